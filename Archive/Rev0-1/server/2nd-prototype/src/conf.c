@@ -0,0 +1,135 @@
+/* conf.c -*-c-*-
+ * Configuration file.
+ * Author: SNESoIP contributors
+ *
+ * This program is part of the SNESoIP project and has has been released
+ * under the terms of a BSD-like license.  See the file LICENSE for
+ * details. */
+
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+#include "conf.h"
+
+
+typedef struct conf_entry_s {
+	char name[ConfNameSize];
+	char value[ConfValueSize];
+} conf_entry_t;
+
+
+// Read once at start-up, before any thread is created.
+static conf_entry_t entries[ConfEntries];
+static int          nentries;
+
+
+static char *trim(char *str) {
+	char *end;
+
+
+	while (isspace((unsigned char)*str))
+		str++;
+
+	end = str + strlen(str);
+	while (end > str && isspace((unsigned char)end[-1]))
+		end--;
+	*end = '\0';
+
+	return str;
+}
+
+
+int loadConf(char *confFile) {
+	FILE *file = fopen(confFile, "r");
+	char  line[256];
+	char *name, *value, *end;
+	int   lineno = 0;
+
+
+	if (! file)
+		return -1;
+
+	nentries = 0;
+	while (fgets(line, sizeof(line), file)) {
+		lineno++;
+
+		// Comments, quotes are not looked into.
+		for (end = line; *end; end++) {
+			if (*end == '"') {
+				end = strchr(end + 1, '"');
+				if (! end)
+					break;
+			} else if (*end == '#' || (end[0] == '/' && end[1] == '/')) {
+				*end = '\0';
+				break;
+			}
+		}
+
+		name = trim(line);
+		if (*name == '\0')
+			continue;
+
+		value = strpbrk(name, "=:");
+		if (! value || nentries == ConfEntries) {
+			syslog(LOG_ERR, "... %s:%d: syntax error\n", confFile, lineno);
+			fclose(file);
+			return -1;
+		}
+		*value++ = '\0';
+		name     = trim(name);
+		value    = trim(value);
+
+		end = value + strlen(value);
+		if (end > value && end[-1] == ';')
+			*--end = '\0';
+		value = trim(value);
+
+		end = value + strlen(value);
+		if (*value == '"' && end > value + 1 && end[-1] == '"') {
+			end[-1] = '\0';
+			value++;
+		}
+
+		snprintf(entries[nentries].name,  ConfNameSize,  "%s", name);
+		snprintf(entries[nentries].value, ConfValueSize, "%s", value);
+		nentries++;
+	}
+
+	fclose(file);
+	return 0;
+}
+
+
+int confString(const char *name, const char **value) {
+	int i;
+
+
+	for (i = 0; i < nentries; i++)
+		if (strcmp(entries[i].name, name) == 0) {
+			*value = entries[i].value;
+			return 1;
+		}
+
+	return 0;
+}
+
+
+int confInt(const char *name, int *value) {
+	const char *str;
+	char       *end;
+	long        l;
+
+
+	if (! confString(name, &str))
+		return 0;
+
+	l = strtol(str, &end, 0);
+	if (end == str || *end != '\0')
+		return 0;
+
+	*value = (int)l;
+	return 1;
+}
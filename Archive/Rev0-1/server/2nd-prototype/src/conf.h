@@ -0,0 +1,28 @@
+/* conf.h -*-c-*-
+ * Configuration file.
+ * Author: SNESoIP contributors
+ *
+ * Reads the flat "name = value" settings of server.conf, strings in
+ * double quotes, comments after // or #.  Same lookups as libconfig,
+ * which is no longer needed.
+ *
+ * This program is part of the SNESoIP project and has has been released
+ * under the terms of a BSD-like license.  See the file LICENSE for
+ * details. */
+
+
+#ifndef CONF_h
+#define CONF_h
+
+
+#define ConfEntries    32
+#define ConfNameSize   32
+#define ConfValueSize 128
+
+
+int   loadConf(char *confFile);
+int   confString(const char *name, const char **value);
+int   confInt(const char *name, int *value);
+
+
+#endif
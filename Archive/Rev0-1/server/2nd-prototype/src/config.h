@@ -11,8 +11,7 @@
 #define CONFIG_h
 
 
-#include <libconfig.h>
-#include "mysql.h"
+#include "db.h"
 
 
 #define exit_if(expr) \
@@ -52,6 +51,13 @@ if (expr) { \
 #define MAXFD 128
 
 
+// Presence table, see presence.h.
+#define PRESENCE_SHARDS       16
+#define PRESENCE_BUCKETS      64 // Per shard.
+#define ACCOUNT_TTL          300 // Seconds until account data is reloaded.
+#define WRITEBEHIND_INTERVAL   5 // Seconds between auth_time flushes.
+
+
 // Debug.
 #define DEBUG 1 // 1 = ON, 2 = OFF.
 
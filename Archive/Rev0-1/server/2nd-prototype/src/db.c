@@ -0,0 +1,263 @@
+/* db.c -*-c-*-
+ * Database workers.
+ * Author: SNESoIP contributors
+ *
+ * This program is part of the SNESoIP project and has has been released
+ * under the terms of a BSD-like license.  See the file LICENSE for
+ * details. */
+
+
+#include <errno.h>
+#include <string.h>
+#include "db.h"
+#include "mysql.h"
+#include "sqlite.h"
+
+
+#define DB_LOAD_ACCOUNT   1
+#define DB_SET_AUTH_TIMES 2
+
+
+static const db_backend_t *backends[] = {
+#ifdef WITH_MYSQL
+	&mysqlBackend,
+#endif
+#ifdef WITH_SQLITE
+	&sqliteBackend,
+#endif
+	NULL
+};
+
+
+typedef struct db_worker_s {
+	pthread_t   thread;
+	void       *con;
+} db_worker_t;
+
+
+static const db_backend_t *backend;
+static db_worker_t         workers[DBWorkersMax];
+static int                 nworkers;
+
+static pthread_mutex_t     m_queue = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t      c_queue = PTHREAD_COND_INITIALIZER;
+static db_request_t       *queue_head;
+static db_request_t       *queue_tail;
+static int                 queue_len;
+static int                 quit;
+
+
+static void *workerDB(void* val);
+
+
+// Call loadConf() first.
+int initDB(void) {
+	const char *name = backends[0] ? backends[0]->name : "";
+	int         i;
+
+
+	// Optional.
+	confString("backend", &name);
+
+	for (i = 0; backends[i]; i++)
+		if (strcmp(backends[i]->name, name) == 0)
+			backend = backends[i];
+
+	if (! backend) {
+		syslog(LOG_ERR, "... backend \"%s\" is not built in\n", name);
+		return -1;
+	}
+
+	if (! confInt("workers", &nworkers) )
+		nworkers = DBWorkersDefault;
+
+	if (nworkers < 1 || nworkers > DBWorkersMax) {
+		syslog(LOG_ERR, "... workers must be 1 to %d\n", DBWorkersMax);
+		return -1;
+	}
+
+	syslog(LOG_INFO, "Step one, we can have lots of fun:");
+
+	if (backend->init() != 0)
+		return -1;
+	syslog(LOG_INFO, "... %s backend initialised.\n", backend->name);
+
+	syslog(LOG_INFO, "Step two, there's so much we can do:");
+
+	// Establish database connections.
+	for (i = 0; i < nworkers; i++) {
+		workers[i].con = backend->connect();
+		if (! workers[i].con)
+			return -1;
+	}
+	syslog(LOG_INFO, "... %d database connections established.", nworkers);
+
+	syslog(LOG_INFO, "Step three, it's just you for me:");
+
+	if (backend->resetAll(workers[0].con) == 0)
+		syslog(LOG_INFO, "... reset status for all users.");
+	else
+		syslog(LOG_INFO, "... reset status for all users faild.");
+
+	syslog(LOG_INFO, "Step four, I can give you more");
+
+	for (i = 0; i < nworkers; i++)
+		if (pthread_create(&workers[i].thread, NULL, &workerDB, &workers[i]) != 0) {
+			syslog(LOG_ERR, "... couldn't create database worker %d.\n", i);
+			return -1;
+		}
+	syslog(LOG_INFO, "... %d database workers started.", nworkers);
+
+
+	return 0;
+}
+
+
+// Lets the workers finish the queue.
+void finiDB(void) {
+	int i;
+
+
+	pthread_mutex_lock(&m_queue);
+	quit = 1;
+	pthread_cond_broadcast(&c_queue);
+	pthread_mutex_unlock(&m_queue);
+
+	for (i = 0; i < nworkers; i++) {
+		pthread_join(workers[i].thread, NULL);
+		backend->disconnect(workers[i].con);
+	}
+
+	backend->fini();
+}
+
+
+static int submitDB(db_request_t *req) {
+	pthread_mutex_lock(&m_queue);
+
+	if (queue_len >= DBQueueSize || quit) {
+		pthread_mutex_unlock(&m_queue);
+		syslog(LOG_WARNING, "database queue full, request dropped\n");
+		free(req);
+		return -1;
+	}
+
+	req->next = NULL;
+	if (queue_tail)
+		queue_tail->next = req;
+	else
+		queue_head = req;
+	queue_tail = req;
+	queue_len++;
+
+	pthread_cond_signal(&c_queue);
+	pthread_mutex_unlock(&m_queue);
+
+
+	return 0;
+}
+
+
+int loadAccountQuery(char *user, db_done_t done, void *arg) {
+	db_request_t *req;
+
+
+	if (strlen(user) >= AccountNameSize)
+		return -1;
+
+	req = (db_request_t*) calloc(1, sizeof(db_request_t));
+	if (! req)
+		return -1;
+
+	req->type  = DB_LOAD_ACCOUNT;
+	req->count = 1;
+	req->done  = done;
+	req->arg   = arg;
+	snprintf(req->user[0], AccountNameSize, "%s", user);
+
+
+	return submitDB(req);
+}
+
+
+// Write-behind: the batch is one transaction.
+int setAuthTimesQuery(char user[][AccountNameSize], time_t *auth_time, int count, db_done_t done, void *arg) {
+	db_request_t *req;
+
+
+	if (count <= 0 || count > AuthTimeBatchSize)
+		return -1;
+
+	req = (db_request_t*) calloc(1, sizeof(db_request_t));
+	if (! req)
+		return -1;
+
+	req->type  = DB_SET_AUTH_TIMES;
+	req->count = count;
+	req->done  = done;
+	req->arg   = arg;
+	memcpy(req->user, user, count * AccountNameSize);
+	memcpy(req->auth_time, auth_time, count * sizeof(time_t));
+
+
+	return submitDB(req);
+}
+
+
+static void *workerDB(void* val) {
+	db_worker_t    *worker = (db_worker_t*) val;
+	db_request_t   *req;
+	struct timespec timeout;
+
+
+	if (backend->threadStart)
+		backend->threadStart();
+
+	for (;;) {
+		pthread_mutex_lock(&m_queue);
+		while (! queue_head && ! quit) {
+			clock_gettime(CLOCK_REALTIME, &timeout);
+			timeout.tv_sec += DBKeepalive;
+
+			// Idle connections are pinged, like the old keepalive thread did.
+			if (pthread_cond_timedwait(&c_queue, &m_queue, &timeout) == ETIMEDOUT && ! queue_head && backend->ping) {
+				pthread_mutex_unlock(&m_queue);
+				backend->ping(worker->con);
+				pthread_mutex_lock(&m_queue);
+			}
+		}
+
+		req = queue_head;
+		if (req) {
+			queue_head = req->next;
+			if (! queue_head)
+				queue_tail = NULL;
+			queue_len--;
+		}
+		pthread_mutex_unlock(&m_queue);
+
+		if (! req)
+			break;
+
+		switch (req->type) {
+			case DB_LOAD_ACCOUNT:
+				req->ret = backend->loadAccount(worker->con, req->user[0], &req->account);
+				break;
+			case DB_SET_AUTH_TIMES:
+				req->ret = backend->setAuthTimes(worker->con, req->user, req->auth_time, req->count);
+				break;
+			default:
+				req->ret = -1;
+				break;
+		}
+
+		if (req->done)
+			req->done(req);
+		free(req);
+	}
+
+	if (backend->threadEnd)
+		backend->threadEnd();
+
+	return NULL;
+}
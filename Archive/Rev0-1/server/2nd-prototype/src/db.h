@@ -0,0 +1,92 @@
+/* db.h -*-c-*-
+ * Database workers.
+ * Author: SNESoIP contributors
+ *
+ * A fixed pool of workers, each with its own connection, runs the
+ * queued requests and calls back when they are done.  Where the data
+ * lives is up to the backend chosen by "backend" in server.conf, see
+ * mysql.h and sqlite.h.
+ *
+ * This program is part of the SNESoIP project and has has been released
+ * under the terms of a BSD-like license.  See the file LICENSE for
+ * details. */
+
+
+#ifndef DB_h
+#define DB_h
+
+#define QueryBufferSize   256
+#define AccountNameSize    32
+#define AuthTimeBatchSize  64
+
+#define DBWorkersDefault    4  // Connections, see "workers" in server.conf.
+#define DBWorkersMax       16
+#define DBQueueSize       256  // Pending requests before submits fail.
+#define DBKeepalive        60  // Idle seconds between pings.
+
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <syslog.h>
+#include <time.h>
+#include <unistd.h>
+#include "conf.h"
+#include "utils.h"
+
+
+// Durable account data, see presence.h for what is kept online.
+typedef struct account_s {
+	int  userid;
+	char key[11];
+	char opponent[AccountNameSize];
+	char pwhash[41];
+} account_t;
+
+
+// A request is run by one of the workers, which then calls done() and
+// frees it.  done() runs on the worker thread and must not block.
+typedef struct db_request_s {
+	int        type;
+	int        ret;     // Load: 1 found, 0 unknown, -1 error.  Else 0 or -1.
+
+	int        count;
+	char       user[AuthTimeBatchSize][AccountNameSize];
+	time_t     auth_time[AuthTimeBatchSize];
+	account_t  account;
+
+	void     (*done)(struct db_request_s *req);
+	void      *arg;
+
+	struct db_request_s *next;
+} db_request_t;
+
+typedef void (*db_done_t)(db_request_t *req);
+
+
+// A storage backend.  Each connection is only ever used by one worker.
+typedef struct db_backend_s {
+	const char *name;
+
+	int   (*init)(void);        // Reads its settings.
+	void  (*fini)(void);
+	void *(*connect)(void);
+	void  (*disconnect)(void *con);
+	void  (*threadStart)(void); // Optional, on each worker.
+	void  (*threadEnd)(void);
+
+	int   (*resetAll)(void *con);
+	int   (*loadAccount)(void *con, char *user, account_t *account);
+	int   (*setAuthTimes)(void *con, char user[][AccountNameSize], time_t *auth_time, int count);
+	void  (*ping)(void *con);   // Optional.
+} db_backend_t;
+
+
+int   initDB(void);
+void  finiDB(void);
+
+int   loadAccountQuery(char *user, db_done_t done, void *arg);
+int   setAuthTimesQuery(char user[][AccountNameSize], time_t *auth_time, int count, db_done_t done, void *arg);
+
+
+#endif
@@ -0,0 +1,254 @@
+/* loginbench.c -*-c-*-
+ * Login benchmark for the server.
+ * Author: SNESoIP contributors
+ *
+ * Each of n clients logs in r times (HELO, USER, PASS, QUIT) with its
+ * own account, <prefix><i>.  The first round finds the presence table
+ * empty, the following ones show logins from the cache.  -S prints the
+ * SQL to add the accounts to the user table, for MySQL and SQLite.
+ *
+ *   loginbench [-h host] [-p port] [-n clients] [-r rounds]
+ *              [-u prefix] [-w password] [-k key] [-S]
+ *
+ * This program is part of the SNESoIP project and has has been released
+ * under the terms of a BSD-like license.  See the file LICENSE for
+ * details. */
+
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#include "sha1.h"
+#include "trivium64.h"
+
+
+#define MAX_CLIENTS 100
+
+
+typedef struct client_s {
+	pthread_t thread;
+	int       index;
+	int       ok;
+	int       failed;
+	double    seconds;  // Sum of the login times of this round.
+} client_t;
+
+
+static const char        *host     = "127.0.0.1";
+static int                port     = 51234;
+static int                clients  = 10;
+static int                rounds   = 5;
+static const char        *prefix   = "bench";
+static const char        *password = "benchpassword";
+static const char        *key      = "0123456789";
+
+static client_t           client[MAX_CLIENTS];
+static pthread_barrier_t  start, end;
+
+
+static double now(void) {
+	struct timespec ts;
+
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+static int readLine(int fd, char *line, int size) {
+	int len = 0;
+
+
+	while (len < size - 1) {
+		if (read(fd, line + len, 1) != 1)
+			return -1;
+		if (line[len] == '\n')
+			break;
+		len++;
+	}
+	line[len] = '\0';
+
+	return len;
+}
+
+
+static int login(int index) {
+	struct sockaddr_in sa;
+	trivium64_ctx_t    ctx;
+	uint64_t           ks[TRIVIUM64_WORDS(1 + 8 * 64)];
+	uint8_t            keystream[64];
+	char               line[128];
+	char               user[32];
+	char               iv[16];
+	int                fd, len, i, ok = 0;
+	int                yes = 1;
+
+
+	snprintf(user, sizeof(user), "%s%d", prefix, index);
+
+	fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (fd < 0)
+		return 0;
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sin_family = AF_INET;
+	sa.sin_port   = htons(port);
+	inet_pton(AF_INET, host, &sa.sin_addr);
+
+	if (connect(fd, (struct sockaddr *) &sa, sizeof(sa)) != 0)
+		goto out;
+
+	if (write(fd, "HELO server\n", 12) != 12 || readLine(fd, line, sizeof(line)) < 0)
+		goto out;
+
+	len = snprintf(line, sizeof(line), "USER %s\n", user);
+	if (write(fd, line, len) != len || readLine(fd, line, sizeof(line)) < 0 || strcmp(line, "OK") != 0)
+		goto out;
+
+	if (readLine(fd, iv, sizeof(iv)) != 10)
+		goto out;
+
+	// Same as the firmware: the password is XORed with the keystream,
+	// after its first bit.
+	trivium64_init(key, iv, &ctx);
+	for (i = 0; i < TRIVIUM64_WORDS(1 + 8 * 64); i++)
+		ks[i] = trivium64_next(&ctx);
+	trivium64_bytes(ks, 1, keystream, sizeof(keystream));
+
+	len = snprintf(line, sizeof(line), "PASS ");
+	for (i = 0; password[i]; i++)
+		len += snprintf(line + len, sizeof(line) - len, "%02x",
+			(uint8_t)(password[i] ^ keystream[i]));
+	line[len++] = '\n';
+
+	if (write(fd, line, len) != len || readLine(fd, line, sizeof(line)) < 0)
+		goto out;
+
+	ok = strcmp(line, "OK") == 0;
+	if (write(fd, "QUIT\n", 5) != 5)
+		ok = 0;
+
+	// The server closes the connection after QUIT.
+	while (read(fd, line, sizeof(line)) > 0);
+
+out:
+	close(fd);
+	return ok;
+}
+
+
+static void *run(void *arg) {
+	client_t *c = (client_t*) arg;
+	double    t;
+	int       r;
+
+
+	for (r = 0; r < rounds; r++) {
+		pthread_barrier_wait(&start);
+
+		t = now();
+		if (login(c->index))
+			c->ok++;
+		else
+			c->failed++;
+		c->seconds = now() - t;
+
+		pthread_barrier_wait(&end);
+	}
+
+	return NULL;
+}
+
+
+// The password column holds SHA1(CONCAT_WS(':', username, password)).
+static void printSeed(void) {
+	char salted[128];
+	char hex[SHA1_HEX_SIZE];
+	int  i, len;
+
+
+	printf("INSERT INTO user (username, password, `key`, dest_username) VALUES\n");
+	for (i = 0; i < clients; i++) {
+		len = snprintf(salted, sizeof(salted), "%s%d:%s", prefix, i, password);
+		sha1Hex(salted, len, hex);
+
+		printf("('%s%d', '%s', '%s', '%s%d')%s\n",
+			prefix, i, hex, key, prefix, i ^ 1, i + 1 < clients ? "," : ";");
+	}
+}
+
+
+int main(int argc, char *argv[]) {
+	int    options, i, r, ok, failed, seed = 0;
+	double t, sum;
+
+
+	while ( (options = getopt(argc, argv, "h:p:n:r:u:w:k:S") ) != -1)
+		switch (options) {
+			case 'h': host     = optarg;       break;
+			case 'p': port     = atoi(optarg); break;
+			case 'n': clients  = atoi(optarg); break;
+			case 'r': rounds   = atoi(optarg); break;
+			case 'u': prefix   = optarg;       break;
+			case 'w': password = optarg;       break;
+			case 'k': key      = optarg;       break;
+			case 'S': seed     = 1;            break;
+			default:
+				fprintf(stderr, "usage: %s [-h host] [-p port] [-n clients] [-r rounds] "
+				                "[-u prefix] [-w password] [-k key] [-S]\n", argv[0]);
+				return EXIT_FAILURE;
+		}
+
+	if (clients < 1 || clients > MAX_CLIENTS || rounds < 1 || strlen(key) != 10 || strlen(password) > 64) {
+		fprintf(stderr, "1 to %d clients, at least one round, a 10 character key and at most 64 characters password.\n", MAX_CLIENTS);
+		return EXIT_FAILURE;
+	}
+
+	if (seed) {
+		printSeed();
+		return EXIT_SUCCESS;
+	}
+
+	pthread_barrier_init(&start, NULL, clients + 1);
+	pthread_barrier_init(&end,   NULL, clients + 1);
+
+	for (i = 0; i < clients; i++) {
+		client[i].index = i;
+		pthread_create(&client[i].thread, NULL, &run, &client[i]);
+	}
+
+	for (r = 0; r < rounds; r++) {
+		ok = failed = 0;
+		sum = 0;
+
+		t = now();
+		pthread_barrier_wait(&start);
+		pthread_barrier_wait(&end);
+		t = now() - t;
+
+		for (i = 0; i < clients; i++) {
+			ok     += client[i].ok;
+			failed += client[i].failed;
+			sum    += client[i].seconds;
+			client[i].ok = client[i].failed = 0;
+		}
+
+		printf("round %d%s: %d logins, %d failed, %.0f logins/s, %.2f ms per login\n",
+			r + 1, r == 0 ? " (cold)" : "", ok, failed, ok / t, sum / clients * 1000);
+	}
+
+	for (i = 0; i < clients; i++)
+		pthread_join(client[i].thread, NULL);
+
+
+	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
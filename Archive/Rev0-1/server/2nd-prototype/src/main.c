@@ -12,9 +12,9 @@
 
 
 int main(int argc, char *argv[]){
-	extern MYSQL *dbCon;
-	pthread_t     t_sql_keepavlive;
+	pthread_t     t_writebehind;
 	int           options, rc;
+	int           portnum = 0;
 	char         *confFile = "server.conf";
 
 
@@ -36,35 +36,31 @@ int main(int argc, char *argv[]){
 		}
 
 
-	// Initialise MySQL.
-	if (initMySQL(confFile) == -1)
-		return -1;
-
-	rc = pthread_create(&t_sql_keepavlive, NULL, &keepaliveMySQL, NULL);
-	if (rc != 0) {
-		syslog(LOG_ERR, "Couldn't create t_sql_keepavlive.\n");
-		return EXIT_FAILURE;
-	}
-
-
 	// Initialise and read configuration file.
-	config_t          conf;
-	config_setting_t *setting;
-	int               portnum = 0;
-	config_init(&conf);
-
-	if (! config_read_file(&conf, confFile)) {
-		config_destroy(&conf);
+	if (loadConf(confFile) != 0) {
 		syslog(LOG_ERR, "... %s: wrong file format or file does not exist.\n", confFile);
 		return -1;
 	}
 
-	if ((! config_lookup_int(&conf, "port", &portnum))) {
+	if ((! confInt("port", &portnum))) {
 		syslog(LOG_ERR, "... %s: port is not set\n", confFile);
 		return -1;
 	}
 
 
+	// Initialise database.
+	if (initDB() == -1)
+		return -1;
+
+	initPresence();
+
+	rc = pthread_create(&t_writebehind, NULL, &writebehindPresence, NULL);
+	if (rc != 0) {
+		syslog(LOG_ERR, "Couldn't create t_writebehind.\n");
+		return EXIT_FAILURE;
+	}
+
+
 	// Start TCP server.
 	loop(init_tcp(portnum));
 
@@ -13,6 +13,7 @@
 
 #include <getopt.h>
 #include "config.h"
+#include "presence.h"
 
 
 #endif
@@ -1,5 +1,5 @@
 /* mysql.c -*-c-*-
- * Database handler.
+ * MySQL/MariaDB storage backend.
  * Author: saturnu
  *
  * This program is part of the SNESoIP project and has has been released
@@ -7,406 +7,294 @@
  * details. */
 
 
+#include <mysql.h>
+#include <string.h>
 #include "mysql.h"
 
 
-int initMySQL(char *confFile) {
-	const char *hostname;
-	const char *username;
-	const char *password;
-	const char *database;
+#if !defined(MARIADB_BASE_VERSION) && MYSQL_VERSION_ID >= 80000
+typedef bool my_bool;
+#endif
 
-	char error = 0;
-	dbCon = mysql_init(NULL);
 
+// Each worker owns its connection and its prepared statements.
+typedef struct mysql_con_s {
+	MYSQL      *con;
+	MYSQL_STMT *load;
+	MYSQL_STMT *auth_time;
+} mysql_con_t;
 
-	// Initialise and read configuration file.
-	config_t          conf;
-	config_setting_t *setting;
-	config_init(&conf);
 
-	syslog(LOG_INFO, "Step one, we can have lots of fun:");
+static const char *hostname;
+static const char *username;
+static const char *password;
+static const char *database;
 
 
-	if (! config_read_file(&conf, confFile)) {
-		config_destroy(&conf);
-		syslog(LOG_ERR, "... %s: wrong file format or file does not exist.\n", confFile);
-		return -1;
-	}
+static int   resetAllIPMySQLQuery(MYSQL *con);
+static int   resetAllOnlineMySQLQuery(MYSQL *con);
+static int   resetAllPortMySQLQuery(MYSQL *con);
+
+
+static int initMySQL(void) {
+	char error = 0;
 
-	if ( (! config_lookup_string(&conf, "hostname", &hostname) ) || (strlen(hostname) == 0) ) {
-		syslog(LOG_ERR, "... %s: hostname is not set\n", confFile);
+
+	if ( (! confString("hostname", &hostname) ) || (strlen(hostname) == 0) ) {
+		syslog(LOG_ERR, "... hostname is not set\n");
 		error = 1;
 	}
 
-	if ( (! config_lookup_string(&conf, "username", &username) ) || (strlen(username) == 0) ) {
-		syslog(LOG_ERR, "... %s: username is not set\n", confFile);
+	if ( (! confString("username", &username) ) || (strlen(username) == 0) ) {
+		syslog(LOG_ERR, "... username is not set\n");
 		error = 1;
 	}
 
-	if ( (! config_lookup_string(&conf, "password", &password) ) || (strlen(password) == 0) ) {
-		syslog(LOG_ERR, "... %s: password is not set\n", confFile);
+	if ( (! confString("password", &password) ) || (strlen(password) == 0) ) {
+		syslog(LOG_ERR, "... password is not set\n");
 		error = 1;
 	}
 
-	if ( (! config_lookup_string(&conf, "database", &database) ) || (strlen(database) == 0) ) {
-		syslog(LOG_ERR, "... %s: database is not set\n", confFile);
+	if ( (! confString("database", &database) ) || (strlen(database) == 0) ) {
+		syslog(LOG_ERR, "... database is not set\n");
 		error = 1;
 	}
 
 	if (error == 1) return -1;
-	syslog(LOG_INFO, "... sucessfully loaded %s.\n", confFile);
-
-
-	// Initialise database connection.
-	if (! dbCon) {
-		syslog(LOG_ERR, "... %s\n", mysql_error(dbCon) );
-		return -1;
-	}
-	syslog(LOG_INFO, "Step two, there's so much we can do:");
 
-	// Establish database connection.
-	if (mysql_real_connect(dbCon, hostname, username, password,
-			database, 0, NULL, 0) == NULL) {
-
-		syslog(LOG_ERR, "... %s\n", mysql_error(dbCon) );
-		mysql_close(dbCon);
+	if (mysql_library_init(0, NULL, NULL) != 0) {
+		syslog(LOG_ERR, "... could not initialise the client library\n");
 		return -1;
 	}
-	syslog(LOG_INFO, "... Database connection established.");
-
-	syslog(LOG_INFO, "Step three, it's just you for me:");
 
-	int ret = resetAllMySQLQuery();
-	if(ret==0)
-		syslog(LOG_INFO, "... reset status for all users.");
-	else
-		syslog(LOG_INFO, "... reset status for all users faild.");
-
-	//syslog(LOG_INFO, "Step five, don't you know that the time has arrived");
 
-	config_destroy(&conf);
 	return 0;
 }
 
 
-void finiMySQL() { mysql_close(dbCon); }
-
+static void finiMySQL(void) { mysql_library_end(); }
 
-int authMySQLQuery(char *user, char *pass) {
-	char       query[QueryBufferSize];
-	int        user_id = 0;
-	MYSQL_RES *res;
-	MYSQL_ROW  row;
 
-	char *user_esc = (char*) malloc(strlen(user));
-	char *pass_esc = (char*) malloc(strlen(pass));
-	mysql_real_escape_string(dbCon, user_esc, user, strlen(user));
-	mysql_real_escape_string(dbCon, pass_esc, pass, strlen(pass));
+static MYSQL_STMT *prepareMySQL(MYSQL *con, const char *query) {
+	MYSQL_STMT *stmt = mysql_stmt_init(con);
 
-	int cx = snprintf ( query, 256, "SELECT userid FROM snesoip.user WHERE username = '%s' AND password = (SHA1(CONCAT_WS(':','%s','%s')))", user_esc , user_esc ,pass_esc );
 
-
-	if (mysql_query(dbCon, query) != 0) {
-		syslog(LOG_ERR, "%s", mysql_error(dbCon) );
-		return -1;
-	}
-
-	if ( (res = mysql_store_result(dbCon)) == NULL) {
-		syslog(LOG_ERR, "%s", mysql_error(dbCon) );
-		return -1;
+	if (! stmt) {
+		syslog(LOG_ERR, "... %s\n", mysql_error(con) );
+		return NULL;
 	}
 
-	if ( (row = mysql_fetch_row(res)) == NULL) {
-		//just not found
-		//syslog(LOG_ERR, "%s", mysql_error(dbCon) );
-		return 0;
+	if (mysql_stmt_prepare(stmt, query, strlen(query)) != 0) {
+		syslog(LOG_ERR, "... %s\n", mysql_stmt_error(stmt) );
+		mysql_stmt_close(stmt);
+		return NULL;
 	}
 
 
-	mysql_free_result(res);
-
-	if(atoi(row[0]) != 0);
-	user_id = atoi(row[0]);
-
-	return user_id;
+	return stmt;
 }
 
 
-int userMySQLQuery(char *user) {
-	char       query[QueryBufferSize];
-	int        user_id = 0;
-	MYSQL_RES *res;
-	MYSQL_ROW  row;
-
-	char *user_esc = (char*) malloc(strlen(user));
-	mysql_real_escape_string(dbCon, user_esc, user, strlen(user));
+static void disconnectMySQL(void *val) {
+	mysql_con_t *worker = (mysql_con_t*) val;
 
-	int cx = snprintf ( query, 128, "SELECT userid FROM snesoip.user WHERE username = '%s'", user_esc);
 
-
-	if (mysql_query(dbCon, query) != 0) {
-		syslog(LOG_ERR, "%s", mysql_error(dbCon) );
-		return -1;
-	}
-
-	if ( (res = mysql_store_result(dbCon)) == NULL) {
-		syslog(LOG_ERR, "%s", mysql_error(dbCon) );
-		return -1;
-	}
-
-	if ( (row = mysql_fetch_row(res)) == NULL) {
-		//just not found
-		//syslog(LOG_ERR, "%s", mysql_error(dbCon) );
-		return 0;
-	}
-
-
-	mysql_free_result(res);
-
-	if(atoi(row[0]) != 0);
-	user_id = atoi(row[0]);
-
-	return user_id;
+	if (worker->load)
+		mysql_stmt_close(worker->load);
+	if (worker->auth_time)
+		mysql_stmt_close(worker->auth_time);
+	mysql_close(worker->con);
+	free(worker);
 }
 
 
-// Obsolete.
-char *getModeMySQLQuery(char *user, char *dest_user) {
-	char       query[QueryBufferSize];
-	int        user_id = 0;
-	MYSQL_RES *res;
-	MYSQL_ROW  row;
-
-	char *user_esc = (char*) malloc(strlen(user));
-	mysql_real_escape_string(dbCon, user_esc, user, strlen(user));
-	char *dest_user_esc = (char*) malloc(strlen(dest_user));
-	mysql_real_escape_string(dbCon, dest_user_esc, dest_user, strlen(dest_user));
-
-	//	int cx = snprintf ( query, 256,"SELECT CASE WHEN (SELECT auth_time from snesoip.user WHERE username='%s')>(SELECT auth_time from snesoip.user where username=(SELECT dest_username from snesoip.user where username='%s')) THEN 'true' ELSE 'false' END", user_esc, user_esc);
-	int cx = snprintf ( query, 256,"SELECT CASE WHEN (SELECT auth_time from snesoip.user WHERE username='%s')>(SELECT auth_time from snesoip.user where username='%s') THEN 'true' ELSE 'false' END", user_esc, dest_user_esc);
+static void *connectMySQL(void) {
+	mysql_con_t *worker = (mysql_con_t*) calloc(1, sizeof(mysql_con_t));
 
 
-	if (mysql_query(dbCon, query) != 0) {
-		syslog(LOG_ERR, "%s", mysql_error(dbCon) );
+	if (! worker || ! (worker->con = mysql_init(NULL)) ) {
+		syslog(LOG_ERR, "... out of memory\n");
+		free(worker);
 		return NULL;
 	}
 
-	if ( (res = mysql_store_result(dbCon)) == NULL) {
-		syslog(LOG_ERR, "%s", mysql_error(dbCon) );
+	if (mysql_real_connect(worker->con, hostname, username, password,
+			database, 0, NULL, 0) == NULL) {
+
+		syslog(LOG_ERR, "... %s\n", mysql_error(worker->con) );
+		disconnectMySQL(worker);
 		return NULL;
 	}
 
-	if ( (row = mysql_fetch_row(res)) == NULL) {
-		//just not found
-		//syslog(LOG_ERR, "%s", mysql_error(dbCon) );
+	worker->load = prepareMySQL(worker->con,
+		"SELECT userid, `key`, dest_username, password FROM snesoip.user WHERE username = ?");
+	worker->auth_time = prepareMySQL(worker->con,
+		"UPDATE snesoip.user SET auth_time = FROM_UNIXTIME(?) WHERE username = ?");
+
+	if (! worker->load || ! worker->auth_time) {
+		disconnectMySQL(worker);
 		return NULL;
 	}
 
 
-	mysql_free_result(res);
-
-	return row[0];
+	return worker;
 }
 
 
-int isPlayerOnlineMySQLQuery(char *user) {
-	char       query[QueryBufferSize];
-	int        online = 0;
-	MYSQL_RES *res;
-	MYSQL_ROW  row;
-
-	char *user_esc = (char*) malloc(strlen(user));
-	mysql_real_escape_string(dbCon, user_esc, user, strlen(user));
-
-	//	int cx = snprintf ( query, 256,"SELECT CASE WHEN (SELECT auth_time from snesoip.user WHERE username='%s')>(SELECT auth_time from snesoip.user where username=(SELECT dest_username from snesoip.user where username='%s')) THEN 'true' ELSE 'false' END", user_esc, user_esc);
-	int cx = snprintf ( query, 256,"SELECT online from snesoip.user where username='%s'", user_esc);
-
-
-	if (mysql_query(dbCon, query) != 0) {
-		syslog(LOG_ERR, "%s", mysql_error(dbCon) );
+static void threadStartMySQL(void) { mysql_thread_init(); }
+static void threadEndMySQL(void)   { mysql_thread_end(); }
+
+
+static int loadAccountMySQLQuery(void *val, char *user, account_t *account) {
+	mysql_con_t   *worker = (mysql_con_t*) val;
+	MYSQL_BIND    param[1];
+	MYSQL_BIND    result[4];
+	unsigned long user_len = strlen(user);
+	unsigned long len[4];
+	my_bool       is_null[4];
+	int           ret, i;
+
+
+	memset(param, 0, sizeof(param));
+	param[0].buffer_type   = MYSQL_TYPE_STRING;
+	param[0].buffer        = user;
+	param[0].buffer_length = user_len;
+	param[0].length        = &user_len;
+
+	memset(account, 0, sizeof(account_t));
+	memset(result, 0, sizeof(result));
+	result[0].buffer_type   = MYSQL_TYPE_LONG;
+	result[0].buffer        = &account->userid;
+	result[1].buffer_type   = MYSQL_TYPE_STRING;
+	result[1].buffer        = account->key;
+	result[1].buffer_length = sizeof(account->key);
+	result[2].buffer_type   = MYSQL_TYPE_STRING;
+	result[2].buffer        = account->opponent;
+	result[2].buffer_length = sizeof(account->opponent);
+	result[3].buffer_type   = MYSQL_TYPE_STRING;
+	result[3].buffer        = account->pwhash;
+	result[3].buffer_length = sizeof(account->pwhash);
+	for (i = 0; i < 4; i++) {
+		result[i].length  = &len[i];
+		result[i].is_null = &is_null[i];
+	}
+
+	if (mysql_stmt_bind_param(worker->load, param) != 0 ||
+	    mysql_stmt_execute(worker->load) != 0 ||
+	    mysql_stmt_bind_result(worker->load, result) != 0 ||
+	    mysql_stmt_store_result(worker->load) != 0) {
+		syslog(LOG_ERR, "%s", mysql_stmt_error(worker->load) );
+		mysql_stmt_free_result(worker->load);
 		return -1;
 	}
 
-	if ( (res = mysql_store_result(dbCon)) == NULL) {
-		syslog(LOG_ERR, "%s", mysql_error(dbCon) );
-		return -1;
-	}
+	ret = mysql_stmt_fetch(worker->load);
+	mysql_stmt_free_result(worker->load);
 
-	if ( (row = mysql_fetch_row(res)) == NULL) {
-		//just not found
-		//syslog(LOG_ERR, "%s", mysql_error(dbCon) );
+	if (ret == MYSQL_NO_DATA)
 		return 0;
-	}
-
-
-	mysql_free_result(res);
-
-	if(atoi(row[0]) != 0);
-	online = atoi(row[0]);
-
-	return online;
-}
-
-
-char *getDestAddrMySQLQuery(char *dest_user) {
-	char       query[QueryBufferSize];
-
-	MYSQL_RES *res;
-	MYSQL_ROW  row;
-
-	char *dest_user_esc = (char*) malloc(strlen(dest_user));
-	mysql_real_escape_string(dbCon, dest_user_esc, dest_user, strlen(dest_user));
-
-	int cx = snprintf ( query, 256, "SELECT CONCAT(user.curr_ip,':',user.port) FROM user WHERE username='%s'", dest_user_esc);
 
-
-	if (mysql_query(dbCon, query) != 0) {
-		syslog(LOG_ERR, "%s", mysql_error(dbCon) );
-		return NULL;
+	if (ret != 0 && ret != MYSQL_DATA_TRUNCATED) {
+		syslog(LOG_ERR, "%s", mysql_stmt_error(worker->load) );
+		return -1;
 	}
 
-	if ( (res = mysql_store_result(dbCon)) == NULL) {
-		syslog(LOG_ERR, "%s", mysql_error(dbCon) );
-		return NULL;
-	}
-
-	if ( (row = mysql_fetch_row(res)) == NULL) {
-		//just not found
-		//syslog(LOG_ERR, "%s", mysql_error(dbCon) );
-		return NULL;
-	}
+	// Truncated strings are not terminated, NULL columns are empty.
+	account->key[sizeof(account->key) - 1]           = '\0';
+	account->opponent[sizeof(account->opponent) - 1] = '\0';
+	account->pwhash[sizeof(account->pwhash) - 1]     = '\0';
+	if (is_null[1]) account->key[0]      = '\0';
+	if (is_null[2]) account->opponent[0] = '\0';
+	if (is_null[3]) account->pwhash[0]   = '\0';
 
 
-	mysql_free_result(res);
-	return row[0];
+	return 1;
 }
 
 
-char *getClientKeyMySQLQuery(char *user) {
-	char       query[QueryBufferSize];
-	int        user_id = 0;
-	MYSQL_RES *res;
-	MYSQL_ROW  row;
-
-	char *user_esc = (char*) malloc(strlen(user));
-	mysql_real_escape_string(dbCon, user_esc, user, strlen(user));
+static int setAuthTimesMySQLQuery(void *val, char users[][AccountNameSize], time_t *auth_times, int count) {
+	mysql_con_t   *worker = (mysql_con_t*) val;
+	MYSQL_BIND    param[2];
+	long long     auth_time;
+	char          user[AccountNameSize];
+	unsigned long user_len;
+	int           i;
 
-	int cx = snprintf ( query, 256, "SELECT user.key FROM user WHERE username='%s'", user_esc);
 
+	memset(param, 0, sizeof(param));
+	param[0].buffer_type   = MYSQL_TYPE_LONGLONG;
+	param[0].buffer        = &auth_time;
+	param[1].buffer_type   = MYSQL_TYPE_STRING;
+	param[1].buffer        = user;
+	param[1].buffer_length = sizeof(user);
+	param[1].length        = &user_len;
 
-	if (mysql_query(dbCon, query) != 0) {
-		syslog(LOG_ERR, "%s", mysql_error(dbCon) );
-		return NULL;
-	}
-
-	if ( (res = mysql_store_result(dbCon)) == NULL) {
-		syslog(LOG_ERR, "%s", mysql_error(dbCon) );
-		return NULL;
+	if (mysql_query(worker->con, "START TRANSACTION") != 0) {
+		syslog(LOG_ERR, "%s", mysql_error(worker->con) );
+		return -1;
 	}
 
-	if ( (row = mysql_fetch_row(res)) == NULL) {
-		//just not found
-		//syslog(LOG_ERR, "%s", mysql_error(dbCon) );
-		return NULL;
+	if (mysql_stmt_bind_param(worker->auth_time, param) != 0) {
+		syslog(LOG_ERR, "%s", mysql_stmt_error(worker->auth_time) );
+		mysql_rollback(worker->con);
+		return -1;
 	}
 
+	for (i = 0; i < count; i++) {
+		auth_time = auth_times[i];
+		memcpy(user, users[i], AccountNameSize);
+		user_len  = strlen(user);
 
-	mysql_free_result(res);
-	return row[0];
-}
-
-
-char *getOpponentMySQLQuery(char *user) {
-	char       query[QueryBufferSize];
-	int        user_id = 0;
-	MYSQL_RES *res;
-	MYSQL_ROW  row;
-
-	char *user_esc = (char*) malloc(strlen(user));
-	mysql_real_escape_string(dbCon, user_esc, user, strlen(user));
-
-	int cx = snprintf ( query, 256, "SELECT user.dest_username FROM user WHERE username='%s'", user_esc);
-
-
-	if (mysql_query(dbCon, query) != 0) {
-		syslog(LOG_ERR, "%s", mysql_error(dbCon) );
-		return NULL;
-	}
-
-	if ( (res = mysql_store_result(dbCon)) == NULL) {
-		syslog(LOG_ERR, "%s", mysql_error(dbCon) );
-		return NULL;
+		if (mysql_stmt_execute(worker->auth_time) != 0) {
+			syslog(LOG_ERR, "%s", mysql_stmt_error(worker->auth_time) );
+			mysql_rollback(worker->con);
+			return -1;
+		}
 	}
 
-	if ( (row = mysql_fetch_row(res)) == NULL) {
-		//just not found
-		//syslog(LOG_ERR, "%s", mysql_error(dbCon) );
-		return NULL;
+	if (mysql_commit(worker->con) != 0) {
+		syslog(LOG_ERR, "%s", mysql_error(worker->con) );
+		return -1;
 	}
 
 
-	mysql_free_result(res);
-	return row[0];
+	return 0;
 }
 
 
-int freePortMySQLQuery(char *curr_ip, int port) {
-	char       query[QueryBufferSize];
-	int        user_id = 0;
-	MYSQL_RES *res;
-	MYSQL_ROW  row;
-
-	char *curr_ip_esc = (char*) malloc(strlen(curr_ip));
-	mysql_real_escape_string(dbCon, curr_ip_esc, curr_ip, strlen(curr_ip));
-
-
-	int cx = snprintf ( query, 128, "SELECT userid FROM snesoip.user WHERE curr_ip = '%s' AND port = %i", curr_ip_esc , port );
-
-
-	if (mysql_query(dbCon, query) != 0) {
-		syslog(LOG_ERR, "a%s", mysql_error(dbCon) );
-		return -1;
-	}
-
-	if ( (res = mysql_store_result(dbCon)) == NULL) {
-		syslog(LOG_ERR, "b%s", mysql_error(dbCon) );
-		return -1;
-	}
-
-	if ( (row = mysql_fetch_row(res)) == NULL) {
-		//just not found
-		//syslog(LOG_ERR, "c%s", mysql_error(dbCon) );
-		return 0;
-	}
+static void pingMySQL(void *val) {
+	mysql_con_t *worker = (mysql_con_t*) val;
+	int          ret    = mysql_ping(worker->con);
 
 
-	mysql_free_result(res);
+	if (ret == 0)
+		return;
 
-	if(atoi(row[0]) != 0);
-	user_id = atoi(row[0]);
-
-	return user_id;
+	if (mysql_errno(worker->con) == 2006)
+		syslog(LOG_ERR, "...sqlserver is gone!");
+	else
+		syslog(LOG_ERR, "...keep alive - connection error!");
 }
 
 
-int resetAllMySQLQuery(void) {
-	int a =  resetAllOnlineMySQLQuery();
-	int b =  resetAllIPMySQLQuery();
-	int c =  resetAllPortMySQLQuery();
+static int resetAllMySQLQuery(void *val) {
+	MYSQL *con = ((mysql_con_t*) val)->con;
+	int a =  resetAllOnlineMySQLQuery(con);
+	int b =  resetAllIPMySQLQuery(con);
+	int c =  resetAllPortMySQLQuery(con);
 
 	return (a+b+c);
 }
 
 
-int resetAllOnlineMySQLQuery(void) {
+static int resetAllOnlineMySQLQuery(MYSQL *con) {
 	char query[QueryBufferSize];
 
 	int cx=0;
 	cx = snprintf ( query, 128, "UPDATE snesoip.user SET online = false");
 
-	if (mysql_query(dbCon, query) != 0) {
-		syslog(LOG_ERR, "%s", mysql_error(dbCon) );
+	if (mysql_query(con, query) != 0) {
+		syslog(LOG_ERR, "%s", mysql_error(con) );
 		return -1;
 	}
 
@@ -415,14 +303,14 @@ int resetAllOnlineMySQLQuery(void) {
 }
 
 
-int resetAllIPMySQLQuery(void) {
+static int resetAllIPMySQLQuery(MYSQL *con) {
 	char query[QueryBufferSize];
 
 	int cx=0;
 	cx = snprintf ( query, 128, "UPDATE snesoip.user SET curr_ip = 'none'");
 
-	if (mysql_query(dbCon, query) != 0) {
-		syslog(LOG_ERR, "%s", mysql_error(dbCon) );
+	if (mysql_query(con, query) != 0) {
+		syslog(LOG_ERR, "%s", mysql_error(con) );
 		return -1;
 	}
 
@@ -431,14 +319,14 @@ int resetAllIPMySQLQuery(void) {
 }
 
 
-int resetAllPortMySQLQuery(void) {
+static int resetAllPortMySQLQuery(MYSQL *con) {
 	char query[QueryBufferSize];
 
 	int cx=0;
 	cx = snprintf ( query, 128, "UPDATE snesoip.user SET port = 0");
 
-	if (mysql_query(dbCon, query) != 0) {
-		syslog(LOG_ERR, "%s", mysql_error(dbCon) );
+	if (mysql_query(con, query) != 0) {
+		syslog(LOG_ERR, "%s", mysql_error(con) );
 		return -1;
 	}
 
@@ -447,110 +335,16 @@ int resetAllPortMySQLQuery(void) {
 }
 
 
-int setOnlineMySQLQuery(char *user, int status) {
-	char query[QueryBufferSize];
-
-	char *user_esc = (char*) malloc(strlen(user));
-	mysql_real_escape_string(dbCon, user_esc, user, strlen(user));
-
-	if(status==1) {
-		int cx = snprintf ( query, 128, "UPDATE snesoip.user SET online = true WHERE username = '%s'", user_esc);
-
-	} else {
-		int cx = snprintf ( query, 128, "UPDATE snesoip.user SET online = false WHERE username = '%s'", user_esc);
-	}
-
-	if (mysql_query(dbCon, query) != 0) {
-		syslog(LOG_ERR, "%s", mysql_error(dbCon) );
-		return -1;
-	}
-
-
-	return 0;
-}
-
-
-int setPortMySQLQuery(char *user, int port) {
-	char query[QueryBufferSize];
-
-	char *user_esc = (char*) malloc(strlen(user));
-	mysql_real_escape_string(dbCon, user_esc, user, strlen(user));
-
-	int cx = snprintf ( query, 128, "UPDATE snesoip.user SET port = %i WHERE username = '%s'", port, user_esc);
-
-
-	if (mysql_query(dbCon, query) != 0) {
-		syslog(LOG_ERR, "%s", mysql_error(dbCon) );
-		return -1;
-	}
-
-
-	return 0;
-}
-
-
-int setDateMySQLQuery(char *user) {
-	char query[QueryBufferSize];
-
-	char *user_esc = (char*) malloc(strlen(user));
-	mysql_real_escape_string(dbCon, user_esc, user, strlen(user));
-
-	int cx = snprintf ( query, 128, "UPDATE snesoip.user SET auth_time = NOW() WHERE username = '%s'", user_esc);
-
-
-	if (mysql_query(dbCon, query) != 0) {
-		syslog(LOG_ERR, "%s", mysql_error(dbCon) );
-		return -1;
-	}
-
-
-	return 0;
-}
-
-
-int setIPMySQLQuery(char *user, char *ip) {
-
-	char query[QueryBufferSize];
-
-	char *user_esc = (char*) malloc(strlen(user));
-	mysql_real_escape_string(dbCon, user_esc, user, strlen(user));
-	char *ip_esc = (char*) malloc(strlen(ip));
-	mysql_real_escape_string(dbCon, ip_esc, ip, strlen(ip));
-
-	int cx = snprintf ( query, 128, "UPDATE snesoip.user SET curr_ip = '%s' WHERE username = '%s'", ip_esc, user_esc);
-
-	if (mysql_query(dbCon, query) != 0) {
-		syslog(LOG_ERR, "%s", mysql_error(dbCon) );
-		return -1;
-	}
-
-
-	return 0;
-}
-
-
-void *keepaliveMySQL(void* val) {
-	int ret=0;
-	syslog(LOG_INFO, "Step four, I can give you more");
-
-	syslog(LOG_INFO, "...starting mysql keep alive\n");
-
-	while(1){
-		//syslog(LOG_INFO, "PING");
-		ret = mysql_ping(dbCon);
-		if(ret==0){
-			//syslog(LOG_INFO, "PONG");
-		} else
-			if(ret==2006){
-				syslog(LOG_ERR, "...sqlserver is gone!");
-
-			} else
-					syslog(LOG_ERR, "...keep alive - connection error!");
-
-		sleep(60);
-	}
-	//  syslog(LOG_ERR, "...starting keep alive thread has faild\n");
-
-
-	return NULL;
-}
+const db_backend_t mysqlBackend = {
+	.name         = "mysql",
+	.init         = initMySQL,
+	.fini         = finiMySQL,
+	.connect      = connectMySQL,
+	.disconnect   = disconnectMySQL,
+	.threadStart  = threadStartMySQL,
+	.threadEnd    = threadEndMySQL,
+	.resetAll     = resetAllMySQLQuery,
+	.loadAccount  = loadAccountMySQLQuery,
+	.setAuthTimes = setAuthTimesMySQLQuery,
+	.ping         = pingMySQL,
+};
@@ -0,0 +1,383 @@
+/* presence.c -*-c-*-
+ * In-memory presence table.
+ * Author: SNESoIP contributors
+ *
+ * This program is part of the SNESoIP project and has has been released
+ * under the terms of a BSD-like license.  See the file LICENSE for
+ * details. */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include "presence.h"
+
+
+// Entries are never removed, the table holds at most one per account.
+typedef struct shard_s {
+	pthread_mutex_t lock;
+	presence_t     *bucket[PRESENCE_BUCKETS];
+} shard_t;
+
+
+static shard_t shards[PRESENCE_SHARDS];
+
+
+static unsigned int hashName(char *user) {
+	unsigned int hash = 5381;
+
+
+	while (*user)
+		hash = hash * 33 + (unsigned char)*user++;
+
+	return hash;
+}
+
+
+// Call with the shard locked.
+static presence_t *findEntry(shard_t *shard, unsigned int hash, char *user) {
+	presence_t *entry = shard->bucket[(hash / PRESENCE_SHARDS) % PRESENCE_BUCKETS];
+
+
+	while (entry && strcmp(entry->username, user) != 0)
+		entry = entry->next;
+
+	return entry;
+}
+
+
+static presence_t *lockEntry(char *user, shard_t **shard) {
+	unsigned int hash = hashName(user);
+
+
+	*shard = &shards[hash % PRESENCE_SHARDS];
+	pthread_mutex_lock(&(*shard)->lock);
+
+	return findEntry(*shard, hash, user);
+}
+
+
+void initPresence(void) {
+	int s;
+
+
+	memset(shards, 0, sizeof(shards));
+	for (s = 0; s < PRESENCE_SHARDS; s++)
+		pthread_mutex_init(&shards[s].lock, NULL);
+}
+
+
+// Call with the shard locked.
+static presence_t *insertEntry(shard_t *shard, char *user) {
+	unsigned int hash = hashName(user);
+	presence_t **bucket = &shard->bucket[(hash / PRESENCE_SHARDS) % PRESENCE_BUCKETS];
+	presence_t  *entry = (presence_t*) calloc(1, sizeof(presence_t));
+
+
+	if (entry) {
+		snprintf(entry->username, AccountNameSize, "%s", user);
+		snprintf(entry->curr_ip, sizeof(entry->curr_ip), "none");
+
+		entry->next = *bucket;
+		*bucket     = entry;
+	}
+
+	return entry;
+}
+
+
+typedef struct waiter_s {
+	presence_done_t done;
+	void           *arg;
+} waiter_t;
+
+
+// Runs on a database worker.
+static void loadDone(db_request_t *req) {
+	waiter_t   *waiter = (waiter_t*) req->arg;
+	shard_t    *shard;
+	presence_t *entry = lockEntry(req->user[0], &shard);
+	int         ret   = req->ret;
+
+
+	if (ret == 1) {
+		if (! entry)
+			entry = insertEntry(shard, req->user[0]);
+
+		if (entry) {
+			entry->account = req->account;
+			entry->loaded  = time(NULL);
+		} else {
+			ret = -1;
+		}
+	}
+
+	if (entry)
+		entry->refreshing = 0;
+	pthread_mutex_unlock(&shard->lock);
+
+	if (waiter) {
+		waiter->done(waiter->arg, ret);
+		free(waiter);
+	}
+}
+
+
+static int queueLoad(char *user, presence_done_t done, void *arg) {
+	waiter_t *waiter = NULL;
+
+
+	if (done) {
+		waiter = (waiter_t*) malloc(sizeof(waiter_t));
+		if (! waiter)
+			return -1;
+		waiter->done = done;
+		waiter->arg  = arg;
+	}
+
+	if (loadAccountQuery(user, &loadDone, waiter) != 0) {
+		free(waiter);
+		return -1;
+	}
+
+
+	return 0;
+}
+
+
+// Returns 1 if the account is cached and was loaded at fresh_since or
+// later, 0 for unknown names, PRESENCE_PENDING if a load was queued and
+// -1 if it could not be.  Entries older than ACCOUNT_TTL are still
+// returned while a refresh runs in the background.
+int presenceLookup(char *user, account_t *account, time_t fresh_since, presence_done_t done, void *arg) {
+	shard_t    *shard;
+	presence_t *entry;
+	int         refresh = 0;
+
+
+	if (user[0] == '\0' || strlen(user) >= AccountNameSize)
+		return 0;
+
+	entry = lockEntry(user, &shard);
+	if (entry && entry->loaded >= fresh_since) {
+		if (account)
+			*account = entry->account;
+
+		if (time(NULL) - entry->loaded >= ACCOUNT_TTL && ! entry->refreshing) {
+			entry->refreshing = 1;
+			refresh           = 1;
+		}
+		pthread_mutex_unlock(&shard->lock);
+
+		if (refresh && queueLoad(user, NULL, NULL) != 0) {
+			entry = lockEntry(user, &shard);
+			entry->refreshing = 0;
+			pthread_mutex_unlock(&shard->lock);
+		}
+
+		return 1;
+	}
+	pthread_mutex_unlock(&shard->lock);
+
+
+	return queueLoad(user, done, arg) == 0 ? PRESENCE_PENDING : -1;
+}
+
+
+// Same as SHA1(CONCAT_WS(':', user, pass)) in the database.  On a
+// mismatch, an account cached before since is reloaded once in case the
+// password changed.
+int presenceAuth(char *user, char *pass, int passlen, time_t since, presence_done_t done, void *arg) {
+	char      salted[AccountNameSize + 1 + PASSWORD_MAX];
+	char      hex[SHA1_HEX_SIZE];
+	account_t account;
+	int       len, ret;
+
+
+	if (passlen < 0 || passlen > PASSWORD_MAX)
+		return 0;
+
+	len = snprintf(salted, sizeof(salted), "%s:", user);
+	memcpy(salted + len, pass, passlen);
+	sha1Hex(salted, len + passlen, hex);
+
+	ret = presenceLookup(user, &account, 0, done, arg);
+	if (ret != 1)
+		return ret;
+
+	if (strcasecmp(hex, account.pwhash) == 0)
+		return 1;
+
+	ret = presenceLookup(user, &account, since, done, arg);
+	if (ret != 1)
+		return ret;
+
+
+	return strcasecmp(hex, account.pwhash) == 0;
+}
+
+
+int presenceIsOnline(char *user) {
+	shard_t    *shard;
+	presence_t *entry = lockEntry(user, &shard);
+	int         online = entry ? entry->online : 0;
+
+
+	pthread_mutex_unlock(&shard->lock);
+	return online;
+}
+
+
+int presencePortUsed(char *curr_ip, int port) {
+	presence_t *entry;
+	int         s, b, used = 0;
+
+
+	for (s = 0; s < PRESENCE_SHARDS && ! used; s++) {
+		pthread_mutex_lock(&shards[s].lock);
+		for (b = 0; b < PRESENCE_BUCKETS && ! used; b++)
+			for (entry = shards[s].bucket[b]; entry && ! used; entry = entry->next)
+				used = entry->port == port && strcmp(entry->curr_ip, curr_ip) == 0;
+		pthread_mutex_unlock(&shards[s].lock);
+	}
+
+
+	return used;
+}
+
+
+int presenceGetAddr(char *user, char *addr, int addrlen) {
+	shard_t    *shard;
+	presence_t *entry = lockEntry(user, &shard);
+
+
+	if (entry)
+		snprintf(addr, addrlen, "%s:%i", entry->curr_ip, entry->port);
+
+	pthread_mutex_unlock(&shard->lock);
+	return entry != NULL;
+}
+
+
+int presenceGetOpponent(char *user, char *opponent, int opponentlen, presence_done_t done, void *arg) {
+	account_t account;
+	int       ret;
+
+
+	opponent[0] = '\0';
+
+	ret = presenceLookup(user, &account, 0, done, arg);
+	if (ret == 1)
+		snprintf(opponent, opponentlen, "%s", account.opponent);
+
+	return ret;
+}
+
+
+void presenceSetIP(char *user, char *ip) {
+	shard_t    *shard;
+	presence_t *entry = lockEntry(user, &shard);
+
+
+	if (entry)
+		snprintf(entry->curr_ip, sizeof(entry->curr_ip), "%s", ip);
+
+	pthread_mutex_unlock(&shard->lock);
+}
+
+
+void presenceSetOnline(char *user, int port) {
+	shard_t    *shard;
+	presence_t *entry = lockEntry(user, &shard);
+
+
+	if (entry) {
+		entry->online    = 1;
+		entry->port      = port;
+		entry->auth_time = time(NULL);
+		entry->dirty     = 1;
+	}
+
+	pthread_mutex_unlock(&shard->lock);
+}
+
+
+void presenceSetOffline(char *user) {
+	shard_t    *shard;
+	presence_t *entry = lockEntry(user, &shard);
+
+
+	if (entry) {
+		entry->online = 0;
+		entry->port   = 0;
+		snprintf(entry->curr_ip, sizeof(entry->curr_ip), "none");
+	}
+
+	pthread_mutex_unlock(&shard->lock);
+}
+
+
+static void markDirty(char user[][AccountNameSize], int count) {
+	presence_t *entry;
+	shard_t    *shard;
+	int         i;
+
+
+	for (i = 0; i < count; i++) {
+		entry = lockEntry(user[i], &shard);
+		if (entry)
+			entry->dirty = 1;
+		pthread_mutex_unlock(&shard->lock);
+	}
+}
+
+
+// Runs on a database worker.
+static void writebehindDone(db_request_t *req) {
+	// Keep them for the next round.
+	if (req->ret != 0)
+		markDirty(req->user, req->count);
+}
+
+
+void *writebehindPresence(void* val) {
+	char        user[AuthTimeBatchSize][AccountNameSize];
+	time_t      auth_time[AuthTimeBatchSize];
+	presence_t *entry;
+	int         count, s, b;
+	(void)val;
+
+
+	syslog(LOG_INFO, "...starting auth_time write-behind\n");
+
+	while(1) {
+		sleep(WRITEBEHIND_INTERVAL);
+
+		do {
+			count = 0;
+
+			for (s = 0; s < PRESENCE_SHARDS && count < AuthTimeBatchSize; s++) {
+				pthread_mutex_lock(&shards[s].lock);
+				for (b = 0; b < PRESENCE_BUCKETS && count < AuthTimeBatchSize; b++)
+					for (entry = shards[s].bucket[b]; entry && count < AuthTimeBatchSize; entry = entry->next)
+						if (entry->dirty) {
+							memcpy(user[count], entry->username, AccountNameSize);
+							auth_time[count] = entry->auth_time;
+							entry->dirty     = 0;
+							count++;
+						}
+				pthread_mutex_unlock(&shards[s].lock);
+			}
+
+			if (count > 0 && setAuthTimesQuery(user, auth_time, count, &writebehindDone, NULL) != 0) {
+				markDirty(user, count);
+				break;
+			}
+		} while (count == AuthTimeBatchSize);
+	}
+
+
+	return NULL;
+}
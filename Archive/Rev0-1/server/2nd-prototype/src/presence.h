@@ -0,0 +1,74 @@
+/* presence.h -*-c-*-
+ * In-memory presence table.
+ * Author: SNESoIP contributors
+ *
+ * Who is online, from where and on which port only matters while the
+ * server runs, so it is kept here instead of in the database.  Each
+ * entry also caches the durable account data (key, opponent, password
+ * hash), so a returning player logs in without a database round trip.
+ * Nothing here waits for the database: misses are loaded by the
+ * database workers, see PRESENCE_PENDING.  The only thing written back
+ * is auth_time, batched by writebehindPresence().
+ *
+ * This program is part of the SNESoIP project and has has been released
+ * under the terms of a BSD-like license.  See the file LICENSE for
+ * details. */
+
+
+#ifndef PRESENCE_h
+#define PRESENCE_h
+
+
+#include <pthread.h>
+#include <time.h>
+#include "config.h"
+#include "sha1.h"
+
+
+typedef struct presence_s {
+	char       username[AccountNameSize];
+
+	// Durable, cached from the database.
+	account_t  account;
+	time_t     loaded;
+	int        refreshing;
+
+	// Volatile, never written to the database.
+	int        online;
+	char       curr_ip[16];
+	int        port;
+
+	// Durable, pending write-behind.
+	time_t     auth_time;
+	int        dirty;
+
+	struct presence_s *next;
+} presence_t;
+
+
+// Returned instead of waiting for the database.  done(arg, ret) is
+// called from a database worker once the account is loaded, the caller
+// then asks again.
+#define PRESENCE_PENDING -2
+
+typedef void (*presence_done_t)(void *arg, int ret);
+
+
+void *writebehindPresence(void* val);
+
+void  initPresence(void);
+
+int   presenceLookup(char *user, account_t *account, time_t fresh_since, presence_done_t done, void *arg);
+int   presenceAuth(char *user, char *pass, int passlen, time_t since, presence_done_t done, void *arg);
+int   presenceGetOpponent(char *user, char *opponent, int opponentlen, presence_done_t done, void *arg);
+
+int   presenceIsOnline(char *user);
+int   presencePortUsed(char *curr_ip, int port);
+int   presenceGetAddr(char *user, char *addr, int addrlen);
+
+void  presenceSetIP(char *user, char *ip);
+void  presenceSetOnline(char *user, int port);
+void  presenceSetOffline(char *user);
+
+
+#endif
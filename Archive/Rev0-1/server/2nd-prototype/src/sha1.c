@@ -0,0 +1,104 @@
+/* sha1.c -*-c-*-
+ * SHA-1, as used by MySQL's SHA1() for the stored passwords.
+ * Author: SNESoIP contributors
+ *
+ * This program is part of the SNESoIP project and has has been released
+ * under the terms of a BSD-like license.  See the file LICENSE for
+ * details. */
+
+
+#include <string.h>
+#include "sha1.h"
+
+
+#define ROL(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+
+
+static void sha1Block(uint32_t h[5], const uint8_t block[64]) {
+	uint32_t w[80];
+	uint32_t a, b, c, d, e, f, k, t;
+	int      i;
+
+
+	for (i = 0; i < 16; i++)
+		w[i] = ((uint32_t)block[i * 4]     << 24) | ((uint32_t)block[i * 4 + 1] << 16) |
+		       ((uint32_t)block[i * 4 + 2] <<  8) |  (uint32_t)block[i * 4 + 3];
+
+	for (i = 16; i < 80; i++)
+		w[i] = ROL(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+
+	a = h[0]; b = h[1]; c = h[2]; d = h[3]; e = h[4];
+
+	for (i = 0; i < 80; i++) {
+		if (i < 20) {
+			f = (b & c) | (~b & d);
+			k = 0x5a827999;
+		} else if (i < 40) {
+			f = b ^ c ^ d;
+			k = 0x6ed9eba1;
+		} else if (i < 60) {
+			f = (b & c) | (b & d) | (c & d);
+			k = 0x8f1bbcdc;
+		} else {
+			f = b ^ c ^ d;
+			k = 0xca62c1d6;
+		}
+
+		t = ROL(a, 5) + f + e + k + w[i];
+		e = d;
+		d = c;
+		c = ROL(b, 30);
+		b = a;
+		a = t;
+	}
+
+	h[0] += a; h[1] += b; h[2] += c; h[3] += d; h[4] += e;
+}
+
+
+void sha1(const void *data, size_t len, uint8_t digest[SHA1_DIGEST_SIZE]) {
+	const uint8_t *p    = data;
+	uint32_t       h[5] = { 0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0 };
+	uint8_t        block[64];
+	uint64_t       bits = (uint64_t)len * 8;
+	size_t         rest;
+	int            i;
+
+
+	for (; len >= 64; len -= 64, p += 64)
+		sha1Block(h, p);
+
+	// Padding: 0x80, zeros, then the message length in bits.
+	rest = len;
+	memset(block, 0, sizeof(block));
+	memcpy(block, p, rest);
+	block[rest] = 0x80;
+
+	if (rest >= 56) {
+		sha1Block(h, block);
+		memset(block, 0, sizeof(block));
+	}
+
+	for (i = 0; i < 8; i++)
+		block[63 - i] = (uint8_t)(bits >> (i * 8));
+	sha1Block(h, block);
+
+	for (i = 0; i < SHA1_DIGEST_SIZE; i++)
+		digest[i] = (uint8_t)(h[i / 4] >> (24 - (i % 4) * 8));
+}
+
+
+void sha1Hex(const void *data, size_t len, char hex[SHA1_HEX_SIZE]) {
+	static const char digits[] = "0123456789abcdef";
+	uint8_t           digest[SHA1_DIGEST_SIZE];
+	int               i;
+
+
+	sha1(data, len, digest);
+
+	for (i = 0; i < SHA1_DIGEST_SIZE; i++) {
+		hex[i * 2]     = digits[digest[i] >> 4];
+		hex[i * 2 + 1] = digits[digest[i] & 0x0f];
+	}
+	hex[SHA1_HEX_SIZE - 1] = '\0';
+}
@@ -0,0 +1,26 @@
+/* sha1.h -*-c-*-
+ * SHA-1, as used by MySQL's SHA1() for the stored passwords.
+ * Author: SNESoIP contributors
+ *
+ * This program is part of the SNESoIP project and has has been released
+ * under the terms of a BSD-like license.  See the file LICENSE for
+ * details. */
+
+
+#ifndef SHA1_h
+#define SHA1_h
+
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+#define SHA1_DIGEST_SIZE 20
+#define SHA1_HEX_SIZE    41 // 40 hex digits + '\0'.
+
+
+void sha1(const void *data, size_t len, uint8_t digest[SHA1_DIGEST_SIZE]);
+void sha1Hex(const void *data, size_t len, char hex[SHA1_HEX_SIZE]);
+
+
+#endif
@@ -0,0 +1,220 @@
+/* sqlite.c -*-c-*-
+ * Embedded SQLite storage backend.
+ * Author: SNESoIP contributors
+ *
+ * This program is part of the SNESoIP project and has has been released
+ * under the terms of a BSD-like license.  See the file LICENSE for
+ * details. */
+
+
+#include <sqlite3.h>
+#include <string.h>
+#include "sqlite.h"
+
+
+// Same columns as snesoip.user in MySQL, auth_time in Unix time.
+#define SQLiteSchema \
+	"CREATE TABLE IF NOT EXISTS user (" \
+	" userid        INTEGER PRIMARY KEY," \
+	" username      TEXT NOT NULL UNIQUE," \
+	" password      TEXT," \
+	" `key`         TEXT," \
+	" dest_username TEXT," \
+	" online        INTEGER NOT NULL DEFAULT 0," \
+	" curr_ip       TEXT NOT NULL DEFAULT 'none'," \
+	" port          INTEGER NOT NULL DEFAULT 0," \
+	" auth_time     INTEGER)"
+
+
+// Each worker owns its connection and its prepared statements.
+typedef struct sqlite_con_s {
+	sqlite3      *db;
+	sqlite3_stmt *load;
+	sqlite3_stmt *auth_time;
+} sqlite_con_t;
+
+
+static const char *file = SQLiteDefaultFile;
+
+
+static int execSQLite(sqlite3 *db, const char *sql) {
+	char *error = NULL;
+
+
+	if (sqlite3_exec(db, sql, NULL, NULL, &error) != SQLITE_OK) {
+		syslog(LOG_ERR, "... %s\n", error ? error : sqlite3_errmsg(db) );
+		sqlite3_free(error);
+		return -1;
+	}
+
+
+	return 0;
+}
+
+
+static int initSQLite(void) {
+	sqlite3 *db;
+	int      ret;
+
+
+	// Optional.
+	confString("sqlite", &file);
+
+	if (sqlite3_open(file, &db) != SQLITE_OK) {
+		syslog(LOG_ERR, "... %s: %s\n", file, sqlite3_errmsg(db) );
+		sqlite3_close(db);
+		return -1;
+	}
+
+	// WAL mode is stored in the file, the workers open it afterwards.
+	sqlite3_busy_timeout(db, SQLiteBusyTimeout);
+	ret = execSQLite(db, "PRAGMA journal_mode = WAL") || execSQLite(db, SQLiteSchema) ? -1 : 0;
+	sqlite3_close(db);
+
+
+	return ret;
+}
+
+
+static void finiSQLite(void) { }
+
+
+static void disconnectSQLite(void *val) {
+	sqlite_con_t *worker = (sqlite_con_t*) val;
+
+
+	sqlite3_finalize(worker->load);
+	sqlite3_finalize(worker->auth_time);
+	sqlite3_close(worker->db);
+	free(worker);
+}
+
+
+static void *connectSQLite(void) {
+	sqlite_con_t *worker = (sqlite_con_t*) calloc(1, sizeof(sqlite_con_t));
+	char          pragma[64];
+
+
+	if (! worker) {
+		syslog(LOG_ERR, "... out of memory\n");
+		return NULL;
+	}
+
+	// A connection is only used by its worker.
+	if (sqlite3_open_v2(file, &worker->db, SQLITE_OPEN_READWRITE | SQLITE_OPEN_NOMUTEX, NULL) != SQLITE_OK) {
+		syslog(LOG_ERR, "... %s: %s\n", file, sqlite3_errmsg(worker->db) );
+		disconnectSQLite(worker);
+		return NULL;
+	}
+
+	sqlite3_busy_timeout(worker->db, SQLiteBusyTimeout);
+	snprintf(pragma, sizeof(pragma), "PRAGMA cache_size = %d", SQLiteCacheSize);
+
+	if (execSQLite(worker->db, "PRAGMA synchronous = NORMAL") != 0 ||
+	    execSQLite(worker->db, pragma) != 0) {
+		disconnectSQLite(worker);
+		return NULL;
+	}
+
+	if (sqlite3_prepare_v2(worker->db,
+			"SELECT userid, `key`, dest_username, password FROM user WHERE username = ?",
+			-1, &worker->load, NULL) != SQLITE_OK ||
+	    sqlite3_prepare_v2(worker->db,
+			"UPDATE user SET auth_time = ? WHERE username = ?",
+			-1, &worker->auth_time, NULL) != SQLITE_OK) {
+
+		syslog(LOG_ERR, "... %s\n", sqlite3_errmsg(worker->db) );
+		disconnectSQLite(worker);
+		return NULL;
+	}
+
+
+	return worker;
+}
+
+
+static int resetAllSQLiteQuery(void *val) {
+	sqlite_con_t *worker = (sqlite_con_t*) val;
+
+
+	return execSQLite(worker->db, "UPDATE user SET online = 0, curr_ip = 'none', port = 0");
+}
+
+
+static void copyColumn(sqlite3_stmt *stmt, int col, char *dest, size_t size) {
+	const unsigned char *text = sqlite3_column_text(stmt, col);
+
+
+	snprintf(dest, size, "%s", text ? (const char *) text : "");
+}
+
+
+static int loadAccountSQLiteQuery(void *val, char *user, account_t *account) {
+	sqlite_con_t *worker = (sqlite_con_t*) val;
+	sqlite3_stmt *stmt   = worker->load;
+	int           ret;
+
+
+	memset(account, 0, sizeof(account_t));
+	sqlite3_bind_text(stmt, 1, user, -1, SQLITE_STATIC);
+
+	ret = sqlite3_step(stmt);
+	if (ret == SQLITE_ROW) {
+		account->userid = sqlite3_column_int(stmt, 0);
+		copyColumn(stmt, 1, account->key,      sizeof(account->key));
+		copyColumn(stmt, 2, account->opponent, sizeof(account->opponent));
+		copyColumn(stmt, 3, account->pwhash,   sizeof(account->pwhash));
+		ret = 1;
+	} else if (ret == SQLITE_DONE) {
+		ret = 0;
+	} else {
+		syslog(LOG_ERR, "%s", sqlite3_errmsg(worker->db) );
+		ret = -1;
+	}
+
+	sqlite3_reset(stmt);
+	sqlite3_clear_bindings(stmt);
+
+
+	return ret;
+}
+
+
+static int setAuthTimesSQLiteQuery(void *val, char users[][AccountNameSize], time_t *auth_times, int count) {
+	sqlite_con_t *worker = (sqlite_con_t*) val;
+	sqlite3_stmt *stmt   = worker->auth_time;
+	int           i;
+
+
+	if (execSQLite(worker->db, "BEGIN") != 0)
+		return -1;
+
+	for (i = 0; i < count; i++) {
+		sqlite3_bind_int64(stmt, 1, auth_times[i]);
+		sqlite3_bind_text(stmt, 2, users[i], -1, SQLITE_STATIC);
+
+		if (sqlite3_step(stmt) != SQLITE_DONE) {
+			syslog(LOG_ERR, "%s", sqlite3_errmsg(worker->db) );
+			sqlite3_reset(stmt);
+			execSQLite(worker->db, "ROLLBACK");
+			return -1;
+		}
+		sqlite3_reset(stmt);
+	}
+	sqlite3_clear_bindings(stmt);
+
+
+	return execSQLite(worker->db, "COMMIT");
+}
+
+
+const db_backend_t sqliteBackend = {
+	.name         = "sqlite",
+	.init         = initSQLite,
+	.fini         = finiSQLite,
+	.connect      = connectSQLite,
+	.disconnect   = disconnectSQLite,
+	.resetAll     = resetAllSQLiteQuery,
+	.loadAccount  = loadAccountSQLiteQuery,
+	.setAuthTimes = setAuthTimesSQLiteQuery,
+};
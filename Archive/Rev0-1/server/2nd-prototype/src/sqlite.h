@@ -0,0 +1,30 @@
+/* sqlite.h -*-c-*-
+ * Embedded SQLite storage backend.
+ * Author: SNESoIP contributors
+ *
+ * Settings: sqlite, the database file (default snesoip.db).  The user
+ * table is created if it does not exist, the database runs in WAL mode
+ * so the workers read while the write-behind commits.  No server and
+ * no network, for small deployments and for testing.
+ *
+ * This program is part of the SNESoIP project and has has been released
+ * under the terms of a BSD-like license.  See the file LICENSE for
+ * details. */
+
+
+#ifndef SQLITE_h
+#define SQLITE_h
+
+
+#include "db.h"
+
+
+#define SQLiteDefaultFile "snesoip.db"
+#define SQLiteBusyTimeout 5000 // ms to wait for a lock held by another worker.
+#define SQLiteCacheSize   2048 // Pages per connection.
+
+
+extern const db_backend_t sqliteBackend;
+
+
+#endif
@@ -31,7 +31,7 @@ int init_tcp(int port) {
   ret = bind(listen_fd, (struct sockaddr *) &sock, sizeof(sock));
   exit_if(ret != 0);
 
-  ret = listen(listen_fd, 5);
+  ret = listen(listen_fd, MAXFD);
   exit_if(ret < 0);
 
   return listen_fd;
@@ -42,11 +42,15 @@ int tcp_fw(int listen_fd) {
   int fd;
   struct sockaddr_in sock;
   socklen_t socklen;
+  int yes = 1;
 
   socklen = sizeof(sock);
   fd = accept(listen_fd, (struct sockaddr *) &sock, &socklen);
   return_if(fd < 0, -1);
 
+  // Answers are written in pieces, don't hold them back.
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(int));
+
   return fd;
 }
 
@@ -60,6 +64,72 @@ int write_tcp(int fd, char buf[], int buflen) {
 }
 
 
+// Commands never wait for a database query.  If an account is not
+// cached, the command is parked until a database worker has loaded it
+// and then run again from the start.
+typedef struct session_s {
+	pthread_mutex_t lock;
+	pthread_cond_t  cond;
+	int             pending;
+	int             completed;
+	time_t          since;                    // When the command arrived.
+	char            fetched[AccountNameSize]; // Last account loaded for it
+	int             fetched_ret;              // and the result.
+} session_t;
+
+
+// Runs on a database worker.
+static void sessionDone(void *arg, int ret) {
+	session_t *session = (session_t*) arg;
+
+
+	pthread_mutex_lock(&session->lock);
+	session->fetched_ret = ret;
+	session->completed   = 1;
+	pthread_cond_signal(&session->cond);
+	pthread_mutex_unlock(&session->lock);
+}
+
+
+static int parkIfPending(session_t *session, char *user, int ret) {
+	if (ret == PRESENCE_PENDING) {
+		snprintf(session->fetched, AccountNameSize, "%s", user);
+		session->pending = 1;
+	}
+
+	return ret;
+}
+
+
+// A name that was loaded and not found is not queued again.
+static int lookupAccount(session_t *session, char *user, account_t *account) {
+	if (session->fetched_ret != 1 && strcmp(session->fetched, user) == 0)
+		return session->fetched_ret;
+
+	return parkIfPending(session, user,
+		presenceLookup(user, account, 0, &sessionDone, session));
+}
+
+
+static int authAccount(session_t *session, char *user, char *pass, int passlen) {
+	if (session->fetched_ret != 1 && strcmp(session->fetched, user) == 0)
+		return session->fetched_ret;
+
+	return parkIfPending(session, user,
+		presenceAuth(user, pass, passlen, session->since, &sessionDone, session));
+}
+
+
+static int opponentOf(session_t *session, char *user, char *opponent, int opponentlen) {
+	opponent[0] = '\0';
+	if (session->fetched_ret != 1 && strcmp(session->fetched, user) == 0)
+		return session->fetched_ret;
+
+	return parkIfPending(session, user,
+		presenceGetOpponent(user, opponent, opponentlen, &sessionDone, session));
+}
+
+
 void *tcp_server_read(void *arg) {
   long rfd;
   char buf[MAXLEN];
@@ -69,6 +139,11 @@ void *tcp_server_read(void *arg) {
   char username[32];
   char curr_ip[16];
   char session_string[11];
+  account_t account;
+
+  session_t session;
+  char command[MAXLEN];
+  int  commandlen=0;
 
   char user_set=0;
   char greet_set=0;
@@ -78,10 +153,36 @@ void *tcp_server_read(void *arg) {
   int brutforce_counter=0;
 
   rfd = (long)arg;
+
+  memset(&session, 0, sizeof(session));
+  pthread_mutex_init(&session.lock, NULL);
+  pthread_cond_init(&session.cond, NULL);
+
   for(;;) {
 
 
-    buflen = read(rfd, buf, sizeof(buf));
+    if (session.pending) {
+      // The client waits for the answer, so there is nothing to read.
+      pthread_mutex_lock(&session.lock);
+      while (! session.completed)
+        pthread_cond_wait(&session.cond, &session.lock);
+      session.completed = 0;
+      pthread_mutex_unlock(&session.lock);
+
+      session.pending = 0;
+      memcpy(buf, command, commandlen);
+      buflen = commandlen;
+    } else {
+      buflen = read(rfd, buf, sizeof(buf) - 1);
+
+      if (buflen > 0) {
+        memcpy(command, buf, buflen);
+        commandlen          = buflen;
+        session.since       = time(NULL);
+        session.fetched[0]  = '\0';
+        session.fetched_ret = 1;
+      }
+    }
 
 
     if (buflen <= 0 || brutforce_counter==5) {
@@ -91,11 +192,8 @@ void *tcp_server_read(void *arg) {
       	if (DEBUG)
 		 syslog(LOG_INFO, "t_server: client dead        [%d]\n", rfd);
 
-      		if(user_set){
-				int ret = setOnlineMySQLQuery(username, 0);
-				int ipr = setIPMySQLQuery(username, "none");
-				int rep = setPortMySQLQuery(username, 0);
-			}
+      		if(user_set)
+				presenceSetOffline(username);
 
       pthread_mutex_unlock(&m_state);
       close(rfd);
@@ -116,7 +214,9 @@ void *tcp_server_read(void *arg) {
 					 if(!user_set) {
 
 						snprintf ( username, 32, "%s", buf+5);
-						exist = userMySQLQuery( username );
+						exist = lookupAccount( &session, username, &account );
+						if (exist == PRESENCE_PENDING)
+							continue;
 						}
 
 						if (DEBUG) {
@@ -132,7 +232,7 @@ void *tcp_server_read(void *arg) {
 							if(exist!=0){
 
 									int online;
-									online = isPlayerOnlineMySQLQuery(username);
+									online = presenceIsOnline(username);
 
 									if(online!=1){
 
@@ -215,9 +315,9 @@ void *tcp_server_read(void *arg) {
 							}
 
 
-							//key from db
+							//key from the account cache
 							char key[11];
-							snprintf(key, 11, getClientKeyMySQLQuery(username));
+							snprintf(key, 11, "%s", account.key);
 
 							if (DEBUG) {
 							 syslog(LOG_INFO, "t_server: trivium_init_iv    [%s]\n", session_string);
@@ -228,21 +328,31 @@ void *tcp_server_read(void *arg) {
 							 syslog(LOG_INFO, "t_server: password_length    [%d]\n", strlen(passwd_hex)/2);
 							}
 
-							trivium_ctx_t ctx;
+							int g=0;
+							trivium64_ctx_t ctx;
+							uint64_t ks[TRIVIUM64_WORDS(1 + PASSWORD_MAX * 8)];
+							uint8_t keystream[PASSWORD_MAX];
 
-							trivium_init(key, 80, session_string, 80, &ctx);
-							trivium_enc(&ctx);
+							trivium64_init(key, session_string, &ctx);
+							for(g=0; g<TRIVIUM64_WORDS(1 + PASSWORD_MAX * 8);g++)
+							ks[g] = trivium64_next(&ctx);
+
+							//the client drops the first keystream bit
+							trivium64_bytes(ks, 1, keystream, real_length);
 
-							int g=0;
 							char passwd_[real_length];
 
 							for(g=0; g<real_length;g++)
-							passwd_[g] = passwd[g] ^ trivium_getbyte(&ctx);
+							passwd_[g] = passwd[g] ^ keystream[g];
 
 							if (DEBUG)
 							syslog(LOG_INFO, "t_server: password_plain     [%s]\n", passwd_);
 
-							int auth = authMySQLQuery(username, passwd_);
+							int auth = authAccount(&session, username, passwd_, real_length);
+							free(passwd);
+
+							if (auth == PRESENCE_PENDING)
+								continue;
 
 							if(auth==-1){
 										char err[10]; snprintf(err, 11, "ERROR %d\n", PASSWORD_ERROR);
@@ -258,7 +368,7 @@ void *tcp_server_read(void *arg) {
 									auth_set=1;
 
 									//set_ip
-									setIPMySQLQuery(username, curr_ip);
+									presenceSetIP(username, curr_ip);
 
 									write_tcp(rfd, "OK\n", 3);
 									} else {
@@ -296,6 +406,14 @@ void *tcp_server_read(void *arg) {
 			if (DEBUG)
 			syslog(LOG_INFO, "t_server: port cmd           [rec]\n");
 
+			// Both accounts are needed before anything is changed.
+			char dest_user[32];
+			char dest_user_reverse[32];
+
+			if (opponentOf(&session, username, dest_user, 32) == PRESENCE_PENDING ||
+			    opponentOf(&session, dest_user, dest_user_reverse, 32) == PRESENCE_PENDING)
+				continue;
+
 			int port_set=0;
 
 			buf[buflen]='\0';
@@ -315,30 +433,20 @@ void *tcp_server_read(void *arg) {
 
 					if(port<=65535 && port>=10){ //max port 16bit
 
-						int uid = freePortMySQLQuery(curr_ip, port);
+						int uid = presencePortUsed(curr_ip, port);
 
 							if(uid==0){
-								int ret = setPortMySQLQuery(username, port);
 								port_set=1; //port set
 
 								if (DEBUG)
 								syslog(LOG_INFO, "t_server: port	           [%d]\n",port);
 
-								int reo = setOnlineMySQLQuery(username, 1);
-								int red = setDateMySQLQuery(username);
-
-								char dest_user[32];
-								snprintf(dest_user, 32, getOpponentMySQLQuery(username));
-
-
-								char dest_user_reverse[32];
+								presenceSetOnline(username, port);
 
 								//if(DEBUG)
 								//syslog(LOG_WARNING, "dbg: dest_player:%s",dest_user);
 								int hosted_game=0;
 
-								snprintf(dest_user_reverse, 32, getOpponentMySQLQuery(dest_user));
-
 								if(strcmp("gameserver", dest_user_reverse) == 0)
 								hosted_game=1;
 
@@ -357,11 +465,8 @@ void *tcp_server_read(void *arg) {
 								write_tcp(rfd, err, 10);
 
 									// Cleanup.
-									if(user_set){
-										int ret = setOnlineMySQLQuery(username, 0);
-										int ipr = setIPMySQLQuery(username, "none");
-										int rep = setPortMySQLQuery(username, 0);
-									}
+									if(user_set)
+										presenceSetOffline(username);
 
 								  pthread_mutex_lock(&m_state);
 								  FD_CLR(rfd, &the_state);
@@ -373,7 +478,7 @@ void *tcp_server_read(void *arg) {
 
 
 									int online;
-									online = isPlayerOnlineMySQLQuery(dest_user);
+									online = presenceIsOnline(dest_user);
 
 									//if (DEBUG)
 									//syslog(LOG_WARNING, "dbg: isOnline:%d",online);
@@ -387,7 +492,7 @@ void *tcp_server_read(void *arg) {
 										if(online==1){
 										write_tcp(rfd, "SLAVE\n", 6);
 										char dest_addr[32];
-										snprintf(dest_addr, 32, getDestAddrMySQLQuery(dest_user));
+										presenceGetAddr(dest_user, dest_addr, 32);
 
 										if (DEBUG)
 										syslog(LOG_INFO, "t_server: mode               [slave]\n");
@@ -475,11 +580,8 @@ void *tcp_server_read(void *arg) {
 		// Quit: End of TCP Connection.
 		if(buf[0]=='Q' && buf[1]=='U' && buf[2]=='I' && buf[3]=='T' ){
 
-			if(user_set){
-				int ret = setOnlineMySQLQuery(username, 0);
-				int ipr = setIPMySQLQuery(username, "none");
-				int rep = setPortMySQLQuery(username, 0);
-			}
+			if(user_set)
+				presenceSetOffline(username);
 
 		  pthread_mutex_lock(&m_state);
 		  FD_CLR(rfd, &the_state);
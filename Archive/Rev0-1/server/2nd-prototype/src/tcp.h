@@ -13,9 +13,11 @@
 
 
 #include <errno.h>
+#include <netinet/tcp.h>
 #include <pthread.h>
 #include "config.h"
-#include "trivium.h"
+#include "presence.h"
+#include "trivium64.h"
 
 
 
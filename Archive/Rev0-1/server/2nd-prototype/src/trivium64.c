@@ -0,0 +1,169 @@
+/* trivium64.c -*-c-*-
+ * Trivium on 64 bit words, one session per context or up to 64
+ * bitsliced sessions per batch.
+ * Author: SNESoIP contributors
+ *
+ * Each shift register is kept as the sequence of bits it was fed, the
+ * newest last: bit i of the 128 bit value c[1]:c[0] was fed 127 - i
+ * steps ago.  A bit is read at the earliest 66 steps after it was fed,
+ * so 64 steps can be computed at once, one per bit of a word.
+ *
+ * The batch keeps one word per state bit instead, bit l of every word
+ * belongs to session l.  Each step costs the same as one step of a
+ * single session, for all 64 sessions.
+ *
+ * This program is part of the SNESoIP project and has been released
+ * under the terms of a BSD-like license.  See the file LICENSE for
+ * details. */
+
+
+#include <string.h>
+#include "trivium64.h"
+
+
+#define INIT_STEPS (4 * 288)
+
+// The 64 values of bit d steps back, for the next 64 steps.
+#define TAP(r, d) (((r)[0] >> (127 - (d))) | ((r)[1] << ((d) - 63)))
+
+// The bit d steps back in a batch, at step j of a block.
+#define BIT(r, d) ((r)[127 + j - (d)])
+
+
+// 80 bits as trivium_init() reads them: s1 is the top bit of the last
+// byte, so the bytes are fed last to first and each byte top bit first.
+static void load(const uint8_t *src, uint64_t r[2]) {
+	r[1] = ((uint64_t)src[9] << 56) | ((uint64_t)src[8] << 48) |
+	       ((uint64_t)src[7] << 40) | ((uint64_t)src[6] << 32) |
+	       ((uint64_t)src[5] << 24) | ((uint64_t)src[4] << 16) |
+	       ((uint64_t)src[3] <<  8) |  (uint64_t)src[2];
+	r[0] = ((uint64_t)src[1] << 56) | ((uint64_t)src[0] << 48);
+}
+
+
+void trivium64_init(const void *key, const void *iv, trivium64_ctx_t *ctx) {
+	int i;
+
+
+	load(key, ctx->a);
+	load(iv,  ctx->b);
+	ctx->c[1] = 0;
+	ctx->c[0] = (uint64_t)7 << 17; // s286 to s288.
+
+	for (i = 0; i < INIT_STEPS / 64; i++)
+		trivium64_next(ctx);
+}
+
+
+uint64_t trivium64_next(trivium64_ctx_t *ctx) {
+	uint64_t t1, t2, t3, z;
+
+
+	t1 = TAP(ctx->a, 65) ^ TAP(ctx->a,  92);
+	t2 = TAP(ctx->b, 68) ^ TAP(ctx->b,  83);
+	t3 = TAP(ctx->c, 65) ^ TAP(ctx->c, 110);
+	z  = t1 ^ t2 ^ t3;
+
+	t1 ^= (TAP(ctx->a,  90) & TAP(ctx->a,  91)) ^ TAP(ctx->b, 77);
+	t2 ^= (TAP(ctx->b,  81) & TAP(ctx->b,  82)) ^ TAP(ctx->c, 86);
+	t3 ^= (TAP(ctx->c, 108) & TAP(ctx->c, 109)) ^ TAP(ctx->a, 68);
+
+	ctx->a[0] = ctx->a[1]; ctx->a[1] = t3;
+	ctx->b[0] = ctx->b[1]; ctx->b[1] = t1;
+	ctx->c[0] = ctx->c[1]; ctx->c[1] = t2;
+
+	return z;
+}
+
+
+// Afterwards bit j of m[i] is bit i of m[j] before.
+static void transpose(uint64_t m[64]) {
+	uint64_t mask = 0x00000000ffffffffULL, t;
+	int      j, k;
+
+
+	for (j = 32; j != 0; j >>= 1, mask ^= mask << j)
+		for (k = 0; k < 64; k = ((k | j) + 1) & ~j) {
+			t = ((m[k] >> j) ^ m[k | j]) & mask;
+			m[k]     ^= t << j;
+			m[k | j] ^= t;
+		}
+}
+
+
+// Bit i of the word layout is the bit fed 127 - i steps before step 0.
+static void loadBatch(int n, const uint8_t *src[], uint64_t reg[128]) {
+	uint64_t m[64], r[2];
+	int      half, l;
+
+
+	for (half = 0; half < 2; half++) {
+		memset(m, 0, sizeof(m));
+		for (l = 0; l < n; l++) {
+			load(src[l], r);
+			m[l] = r[half];
+		}
+
+		transpose(m);
+		memcpy(reg + half * 64, m, sizeof(m));
+	}
+}
+
+
+// ks[l * words + w] is the w-th trivium64_next() of session l < n.
+void trivium64_batch(int n, const uint8_t *key[], const uint8_t *iv[], uint64_t *ks, int words) {
+	// The last 128 bits fed and room for 64 more, oldest first.
+	uint64_t a[192], b[192], c[192], z[64];
+	uint64_t t1, t2, t3;
+	int      block, j, l;
+
+
+	loadBatch(n, key, a);
+	loadBatch(n, iv,  b);
+	memset(c, 0, sizeof(c));
+	c[17] = c[18] = c[19] = ~(uint64_t)0;
+
+	for (block = 0; block < INIT_STEPS / 64 + words; block++) {
+		for (j = 0; j < 64; j++) {
+			t1 = BIT(a, 65) ^ BIT(a,  92);
+			t2 = BIT(b, 68) ^ BIT(b,  83);
+			t3 = BIT(c, 65) ^ BIT(c, 110);
+			z[j] = t1 ^ t2 ^ t3;
+
+			t1 ^= (BIT(a,  90) & BIT(a,  91)) ^ BIT(b, 77);
+			t2 ^= (BIT(b,  81) & BIT(b,  82)) ^ BIT(c, 86);
+			t3 ^= (BIT(c, 108) & BIT(c, 109)) ^ BIT(a, 68);
+
+			a[128 + j] = t3;
+			b[128 + j] = t1;
+			c[128 + j] = t2;
+		}
+
+		memmove(a, a + 64, 128 * sizeof(uint64_t));
+		memmove(b, b + 64, 128 * sizeof(uint64_t));
+		memmove(c, c + 64, 128 * sizeof(uint64_t));
+
+		if (block >= INIT_STEPS / 64) {
+			transpose(z);
+			for (l = 0; l < n; l++)
+				ks[l * words + block - INIT_STEPS / 64] = z[l];
+		}
+	}
+}
+
+
+// len bytes of keystream, starting skip bits in.
+void trivium64_bytes(const uint64_t *ks, int skip, uint8_t *out, int len) {
+	uint64_t v;
+	int      i, bit, s;
+
+
+	for (i = 0; i < len; i++) {
+		bit = skip + i * 8;
+		s   = bit & 63;
+		v   = ks[bit / 64] >> s;
+		if (s > 56)
+			v |= ks[bit / 64 + 1] << (64 - s);
+		out[i] = (uint8_t) v;
+	}
+}
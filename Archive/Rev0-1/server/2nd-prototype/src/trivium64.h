@@ -0,0 +1,44 @@
+/* trivium64.h -*-c-*-
+ * Trivium on 64 bit words, one session per context or up to 64
+ * bitsliced sessions per batch.
+ * Author: SNESoIP contributors
+ *
+ * Keys and IVs are 80 bits and read like trivium_init() does, so the
+ * keystream is the same as the one of trivium.c, and the same as the
+ * eSTREAM test vectors: bit 0 of a keystream word comes out first, byte
+ * k of the keystream are bits 8k to 8k+7.
+ *
+ * This program is part of the SNESoIP project and has been released
+ * under the terms of a BSD-like license.  See the file LICENSE for
+ * details. */
+
+
+#ifndef TRIVIUM64_h
+#define TRIVIUM64_h
+
+
+#include <stdint.h>
+
+
+#define TRIVIUM64_KEY_SIZE 10 // Bytes, also the IV size.
+#define TRIVIUM64_LANES    64 // Sessions per batch.
+
+// Keystream words needed for bits bits.
+#define TRIVIUM64_WORDS(bits) (((bits) + 63) / 64)
+
+
+// The three shift registers, the newest bits in [1].
+typedef struct trivium64_ctx_s {
+	uint64_t a[2], b[2], c[2];
+} trivium64_ctx_t;
+
+
+void     trivium64_init(const void *key, const void *iv, trivium64_ctx_t *ctx);
+uint64_t trivium64_next(trivium64_ctx_t *ctx);
+
+void     trivium64_batch(int n, const uint8_t *key[], const uint8_t *iv[], uint64_t *ks, int words);
+
+void     trivium64_bytes(const uint64_t *ks, int skip, uint8_t *out, int len);
+
+
+#endif
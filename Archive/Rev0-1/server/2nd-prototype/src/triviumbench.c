@@ -0,0 +1,260 @@
+/* triviumbench.c -*-c-*-
+ * Trivium test vectors and benchmark.
+ * Author: SNESoIP contributors
+ *
+ * Checks trivium.c, trivium64_next() and trivium64_batch() against
+ * eSTREAM test vectors and against each other, then times the keystream
+ * of a login (init, one bit dropped, PASSWORD_MAX bytes) with each.
+ *
+ *   triviumbench [-n logins]
+ *
+ * This program is part of the SNESoIP project and has been released
+ * under the terms of a BSD-like license.  See the file LICENSE for
+ * details. */
+
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "trivium.h"
+#include "trivium64.h"
+
+
+#define PASSWORD_MAX 30 // As in config.h.
+#define LOGIN_WORDS  TRIVIUM64_WORDS(1 + PASSWORD_MAX * 8)
+#define VECTOR_SIZE  64
+
+
+typedef struct vector_s {
+	const char *name;
+	const char *key;
+	const char *iv;
+	const char *stream; // stream[0..63]
+} vector_t;
+
+
+// From the eSTREAM verified test vectors for Trivium, 80 bit IV.
+static const vector_t vectors[] = {
+	{ "Set 1, vector# 0",
+	  "80000000000000000000", "00000000000000000000",
+	  "38EB86FF730D7A9CAF8DF13A4420540DBB7B651464C87501552041C249F29A64"
+	  "D2FBF515610921EBE06C8F92CECF7F8098FF20CCCC6A62B97BE8EF7454FC80F9" },
+	{ "Set 2, vector# 0",
+	  "00000000000000000000", "00000000000000000000",
+	  "FBE0BF265859051B517A2E4E239FC97F563203161907CF2DE7A8790FA1B2E9CD"
+	  "F75292030268B7382B4C1A759AA2599A285549986E74805903801A4CB5A5D4F2" },
+	{ "Set 6, vector# 0",
+	  "0053A6F94C9FF24598EB", "0D74DB42A91077DE45AC",
+	  "F4CD954A717F26A7D6930830C4E7CF0819F80E03F25F342C64ADC66ABA7F8A8E"
+	  "6EAA49F23632AE3CD41A7BD290A0132F81C6D4043B6E397D7388F3A03B5FE358" },
+};
+
+
+static double now(void) {
+	struct timespec ts;
+
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+static void fromHex(const char *hex, uint8_t *out, int len) {
+	int i;
+
+
+	for (i = 0; i < len; i++)
+		sscanf(hex + i * 2, "%2hhx", &out[i]);
+}
+
+
+static int check(const char *what, const vector_t *v, const uint8_t *stream) {
+	uint8_t expected[VECTOR_SIZE];
+
+
+	fromHex(v->stream, expected, VECTOR_SIZE);
+	if (memcmp(stream, expected, VECTOR_SIZE) == 0)
+		return 1;
+
+	printf("%s: %s failed\n", v->name, what);
+	return 0;
+}
+
+
+static int checkVectors(void) {
+	uint8_t          key[TRIVIUM64_KEY_SIZE], iv[TRIVIUM64_KEY_SIZE];
+	uint8_t          stream[VECTOR_SIZE];
+	uint64_t         ks[VECTOR_SIZE / 8];
+	const uint8_t   *keys[1], *ivs[1];
+	trivium_ctx_t    ctx;
+	trivium64_ctx_t  ctx64;
+	size_t           v;
+	int              i, ok = 1;
+
+
+	for (v = 0; v < sizeof(vectors) / sizeof(vectors[0]); v++) {
+		fromHex(vectors[v].key, key, sizeof(key));
+		fromHex(vectors[v].iv,  iv,  sizeof(iv));
+
+		trivium_init(key, 80, iv, 80, &ctx);
+		for (i = 0; i < VECTOR_SIZE; i++)
+			stream[i] = trivium_getbyte(&ctx);
+		ok &= check("trivium.c", &vectors[v], stream);
+
+		trivium64_init(key, iv, &ctx64);
+		for (i = 0; i < VECTOR_SIZE / 8; i++)
+			ks[i] = trivium64_next(&ctx64);
+		trivium64_bytes(ks, 0, stream, VECTOR_SIZE);
+		ok &= check("trivium64_next", &vectors[v], stream);
+
+		keys[0] = key;
+		ivs[0]  = iv;
+		trivium64_batch(1, keys, ivs, ks, VECTOR_SIZE / 8);
+		trivium64_bytes(ks, 0, stream, VECTOR_SIZE);
+		ok &= check("trivium64_batch", &vectors[v], stream);
+	}
+
+	return ok;
+}
+
+
+// Random keys and IVs in all lanes, each must give the login keystream of trivium.c.
+static int checkLanes(void) {
+	uint8_t          key[TRIVIUM64_LANES][TRIVIUM64_KEY_SIZE];
+	uint8_t          iv[TRIVIUM64_LANES][TRIVIUM64_KEY_SIZE];
+	uint8_t          expected[PASSWORD_MAX], stream[PASSWORD_MAX];
+	uint64_t         ks[TRIVIUM64_LANES * LOGIN_WORDS], ks64[LOGIN_WORDS];
+	const uint8_t   *keys[TRIVIUM64_LANES], *ivs[TRIVIUM64_LANES];
+	trivium_ctx_t    ctx;
+	trivium64_ctx_t  ctx64;
+	int              n, l, i, ok = 1;
+
+
+	for (n = 1; n <= TRIVIUM64_LANES; n += 21) {
+		for (l = 0; l < n; l++) {
+			for (i = 0; i < TRIVIUM64_KEY_SIZE; i++) {
+				key[l][i] = rand();
+				iv[l][i]  = rand();
+			}
+			keys[l] = key[l];
+			ivs[l]  = iv[l];
+		}
+
+		trivium64_batch(n, keys, ivs, ks, LOGIN_WORDS);
+
+		for (l = 0; l < n; l++) {
+			trivium_init(key[l], 80, iv[l], 80, &ctx);
+			trivium_enc(&ctx);
+			for (i = 0; i < PASSWORD_MAX; i++)
+				expected[i] = trivium_getbyte(&ctx);
+
+			trivium64_init(key[l], iv[l], &ctx64);
+			for (i = 0; i < LOGIN_WORDS; i++)
+				ks64[i] = trivium64_next(&ctx64);
+			trivium64_bytes(ks64, 1, stream, PASSWORD_MAX);
+			if (memcmp(stream, expected, PASSWORD_MAX) != 0) {
+				printf("trivium64_next: session %d of %d differs from trivium.c\n", l, n);
+				ok = 0;
+			}
+
+			trivium64_bytes(ks + l * LOGIN_WORDS, 1, stream, PASSWORD_MAX);
+			if (memcmp(stream, expected, PASSWORD_MAX) != 0) {
+				printf("trivium64_batch: session %d of %d differs from trivium.c\n", l, n);
+				ok = 0;
+			}
+		}
+	}
+
+	return ok;
+}
+
+
+static void report(const char *what, int logins, double t, double base) {
+	printf("%-24s %9.0f logins/s %8.2f us per login", what, logins / t, t / logins * 1e6);
+	if (base > 0)
+		printf(" %6.1fx", base / t);
+	printf("\n");
+}
+
+
+int main(int argc, char *argv[]) {
+	uint8_t          key[TRIVIUM64_KEY_SIZE] = "0123456789";
+	uint8_t          iv[TRIVIUM64_KEY_SIZE]  = "ABCDEFGHIJ";
+	uint8_t          stream[PASSWORD_MAX];
+	uint64_t         ks[TRIVIUM64_LANES * LOGIN_WORDS];
+	const uint8_t   *keys[TRIVIUM64_LANES], *ivs[TRIVIUM64_LANES];
+	trivium_ctx_t    ctx;
+	trivium64_ctx_t  ctx64;
+	unsigned         sum = 0;
+	int              options, logins = 20000, n, l, i, w;
+	double           t, base;
+
+
+	while ( (options = getopt(argc, argv, "n:") ) != -1)
+		switch (options) {
+			case 'n': logins = atoi(optarg); break;
+			default:
+				fprintf(stderr, "usage: %s [-n logins]\n", argv[0]);
+				return EXIT_FAILURE;
+		}
+
+	if (logins < TRIVIUM64_LANES) {
+		fprintf(stderr, "At least %d logins.\n", TRIVIUM64_LANES);
+		return EXIT_FAILURE;
+	}
+
+	if (!checkVectors() || !checkLanes())
+		return EXIT_FAILURE;
+	printf("Test vectors and %d lanes ok.\n\n", TRIVIUM64_LANES);
+
+	// The IV changes with every login, like the session string.
+	t = now();
+	for (n = 0; n < logins; n++) {
+		iv[0] = n;
+		trivium_init(key, 80, iv, 80, &ctx);
+		trivium_enc(&ctx);
+		for (i = 0; i < PASSWORD_MAX; i++)
+			sum += trivium_getbyte(&ctx);
+	}
+	base = now() - t;
+	report("trivium.c", logins, base, 0);
+
+	t = now();
+	for (n = 0; n < logins; n++) {
+		iv[0] = n;
+		trivium64_init(key, iv, &ctx64);
+		for (w = 0; w < LOGIN_WORDS; w++)
+			ks[w] = trivium64_next(&ctx64);
+		trivium64_bytes(ks, 1, stream, PASSWORD_MAX);
+		sum += stream[0];
+	}
+	report("trivium64_next", logins, now() - t, base);
+
+	for (l = 0; l < TRIVIUM64_LANES; l++) {
+		keys[l] = key;
+		ivs[l]  = iv;
+	}
+
+	for (w = 1; w <= TRIVIUM64_LANES; w *= 4) {
+		char what[32];
+
+
+		t = now();
+		for (n = 0; n + w <= logins; n += w) {
+			iv[0] = n;
+			trivium64_batch(w, keys, ivs, ks, LOGIN_WORDS);
+			for (l = 0; l < w; l++) {
+				trivium64_bytes(ks + l * LOGIN_WORDS, 1, stream, PASSWORD_MAX);
+				sum += stream[0];
+			}
+		}
+		snprintf(what, sizeof(what), "trivium64_batch, %d", w);
+		report(what, n, now() - t, base * n / logins);
+	}
+
+	// Keeps the keystream from being optimised away.
+	return sum == 1 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
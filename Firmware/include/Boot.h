@@ -0,0 +1,25 @@
+/**
+ * @file       Boot.h
+ * @brief      Boot sequencing
+ * @details    Readiness of the subsystems, so that tasks wait for what
+ *             they need instead of being started in a fixed order
+ * @ingroup    Firmware
+ * @author     SNESoIP contributors
+ * @copyright  "THE BEER-WARE LICENCE" (Revision 42)
+ */
+#pragma once
+
+#include <stdint.h>
+
+#define BOOT_STAGE_NVS      0x01  // !< NVS initialised
+#define BOOT_STAGE_SNES     0x02  // !< Controller ports running
+#define BOOT_STAGE_WIFI     0x04  // !< WiFi station started
+#define BOOT_STAGE_IP       0x08  // !< First IP address obtained
+#define BOOT_STAGE_EXCHANGE 0x10  // !< First connection to the exchange server
+#define BOOT_STAGES         5     // !< Number of stages
+
+void     InitBoot(void);
+void     SetBootStage(uint32_t u32Stage);
+void     WaitForBootStage(uint32_t u32Stages);
+uint32_t GetBootStages(void);
+uint32_t GetBootStageMs(uint32_t u32Stage);
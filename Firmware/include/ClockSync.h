@@ -0,0 +1,117 @@
+/**
+ * @file       ClockSync.h
+ * @brief      Peer clock synchronisation
+ * @details    Offset and drift estimation between two adapters and
+ *             alignment of the remote console frames to the local ones
+ * @ingroup    Firmware
+ * @author     SNESoIP contributors
+ * @copyright  "THE BEER-WARE LICENCE" (Revision 42)
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifndef CLOCKSYNC_POINTS
+#define CLOCKSYNC_POINTS      32     // !< Filtered offsets used for the drift estimate
+#endif
+
+#ifndef CLOCKSYNC_SLIP_MS
+#define CLOCKSYNC_SLIP_MS     2000   // !< Minimum time between two delay adjustments
+#endif
+
+#define CLOCKSYNC_EPOCH_MS    1000   // !< One filtered offset per epoch
+#define CLOCKSYNC_STEP_US     10000  // !< Offset jump that restarts the estimation
+#define CLOCKSYNC_MAX_PPM     1000   // !< Max. plausible clock rate error
+#define CLOCKSYNC_SPAN_FRAMES 1800   // !< Frames a frame period is measured over
+#define CLOCKSYNC_PERIOD_MIN  15000  // !< Shortest plausible frame period in µs
+#define CLOCKSYNC_PERIOD_MAX  21000  // !< Longest plausible frame period in µs
+
+/**
+ * @typedef  ClockSyncPoint
+ * @brief    Filtered clock offset
+ * @struct   ClockSyncPoint_t
+ * @brief    Filtered clock offset structure
+ */
+typedef struct ClockSyncPoint_t
+{
+    int64_t  s64Local;   ///< Local time in µs
+    int64_t  s64Offset;  ///< Remote minus local time in µs
+    uint32_t u32Delay;   ///< Round-trip time of the sample in µs
+
+} ClockSyncPoint;
+
+/**
+ * @typedef  ClockSyncLatch
+ * @brief    Frame clock of one console
+ * @struct   ClockSyncLatch_t
+ * @brief    Frame clock structure
+ */
+typedef struct ClockSyncLatch_t
+{
+    bool     bValid;          ///< At least one latch seen
+    uint32_t u32Frame;        ///< Newest frame
+    int64_t  s64Time;         ///< Local time of u32Frame in µs
+    uint32_t u32AnchorFrame;  ///< Start of the measurement span
+    int64_t  s64AnchorTime;   ///< Local time of u32AnchorFrame in µs
+    bool     bMidValid;       ///< Next anchor is valid
+    uint32_t u32MidFrame;     ///< Next anchor
+    int64_t  s64MidTime;      ///< Local time of u32MidFrame in µs
+    uint32_t u32PeriodQ8;     ///< Frame period in 1/256 µs, 0 = unknown
+
+} ClockSyncLatch;
+
+/**
+ * @typedef  ClockSyncStats
+ * @brief    Clock synchronisation statistics
+ * @struct   ClockSyncStats_t
+ * @brief    Clock synchronisation statistics structure
+ */
+typedef struct ClockSyncStats_t
+{
+    int64_t  s64Offset;        ///< Remote minus local time in µs
+    int32_t  s32DriftPpb;      ///< Remote clock rate error relative to the local clock in ppb
+    int32_t  s32FrameSkewPpm;  ///< Remote frame rate relative to the local frame rate in ppm
+    int32_t  s32Slack;         ///< Predicted time a remote word waits for its latch in µs
+    uint32_t u32LatchToRx;     ///< Smoothed remote latch to local receive time in µs
+    uint32_t u32Samples;       ///< Offset samples taken
+    uint32_t u32Steps;         ///< Restarts after an offset jump
+    uint32_t u32Slips;         ///< Delay adjustments requested
+
+} ClockSyncStats;
+
+/**
+ * @typedef  ClockSync
+ * @brief    Clock synchronisation state
+ * @struct   ClockSync_t
+ * @brief    Clock synchronisation state structure
+ */
+typedef struct ClockSync_t
+{
+    bool           bRemoteValid;                  ///< s64Remote is valid
+    int64_t        s64Remote;                     ///< Newest remote time, unwrapped
+    bool           bEpochValid;                   ///< stEpochBest is valid
+    int64_t        s64EpochStart;                 ///< Start of the current epoch in µs
+    ClockSyncPoint stEpochBest;                   ///< Sample with the lowest delay in the epoch
+    ClockSyncPoint astPoints[CLOCKSYNC_POINTS];   ///< One point per epoch
+    uint8_t        u8Points;                      ///< Valid entries in astPoints
+    uint8_t        u8NextPoint;                   ///< Next entry to overwrite
+    bool           bValid;                        ///< Offset estimate is valid
+    int64_t        s64RefLocal;                   ///< Local time of s64RefOffset in µs
+    int64_t        s64RefOffset;                  ///< Estimated offset at s64RefLocal in µs
+    int32_t        s32DriftPpb;                   ///< Estimated drift in ppb
+    uint32_t       u32LatchToRxVar;               ///< Variation of the latch-to-receive time in µs
+    ClockSyncLatch stLocal;                       ///< Local console frame clock
+    ClockSyncLatch stRemote;                      ///< Remote console frame clock in local time
+    int64_t        s64LastSlip;                   ///< Time of the last delay adjustment in µs
+    ClockSyncStats stStats;                       ///< Statistics
+
+} ClockSync;
+
+void    InitClockSync(ClockSync* pstClock);
+int64_t ClockSyncRemoteTime(ClockSync* pstClock, uint32_t u32Remote);
+void    ClockSyncAddSample(ClockSync* pstClock, int64_t s64Sent, int64_t s64Received, int64_t s64RemoteRx, int64_t s64RemoteTx);
+int64_t ClockSyncToLocal(const ClockSync* pstClock, int64_t s64Remote);
+void    ClockSyncAddLocalLatch(ClockSync* pstClock, uint32_t u32Frame, int64_t s64Time);
+void    ClockSyncAddRemoteLatch(ClockSync* pstClock, uint32_t u32Frame, int64_t s64Remote, int64_t s64Received);
+int8_t  ClockSyncAlign(ClockSync* pstClock, uint32_t u32PlayFrame, int64_t s64PlayTime, uint8_t u8Delay, int64_t s64Now);
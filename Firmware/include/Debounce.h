@@ -0,0 +1,40 @@
+/**
+ * @file       Debounce.h
+ * @brief      Input debouncer
+ * @details    A per-button integrating debouncer for controller words
+ * @ingroup    Firmware
+ * @author     SNESoIP contributors
+ * @copyright  "THE BEER-WARE LICENCE" (Revision 42)
+ */
+#pragma once
+
+#include <stdint.h>
+
+#ifndef DEBOUNCE_PERIOD_US
+#define DEBOUNCE_PERIOD_US  5000 // !< Interval between two samples in µs, see SNES_READ_PERIOD_US
+#endif
+
+#ifndef DEBOUNCE_REJECT_US
+#define DEBOUNCE_REJECT_US  5000 // !< Glitches shorter than this never get through
+#endif
+
+#define DEBOUNCE_DEPTH_MAX  7    // !< Limit of the 3-bit vertical counter
+
+/**
+ * @typedef  Debounce
+ * @brief    Debouncer state
+ * @struct   Debounce_t
+ * @brief    Debouncer state structure
+ */
+typedef struct Debounce_t
+{
+    uint16_t u16State;      ///< Debounced controller word
+    uint16_t au16Count[3];  ///< Vertical counter, one bit plane per entry
+    uint8_t  u8Depth;       ///< Filter depth
+
+} Debounce;
+
+void     InitDebounce(Debounce* pstDebounce, uint16_t u16Initial, uint8_t u8Depth);
+void     SetDebounceDepth(Debounce* pstDebounce, uint8_t u8Depth);
+uint8_t  DebounceDepth(uint32_t u32RejectUs, uint32_t u32PeriodUs);
+uint16_t DebounceInput(Debounce* pstDebounce, uint16_t u16Sample);
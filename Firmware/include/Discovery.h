@@ -0,0 +1,18 @@
+/**
+ * @file       Discovery.h
+ * @brief      LAN discovery
+ * @details    Pairs adapters on the same subnet without the exchange server
+ * @ingroup    Firmware
+ * @author     SNESoIP contributors
+ * @copyright  "THE BEER-WARE LICENCE" (Revision 42)
+ */
+#pragma once
+
+#include <stdbool.h>
+
+#ifndef DISCOVERY_PORT
+#define DISCOVERY_PORT 54352 // !< UDP port of the LAN discovery
+#endif
+
+void InitDiscovery(void);
+bool IsDiscoveryPaired(void);
@@ -0,0 +1,58 @@
+/**
+ * @file       DiscoveryProtocol.h
+ * @brief      LAN discovery protocol
+ * @details    Transport-independent pairing logic of the LAN discovery
+ * @ingroup    Firmware
+ * @author     SNESoIP contributors
+ * @copyright  "THE BEER-WARE LICENCE" (Revision 42)
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef DISCOVERY_ANNOUNCE_MS
+#define DISCOVERY_ANNOUNCE_MS  100  // !< Broadcast interval while searching
+#endif
+
+#define DISCOVERY_OFFER_MS     500  // !< Time to wait for an answer to an offer
+#define DISCOVERY_PACKET_SIZE  16   // !< Announcement size in bytes
+#define DISCOVERY_VERSION      1    // !< Protocol version
+
+/**
+ * @enum   DiscoveryState
+ * @brief  Pairing state
+ */
+typedef enum
+{
+    DISCOVERY_SEARCH = 0,  ///< Announcing, no candidate
+    DISCOVERY_OFFER,       ///< Offered pairing to a candidate
+    DISCOVERY_PAIRED       ///< Paired
+
+} DiscoveryState;
+
+/**
+ * @typedef  Discovery
+ * @brief    LAN discovery state
+ * @struct   Discovery_t
+ * @brief    LAN discovery state structure
+ */
+typedef struct Discovery_t
+{
+    DiscoveryState eState;           ///< Pairing state
+    uint32_t       u32Nonce;         ///< Random ID of this adapter
+    uint16_t       u16Port;          ///< Own input exchange port
+    uint32_t       u32PeerNonce;     ///< Random ID of the candidate or peer
+    uint32_t       u32PeerAddr;      ///< Address of the peer, network byte order
+    uint16_t       u16PeerSrcPort;   ///< Source port of the peer's announcements
+    uint16_t       u16PeerPort;      ///< Input exchange port of the peer
+    int64_t        s64NextAnnounce;  ///< Time of the next broadcast in µs
+    int64_t        s64OfferTime;     ///< Time of the offer in µs
+    bool           bReplyPending;    ///< Unicast answer to the candidate due
+
+} Discovery;
+
+void   InitDiscoveryProtocol(Discovery* pstDiscovery, uint32_t u32Nonce, uint16_t u16Port);
+void   DiscoveryReceive(Discovery* pstDiscovery, const uint8_t* pu8Data, size_t uSize, uint32_t u32Addr, uint16_t u16SrcPort, int64_t s64Now);
+size_t DiscoveryPoll(Discovery* pstDiscovery, int64_t s64Now, uint8_t* pu8Buffer, bool* pbUnicast);
@@ -9,5 +9,19 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stdint.h>
 
-void InitExchangeClient(void);
+#ifndef EXCHANGE_SERVER_ADDR
+#define EXCHANGE_SERVER_ADDR "10.0.0.3" // !< Default server address, overridden by NVS
+#endif
+
+#ifndef EXCHANGE_SERVER_PORT
+#define EXCHANGE_SERVER_PORT 54350      // !< Default server port, overridden by NVS
+#endif
+
+void     InitExchangeClient(void);
+bool     SetExchangeServer(const char* pacAddr, uint16_t u16Port);
+bool     GetExchangeOpponent(uint8_t* pu8IpAddr);
+bool     GetExchangeClientID(uint8_t* pu8ClientID);
+void     GetExchangeServer(uint32_t* pu32Addr, uint16_t* pu16Port);
+uint32_t GetExchangeRTT(void);
@@ -0,0 +1,63 @@
+/**
+ * @file       ExchangeProtocol.h
+ * @brief      IP exchange protocol
+ * @details    Transport-independent state machine of the exchange client
+ * @ingroup    Firmware
+ * @author     SNESoIP contributors
+ * @copyright  "THE BEER-WARE LICENCE" (Revision 42)
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef EXCHANGE_BACKOFF_MIN_MS
+#define EXCHANGE_BACKOFF_MIN_MS  500   // !< First reconnect delay in ms
+#endif
+
+#ifndef EXCHANGE_BACKOFF_MAX_MS
+#define EXCHANGE_BACKOFF_MAX_MS  30000 // !< Upper limit of the reconnect delay in ms
+#endif
+
+#define EXCHANGE_RX_SIZE  16           // !< Longest server message
+#define EXCHANGE_TX_SIZE  16           // !< Longest pending client message
+
+/**
+ * @enum   ExchangeStage
+ * @brief  Stages of the exchange conversation
+ */
+typedef enum
+{
+    EXCHANGE_STAGE_HELLO = 0,  ///< Waiting for the client ID
+    EXCHANGE_STAGE_GETIP,      ///< Waiting for the opponent's address
+    EXCHANGE_STAGE_BYE,        ///< Waiting for the server to hang up
+    EXCHANGE_STAGE_DONE,       ///< Conversation finished
+    EXCHANGE_STAGE_ERROR       ///< Unexpected message received
+
+} ExchangeStage;
+
+/**
+ * @typedef  Exchange
+ * @brief    Exchange protocol state
+ * @struct   Exchange_t
+ * @brief    Exchange protocol state structure
+ */
+typedef struct Exchange_t
+{
+    ExchangeStage eStage;                    ///< Current stage
+    uint8_t       au8Rx[EXCHANGE_RX_SIZE];   ///< Partially received message
+    size_t        uRxLen;                    ///< Bytes in au8Rx
+    uint8_t       au8Tx[EXCHANGE_TX_SIZE];   ///< Message waiting to be sent
+    size_t        uTxLen;                    ///< Bytes in au8Tx
+    uint8_t       u8ClientID;                ///< Own client ID
+    uint8_t       u8OpponentID;              ///< Client ID of the opponent
+    uint8_t       au8IpAddr[4];              ///< IP address of the opponent
+
+} Exchange;
+
+void     InitExchange(Exchange* pstExchange);
+void     ExchangeReceive(Exchange* pstExchange, const uint8_t* pu8Data, size_t uSize);
+void     ExchangePoll(Exchange* pstExchange);
+void     ExchangeSent(Exchange* pstExchange, size_t uSize);
+uint32_t ExchangeBackoff(uint8_t u8Attempt, uint32_t u32Random);
@@ -0,0 +1,39 @@
+/**
+ * @file       JitterBench.h
+ * @brief      Capture jitter benchmark
+ * @details    Capture timing histograms while the WiFi is under load
+ * @ingroup    Firmware
+ * @author     SNESoIP contributors
+ * @copyright  "THE BEER-WARE LICENCE" (Revision 42)
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "SNES.h"
+
+#define JITTER_BENCH_MAX_S     600   // !< Max. benchmark duration in s
+#define JITTER_BENCH_PAYLOAD   1400  // !< Size of a load datagram in bytes
+#define JITTER_BENCH_BURST     16    // !< Load datagrams sent per tick
+
+/**
+ * @typedef  JitterBenchResult
+ * @brief    Benchmark progress and result
+ * @struct   JitterBenchResult_t
+ * @brief    Benchmark progress and result structure
+ */
+typedef struct JitterBenchResult_t
+{
+    bool                bRunning;     ///< Benchmark in progress
+    uint32_t            u32Seconds;   ///< Duration in s, 0 = never run
+    uint32_t            u32Elapsed;   ///< Time run so far in ms
+    uint32_t            u32Target;    ///< Load target, network byte order, 0 = no load
+    uint16_t            u16Port;      ///< Load target port
+    uint32_t            u32Packets;   ///< Load datagrams sent
+    uint32_t            u32Errors;    ///< Load datagrams rejected by the stack
+    SNESTimingHistogram stTiming;     ///< Capture timing, live while running
+
+} JitterBenchResult;
+
+bool StartJitterBench(uint32_t u32Seconds, uint32_t u32Target, uint16_t u16Port);
+void GetJitterBench(JitterBenchResult* pstResult);
@@ -0,0 +1,32 @@
+/**
+ * @file       Latency.h
+ * @brief      Latency window
+ * @details    A sliding window of latency samples with percentiles
+ * @ingroup    Firmware
+ * @author     SNESoIP contributors
+ * @copyright  "THE BEER-WARE LICENCE" (Revision 42)
+ */
+#pragma once
+
+#include <stdint.h>
+
+#ifndef LATENCY_SAMPLES
+#define LATENCY_SAMPLES 128 // !< Window size, must be a power of two
+#endif
+
+/**
+ * @typedef  Latency
+ * @brief    Latency window
+ * @struct   Latency_t
+ * @brief    Latency window structure
+ */
+typedef struct Latency_t
+{
+    uint32_t au32Samples[LATENCY_SAMPLES];  ///< Most recent samples in µs
+    uint32_t u32Count;                      ///< Number of samples taken
+
+} Latency;
+
+void     InitLatency(Latency* pstLatency);
+void     AddLatency(Latency* pstLatency, uint32_t u32Sample);
+uint32_t GetLatencyPercentile(const Latency* pstLatency, uint8_t u8Percent);
@@ -0,0 +1,23 @@
+/**
+ * @file       Movie.h
+ * @brief      Input movie playback
+ * @details    Replaces the controller by a movie uploaded through the
+ *             terminal
+ * @ingroup    Firmware
+ * @author     SNESoIP contributors
+ * @copyright  "THE BEER-WARE LICENCE" (Revision 42)
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "MoviePlayer.h"
+
+void   InitMovie(void);
+bool   StartMovie(uint8_t u8Ports, uint32_t u32Frames);
+void   StopMovie(void);
+size_t PushMovie(const uint8_t* pu8Data, size_t uSize);
+size_t GetMovieFree(void);
+bool   IsMovieActive(void);
+void   GetMovieStats(MovieStats* pstStats);
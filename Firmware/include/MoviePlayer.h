@@ -0,0 +1,73 @@
+/**
+ * @file       MoviePlayer.h
+ * @brief      Input movie player
+ * @details    Plays a recorded input movie out one frame per console
+ *             latch
+ * @ingroup    Firmware
+ * @author     SNESoIP contributors
+ * @copyright  "THE BEER-WARE LICENCE" (Revision 42)
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef MOVIE_BUFFER_SIZE
+#define MOVIE_BUFFER_SIZE   16384  // !< Movie ring buffer in bytes, must be a power of two
+#endif
+
+#ifndef MOVIE_PREBUFFER
+#define MOVIE_PREBUFFER     4096   // !< Bytes buffered before the playback starts
+#endif
+
+#define MOVIE_MAX_PORTS     2      // !< Controller ports per frame
+#define MOVIE_SAME_FRAME_US 8000   // !< Latches closer than this belong to the same frame
+
+/**
+ * @typedef  MovieStats
+ * @brief    Movie playback statistics
+ * @struct   MovieStats_t
+ * @brief    Movie playback statistics structure
+ */
+typedef struct MovieStats_t
+{
+    uint32_t u32Frames;     ///< Frames in the movie
+    uint32_t u32Received;   ///< Frames received
+    uint32_t u32Played;     ///< Frames presented
+    uint32_t u32Latches;    ///< Latches served
+    uint32_t u32Repeats;    ///< Further latches of a port within one frame
+    uint32_t u32Underruns;  ///< Frames whose words had not arrived in time
+    uint32_t u32Gaps;       ///< Latch periods long enough to hide a missed latch
+    uint32_t u32Missed;     ///< Latches without an armed SPI transaction, set by the driver
+
+} MovieStats;
+
+/**
+ * @typedef  MoviePlayer
+ * @brief    Input movie player state
+ * @struct   MoviePlayer_t
+ * @brief    Input movie player state structure
+ */
+typedef struct MoviePlayer_t
+{
+    uint8_t    au8Ring[MOVIE_BUFFER_SIZE];   ///< Received, not yet presented words
+    uint32_t   u32Head;                      ///< Bytes written to au8Ring
+    uint32_t   u32Tail;                      ///< Bytes taken from au8Ring
+    uint32_t   u32Size;                      ///< Movie size in bytes
+    uint8_t    u8Ports;                      ///< Controller ports per frame
+    bool       bStarted;                     ///< Prebuffering is over
+    bool       bDone;                        ///< Last frame has been presented
+    bool       bFrameValid;                  ///< au16Word holds a frame
+    int64_t    s64FrameTime;                 ///< First latch of the current frame in µs
+    uint32_t   u32Period;                    ///< Last regular latch period in µs
+    uint16_t   au16Word[MOVIE_MAX_PORTS];    ///< Words of the current frame
+    uint8_t    au8Latches[MOVIE_MAX_PORTS];  ///< Latches of the current frame per port
+    MovieStats stStats;                      ///< Statistics
+
+} MoviePlayer;
+
+void   InitMoviePlayer(MoviePlayer* pstPlayer, uint8_t u8Ports, uint32_t u32Frames);
+size_t MovieFree(const MoviePlayer* pstPlayer);
+size_t MoviePush(MoviePlayer* pstPlayer, const uint8_t* pu8Data, size_t uSize);
+bool   MovieLatch(MoviePlayer* pstPlayer, uint8_t u8Port, int64_t s64Now, uint16_t* pu16Data);
@@ -0,0 +1,46 @@
+/**
+ * @file       Netplay.h
+ * @brief      Peer-to-peer input exchange
+ * @details    Exchanges controller words with the opponent via UDP
+ * @ingroup    Firmware
+ * @author     SNESoIP contributors
+ * @copyright  "THE BEER-WARE LICENCE" (Revision 42)
+ */
+#pragma once
+
+#include "NetplayProtocol.h"
+
+#ifndef NETPLAY_PORT
+#define NETPLAY_PORT          54351 // !< UDP port of the input exchange
+#endif
+
+#ifndef NETPLAY_KEEPALIVE_MS
+#define NETPLAY_KEEPALIVE_MS  100   // !< Send interval while the console is off
+#endif
+
+#ifndef NETPLAY_PUNCH_MS
+#define NETPLAY_PUNCH_MS      3000  // !< Hole punching time before falling back to the relay
+#endif
+
+#define NETPLAY_REGISTER_MS   250   // !< Registration interval until the peer is known
+#define NETPLAY_REFRESH_MS    5000  // !< Registration interval afterwards
+#define NETPLAY_PROBE_MS      1000  // !< Direct probe interval while relaying
+
+/**
+ * @enum   NetplayPath
+ * @brief  Path of the input packets
+ */
+typedef enum
+{
+    NETPLAY_PATH_REGISTER = 0,  ///< Waiting for the peer's endpoint
+    NETPLAY_PATH_PUNCH,         ///< Sending directly, nothing received yet
+    NETPLAY_PATH_DIRECT,        ///< Direct path established
+    NETPLAY_PATH_RELAY          ///< Relayed by the exchange server
+
+} NetplayPath;
+
+void        InitNetplay(void);
+void        GetNetplayStats(NetplayStats* pstStats);
+void        GetNetplayClockStats(ClockSyncStats* pstStats);
+NetplayPath GetNetplayPath(void);
+void        SetNetplayPeer(uint32_t u32Addr, uint16_t u16Port);
@@ -0,0 +1,103 @@
+/**
+ * @file       NetplayProtocol.h
+ * @brief      Peer-to-peer input protocol
+ * @details    Transport-independent codec and session state of the UDP input exchange
+ * @ingroup    Firmware
+ * @author     SNESoIP contributors
+ * @copyright  "THE BEER-WARE LICENCE" (Revision 42)
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ClockSync.h"
+
+#ifndef NETPLAY_HISTORY
+#define NETPLAY_HISTORY      8    // !< Controller words per packet, must be a power of two
+#endif
+
+#define NETPLAY_MAGIC        0x4e // !< 'N'
+#define NETPLAY_HEADER_SIZE  18   // !< Packet header size in bytes
+#define NETPLAY_PACKET_SIZE  (NETPLAY_HEADER_SIZE + 2 * NETPLAY_HISTORY) // !< Max. packet size
+#define NETPLAY_SEQ_WINDOW   64   // !< Sent packets remembered for RTT, power of two
+#define NETPLAY_NO_ACK       0xffff // !< Ack delay of a packet that doesn't ack anything
+#define NETPLAY_NO_LATCH     0xffff // !< Latch age of a packet without a recent latch
+
+/**
+ * @typedef  NetplayPacket
+ * @brief    Decoded input packet
+ * @struct   NetplayPacket_t
+ * @brief    Decoded input packet structure
+ */
+typedef struct NetplayPacket_t
+{
+    uint16_t u16Seq;       ///< Sequence number
+    uint16_t u16Ack;       ///< Newest sequence number received from the peer
+    uint16_t u16AckDelay;  ///< Time between receiving u16Ack and sending, 10µs units
+    uint32_t u32Frame;     ///< Frame of au16Words[0]
+    uint32_t u32Time;      ///< Sender's time at sending in µs, truncated
+    uint16_t u16LatchAge;  ///< Time between the latch of u32Frame and sending, 10µs units
+    uint8_t  u8Count;      ///< Number of controller words
+    uint16_t au16Words[NETPLAY_HISTORY]; ///< Controller words, newest first
+
+} NetplayPacket;
+
+/**
+ * @typedef  NetplayStats
+ * @brief    Input exchange statistics
+ * @struct   NetplayStats_t
+ * @brief    Input exchange statistics structure
+ */
+typedef struct NetplayStats_t
+{
+    uint32_t u32TxPackets;   ///< Packets sent
+    uint32_t u32RxPackets;   ///< Valid packets received
+    uint32_t u32RxInvalid;   ///< Malformed packets received
+    uint32_t u32RxReordered; ///< Packets older than the newest one received
+    uint32_t u32Recovered;   ///< Frames only delivered by the history of a later packet
+    uint32_t u32Lost;        ///< Frames missing even from the history
+    uint32_t u32RTTLast;     ///< Last round-trip time in µs
+    uint32_t u32RTTMin;      ///< Minimum round-trip time in µs
+    uint32_t u32RTTSmooth;   ///< Smoothed round-trip time in µs
+    uint32_t u32RTTVar;      ///< Round-trip time variation in µs
+
+} NetplayStats;
+
+/**
+ * @typedef  NetplayInputFn
+ * @brief    Receives remote controller words in frame order
+ */
+typedef void (*NetplayInputFn)(uint32_t u32Frame, uint16_t u16Data);
+
+/**
+ * @typedef  NetplaySession
+ * @brief    Input exchange session state
+ * @struct   NetplaySession_t
+ * @brief    Input exchange session state structure
+ */
+typedef struct NetplaySession_t
+{
+    uint16_t     au16History[NETPLAY_HISTORY];   ///< Local words, indexed by frame
+    uint32_t     u32Frame;                       ///< Newest local frame
+    uint8_t      u8HistoryLen;                   ///< Valid entries in au16History
+    uint16_t     u16TxSeq;                       ///< Sequence number of the next packet
+    int64_t      as64TxTime[NETPLAY_SEQ_WINDOW]; ///< Send time per sequence number in µs
+    bool         bRxValid;                       ///< At least one packet received
+    uint16_t     u16RxSeq;                       ///< Newest sequence number received
+    int64_t      s64RxTime;                      ///< Receive time of u16RxSeq in µs
+    bool         bAckValid;                      ///< u16LastAck is valid
+    uint16_t     u16LastAck;                     ///< Newest acknowledged sequence number
+    bool         bRemoteValid;                   ///< u32RemoteFrame is valid
+    uint32_t     u32RemoteFrame;                 ///< Newest remote frame delivered
+    ClockSync    stClock;                        ///< Peer clock synchronisation
+    NetplayStats stStats;                        ///< Statistics
+
+} NetplaySession;
+
+size_t EncodeNetplayPacket(const NetplayPacket* pstPacket, uint8_t* pu8Buffer, size_t uSize);
+bool   DecodeNetplayPacket(NetplayPacket* pstPacket, const uint8_t* pu8Buffer, size_t uSize);
+void   InitNetplaySession(NetplaySession* pstSession);
+void   NetplayBuildPacket(NetplaySession* pstSession, uint32_t u32Frame, uint16_t u16Data, int64_t s64Latch, int64_t s64Now, NetplayPacket* pstPacket);
+void   NetplayHandlePacket(NetplaySession* pstSession, const NetplayPacket* pstPacket, int64_t s64Now, NetplayInputFn pfnInput);
@@ -9,7 +9,13 @@
  */
 #pragma once
 
+#include <stdbool.h>
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
 #include "driver/gpio.h"
+#include "Debounce.h"
 
 #ifdef USE_SNES_DEFAULT_CONFIG
 
@@ -25,6 +31,8 @@
 #define SNES_PORT0_LATCH_PIN  GPIO_NUM_15 // !< Port 0 data latch pin
 #define SNES_PORT0_DATA_BIT   GPIO_SEL_12 // !< Port 0 serial data bitmask
 #define SNES_PORT0_DATA_PIN   GPIO_NUM_12 // !< Port 0 serial data pin
+#define SNES_PORT0_IO_BIT     GPIO_SEL_32 // !< Port 0 IOPort 6 bitmask
+#define SNES_PORT0_IO_PIN     GPIO_NUM_32 // !< Port 0 IOPort 6 pin
 
 /*
  * VSPI
@@ -38,6 +46,8 @@
 #define SNES_PORT1_LATCH_PIN  GPIO_NUM_5  // !< Port 1 data latch pin
 #define SNES_PORT1_DATA_BIT   GPIO_SEL_19 // !< Port 1 serial data bitmask
 #define SNES_PORT1_DATA_PIN   GPIO_NUM_19 // !< Port 1 serial data pin
+#define SNES_PORT1_IO_BIT     GPIO_SEL_33 // !< Port 1 IOPort 7 bitmask
+#define SNES_PORT1_IO_PIN     GPIO_NUM_33 // !< Port 1 IOPort 7 pin
 
 #define SNES_INPUT_CLOCK_BIT  GPIO_SEL_25 // !< Input data clock bitmask
 #define SNES_INPUT_CLOCK_PIN  GPIO_NUM_25 // !< Input data clock pin
@@ -47,8 +57,210 @@
 #define SNES_INPUT_DATA_PIN   GPIO_NUM_27 // !< Input serial data pin
 #endif
 
+#define SNES_NUM_PORTS        2   // !< Number of controller ports
+#define SNES_PORT_MAX_BITS    512 // !< Max. transaction length without DMA
+
+#ifndef SNES_CLOCK_PERIOD_US
+#define SNES_CLOCK_PERIOD_US  12 // !< Nominal data clock period in µs
+#endif
+
+#ifndef SNES_READ_PERIOD_US
+#define SNES_READ_PERIOD_US   DEBOUNCE_PERIOD_US // !< Interval between two controller reads in µs
+#endif
+
+#ifndef SNES_LATCH_SYNC
+#define SNES_LATCH_SYNC       0 // !< Read the controller right before the console latches
+#endif
+
+#ifndef SNES_LATCH_SYNC_MARGIN_US
+#define SNES_LATCH_SYNC_MARGIN_US  150 // !< Safety margin before the predicted latch in µs
+#endif
+
+#ifndef SNES_REMOTE_QUEUE_SIZE
+#define SNES_REMOTE_QUEUE_SIZE  16 // !< Remote input queue size in frames, power of two
+#endif
+
+#ifndef SNES_REMOTE_DELAY
+#define SNES_REMOTE_DELAY       2  // !< Default remote input delay in frames
+#endif
+
+#define SNES_TIMING_BUCKETS     12 // !< Timing histogram buckets: 0, 1, 2-3, 4-7 ... 1024+ µs
+
+/**
+ * @typedef  SNESCaptureStats
+ * @brief    Controller capture statistics
+ * @struct   SNESCaptureStats_t
+ * @brief    Controller capture statistics structure
+ */
+typedef struct SNESCaptureStats_t
+{
+    uint32_t u32Captures;     ///< Number of completed captures
+    uint32_t u32Timeouts;     ///< Number of incomplete captures
+    uint32_t u32LatencyLast;  ///< Latch-to-word latency of the last capture in µs
+    uint32_t u32LatencyMin;   ///< Minimum latch-to-word latency in µs
+    uint32_t u32LatencyMax;   ///< Maximum latch-to-word latency in µs
+    uint32_t u32LatencyAvg;   ///< Moving average of the latch-to-word latency in µs
+    uint32_t u32JitterLast;   ///< Max. clock edge deviation of the last capture in µs
+    uint32_t u32JitterMax;    ///< Max. clock edge deviation since start-up in µs
+
+} SNESCaptureStats;
+
+/**
+ * @typedef  SNESTimingHistogram
+ * @brief    Controller capture timing histogram
+ * @details  Bucket 0 counts samples below 1 µs, bucket n counts
+ *           samples from 2^(n-1) to 2^n - 1 µs, the last bucket all
+ *           longer ones.
+ * @struct   SNESTimingHistogram_t
+ * @brief    Controller capture timing histogram structure
+ */
+typedef struct SNESTimingHistogram_t
+{
+    uint32_t u32Captures;                      ///< Number of completed captures
+    uint32_t u32Wakes;                         ///< Number of latch-sync wake-ups
+    uint32_t au32Jitter[SNES_TIMING_BUCKETS];  ///< Max. clock edge deviation per capture
+    uint32_t au32Wake[SNES_TIMING_BUCKETS];    ///< Last clock edge to reader running
+    uint32_t au32Late[SNES_TIMING_BUCKETS];    ///< Latch-sync wake-up past its due time
+    uint32_t u32JitterMax;                     ///< Max. clock edge deviation in µs
+    uint32_t u32WakeMax;                       ///< Max. reader wake-up delay in µs
+    uint32_t u32LateMax;                       ///< Max. latch-sync wake-up delay in µs
+
+} SNESTimingHistogram;
+
+/**
+ * @typedef  SNESLatchStats
+ * @brief    Console latch statistics
+ * @struct   SNESLatchStats_t
+ * @brief    Console latch statistics structure
+ */
+typedef struct SNESLatchStats_t
+{
+    uint32_t u32Latches;      ///< Number of latch pulses seen on port 0
+    uint32_t u32FramePeriod;  ///< Filtered latch period in µs, 0 = unknown
+    uint32_t u32AgeLast;      ///< Input age at the last shift-out in µs
+    uint32_t u32AgeMin;       ///< Minimum input age at shift-out in µs
+    uint32_t u32AgeMax;       ///< Maximum input age at shift-out in µs
+    uint32_t u32AgeAvg;       ///< Moving average of the input age in µs
+    uint32_t u32EventsLost;   ///< Input events dropped on a full queue
+
+} SNESLatchStats;
+
+/**
+ * @typedef  SNESPortStats
+ * @brief    Controller port statistics
+ * @struct   SNESPortStats_t
+ * @brief    Controller port statistics structure
+ */
+typedef struct SNESPortStats_t
+{
+    uint32_t u32Latches;        ///< Number of latch pulses
+    uint32_t u32Transactions;   ///< Number of completed SPI transactions
+    uint32_t u32MissedLatches;  ///< Latches without an armed transaction
+    uint32_t u32QueueErrors;    ///< Failed spi_slave_queue_trans calls
+
+} SNESPortStats;
+
+/**
+ * @typedef  SNESRemoteStats
+ * @brief    Remote input statistics
+ * @struct   SNESRemoteStats_t
+ * @brief    Remote input statistics structure
+ */
+typedef struct SNESRemoteStats_t
+{
+    uint32_t u32Received;   ///< Number of queued remote words
+    uint32_t u32Presented;  ///< Number of remote words shifted out
+    uint32_t u32Underruns;  ///< Latches with an empty queue
+    uint32_t u32Repeats;    ///< Latches that repeated the previous word
+    uint32_t u32Late;       ///< Words that arrived after their frame
+    uint32_t u32Resyncs;    ///< Words that arrived too far ahead
+    uint32_t u32Inserted;   ///< Words repeated to increase the delay
+    uint32_t u32Dropped;    ///< Words skipped to decrease the delay
+
+} SNESRemoteStats;
+
+/**
+ * @typedef  SNESInputStamp
+ * @brief    Time-stamped controller word
+ * @struct   SNESInputStamp_t
+ * @brief    Time-stamped controller word structure
+ */
+typedef struct SNESInputStamp_t
+{
+    int64_t  s64Time;   ///< Capture time in µs (esp_timer)
+    uint32_t u32Frame;  ///< Console frame, i.e. port 0 latch count, at capture
+    uint16_t u16Data;   ///< Controller word
+
+} SNESInputStamp;
+
+/**
+ * @typedef  SNESInputEvent
+ * @brief    Controller input event
+ * @struct   SNESInputEvent_t
+ * @brief    Controller input event structure
+ */
+typedef struct SNESInputEvent_t
+{
+    int64_t  s64Time;   ///< Latch or capture time in µs (esp_timer)
+    uint32_t u32Frame;  ///< Console frame, i.e. port 0 latch count
+    uint16_t u16Data;   ///< Controller word
+    bool     bLatch;    ///< Word shifted out at a latch, otherwise a changed word
+
+} SNESInputEvent;
+
+/**
+ * @typedef  SNESOverrideFn
+ * @brief    Supplies the word a controller port shifts out at a latch
+ * @details  Called from interrupt context with the port and the time
+ *           of the latch.  Returns false to leave the port to the
+ *           controller or the remote input.
+ */
+typedef bool (*SNESOverrideFn)(uint8_t u8Port, int64_t s64Time, uint16_t* pu16Data);
+
+/**
+ * @typedef  SNESLatencyStats
+ * @brief    End-to-end latency percentiles
+ * @struct   SNESLatencyStats_t
+ * @brief    End-to-end latency percentiles structure
+ */
+typedef struct SNESLatencyStats_t
+{
+    uint32_t u32CaptureToLatchP50;  ///< Local capture to port 0 latch in µs
+    uint32_t u32CaptureToLatchP99;  ///< Local capture to port 0 latch in µs
+    uint32_t u32CaptureToWireP50;   ///< Local capture to network send in µs
+    uint32_t u32CaptureToWireP99;   ///< Local capture to network send in µs
+    uint32_t u32WireToLatchP50;     ///< Network receive to port 1 latch in µs
+    uint32_t u32WireToLatchP99;     ///< Network receive to port 1 latch in µs
+    uint32_t u32CaptureToWireCount; ///< Number of capture-to-wire samples
+    uint32_t u32WireToLatchCount;   ///< Number of wire-to-latch samples
+
+} SNESLatencyStats;
+
 void     InitSNES(void);
 void     DeInitSNES(void);
 uint16_t GetSNESInputData(void);
+void     GetSNESCaptureStats(SNESCaptureStats* pstStats);
+void     GetSNESTimingHistogram(SNESTimingHistogram* pstHistogram);
+void     ResetSNESTimingHistogram(void);
+void     GetSNESLatchStats(SNESLatchStats* pstStats);
+void     GetSNESPortStats(uint8_t u8Port, SNESPortStats* pstStats);
+void     SetSNESLatchSync(bool bEnable);
+void     SetSNESDebounceDepth(uint8_t u8Depth);
+void     PushSNESRemoteInput(uint32_t u32Frame, uint16_t u16Data);
+void     ResetSNESRemoteInput(void);
+void     SetSNESRemoteDelay(uint8_t u8Delay);
+uint8_t  GetSNESRemoteDelay(void);
+void     AdjustSNESRemoteDelay(int8_t s8Frames);
+bool     GetSNESRemotePlayout(uint32_t* pu32Frame, int64_t* ps64Time);
+void     GetSNESRemoteStats(SNESRemoteStats* pstStats);
+uint32_t GetSNESFrame(void);
+void     GetSNESLatchTime(uint32_t* pu32Frame, int64_t* ps64Time);
+void     SetSNESFrameNotify(TaskHandle_t hTask);
+void     SetSNESInputQueue(QueueHandle_t hQueue);
+void     SetSNESOverride(SNESOverrideFn pfnOverride);
+void     GetSNESInputStamp(SNESInputStamp* pstStamp);
+void     MarkSNESInputSent(const SNESInputStamp* pstStamp);
+void     GetSNESLatencyStats(SNESLatencyStats* pstStats);
+void     SetSNESPortBuffer(uint8_t u8Port, const void* pBuffer, uint16_t u16Bits);
 void     SendClock(void);
 void     SendLatch(void);
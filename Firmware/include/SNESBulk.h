@@ -0,0 +1,42 @@
+/**
+ * @file       SNESBulk.h
+ * @brief      SNES bulk data channel
+ * @details    A framed downstream data channel over both controller ports
+ * @ingroup    Firmware
+ * @author     SNESoIP contributors
+ * @copyright  "THE BEER-WARE LICENCE" (Revision 42)
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "freertos/FreeRTOS.h"
+#include "SNESBulkProtocol.h"
+
+#ifndef SNES_BULK_BUFFER_SIZE
+#define SNES_BULK_BUFFER_SIZE   4096  // !< Size of the staging buffer in bytes
+#endif
+
+/**
+ * @typedef  SNESBulkStats
+ * @brief    Bulk data channel statistics
+ * @struct   SNESBulkStats_t
+ * @brief    Bulk data channel statistics structure
+ */
+typedef struct SNESBulkStats_t
+{
+    uint32_t u32Blocks;  ///< Number of blocks handed over to the ports
+    uint32_t u32Bytes;   ///< Number of payload bytes handed over
+    uint32_t u32Acks;    ///< Number of acknowledges received
+    uint32_t u32Stalls;  ///< Acknowledges without a block staged
+
+} SNESBulkStats;
+
+void InitSNESBulk(void);
+void SetSNESBulkMode(bool bEnable);
+bool IsSNESBulkMode(void);
+bool WriteSNESBulk(const uint8_t* pu8Data, size_t uSize, TickType_t xTimeout);
+void GetSNESBulkStats(SNESBulkStats* pstStats);
+void SetSNESBulkCredit(uint8_t u8Credit);
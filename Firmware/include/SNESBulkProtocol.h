@@ -0,0 +1,26 @@
+/**
+ * @file       SNESBulkProtocol.h
+ * @brief      SNES bulk data block format
+ * @details    Transport-independent block codec of the bulk data channel
+ * @ingroup    Firmware
+ * @author     SNESoIP contributors
+ * @copyright  "THE BEER-WARE LICENCE" (Revision 42)
+ */
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SNES_BULK_PORTS         2     // !< Controller ports a block is spread over
+#define SNES_BULK_MAGIC         0x5a  // !< First byte of every block
+#define SNES_BULK_BLOCK_SIZE    64    // !< Block size in bytes, both ports
+#define SNES_BULK_HEADER_SIZE   4     // !< Magic, sequence, length, credit
+#define SNES_BULK_CRC_SIZE      2     // !< CRC-16-CCITT
+#define SNES_BULK_PAYLOAD_SIZE  (SNES_BULK_BLOCK_SIZE - SNES_BULK_HEADER_SIZE - SNES_BULK_CRC_SIZE)
+
+#define SNES_BULK_PORT_BYTES    (SNES_BULK_BLOCK_SIZE / SNES_BULK_PORTS)  // !< Bytes per port
+#define SNES_BULK_PORT_BITS     (1 + 8 * SNES_BULK_PORT_BYTES)           // !< Incl. dummy bit
+#define SNES_BULK_PORT_WORDS    ((SNES_BULK_PORT_BITS + 31) / 32)        // !< 32-bit words
+
+uint16_t SNESBulkCRC(const uint8_t* pu8Data, size_t uSize);
+void     SNESBulkPack(uint8_t u8Seq, uint8_t u8Credit, const uint8_t* pu8Payload, uint8_t u8Len, uint32_t au32Out[][SNES_BULK_PORT_WORDS]);
@@ -0,0 +1,44 @@
+/**
+ * @file       SNESUpstream.h
+ * @brief      SNES upstream data channel
+ * @details    A bit-serial channel from the SNES to the firmware via WRIO
+ * @ingroup    Firmware
+ * @author     SNESoIP contributors
+ * @copyright  "THE BEER-WARE LICENCE" (Revision 42)
+ */
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "freertos/FreeRTOS.h"
+
+#ifndef SNES_UPSTREAM_BIT_US
+#define SNES_UPSTREAM_BIT_US      4    // !< Nominal pulse width T in µs
+#endif
+
+#ifndef SNES_UPSTREAM_BUFFER_SIZE
+#define SNES_UPSTREAM_BUFFER_SIZE 1024 // !< Size of the receive buffer in bytes
+#endif
+
+#define SNES_UPSTREAM_MAX_PAYLOAD 29   // !< Max. payload bytes per frame
+
+/**
+ * @typedef  SNESUpstreamStats
+ * @brief    Upstream channel statistics
+ * @struct   SNESUpstreamStats_t
+ * @brief    Upstream channel statistics structure
+ */
+typedef struct SNESUpstreamStats_t
+{
+    uint32_t u32Frames;       ///< Number of valid frames
+    uint32_t u32Bytes;        ///< Number of payload bytes received
+    uint32_t u32CodingErrors; ///< Frames with invalid pulse timing
+    uint32_t u32CRCErrors;    ///< Frames with bad length or CRC
+    uint32_t u32Overflows;    ///< Frames dropped due to a full buffer
+
+} SNESUpstreamStats;
+
+void   InitSNESUpstream(void);
+size_t ReadSNESUpstream(uint8_t* pu8Data, size_t uSize, TickType_t xTimeout);
+void   GetSNESUpstreamStats(SNESUpstreamStats* pstStats);
@@ -0,0 +1,61 @@
+/**
+ * @file       Tasks.h
+ * @brief      Task placement
+ * @ingroup    Firmware
+ * @details
+ * @code{.unparsed}
+ *
+ * The two cores are split by role instead of letting the scheduler
+ * move tasks around:
+ *
+ *   PRO CPU (0)                          APP CPU (1)
+ *   -----------                          -----------
+ *   WiFi driver          23  (IDF)       SNES port refill   22
+ *   esp_timer            22  (IDF)       SNES reader        21
+ *   lwIP                 18  (IDF)       SNES bulk/upstream 10
+ *   netplay send         17              main, debug         1
+ *   netplay receive      16
+ *   WiFi, exchange,       5
+ *   discovery
+ *   terminal, stream      3
+ *   jitter benchmark      2
+ *
+ * The WiFi driver is pinned to the PRO CPU by the SDK and all socket
+ * users are placed next to it and lwIP.  The APP CPU runs nothing
+ * but the SNES I/O, which is why its priorities may be as high as the
+ * driver's: a refill or a capture is never queued behind a burst of
+ * packets.  Network tasks stay below lwIP, so a send never preempts
+ * the stack it depends on.
+ *
+ * Interrupts are allocated on the core that installs them.  The SNES
+ * subsystem is therefore initialised by a task on the APP CPU, see
+ * Firmware.c, which puts the SPI slave, RMT and GPIO interrupts there
+ * as well.  The interrupt handlers, the SPI callbacks and everything
+ * they call are placed in IRAM and allocated with ESP_INTR_FLAG_IRAM.
+ * While the flash cache is disabled, e.g. while NVS is written, they
+ * still answer the latches with the transactions that are already
+ * armed, but all tasks are stalled: the controller is not read, the
+ * transactions are not refilled and the ports may run out of them.
+ *
+ * The latch-sync timer callback is the only SNES path that runs on the
+ * PRO CPU, in the esp_timer task.  The jitter benchmark shows what the
+ * WiFi driver costs it, see JitterBench.c.
+ *
+ * @endcode
+ * @author     SNESoIP contributors
+ * @copyright  "THE BEER-WARE LICENCE" (Revision 42)
+ */
+#pragma once
+
+#define TASK_CORE_NET            0   // !< PRO CPU: WiFi, lwIP and all socket users
+#define TASK_CORE_SNES           1   // !< APP CPU: SNES I/O and its interrupts
+
+#define TASK_PRIO_SNES_PORT      22  // !< Controller port refill
+#define TASK_PRIO_SNES_READ      21  // !< Controller reader
+#define TASK_PRIO_SNES_DATA      10  // !< Bulk and upstream block builders
+#define TASK_PRIO_NETPLAY_SEND   17  // !< Netplay sender, paced by the latch
+#define TASK_PRIO_NETPLAY        16  // !< Netplay receiver
+#define TASK_PRIO_CONTROL        5   // !< WiFi, exchange client, discovery
+#define TASK_PRIO_SERVICE        3   // !< Terminal and input stream
+#define TASK_PRIO_BENCH          2   // !< Jitter benchmark traffic
+#define TASK_PRIO_BACKGROUND     1   // !< Main and debug thread
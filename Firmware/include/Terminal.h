@@ -14,6 +14,10 @@
 #define TERMINAL_PORT 23
 #endif
 
+#ifndef TERMINAL_MAX_SESSIONS
+#define TERMINAL_MAX_SESSIONS 4 // !< Max. number of concurrent connections
+#endif
+
 #ifndef VERSION
 #define VERSION "SNESoIP Rev. 3\r\n"
 #endif
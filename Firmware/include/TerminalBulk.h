@@ -0,0 +1,19 @@
+/**
+ * @file       TerminalBulk.h
+ * @brief      Bulk data pipe
+ * @details    Connects a terminal connection to the SNES bulk data
+ *             channel
+ * @ingroup    Firmware
+ * @author     SNESoIP contributors
+ * @copyright  "THE BEER-WARE LICENCE" (Revision 42)
+ */
+#pragma once
+
+#include <stdbool.h>
+
+#ifndef TERMINAL_BULK_CHUNK
+#define TERMINAL_BULK_CHUNK  256  // !< Max. bytes received from the host at once
+#endif
+
+void InitTerminalBulk(void);
+bool AddTerminalBulk(int nSock);
@@ -0,0 +1,40 @@
+/**
+ * @file       TerminalStream.h
+ * @brief      Binary input stream
+ * @details    Pushes controller input to terminal connections that
+ *             switched to binary mode
+ * @ingroup    Firmware
+ * @author     SNESoIP contributors
+ * @copyright  "THE BEER-WARE LICENCE" (Revision 42)
+ */
+#pragma once
+
+#include <stdbool.h>
+
+#ifndef TERMINAL_STREAM_MAX
+#define TERMINAL_STREAM_MAX        4   // !< Max. number of concurrent subscribers
+#endif
+
+#ifndef TERMINAL_STREAM_QUEUE_SIZE
+#define TERMINAL_STREAM_QUEUE_SIZE 64  // !< Input events buffered for the stream task
+#endif
+
+#define TERMINAL_STREAM_RECORD_SIZE 12   // !< Size of one stream record in bytes
+#define TERMINAL_STREAM_MAGIC       0x53 // !< First byte of every record ('S')
+#define TERMINAL_STREAM_CHANGED     'C'  // !< Record type: changed controller word
+#define TERMINAL_STREAM_FRAME       'F'  // !< Record type: word shifted out at a latch
+#define TERMINAL_STREAM_LOST        'L'  // !< Record type: records dropped before this one
+
+/**
+ * @enum   TerminalStreamMode
+ * @brief  Records a subscriber receives
+ */
+typedef enum
+{
+    TERMINAL_STREAM_CHANGES = 0,  ///< Changed controller words only
+    TERMINAL_STREAM_FRAMES        ///< One record per console frame
+
+} TerminalStreamMode;
+
+void InitTerminalStream(void);
+bool AddTerminalStream(int nSock, TerminalStreamMode eMode);
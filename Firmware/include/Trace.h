@@ -0,0 +1,26 @@
+/**
+ * @file       Trace.h
+ * @brief      Event trace
+ * @details    Scheduling, interrupt and packet events in a RAM ring
+ * @ingroup    Firmware
+ * @author     SNESoIP contributors
+ * @copyright  "THE BEER-WARE LICENCE" (Revision 42)
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "TraceFormat.h"
+
+#ifndef TRACE_EVENTS
+#define TRACE_EVENTS  1024  // !< Ring size in events, must be a power of two
+#endif
+
+void     InitTrace(void);
+void     StartTrace(void);
+void     StopTrace(void);
+bool     IsTraceRunning(void);
+uint32_t GetTraceEvents(uint32_t* pu32Lost);
+bool     GetTraceEvent(uint32_t u32Index, TraceEvent* pstEvent);
+void     TraceRecord(uint8_t u8Type, uint16_t u16Id, uint32_t u32Arg);
+void     TraceTaskSwitchedIn(void* pTask);
@@ -0,0 +1,104 @@
+/**
+ * @file       TraceFormat.h
+ * @brief      Trace dump format
+ * @details    Encoding of the trace dump sent by the terminal
+ * @ingroup    Firmware
+ * @author     SNESoIP contributors
+ * @copyright  "THE BEER-WARE LICENCE" (Revision 42)
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define TRACE_MAGIC        "STRC" // !< First four bytes of a dump
+#define TRACE_VERSION      1   // !< Dump format version
+#define TRACE_HEADER_SIZE  16  // !< Encoded header size in bytes
+#define TRACE_TASK_SIZE    20  // !< Encoded task entry size in bytes
+#define TRACE_EVENT_SIZE   12  // !< Encoded event size in bytes
+#define TRACE_TASK_NAME    16  // !< Max. task name length in bytes
+
+/**
+ * @enum   TraceType
+ * @brief  Trace event type
+ */
+typedef enum
+{
+    TRACE_TASK_SWITCH = 0,  ///< Task switched in, arg: task handle
+    TRACE_ISR_ENTER,        ///< Interrupt handler entered, id: TraceISR
+    TRACE_ISR_EXIT,         ///< Interrupt handler left, id: TraceISR
+    TRACE_SPI_DONE,         ///< SPI transaction done, id: port, arg: transaction count
+    TRACE_LATCH,            ///< Console latch edge, id: port, arg: latch count
+    TRACE_PACKET_RX,        ///< Netplay packet received, id: size
+    TRACE_PACKET_TX,        ///< Netplay packet sent, id: size, arg: frame
+    TRACE_TYPES             ///< Number of event types
+
+} TraceType;
+
+/**
+ * @enum   TraceISR
+ * @brief  Traced interrupt handler
+ */
+typedef enum
+{
+    TRACE_ISR_CLOCK = 0,    ///< Controller capture, last clock edge
+    TRACE_ISR_LATCH0,       ///< Port 0 latch
+    TRACE_ISR_LATCH1,       ///< Port 1 latch
+    TRACE_ISR_BULK_ACK,     ///< Bulk channel acknowledge
+    TRACE_ISRS              ///< Number of traced interrupt handlers
+
+} TraceISR;
+
+/**
+ * @typedef  TraceEvent
+ * @brief    Trace event
+ * @struct   TraceEvent_t
+ * @brief    Trace event structure
+ */
+typedef struct TraceEvent_t
+{
+    uint32_t u32Time;  ///< Time since start-up in µs, wraps after 71 minutes
+    uint32_t u32Arg;   ///< Argument, see TraceType
+    uint16_t u16Id;    ///< Identifier, see TraceType
+    uint8_t  u8Type;   ///< TraceType
+    uint8_t  u8Core;   ///< Core the event happened on
+
+} TraceEvent;
+
+/**
+ * @typedef  TraceTask
+ * @brief    Task name table entry
+ * @struct   TraceTask_t
+ * @brief    Task name table entry structure
+ */
+typedef struct TraceTask_t
+{
+    uint32_t u32Handle;                   ///< Task handle as in TRACE_TASK_SWITCH
+    char     acName[TRACE_TASK_NAME + 1]; ///< Null-terminated task name
+
+} TraceTask;
+
+/**
+ * @typedef  TraceHeader
+ * @brief    Trace dump header
+ * @struct   TraceHeader_t
+ * @brief    Trace dump header structure
+ */
+typedef struct TraceHeader_t
+{
+    uint8_t  u8Version;  ///< Dump format version
+    uint16_t u16Tasks;   ///< Number of task entries that follow
+    uint32_t u32Events;  ///< Number of events that follow the tasks
+    uint32_t u32Lost;    ///< Events overwritten before the dump
+
+} TraceHeader;
+
+size_t      EncodeTraceHeader(const TraceHeader* pstHeader, uint8_t* pu8Buffer, size_t uSize);
+bool        DecodeTraceHeader(TraceHeader* pstHeader, const uint8_t* pu8Buffer, size_t uSize);
+size_t      EncodeTraceTask(const TraceTask* pstTask, uint8_t* pu8Buffer, size_t uSize);
+bool        DecodeTraceTask(TraceTask* pstTask, const uint8_t* pu8Buffer, size_t uSize);
+size_t      EncodeTraceEvent(const TraceEvent* pstEvent, uint8_t* pu8Buffer, size_t uSize);
+bool        DecodeTraceEvent(TraceEvent* pstEvent, const uint8_t* pu8Buffer, size_t uSize);
+const char* TraceTypeName(uint8_t u8Type);
+const char* TraceISRName(uint16_t u16Id);
@@ -0,0 +1,20 @@
+/**
+ * @file       TraceHooks.h
+ * @brief      FreeRTOS trace hooks
+ * @details    Included into every source file, the FreeRTOS kernel
+ *             included, by platformio.ini, so that the kernel reports
+ *             task switches to Trace.c
+ * @ingroup    Firmware
+ * @author     SNESoIP contributors
+ * @copyright  "THE BEER-WARE LICENCE" (Revision 42)
+ */
+#pragma once
+
+#ifndef __ASSEMBLER__
+
+void TraceTaskSwitchedIn(void* pTask);
+
+// Expanded in tasks.c only, where pxCurrentTCB is known.
+#define traceTASK_SWITCHED_IN() TraceTaskSwitchedIn((void*)pxCurrentTCB[xPortGetCoreID()])
+
+#endif
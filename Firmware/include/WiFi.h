@@ -8,5 +8,33 @@
  */
 #pragma once
 
-void InitWiFi(void);
-void WaitForIP(void);
+#include <stdbool.h>
+#include <stdint.h>
+#include "WiFiConnect.h"
+
+/**
+ * @typedef  WiFiInfo
+ * @brief    WiFi connection details
+ * @struct   WiFiInfo_t
+ * @brief    WiFi connection details structure
+ */
+typedef struct WiFiInfo_t
+{
+    WiFiConnectState eState;        ///< Connection state
+    WiFiConnectStats stStats;       ///< Connection statistics
+    char             acSSID[33];    ///< Stored SSID, empty if none
+    uint8_t          au8BSSID[6];   ///< Stored BSSID
+    uint8_t          u8Channel;     ///< Stored channel, 0 = unknown
+    bool             bStaticIP;     ///< Address is set, not leased
+    uint32_t         u32IP;         ///< Static address or last lease, network byte order
+    uint32_t         u32Mask;       ///< Netmask, network byte order
+    uint32_t         u32GW;         ///< Gateway, network byte order
+
+} WiFiInfo;
+
+void   InitWiFi(void);
+void   WaitForIP(void);
+int8_t GetWiFiRSSI(void);
+void   GetWiFiInfo(WiFiInfo* pstInfo);
+bool   SetWiFiAddress(uint32_t u32IP, uint32_t u32Mask, uint32_t u32GW);
+bool   ForgetWiFi(void);
@@ -0,0 +1,111 @@
+/**
+ * @file       WiFiConnect.h
+ * @brief      WiFi connection strategy
+ * @details    Decides between direct connect, full scan and SmartConfig
+ * @ingroup    Firmware
+ * @author     SNESoIP contributors
+ * @copyright  "THE BEER-WARE LICENCE" (Revision 42)
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifndef WIFI_FAST_MS
+#define WIFI_FAST_MS          2000    // !< Timeout of a direct connect in ms
+#endif
+
+#ifndef WIFI_SCAN_MS
+#define WIFI_SCAN_MS          10000   // !< Timeout of a connect with full scan in ms
+#endif
+
+#ifndef WIFI_SMARTCONFIG_MS
+#define WIFI_SMARTCONFIG_MS   120000  // !< Time SmartConfig waits before the stored network is tried again
+#endif
+
+#define WIFI_SCAN_ATTEMPTS    3       // !< Full scans before SmartConfig is started
+#define WIFI_RETRY_MS         5000    // !< Pause between reconnects once connected
+
+#define WIFI_ACTION_NONE              0x00  // !< Nothing to do
+#define WIFI_ACTION_CONNECT_FAST      0x01  // !< Connect to the stored BSSID on the stored channel
+#define WIFI_ACTION_CONNECT_SCAN      0x02  // !< Connect to the stored SSID after a full scan
+#define WIFI_ACTION_SMARTCONFIG_START 0x04  // !< Start SmartConfig
+#define WIFI_ACTION_SMARTCONFIG_STOP  0x08  // !< Stop SmartConfig
+#define WIFI_ACTION_STORE             0x10  // !< Store credentials, BSSID, channel and lease
+
+/**
+ * @enum   WiFiConnectState
+ * @brief  Connection state
+ */
+typedef enum
+{
+    WIFI_STATE_IDLE = 0,     ///< Not started
+    WIFI_STATE_FAST,         ///< Direct connect to the stored BSSID
+    WIFI_STATE_SCAN,         ///< Connect after a full scan
+    WIFI_STATE_SMARTCONFIG,  ///< Waiting for credentials
+    WIFI_STATE_BACKOFF,      ///< Waiting before the next reconnect
+    WIFI_STATE_CONNECTED     ///< Connected with IP
+
+} WiFiConnectState;
+
+/**
+ * @enum   WiFiConnectEvent
+ * @brief  Input of the connection state machine
+ */
+typedef enum
+{
+    WIFI_CONNECT_START = 0,        ///< Station started
+    WIFI_CONNECT_GOT_IP,           ///< Got an IP address
+    WIFI_CONNECT_NO_AP,            ///< Disconnected, access point not found
+    WIFI_CONNECT_AUTH_FAILED,      ///< Disconnected, authentication failed
+    WIFI_CONNECT_LOST,             ///< Disconnected for any other reason
+    WIFI_CONNECT_PROVISIONED,      ///< SmartConfig received credentials
+    WIFI_CONNECT_SMARTCONFIG_DONE, ///< SmartConfig acknowledged the credentials
+    WIFI_CONNECT_TICK              ///< Time passed
+
+} WiFiConnectEvent;
+
+/**
+ * @typedef  WiFiConnectStats
+ * @brief    Connection statistics
+ * @struct   WiFiConnectStats_t
+ * @brief    Connection statistics structure
+ */
+typedef struct WiFiConnectStats_t
+{
+    WiFiConnectState eReadyPath;     ///< State the first IP was obtained in
+    uint32_t         u32ReadyMs;     ///< Boot to first IP in ms, 0 = not yet
+    uint32_t         u32ConnectMs;   ///< Duration of the last (re)connect in ms
+    uint32_t         u32Fast;        ///< Direct connects tried
+    uint32_t         u32FastFails;   ///< Direct connects failed
+    uint32_t         u32Scans;       ///< Connects with full scan tried
+    uint32_t         u32ScanFails;   ///< Connects with full scan failed
+    uint32_t         u32SmartConfig; ///< SmartConfig runs
+    uint32_t         u32Lost;        ///< Connections lost
+
+} WiFiConnectStats;
+
+/**
+ * @typedef  WiFiConnect
+ * @brief    Connection state machine
+ * @struct   WiFiConnect_t
+ * @brief    Connection state machine structure
+ */
+typedef struct WiFiConnect_t
+{
+    WiFiConnectState eState;          ///< Connection state
+    bool             bCredentials;    ///< SSID and password are known
+    bool             bBSSID;          ///< BSSID and channel are known
+    bool             bWasConnected;   ///< Had an IP since boot
+    bool             bSmartConfig;    ///< SmartConfig is running
+    bool             bProvisioned;    ///< SmartConfig delivered credentials
+    uint8_t          u8Attempt;       ///< Full scans in a row
+    int64_t          s64Deadline;     ///< End of the current state in µs, 0 = none
+    int64_t          s64Since;        ///< Start of the current (re)connect in µs
+    WiFiConnectStats stStats;         ///< Statistics
+
+} WiFiConnect;
+
+void        InitWiFiConnect(WiFiConnect* pstConnect, bool bCredentials, bool bBSSID);
+uint8_t     WiFiConnectHandle(WiFiConnect* pstConnect, WiFiConnectEvent eEvent, int64_t s64Now);
+const char* WiFiConnectStateName(WiFiConnectState eState);
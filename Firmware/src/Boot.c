@@ -0,0 +1,174 @@
+/**
+ * @file       Boot.c
+ * @brief      Boot sequencing
+ * @ingroup    Firmware
+ * @details
+ * @code{.unparsed}
+ *
+ * Every subsystem announces the stages it reached with SetBootStage(),
+ * and tasks that depend on a stage block in WaitForBootStage() at the
+ * top of their thread.  So app_main() only has to start things and
+ * never waits for the network:
+ *
+ *   app_main       WiFiStartThread   SNESStartThread   network threads
+ *   --------       ---------------   ---------------   ---------------
+ *   start WiFi --> NVS, WiFi driver
+ *   start SNES ----------------------> SNES, movie
+ *   wait for   <---+  | connect           |
+ *   NVS, SNES  <------|-------------------+
+ *   start network     |                                wait for IP
+ *   threads           | IP  ------------------------>  exchange server,
+ *                                                      discovery
+ *
+ * Each stage is logged once with its time since start-up and since
+ * the previous stage, which gives the boot timeline.
+ *
+ * @endcode
+ * @author     SNESoIP contributors
+ * @copyright  "THE BEER-WARE LICENCE" (Revision 42)
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "Boot.h"
+
+/**
+ * @struct  Boot
+ * @brief   Boot sequencing data
+ */
+typedef struct Boot_t
+{
+    EventGroupHandle_t hEventGroup;
+    portMUX_TYPE       stMux;                     ///< Guards the fields below
+    uint32_t           u32Reached;                ///< Stages reached
+    uint32_t           u32LastMs;                 ///< Time of the latest stage in ms
+    uint32_t           au32StageMs[BOOT_STAGES];  ///< Time of each stage since start-up in ms
+
+} Boot;
+
+/**
+ * @var    _stBoot
+ * @brief  Boot sequencing private data
+ */
+static Boot _stBoot;
+
+static const char* const _apacStageName[BOOT_STAGES] = { "nvs", "snes", "wifi", "ip", "exchange" };
+
+static uint8_t _BootStageIndex(uint32_t u32Stage);
+
+/**
+ * @fn     void InitBoot(void)
+ * @brief  Initialise boot sequencing
+ * @note   Has to be called first thing in app_main().
+ */
+void InitBoot(void)
+{
+    memset(&_stBoot, 0, sizeof(struct Boot_t));
+    vPortCPUInitializeMutex(&_stBoot.stMux);
+    _stBoot.hEventGroup = xEventGroupCreate();
+}
+
+/**
+ * @fn     void SetBootStage(uint32_t u32Stage)
+ * @brief  Announce that a stage has been reached
+ * @param  u32Stage
+ *         One BOOT_STAGE_* flag; stages reached before are ignored
+ */
+void SetBootStage(uint32_t u32Stage)
+{
+    uint8_t  u8Index = _BootStageIndex(u32Stage);
+    uint32_t u32Ms   = (uint32_t)(esp_timer_get_time() / 1000);
+    uint32_t u32Delta;
+
+    if (u8Index >= BOOT_STAGES)
+    {
+        return;
+    }
+
+    portENTER_CRITICAL(&_stBoot.stMux);
+    if (_stBoot.u32Reached & u32Stage)
+    {
+        portEXIT_CRITICAL(&_stBoot.stMux);
+        return;
+    }
+    _stBoot.u32Reached          |= u32Stage;
+    _stBoot.au32StageMs[u8Index] = u32Ms;
+    u32Delta                     = u32Ms - _stBoot.u32LastMs;
+    _stBoot.u32LastMs            = u32Ms;
+    portEXIT_CRITICAL(&_stBoot.stMux);
+
+    ESP_LOGI("Boot", "%-8s %6u ms (+%u)", _apacStageName[u8Index], u32Ms, u32Delta);
+    xEventGroupSetBits(_stBoot.hEventGroup, u32Stage);
+}
+
+/**
+ * @fn     void WaitForBootStage(uint32_t u32Stages)
+ * @brief  Wait until all given stages have been reached (blocking)
+ * @param  u32Stages
+ *         BOOT_STAGE_* flags
+ */
+void WaitForBootStage(uint32_t u32Stages)
+{
+    xEventGroupWaitBits(_stBoot.hEventGroup, u32Stages, false, true, portMAX_DELAY);
+}
+
+/**
+ * @fn      uint32_t GetBootStages(void)
+ * @brief   Get the stages reached so far
+ * @return  BOOT_STAGE_* flags
+ */
+uint32_t GetBootStages(void)
+{
+    uint32_t u32Reached;
+
+    portENTER_CRITICAL(&_stBoot.stMux);
+    u32Reached = _stBoot.u32Reached;
+    portEXIT_CRITICAL(&_stBoot.stMux);
+
+    return u32Reached;
+}
+
+/**
+ * @fn      uint32_t GetBootStageMs(uint32_t u32Stage)
+ * @brief   Get the time a stage has been reached
+ * @param   u32Stage
+ *          One BOOT_STAGE_* flag
+ * @return  Time since start-up in ms, 0 = not reached
+ */
+uint32_t GetBootStageMs(uint32_t u32Stage)
+{
+    uint8_t  u8Index = _BootStageIndex(u32Stage);
+    uint32_t u32Ms   = 0;
+
+    if (u8Index < BOOT_STAGES)
+    {
+        portENTER_CRITICAL(&_stBoot.stMux);
+        u32Ms = _stBoot.au32StageMs[u8Index];
+        portEXIT_CRITICAL(&_stBoot.stMux);
+    }
+    return u32Ms;
+}
+
+/**
+ * @fn      uint8_t _BootStageIndex(uint32_t u32Stage)
+ * @brief   Get the index of a stage
+ * @param   u32Stage
+ *          One BOOT_STAGE_* flag
+ * @return  Index, BOOT_STAGES if invalid
+ */
+static uint8_t _BootStageIndex(uint32_t u32Stage)
+{
+    for (uint8_t u8Index = 0; u8Index < BOOT_STAGES; u8Index++)
+    {
+        if ((1UL << u8Index) == u32Stage)
+        {
+            return u8Index;
+        }
+    }
+    return BOOT_STAGES;
+}
@@ -0,0 +1,522 @@
+/**
+ * @file       ClockSync.c
+ * @brief      Peer clock synchronisation
+ * @ingroup    Firmware
+ * @details
+ * @code{.unparsed}
+ *
+ * Both consoles run their own frame clock, 60.098 Hz (NTSC) or
+ * 50.007 Hz (PAL), each off its own crystal.  Without correction the
+ * remote words arrive a little earlier or later every frame until one
+ * misses its latch.
+ *
+ * Clock offset, NTP-style: each input packet carries the sender's
+ * transmit time and the time it held the acknowledged packet (see
+ * NetplayProtocol.c), which gives the four timestamps
+ *
+ *   T1  local send         T2  remote receive
+ *   T3  remote send        T4  local receive
+ *
+ *   offset = ((T2 - T1) + (T3 - T4)) / 2
+ *   delay  =  (T4 - T1) - (T3 - T2)
+ *
+ * Queueing only ever adds delay, so of all samples within
+ * CLOCKSYNC_EPOCH_MS the one with the lowest delay is kept.  A
+ * least-squares line through the last CLOCKSYNC_POINTS of these gives
+ * the offset and the drift of the remote clock.
+ *
+ * Frame clocks: the latch edge of the newest frame is part of every
+ * packet as well.  Remote latches are converted to local time, so both
+ * consoles are measured against the same clock.  Each frame period is
+ * taken over CLOCKSYNC_SPAN_FRAMES frames, which averages out the
+ * timestamp jitter.
+ *
+ * Alignment: the remote word of frame F is presented at the local
+ * latch of the frame it is queued for.  Its slack is the predicted
+ * time between its arrival and that latch:
+ *
+ *   slack = latch(F) - (remote latch(F) + latch-to-receive + 4 * var)
+ *
+ * The slack is kept between the configured input delay and one and a
+ * half frames more, so that a single adjustment never has to be taken
+ * back.  If the frame clocks drift apart, one word is repeated or
+ * dropped before a frame is actually missed, at most once per
+ * CLOCKSYNC_SLIP_MS.  The variation is smoothed more than in RFC 6298,
+ * as it only has to follow the network, not single packets.
+ *
+ * No sockets or FreeRTOS calls are used here, so the same code runs on
+ * the adapter and in the host simulation (Tools/ClockSyncSim).
+ *
+ * @endcode
+ * @author     SNESoIP contributors
+ * @copyright  "THE BEER-WARE LICENCE" (Revision 42)
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "ClockSync.h"
+
+static int64_t _ClockSyncOffsetAt(const ClockSync* pstClock, int64_t s64Local);
+static void    _ClockSyncAddPoint(ClockSync* pstClock, const ClockSyncPoint* pstPoint);
+static void    _ClockSyncFit(ClockSync* pstClock);
+static void    _ClockSyncRestart(ClockSync* pstClock);
+static bool    _ClockSyncLatchAdd(ClockSyncLatch* pstLatch, uint32_t u32Frame, int64_t s64Time);
+static int64_t _ClockSyncLatchTime(const ClockSyncLatch* pstLatch, uint32_t u32Frame);
+
+/**
+ * @fn     void InitClockSync(ClockSync* pstClock)
+ * @brief  Initialise clock synchronisation
+ * @param  pstClock
+ *         Clock synchronisation state
+ */
+void InitClockSync(ClockSync* pstClock)
+{
+    memset(pstClock, 0, sizeof(struct ClockSync_t));
+}
+
+/**
+ * @fn      int64_t ClockSyncRemoteTime(ClockSync* pstClock, uint32_t u32Remote)
+ * @brief   Extend a 32-bit remote timestamp
+ * @param   pstClock
+ *          Clock synchronisation state
+ * @param   u32Remote
+ *          Remote time in µs, truncated to 32 bits
+ * @return  Remote time in µs
+ */
+int64_t ClockSyncRemoteTime(ClockSync* pstClock, uint32_t u32Remote)
+{
+    int64_t s64Remote;
+
+    if (! pstClock->bRemoteValid)
+    {
+        pstClock->bRemoteValid = true;
+        pstClock->s64Remote    = u32Remote;
+        return pstClock->s64Remote;
+    }
+
+    s64Remote = pstClock->s64Remote + (int32_t)(u32Remote - (uint32_t)pstClock->s64Remote);
+    if (s64Remote > pstClock->s64Remote)
+    {
+        pstClock->s64Remote = s64Remote;
+    }
+
+    return s64Remote;
+}
+
+/**
+ * @fn     void ClockSyncAddSample(ClockSync* pstClock, int64_t s64Sent, int64_t s64Received, int64_t s64RemoteRx, int64_t s64RemoteTx)
+ * @brief  Add an offset sample
+ * @param  pstClock
+ *         Clock synchronisation state
+ * @param  s64Sent
+ *         Local send time of the acknowledged packet in µs (T1)
+ * @param  s64Received
+ *         Local receive time of the acknowledgement in µs (T4)
+ * @param  s64RemoteRx
+ *         Remote receive time of the acknowledged packet in µs (T2)
+ * @param  s64RemoteTx
+ *         Remote send time of the acknowledgement in µs (T3)
+ */
+void ClockSyncAddSample(ClockSync* pstClock, int64_t s64Sent, int64_t s64Received, int64_t s64RemoteRx, int64_t s64RemoteTx)
+{
+    ClockSyncPoint stPoint;
+    int64_t        s64Delay = (s64Received - s64Sent) - (s64RemoteTx - s64RemoteRx);
+
+    if (s64Delay < 0)
+    {
+        return;
+    }
+
+    stPoint.s64Local  = s64Sent + (s64Received - s64Sent) / 2;
+    stPoint.s64Offset = ((s64RemoteRx - s64Sent) + (s64RemoteTx - s64Received)) / 2;
+    stPoint.u32Delay  = s64Delay < UINT32_MAX ? (uint32_t)s64Delay : UINT32_MAX;
+    pstClock->stStats.u32Samples++;
+
+    if (! pstClock->bEpochValid)
+    {
+        pstClock->bEpochValid   = true;
+        pstClock->s64EpochStart = stPoint.s64Local;
+        pstClock->stEpochBest   = stPoint;
+    }
+    else if (stPoint.u32Delay < pstClock->stEpochBest.u32Delay)
+    {
+        pstClock->stEpochBest = stPoint;
+    }
+
+    // Until the first epoch is complete, go with the best sample so far.
+    if (0 == pstClock->u8Points)
+    {
+        pstClock->bValid       = true;
+        pstClock->s64RefLocal  = pstClock->stEpochBest.s64Local;
+        pstClock->s64RefOffset = pstClock->stEpochBest.s64Offset;
+        pstClock->s32DriftPpb  = 0;
+    }
+
+    if ((stPoint.s64Local - pstClock->s64EpochStart) >= CLOCKSYNC_EPOCH_MS * 1000LL)
+    {
+        pstClock->bEpochValid = false;
+        _ClockSyncAddPoint(pstClock, &pstClock->stEpochBest);
+    }
+
+    pstClock->stStats.s64Offset   = pstClock->s64RefOffset;
+    pstClock->stStats.s32DriftPpb = pstClock->s32DriftPpb;
+}
+
+/**
+ * @fn      int64_t ClockSyncToLocal(const ClockSync* pstClock, int64_t s64Remote)
+ * @brief   Convert a remote timestamp to local time
+ * @param   pstClock
+ *          Clock synchronisation state
+ * @param   s64Remote
+ *          Remote time in µs
+ * @return  Local time in µs
+ */
+int64_t ClockSyncToLocal(const ClockSync* pstClock, int64_t s64Remote)
+{
+    return s64Remote - _ClockSyncOffsetAt(pstClock, s64Remote - pstClock->s64RefOffset);
+}
+
+/**
+ * @fn     void ClockSyncAddLocalLatch(ClockSync* pstClock, uint32_t u32Frame, int64_t s64Time)
+ * @brief  Add a latch edge of the local console
+ * @param  pstClock
+ *         Clock synchronisation state
+ * @param  u32Frame
+ *         Local frame number
+ * @param  s64Time
+ *         Local time of the latch in µs
+ */
+void ClockSyncAddLocalLatch(ClockSync* pstClock, uint32_t u32Frame, int64_t s64Time)
+{
+    _ClockSyncLatchAdd(&pstClock->stLocal, u32Frame, s64Time);
+}
+
+/**
+ * @fn     void ClockSyncAddRemoteLatch(ClockSync* pstClock, uint32_t u32Frame, int64_t s64Remote, int64_t s64Received)
+ * @brief  Add a latch edge of the remote console
+ * @param  pstClock
+ *         Clock synchronisation state
+ * @param  u32Frame
+ *         Remote frame number
+ * @param  s64Remote
+ *         Remote time of the latch in µs
+ * @param  s64Received
+ *         Local receive time of the packet in µs
+ */
+void ClockSyncAddRemoteLatch(ClockSync* pstClock, uint32_t u32Frame, int64_t s64Remote, int64_t s64Received)
+{
+    ClockSyncStats* pstStats = &pstClock->stStats;
+    int64_t         s64Latch;
+    uint32_t        u32Sample;
+    uint32_t        u32Diff;
+
+    if (! pstClock->bValid)
+    {
+        return;
+    }
+
+    s64Latch = ClockSyncToLocal(pstClock, s64Remote);
+    if (! _ClockSyncLatchAdd(&pstClock->stRemote, u32Frame, s64Latch))
+    {
+        return;
+    }
+
+    // Smoothed like the round-trip time in RFC 6298, but slower.
+    u32Sample = s64Received > s64Latch ? (uint32_t)(s64Received - s64Latch) : 0;
+    if (0 == pstStats->u32LatchToRx)
+    {
+        pstStats->u32LatchToRx    = u32Sample ? u32Sample : 1;
+        pstClock->u32LatchToRxVar = u32Sample / 2;
+        return;
+    }
+    u32Diff = u32Sample > pstStats->u32LatchToRx ? u32Sample - pstStats->u32LatchToRx : pstStats->u32LatchToRx - u32Sample;
+    pstClock->u32LatchToRxVar += ((int32_t)u32Diff - (int32_t)pstClock->u32LatchToRxVar) / 16;
+    pstStats->u32LatchToRx    += ((int32_t)u32Sample - (int32_t)pstStats->u32LatchToRx) / 8;
+}
+
+/**
+ * @fn       int8_t ClockSyncAlign(ClockSync* pstClock, uint32_t u32PlayFrame, int64_t s64PlayTime, uint8_t u8Delay, int64_t s64Now)
+ * @brief    Check whether the remote input delay needs adjustment
+ * @details  Has to be called once per local frame.
+ * @param    pstClock
+ *           Clock synchronisation state
+ * @param    u32PlayFrame
+ *           Remote frame presented last
+ * @param    s64PlayTime
+ *           Local latch time at which u32PlayFrame was presented in µs
+ * @param    u8Delay
+ *           Configured input delay in frames
+ * @param    s64Now
+ *           Current time in µs
+ * @return   Delay adjustment in frames
+ * @retval    1 = Repeat one word
+ * @retval    0 = No adjustment
+ * @retval   -1 = Drop one word
+ */
+int8_t ClockSyncAlign(ClockSync* pstClock, uint32_t u32PlayFrame, int64_t s64PlayTime, uint8_t u8Delay, int64_t s64Now)
+{
+    ClockSyncLatch* pstLocal  = &pstClock->stLocal;
+    ClockSyncLatch* pstRemote = &pstClock->stRemote;
+    ClockSyncStats* pstStats  = &pstClock->stStats;
+    int64_t         s64Period;
+    int64_t         s64Deadline;
+    int64_t         s64Arrival;
+    int64_t         s64Low;
+    int8_t          s8Slip = 0;
+
+    if (! pstClock->bValid || 0 == pstLocal->u32PeriodQ8 || 0 == pstRemote->u32PeriodQ8 || 0 == pstStats->u32LatchToRx)
+    {
+        return 0;
+    }
+
+    // Either console stopped latching.
+    s64Period = pstLocal->u32PeriodQ8 / 256;
+    if ((s64Now - s64PlayTime) > 4 * s64Period || (s64Now - pstRemote->s64Time) > 4 * s64Period)
+    {
+        return 0;
+    }
+
+    s64Deadline = s64PlayTime + ((int64_t)(int32_t)(pstRemote->u32Frame - u32PlayFrame) * pstLocal->u32PeriodQ8) / 256;
+    s64Arrival  = _ClockSyncLatchTime(pstRemote, pstRemote->u32Frame)
+        + pstStats->u32LatchToRx + 4 * (int64_t)pstClock->u32LatchToRxVar;
+
+    pstStats->s32Slack        = (int32_t)(s64Deadline - s64Arrival);
+    pstStats->s32FrameSkewPpm = (int32_t)(((int64_t)pstLocal->u32PeriodQ8 - (int64_t)pstRemote->u32PeriodQ8) * 1000000
+        / (int64_t)pstRemote->u32PeriodQ8);
+
+    if (0 != pstClock->s64LastSlip && (s64Now - pstClock->s64LastSlip) < CLOCKSYNC_SLIP_MS * 1000LL)
+    {
+        return 0;
+    }
+
+    s64Low = (int64_t)u8Delay * s64Period;
+    if (pstStats->s32Slack < s64Low)
+    {
+        s8Slip = 1;
+    }
+    else if (pstStats->s32Slack > s64Low + s64Period + s64Period / 2)
+    {
+        s8Slip = -1;
+    }
+
+    if (0 != s8Slip)
+    {
+        pstClock->s64LastSlip = s64Now;
+        pstStats->u32Slips++;
+    }
+
+    return s8Slip;
+}
+
+/**
+ * @fn      int64_t _ClockSyncOffsetAt(const ClockSync* pstClock, int64_t s64Local)
+ * @brief   Get the estimated offset at a given time
+ * @param   pstClock
+ *          Clock synchronisation state
+ * @param   s64Local
+ *          Local time in µs
+ * @return  Remote minus local time in µs
+ */
+static int64_t _ClockSyncOffsetAt(const ClockSync* pstClock, int64_t s64Local)
+{
+    return pstClock->s64RefOffset + ((s64Local - pstClock->s64RefLocal) * pstClock->s32DriftPpb) / 1000000000LL;
+}
+
+/**
+ * @fn     void _ClockSyncAddPoint(ClockSync* pstClock, const ClockSyncPoint* pstPoint)
+ * @brief  Add the filtered offset of an epoch
+ * @param  pstClock
+ *         Clock synchronisation state
+ * @param  pstPoint
+ *         Sample with the lowest delay in the epoch
+ */
+static void _ClockSyncAddPoint(ClockSync* pstClock, const ClockSyncPoint* pstPoint)
+{
+    if (pstClock->u8Points > 0)
+    {
+        int64_t s64Error = pstPoint->s64Offset - _ClockSyncOffsetAt(pstClock, pstPoint->s64Local);
+
+        // The peer has restarted or its clock has been set.
+        if (s64Error < 0)
+        {
+            s64Error = -s64Error;
+        }
+        if (s64Error > CLOCKSYNC_STEP_US + (int64_t)pstPoint->u32Delay / 2)
+        {
+            _ClockSyncRestart(pstClock);
+        }
+    }
+
+    pstClock->astPoints[pstClock->u8NextPoint] = *pstPoint;
+    pstClock->u8NextPoint = (pstClock->u8NextPoint + 1) % CLOCKSYNC_POINTS;
+    if (pstClock->u8Points < CLOCKSYNC_POINTS)
+    {
+        pstClock->u8Points++;
+    }
+
+    _ClockSyncFit(pstClock);
+}
+
+/**
+ * @fn       void _ClockSyncFit(ClockSync* pstClock)
+ * @brief    Fit offset and drift to the filtered offsets
+ * @details  Least squares, relative to the first point so that the
+ *           sums fit into 64 bits.
+ * @param    pstClock
+ *           Clock synchronisation state
+ */
+static void _ClockSyncFit(ClockSync* pstClock)
+{
+    const ClockSyncPoint* pstFirst = &pstClock->astPoints[0];
+    int64_t               s64SumX  = 0;
+    int64_t               s64SumY  = 0;
+    int64_t               s64SumXX = 0;
+    int64_t               s64SumXY = 0;
+    int64_t               s64MeanX;
+    int64_t               s64MeanY;
+    int64_t               s64Drift = 0;
+
+    for (uint8_t u8Index = 0; u8Index < pstClock->u8Points; u8Index++)
+    {
+        s64SumX += pstClock->astPoints[u8Index].s64Local  - pstFirst->s64Local;
+        s64SumY += pstClock->astPoints[u8Index].s64Offset - pstFirst->s64Offset;
+    }
+    s64MeanX = s64SumX / pstClock->u8Points;
+    s64MeanY = s64SumY / pstClock->u8Points;
+
+    for (uint8_t u8Index = 0; u8Index < pstClock->u8Points; u8Index++)
+    {
+        int64_t s64X = pstClock->astPoints[u8Index].s64Local  - pstFirst->s64Local  - s64MeanX;
+        int64_t s64Y = pstClock->astPoints[u8Index].s64Offset - pstFirst->s64Offset - s64MeanY;
+
+        s64SumXX += s64X * s64X;
+        s64SumXY += s64X * s64Y;
+    }
+
+    if (s64SumXX >= 10000)
+    {
+        s64Drift = (s64SumXY * 100000) / (s64SumXX / 10000);
+    }
+    if (s64Drift > CLOCKSYNC_MAX_PPM * 1000LL)
+    {
+        s64Drift = CLOCKSYNC_MAX_PPM * 1000LL;
+    }
+    else if (s64Drift < -CLOCKSYNC_MAX_PPM * 1000LL)
+    {
+        s64Drift = -CLOCKSYNC_MAX_PPM * 1000LL;
+    }
+
+    pstClock->bValid       = true;
+    pstClock->s64RefLocal  = pstFirst->s64Local  + s64MeanX;
+    pstClock->s64RefOffset = pstFirst->s64Offset + s64MeanY;
+    pstClock->s32DriftPpb  = (int32_t)s64Drift;
+}
+
+/**
+ * @fn     void _ClockSyncRestart(ClockSync* pstClock)
+ * @brief  Discard everything derived from the remote clock
+ * @param  pstClock
+ *         Clock synchronisation state
+ */
+static void _ClockSyncRestart(ClockSync* pstClock)
+{
+    pstClock->bRemoteValid             = false;
+    pstClock->u8Points                 = 0;
+    pstClock->u8NextPoint              = 0;
+    pstClock->u32LatchToRxVar          = 0;
+    pstClock->stStats.u32LatchToRx     = 0;
+    pstClock->stStats.u32Steps++;
+    memset(&pstClock->stRemote, 0, sizeof(ClockSyncLatch));
+}
+
+/**
+ * @fn      bool _ClockSyncLatchAdd(ClockSyncLatch* pstLatch, uint32_t u32Frame, int64_t s64Time)
+ * @brief   Add a latch edge to a frame clock
+ * @param   pstLatch
+ *          Frame clock
+ * @param   u32Frame
+ *          Frame number
+ * @param   s64Time
+ *          Local time of the latch in µs
+ * @return  Status
+ * @retval  true  = New frame
+ * @retval  false = Frame already known
+ */
+static bool _ClockSyncLatchAdd(ClockSyncLatch* pstLatch, uint32_t u32Frame, int64_t s64Time)
+{
+    uint32_t u32Span;
+
+    if (pstLatch->bValid)
+    {
+        int32_t s32Frames = (int32_t)(u32Frame - pstLatch->u32Frame);
+        int64_t s64Period;
+
+        if (s32Frames <= 0)
+        {
+            return false;
+        }
+
+        // The console has been paused or reset, start over.
+        s64Period = (s64Time - pstLatch->s64Time) / s32Frames;
+        if (s64Period < CLOCKSYNC_PERIOD_MIN || s64Period > CLOCKSYNC_PERIOD_MAX)
+        {
+            pstLatch->bValid = false;
+        }
+    }
+
+    if (! pstLatch->bValid)
+    {
+        pstLatch->bValid         = true;
+        pstLatch->bMidValid      = false;
+        pstLatch->u32Frame       = u32Frame;
+        pstLatch->s64Time        = s64Time;
+        pstLatch->u32AnchorFrame = u32Frame;
+        pstLatch->s64AnchorTime  = s64Time;
+        return true;
+    }
+
+    pstLatch->u32Frame = u32Frame;
+    pstLatch->s64Time  = s64Time;
+
+    // The span slides in halves, so it is always at least
+    // CLOCKSYNC_SPAN_FRAMES long once warmed up.
+    u32Span = u32Frame - pstLatch->u32AnchorFrame;
+    if (u32Span >= 2 * CLOCKSYNC_SPAN_FRAMES && pstLatch->bMidValid)
+    {
+        pstLatch->u32AnchorFrame = pstLatch->u32MidFrame;
+        pstLatch->s64AnchorTime  = pstLatch->s64MidTime;
+        pstLatch->bMidValid      = false;
+        u32Span                  = u32Frame - pstLatch->u32AnchorFrame;
+    }
+    if (u32Span >= CLOCKSYNC_SPAN_FRAMES && ! pstLatch->bMidValid)
+    {
+        pstLatch->bMidValid   = true;
+        pstLatch->u32MidFrame = u32Frame;
+        pstLatch->s64MidTime  = s64Time;
+    }
+
+    // One second is enough for a first estimate.
+    if (u32Span >= 60)
+    {
+        pstLatch->u32PeriodQ8 = (uint32_t)(((s64Time - pstLatch->s64AnchorTime) * 256) / u32Span);
+    }
+
+    return true;
+}
+
+/**
+ * @fn      int64_t _ClockSyncLatchTime(const ClockSyncLatch* pstLatch, uint32_t u32Frame)
+ * @brief   Get the predicted latch time of a frame
+ * @param   pstLatch
+ *          Frame clock
+ * @param   u32Frame
+ *          Frame number
+ * @return  Local time in µs
+ */
+static int64_t _ClockSyncLatchTime(const ClockSyncLatch* pstLatch, uint32_t u32Frame)
+{
+    return pstLatch->s64AnchorTime
+        + ((int64_t)(int32_t)(u32Frame - pstLatch->u32AnchorFrame) * pstLatch->u32PeriodQ8) / 256;
+}
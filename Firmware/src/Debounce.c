@@ -0,0 +1,139 @@
+/**
+ * @file       Debounce.c
+ * @brief      Input debouncer
+ * @ingroup    Firmware
+ * @details
+ * @code{.unparsed}
+ *
+ * Every button has its own counter which is incremented for each
+ * sample that differs from the debounced state, and cleared as soon as
+ * a sample agrees with it again.  A button only changes its debounced
+ * state once its counter reaches the filter depth.
+ *
+ * The depth is a number of samples, what it filters depends on the
+ * sample period P.  A glitch shorter than (depth - 1) * P covers at most
+ * depth - 1 samples and never gets through; a change that lasts depth
+ * * P is always passed on, after at most that time.  DebounceDepth()
+ * picks the depth for a given glitch length and period.
+ *
+ * The counters are stored as a vertical counter: entry n of au16Count
+ * holds bit n of all 16 counters.  This way the whole controller word
+ * is processed at once with a handful of bitwise operations and a
+ * noisy button can't hold back the others.
+ *
+ * @endcode
+ * @author     SNESoIP contributors
+ * @copyright  "THE BEER-WARE LICENCE" (Revision 42)
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "Debounce.h"
+
+/**
+ * @fn     void InitDebounce(Debounce* pstDebounce, uint16_t u16Initial, uint8_t u8Depth)
+ * @brief  Initialise debouncer
+ * @param  pstDebounce
+ *         Debouncer state
+ * @param  u16Initial
+ *         Initial debounced controller word
+ * @param  u8Depth
+ *         Consecutive samples required for a change
+ */
+void InitDebounce(Debounce* pstDebounce, uint16_t u16Initial, uint8_t u8Depth)
+{
+    memset(pstDebounce, 0, sizeof(struct Debounce_t));
+    pstDebounce->u16State = u16Initial;
+    SetDebounceDepth(pstDebounce, u8Depth);
+}
+
+/**
+ * @fn     void SetDebounceDepth(Debounce* pstDebounce, uint8_t u8Depth)
+ * @brief  Set filter depth
+ * @param  pstDebounce
+ *         Debouncer state
+ * @param  u8Depth
+ *         Consecutive samples required for a change, clamped to
+ *         1..DEBOUNCE_DEPTH_MAX
+ */
+void SetDebounceDepth(Debounce* pstDebounce, uint8_t u8Depth)
+{
+    if (u8Depth < 1)
+    {
+        u8Depth = 1;
+    }
+    if (u8Depth > DEBOUNCE_DEPTH_MAX)
+    {
+        u8Depth = DEBOUNCE_DEPTH_MAX;
+    }
+
+    pstDebounce->u8Depth      = u8Depth;
+    pstDebounce->au16Count[0] = 0;
+    pstDebounce->au16Count[1] = 0;
+    pstDebounce->au16Count[2] = 0;
+}
+
+/**
+ * @fn      uint8_t DebounceDepth(uint32_t u32RejectUs, uint32_t u32PeriodUs)
+ * @brief   Get the filter depth that rejects glitches of a given length
+ * @param   u32RejectUs
+ *          Glitches shorter than this are rejected, in µs
+ * @param   u32PeriodUs
+ *          Sample period in µs
+ * @return  Filter depth, clamped to 1..DEBOUNCE_DEPTH_MAX
+ */
+uint8_t DebounceDepth(uint32_t u32RejectUs, uint32_t u32PeriodUs)
+{
+    uint32_t u32Depth;
+
+    if (0 == u32PeriodUs)
+    {
+        return DEBOUNCE_DEPTH_MAX;
+    }
+    u32Depth = (u32RejectUs + u32PeriodUs - 1) / u32PeriodUs + 1;
+
+    return u32Depth > DEBOUNCE_DEPTH_MAX ? DEBOUNCE_DEPTH_MAX : (uint8_t)u32Depth;
+}
+
+/**
+ * @fn      uint16_t DebounceInput(Debounce* pstDebounce, uint16_t u16Sample)
+ * @brief   Feed a sample into the debouncer
+ * @param   pstDebounce
+ *          Debouncer state
+ * @param   u16Sample
+ *          Raw controller word
+ * @return  Debounced controller word
+ */
+uint16_t DebounceInput(Debounce* pstDebounce, uint16_t u16Sample)
+{
+    uint16_t* pu16Count = pstDebounce->au16Count;
+    uint16_t  u16Delta  = u16Sample ^ pstDebounce->u16State;
+    uint16_t  u16Carry;
+    uint16_t  u16Match;
+    uint16_t  u16Toggle;
+
+    // Clear the counters of all buttons agreeing with the state.
+    pu16Count[0] &= u16Delta;
+    pu16Count[1] &= u16Delta;
+    pu16Count[2] &= u16Delta;
+
+    // Increment the counters of all other buttons.
+    u16Carry      = pu16Count[0] & u16Delta;
+    pu16Count[0] ^= u16Delta;
+    pu16Count[2] ^= pu16Count[1] & u16Carry;
+    pu16Count[1] ^= u16Carry;
+
+    // Compare each counter against the filter depth.
+    u16Match  = pu16Count[0] ^ ((pstDebounce->u8Depth & 1) ? 0xffff : 0);
+    u16Match |= pu16Count[1] ^ ((pstDebounce->u8Depth & 2) ? 0xffff : 0);
+    u16Match |= pu16Count[2] ^ ((pstDebounce->u8Depth & 4) ? 0xffff : 0);
+    u16Toggle = u16Delta & ~u16Match;
+
+    pstDebounce->u16State ^= u16Toggle;
+    pu16Count[0]          &= ~u16Toggle;
+    pu16Count[1]          &= ~u16Toggle;
+    pu16Count[2]          &= ~u16Toggle;
+
+    return pstDebounce->u16State;
+}
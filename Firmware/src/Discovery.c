@@ -0,0 +1,221 @@
+/**
+ * @file       Discovery.c
+ * @brief      LAN discovery
+ * @ingroup    Firmware
+ * @details    Announces the adapter by UDP broadcast and hands the
+ *             address of a paired adapter over to the input exchange.
+ *             The pairing logic is described in DiscoveryProtocol.c.
+ * @author     SNESoIP contributors
+ * @copyright  "THE BEER-WARE LICENCE" (Revision 42)
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "lwip/err.h"
+#include "lwip/sockets.h"
+#include "lwip/sys.h"
+#include "lwip/netdb.h"
+#include "Boot.h"
+#include "Discovery.h"
+#include "DiscoveryProtocol.h"
+#include "Netplay.h"
+#include "Tasks.h"
+
+/**
+ * @struct  DiscoveryClient
+ * @brief   LAN discovery data
+ */
+typedef struct DiscoveryClient_t
+{
+    bool      bIsRunning;
+    int       nSock;
+    uint32_t  u32PairedNonce;
+    Discovery stDiscovery;
+
+} DiscoveryClient;
+
+/**
+ * @var    _stDiscoveryClient
+ * @brief  LAN discovery private data
+ */
+static DiscoveryClient _stDiscoveryClient;
+
+static void _DiscoveryThread(void* pArg);
+static bool _DiscoveryOpenSocket(void);
+static void _DiscoverySend(int64_t s64Now);
+
+/**
+ * @fn     void InitDiscovery(void)
+ * @brief  Initialise LAN discovery
+ * @note   Has to be called after InitNetplay().
+ */
+void InitDiscovery(void)
+{
+    ESP_LOGI("Discovery", "Initialise LAN discovery.");
+    memset(&_stDiscoveryClient, 0, sizeof(struct DiscoveryClient_t));
+    _stDiscoveryClient.nSock = -1;
+    InitDiscoveryProtocol(&_stDiscoveryClient.stDiscovery, esp_random(), NETPLAY_PORT);
+    xTaskCreatePinnedToCore(
+        _DiscoveryThread, "DiscoveryThread", 3072, NULL,
+        TASK_PRIO_CONTROL, NULL, TASK_CORE_NET);
+}
+
+/**
+ * @fn     bool IsDiscoveryPaired(void)
+ * @brief  Check if an adapter on the LAN has been paired
+ */
+bool IsDiscoveryPaired(void)
+{
+    return DISCOVERY_PAIRED == _stDiscoveryClient.stDiscovery.eState;
+}
+
+/**
+ * @fn       void _DiscoveryThread(void* pArg)
+ * @brief    LAN discovery thread
+ * @details  Announcements are answered as soon as they arrive, so a
+ *           pairing takes one round trip once both adapters are up.
+ * @param    pArg
+ *           Unused
+ */
+static void _DiscoveryThread(void* pArg)
+{
+    Discovery* pstDiscovery = &_stDiscoveryClient.stDiscovery;
+    uint8_t    au8RxBuffer[DISCOVERY_PACKET_SIZE + 1];
+    (void)pArg;
+
+    // Broadcasts need an interface with an address.
+    WaitForBootStage(BOOT_STAGE_IP);
+
+    if (! _DiscoveryOpenSocket())
+    {
+        vTaskDelete(NULL);
+        return;
+    }
+
+    _stDiscoveryClient.bIsRunning = true;
+    while (_stDiscoveryClient.bIsRunning)
+    {
+        struct sockaddr_in stSourceAddr;
+        socklen_t          uAddrLen = sizeof(stSourceAddr);
+        struct timeval     stTimeout;
+        fd_set             stReadSet;
+        int64_t            s64Now;
+        int                nLen;
+
+        _DiscoverySend(esp_timer_get_time());
+
+        FD_ZERO(&stReadSet);
+        FD_SET(_stDiscoveryClient.nSock, &stReadSet);
+        stTimeout.tv_sec  = 0;
+        stTimeout.tv_usec = DISCOVERY_ANNOUNCE_MS * 1000 / 2;
+        if (0 >= select(_stDiscoveryClient.nSock + 1, &stReadSet, NULL, NULL, &stTimeout))
+        {
+            continue;
+        }
+
+        nLen = recvfrom(_stDiscoveryClient.nSock, au8RxBuffer, sizeof(au8RxBuffer), 0,
+                        (struct sockaddr*)&stSourceAddr, &uAddrLen);
+        if (0 >= nLen)
+        {
+            continue;
+        }
+        s64Now = esp_timer_get_time();
+
+        DiscoveryReceive(pstDiscovery, au8RxBuffer, (size_t)nLen,
+                         stSourceAddr.sin_addr.s_addr, ntohs(stSourceAddr.sin_port), s64Now);
+        _DiscoverySend(s64Now);
+
+        if (DISCOVERY_PAIRED == pstDiscovery->eState &&
+            _stDiscoveryClient.u32PairedNonce != pstDiscovery->u32PeerNonce)
+        {
+            _stDiscoveryClient.u32PairedNonce = pstDiscovery->u32PeerNonce;
+            ESP_LOGI("Discovery", "Paired with %s:%u",
+                     inet_ntoa(stSourceAddr.sin_addr), pstDiscovery->u16PeerPort);
+            SetNetplayPeer(pstDiscovery->u32PeerAddr, pstDiscovery->u16PeerPort);
+        }
+        else if (DISCOVERY_PAIRED != pstDiscovery->eState)
+        {
+            _stDiscoveryClient.u32PairedNonce = 0;
+        }
+    }
+
+    close(_stDiscoveryClient.nSock);
+    vTaskDelete(NULL);
+}
+
+/**
+ * @fn      bool _DiscoveryOpenSocket(void)
+ * @brief   Create and bind the broadcast socket
+ * @return  Status
+ * @retval  true  = OK
+ * @retval  false = Error
+ */
+static bool _DiscoveryOpenSocket(void)
+{
+    struct sockaddr_in stLocalAddr;
+    int                nSockOpt = 1;
+
+    _stDiscoveryClient.nSock = socket(AF_INET, SOCK_DGRAM, IPPROTO_IP);
+    if (0 > _stDiscoveryClient.nSock)
+    {
+        ESP_LOGE("Discovery", "Unable to create socket: errno %d", errno);
+        return false;
+    }
+    setsockopt(_stDiscoveryClient.nSock, SOL_SOCKET, SO_BROADCAST, &nSockOpt, sizeof(nSockOpt));
+    setsockopt(_stDiscoveryClient.nSock, SOL_SOCKET, SO_REUSEADDR, &nSockOpt, sizeof(nSockOpt));
+
+    memset(&stLocalAddr, 0, sizeof(stLocalAddr));
+    stLocalAddr.sin_addr.s_addr = htonl(INADDR_ANY);
+    stLocalAddr.sin_family      = AF_INET;
+    stLocalAddr.sin_port        = htons(DISCOVERY_PORT);
+    if (0 != bind(_stDiscoveryClient.nSock, (struct sockaddr*)&stLocalAddr, sizeof(stLocalAddr)))
+    {
+        ESP_LOGE("Discovery", "Couldn't bind name to socket: errno %d", errno);
+        close(_stDiscoveryClient.nSock);
+        _stDiscoveryClient.nSock = -1;
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * @fn     void _DiscoverySend(int64_t s64Now)
+ * @brief  Send all announcements that are due
+ * @param  s64Now
+ *         Current time in µs
+ */
+static void _DiscoverySend(int64_t s64Now)
+{
+    Discovery*         pstDiscovery = &_stDiscoveryClient.stDiscovery;
+    uint8_t            au8TxBuffer[DISCOVERY_PACKET_SIZE];
+    struct sockaddr_in stDestAddr;
+    bool               bUnicast;
+    size_t             uSize;
+
+    while (0 < (uSize = DiscoveryPoll(pstDiscovery, s64Now, au8TxBuffer, &bUnicast)))
+    {
+        memset(&stDestAddr, 0, sizeof(stDestAddr));
+        stDestAddr.sin_family = AF_INET;
+        if (bUnicast)
+        {
+            stDestAddr.sin_addr.s_addr = pstDiscovery->u32PeerAddr;
+            stDestAddr.sin_port        = htons(pstDiscovery->u16PeerSrcPort);
+        }
+        else
+        {
+            stDestAddr.sin_addr.s_addr = htonl(INADDR_BROADCAST);
+            stDestAddr.sin_port        = htons(DISCOVERY_PORT);
+        }
+
+        sendto(_stDiscoveryClient.nSock, au8TxBuffer, uSize, 0,
+               (struct sockaddr*)&stDestAddr, sizeof(stDestAddr));
+    }
+}
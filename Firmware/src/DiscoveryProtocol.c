@@ -0,0 +1,214 @@
+/**
+ * @file       DiscoveryProtocol.c
+ * @brief      LAN discovery protocol
+ * @ingroup    Firmware
+ * @details
+ * @code{.unparsed}
+ *
+ * Adapters on the same subnet find each other without the exchange
+ * server.  Each adapter announces itself by UDP broadcast:
+ *
+ *   +---+---+---+---+-----+-----+-------+-------+---------+
+ *   | 0 | 1 | 2 | 3 |  4  |  5  | 6..9  | 10..11| 12..15  |
+ *   +---+---+---+---+-----+-----+-------+-------+---------+
+ *   | S | o | I | P | VER | --- | NONCE | PORT  | PEER    |
+ *   +---+---+---+---+-----+-----+-------+-------+---------+
+ *
+ *   VER:   DISCOVERY_VERSION
+ *   NONCE: Random ID of the sender, chosen at boot
+ *   PORT:  UDP port of the sender's input exchange, big-endian
+ *   PEER:  NONCE of the adapter the sender pairs with, 0 if none
+ *
+ * Pairing is a three-way handshake:
+ *
+ *   A: broadcast  PEER=0          A searching
+ *   B: unicast    PEER=A          B offers to pair with A
+ *   A: unicast    PEER=B          A is paired
+ *                                 B is paired on reception
+ *
+ * Announcements of adapters that pair with someone else are ignored.
+ * An unanswered offer is withdrawn after DISCOVERY_OFFER_MS.  If the
+ * peer announces PEER=0 again, e.g. after a reset, the pairing is
+ * dissolved and the search starts over.
+ *
+ * This module doesn't use sockets, so the same logic runs on the
+ * adapter and in the host implementation (Tools/LanDiscovery).
+ *
+ * @endcode
+ * @author     SNESoIP contributors
+ * @copyright  "THE BEER-WARE LICENCE" (Revision 42)
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "DiscoveryProtocol.h"
+
+static size_t _DiscoveryEncode(const Discovery* pstDiscovery, uint8_t* pu8Buffer, uint32_t u32Peer);
+
+/**
+ * @fn     void InitDiscoveryProtocol(Discovery* pstDiscovery, uint32_t u32Nonce, uint16_t u16Port)
+ * @brief  Initialise LAN discovery state
+ * @param  pstDiscovery
+ *         Discovery state
+ * @param  u32Nonce
+ *         Random, non-zero ID of this adapter
+ * @param  u16Port
+ *         Own input exchange port
+ */
+void InitDiscoveryProtocol(Discovery* pstDiscovery, uint32_t u32Nonce, uint16_t u16Port)
+{
+    memset(pstDiscovery, 0, sizeof(struct Discovery_t));
+    pstDiscovery->u32Nonce = u32Nonce ? u32Nonce : 1;
+    pstDiscovery->u16Port  = u16Port;
+}
+
+/**
+ * @fn     void DiscoveryReceive(Discovery* pstDiscovery, const uint8_t* pu8Data, size_t uSize, uint32_t u32Addr, uint16_t u16SrcPort, int64_t s64Now)
+ * @brief  Process a received announcement
+ * @param  pstDiscovery
+ *         Discovery state
+ * @param  pu8Data
+ *         Received data
+ * @param  uSize
+ *         Size of the received data in bytes
+ * @param  u32Addr
+ *         Sender address, network byte order
+ * @param  u16SrcPort
+ *         Sender port
+ * @param  s64Now
+ *         Current time in µs
+ */
+void DiscoveryReceive(Discovery* pstDiscovery, const uint8_t* pu8Data, size_t uSize, uint32_t u32Addr, uint16_t u16SrcPort, int64_t s64Now)
+{
+    uint32_t u32Nonce;
+    uint32_t u32Peer;
+    uint16_t u16Port;
+
+    if (DISCOVERY_PACKET_SIZE != uSize || 0 != memcmp(pu8Data, "SoIP", 4) || DISCOVERY_VERSION != pu8Data[4])
+    {
+        return;
+    }
+
+    u32Nonce = ((uint32_t)pu8Data[6]  << 24) | ((uint32_t)pu8Data[7]  << 16) | ((uint32_t)pu8Data[8]  << 8) | pu8Data[9];
+    u16Port  = (uint16_t)(((uint16_t)pu8Data[10] << 8) | pu8Data[11]);
+    u32Peer  = ((uint32_t)pu8Data[12] << 24) | ((uint32_t)pu8Data[13] << 16) | ((uint32_t)pu8Data[14] << 8) | pu8Data[15];
+
+    // Own broadcast or an adapter that pairs with someone else.
+    if (u32Nonce == pstDiscovery->u32Nonce || (0 != u32Peer && u32Peer != pstDiscovery->u32Nonce))
+    {
+        return;
+    }
+
+    switch (pstDiscovery->eState)
+    {
+        case DISCOVERY_SEARCH:
+            pstDiscovery->u32PeerNonce   = u32Nonce;
+            pstDiscovery->u32PeerAddr    = u32Addr;
+            pstDiscovery->u16PeerSrcPort = u16SrcPort;
+            pstDiscovery->u16PeerPort    = u16Port;
+            pstDiscovery->bReplyPending  = true;
+            if (u32Peer == pstDiscovery->u32Nonce)
+            {
+                pstDiscovery->eState = DISCOVERY_PAIRED;
+            }
+            else
+            {
+                pstDiscovery->eState       = DISCOVERY_OFFER;
+                pstDiscovery->s64OfferTime = s64Now;
+            }
+            break;
+        case DISCOVERY_OFFER:
+            if (u32Nonce != pstDiscovery->u32PeerNonce)
+            {
+                break;
+            }
+            if (u32Peer == pstDiscovery->u32Nonce)
+            {
+                pstDiscovery->eState = DISCOVERY_PAIRED;
+            }
+            // Either confirm, or repeat the offer the candidate missed.
+            pstDiscovery->bReplyPending = true;
+            break;
+        case DISCOVERY_PAIRED:
+            if (u32Nonce == pstDiscovery->u32PeerNonce && 0 == u32Peer)
+            {
+                // The peer lost the pairing, start over.
+                pstDiscovery->eState          = DISCOVERY_SEARCH;
+                pstDiscovery->s64NextAnnounce = s64Now;
+            }
+            break;
+    }
+}
+
+/**
+ * @fn      size_t DiscoveryPoll(Discovery* pstDiscovery, int64_t s64Now, uint8_t* pu8Buffer, bool* pbUnicast)
+ * @brief   Get the next announcement to send
+ * @details Has to be called after each DiscoveryReceive() and
+ *          periodically, until it returns 0.
+ * @param   pstDiscovery
+ *          Discovery state
+ * @param   s64Now
+ *          Current time in µs
+ * @param   pu8Buffer
+ *          Destination, DISCOVERY_PACKET_SIZE bytes
+ * @param   pbUnicast
+ *          true = send to the peer, false = broadcast
+ * @return  Announcement size in bytes, 0 if nothing is due
+ */
+size_t DiscoveryPoll(Discovery* pstDiscovery, int64_t s64Now, uint8_t* pu8Buffer, bool* pbUnicast)
+{
+    if (DISCOVERY_OFFER == pstDiscovery->eState &&
+        (s64Now - pstDiscovery->s64OfferTime) > DISCOVERY_OFFER_MS * 1000LL)
+    {
+        pstDiscovery->eState = DISCOVERY_SEARCH;
+    }
+
+    if (pstDiscovery->bReplyPending)
+    {
+        pstDiscovery->bReplyPending = false;
+        *pbUnicast                  = true;
+        return _DiscoveryEncode(pstDiscovery, pu8Buffer, pstDiscovery->u32PeerNonce);
+    }
+
+    if (DISCOVERY_SEARCH == pstDiscovery->eState && s64Now >= pstDiscovery->s64NextAnnounce)
+    {
+        pstDiscovery->s64NextAnnounce = s64Now + DISCOVERY_ANNOUNCE_MS * 1000LL;
+        *pbUnicast                    = false;
+        return _DiscoveryEncode(pstDiscovery, pu8Buffer, 0);
+    }
+
+    return 0;
+}
+
+/**
+ * @fn      size_t _DiscoveryEncode(const Discovery* pstDiscovery, uint8_t* pu8Buffer, uint32_t u32Peer)
+ * @brief   Build an announcement
+ * @param   pstDiscovery
+ *          Discovery state
+ * @param   pu8Buffer
+ *          Destination, DISCOVERY_PACKET_SIZE bytes
+ * @param   u32Peer
+ *          Nonce of the peer, 0 if none
+ * @return  Announcement size in bytes
+ */
+static size_t _DiscoveryEncode(const Discovery* pstDiscovery, uint8_t* pu8Buffer, uint32_t u32Peer)
+{
+    memcpy(pu8Buffer, "SoIP", 4);
+    pu8Buffer[4]  = DISCOVERY_VERSION;
+    pu8Buffer[5]  = 0;
+    pu8Buffer[6]  = (uint8_t)(pstDiscovery->u32Nonce >> 24);
+    pu8Buffer[7]  = (uint8_t)(pstDiscovery->u32Nonce >> 16);
+    pu8Buffer[8]  = (uint8_t)(pstDiscovery->u32Nonce >> 8);
+    pu8Buffer[9]  = (uint8_t)(pstDiscovery->u32Nonce);
+    pu8Buffer[10] = (uint8_t)(pstDiscovery->u16Port >> 8);
+    pu8Buffer[11] = (uint8_t)(pstDiscovery->u16Port);
+    pu8Buffer[12] = (uint8_t)(u32Peer >> 24);
+    pu8Buffer[13] = (uint8_t)(u32Peer >> 16);
+    pu8Buffer[14] = (uint8_t)(u32Peer >> 8);
+    pu8Buffer[15] = (uint8_t)(u32Peer);
+
+    return DISCOVERY_PACKET_SIZE;
+}
@@ -7,17 +7,28 @@
  * @copyright  "THE BEER-WARE LICENCE" (Revision 42)
  */
 
+#include <stdbool.h>
 #include <stdint.h>
 #include <string.h>
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "esp_log.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "nvs.h"
 #include "lwip/err.h"
 #include "lwip/sockets.h"
 #include "lwip/sys.h"
 #include "lwip/netdb.h"
+#include "Boot.h"
 #include "ExchangeClient.h"
+#include "ExchangeProtocol.h"
+#include "Tasks.h"
+
+#define EXCHANGE_NVS_NAMESPACE  "exchange"  // !< NVS namespace of the server settings
+#define EXCHANGE_POLL_MS        1000        // !< Interval of the address request in ms
+#define EXCHANGE_CONNECT_MS     5000        // !< Connection timeout in ms
 
 /**
  * @struct  ExchangeClient
@@ -25,11 +36,18 @@
  */
 typedef struct ExchangeClient_t
 {
-    bool    bIsRunning;
-    uint8_t u8Stage;
-    uint8_t u8ClientID;
-    uint8_t u8OpponentID;
-    uint8_t u8IpAddr[4];
+    bool               bIsRunning;
+    bool               bConnecting;
+    bool               bHasID;
+    bool               bHasOpponent;
+    int                nSock;
+    uint8_t            u8Attempt;
+    char               acServerAddr[16];
+    uint16_t           u16ServerPort;
+    struct sockaddr_in stServer;        ///< Parsed server address, ready for connect()
+    Exchange           stExchange;
+    int64_t            s64RequestTime;  ///< Connect or request start in µs, 0 = idle
+    uint32_t           u32RTT;          ///< Last round-trip time in µs, 0 = unknown
 
 } ExchangeClient;
 
@@ -40,146 +58,489 @@ typedef struct ExchangeClient_t
 static ExchangeClient _stExchangeClient;
 
 static void _ExchangeClientThread(void* pArg);
+static void _LoadServerConfig(void);
+static void _ResolveServer(void);
+static bool _Connect(void);
+static void _Disconnect(void);
+static void _Backoff(void);
+static bool _HandleConnect(void);
+static bool _HandleReceive(void);
+static bool _HandleSend(void);
+static void _ExchangeMeasureRTT(void);
 
 /**
  * @fn     void InitExchangeClient(void)
  * @brief  Initialise IP exchange client
+ * @note   NVS has to be initialised before, see InitWiFi().
  */
 void InitExchangeClient(void)
 {
     ESP_LOGI("ExchangeClient", "Initialise IP exchange client.");
     memset(&_stExchangeClient, 0, sizeof(struct ExchangeClient_t));
-    xTaskCreate(_ExchangeClientThread, "ExchangeClientThread", 4096, NULL, 3, NULL);
+    _stExchangeClient.nSock = -1;
+    _LoadServerConfig();
+    _ResolveServer();
+    xTaskCreatePinnedToCore(
+        _ExchangeClientThread, "ExchangeClientThread", 4096, NULL,
+        TASK_PRIO_CONTROL, NULL, TASK_CORE_NET);
 }
 
 /**
- * @fn     void _ExchangeClientThread(void* pArg)
- * @brief  IP exchange client thread
- * @param  pArg
- *         Unused
+ * @fn      bool SetExchangeServer(const char* pacAddr, uint16_t u16Port)
+ * @brief   Store the address of the IP exchange server
+ * @details The new address is used from the next connection attempt.
+ * @param   pacAddr
+ *          IPv4 address in dotted-decimal notation
+ * @param   u16Port
+ *          TCP port
+ * @return  Status
+ * @retval  true  = Address has been stored
+ * @retval  false = Invalid address or NVS error
  */
-static void _ExchangeClientThread(void* pArg)
+bool SetExchangeServer(const char* pacAddr, uint16_t u16Port)
 {
-    struct sockaddr_in stDestAddr;
-
-    char acRxBuffer[11];
-    char acAddrStr[128];
-    int  nAddrFamily;
-    int  nIPProtocol;
-    int  nSock;
-    int  nErr;
+    nvs_handle hNVS;
+    esp_err_t  eErr;
 
-    stDestAddr.sin_addr.s_addr = inet_addr("10.0.0.3");
-    stDestAddr.sin_family      = AF_INET;
-    stDestAddr.sin_port        = htons(54350);
-    nAddrFamily                = AF_INET;
-    nIPProtocol                = IPPROTO_IP;
-    inet_ntoa_r(stDestAddr.sin_addr, acAddrStr, sizeof(acAddrStr) - 1);
+    if (INADDR_NONE == inet_addr(pacAddr) || strlen(pacAddr) >= sizeof(_stExchangeClient.acServerAddr))
+    {
+        return false;
+    }
 
-    nSock = socket(nAddrFamily, SOCK_STREAM, nIPProtocol);
-    if (0 > nSock)
+    if (ESP_OK != nvs_open(EXCHANGE_NVS_NAMESPACE, NVS_READWRITE, &hNVS))
     {
-        ESP_LOGE("ExchangeClient", "Unable to create socket: errno %d", errno);
+        return false;
     }
-    else
+    eErr = nvs_set_str(hNVS, "addr", pacAddr);
+    if (ESP_OK == eErr)
+    {
+        eErr = nvs_set_u16(hNVS, "port", u16Port);
+    }
+    if (ESP_OK == eErr)
     {
-        ESP_LOGI("ExchangeClient", "Socket created successfully.");
+        eErr = nvs_commit(hNVS);
     }
+    nvs_close(hNVS);
 
-    nErr = connect(nSock, (struct sockaddr *)&stDestAddr, sizeof(stDestAddr));
-    if (0 != nErr)
+    if (ESP_OK != eErr)
     {
-        ESP_LOGE("ExchangeClient", "Unable to connect: errno %d", errno);
+        return false;
     }
-    else
+
+    strcpy(_stExchangeClient.acServerAddr, pacAddr);
+    _stExchangeClient.u16ServerPort = u16Port;
+    _ResolveServer();
+    return true;
+}
+
+/**
+ * @fn      bool GetExchangeOpponent(uint8_t* pu8IpAddr)
+ * @brief   Get the IP address of the opponent
+ * @param   pu8IpAddr
+ *          Destination of the 4-byte IPv4 address
+ * @return  Status
+ * @retval  true  = Address has been received from the server
+ * @retval  false = Address is not known yet
+ */
+bool GetExchangeOpponent(uint8_t* pu8IpAddr)
+{
+    if (! _stExchangeClient.bHasOpponent)
+    {
+        return false;
+    }
+    memcpy(pu8IpAddr, _stExchangeClient.stExchange.au8IpAddr, 4);
+    return true;
+}
+
+/**
+ * @fn      bool GetExchangeClientID(uint8_t* pu8ClientID)
+ * @brief   Get the client ID assigned by the server
+ * @param   pu8ClientID
+ *          Destination of the client ID
+ * @return  Status
+ * @retval  true  = ID has been received from the server
+ * @retval  false = ID is not known yet
+ */
+bool GetExchangeClientID(uint8_t* pu8ClientID)
+{
+    if (! _stExchangeClient.bHasID)
     {
-        ESP_LOGI("ExchangeClient", "Successfully connected");
+        return false;
     }
+    *pu8ClientID = _stExchangeClient.stExchange.u8ClientID;
+    return true;
+}
+
+/**
+ * @fn       uint32_t GetExchangeRTT(void)
+ * @brief    Get the round-trip time to the IP exchange server
+ * @details  Measured by the TCP handshake and by the time between a
+ *           request and the next reply.
+ * @return   Last round-trip time in µs, 0 = unknown
+ */
+uint32_t GetExchangeRTT(void)
+{
+    return _stExchangeClient.u32RTT;
+}
+
+/**
+ * @fn     void GetExchangeServer(uint32_t* pu32Addr, uint16_t* pu16Port)
+ * @brief  Get the address of the IP exchange server
+ * @param  pu32Addr
+ *         Destination of the IPv4 address in network byte order
+ * @param  pu16Port
+ *         Destination of the port in host byte order
+ */
+void GetExchangeServer(uint32_t* pu32Addr, uint16_t* pu16Port)
+{
+    *pu32Addr = _stExchangeClient.stServer.sin_addr.s_addr;
+    *pu16Port = _stExchangeClient.u16ServerPort;
+}
+
+/**
+ * @fn       void _ExchangeClientThread(void* pArg)
+ * @brief    IP exchange client thread
+ * @details  The socket is non-blocking and the thread sleeps in
+ *           select() until the connection is established, the server
+ *           has sent something or the next address request is due.
+ *           Whenever the connection fails, it is re-established after
+ *           a randomised, exponentially growing delay.
+ * @param    pArg
+ *           Unused
+ */
+static void _ExchangeClientThread(void* pArg)
+{
+    TickType_t xConnectStart = 0;
+    TickType_t xLastPoll     = 0;
+    (void)pArg;
+
+    // Started at boot, the first connect goes out as soon as there is an IP.
+    WaitForBootStage(BOOT_STAGE_IP);
 
     _stExchangeClient.bIsRunning = true;
     while (_stExchangeClient.bIsRunning)
     {
-        int  nLen;
-        char acCommand[7] = { 0 };
+        struct timeval stTimeout;
+        fd_set         stReadSet;
+        fd_set         stWriteSet;
+        int            nReady;
+        bool           bOK = true;
+
+        if (0 > _stExchangeClient.nSock)
+        {
+            if (! _Connect())
+            {
+                _Backoff();
+                continue;
+            }
+            xConnectStart = xTaskGetTickCount();
+            xLastPoll     = xConnectStart;
+        }
 
-        if (1 == _stExchangeClient.u8Stage)
+        FD_ZERO(&stReadSet);
+        FD_ZERO(&stWriteSet);
+        if (_stExchangeClient.bConnecting || _stExchangeClient.stExchange.uTxLen > 0)
         {
-            ESP_LOGI("ExchangeClient", "Requesting IP address");
-            memcpy(acCommand, "GetIP\r\n", 7);
-            nErr = send(nSock, acCommand, 7, 0);
+            FD_SET(_stExchangeClient.nSock, &stWriteSet);
         }
-        if (2 == _stExchangeClient.u8Stage)
+        if (! _stExchangeClient.bConnecting)
         {
-            memcpy(acCommand, "Bye\r\n", 5);
-            nErr = send(nSock, acCommand, 5, 0);
+            FD_SET(_stExchangeClient.nSock, &stReadSet);
         }
-        if (0 > nErr)
+
+        stTimeout.tv_sec  = 0;
+        stTimeout.tv_usec = EXCHANGE_POLL_MS * 1000 / 4;
+        nReady = select(_stExchangeClient.nSock + 1, &stReadSet, &stWriteSet, NULL, &stTimeout);
+        if (0 > nReady)
         {
-            ESP_LOGE("ExchangeClient", "Error occured during sending: errno %d", errno);
-            continue;
+            ESP_LOGE("ExchangeClient", "select failed: errno %d", errno);
+            bOK = false;
         }
 
-        nLen = recv(nSock, acRxBuffer, sizeof(acRxBuffer) - 1, MSG_DONTWAIT);
-        if (0 > nLen)
+        if (bOK && _stExchangeClient.bConnecting)
         {
-            if (EAGAIN != errno)
+            if (FD_ISSET(_stExchangeClient.nSock, &stWriteSet))
+            {
+                bOK = _HandleConnect();
+            }
+            else if ((xTaskGetTickCount() - xConnectStart) > (EXCHANGE_CONNECT_MS / portTICK_PERIOD_MS))
             {
-                ESP_LOGE("Client", "Receive failed: errno %d", errno);
+                ESP_LOGE("ExchangeClient", "Connection timed out");
+                bOK = false;
             }
         }
-        else
+        else if (bOK)
         {
-            if (0 == _stExchangeClient.u8Stage)
+            if (FD_ISSET(_stExchangeClient.nSock, &stReadSet))
             {
-                char acCommand[7] = { 'H', 'e', 'l', 'l', 'o' };
-                if (0 == memcmp(acCommand, &acRxBuffer, 5))
-                {
-                    ESP_LOGI("ExchangeClient", "Client ID received: %d", acRxBuffer[5]);
-                    _stExchangeClient.u8ClientID = acRxBuffer[5];
-                    _stExchangeClient.u8Stage    = 1;
-                }
+                bOK = _HandleReceive();
             }
-            else if (1 == _stExchangeClient.u8Stage)
+            if (bOK && (xTaskGetTickCount() - xLastPoll) >= (EXCHANGE_POLL_MS / portTICK_PERIOD_MS))
             {
-                char acCommand[4] = { 'I', 'P', 'O', 'K' };
-                if (0 == memcmp(acCommand, &acRxBuffer, 4))
-                {
-                    _stExchangeClient.u8OpponentID = acRxBuffer[4];
-                    _stExchangeClient.u8IpAddr[0]  = acRxBuffer[5];
-                    _stExchangeClient.u8IpAddr[1]  = acRxBuffer[6];
-                    _stExchangeClient.u8IpAddr[2]  = acRxBuffer[7];
-                    _stExchangeClient.u8IpAddr[3]  = acRxBuffer[8];
-
-                    ESP_LOGI("ExchangeClient", "IP from player %d received: %d.%d.%d.%d",
-                             _stExchangeClient.u8OpponentID,
-                             _stExchangeClient.u8IpAddr[0],
-                             _stExchangeClient.u8IpAddr[1],
-                             _stExchangeClient.u8IpAddr[2],
-                             _stExchangeClient.u8IpAddr[3]);
-                    _stExchangeClient.u8Stage = 2;
-                }
-                else
-                {
-                    ESP_LOGI("ExchangeClient", "Waiting for opponent");
-                }
+                xLastPoll = xTaskGetTickCount();
+                ExchangePoll(&_stExchangeClient.stExchange);
             }
-            else if (2 == _stExchangeClient.u8Stage)
+            if (bOK && _stExchangeClient.stExchange.uTxLen > 0)
             {
-                char acCommand[5] = { 'C', 'y', 'a', '\r', '\n' };
-                if (0 == memcmp(acCommand, &acRxBuffer, 5))
-                {
-                    _stExchangeClient.bIsRunning = false;
-                    continue;
-                }
+                bOK = _HandleSend();
             }
         }
 
-        vTaskDelay(1000 / portTICK_PERIOD_MS);
+        if (EXCHANGE_STAGE_DONE == _stExchangeClient.stExchange.eStage)
+        {
+            _stExchangeClient.bIsRunning = false;
+        }
+        else if (! bOK)
+        {
+            _Disconnect();
+            _Backoff();
+        }
     }
 
+    _Disconnect();
+    vTaskDelete(NULL);
+}
+
+/**
+ * @fn     void _LoadServerConfig(void)
+ * @brief  Read the server address from NVS, falling back to defaults
+ */
+static void _LoadServerConfig(void)
+{
+    nvs_handle hNVS;
+    size_t     uSize = sizeof(_stExchangeClient.acServerAddr);
+
+    strcpy(_stExchangeClient.acServerAddr, EXCHANGE_SERVER_ADDR);
+    _stExchangeClient.u16ServerPort = EXCHANGE_SERVER_PORT;
+
+    if (ESP_OK != nvs_open(EXCHANGE_NVS_NAMESPACE, NVS_READONLY, &hNVS))
+    {
+        return;
+    }
+    if (ESP_OK != nvs_get_str(hNVS, "addr", _stExchangeClient.acServerAddr, &uSize))
+    {
+        strcpy(_stExchangeClient.acServerAddr, EXCHANGE_SERVER_ADDR);
+    }
+    nvs_get_u16(hNVS, "port", &_stExchangeClient.u16ServerPort);
+    nvs_close(hNVS);
+}
+
+/**
+ * @fn     void _ResolveServer(void)
+ * @brief  Prepare the socket address of the server
+ */
+static void _ResolveServer(void)
+{
+    memset(&_stExchangeClient.stServer, 0, sizeof(struct sockaddr_in));
+    _stExchangeClient.stServer.sin_addr.s_addr = inet_addr(_stExchangeClient.acServerAddr);
+    _stExchangeClient.stServer.sin_family      = AF_INET;
+    _stExchangeClient.stServer.sin_port        = htons(_stExchangeClient.u16ServerPort);
+}
+
+/**
+ * @fn      bool _Connect(void)
+ * @brief   Start a non-blocking connection attempt
+ * @return  Status
+ * @retval  true  = Connection established or in progress
+ * @retval  false = Error
+ */
+static bool _Connect(void)
+{
+    struct sockaddr_in stDestAddr = _stExchangeClient.stServer;
+    int                nSock;
+
+    nSock = socket(AF_INET, SOCK_STREAM, IPPROTO_IP);
+    if (0 > nSock)
+    {
+        ESP_LOGE("ExchangeClient", "Unable to create socket: errno %d", errno);
+        return false;
+    }
+    fcntl(nSock, F_SETFL, fcntl(nSock, F_GETFL, 0) | O_NONBLOCK);
+
+    InitExchange(&_stExchangeClient.stExchange);
+    _stExchangeClient.nSock          = nSock;
+    _stExchangeClient.bConnecting    = true;
+    _stExchangeClient.s64RequestTime = esp_timer_get_time();
+
+    if (0 != connect(nSock, (struct sockaddr*)&stDestAddr, sizeof(stDestAddr)))
+    {
+        if (EINPROGRESS != errno)
+        {
+            ESP_LOGE("ExchangeClient", "Unable to connect: errno %d", errno);
+            _Disconnect();
+            return false;
+        }
+    }
+    else
+    {
+        _stExchangeClient.bConnecting    = false;
+        _stExchangeClient.s64RequestTime = 0;
+        SetBootStage(BOOT_STAGE_EXCHANGE);
+    }
+
+    ESP_LOGI("ExchangeClient", "Connecting to %s:%u",
+             _stExchangeClient.acServerAddr, _stExchangeClient.u16ServerPort);
+    return true;
+}
+
+/**
+ * @fn     void _Disconnect(void)
+ * @brief  Close the connection, if any
+ */
+static void _Disconnect(void)
+{
+    if (0 > _stExchangeClient.nSock)
+    {
+        return;
+    }
     ESP_LOGI("ExchangeClient", "Shutting down socket.");
-    shutdown(nSock, 0);
-    close(nSock);
+    shutdown(_stExchangeClient.nSock, 0);
+    close(_stExchangeClient.nSock);
+    _stExchangeClient.nSock       = -1;
+    _stExchangeClient.bConnecting = false;
+}
 
-    vTaskDelete(NULL);
+/**
+ * @fn     void _Backoff(void)
+ * @brief  Wait before the next connection attempt
+ */
+static void _Backoff(void)
+{
+    uint32_t u32Delay = ExchangeBackoff(_stExchangeClient.u8Attempt, esp_random());
+
+    if (_stExchangeClient.u8Attempt < 0xff)
+    {
+        _stExchangeClient.u8Attempt++;
+    }
+    ESP_LOGI("ExchangeClient", "Reconnecting in %u ms", u32Delay);
+    vTaskDelay(u32Delay / portTICK_PERIOD_MS);
+}
+
+/**
+ * @fn      bool _HandleConnect(void)
+ * @brief   Check the result of the connection attempt
+ * @return  Status
+ * @retval  true  = Connected
+ * @retval  false = Connection failed
+ */
+static bool _HandleConnect(void)
+{
+    int       nErr = 0;
+    socklen_t uLen = sizeof(nErr);
+
+    getsockopt(_stExchangeClient.nSock, SOL_SOCKET, SO_ERROR, &nErr, &uLen);
+    if (0 != nErr)
+    {
+        ESP_LOGE("ExchangeClient", "Unable to connect: errno %d", nErr);
+        return false;
+    }
+
+    ESP_LOGI("ExchangeClient", "Successfully connected");
+    SetBootStage(BOOT_STAGE_EXCHANGE);
+    _ExchangeMeasureRTT();
+    _stExchangeClient.bConnecting = false;
+    return true;
+}
+
+/**
+ * @fn      bool _HandleReceive(void)
+ * @brief   Receive and process server messages
+ * @return  Status
+ * @retval  true  = OK
+ * @retval  false = Connection lost or protocol error
+ */
+static bool _HandleReceive(void)
+{
+    Exchange*     pstExchange = &_stExchangeClient.stExchange;
+    ExchangeStage eStage;
+    uint8_t       au8RxBuffer[EXCHANGE_RX_SIZE];
+    int           nLen;
+
+    nLen = recv(_stExchangeClient.nSock, au8RxBuffer, sizeof(au8RxBuffer), 0);
+    if (0 > nLen)
+    {
+        if (EAGAIN == errno || EWOULDBLOCK == errno)
+        {
+            return true;
+        }
+        ESP_LOGE("ExchangeClient", "Receive failed: errno %d", errno);
+        return false;
+    }
+    else if (0 == nLen)
+    {
+        ESP_LOGI("ExchangeClient", "Connection closed by server");
+        return EXCHANGE_STAGE_DONE == pstExchange->eStage;
+    }
+
+    _ExchangeMeasureRTT();
+    eStage = pstExchange->eStage;
+    ExchangeReceive(pstExchange, au8RxBuffer, (size_t)nLen);
+
+    if (EXCHANGE_STAGE_ERROR == pstExchange->eStage)
+    {
+        ESP_LOGE("ExchangeClient", "Unexpected message from server");
+        return false;
+    }
+    if (EXCHANGE_STAGE_HELLO == eStage && EXCHANGE_STAGE_HELLO != pstExchange->eStage)
+    {
+        ESP_LOGI("ExchangeClient", "Client ID received: %d", pstExchange->u8ClientID);
+        _stExchangeClient.u8Attempt = 0;
+        _stExchangeClient.bHasID    = true;
+    }
+    if (eStage <= EXCHANGE_STAGE_GETIP && pstExchange->eStage >= EXCHANGE_STAGE_BYE)
+    {
+        ESP_LOGI("ExchangeClient", "IP from player %d received: %d.%d.%d.%d",
+                 pstExchange->u8OpponentID,
+                 pstExchange->au8IpAddr[0],
+                 pstExchange->au8IpAddr[1],
+                 pstExchange->au8IpAddr[2],
+                 pstExchange->au8IpAddr[3]);
+        _stExchangeClient.bHasOpponent = true;
+    }
+
+    return true;
+}
+
+/**
+ * @fn      bool _HandleSend(void)
+ * @brief   Send the pending message
+ * @return  Status
+ * @retval  true  = OK
+ * @retval  false = Connection lost
+ */
+static bool _HandleSend(void)
+{
+    Exchange* pstExchange = &_stExchangeClient.stExchange;
+    int       nLen;
+
+    nLen = send(_stExchangeClient.nSock, pstExchange->au8Tx, pstExchange->uTxLen, 0);
+    if (0 > nLen)
+    {
+        if (EAGAIN == errno || EWOULDBLOCK == errno)
+        {
+            return true;
+        }
+        ESP_LOGE("ExchangeClient", "Error occured during sending: errno %d", errno);
+        return false;
+    }
+
+    ExchangeSent(pstExchange, (size_t)nLen);
+    if (0 == pstExchange->uTxLen)
+    {
+        _stExchangeClient.s64RequestTime = esp_timer_get_time();
+    }
+    return true;
+}
+
+/**
+ * @fn     void _ExchangeMeasureRTT(void)
+ * @brief  Complete a pending round-trip time measurement
+ */
+static void _ExchangeMeasureRTT(void)
+{
+    if (0 != _stExchangeClient.s64RequestTime)
+    {
+        _stExchangeClient.u32RTT         = (uint32_t)(esp_timer_get_time() - _stExchangeClient.s64RequestTime);
+        _stExchangeClient.s64RequestTime = 0;
+    }
 }
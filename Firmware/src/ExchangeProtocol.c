@@ -0,0 +1,262 @@
+/**
+ * @file       ExchangeProtocol.c
+ * @brief      IP exchange protocol
+ * @ingroup    Firmware
+ * @details
+ * @code{.unparsed}
+ *
+ * The protocol itself is described in Server.c.  This module only
+ * consumes the bytes received from the server and produces the bytes to
+ * be sent back, so it does not depend on sockets or FreeRTOS and can be
+ * driven by any transport, e.g. the stand-in server of Tools/ExchangeSim.
+ *
+ * As TCP is a byte stream, messages are reassembled by their fixed
+ * length, which is derived from the first bytes:
+ *
+ *   Hello<ID0><CR><LF><0><0>            10 bytes
+ *   IPOK<ID1><IP0..IP3><CR><LF>         11 bytes
+ *   None<CR><LF>                         6 bytes
+ *   Cya<CR><LF>                          5 bytes
+ *
+ * While waiting for the opponent, ExchangePoll() repeats the request.
+ *
+ * @endcode
+ * @author     SNESoIP contributors
+ * @copyright  "THE BEER-WARE LICENCE" (Revision 42)
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "ExchangeProtocol.h"
+
+static size_t _ExchangeMessageSize(const uint8_t* pu8Data, size_t uSize);
+static void   _ExchangeHandleMessage(Exchange* pstExchange);
+static void   _ExchangeQueue(Exchange* pstExchange, const char* pacMessage);
+
+/**
+ * @fn     void InitExchange(Exchange* pstExchange)
+ * @brief  Reset the protocol state for a new connection
+ * @param  pstExchange
+ *         Protocol state
+ */
+void InitExchange(Exchange* pstExchange)
+{
+    memset(pstExchange, 0, sizeof(struct Exchange_t));
+    pstExchange->eStage = EXCHANGE_STAGE_HELLO;
+}
+
+/**
+ * @fn     void ExchangeReceive(Exchange* pstExchange, const uint8_t* pu8Data, size_t uSize)
+ * @brief  Process data received from the server
+ * @param  pstExchange
+ *         Protocol state
+ * @param  pu8Data
+ *         Received data
+ * @param  uSize
+ *         Size of the data in bytes
+ */
+void ExchangeReceive(Exchange* pstExchange, const uint8_t* pu8Data, size_t uSize)
+{
+    while (uSize > 0 && EXCHANGE_STAGE_ERROR != pstExchange->eStage)
+    {
+        size_t uMessageSize;
+
+        pstExchange->au8Rx[pstExchange->uRxLen++] = *pu8Data++;
+        uSize--;
+
+        uMessageSize = _ExchangeMessageSize(pstExchange->au8Rx, pstExchange->uRxLen);
+        if (0 == uMessageSize)
+        {
+            pstExchange->eStage = EXCHANGE_STAGE_ERROR;
+        }
+        else if (uMessageSize == pstExchange->uRxLen)
+        {
+            _ExchangeHandleMessage(pstExchange);
+            pstExchange->uRxLen = 0;
+        }
+    }
+}
+
+/**
+ * @fn     void ExchangePoll(Exchange* pstExchange)
+ * @brief  Repeat the address request while waiting for the opponent
+ * @param  pstExchange
+ *         Protocol state
+ */
+void ExchangePoll(Exchange* pstExchange)
+{
+    if (EXCHANGE_STAGE_GETIP == pstExchange->eStage && 0 == pstExchange->uTxLen)
+    {
+        _ExchangeQueue(pstExchange, "GetIP\r\n");
+    }
+}
+
+/**
+ * @fn     void ExchangeSent(Exchange* pstExchange, size_t uSize)
+ * @brief  Remove sent bytes from the pending message
+ * @param  pstExchange
+ *         Protocol state
+ * @param  uSize
+ *         Number of bytes that have been sent
+ */
+void ExchangeSent(Exchange* pstExchange, size_t uSize)
+{
+    if (uSize >= pstExchange->uTxLen)
+    {
+        pstExchange->uTxLen = 0;
+        return;
+    }
+    memmove(pstExchange->au8Tx, &pstExchange->au8Tx[uSize], pstExchange->uTxLen - uSize);
+    pstExchange->uTxLen -= uSize;
+}
+
+/**
+ * @fn       uint32_t ExchangeBackoff(uint8_t u8Attempt, uint32_t u32Random)
+ * @brief    Get the delay before the next connection attempt
+ * @details  The upper bound doubles with each failed attempt, starting
+ *           at EXCHANGE_BACKOFF_MIN_MS and limited to
+ *           EXCHANGE_BACKOFF_MAX_MS.  The actual delay is picked from
+ *           the upper half of that range, so several adapters that
+ *           lost the server at the same time don't return in lockstep.
+ * @param    u8Attempt
+ *           Number of failed attempts so far
+ * @param    u32Random
+ *           Random number
+ * @return   Delay in ms
+ */
+uint32_t ExchangeBackoff(uint8_t u8Attempt, uint32_t u32Random)
+{
+    uint32_t u32Max = EXCHANGE_BACKOFF_MIN_MS;
+
+    while (u8Attempt-- > 0 && u32Max < EXCHANGE_BACKOFF_MAX_MS)
+    {
+        u32Max *= 2;
+    }
+    if (u32Max > EXCHANGE_BACKOFF_MAX_MS)
+    {
+        u32Max = EXCHANGE_BACKOFF_MAX_MS;
+    }
+
+    return (u32Max / 2) + (u32Random % ((u32Max / 2) + 1));
+}
+
+/**
+ * @fn      size_t _ExchangeMessageSize(const uint8_t* pu8Data, size_t uSize)
+ * @brief   Get the size of the message that starts with the given bytes
+ * @param   pu8Data
+ *          Start of the message
+ * @param   uSize
+ *          Number of bytes received so far
+ * @return  Message size, EXCHANGE_RX_SIZE if the message can't be
+ *          identified yet, 0 if it is unknown
+ */
+static size_t _ExchangeMessageSize(const uint8_t* pu8Data, size_t uSize)
+{
+    static const struct
+    {
+        const char* pacPrefix;
+        size_t      uSize;
+
+    } astMessage[] = {
+        { "Hello", 10 },
+        { "IPOK",  11 },
+        { "None",   6 },
+        { "Cya",    5 }
+    };
+    bool bCandidate = false;
+
+    for (size_t uIndex = 0; uIndex < sizeof(astMessage) / sizeof(astMessage[0]); uIndex++)
+    {
+        size_t uPrefix = strlen(astMessage[uIndex].pacPrefix);
+        size_t uCmp    = uSize < uPrefix ? uSize : uPrefix;
+
+        if (0 == memcmp(pu8Data, astMessage[uIndex].pacPrefix, uCmp))
+        {
+            if (uSize >= uPrefix)
+            {
+                return astMessage[uIndex].uSize;
+            }
+            bCandidate = true;
+        }
+    }
+
+    return bCandidate ? EXCHANGE_RX_SIZE : 0;
+}
+
+/**
+ * @fn     void _ExchangeHandleMessage(Exchange* pstExchange)
+ * @brief  Handle a complete server message
+ * @param  pstExchange
+ *         Protocol state
+ */
+static void _ExchangeHandleMessage(Exchange* pstExchange)
+{
+    const uint8_t* pu8Rx = pstExchange->au8Rx;
+
+    switch (pstExchange->eStage)
+    {
+        case EXCHANGE_STAGE_HELLO:
+            if (0 == memcmp(pu8Rx, "Hello", 5))
+            {
+                pstExchange->u8ClientID = pu8Rx[5];
+                pstExchange->eStage     = EXCHANGE_STAGE_GETIP;
+                _ExchangeQueue(pstExchange, "GetIP\r\n");
+                return;
+            }
+            break;
+        case EXCHANGE_STAGE_GETIP:
+            if (0 == memcmp(pu8Rx, "IPOK", 4))
+            {
+                pstExchange->u8OpponentID = pu8Rx[4];
+                memcpy(pstExchange->au8IpAddr, &pu8Rx[5], 4);
+                pstExchange->eStage = EXCHANGE_STAGE_BYE;
+                _ExchangeQueue(pstExchange, "Bye\r\n");
+                return;
+            }
+            else if (0 == memcmp(pu8Rx, "None", 4))
+            {
+                // Opponent not connected yet, ExchangePoll() asks again.
+                return;
+            }
+            break;
+        case EXCHANGE_STAGE_BYE:
+            if (0 == memcmp(pu8Rx, "Cya", 3))
+            {
+                pstExchange->eStage = EXCHANGE_STAGE_DONE;
+                return;
+            }
+            else if (0 == memcmp(pu8Rx, "IPOK", 4) || 0 == memcmp(pu8Rx, "None", 4))
+            {
+                // Answer to a request that crossed our Bye.
+                return;
+            }
+            break;
+        default:
+            break;
+    }
+
+    pstExchange->eStage = EXCHANGE_STAGE_ERROR;
+}
+
+/**
+ * @fn     void _ExchangeQueue(Exchange* pstExchange, const char* pacMessage)
+ * @brief  Queue a message for the server
+ * @param  pstExchange
+ *         Protocol state
+ * @param  pacMessage
+ *         Message
+ */
+static void _ExchangeQueue(Exchange* pstExchange, const char* pacMessage)
+{
+    size_t uSize = strlen(pacMessage);
+
+    if (pstExchange->uTxLen + uSize > EXCHANGE_TX_SIZE)
+    {
+        return;
+    }
+    memcpy(&pstExchange->au8Tx[pstExchange->uTxLen], pacMessage, uSize);
+    pstExchange->uTxLen += uSize;
+}
@@ -1,6 +1,8 @@
 /**
  * @file       Firmware.c
  * @brief      SNESoIP firmware
+ * @details    The subsystems are started in parallel, see Boot.c, on
+ *             the cores given in Tasks.h.
  * @defgroup   Firmware SNESoIP firmware
  * @ingroup    Firmware
  * @author     Michael Fitzmayer
@@ -13,24 +15,50 @@
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "Boot.h"
+#include "Discovery.h"
 #include "ExchangeClient.h"
 //#include "IRC.h"
+#include "Movie.h"
+#include "Netplay.h"
 #include "SNES.h"
+#include "SNESBulk.h"
+#include "SNESUpstream.h"
+#include "Tasks.h"
+#include "Trace.h"
 #include "Terminal.h"
 #include "WiFi.h"
 
 static void _MainThread(void* pArg);
+static void _WiFiStartThread(void* pArg);
+static void _SNESStartThread(void* pArg);
 
 void app_main()
 {
-    InitSNES();
-    InitWiFi();
-    WaitForIP();
+    InitBoot();
+    InitTrace();
+
+    // The radio takes longest, get it going first.
+    xTaskCreatePinnedToCore(
+        _WiFiStartThread, "WiFiStartThread", 4096, NULL,
+        TASK_PRIO_CONTROL, NULL, TASK_CORE_NET);
+
+    // Interrupts are allocated on the core that installs them.
+    xTaskCreatePinnedToCore(
+        _SNESStartThread, "SNESStartThread", 4096, NULL,
+        TASK_PRIO_CONTROL, NULL, TASK_CORE_SNES);
+
+    // The network threads wait for the IP themselves.
+    WaitForBootStage(BOOT_STAGE_NVS | BOOT_STAGE_SNES);
     InitTerminal();
     //InitIRC();
     InitExchangeClient();
+    InitNetplay();
+    InitDiscovery();
 
-    xTaskCreate(_MainThread, "MainThread", 1024, NULL, 5, NULL);
+    xTaskCreatePinnedToCore(
+        _MainThread, "MainThread", 1024, NULL,
+        TASK_PRIO_BACKGROUND, NULL, TASK_CORE_SNES);
 }
 
 static void _MainThread(void* pArg)
@@ -42,3 +70,23 @@ static void _MainThread(void* pArg)
         vTaskDelay(1000 / portTICK_PERIOD_MS);
     }
 }
+
+static void _WiFiStartThread(void* pArg)
+{
+    (void)pArg;
+
+    InitWiFi();
+    vTaskDelete(NULL);
+}
+
+static void _SNESStartThread(void* pArg)
+{
+    (void)pArg;
+
+    InitSNES();
+    InitSNESBulk();
+    InitSNESUpstream();
+    InitMovie();
+    SetBootStage(BOOT_STAGE_SNES);
+    vTaskDelete(NULL);
+}
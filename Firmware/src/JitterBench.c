@@ -0,0 +1,230 @@
+/**
+ * @file       JitterBench.c
+ * @brief      Capture jitter benchmark
+ * @ingroup    Firmware
+ * @details
+ * @code{.unparsed}
+ *
+ * Shows whether the controller capture keeps its timing while the
+ * WiFi is busy.  The benchmark clears the capture timing histogram of
+ * the SNES driver and, if a target is given, floods it with UDP
+ * datagrams from the network core for the given time:
+ *
+ *   JITTER_BENCH_BURST datagrams of JITTER_BENCH_PAYLOAD bytes per
+ *   tick, i.e. about 18 Mbit/s at 100 Hz, more than the radio can
+ *   send, so the WiFi driver and lwIP run flat out.
+ *
+ * Any host will do as target, e.g. the discard port 9 of the PC on
+ * the terminal; the datagrams don't have to be received.  Without a
+ * target the histogram gives the idle baseline.
+ *
+ * Three timings are recorded, see SNESTimingHistogram:
+ *
+ *   jitter  Deviation of the clock edges seen by the capture ISR,
+ *           i.e. its interrupt latency.
+ *   wake    Last clock edge to the reader running, i.e. how long the
+ *           reader waits for its core.
+ *   late    Latch-sync timer to the reader running; the timer is
+ *           served by the esp_timer task on the network core.
+ *
+ * With the task placement in Tasks.h wake should stay in the low
+ * buckets under load; a tail in late is the cost of the timer task
+ * sharing its core with the WiFi driver.
+ *
+ * @endcode
+ * @author     SNESoIP contributors
+ * @copyright  "THE BEER-WARE LICENCE" (Revision 42)
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "lwip/err.h"
+#include "lwip/sockets.h"
+#include "lwip/sys.h"
+#include "JitterBench.h"
+#include "SNES.h"
+#include "Tasks.h"
+
+/**
+ * @struct  JitterBench
+ * @brief   Jitter benchmark data
+ */
+typedef struct JitterBench_t
+{
+    volatile bool bRunning;
+    int64_t       s64Start;     ///< Start of the benchmark in µs
+    uint32_t      u32Seconds;   ///< Duration in s
+    uint32_t      u32Elapsed;   ///< Duration when finished in ms
+    uint32_t      u32Target;    ///< Load target, network byte order, 0 = no load
+    uint16_t      u16Port;      ///< Load target port
+    uint32_t      u32Packets;   ///< Load datagrams sent
+    uint32_t      u32Errors;    ///< Load datagrams rejected by the stack
+
+    SNESTimingHistogram stTiming;  ///< Histogram of the last finished run
+
+    uint8_t au8Payload[JITTER_BENCH_PAYLOAD];  ///< Load datagram
+
+} JitterBench;
+
+/**
+ * @var    _stBench
+ * @brief  Jitter benchmark private data
+ */
+static JitterBench _stBench;
+
+static void _JitterBenchThread(void* pArg);
+static void _JitterBenchLoad(int nSock, struct sockaddr_in* pstDest);
+
+/**
+ * @fn      bool StartJitterBench(uint32_t u32Seconds, uint32_t u32Target, uint16_t u16Port)
+ * @brief   Start the jitter benchmark
+ * @param   u32Seconds
+ *          Duration in s, 1 to JITTER_BENCH_MAX_S
+ * @param   u32Target
+ *          Load target, network byte order, 0 = no load
+ * @param   u16Port
+ *          Load target port
+ * @return  Start status
+ * @retval  true  = Benchmark started
+ * @retval  false = Invalid duration or a benchmark is already running
+ */
+bool StartJitterBench(uint32_t u32Seconds, uint32_t u32Target, uint16_t u16Port)
+{
+    if (_stBench.bRunning || 0 == u32Seconds || u32Seconds > JITTER_BENCH_MAX_S)
+    {
+        return false;
+    }
+
+    _stBench.u32Seconds = u32Seconds;
+    _stBench.u32Elapsed = 0;
+    _stBench.u32Target  = u32Target;
+    _stBench.u16Port    = u16Port;
+    _stBench.u32Packets = 0;
+    _stBench.u32Errors  = 0;
+    _stBench.s64Start   = esp_timer_get_time();
+    _stBench.bRunning   = true;
+
+    ResetSNESTimingHistogram();
+    ESP_LOGI("Bench", "Jitter benchmark for %u s", u32Seconds);
+
+    if (pdPASS != xTaskCreatePinnedToCore(
+            _JitterBenchThread, "JitterBenchThread", 2048, NULL,
+            TASK_PRIO_BENCH, NULL, TASK_CORE_NET))
+    {
+        _stBench.bRunning = false;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @fn     void GetJitterBench(JitterBenchResult* pstResult)
+ * @brief  Get progress and result of the jitter benchmark
+ * @param  pstResult
+ *         Destination of the result
+ */
+void GetJitterBench(JitterBenchResult* pstResult)
+{
+    pstResult->bRunning   = _stBench.bRunning;
+    pstResult->u32Seconds = _stBench.u32Seconds;
+    pstResult->u32Target  = _stBench.u32Target;
+    pstResult->u16Port    = _stBench.u16Port;
+    pstResult->u32Packets = _stBench.u32Packets;
+    pstResult->u32Errors  = _stBench.u32Errors;
+
+    if (pstResult->bRunning)
+    {
+        pstResult->u32Elapsed = (uint32_t)((esp_timer_get_time() - _stBench.s64Start) / 1000);
+        GetSNESTimingHistogram(&pstResult->stTiming);
+    }
+    else
+    {
+        pstResult->u32Elapsed = _stBench.u32Elapsed;
+        memcpy(&pstResult->stTiming, &_stBench.stTiming, sizeof(SNESTimingHistogram));
+    }
+}
+
+/**
+ * @fn       void _JitterBenchThread(void* pArg)
+ * @brief    Jitter benchmark thread
+ * @details  Generates the load until the duration has passed and
+ *           keeps a copy of the histogram, so the result survives
+ *           until the next run.
+ * @param    pArg
+ *           Unused
+ */
+static void _JitterBenchThread(void* pArg)
+{
+    struct sockaddr_in stDest;
+    int64_t            s64End = _stBench.s64Start + (int64_t)_stBench.u32Seconds * 1000000;
+    int                nSock  = -1;
+    (void)pArg;
+
+    if (0 != _stBench.u32Target)
+    {
+        memset(&stDest, 0, sizeof(stDest));
+        stDest.sin_family      = AF_INET;
+        stDest.sin_addr.s_addr = _stBench.u32Target;
+        stDest.sin_port        = htons(_stBench.u16Port);
+
+        memset(_stBench.au8Payload, 0x5a, sizeof(_stBench.au8Payload));
+        nSock = socket(AF_INET, SOCK_DGRAM, IPPROTO_IP);
+        if (nSock < 0)
+        {
+            ESP_LOGE("Bench", "Unable to create socket: errno %d", errno);
+        }
+    }
+
+    while (esp_timer_get_time() < s64End)
+    {
+        if (nSock >= 0)
+        {
+            _JitterBenchLoad(nSock, &stDest);
+        }
+        vTaskDelay(1);
+    }
+
+    if (nSock >= 0)
+    {
+        close(nSock);
+    }
+
+    GetSNESTimingHistogram(&_stBench.stTiming);
+    _stBench.u32Elapsed = (uint32_t)((esp_timer_get_time() - _stBench.s64Start) / 1000);
+    _stBench.bRunning   = false;
+
+    ESP_LOGI("Bench", "Jitter benchmark done, %u datagrams sent, %u rejected",
+             _stBench.u32Packets, _stBench.u32Errors);
+    vTaskDelete(NULL);
+}
+
+/**
+ * @fn     void _JitterBenchLoad(int nSock, struct sockaddr_in* pstDest)
+ * @brief  Send one burst of load datagrams
+ * @param  nSock
+ *         UDP socket
+ * @param  pstDest
+ *         Load target
+ */
+static void _JitterBenchLoad(int nSock, struct sockaddr_in* pstDest)
+{
+    for (uint8_t u8Index = 0; u8Index < JITTER_BENCH_BURST; u8Index++)
+    {
+        // Full buffers are expected, that's the point of the load.
+        if (0 > sendto(nSock, _stBench.au8Payload, sizeof(_stBench.au8Payload), 0,
+                       (struct sockaddr*)pstDest, sizeof(struct sockaddr_in)))
+        {
+            _stBench.u32Errors++;
+        }
+        else
+        {
+            _stBench.u32Packets++;
+        }
+    }
+}
@@ -0,0 +1,98 @@
+/**
+ * @file       Latency.c
+ * @brief      Latency window
+ * @ingroup    Firmware
+ * @details
+ * @code{.unparsed}
+ *
+ * The window keeps the last LATENCY_SAMPLES samples in a ring.  Adding
+ * a sample is a single store and runs from IRAM, so it can be done from
+ * an interrupt, even while the flash cache is disabled.
+ * Percentiles are only needed on request; they are taken from a sorted
+ * copy of the window (nearest-rank method).
+ *
+ * @endcode
+ * @author     SNESoIP contributors
+ * @copyright  "THE BEER-WARE LICENCE" (Revision 42)
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "esp_attr.h"
+#include "Latency.h"
+
+/**
+ * @fn     void InitLatency(Latency* pstLatency)
+ * @brief  Initialise latency window
+ * @param  pstLatency
+ *         Latency window
+ */
+void InitLatency(Latency* pstLatency)
+{
+    memset(pstLatency, 0, sizeof(struct Latency_t));
+}
+
+/**
+ * @fn     void AddLatency(Latency* pstLatency, uint32_t u32Sample)
+ * @brief  Add a sample, replacing the oldest one
+ * @param  pstLatency
+ *         Latency window
+ * @param  u32Sample
+ *         Latency in µs
+ */
+void IRAM_ATTR AddLatency(Latency* pstLatency, uint32_t u32Sample)
+{
+    pstLatency->au32Samples[pstLatency->u32Count & (LATENCY_SAMPLES - 1)] = u32Sample;
+    pstLatency->u32Count++;
+}
+
+/**
+ * @fn      uint32_t GetLatencyPercentile(const Latency* pstLatency, uint8_t u8Percent)
+ * @brief   Get a percentile of the samples in the window
+ * @param   pstLatency
+ *          Latency window
+ * @param   u8Percent
+ *          Percentile, 1 to 100
+ * @return  Latency in µs, 0 if there are no samples
+ */
+uint32_t GetLatencyPercentile(const Latency* pstLatency, uint8_t u8Percent)
+{
+    uint32_t au32Sorted[LATENCY_SAMPLES];
+    uint32_t u32Num = pstLatency->u32Count;
+    uint32_t u32Rank;
+
+    if (0 == u32Num)
+    {
+        return 0;
+    }
+    if (u32Num > LATENCY_SAMPLES)
+    {
+        u32Num = LATENCY_SAMPLES;
+    }
+    if (u8Percent > 100)
+    {
+        u8Percent = 100;
+    }
+
+    // Insertion sort, the window is small.
+    for (uint32_t u32Index = 0; u32Index < u32Num; u32Index++)
+    {
+        uint32_t u32Sample = pstLatency->au32Samples[u32Index];
+        uint32_t u32Pos    = u32Index;
+
+        while (u32Pos > 0 && au32Sorted[u32Pos - 1] > u32Sample)
+        {
+            au32Sorted[u32Pos] = au32Sorted[u32Pos - 1];
+            u32Pos--;
+        }
+        au32Sorted[u32Pos] = u32Sample;
+    }
+
+    u32Rank = (u32Num * u8Percent + 99) / 100;
+    if (u32Rank > 0)
+    {
+        u32Rank--;
+    }
+    return au32Sorted[u32Rank];
+}
@@ -0,0 +1,192 @@
+/**
+ * @file       Movie.c
+ * @brief      Input movie playback
+ * @ingroup    Firmware
+ * @details    Feeds the movie player from the terminal and hands its
+ *             words to the SNES driver at every latch.  The board has
+ *             no PSRAM, so the movie is streamed through a ring buffer
+ *             in internal RAM; the terminal stops reading from the
+ *             uploading host while the buffer is full.
+ * @author     SNESoIP contributors
+ * @copyright  "THE BEER-WARE LICENCE" (Revision 42)
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include "Movie.h"
+#include "MoviePlayer.h"
+#include "SNES.h"
+
+/**
+ * @struct  Movie
+ * @brief   Input movie playback data
+ */
+typedef struct Movie_t
+{
+    bool         bActive;                     ///< A movie is loaded
+    portMUX_TYPE stMux;                       ///< Guards stPlayer
+    MoviePlayer  stPlayer;                    ///< Player state
+    uint32_t     au32Missed[SNES_NUM_PORTS];  ///< Missed latches at the start
+
+} Movie;
+
+/**
+ * @var    _stMovie
+ * @brief  Input movie playback private data
+ */
+static Movie _stMovie;
+
+static bool IRAM_ATTR _MovieOverride(uint8_t u8Port, int64_t s64Time, uint16_t* pu16Data);
+
+/**
+ * @fn     void InitMovie(void)
+ * @brief  Initialise input movie playback
+ */
+void InitMovie(void)
+{
+    memset(&_stMovie, 0, sizeof(struct Movie_t));
+    vPortCPUInitializeMutex(&_stMovie.stMux);
+}
+
+/**
+ * @fn      bool StartMovie(uint8_t u8Ports, uint32_t u32Frames)
+ * @brief   Prepare the playback of a new movie
+ * @details A running movie is stopped.  The playback starts as soon
+ *          as enough data has been pushed.
+ * @param   u8Ports
+ *          Controller ports per frame, 1 or 2
+ * @param   u32Frames
+ *          Number of frames
+ * @return  Status
+ * @retval  true  = OK
+ * @retval  false = Invalid parameters
+ */
+bool StartMovie(uint8_t u8Ports, uint32_t u32Frames)
+{
+    SNESPortStats stPort;
+
+    if (u8Ports < 1 || u8Ports > MOVIE_MAX_PORTS || 0 == u32Frames)
+    {
+        return false;
+    }
+
+    StopMovie();
+    for (uint8_t u8Port = 0; u8Port < SNES_NUM_PORTS; u8Port++)
+    {
+        GetSNESPortStats(u8Port, &stPort);
+        _stMovie.au32Missed[u8Port] = stPort.u32MissedLatches;
+    }
+
+    portENTER_CRITICAL(&_stMovie.stMux);
+    InitMoviePlayer(&_stMovie.stPlayer, u8Ports, u32Frames);
+    portEXIT_CRITICAL(&_stMovie.stMux);
+
+    _stMovie.bActive = true;
+    SetSNESOverride(_MovieOverride);
+    ESP_LOGI("Movie", "Movie with %u frames on %u port(s) loaded.", u32Frames, u8Ports);
+    return true;
+}
+
+/**
+ * @fn     void StopMovie(void)
+ * @brief  Stop the playback and return the ports to the controller
+ */
+void StopMovie(void)
+{
+    if (! _stMovie.bActive)
+    {
+        return;
+    }
+    SetSNESOverride(NULL);
+    _stMovie.bActive = false;
+    ESP_LOGI("Movie", "Movie stopped.");
+}
+
+/**
+ * @fn      size_t PushMovie(const uint8_t* pu8Data, size_t uSize)
+ * @brief   Append data to the loaded movie
+ * @param   pu8Data
+ *          Movie data
+ * @param   uSize
+ *          Number of bytes
+ * @return  Number of bytes accepted
+ */
+size_t PushMovie(const uint8_t* pu8Data, size_t uSize)
+{
+    size_t uAccepted;
+
+    portENTER_CRITICAL(&_stMovie.stMux);
+    uAccepted = MoviePush(&_stMovie.stPlayer, pu8Data, uSize);
+    portEXIT_CRITICAL(&_stMovie.stMux);
+
+    return uAccepted;
+}
+
+/**
+ * @fn      size_t GetMovieFree(void)
+ * @brief   Get the number of bytes PushMovie() accepts right now
+ * @return  Number of bytes
+ */
+size_t GetMovieFree(void)
+{
+    size_t uFree;
+
+    portENTER_CRITICAL(&_stMovie.stMux);
+    uFree = MovieFree(&_stMovie.stPlayer);
+    portEXIT_CRITICAL(&_stMovie.stMux);
+
+    return uFree;
+}
+
+/**
+ * @fn     bool IsMovieActive(void)
+ * @brief  Check if a movie is loaded and not finished yet
+ */
+bool IsMovieActive(void)
+{
+    return _stMovie.bActive && ! _stMovie.stPlayer.bDone;
+}
+
+/**
+ * @fn     void GetMovieStats(MovieStats* pstStats)
+ * @brief  Get the statistics of the current or last movie
+ * @param  pstStats
+ *         Destination of the statistics
+ */
+void GetMovieStats(MovieStats* pstStats)
+{
+    SNESPortStats stPort;
+
+    portENTER_CRITICAL(&_stMovie.stMux);
+    memcpy(pstStats, &_stMovie.stPlayer.stStats, sizeof(MovieStats));
+    portEXIT_CRITICAL(&_stMovie.stMux);
+
+    pstStats->u32Missed = 0;
+    for (uint8_t u8Port = 0; u8Port < _stMovie.stPlayer.u8Ports; u8Port++)
+    {
+        GetSNESPortStats(u8Port, &stPort);
+        pstStats->u32Missed += stPort.u32MissedLatches - _stMovie.au32Missed[u8Port];
+    }
+}
+
+/**
+ * @fn       bool _MovieOverride(uint8_t u8Port, int64_t s64Time, uint16_t* pu16Data)
+ * @brief    SNES driver override, see SNESOverrideFn
+ * @details  Once the last frame has been shown, the ports go back to
+ *           the controller and the remote input.
+ */
+static bool IRAM_ATTR _MovieOverride(uint8_t u8Port, int64_t s64Time, uint16_t* pu16Data)
+{
+    bool bSupplied;
+
+    portENTER_CRITICAL_ISR(&_stMovie.stMux);
+    bSupplied = MovieLatch(&_stMovie.stPlayer, u8Port, s64Time, pu16Data);
+    portEXIT_CRITICAL_ISR(&_stMovie.stMux);
+
+    return bSupplied;
+}
@@ -0,0 +1,240 @@
+/**
+ * @file       MoviePlayer.c
+ * @brief      Input movie player
+ * @ingroup    Firmware
+ * @details
+ * @code{.unparsed}
+ *
+ * A movie is a sequence of frames, each frame holding one 16-bit
+ * controller word per port in network byte order.  The words are raw
+ * port data as returned by GetSNESInputData(), i.e. a released button
+ * reads as 1:
+ *
+ *   | 0..1         | 2..3         | 4..5         | ...
+ *   | frame 0 (P1) | frame 0 (P2) | frame 1 (P1) | ...
+ *
+ * The movie is streamed into a ring buffer while it plays, so it may
+ * be much longer than the buffer.  Playback starts with the first
+ * latch after MOVIE_PREBUFFER bytes (or the whole movie) arrived.
+ *
+ * Both controller ports latch on the same console signal but report
+ * it separately.  Whichever port reports first starts a new frame;
+ * every further latch within MOVIE_SAME_FRAME_US gets the same words,
+ * which also covers games that read the controllers more than once per
+ * frame.  If the words of a frame have not arrived in time, the
+ * previous ones are repeated and the rest of the movie is shifted by
+ * one frame; this is counted as an underrun.  A latch period of more
+ * than 1.5 times the last regular one is counted as a gap, since the
+ * driver may have missed a latch.
+ *
+ * The player does no locking; MoviePush() and MovieLatch() have to be
+ * serialised by the caller.  MovieLatch() is called from the SPI
+ * interrupt, so it stays in IRAM together with everything it calls and
+ * only touches the player state, which lives in DRAM.
+ *
+ * @endcode
+ * @author     SNESoIP contributors
+ * @copyright  "THE BEER-WARE LICENCE" (Revision 42)
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "MoviePlayer.h"
+
+#ifdef ESP_PLATFORM
+#include "esp_attr.h"
+#else
+#define IRAM_ATTR
+#endif
+
+static void _MovieNextFrame(MoviePlayer* pstPlayer, int64_t s64Now);
+
+/**
+ * @fn     void InitMoviePlayer(MoviePlayer* pstPlayer, uint8_t u8Ports, uint32_t u32Frames)
+ * @brief  Initialise movie player
+ * @param  pstPlayer
+ *         Player state
+ * @param  u8Ports
+ *         Controller ports per frame, 1 or 2
+ * @param  u32Frames
+ *         Number of frames
+ */
+void InitMoviePlayer(MoviePlayer* pstPlayer, uint8_t u8Ports, uint32_t u32Frames)
+{
+    memset(pstPlayer, 0, sizeof(struct MoviePlayer_t));
+    if (u8Ports < 1)
+    {
+        u8Ports = 1;
+    }
+    else if (u8Ports > MOVIE_MAX_PORTS)
+    {
+        u8Ports = MOVIE_MAX_PORTS;
+    }
+    pstPlayer->u8Ports           = u8Ports;
+    pstPlayer->u32Size           = u32Frames * u8Ports * 2;
+    pstPlayer->stStats.u32Frames = u32Frames;
+    for (uint8_t u8Port = 0; u8Port < MOVIE_MAX_PORTS; u8Port++)
+    {
+        pstPlayer->au16Word[u8Port] = 0xffff;
+    }
+}
+
+/**
+ * @fn      size_t MovieFree(const MoviePlayer* pstPlayer)
+ * @brief   Get the number of bytes MoviePush() accepts right now
+ * @param   pstPlayer
+ *          Player state
+ * @return  Number of bytes
+ */
+size_t MovieFree(const MoviePlayer* pstPlayer)
+{
+    uint32_t u32Free = MOVIE_BUFFER_SIZE - (pstPlayer->u32Head - pstPlayer->u32Tail);
+    uint32_t u32Left = pstPlayer->u32Size - pstPlayer->u32Head;
+
+    return u32Free < u32Left ? u32Free : u32Left;
+}
+
+/**
+ * @fn      size_t MoviePush(MoviePlayer* pstPlayer, const uint8_t* pu8Data, size_t uSize)
+ * @brief   Append movie data
+ * @param   pstPlayer
+ *          Player state
+ * @param   pu8Data
+ *          Movie data, may end in the middle of a word
+ * @param   uSize
+ *          Number of bytes
+ * @return  Number of bytes accepted
+ */
+size_t MoviePush(MoviePlayer* pstPlayer, const uint8_t* pu8Data, size_t uSize)
+{
+    size_t uFree = MovieFree(pstPlayer);
+
+    if (uSize > uFree)
+    {
+        uSize = uFree;
+    }
+    for (size_t uIndex = 0; uIndex < uSize; uIndex++)
+    {
+        pstPlayer->au8Ring[pstPlayer->u32Head & (MOVIE_BUFFER_SIZE - 1)] = pu8Data[uIndex];
+        pstPlayer->u32Head++;
+    }
+    pstPlayer->stStats.u32Received = pstPlayer->u32Head / (pstPlayer->u8Ports * 2);
+
+    return uSize;
+}
+
+/**
+ * @fn      bool MovieLatch(MoviePlayer* pstPlayer, uint8_t u8Port, int64_t s64Now, uint16_t* pu16Data)
+ * @brief   Get the word a controller port presents at a latch
+ * @param   pstPlayer
+ *          Player state
+ * @param   u8Port
+ *          Controller port
+ * @param   s64Now
+ *          Time of the latch in µs
+ * @param   pu16Data
+ *          Destination of the controller word
+ * @return  Status
+ * @retval  true  = The movie supplies the word
+ * @retval  false = Port not covered by the movie, prebuffering or done
+ */
+bool IRAM_ATTR MovieLatch(MoviePlayer* pstPlayer, uint8_t u8Port, int64_t s64Now, uint16_t* pu16Data)
+{
+    uint32_t u32Buffered = pstPlayer->u32Head - pstPlayer->u32Tail;
+    uint32_t u32Needed   = pstPlayer->u32Size - pstPlayer->u32Tail;
+
+    if (pstPlayer->bDone || u8Port >= pstPlayer->u8Ports)
+    {
+        return false;
+    }
+
+    if (! pstPlayer->bStarted)
+    {
+        if (u32Needed > MOVIE_PREBUFFER)
+        {
+            u32Needed = MOVIE_PREBUFFER;
+        }
+        if (u32Buffered < u32Needed)
+        {
+            return false;
+        }
+        pstPlayer->bStarted = true;
+    }
+
+    if (! pstPlayer->bFrameValid || (s64Now - pstPlayer->s64FrameTime) >= MOVIE_SAME_FRAME_US)
+    {
+        if (pstPlayer->u32Tail == pstPlayer->u32Size)
+        {
+            pstPlayer->bDone = true;
+            return false;
+        }
+        _MovieNextFrame(pstPlayer, s64Now);
+    }
+
+    pstPlayer->stStats.u32Latches++;
+    if (pstPlayer->au8Latches[u8Port] > 0)
+    {
+        pstPlayer->stStats.u32Repeats++;
+    }
+    if (pstPlayer->au8Latches[u8Port] < 0xff)
+    {
+        pstPlayer->au8Latches[u8Port]++;
+    }
+
+    *pu16Data = pstPlayer->au16Word[u8Port];
+    return true;
+}
+
+/**
+ * @fn     void _MovieNextFrame(MoviePlayer* pstPlayer, int64_t s64Now)
+ * @brief  Start a new frame
+ * @param  pstPlayer
+ *         Player state
+ * @param  s64Now
+ *         Time of the first latch of the frame in µs
+ */
+static void IRAM_ATTR _MovieNextFrame(MoviePlayer* pstPlayer, int64_t s64Now)
+{
+    uint32_t u32FrameSize = (uint32_t)pstPlayer->u8Ports * 2;
+
+    if (pstPlayer->bFrameValid)
+    {
+        uint32_t u32Period = (uint32_t)(s64Now - pstPlayer->s64FrameTime);
+
+        if (0 != pstPlayer->u32Period && u32Period > pstPlayer->u32Period + pstPlayer->u32Period / 2)
+        {
+            pstPlayer->stStats.u32Gaps++;
+        }
+        else
+        {
+            pstPlayer->u32Period = u32Period;
+        }
+    }
+
+    if (pstPlayer->u32Head - pstPlayer->u32Tail >= u32FrameSize)
+    {
+        for (uint8_t u8Port = 0; u8Port < pstPlayer->u8Ports; u8Port++)
+        {
+            uint8_t u8High = pstPlayer->au8Ring[pstPlayer->u32Tail       & (MOVIE_BUFFER_SIZE - 1)];
+            uint8_t u8Low  = pstPlayer->au8Ring[(pstPlayer->u32Tail + 1) & (MOVIE_BUFFER_SIZE - 1)];
+
+            pstPlayer->au16Word[u8Port] = (uint16_t)((u8High << 8) | u8Low);
+            pstPlayer->u32Tail         += 2;
+        }
+        pstPlayer->stStats.u32Played++;
+    }
+    else
+    {
+        pstPlayer->stStats.u32Underruns++;
+    }
+
+    for (uint8_t u8Port = 0; u8Port < MOVIE_MAX_PORTS; u8Port++)
+    {
+        pstPlayer->au8Latches[u8Port] = 0;
+    }
+    pstPlayer->bFrameValid  = true;
+    pstPlayer->s64FrameTime = s64Now;
+}
@@ -0,0 +1,516 @@
+/**
+ * @file       Netplay.c
+ * @brief      Peer-to-peer input exchange
+ * @ingroup    Firmware
+ * @details
+ * @code{.unparsed}
+ *
+ * Sends the local controller word on every console frame and feeds
+ * the words of the opponent into controller port 1.  The packet format
+ * is described in NetplayProtocol.c.
+ *
+ * The path to the opponent is negotiated with the exchange server
+ * acting as rendezvous, see _UdpHandler() in Server.c:
+ *
+ *   REGISTER  The socket is registered with the server until it
+ *             answers with the external endpoint of the opponent.
+ *   PUNCH     Input packets are sent directly to that endpoint.  Both
+ *             sides start at the same time, which opens the NAT
+ *             mappings on both routers.
+ *   DIRECT    A packet has arrived directly from the opponent.
+ *   RELAY     Nothing has arrived directly within NETPLAY_PUNCH_MS.
+ *             Input packets are sent to the server, which forwards
+ *             them.  A direct probe is still sent every
+ *             NETPLAY_PROBE_MS and the first direct packet switches
+ *             back to DIRECT.
+ *
+ * If the LAN discovery pairs the adapter with one on the same subnet
+ * first, the server is skipped entirely: SetNetplayPeer() starts at
+ * PUNCH and there is no fallback to RELAY.
+ *
+ * Both consoles run on their own crystal.  The send thread keeps the
+ * remote input aligned to the local frames, see ClockSync.c.
+ *
+ * @endcode
+ * @author     SNESoIP contributors
+ * @copyright  "THE BEER-WARE LICENCE" (Revision 42)
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "lwip/err.h"
+#include "lwip/sockets.h"
+#include "lwip/sys.h"
+#include "lwip/netdb.h"
+#include "ExchangeClient.h"
+#include "Netplay.h"
+#include "NetplayProtocol.h"
+#include "SNES.h"
+#include "Tasks.h"
+#include "Trace.h"
+
+/**
+ * @typedef  Netplay
+ * @brief    Input exchange data
+ * @struct   Netplay_t
+ * @brief    Input exchange data structure
+ */
+typedef struct Netplay_t
+{
+    bool               bIsRunning;     ///< Run condition
+    bool               bLocal;         ///< Paired by LAN discovery
+    TaskHandle_t       hTask;          ///< Receive thread, woken up by SetNetplayPeer()
+    int                nSock;          ///< UDP socket
+    uint8_t            u8ClientID;     ///< Own client ID
+    struct sockaddr_in stServerAddr;   ///< Address of the exchange server
+    struct sockaddr_in stPeerAddr;     ///< External endpoint of the opponent
+    portMUX_TYPE       stMux;          ///< Guards path and session state
+    NetplayPath        ePath;          ///< Current path
+    int64_t            s64PathStart;   ///< Time the current path was entered in µs
+    int64_t            s64LastReg;     ///< Time of the last registration in µs
+    int64_t            s64LastProbe;   ///< Time of the last direct probe in µs
+    NetplaySession     stSession;      ///< Session state
+
+} Netplay;
+
+/**
+ * @var    _stNetplay
+ * @brief  Input exchange private data
+ */
+static Netplay _stNetplay;
+
+static void _NetplayThread(void* pArg);
+static void _NetplaySendThread(void* pArg);
+static bool _NetplayOpenSocket(void);
+static void _NetplaySetPath(NetplayPath ePath, int64_t s64Now);
+static void _NetplayLogPath(NetplayPath eOldPath);
+static void _NetplayHandlePeer(const uint8_t* pu8Data, int64_t s64Now);
+static void _NetplayRegister(int64_t s64Now);
+static bool _IsSameEndpoint(const struct sockaddr_in* pstA, const struct sockaddr_in* pstB);
+
+/**
+ * @fn     void InitNetplay(void)
+ * @brief  Initialise input exchange
+ * @note   Has to be called after InitExchangeClient().
+ */
+void InitNetplay(void)
+{
+    ESP_LOGI("Netplay", "Initialise input exchange.");
+    memset(&_stNetplay, 0, sizeof(struct Netplay_t));
+    _stNetplay.nSock = -1;
+    vPortCPUInitializeMutex(&_stNetplay.stMux);
+    InitNetplaySession(&_stNetplay.stSession);
+    xTaskCreatePinnedToCore(
+        _NetplayThread, "NetplayThread", 3072, NULL,
+        TASK_PRIO_NETPLAY, &_stNetplay.hTask, TASK_CORE_NET);
+}
+
+/**
+ * @fn     void SetNetplayPeer(uint32_t u32Addr, uint16_t u16Port)
+ * @brief  Exchange input directly with an adapter on the LAN
+ * @param  u32Addr
+ *         Address of the peer, network byte order
+ * @param  u16Port
+ *         Input exchange port of the peer
+ */
+void SetNetplayPeer(uint32_t u32Addr, uint16_t u16Port)
+{
+    NetplayPath eOldPath = _stNetplay.ePath;
+
+    portENTER_CRITICAL(&_stNetplay.stMux);
+    _stNetplay.bLocal                     = true;
+    _stNetplay.stPeerAddr.sin_family      = AF_INET;
+    _stNetplay.stPeerAddr.sin_addr.s_addr = u32Addr;
+    _stNetplay.stPeerAddr.sin_port        = htons(u16Port);
+    _NetplaySetPath(NETPLAY_PATH_PUNCH, esp_timer_get_time());
+    portEXIT_CRITICAL(&_stNetplay.stMux);
+    _NetplayLogPath(eOldPath);
+
+    if (NULL != _stNetplay.hTask)
+    {
+        xTaskNotifyGive(_stNetplay.hTask);
+    }
+}
+
+/**
+ * @fn     void GetNetplayStats(NetplayStats* pstStats)
+ * @brief  Get input exchange statistics
+ * @param  pstStats
+ *         Destination of the statistics
+ */
+void GetNetplayStats(NetplayStats* pstStats)
+{
+    portENTER_CRITICAL(&_stNetplay.stMux);
+    memcpy(pstStats, &_stNetplay.stSession.stStats, sizeof(NetplayStats));
+    portEXIT_CRITICAL(&_stNetplay.stMux);
+}
+
+/**
+ * @fn     void GetNetplayClockStats(ClockSyncStats* pstStats)
+ * @brief  Get peer clock synchronisation statistics
+ * @param  pstStats
+ *         Destination of the statistics
+ */
+void GetNetplayClockStats(ClockSyncStats* pstStats)
+{
+    portENTER_CRITICAL(&_stNetplay.stMux);
+    memcpy(pstStats, &_stNetplay.stSession.stClock.stStats, sizeof(ClockSyncStats));
+    portEXIT_CRITICAL(&_stNetplay.stMux);
+}
+
+/**
+ * @fn     NetplayPath GetNetplayPath(void)
+ * @brief  Get the path of the input packets
+ */
+NetplayPath GetNetplayPath(void)
+{
+    return _stNetplay.ePath;
+}
+
+/**
+ * @fn       void _NetplayThread(void* pArg)
+ * @brief    Input exchange receive thread
+ * @details  Waits until the exchange server or the LAN discovery has
+ *           paired this client with an opponent, starts the send thread and then handles
+ *           every datagram as soon as it arrives.
+ * @param    pArg
+ *           Unused
+ */
+static void _NetplayThread(void* pArg)
+{
+    uint8_t  au8IpAddr[4];
+    uint8_t  au8RxBuffer[NETPLAY_PACKET_SIZE + 1];
+    uint32_t u32ServerAddr;
+    uint16_t u16ServerPort;
+    (void)pArg;
+
+    while (! _stNetplay.bLocal &&
+           (! GetExchangeOpponent(au8IpAddr) || ! GetExchangeClientID(&_stNetplay.u8ClientID)))
+    {
+        ulTaskNotifyTake(pdTRUE, 500 / portTICK_PERIOD_MS);
+    }
+
+    if (! _stNetplay.bLocal)
+    {
+        GetExchangeServer(&u32ServerAddr, &u16ServerPort);
+        _stNetplay.stServerAddr.sin_family      = AF_INET;
+        _stNetplay.stServerAddr.sin_addr.s_addr = u32ServerAddr;
+        _stNetplay.stServerAddr.sin_port        = htons(u16ServerPort);
+    }
+
+    if (! _NetplayOpenSocket())
+    {
+        vTaskDelete(NULL);
+        return;
+    }
+
+    ResetSNESRemoteInput();
+    _stNetplay.bIsRunning = true;
+    xTaskCreatePinnedToCore(
+        _NetplaySendThread, "NetplaySendThread", 2048, NULL,
+        TASK_PRIO_NETPLAY_SEND, NULL, TASK_CORE_NET);
+
+    while (_stNetplay.bIsRunning)
+    {
+        struct sockaddr_in stSourceAddr;
+        socklen_t          uAddrLen = sizeof(stSourceAddr);
+        NetplayPacket      stPacket;
+        NetplayPath        eOldPath;
+        int64_t            s64Now;
+        bool               bFromPeer;
+        int                nLen;
+
+        nLen = recvfrom(_stNetplay.nSock, au8RxBuffer, sizeof(au8RxBuffer), 0,
+                        (struct sockaddr*)&stSourceAddr, &uAddrLen);
+        if (0 > nLen)
+        {
+            ESP_LOGE("Netplay", "recvfrom failed: errno %d", errno);
+            vTaskDelay(100 / portTICK_PERIOD_MS);
+            continue;
+        }
+        s64Now = esp_timer_get_time();
+        TraceRecord(TRACE_PACKET_RX, (uint16_t)nLen, 0);
+
+        if (_IsSameEndpoint(&stSourceAddr, &_stNetplay.stServerAddr))
+        {
+            if (11 == nLen && 0 == memcmp(au8RxBuffer, "Peer", 4))
+            {
+                _NetplayHandlePeer(au8RxBuffer, s64Now);
+                continue;
+            }
+            bFromPeer = false;
+        }
+        else if (NETPLAY_PATH_REGISTER != _stNetplay.ePath && _IsSameEndpoint(&stSourceAddr, &_stNetplay.stPeerAddr))
+        {
+            bFromPeer = true;
+        }
+        else
+        {
+            continue;
+        }
+
+        eOldPath = _stNetplay.ePath;
+        portENTER_CRITICAL(&_stNetplay.stMux);
+        if (DecodeNetplayPacket(&stPacket, au8RxBuffer, (size_t)nLen))
+        {
+            NetplayHandlePacket(&_stNetplay.stSession, &stPacket, s64Now, PushSNESRemoteInput);
+            if (bFromPeer && NETPLAY_PATH_DIRECT != _stNetplay.ePath)
+            {
+                _NetplaySetPath(NETPLAY_PATH_DIRECT, s64Now);
+            }
+        }
+        else
+        {
+            _stNetplay.stSession.stStats.u32RxInvalid++;
+        }
+        portEXIT_CRITICAL(&_stNetplay.stMux);
+        _NetplayLogPath(eOldPath);
+    }
+
+    close(_stNetplay.nSock);
+    vTaskDelete(NULL);
+}
+
+/**
+ * @fn       void _NetplaySendThread(void* pArg)
+ * @brief    Input exchange send thread
+ * @details  Woken up by the port 0 latch, so the word goes out right
+ *           when the console has read it.  While the console is off,
+ *           the current word is repeated as keep-alive.  Afterwards the
+ *           remote input delay is checked against the peer's frame
+ *           clock.
+ * @param    pArg
+ *           Unused
+ */
+static void _NetplaySendThread(void* pArg)
+{
+    uint8_t au8TxBuffer[NETPLAY_PACKET_SIZE];
+    (void)pArg;
+
+    SetSNESFrameNotify(xTaskGetCurrentTaskHandle());
+
+    while (_stNetplay.bIsRunning)
+    {
+        SNESInputStamp     stStamp;
+        NetplayPacket      stPacket;
+        struct sockaddr_in stDest;
+        NetplayPath        eOldPath;
+        bool               bProbe = false;
+        uint32_t           u32Frame;
+        int64_t            s64Latch;
+        uint32_t           u32PlayFrame;
+        int64_t            s64PlayTime;
+        bool               bPlaying;
+        int8_t             s8Slip = 0;
+        int64_t            s64Now;
+        size_t             uSize;
+
+        ulTaskNotifyTake(pdTRUE, NETPLAY_KEEPALIVE_MS / portTICK_PERIOD_MS);
+        GetSNESInputStamp(&stStamp);
+        GetSNESLatchTime(&u32Frame, &s64Latch);
+        bPlaying = GetSNESRemotePlayout(&u32PlayFrame, &s64PlayTime);
+        s64Now   = esp_timer_get_time();
+
+        _NetplayRegister(s64Now);
+        if (NETPLAY_PATH_REGISTER == _stNetplay.ePath)
+        {
+            continue;
+        }
+
+        eOldPath = _stNetplay.ePath;
+        portENTER_CRITICAL(&_stNetplay.stMux);
+        if (NETPLAY_PATH_PUNCH == _stNetplay.ePath && ! _stNetplay.bLocal &&
+            (s64Now - _stNetplay.s64PathStart) > NETPLAY_PUNCH_MS * 1000LL)
+        {
+            _NetplaySetPath(NETPLAY_PATH_RELAY, s64Now);
+        }
+        if (NETPLAY_PATH_RELAY == _stNetplay.ePath)
+        {
+            stDest = _stNetplay.stServerAddr;
+            if ((s64Now - _stNetplay.s64LastProbe) > NETPLAY_PROBE_MS * 1000LL)
+            {
+                _stNetplay.s64LastProbe = s64Now;
+                bProbe                  = true;
+            }
+        }
+        else
+        {
+            stDest = _stNetplay.stPeerAddr;
+        }
+        NetplayBuildPacket(&_stNetplay.stSession, u32Frame, stStamp.u16Data, s64Latch, s64Now, &stPacket);
+        ClockSyncAddLocalLatch(&_stNetplay.stSession.stClock, u32Frame, s64Latch);
+        if (bPlaying)
+        {
+            s8Slip = ClockSyncAlign(&_stNetplay.stSession.stClock, u32PlayFrame, s64PlayTime, GetSNESRemoteDelay(), s64Now);
+        }
+        portEXIT_CRITICAL(&_stNetplay.stMux);
+        _NetplayLogPath(eOldPath);
+
+        if (0 != s8Slip)
+        {
+            AdjustSNESRemoteDelay(s8Slip);
+        }
+
+        uSize = EncodeNetplayPacket(&stPacket, au8TxBuffer, sizeof(au8TxBuffer));
+        if (0 > sendto(_stNetplay.nSock, au8TxBuffer, uSize, 0, (struct sockaddr*)&stDest, sizeof(stDest)))
+        {
+            ESP_LOGE("Netplay", "sendto failed: errno %d", errno);
+            continue;
+        }
+        TraceRecord(TRACE_PACKET_TX, (uint16_t)uSize, u32Frame);
+        MarkSNESInputSent(&stStamp);
+
+        if (bProbe)
+        {
+            sendto(_stNetplay.nSock, au8TxBuffer, uSize, 0,
+                   (struct sockaddr*)&_stNetplay.stPeerAddr, sizeof(_stNetplay.stPeerAddr));
+        }
+    }
+
+    SetSNESFrameNotify(NULL);
+    vTaskDelete(NULL);
+}
+
+/**
+ * @fn      bool _NetplayOpenSocket(void)
+ * @brief   Create and bind the UDP socket
+ * @return  Status
+ * @retval  true  = OK
+ * @retval  false = Error
+ */
+static bool _NetplayOpenSocket(void)
+{
+    struct sockaddr_in stLocalAddr;
+
+    _stNetplay.nSock = socket(AF_INET, SOCK_DGRAM, IPPROTO_IP);
+    if (0 > _stNetplay.nSock)
+    {
+        ESP_LOGE("Netplay", "Unable to create socket: errno %d", errno);
+        return false;
+    }
+
+    memset(&stLocalAddr, 0, sizeof(stLocalAddr));
+    stLocalAddr.sin_addr.s_addr = htonl(INADDR_ANY);
+    stLocalAddr.sin_family      = AF_INET;
+    stLocalAddr.sin_port        = htons(NETPLAY_PORT);
+    if (0 != bind(_stNetplay.nSock, (struct sockaddr*)&stLocalAddr, sizeof(stLocalAddr)))
+    {
+        ESP_LOGE("Netplay", "Couldn't bind name to socket: errno %d", errno);
+        close(_stNetplay.nSock);
+        _stNetplay.nSock = -1;
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * @fn     void _NetplaySetPath(NetplayPath ePath, int64_t s64Now)
+ * @brief  Switch to another path
+ * @note   Has to be called with stMux held.
+ * @param  ePath
+ *         New path
+ * @param  s64Now
+ *         Current time in µs
+ */
+static void _NetplaySetPath(NetplayPath ePath, int64_t s64Now)
+{
+    _stNetplay.ePath        = ePath;
+    _stNetplay.s64PathStart = s64Now;
+}
+
+/**
+ * @fn     void _NetplayLogPath(NetplayPath eOldPath)
+ * @brief  Log a path change, outside of the critical section
+ * @param  eOldPath
+ *         Path before the change
+ */
+static void _NetplayLogPath(NetplayPath eOldPath)
+{
+    static const char* const apacPath[] = { "register", "punch", "direct", "relay" };
+
+    if (eOldPath != _stNetplay.ePath)
+    {
+        ESP_LOGI("Netplay", "Path: %s -> %s", apacPath[eOldPath], apacPath[_stNetplay.ePath]);
+    }
+}
+
+/**
+ * @fn     void _NetplayHandlePeer(const uint8_t* pu8Data, int64_t s64Now)
+ * @brief  Handle the opponent's endpoint sent by the server
+ * @param  pu8Data
+ *         Peer message, see _UdpHandler() in Server.c
+ * @param  s64Now
+ *         Current time in µs
+ */
+static void _NetplayHandlePeer(const uint8_t* pu8Data, int64_t s64Now)
+{
+    struct sockaddr_in stPeerAddr;
+    NetplayPath        eOldPath = _stNetplay.ePath;
+
+    if (pu8Data[4] != (_stNetplay.u8ClientID ^ 1))
+    {
+        return;
+    }
+
+    memset(&stPeerAddr, 0, sizeof(stPeerAddr));
+    stPeerAddr.sin_family = AF_INET;
+    memcpy(&stPeerAddr.sin_addr.s_addr, &pu8Data[5], 4);
+    memcpy(&stPeerAddr.sin_port, &pu8Data[9], 2);
+
+    portENTER_CRITICAL(&_stNetplay.stMux);
+    if (NETPLAY_PATH_REGISTER == _stNetplay.ePath || ! _IsSameEndpoint(&stPeerAddr, &_stNetplay.stPeerAddr))
+    {
+        // New or changed endpoint, both sides start punching now.
+        _stNetplay.stPeerAddr = stPeerAddr;
+        _NetplaySetPath(NETPLAY_PATH_PUNCH, s64Now);
+    }
+    portEXIT_CRITICAL(&_stNetplay.stMux);
+    _NetplayLogPath(eOldPath);
+}
+
+/**
+ * @fn       void _NetplayRegister(int64_t s64Now)
+ * @brief    Register the socket with the exchange server if due
+ * @details  Frequently until the server has answered, then only to
+ *           keep the NAT mapping and the relay open.
+ * @param    s64Now
+ *           Current time in µs
+ */
+static void _NetplayRegister(int64_t s64Now)
+{
+    int64_t s64Interval = NETPLAY_REFRESH_MS * 1000LL;
+    uint8_t au8Reg[4]   = { 'R', 'e', 'g', _stNetplay.u8ClientID };
+
+    if (_stNetplay.bLocal)
+    {
+        return;
+    }
+    if (NETPLAY_PATH_REGISTER == _stNetplay.ePath)
+    {
+        s64Interval = NETPLAY_REGISTER_MS * 1000LL;
+    }
+    if ((s64Now - _stNetplay.s64LastReg) < s64Interval && 0 != _stNetplay.s64LastReg)
+    {
+        return;
+    }
+    _stNetplay.s64LastReg = s64Now;
+
+    sendto(_stNetplay.nSock, au8Reg, sizeof(au8Reg), 0,
+           (struct sockaddr*)&_stNetplay.stServerAddr, sizeof(_stNetplay.stServerAddr));
+}
+
+/**
+ * @fn     bool _IsSameEndpoint(const struct sockaddr_in* pstA, const struct sockaddr_in* pstB)
+ * @brief  Compare address and port of two endpoints
+ */
+static bool _IsSameEndpoint(const struct sockaddr_in* pstA, const struct sockaddr_in* pstB)
+{
+    return pstA->sin_addr.s_addr == pstB->sin_addr.s_addr && pstA->sin_port == pstB->sin_port;
+}
@@ -0,0 +1,359 @@
+/**
+ * @file       NetplayProtocol.c
+ * @brief      Peer-to-peer input protocol
+ * @ingroup    Firmware
+ * @details
+ * @code{.unparsed}
+ *
+ * Once both adapters know each other's address (Stage 3, see Server.c),
+ * they exchange their controller words directly via UDP.  One packet
+ * is sent per console frame.  All fields are little-endian:
+ *
+ *   +-------+-------+-------+-------+-------+---------+---------+-------+
+ *   | 0     | 1     | 2..3  | 4..5  | 6..7  | 8..11   | 12..15  | 16..17|
+ *   +-------+-------+-------+-------+-------+---------+---------+-------+
+ *   | $4E   | CNT   | SEQ   | ACK   | ADL   | FRAME   | TIME    | LAGE  |
+ *   +-------+-------+-------+-------+-------+---------+---------+-------+
+ *   | 18..19: word of FRAME, 20..21: word of FRAME-1, ...                |
+ *   +--------------------------------------------------------------------+
+ *
+ *   CNT:   Number of controller words, 1 to NETPLAY_HISTORY
+ *   SEQ:   Sequence number, incremented for each packet
+ *   ACK:   Newest sequence number received from the peer
+ *   ADL:   Time between receiving ACK and sending this packet in units
+ *          of 10µs, NETPLAY_NO_ACK if nothing has been received yet
+ *   FRAME: Sender's frame number of the newest word
+ *   TIME:  Sender's clock at sending in µs, lower 32 bits
+ *   LAGE:  Time between the console latch of FRAME and sending in
+ *          units of 10µs, NETPLAY_NO_LATCH if older than that
+ *
+ * As every packet repeats the last NETPLAY_HISTORY words, a lost
+ * packet is covered by the next one and costs no input.  The round-trip
+ * time is the time between sending SEQ and receiving it back as ACK,
+ * minus the peer's ack delay.  It is smoothed as in RFC 6298.  Together
+ * with TIME, the same timestamps synchronise the clocks of both
+ * adapters, and LAGE places the peer's latch edges on the local time
+ * line, see ClockSync.c.
+ *
+ * No sockets or FreeRTOS calls are used here, so the same code runs on
+ * the adapter and in the host benchmark (Tools/NetplayBench).
+ *
+ * @endcode
+ * @author     SNESoIP contributors
+ * @copyright  "THE BEER-WARE LICENCE" (Revision 42)
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "NetplayProtocol.h"
+
+static void     _PutU16(uint8_t* pu8Dest, uint16_t u16Value);
+static void     _PutU32(uint8_t* pu8Dest, uint32_t u32Value);
+static uint16_t _GetU16(const uint8_t* pu8Src);
+static uint32_t _GetU32(const uint8_t* pu8Src);
+static void     _NetplayUpdateRTT(NetplaySession* pstSession, uint32_t u32RTT);
+
+/**
+ * @fn      size_t EncodeNetplayPacket(const NetplayPacket* pstPacket, uint8_t* pu8Buffer, size_t uSize)
+ * @brief   Serialise an input packet
+ * @param   pstPacket
+ *          Packet
+ * @param   pu8Buffer
+ *          Destination buffer
+ * @param   uSize
+ *          Size of the destination buffer in bytes
+ * @return  Packet size in bytes, 0 if the buffer is too small
+ */
+size_t EncodeNetplayPacket(const NetplayPacket* pstPacket, uint8_t* pu8Buffer, size_t uSize)
+{
+    size_t uPacketSize = NETPLAY_HEADER_SIZE + 2 * (size_t)pstPacket->u8Count;
+
+    if (uSize < uPacketSize || 0 == pstPacket->u8Count || pstPacket->u8Count > NETPLAY_HISTORY)
+    {
+        return 0;
+    }
+
+    pu8Buffer[0] = NETPLAY_MAGIC;
+    pu8Buffer[1] = pstPacket->u8Count;
+    _PutU16(&pu8Buffer[2], pstPacket->u16Seq);
+    _PutU16(&pu8Buffer[4], pstPacket->u16Ack);
+    _PutU16(&pu8Buffer[6], pstPacket->u16AckDelay);
+    _PutU32(&pu8Buffer[8], pstPacket->u32Frame);
+    _PutU32(&pu8Buffer[12], pstPacket->u32Time);
+    _PutU16(&pu8Buffer[16], pstPacket->u16LatchAge);
+    for (uint8_t u8Index = 0; u8Index < pstPacket->u8Count; u8Index++)
+    {
+        _PutU16(&pu8Buffer[NETPLAY_HEADER_SIZE + 2 * u8Index], pstPacket->au16Words[u8Index]);
+    }
+
+    return uPacketSize;
+}
+
+/**
+ * @fn      bool DecodeNetplayPacket(NetplayPacket* pstPacket, const uint8_t* pu8Buffer, size_t uSize)
+ * @brief   Parse an input packet
+ * @param   pstPacket
+ *          Destination of the packet
+ * @param   pu8Buffer
+ *          Received data
+ * @param   uSize
+ *          Size of the received data in bytes
+ * @return  Status
+ * @retval  true  = Valid packet
+ * @retval  false = Malformed packet
+ */
+bool DecodeNetplayPacket(NetplayPacket* pstPacket, const uint8_t* pu8Buffer, size_t uSize)
+{
+    if (uSize < NETPLAY_HEADER_SIZE || NETPLAY_MAGIC != pu8Buffer[0])
+    {
+        return false;
+    }
+
+    pstPacket->u8Count = pu8Buffer[1];
+    if (0 == pstPacket->u8Count || pstPacket->u8Count > NETPLAY_HISTORY ||
+        uSize != NETPLAY_HEADER_SIZE + 2 * (size_t)pstPacket->u8Count)
+    {
+        return false;
+    }
+
+    pstPacket->u16Seq      = _GetU16(&pu8Buffer[2]);
+    pstPacket->u16Ack      = _GetU16(&pu8Buffer[4]);
+    pstPacket->u16AckDelay = _GetU16(&pu8Buffer[6]);
+    pstPacket->u32Frame    = _GetU32(&pu8Buffer[8]);
+    pstPacket->u32Time     = _GetU32(&pu8Buffer[12]);
+    pstPacket->u16LatchAge = _GetU16(&pu8Buffer[16]);
+    for (uint8_t u8Index = 0; u8Index < pstPacket->u8Count; u8Index++)
+    {
+        pstPacket->au16Words[u8Index] = _GetU16(&pu8Buffer[NETPLAY_HEADER_SIZE + 2 * u8Index]);
+    }
+
+    return true;
+}
+
+/**
+ * @fn     void InitNetplaySession(NetplaySession* pstSession)
+ * @brief  Initialise input exchange session
+ * @param  pstSession
+ *         Session state
+ */
+void InitNetplaySession(NetplaySession* pstSession)
+{
+    memset(pstSession, 0, sizeof(struct NetplaySession_t));
+    InitClockSync(&pstSession->stClock);
+}
+
+/**
+ * @fn       void NetplayBuildPacket(NetplaySession* pstSession, uint32_t u32Frame, uint16_t u16Data, int64_t s64Latch, int64_t s64Now, NetplayPacket* pstPacket)
+ * @brief    Record the local word of a frame and build the packet to send
+ * @details  Frames skipped since the last call get the same word.  The
+ *           same frame may be sent repeatedly, e.g. as keep-alive
+ *           while the console is off.
+ * @param    pstSession
+ *           Session state
+ * @param    u32Frame
+ *           Local frame number
+ * @param    u16Data
+ *           Local controller word
+ * @param    s64Latch
+ *           Time of the console latch of u32Frame in µs
+ * @param    s64Now
+ *           Current time in µs
+ * @param    pstPacket
+ *           Destination of the packet
+ */
+void NetplayBuildPacket(NetplaySession* pstSession, uint32_t u32Frame, uint16_t u16Data, int64_t s64Latch, int64_t s64Now, NetplayPacket* pstPacket)
+{
+    uint32_t u32Gap      = u32Frame - pstSession->u32Frame;
+    int64_t  s64LatchAge = (s64Now - s64Latch) / 10;
+
+    if (0 == pstSession->u8HistoryLen || u32Gap > NETPLAY_HISTORY)
+    {
+        u32Gap                   = 1;
+        pstSession->u8HistoryLen = 0;
+    }
+    while (u32Gap-- > 0)
+    {
+        if (pstSession->u8HistoryLen < NETPLAY_HISTORY)
+        {
+            pstSession->u8HistoryLen++;
+        }
+        pstSession->au16History[(u32Frame - u32Gap) & (NETPLAY_HISTORY - 1)] = u16Data;
+    }
+    pstSession->au16History[u32Frame & (NETPLAY_HISTORY - 1)] = u16Data;
+    pstSession->u32Frame = u32Frame;
+
+    pstPacket->u16Seq   = pstSession->u16TxSeq++;
+    pstPacket->u32Frame = u32Frame;
+    pstPacket->u32Time  = (uint32_t)s64Now;
+    pstPacket->u8Count  = pstSession->u8HistoryLen;
+    if (s64LatchAge >= 0 && s64LatchAge < NETPLAY_NO_LATCH)
+    {
+        pstPacket->u16LatchAge = (uint16_t)s64LatchAge;
+    }
+    else
+    {
+        pstPacket->u16LatchAge = NETPLAY_NO_LATCH;
+    }
+    for (uint8_t u8Index = 0; u8Index < pstPacket->u8Count; u8Index++)
+    {
+        pstPacket->au16Words[u8Index] = pstSession->au16History[(u32Frame - u8Index) & (NETPLAY_HISTORY - 1)];
+    }
+
+    if (pstSession->bRxValid)
+    {
+        int64_t s64Delay = (s64Now - pstSession->s64RxTime) / 10;
+
+        pstPacket->u16Ack      = pstSession->u16RxSeq;
+        pstPacket->u16AckDelay = s64Delay < NETPLAY_NO_ACK ? (uint16_t)s64Delay : NETPLAY_NO_ACK - 1;
+    }
+    else
+    {
+        pstPacket->u16Ack      = 0;
+        pstPacket->u16AckDelay = NETPLAY_NO_ACK;
+    }
+
+    pstSession->as64TxTime[pstPacket->u16Seq & (NETPLAY_SEQ_WINDOW - 1)] = s64Now;
+    pstSession->stStats.u32TxPackets++;
+}
+
+/**
+ * @fn       void NetplayHandlePacket(NetplaySession* pstSession, const NetplayPacket* pstPacket, int64_t s64Now, NetplayInputFn pfnInput)
+ * @brief    Process a packet received from the peer
+ * @details  Every remote frame is delivered exactly once and in order,
+ *           no matter how often it is repeated by later packets.
+ * @param    pstSession
+ *           Session state
+ * @param    pstPacket
+ *           Received packet
+ * @param    s64Now
+ *           Receive time in µs
+ * @param    pfnInput
+ *           Receives the new remote words
+ */
+void NetplayHandlePacket(NetplaySession* pstSession, const NetplayPacket* pstPacket, int64_t s64Now, NetplayInputFn pfnInput)
+{
+    uint32_t u32Oldest = pstPacket->u32Frame - (pstPacket->u8Count - 1);
+    int64_t  s64Remote = ClockSyncRemoteTime(&pstSession->stClock, pstPacket->u32Time);
+
+    pstSession->stStats.u32RxPackets++;
+
+    if (! pstSession->bRxValid || (int16_t)(pstPacket->u16Seq - pstSession->u16RxSeq) > 0)
+    {
+        pstSession->bRxValid  = true;
+        pstSession->u16RxSeq  = pstPacket->u16Seq;
+        pstSession->s64RxTime = s64Now;
+    }
+    else
+    {
+        pstSession->stStats.u32RxReordered++;
+    }
+
+    // Round-trip time and clock offset, only sampled once per
+    // acknowledged packet.
+    if (NETPLAY_NO_ACK != pstPacket->u16AckDelay &&
+        (uint16_t)(pstSession->u16TxSeq - pstPacket->u16Ack) <= NETPLAY_SEQ_WINDOW &&
+        (! pstSession->bAckValid || (int16_t)(pstPacket->u16Ack - pstSession->u16LastAck) > 0))
+    {
+        int64_t s64Sent = pstSession->as64TxTime[pstPacket->u16Ack & (NETPLAY_SEQ_WINDOW - 1)];
+        int64_t s64RTT  = s64Now - s64Sent - (int64_t)pstPacket->u16AckDelay * 10;
+
+        pstSession->bAckValid  = true;
+        pstSession->u16LastAck = pstPacket->u16Ack;
+        if (s64RTT >= 0)
+        {
+            _NetplayUpdateRTT(pstSession, (uint32_t)s64RTT);
+            ClockSyncAddSample(&pstSession->stClock, s64Sent, s64Now,
+                               s64Remote - (int64_t)pstPacket->u16AckDelay * 10, s64Remote);
+        }
+    }
+
+    if (NETPLAY_NO_LATCH != pstPacket->u16LatchAge)
+    {
+        ClockSyncAddRemoteLatch(&pstSession->stClock, pstPacket->u32Frame,
+                                s64Remote - (int64_t)pstPacket->u16LatchAge * 10, s64Now);
+    }
+
+    if (pstSession->bRemoteValid)
+    {
+        if ((int32_t)(u32Oldest - pstSession->u32RemoteFrame) > 1)
+        {
+            pstSession->stStats.u32Lost += u32Oldest - pstSession->u32RemoteFrame - 1;
+        }
+    }
+
+    for (int16_t s16Index = pstPacket->u8Count - 1; s16Index >= 0; s16Index--)
+    {
+        uint32_t u32Frame = pstPacket->u32Frame - (uint32_t)s16Index;
+
+        if (pstSession->bRemoteValid && (int32_t)(u32Frame - pstSession->u32RemoteFrame) <= 0)
+        {
+            continue;
+        }
+        if (pstSession->bRemoteValid && s16Index > 0)
+        {
+            pstSession->stStats.u32Recovered++;
+        }
+        pstSession->bRemoteValid   = true;
+        pstSession->u32RemoteFrame = u32Frame;
+        if (NULL != pfnInput)
+        {
+            pfnInput(u32Frame, pstPacket->au16Words[s16Index]);
+        }
+    }
+}
+
+/**
+ * @fn     void _NetplayUpdateRTT(NetplaySession* pstSession, uint32_t u32RTT)
+ * @brief  Update the round-trip time estimate
+ * @param  pstSession
+ *         Session state
+ * @param  u32RTT
+ *         Round-trip time sample in µs
+ */
+static void _NetplayUpdateRTT(NetplaySession* pstSession, uint32_t u32RTT)
+{
+    NetplayStats* pstStats = &pstSession->stStats;
+    uint32_t      u32Diff;
+
+    pstStats->u32RTTLast = u32RTT;
+    if (0 == pstStats->u32RTTSmooth)
+    {
+        pstStats->u32RTTMin    = u32RTT;
+        pstStats->u32RTTSmooth = u32RTT;
+        pstStats->u32RTTVar    = u32RTT / 2;
+        return;
+    }
+
+    if (u32RTT < pstStats->u32RTTMin)
+    {
+        pstStats->u32RTTMin = u32RTT;
+    }
+    u32Diff = u32RTT > pstStats->u32RTTSmooth ? u32RTT - pstStats->u32RTTSmooth : pstStats->u32RTTSmooth - u32RTT;
+    pstStats->u32RTTVar    += ((int32_t)u32Diff - (int32_t)pstStats->u32RTTVar) / 4;
+    pstStats->u32RTTSmooth += ((int32_t)u32RTT - (int32_t)pstStats->u32RTTSmooth) / 8;
+}
+
+static void _PutU16(uint8_t* pu8Dest, uint16_t u16Value)
+{
+    pu8Dest[0] = u16Value & 0xff;
+    pu8Dest[1] = u16Value >> 8;
+}
+
+static void _PutU32(uint8_t* pu8Dest, uint32_t u32Value)
+{
+    _PutU16(&pu8Dest[0], u32Value & 0xffff);
+    _PutU16(&pu8Dest[2], u32Value >> 16);
+}
+
+static uint16_t _GetU16(const uint8_t* pu8Src)
+{
+    return (uint16_t)pu8Src[0] | ((uint16_t)pu8Src[1] << 8);
+}
+
+static uint32_t _GetU32(const uint8_t* pu8Src)
+{
+    return (uint32_t)_GetU16(&pu8Src[0]) | ((uint32_t)_GetU16(&pu8Src[2]) << 16);
+}
@@ -23,12 +23,12 @@
  *   | SNES Port0  |  2  | Clock     | LShft | IO 14 |
  *   | SNES Port0  |  3  | Latch     | LShft | IO 15 |
  *   | SNES Port0  |  4  | Data      | LShft | IO 12 |
- *   | SNES Port0  |  6  | IOPort 6  | LShft |       |
+ *   | SNES Port0  |  6  | IOPort 6  | LShft | IO 32 |
  *   +-------------+-----+-----------+-------+-------+
  *   | SNES Port1  |  2  | Clock     | LShft | IO 18 |
  *   | SNES Port1  |  3  | Latch     | LShft | IO  5 |
  *   | SNES Port1  |  4  | Data      | LShft | IO 19 |
- *   | SNES Port1  |  6  | IOPort 7  | LShft |       |
+ *   | SNES Port1  |  6  | IOPort 7  | LShft | IO 33 |
  *   | SNES Port1  |  7  | GND       |  GND  |       |
  *   +-------------+-----+-----------+-------+-------+
  *   | SNES Input  |  1  | +5V       |  +5V  |       |
@@ -81,13 +81,64 @@
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/semphr.h"
 #include "esp_err.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "driver/rmt.h"
 #include "driver/gpio.h"
 #include "driver/spi_slave.h"
-#include "rom/ets_sys.h"
+#include "soc/gpio_struct.h"
+#include "soc/io_mux_reg.h"
+#include "Debounce.h"
+#include "Latency.h"
 #include "SNES.h"
+#include "Tasks.h"
+#include "Trace.h"
+
+#define SNES_CAPTURE_BITS     16     // !< Number of bits per controller read
+#define SNES_CAPTURE_TIMEOUT  2      // !< Capture timeout in ticks
+#define SNES_FRAME_PERIOD_MIN 15000  // !< Shortest plausible latch period in µs
+#define SNES_FRAME_PERIOD_MAX 21000  // !< Longest plausible latch period in µs
+#define SNES_PORT_QUEUE_SIZE  3      // !< Transactions armed per controller port
+#define SNES_PORT_TRANS_BITS  17     // !< Controller word plus dummy bit
+
+/**
+ * @typedef  SNESPort
+ * @brief    Controller port data
+ * @struct   SNESPort_t
+ * @brief    Controller port data structure
+ */
+typedef struct SNESPort_t
+{
+    spi_host_device_t            eHost;  ///< SPI host
+    spi_bus_config_t             stBus;  ///< SPI bus configuration
+    spi_slave_interface_config_t stIf;   ///< SPI interface configuration
+
+    /// Transaction ring, all entries transmit u32Tx
+    spi_slave_transaction_t astTrans[SNES_PORT_QUEUE_SIZE];
+
+    volatile uint32_t u32Tx;       ///< Word shifted out at the next latch
+    volatile int64_t  s64TxTime;   ///< Capture time of u32Tx in µs
+    volatile uint8_t  u8Armed;     ///< Number of queued transactions
+    SNESPortStats     stStats;     ///< Port statistics
+
+} SNESPort;
+
+/**
+ * @typedef  SNESRemoteSlot
+ * @brief    Remote input queue entry
+ * @struct   SNESRemoteSlot_t
+ * @brief    Remote input queue entry structure
+ */
+typedef struct SNESRemoteSlot_t
+{
+    int64_t  s64Arrival; ///< Receive time in µs
+    uint32_t u32Frame;   ///< Remote frame number
+    uint16_t u16Data;    ///< Remote controller word
+    bool     bValid;    ///< Entry holds a word not yet presented
+
+} SNESRemoteSlot;
 
 /**
  * @typedef  SNESDriver
@@ -102,13 +153,8 @@ typedef struct SNESDriver_t
     bool     bIOPortBit6;   ///< Programmable I/O Port bit 6
     bool     bIOPortBit7;   ///< Programmable I/O Port bit 7
 
-    uint32_t                     u32Port0Tx;  ///< Port 0 TX buffer
-    spi_bus_config_t             stPort0Bus;  ///< HSPI bus configuration
-    spi_slave_interface_config_t stPort0;     ///< HSPI interface configuration
-
-    uint32_t                     u32Port1Tx;  ///< Port 1 TX buffer
-    spi_bus_config_t             stPort1Bus;  ///< VSPI bus configuration
-    spi_slave_interface_config_t stPort1;     ///< VSPI interface configuration
+    SNESPort     astPort[SNES_NUM_PORTS];  ///< Controller ports (HSPI, VSPI)
+    portMUX_TYPE stPortMux;                ///< Guards the armed counters
 
     rmt_config_t stLatch;          ///< Latch signal configuration
     rmt_item32_t stLatchItem[1];   ///< Latch signal data
@@ -118,6 +164,54 @@ typedef struct SNESDriver_t
     rmt_config_t stDebug;
     rmt_item32_t stDebugItem[1];
 
+    TaskHandle_t      hReadInputTask;   ///< Controller reader task
+    volatile uint8_t  u8CaptureBit;     ///< Index of the next bit to capture
+    volatile uint16_t u16CaptureWord;   ///< Controller word being captured
+    volatile int64_t  s64CaptureStart;  ///< Start of the current capture in µs
+    volatile int64_t  s64CaptureEnd;    ///< Time of the last captured bit in µs
+    int64_t           s64CaptureWake;   ///< Time the reader saw the captured word in µs
+    volatile int64_t  s64LastEdge;      ///< Time of the previous clock edge in µs
+    volatile uint32_t u32EdgeJitter;    ///< Max. clock edge deviation in µs
+    SNESCaptureStats  stCaptureStats;   ///< Capture statistics
+    SNESTimingHistogram stTiming;       ///< Capture timing histogram
+    portMUX_TYPE      stTimingMux;      ///< Guards the timing histogram
+    Debounce          stDebounce;       ///< Input debouncer
+
+    bool               bLatchSync;        ///< Latch-synchronised sampling
+    SemaphoreHandle_t  hLatchSyncSem;     ///< Signalled when the next read is due
+    esp_timer_handle_t hLatchSyncTimer;   ///< Wakes up the reader when the next read is due
+    int64_t            s64InputTime;      ///< Capture time of the input data in µs
+    volatile int64_t   s64Port0Latch;     ///< Time of the last port 0 latch in µs
+    TaskHandle_t       hFrameNotify;      ///< Notified on every port 0 latch
+    QueueHandle_t      hInputQueue;       ///< Receives SNESInputEvent records
+    SNESOverrideFn     pfnOverride;       ///< Replaces the port words, e.g. by a movie
+
+    /// The override supplied the word at the last latch
+    volatile bool abOverridden[SNES_NUM_PORTS];
+    SNESLatchStats     stLatchStats;      ///< Latch statistics
+
+    SNESRemoteSlot  astRemote[SNES_REMOTE_QUEUE_SIZE];  ///< Remote input queue
+    portMUX_TYPE    stRemoteMux;      ///< Guards the remote input queue
+    bool            bRemoteActive;    ///< At least one remote word received
+    bool            bRemotePlaying;   ///< Queue filled up to the input delay
+    uint32_t        u32RemotePlay;    ///< Frame presented at the next latch
+    uint32_t        u32RemoteNewest;  ///< Newest frame received
+    uint16_t        u16RemoteLast;    ///< Last presented remote word
+    uint8_t         u8RemoteDelay;    ///< Input delay in frames
+    int8_t          s8RemoteSlip;     ///< Pending delay adjustment in frames
+    bool            bRemoteShown;     ///< u32RemoteShown is valid
+    uint32_t        u32RemoteShown;   ///< Frame presented at the last latch
+    int64_t         s64RemoteShown;   ///< Time of the last latch in µs
+    SNESRemoteStats stRemoteStats;    ///< Remote input statistics
+
+    portMUX_TYPE   stStampMux;        ///< Guards the input stamp and latency windows
+    SNESInputStamp stInputStamp;      ///< Most recent local controller word
+    uint32_t       u32LatchFrame;     ///< Frame of the last port 0 latch
+    int64_t        s64LatchTime;      ///< Time of the last port 0 latch in µs
+    Latency        stCaptureToLatch;  ///< Local capture to port 0 latch
+    Latency        stCaptureToWire;   ///< Local capture to network send
+    Latency        stWireToLatch;     ///< Network receive to port 1 latch
+
 } SNESDriver;
 
 /**
@@ -131,6 +225,25 @@ static void _SNESReadInputThread(void* pArg);
 static void _SNESDebugThread(void* pArg);
 #endif
 static void _InitSNESSigGen(void);
+static void _InitSNESCapture(void);
+static bool _SNESCaptureInput(uint16_t* pu16Data);
+static void _SNESUpdateCaptureStats(void);
+static void _SNESAddTiming(uint32_t* pau32Buckets, uint32_t* pu32Max, uint32_t u32Us);
+static void _InitSNESLatchSync(void);
+static bool _SNESWaitForLatch(int64_t* ps64Due);
+static bool _SNESSleepUntil(int64_t s64Due);
+static void _SNESLatchSyncCallback(void* pArg);
+static void _SNESPublishInput(void);
+static void _SNESPortThread(void* pArg);
+static void _SNESQueuePortTrans(SNESPort* pstPort, spi_slave_transaction_t* pstTrans);
+
+static void IRAM_ATTR _SNESSetPortWord(SNESPort* pstPort, uint16_t u16Data, int64_t s64Time);
+static void IRAM_ATTR _SNESClockISR(void* pArg);
+static void IRAM_ATTR _SNESPort0LatchISR(void* pArg);
+static void IRAM_ATTR _SNESPort1LatchISR(void* pArg);
+static void IRAM_ATTR _SNESPortLatch(SNESPort* pstPort);
+static void IRAM_ATTR _SNESRemotePlayout(SNESPort* pstPort);
+static bool IRAM_ATTR _SNESOverridePort(uint8_t u8Port);
 
 static void IRAM_ATTR Port0Setup(spi_slave_transaction_t *stTrans);
 static void IRAM_ATTR Port0Trans(spi_slave_transaction_t *stTrans);
@@ -146,10 +259,19 @@ void InitSNES(void)
     gpio_config_t stGPIOConf;
 
     memset(&_stDriver, 0, sizeof(struct SNESDriver_t));
-    _stDriver.bIsRunning   = true;
-    _stDriver.u16InputData = 0xffff;
-    _stDriver.u32Port0Tx   = 0xffffffff;
-    _stDriver.u32Port1Tx   = 0xffffffff;
+    _stDriver.bIsRunning       = true;
+    _stDriver.u16InputData     = 0xffff;
+    _stDriver.astPort[0].eHost = HSPI_HOST;
+    _stDriver.astPort[0].u32Tx = 0xffffffff;
+    _stDriver.astPort[1].eHost = VSPI_HOST;
+    _stDriver.astPort[1].u32Tx = 0xffffffff;
+    vPortCPUInitializeMutex(&_stDriver.stPortMux);
+    vPortCPUInitializeMutex(&_stDriver.stRemoteMux);
+    vPortCPUInitializeMutex(&_stDriver.stStampMux);
+    vPortCPUInitializeMutex(&_stDriver.stTimingMux);
+    _stDriver.u16RemoteLast = 0xffff;
+    _stDriver.u8RemoteDelay = SNES_REMOTE_DELAY;
+    InitDebounce(&_stDriver.stDebounce, 0xffff, DebounceDepth(DEBOUNCE_REJECT_US, SNES_READ_PERIOD_US));
 
     // GPIO configuration.
     stGPIOConf.intr_type    = GPIO_PIN_INTR_DISABLE;
@@ -171,56 +293,83 @@ void InitSNES(void)
     ESP_ERROR_CHECK(gpio_config(&stGPIOConf));
 
     // Controller port 0 (HSPI).
-    _stDriver.stPort0Bus.mosi_io_num     = -1;
-    _stDriver.stPort0Bus.miso_io_num     = SNES_PORT0_DATA_PIN;
-    _stDriver.stPort0Bus.sclk_io_num     = SNES_PORT0_CLOCK_PIN;
-    _stDriver.stPort0Bus.quadwp_io_num   = -1;
-    _stDriver.stPort0Bus.quadhd_io_num   = -1;
-    _stDriver.stPort0Bus.max_transfer_sz =  0;
-    _stDriver.stPort0Bus.flags           = SPICOMMON_BUSFLAG_SLAVE;
-    _stDriver.stPort0Bus.intr_flags      = ESP_INTR_FLAG_IRAM;
-
-    _stDriver.stPort0.spics_io_num       = SNES_PORT0_LATCH_PIN;
-    _stDriver.stPort0.flags              = SPI_SLAVE_BIT_LSBFIRST;
-    _stDriver.stPort0.queue_size         = 1;
-    _stDriver.stPort0.mode               = 2;
-    _stDriver.stPort0.post_setup_cb      = Port0Setup;
-    _stDriver.stPort0.post_trans_cb      = Port0Trans;
-
-    ESP_ERROR_CHECK(spi_slave_initialize(HSPI_HOST, &_stDriver.stPort0Bus, &_stDriver.stPort0, 0));
+    _stDriver.astPort[0].stBus.mosi_io_num     = -1;
+    _stDriver.astPort[0].stBus.miso_io_num     = SNES_PORT0_DATA_PIN;
+    _stDriver.astPort[0].stBus.sclk_io_num     = SNES_PORT0_CLOCK_PIN;
+    _stDriver.astPort[0].stBus.quadwp_io_num   = -1;
+    _stDriver.astPort[0].stBus.quadhd_io_num   = -1;
+    _stDriver.astPort[0].stBus.max_transfer_sz =  0;
+    _stDriver.astPort[0].stBus.flags           = SPICOMMON_BUSFLAG_SLAVE;
+    _stDriver.astPort[0].stBus.intr_flags      = ESP_INTR_FLAG_IRAM;
+
+    _stDriver.astPort[0].stIf.spics_io_num  = SNES_PORT0_LATCH_PIN;
+    _stDriver.astPort[0].stIf.flags         = SPI_SLAVE_BIT_LSBFIRST;
+    _stDriver.astPort[0].stIf.queue_size    = SNES_PORT_QUEUE_SIZE;
+    _stDriver.astPort[0].stIf.mode          = 2;
+    _stDriver.astPort[0].stIf.post_setup_cb = Port0Setup;
+    _stDriver.astPort[0].stIf.post_trans_cb = Port0Trans;
+
+    ESP_ERROR_CHECK(spi_slave_initialize(
+        HSPI_HOST, &_stDriver.astPort[0].stBus, &_stDriver.astPort[0].stIf, 0));
 
     // Controller port 1 (VSPI).
-    _stDriver.stPort1Bus.mosi_io_num     = -1;
-    _stDriver.stPort1Bus.miso_io_num     = SNES_PORT1_DATA_PIN;
-    _stDriver.stPort1Bus.sclk_io_num     = SNES_PORT1_CLOCK_PIN;
-    _stDriver.stPort1Bus.quadwp_io_num   = -1;
-    _stDriver.stPort1Bus.quadhd_io_num   = -1;
-    _stDriver.stPort1Bus.max_transfer_sz =  0;
-    _stDriver.stPort1Bus.flags           = SPICOMMON_BUSFLAG_SLAVE;
-    _stDriver.stPort1Bus.intr_flags      = ESP_INTR_FLAG_IRAM;
-
-    _stDriver.stPort1.spics_io_num       = SNES_PORT1_LATCH_PIN;
-    _stDriver.stPort1.flags              = SPI_SLAVE_BIT_LSBFIRST;
-    _stDriver.stPort1.queue_size         = 1;
-    _stDriver.stPort1.mode               = 2;
-    _stDriver.stPort1.post_setup_cb      = Port1Setup;
-    _stDriver.stPort1.post_trans_cb      = Port1Trans;
-
-    ESP_ERROR_CHECK(spi_slave_initialize(VSPI_HOST, &_stDriver.stPort1Bus, &_stDriver.stPort1, 0));
+    _stDriver.astPort[1].stBus.mosi_io_num     = -1;
+    _stDriver.astPort[1].stBus.miso_io_num     = SNES_PORT1_DATA_PIN;
+    _stDriver.astPort[1].stBus.sclk_io_num     = SNES_PORT1_CLOCK_PIN;
+    _stDriver.astPort[1].stBus.quadwp_io_num   = -1;
+    _stDriver.astPort[1].stBus.quadhd_io_num   = -1;
+    _stDriver.astPort[1].stBus.max_transfer_sz =  0;
+    _stDriver.astPort[1].stBus.flags           = SPICOMMON_BUSFLAG_SLAVE;
+    _stDriver.astPort[1].stBus.intr_flags      = ESP_INTR_FLAG_IRAM;
+
+    _stDriver.astPort[1].stIf.spics_io_num  = SNES_PORT1_LATCH_PIN;
+    _stDriver.astPort[1].stIf.flags         = SPI_SLAVE_BIT_LSBFIRST;
+    _stDriver.astPort[1].stIf.queue_size    = SNES_PORT_QUEUE_SIZE;
+    _stDriver.astPort[1].stIf.mode          = 2;
+    _stDriver.astPort[1].stIf.post_setup_cb = Port1Setup;
+    _stDriver.astPort[1].stIf.post_trans_cb = Port1Trans;
+
+    ESP_ERROR_CHECK(spi_slave_initialize(
+        VSPI_HOST, &_stDriver.astPort[1].stBus, &_stDriver.astPort[1].stIf, 0));
+
+    // Arm the transaction rings of both controller ports.
+    for (uint8_t u8Port = 0; u8Port < SNES_NUM_PORTS; u8Port++)
+    {
+        SNESPort* pstPort = &_stDriver.astPort[u8Port];
+
+        for (uint8_t u8Index = 0; u8Index < SNES_PORT_QUEUE_SIZE; u8Index++)
+        {
+            pstPort->astTrans[u8Index].length    = SNES_PORT_TRANS_BITS;
+            pstPort->astTrans[u8Index].tx_buffer = (const void*)&pstPort->u32Tx;
+            pstPort->astTrans[u8Index].user      = pstPort;
+            _SNESQueuePortTrans(pstPort, &pstPort->astTrans[u8Index]);
+        }
+    }
+
+    xTaskCreatePinnedToCore(
+        _SNESPortThread, "SNESPort0Thread", 2048, &_stDriver.astPort[0],
+        TASK_PRIO_SNES_PORT, NULL, TASK_CORE_SNES);
+    xTaskCreatePinnedToCore(
+        _SNESPortThread, "SNESPort1Thread", 2048, &_stDriver.astPort[1],
+        TASK_PRIO_SNES_PORT, NULL, TASK_CORE_SNES);
 
     // Initialise latch and clock signal generator.
     _InitSNESSigGen();
 
-    xTaskCreate(
+    xTaskCreatePinnedToCore(
         _SNESReadInputThread,
         "SNESReadInputThread",
-        2048, NULL, 3, NULL);
+        2048, NULL, TASK_PRIO_SNES_READ, &_stDriver.hReadInputTask, TASK_CORE_SNES);
+
+    // The capture ISR notifies the reader, so it needs the task handle.
+    _InitSNESCapture();
+    _InitSNESLatchSync();
 
     #ifdef DEBUG
-    xTaskCreate(
+    xTaskCreatePinnedToCore(
         _SNESDebugThread,
         "SNESDebugThread",
-        2048, NULL, 3, NULL);
+        2048, NULL, TASK_PRIO_BACKGROUND, NULL, TASK_CORE_SNES);
     #endif
 }
 
@@ -242,6 +391,431 @@ uint16_t GetSNESInputData(void)
     return _stDriver.u16InputData;
 }
 
+/**
+ * @fn     void GetSNESCaptureStats(SNESCaptureStats* pstStats)
+ * @brief  Get controller capture latency and jitter statistics
+ * @param  pstStats
+ *         Destination of the statistics
+ */
+void GetSNESCaptureStats(SNESCaptureStats* pstStats)
+{
+    memcpy(pstStats, &_stDriver.stCaptureStats, sizeof(SNESCaptureStats));
+}
+
+/**
+ * @fn     void GetSNESTimingHistogram(SNESTimingHistogram* pstHistogram)
+ * @brief  Get the capture timing histogram
+ * @param  pstHistogram
+ *         Destination of the histogram
+ */
+void GetSNESTimingHistogram(SNESTimingHistogram* pstHistogram)
+{
+    portENTER_CRITICAL(&_stDriver.stTimingMux);
+    memcpy(pstHistogram, &_stDriver.stTiming, sizeof(SNESTimingHistogram));
+    portEXIT_CRITICAL(&_stDriver.stTimingMux);
+}
+
+/**
+ * @fn     void ResetSNESTimingHistogram(void)
+ * @brief  Clear the capture timing histogram
+ */
+void ResetSNESTimingHistogram(void)
+{
+    portENTER_CRITICAL(&_stDriver.stTimingMux);
+    memset(&_stDriver.stTiming, 0, sizeof(SNESTimingHistogram));
+    portEXIT_CRITICAL(&_stDriver.stTimingMux);
+}
+
+/**
+ * @fn     void GetSNESLatchStats(SNESLatchStats* pstStats)
+ * @brief  Get console latch and input age statistics
+ * @param  pstStats
+ *         Destination of the statistics
+ */
+void GetSNESLatchStats(SNESLatchStats* pstStats)
+{
+    memcpy(pstStats, &_stDriver.stLatchStats, sizeof(SNESLatchStats));
+}
+
+/**
+ * @fn       void SetSNESLatchSync(bool bEnable)
+ * @brief    Enable or disable latch-synchronised sampling
+ * @details  If enabled, the controller is read right before the
+ *           console is expected to latch port 0 instead of on a
+ *           free-running schedule.
+ * @param    bEnable
+ *           true = enable, false = disable
+ */
+void SetSNESLatchSync(bool bEnable)
+{
+    _stDriver.bLatchSync = bEnable;
+}
+
+/**
+ * @fn     void GetSNESPortStats(uint8_t u8Port, SNESPortStats* pstStats)
+ * @brief  Get controller port transaction statistics
+ * @param  u8Port
+ *         Controller port, 0 or 1
+ * @param  pstStats
+ *         Destination of the statistics
+ */
+void GetSNESPortStats(uint8_t u8Port, SNESPortStats* pstStats)
+{
+    if (u8Port >= SNES_NUM_PORTS)
+    {
+        memset(pstStats, 0, sizeof(SNESPortStats));
+        return;
+    }
+    memcpy(pstStats, &_stDriver.astPort[u8Port].stStats, sizeof(SNESPortStats));
+}
+
+/**
+ * @fn     void SetSNESDebounceDepth(uint8_t u8Depth)
+ * @brief  Set the number of consecutive reads required for a change
+ * @param  u8Depth
+ *         Filter depth, 1 to DEBOUNCE_DEPTH_MAX
+ */
+void SetSNESDebounceDepth(uint8_t u8Depth)
+{
+    SetDebounceDepth(&_stDriver.stDebounce, u8Depth);
+}
+
+/**
+ * @fn       void PushSNESRemoteInput(uint32_t u32Frame, uint16_t u16Data)
+ * @brief    Queue a controller word of the remote player
+ * @details  Port 1 presents the remote words in frame order, exactly
+ *           one per console latch.  Playback starts once the queue is
+ *           filled up to the input delay.  Words for frames that have
+ *           already been presented are dropped, words too far ahead
+ *           re-align the queue.
+ * @param    u32Frame
+ *           Remote frame number of the word
+ * @param    u16Data
+ *           Controller word
+ */
+void PushSNESRemoteInput(uint32_t u32Frame, uint16_t u16Data)
+{
+    SNESRemoteSlot* pstSlot;
+    int64_t         s64Now = esp_timer_get_time();
+
+    portENTER_CRITICAL(&_stDriver.stRemoteMux);
+
+    if (! _stDriver.bRemoteActive)
+    {
+        _stDriver.bRemoteActive   = true;
+        _stDriver.u32RemotePlay   = u32Frame;
+        _stDriver.u32RemoteNewest = u32Frame;
+    }
+
+    if ((int32_t)(u32Frame - _stDriver.u32RemotePlay) < 0)
+    {
+        _stDriver.stRemoteStats.u32Late++;
+        portEXIT_CRITICAL(&_stDriver.stRemoteMux);
+        return;
+    }
+
+    if ((u32Frame - _stDriver.u32RemotePlay) >= SNES_REMOTE_QUEUE_SIZE)
+    {
+        _stDriver.stRemoteStats.u32Resyncs++;
+        _stDriver.u32RemotePlay = u32Frame - _stDriver.u8RemoteDelay;
+    }
+
+    pstSlot             = &_stDriver.astRemote[u32Frame & (SNES_REMOTE_QUEUE_SIZE - 1)];
+    pstSlot->s64Arrival = s64Now;
+    pstSlot->u32Frame   = u32Frame;
+    pstSlot->u16Data    = u16Data;
+    pstSlot->bValid     = true;
+    _stDriver.stRemoteStats.u32Received++;
+
+    if ((int32_t)(u32Frame - _stDriver.u32RemoteNewest) > 0)
+    {
+        _stDriver.u32RemoteNewest = u32Frame;
+    }
+    if ((_stDriver.u32RemoteNewest - _stDriver.u32RemotePlay) >= _stDriver.u8RemoteDelay)
+    {
+        _stDriver.bRemotePlaying = true;
+    }
+
+    portEXIT_CRITICAL(&_stDriver.stRemoteMux);
+}
+
+/**
+ * @fn     void ResetSNESRemoteInput(void)
+ * @brief  Discard all queued remote words, e.g. on a new session
+ */
+void ResetSNESRemoteInput(void)
+{
+    portENTER_CRITICAL(&_stDriver.stRemoteMux);
+    memset(_stDriver.astRemote, 0, sizeof(_stDriver.astRemote));
+    _stDriver.bRemoteActive    = false;
+    _stDriver.bRemotePlaying   = false;
+    _stDriver.bRemoteShown     = false;
+    _stDriver.s8RemoteSlip     = 0;
+    _stDriver.u16RemoteLast    = 0xffff;
+    _stDriver.astPort[1].u32Tx = 0xffffffff;
+    portEXIT_CRITICAL(&_stDriver.stRemoteMux);
+}
+
+/**
+ * @fn     void SetSNESRemoteDelay(uint8_t u8Delay)
+ * @brief  Set the remote input delay
+ * @param  u8Delay
+ *         Input delay in frames, less than SNES_REMOTE_QUEUE_SIZE
+ */
+void SetSNESRemoteDelay(uint8_t u8Delay)
+{
+    if (u8Delay >= SNES_REMOTE_QUEUE_SIZE)
+    {
+        u8Delay = SNES_REMOTE_QUEUE_SIZE - 1;
+    }
+    _stDriver.u8RemoteDelay = u8Delay;
+}
+
+/**
+ * @fn     uint8_t GetSNESRemoteDelay(void)
+ * @brief  Get the configured remote input delay in frames
+ */
+uint8_t GetSNESRemoteDelay(void)
+{
+    return _stDriver.u8RemoteDelay;
+}
+
+/**
+ * @fn       void AdjustSNESRemoteDelay(int8_t s8Frames)
+ * @brief    Shift the remote input by whole frames
+ * @details  Takes effect at the next latches: a positive value repeats
+ *           the previous word, a negative value skips words.  Meant to
+ *           compensate the drift between both consoles one frame at a
+ *           time, see ClockSyncAlign().
+ * @param    s8Frames
+ *           Adjustment in frames
+ */
+void AdjustSNESRemoteDelay(int8_t s8Frames)
+{
+    portENTER_CRITICAL(&_stDriver.stRemoteMux);
+    _stDriver.s8RemoteSlip += s8Frames;
+    portEXIT_CRITICAL(&_stDriver.stRemoteMux);
+}
+
+/**
+ * @fn      bool GetSNESRemotePlayout(uint32_t* pu32Frame, int64_t* ps64Time)
+ * @brief   Get the remote frame presented at the last latch
+ * @param   pu32Frame
+ *          Destination of the remote frame number
+ * @param   ps64Time
+ *          Destination of the latch time in µs
+ * @return  Status
+ * @retval  true  = OK
+ * @retval  false = Remote input isn't playing
+ */
+bool GetSNESRemotePlayout(uint32_t* pu32Frame, int64_t* ps64Time)
+{
+    bool bShown;
+
+    portENTER_CRITICAL(&_stDriver.stRemoteMux);
+    bShown     = _stDriver.bRemoteShown;
+    *pu32Frame = _stDriver.u32RemoteShown;
+    *ps64Time  = _stDriver.s64RemoteShown;
+    portEXIT_CRITICAL(&_stDriver.stRemoteMux);
+
+    return bShown;
+}
+
+/**
+ * @fn     void GetSNESRemoteStats(SNESRemoteStats* pstStats)
+ * @brief  Get remote input statistics
+ * @param  pstStats
+ *         Destination of the statistics
+ */
+void GetSNESRemoteStats(SNESRemoteStats* pstStats)
+{
+    memcpy(pstStats, &_stDriver.stRemoteStats, sizeof(SNESRemoteStats));
+}
+
+/**
+ * @fn      uint32_t GetSNESFrame(void)
+ * @brief   Get the console frame number
+ * @return  Number of latch pulses seen on port 0
+ */
+uint32_t GetSNESFrame(void)
+{
+    return _stDriver.stLatchStats.u32Latches;
+}
+
+/**
+ * @fn     void GetSNESLatchTime(uint32_t* pu32Frame, int64_t* ps64Time)
+ * @brief  Get the console frame number and the time of its latch
+ * @param  pu32Frame
+ *         Destination of the frame number
+ * @param  ps64Time
+ *         Destination of the latch time in µs
+ */
+void GetSNESLatchTime(uint32_t* pu32Frame, int64_t* ps64Time)
+{
+    portENTER_CRITICAL(&_stDriver.stStampMux);
+    *pu32Frame = _stDriver.u32LatchFrame;
+    *ps64Time  = _stDriver.s64LatchTime;
+    portEXIT_CRITICAL(&_stDriver.stStampMux);
+}
+
+/**
+ * @fn     void SetSNESFrameNotify(TaskHandle_t hTask)
+ * @brief  Notify a task on every console frame
+ * @param  hTask
+ *         Task that receives a notification on each port 0 latch,
+ *         NULL to disable
+ */
+void SetSNESFrameNotify(TaskHandle_t hTask)
+{
+    _stDriver.hFrameNotify = hTask;
+}
+
+/**
+ * @fn       void SetSNESInputQueue(QueueHandle_t hQueue)
+ * @brief    Report controller input events to a queue
+ * @details  An SNESInputEvent is posted for every changed controller
+ *           word and for every port 0 latch.  The driver never waits
+ *           for the queue; events that do not fit are counted in
+ *           SNESLatchStats.u32EventsLost.
+ * @param    hQueue
+ *           Queue of SNESInputEvent items, NULL to disable
+ */
+void SetSNESInputQueue(QueueHandle_t hQueue)
+{
+    _stDriver.hInputQueue = hQueue;
+}
+
+/**
+ * @fn       void SetSNESOverride(SNESOverrideFn pfnOverride)
+ * @brief    Replace the words shifted out by the controller ports
+ * @details  The override is asked at every latch of either port,
+ *           right before the next transaction is set up, so the word
+ *           it returns is the one the console reads.  A word supplied
+ *           for port 0 is also handed to the input exchange in place
+ *           of the controller.
+ * @param    pfnOverride
+ *           Override, NULL to disable
+ */
+void SetSNESOverride(SNESOverrideFn pfnOverride)
+{
+    _stDriver.pfnOverride = pfnOverride;
+    if (NULL == pfnOverride)
+    {
+        for (uint8_t u8Port = 0; u8Port < SNES_NUM_PORTS; u8Port++)
+        {
+            _stDriver.abOverridden[u8Port] = false;
+        }
+    }
+}
+
+/**
+ * @fn       void GetSNESInputStamp(SNESInputStamp* pstStamp)
+ * @brief    Get the most recent local controller word
+ * @details  The stamp carries the capture time and the console frame
+ *           it was captured in.  It is meant to travel with the word
+ *           to the remote side and back into MarkSNESInputSent().
+ * @param    pstStamp
+ *           Destination of the stamped word
+ */
+void GetSNESInputStamp(SNESInputStamp* pstStamp)
+{
+    portENTER_CRITICAL(&_stDriver.stStampMux);
+    memcpy(pstStamp, &_stDriver.stInputStamp, sizeof(SNESInputStamp));
+    portEXIT_CRITICAL(&_stDriver.stStampMux);
+}
+
+/**
+ * @fn     void MarkSNESInputSent(const SNESInputStamp* pstStamp)
+ * @brief  Record that a stamped word has been put on the network
+ * @param  pstStamp
+ *         Stamped word as returned by GetSNESInputStamp()
+ */
+void MarkSNESInputSent(const SNESInputStamp* pstStamp)
+{
+    uint32_t u32Latency = (uint32_t)(esp_timer_get_time() - pstStamp->s64Time);
+
+    portENTER_CRITICAL(&_stDriver.stStampMux);
+    AddLatency(&_stDriver.stCaptureToWire, u32Latency);
+    portEXIT_CRITICAL(&_stDriver.stStampMux);
+}
+
+/**
+ * @fn       void GetSNESLatencyStats(SNESLatencyStats* pstStats)
+ * @brief    Get end-to-end latency percentiles
+ * @details  The latency windows are copied first, so the percentiles
+ *           are computed without blocking the interrupts.
+ * @param    pstStats
+ *           Destination of the statistics
+ */
+void GetSNESLatencyStats(SNESLatencyStats* pstStats)
+{
+    Latency stCopy;
+
+    portENTER_CRITICAL(&_stDriver.stStampMux);
+    memcpy(&stCopy, &_stDriver.stCaptureToLatch, sizeof(Latency));
+    portEXIT_CRITICAL(&_stDriver.stStampMux);
+    pstStats->u32CaptureToLatchP50 = GetLatencyPercentile(&stCopy, 50);
+    pstStats->u32CaptureToLatchP99 = GetLatencyPercentile(&stCopy, 99);
+
+    portENTER_CRITICAL(&_stDriver.stStampMux);
+    memcpy(&stCopy, &_stDriver.stCaptureToWire, sizeof(Latency));
+    portEXIT_CRITICAL(&_stDriver.stStampMux);
+    pstStats->u32CaptureToWireP50   = GetLatencyPercentile(&stCopy, 50);
+    pstStats->u32CaptureToWireP99   = GetLatencyPercentile(&stCopy, 99);
+    pstStats->u32CaptureToWireCount = stCopy.u32Count;
+
+    portENTER_CRITICAL(&_stDriver.stStampMux);
+    memcpy(&stCopy, &_stDriver.stWireToLatch, sizeof(Latency));
+    portEXIT_CRITICAL(&_stDriver.stStampMux);
+    pstStats->u32WireToLatchP50   = GetLatencyPercentile(&stCopy, 50);
+    pstStats->u32WireToLatchP99   = GetLatencyPercentile(&stCopy, 99);
+    pstStats->u32WireToLatchCount = stCopy.u32Count;
+}
+
+/**
+ * @fn       void SetSNESPortBuffer(uint8_t u8Port, const void* pBuffer, uint16_t u16Bits)
+ * @brief    Replace the controller word of a port by a raw buffer
+ * @details  All transactions of the port's ring transmit the given
+ *           buffer from now on, including the ones already queued, as
+ *           the driver only reads them when setting them up.  This is
+ *           used by the bulk data mode.
+ * @param    u8Port
+ *           Controller port, 0 or 1
+ * @param    pBuffer
+ *           32-bit aligned buffer, NULL restores the controller word
+ * @param    u16Bits
+ *           Number of bits per latch including the dummy bit, up to
+ *           SNES_PORT_MAX_BITS
+ */
+void SetSNESPortBuffer(uint8_t u8Port, const void* pBuffer, uint16_t u16Bits)
+{
+    SNESPort* pstPort;
+
+    if (u8Port >= SNES_NUM_PORTS)
+    {
+        return;
+    }
+    pstPort = &_stDriver.astPort[u8Port];
+
+    if (NULL == pBuffer)
+    {
+        pBuffer = (const void*)&pstPort->u32Tx;
+        u16Bits = SNES_PORT_TRANS_BITS;
+    }
+    if (u16Bits > SNES_PORT_MAX_BITS)
+    {
+        u16Bits = SNES_PORT_MAX_BITS;
+    }
+
+    portENTER_CRITICAL(&_stDriver.stPortMux);
+    for (uint8_t u8Index = 0; u8Index < SNES_PORT_QUEUE_SIZE; u8Index++)
+    {
+        pstPort->astTrans[u8Index].length    = u16Bits;
+        pstPort->astTrans[u8Index].tx_buffer = pBuffer;
+    }
+    portEXIT_CRITICAL(&_stDriver.stPortMux);
+}
+
 /**
  * @fn      void SendClock(void)
  * @brief   Send clock signal.
@@ -337,73 +911,382 @@ void SendLatch(void)
  * tbc.
  *
  * @endcode
- *           The data is retrieved three times as often as on a SNES.
  *           Signal fluctuations, probably caused by wrong timing, are
- *           compensated by comparing the results.
+ *           compensated by a per-button debouncer.  Its depth is
+ *           chosen so that glitches shorter than DEBOUNCE_REJECT_US
+ *           are rejected, i.e. two reads at the default 5 ms period.
+ *           The reads are SNES_READ_PERIOD_US apart on either
+ *           schedule, so the filter covers the same time whether or
+ *           not the reads are synchronised to the latch.
+ *
+ *           The schedule is kept with a one-shot esp_timer, as a tick
+ *           is 10 ms and a delay of 5 ms would round down to none.
+ *
+ *           Latch and clock are generated by the RMT module and the
+ *           data line is sampled by an edge interrupt on the clock
+ *           line, so the thread sleeps until a complete word is ready.
  * @param    pArg Unused
- * @todo     Use the RMT module driver to read the data in non-blocking
- *           mode.
  */
 static void _SNESReadInputThread(void* pArg)
 {
-    uint16_t u16Temp[3] = { 0xffff, 0xffff, 0xffff };
+    uint16_t u16Temp   = 0xffff;
     uint8_t  u8Attempt = 0;
-    spi_slave_transaction_t stTrans0;
-    spi_slave_transaction_t stTrans1;
-
-    memset(&stTrans0, 0, sizeof(stTrans0));
-    stTrans0.length    = 17;
-    stTrans0.trans_len = 17;
-    stTrans0.tx_buffer = &_stDriver.u32Port0Tx;
+    uint8_t  u8Samples = 1;
+    int64_t  s64Due    = esp_timer_get_time();
+    (void)pArg;
 
     while (_stDriver.bIsRunning)
     {
-        SendLatch();
-        SendClock();
-
-        ets_delay_us(3);
-        for (uint8_t u8Bit = 0; u8Bit < 16; u8Bit++)
+        // Right before a latch, take enough reads to pass the filter.
+        u8Samples = 1;
+        if (_stDriver.bLatchSync && _SNESWaitForLatch(&s64Due))
         {
-            ets_delay_us(6);
-            if (u8Bit < 12)
+            u8Samples = _stDriver.stDebounce.u8Depth;
+        }
+        else
+        {
+            // Free-running; after a stall, go on without a burst.
+            s64Due += SNES_READ_PERIOD_US;
+            if (s64Due < esp_timer_get_time())
             {
-                if (gpio_get_level(SNES_INPUT_DATA_PIN))
-                {
-                    if (gpio_get_level(SNES_INPUT_DATA_PIN))
-                    {
-                        u16Temp[u8Attempt] |= 1 << u8Bit;
-                    }
-                }
-                else
-                {
-                    u16Temp[u8Attempt] &= ~(1 << u8Bit);
-                }
+                s64Due = esp_timer_get_time();
             }
-            ets_delay_us(6);
+            _SNESSleepUntil(s64Due);
         }
-        u8Attempt++;
 
-        // Compensate signal fluctuations.
-        if (u8Attempt > 2)
+        u8Attempt = 0;
+        while (u8Attempt < u8Samples && _stDriver.bIsRunning)
         {
-            if (u16Temp[0] == u16Temp[1] && u16Temp[1] == u16Temp[2])
+            if (u8Attempt > 0)
+            {
+                s64Due += SNES_READ_PERIOD_US;
+                _SNESSleepUntil(s64Due);
+            }
+            if (_SNESCaptureInput(&u16Temp))
             {
-                _stDriver.u16InputData = u16Temp[0];
+                _stDriver.u16InputData = DebounceInput(&_stDriver.stDebounce, u16Temp);
+                _stDriver.s64InputTime = _stDriver.s64CaptureEnd;
+                u8Attempt++;
             }
-            _stDriver.u32Port0Tx = _stDriver.u16InputData;
-            _stDriver.u32Port0Tx = _stDriver.u32Port0Tx << 1;
-            _stDriver.u32Port0Tx &= ~(1 << 0);
-            spi_slave_queue_trans(VSPI_HOST, &stTrans0, 0);
+        }
+        // Port 0 and the input stamp belong to the override, if any.
+        if (! _stDriver.abOverridden[0])
+        {
+            _SNESPublishInput();
+        }
+    }
+
+    vTaskDelete(NULL);
+}
+
+/**
+ * @fn       void _SNESPublishInput(void)
+ * @brief    Hand the debounced controller word to port 0 and the users
+ * @details  Sets the word for the next port 0 latch, updates the input
+ *           stamp and reports a changed word to the input queue.
+ */
+static void _SNESPublishInput(void)
+{
+    QueueHandle_t hQueue;
+    bool          bChanged;
 
-            u8Attempt = 0;
+    _SNESSetPortWord(&_stDriver.astPort[0], _stDriver.u16InputData, _stDriver.s64InputTime);
+
+    portENTER_CRITICAL(&_stDriver.stStampMux);
+    bChanged = _stDriver.stInputStamp.u16Data != _stDriver.u16InputData;
+    _stDriver.stInputStamp.s64Time  = _stDriver.s64InputTime;
+    _stDriver.stInputStamp.u32Frame = _stDriver.stLatchStats.u32Latches;
+    _stDriver.stInputStamp.u16Data  = _stDriver.u16InputData;
+    portEXIT_CRITICAL(&_stDriver.stStampMux);
+
+    hQueue = _stDriver.hInputQueue;
+    if (bChanged && NULL != hQueue)
+    {
+        SNESInputEvent stEvent;
+
+        stEvent.s64Time  = _stDriver.s64InputTime;
+        stEvent.u32Frame = _stDriver.stLatchStats.u32Latches;
+        stEvent.u16Data  = _stDriver.u16InputData;
+        stEvent.bLatch   = false;
+        if (pdTRUE != xQueueSend(hQueue, &stEvent, 0))
+        {
+            _stDriver.stLatchStats.u32EventsLost++;
         }
+    }
+}
+
+/**
+ * @fn       void _SNESSetPortWord(SNESPort* pstPort, uint16_t u16Data, int64_t s64Time)
+ * @brief    Set the word shifted out at the next latch
+ * @details  The 17th dummy bit is prepended as described above.  The
+ *           SPI slave driver copies the word into the data buffer when
+ *           it sets up the next transaction, i.e. right at the latch,
+ *           so the console always gets the most recent data.  Also
+ *           called from the SPI callbacks, see _SNESOverridePort().
+ * @param    pstPort
+ *           Controller port
+ * @param    u16Data
+ *           Controller word
+ * @param    s64Time
+ *           Capture time of the controller word in µs
+ */
+static void IRAM_ATTR _SNESSetPortWord(SNESPort* pstPort, uint16_t u16Data, int64_t s64Time)
+{
+    pstPort->u32Tx     = (uint32_t)u16Data << 1;
+    pstPort->s64TxTime = s64Time;
+}
+
+/**
+ * @fn       void _SNESPortThread(void* pArg)
+ * @brief    Controller port refill thread
+ * @details  Every completed transaction is put back into the queue at
+ *           once, so there are always further transactions armed and
+ *           no latch hits an empty queue.
+ * @param    pArg
+ *           Controller port
+ */
+static void _SNESPortThread(void* pArg)
+{
+    SNESPort*                pstPort = (SNESPort*)pArg;
+    spi_slave_transaction_t* pstTrans;
 
-        vTaskDelay(5 / portTICK_PERIOD_MS);
+    while (_stDriver.bIsRunning)
+    {
+        if (ESP_OK == spi_slave_get_trans_result(pstPort->eHost, &pstTrans, portMAX_DELAY))
+        {
+            _SNESQueuePortTrans(pstPort, pstTrans);
+        }
     }
 
     vTaskDelete(NULL);
 }
 
+/**
+ * @fn     void _SNESQueuePortTrans(SNESPort* pstPort, spi_slave_transaction_t* pstTrans)
+ * @brief  Put a transaction back into the queue of a controller port
+ * @param  pstPort
+ *         Controller port
+ * @param  pstTrans
+ *         Transaction
+ */
+static void _SNESQueuePortTrans(SNESPort* pstPort, spi_slave_transaction_t* pstTrans)
+{
+    // Count it first, the transaction may complete before queue returns.
+    portENTER_CRITICAL(&_stDriver.stPortMux);
+    pstPort->u8Armed++;
+    portEXIT_CRITICAL(&_stDriver.stPortMux);
+
+    while (ESP_OK != spi_slave_queue_trans(pstPort->eHost, pstTrans, 0))
+    {
+        pstPort->stStats.u32QueueErrors++;
+        vTaskDelay(1);
+    }
+}
+
+/**
+ * @fn       bool _SNESWaitForLatch(int64_t* ps64Due)
+ * @brief    Wait until the controller has to be read
+ * @details  The next port 0 latch is predicted from the last latch
+ *           edge and the filtered frame period.  The reader is woken
+ *           up early enough to take all samples, SNES_READ_PERIOD_US
+ *           apart, before it happens.
+ * @param    ps64Due
+ *           Destination of the time the first read is due in µs
+ * @return   Status
+ * @retval   true  = Waited for the latch
+ * @retval   false = The console doesn't latch, e.g. because it is
+ *                   switched off; use the free-running schedule
+ */
+static bool _SNESWaitForLatch(int64_t* ps64Due)
+{
+    uint32_t u32Period = _stDriver.stLatchStats.u32FramePeriod;
+    int64_t  s64Latch  = _stDriver.s64Port0Latch;
+    int64_t  s64Now    = esp_timer_get_time();
+    int64_t  s64Lead;
+    int64_t  s64Due;
+
+    if (0 == u32Period || (s64Now - s64Latch) > (2 * (int64_t)u32Period))
+    {
+        return false;
+    }
+
+    s64Lead  = (int64_t)(_stDriver.stDebounce.u8Depth - 1) * SNES_READ_PERIOD_US;
+    s64Lead += _stDriver.stCaptureStats.u32LatencyAvg;
+    s64Lead += SNES_LATCH_SYNC_MARGIN_US;
+
+    s64Due = s64Latch + u32Period - s64Lead;
+    while (s64Due <= s64Now)
+    {
+        s64Due += u32Period;
+    }
+    *ps64Due = s64Due;
+
+    if (_SNESSleepUntil(s64Due))
+    {
+        s64Now = esp_timer_get_time();
+
+        portENTER_CRITICAL(&_stDriver.stTimingMux);
+        _stDriver.stTiming.u32Wakes++;
+        _SNESAddTiming(_stDriver.stTiming.au32Late, &_stDriver.stTiming.u32LateMax,
+                       s64Now > s64Due ? (uint32_t)(s64Now - s64Due) : 0);
+        portEXIT_CRITICAL(&_stDriver.stTimingMux);
+    }
+    return true;
+}
+
+/**
+ * @fn       bool _SNESSleepUntil(int64_t s64Due)
+ * @brief    Sleep until the next read is due
+ * @details  Uses the latch-sync timer, so the reader wakes up with µs
+ *           resolution instead of on the next tick.
+ * @param    s64Due
+ *           Due time in µs
+ * @return   Status
+ * @retval   true  = Woken up by the timer or already due
+ * @retval   false = Timed out
+ */
+static bool _SNESSleepUntil(int64_t s64Due)
+{
+    int64_t s64Wait = s64Due - esp_timer_get_time();
+
+    if (s64Wait <= 0)
+    {
+        return true;
+    }
+
+    esp_timer_stop(_stDriver.hLatchSyncTimer);
+    // Drop a wake-up left over from a timed out wait.
+    xSemaphoreTake(_stDriver.hLatchSyncSem, 0);
+    ESP_ERROR_CHECK(esp_timer_start_once(_stDriver.hLatchSyncTimer, s64Wait));
+
+    return pdTRUE == xSemaphoreTake(_stDriver.hLatchSyncSem, SNES_CAPTURE_TIMEOUT + (s64Wait / 1000) / portTICK_PERIOD_MS);
+}
+
+/**
+ * @fn     void _SNESLatchSyncCallback(void* pArg)
+ * @brief  Latch-sync timer callback
+ * @param  pArg
+ *         Unused
+ */
+static void _SNESLatchSyncCallback(void* pArg)
+{
+    (void)pArg;
+    xSemaphoreGive(_stDriver.hLatchSyncSem);
+}
+
+/**
+ * @fn       bool _SNESCaptureInput(uint16_t* pu16Data)
+ * @brief    Read the controller once
+ * @details  Arms the clock edge interrupt, sends latch and clock via
+ *           the RMT module and blocks until the ISR has shifted in all
+ *           16 bits.
+ * @param    pu16Data
+ *           Destination of the controller word
+ * @return   Read status
+ * @retval   true  = A complete word has been captured
+ * @retval   false = The capture timed out
+ */
+static bool _SNESCaptureInput(uint16_t* pu16Data)
+{
+    // Discard a notification left over from a timed out capture.
+    ulTaskNotifyTake(pdTRUE, 0);
+
+    _stDriver.u16CaptureWord  = 0xffff;
+    _stDriver.u32EdgeJitter   = 0;
+    _stDriver.s64CaptureStart = esp_timer_get_time();
+    _stDriver.u8CaptureBit    = 0;
+
+    SendLatch();
+    SendClock();
+
+    if (0 == ulTaskNotifyTake(pdTRUE, SNES_CAPTURE_TIMEOUT))
+    {
+        _stDriver.u8CaptureBit = SNES_CAPTURE_BITS;
+        _stDriver.stCaptureStats.u32Timeouts++;
+        return false;
+    }
+    _stDriver.s64CaptureWake = esp_timer_get_time();
+
+    // Only the first 12 bits are buttons, the rest is always high.
+    *pu16Data = _stDriver.u16CaptureWord | 0xf000;
+    _SNESUpdateCaptureStats();
+
+    return true;
+}
+
+/**
+ * @fn     void _SNESUpdateCaptureStats(void)
+ * @brief  Update capture latency and jitter statistics
+ */
+static void _SNESUpdateCaptureStats(void)
+{
+    SNESCaptureStats* pstStats = &_stDriver.stCaptureStats;
+    uint32_t          u32Latency;
+
+    u32Latency = (uint32_t)(_stDriver.s64CaptureEnd - _stDriver.s64CaptureStart);
+
+    if (0 == pstStats->u32Captures)
+    {
+        pstStats->u32LatencyMin = u32Latency;
+        pstStats->u32LatencyAvg = u32Latency;
+    }
+    pstStats->u32Captures++;
+
+    pstStats->u32LatencyLast = u32Latency;
+    if (u32Latency < pstStats->u32LatencyMin)
+    {
+        pstStats->u32LatencyMin = u32Latency;
+    }
+    if (u32Latency > pstStats->u32LatencyMax)
+    {
+        pstStats->u32LatencyMax = u32Latency;
+    }
+    // Exponential moving average, weight 1/16.
+    pstStats->u32LatencyAvg += ((int32_t)u32Latency - (int32_t)pstStats->u32LatencyAvg) / 16;
+
+    pstStats->u32JitterLast = _stDriver.u32EdgeJitter;
+    if (_stDriver.u32EdgeJitter > pstStats->u32JitterMax)
+    {
+        pstStats->u32JitterMax = _stDriver.u32EdgeJitter;
+    }
+
+    portENTER_CRITICAL(&_stDriver.stTimingMux);
+    _stDriver.stTiming.u32Captures++;
+    _SNESAddTiming(_stDriver.stTiming.au32Jitter, &_stDriver.stTiming.u32JitterMax,
+                   _stDriver.u32EdgeJitter);
+    _SNESAddTiming(_stDriver.stTiming.au32Wake, &_stDriver.stTiming.u32WakeMax,
+                   (uint32_t)(_stDriver.s64CaptureWake - _stDriver.s64CaptureEnd));
+    portEXIT_CRITICAL(&_stDriver.stTimingMux);
+}
+
+/**
+ * @fn     void _SNESAddTiming(uint32_t* pau32Buckets, uint32_t* pu32Max, uint32_t u32Us)
+ * @brief  Count a sample in a timing histogram
+ * @param  pau32Buckets
+ *         SNES_TIMING_BUCKETS buckets as described in SNES.h
+ * @param  pu32Max
+ *         Maximum of the samples
+ * @param  u32Us
+ *         Sample in µs
+ */
+static void _SNESAddTiming(uint32_t* pau32Buckets, uint32_t* pu32Max, uint32_t u32Us)
+{
+    uint32_t u32Rest  = u32Us;
+    uint8_t  u8Bucket = 0;
+
+    while (u32Rest > 0 && u8Bucket < SNES_TIMING_BUCKETS - 1)
+    {
+        u32Rest >>= 1;
+        u8Bucket++;
+    }
+    pau32Buckets[u8Bucket]++;
+
+    if (u32Us > *pu32Max)
+    {
+        *pu32Max = u32Us;
+    }
+}
+
 #ifdef DEBUG
 /**
  * @fn     _SNESDebugThread(void* pArg)
@@ -498,6 +1381,233 @@ static void _InitSNESSigGen(void)
     }
 }
 
+/**
+ * @fn       void _InitSNESCapture(void)
+ * @brief    Initialise the interrupt driven controller capture
+ * @details  The clock line is driven by the RMT module.  Its input
+ *           path is enabled in addition, so that the falling edges
+ *           generated by the RMT trigger the capture ISR.
+ */
+static void _InitSNESCapture(void)
+{
+    _stDriver.u8CaptureBit = SNES_CAPTURE_BITS;
+
+    // Enable the input buffer without detaching the RMT output signal.
+    PIN_INPUT_ENABLE(GPIO_PIN_MUX_REG[SNES_INPUT_CLOCK_PIN]);
+
+    ESP_ERROR_CHECK(gpio_set_intr_type(SNES_INPUT_CLOCK_PIN, GPIO_INTR_NEGEDGE));
+    ESP_ERROR_CHECK(gpio_install_isr_service(ESP_INTR_FLAG_IRAM));
+    ESP_ERROR_CHECK(gpio_isr_handler_add(SNES_INPUT_CLOCK_PIN, _SNESClockISR, NULL));
+}
+
+/**
+ * @fn       void _SNESClockISR(void* pArg)
+ * @brief    Clock edge interrupt service routine
+ * @details  Samples the data line on every falling clock edge and
+ *           wakes up the reader thread once all 16 bits are shifted
+ *           in.  The deviation of each clock period from the nominal
+ *           period is tracked as capture jitter.
+ * @param    pArg
+ *           Unused
+ */
+static void IRAM_ATTR _SNESClockISR(void* pArg)
+{
+    BaseType_t xWoken = pdFALSE;
+    int64_t    s64Now = esp_timer_get_time();
+    uint8_t    u8Bit  = _stDriver.u8CaptureBit;
+    (void)pArg;
+
+    if (u8Bit >= SNES_CAPTURE_BITS)
+    {
+        return;
+    }
+
+    if ((GPIO.in >> SNES_INPUT_DATA_PIN) & 1)
+    {
+        _stDriver.u16CaptureWord |= (1 << u8Bit);
+    }
+    else
+    {
+        _stDriver.u16CaptureWord &= ~(1 << u8Bit);
+    }
+
+    if (u8Bit > 0)
+    {
+        int32_t nDeviation = (int32_t)(s64Now - _stDriver.s64LastEdge) - SNES_CLOCK_PERIOD_US;
+        if (nDeviation < 0)
+        {
+            nDeviation = -nDeviation;
+        }
+        if ((uint32_t)nDeviation > _stDriver.u32EdgeJitter)
+        {
+            _stDriver.u32EdgeJitter = nDeviation;
+        }
+    }
+    _stDriver.s64LastEdge  = s64Now;
+    _stDriver.u8CaptureBit = u8Bit + 1;
+
+    if (SNES_CAPTURE_BITS == u8Bit + 1)
+    {
+        TraceRecord(TRACE_ISR_ENTER, TRACE_ISR_CLOCK, 0);
+        _stDriver.s64CaptureEnd = s64Now;
+        vTaskNotifyGiveFromISR(_stDriver.hReadInputTask, &xWoken);
+        TraceRecord(TRACE_ISR_EXIT, TRACE_ISR_CLOCK, 0);
+        if (xWoken)
+        {
+            portYIELD_FROM_ISR();
+        }
+    }
+}
+
+/**
+ * @fn       void _InitSNESLatchSync(void)
+ * @brief    Initialise console latch detection
+ * @details  The port 0 latch is also used as SPI chip select; its
+ *           rising edge additionally triggers an interrupt to measure
+ *           the frame period and the age of the shifted out word.
+ */
+static void _InitSNESLatchSync(void)
+{
+    esp_timer_create_args_t stTimerArgs;
+
+    _stDriver.bLatchSync    = SNES_LATCH_SYNC;
+    _stDriver.hLatchSyncSem = xSemaphoreCreateBinary();
+
+    memset(&stTimerArgs, 0, sizeof(stTimerArgs));
+    stTimerArgs.callback        = _SNESLatchSyncCallback;
+    stTimerArgs.dispatch_method = ESP_TIMER_TASK;
+    stTimerArgs.name            = "SNESLatchSync";
+    ESP_ERROR_CHECK(esp_timer_create(&stTimerArgs, &_stDriver.hLatchSyncTimer));
+
+    ESP_ERROR_CHECK(gpio_set_intr_type(SNES_PORT0_LATCH_PIN, GPIO_INTR_POSEDGE));
+    ESP_ERROR_CHECK(gpio_isr_handler_add(SNES_PORT0_LATCH_PIN, _SNESPort0LatchISR, NULL));
+
+    ESP_ERROR_CHECK(gpio_set_intr_type(SNES_PORT1_LATCH_PIN, GPIO_INTR_POSEDGE));
+    ESP_ERROR_CHECK(gpio_isr_handler_add(SNES_PORT1_LATCH_PIN, _SNESPort1LatchISR, NULL));
+}
+
+/**
+ * @fn     void _SNESPort0LatchISR(void* pArg)
+ * @brief  Port 0 latch interrupt service routine
+ * @param  pArg
+ *         Unused
+ */
+static void IRAM_ATTR _SNESPort0LatchISR(void* pArg)
+{
+    SNESLatchStats* pstStats = &_stDriver.stLatchStats;
+    int64_t         s64Now   = esp_timer_get_time();
+    uint16_t        u16Shown = (uint16_t)(_stDriver.astPort[0].u32Tx >> 1);
+    BaseType_t      xWoken   = pdFALSE;
+    uint32_t        u32Period;
+    uint32_t        u32Age;
+    (void)pArg;
+
+    TraceRecord(TRACE_ISR_ENTER, TRACE_ISR_LATCH0, 0);
+    if (pstStats->u32Latches > 0)
+    {
+        u32Period = (uint32_t)(s64Now - _stDriver.s64Port0Latch);
+
+        // Ignore manually triggered latches and pauses.
+        if (u32Period >= SNES_FRAME_PERIOD_MIN && u32Period <= SNES_FRAME_PERIOD_MAX)
+        {
+            if (0 == pstStats->u32FramePeriod)
+            {
+                pstStats->u32FramePeriod = u32Period;
+            }
+            else
+            {
+                pstStats->u32FramePeriod +=
+                    ((int32_t)u32Period - (int32_t)pstStats->u32FramePeriod) / 8;
+            }
+        }
+    }
+    _stDriver.s64Port0Latch = s64Now;
+
+    _SNESPortLatch(&_stDriver.astPort[0]);
+
+    u32Age = (uint32_t)(s64Now - _stDriver.astPort[0].s64TxTime);
+    if (0 == pstStats->u32Latches)
+    {
+        pstStats->u32AgeMin = u32Age;
+        pstStats->u32AgeAvg = u32Age;
+    }
+    pstStats->u32Latches++;
+
+    pstStats->u32AgeLast = u32Age;
+    if (u32Age < pstStats->u32AgeMin)
+    {
+        pstStats->u32AgeMin = u32Age;
+    }
+    if (u32Age > pstStats->u32AgeMax)
+    {
+        pstStats->u32AgeMax = u32Age;
+    }
+    pstStats->u32AgeAvg += ((int32_t)u32Age - (int32_t)pstStats->u32AgeAvg) / 16;
+
+    portENTER_CRITICAL_ISR(&_stDriver.stStampMux);
+    AddLatency(&_stDriver.stCaptureToLatch, u32Age);
+    _stDriver.u32LatchFrame = pstStats->u32Latches;
+    _stDriver.s64LatchTime  = s64Now;
+    portEXIT_CRITICAL_ISR(&_stDriver.stStampMux);
+
+    if (NULL != _stDriver.hInputQueue)
+    {
+        SNESInputEvent stEvent;
+
+        stEvent.s64Time  = s64Now;
+        stEvent.u32Frame = pstStats->u32Latches;
+        stEvent.u16Data  = u16Shown;
+        stEvent.bLatch   = true;
+        if (pdTRUE != xQueueSendFromISR(_stDriver.hInputQueue, &stEvent, &xWoken))
+        {
+            pstStats->u32EventsLost++;
+        }
+    }
+
+    if (NULL != _stDriver.hFrameNotify)
+    {
+        vTaskNotifyGiveFromISR(_stDriver.hFrameNotify, &xWoken);
+    }
+
+    TraceRecord(TRACE_ISR_EXIT, TRACE_ISR_LATCH0, 0);
+    if (xWoken)
+    {
+        portYIELD_FROM_ISR();
+    }
+}
+
+/**
+ * @fn     void _SNESPort1LatchISR(void* pArg)
+ * @brief  Port 1 latch interrupt service routine
+ * @param  pArg
+ *         Unused
+ */
+static void IRAM_ATTR _SNESPort1LatchISR(void* pArg)
+{
+    (void)pArg;
+    TraceRecord(TRACE_ISR_ENTER, TRACE_ISR_LATCH1, 0);
+    _SNESPortLatch(&_stDriver.astPort[1]);
+    TraceRecord(TRACE_ISR_EXIT, TRACE_ISR_LATCH1, 0);
+}
+
+/**
+ * @fn       void _SNESPortLatch(SNESPort* pstPort)
+ * @brief    Count a latch pulse on a controller port
+ * @details  If no transaction is armed when the console latches, the
+ *           port shifts out whatever is left in the data buffer.
+ * @param    pstPort
+ *           Controller port
+ */
+static void IRAM_ATTR _SNESPortLatch(SNESPort* pstPort)
+{
+    pstPort->stStats.u32Latches++;
+    TraceRecord(TRACE_LATCH, pstPort == &_stDriver.astPort[0] ? 0 : 1, pstPort->stStats.u32Latches);
+    if (0 == pstPort->u8Armed)
+    {
+        pstPort->stStats.u32MissedLatches++;
+    }
+}
+
 static void IRAM_ATTR Port0Setup(spi_slave_transaction_t *stTrans)
 {
     (void)stTrans;
@@ -505,7 +1615,15 @@ static void IRAM_ATTR Port0Setup(spi_slave_transaction_t *stTrans)
 
 static void IRAM_ATTR Port0Trans(spi_slave_transaction_t *stTrans)
 {
-    (void)stTrans;
+    SNESPort* pstPort = (SNESPort*)stTrans->user;
+
+    portENTER_CRITICAL_ISR(&_stDriver.stPortMux);
+    pstPort->u8Armed--;
+    portEXIT_CRITICAL_ISR(&_stDriver.stPortMux);
+    pstPort->stStats.u32Transactions++;
+    TraceRecord(TRACE_SPI_DONE, 0, pstPort->stStats.u32Transactions);
+
+    _SNESOverridePort(0);
 }
 
 static void IRAM_ATTR Port1Setup(spi_slave_transaction_t *stTrans)
@@ -515,5 +1633,119 @@ static void IRAM_ATTR Port1Setup(spi_slave_transaction_t *stTrans)
 
 static void IRAM_ATTR Port1Trans(spi_slave_transaction_t *stTrans)
 {
-    (void)stTrans;
+    SNESPort* pstPort = (SNESPort*)stTrans->user;
+
+    portENTER_CRITICAL_ISR(&_stDriver.stPortMux);
+    pstPort->u8Armed--;
+    portEXIT_CRITICAL_ISR(&_stDriver.stPortMux);
+    pstPort->stStats.u32Transactions++;
+    TraceRecord(TRACE_SPI_DONE, 1, pstPort->stStats.u32Transactions);
+
+    // The next transaction is set up right after this callback.
+    if (! _SNESOverridePort(1))
+    {
+        _SNESRemotePlayout(pstPort);
+    }
+}
+
+/**
+ * @fn       bool _SNESOverridePort(uint8_t u8Port)
+ * @brief    Ask the override for the word of a controller port
+ * @details  Called once per latch, see SetSNESOverride().
+ * @param    u8Port
+ *           Controller port
+ * @return   Status
+ * @retval   true  = The override supplied the word
+ * @retval   false = No override for this port
+ */
+static bool IRAM_ATTR _SNESOverridePort(uint8_t u8Port)
+{
+    SNESOverrideFn pfnOverride = _stDriver.pfnOverride;
+    SNESPort*      pstPort     = &_stDriver.astPort[u8Port];
+    int64_t        s64Now      = esp_timer_get_time();
+    uint16_t       u16Data;
+
+    if (NULL == pfnOverride || ! pfnOverride(u8Port, s64Now, &u16Data))
+    {
+        _stDriver.abOverridden[u8Port] = false;
+        return false;
+    }
+    _stDriver.abOverridden[u8Port] = true;
+    _SNESSetPortWord(pstPort, u16Data, s64Now);
+
+    if (0 == u8Port)
+    {
+        portENTER_CRITICAL_ISR(&_stDriver.stStampMux);
+        _stDriver.stInputStamp.s64Time  = s64Now;
+        _stDriver.stInputStamp.u32Frame = _stDriver.stLatchStats.u32Latches;
+        _stDriver.stInputStamp.u16Data  = u16Data;
+        portEXIT_CRITICAL_ISR(&_stDriver.stStampMux);
+    }
+    return true;
+}
+
+/**
+ * @fn       void _SNESRemotePlayout(SNESPort* pstPort)
+ * @brief    Present the next remote word on a controller port
+ * @details  Called once per latch.  If the word for the frame is
+ *           missing, the previous word is repeated.  Pending delay
+ *           adjustments are applied here, one frame per latch.
+ * @param    pstPort
+ *           Controller port
+ */
+static void IRAM_ATTR _SNESRemotePlayout(SNESPort* pstPort)
+{
+    SNESRemoteSlot* pstSlot;
+    int64_t         s64Now = esp_timer_get_time();
+
+    portENTER_CRITICAL_ISR(&_stDriver.stRemoteMux);
+
+    if (_stDriver.bRemotePlaying && _stDriver.s8RemoteSlip > 0)
+    {
+        // Hold the queue for one frame, the word stays on the port.
+        _stDriver.s8RemoteSlip--;
+        _stDriver.stRemoteStats.u32Inserted++;
+    }
+    else if (_stDriver.bRemotePlaying)
+    {
+        if (_stDriver.s8RemoteSlip < 0)
+        {
+            pstSlot         = &_stDriver.astRemote[_stDriver.u32RemotePlay & (SNES_REMOTE_QUEUE_SIZE - 1)];
+            pstSlot->bValid = false;
+            _stDriver.u32RemotePlay++;
+            _stDriver.s8RemoteSlip++;
+            _stDriver.stRemoteStats.u32Dropped++;
+        }
+
+        pstSlot = &_stDriver.astRemote[_stDriver.u32RemotePlay & (SNES_REMOTE_QUEUE_SIZE - 1)];
+
+        if (pstSlot->bValid && pstSlot->u32Frame == _stDriver.u32RemotePlay)
+        {
+            _stDriver.u16RemoteLast = pstSlot->u16Data;
+            pstSlot->bValid         = false;
+            _stDriver.stRemoteStats.u32Presented++;
+
+            // This callback runs at the latch edge that ends the
+            // previous transaction, so now is the time of the latch.
+            portENTER_CRITICAL_ISR(&_stDriver.stStampMux);
+            AddLatency(&_stDriver.stWireToLatch, (uint32_t)(s64Now - pstSlot->s64Arrival));
+            portEXIT_CRITICAL_ISR(&_stDriver.stStampMux);
+        }
+        else
+        {
+            if ((int32_t)(_stDriver.u32RemoteNewest - _stDriver.u32RemotePlay) < 0)
+            {
+                _stDriver.stRemoteStats.u32Underruns++;
+            }
+            _stDriver.stRemoteStats.u32Repeats++;
+        }
+        _stDriver.bRemoteShown   = true;
+        _stDriver.u32RemoteShown = _stDriver.u32RemotePlay;
+        _stDriver.s64RemoteShown = s64Now;
+        _stDriver.u32RemotePlay++;
+
+        pstPort->u32Tx = (uint32_t)_stDriver.u16RemoteLast << 1;
+    }
+
+    portEXIT_CRITICAL_ISR(&_stDriver.stRemoteMux);
 }
@@ -0,0 +1,320 @@
+/**
+ * @file       SNESBulk.c
+ * @brief      SNES bulk data channel
+ * @ingroup    Firmware
+ * @details
+ * @code{.unparsed}
+ *
+ * In bulk mode the SNES doesn't use the auto-joypad read.  Instead, the
+ * software writes the latch bit of $4016 and clocks both ports manually
+ * by reading $4016 and $4017 in a loop.  Each read returns one bit of
+ * each port in bit 0, so both ports transfer in parallel.
+ *
+ * Data is transferred in blocks of 64 bytes spread over both ports, see
+ * SNESBulkProtocol.c for the block format.
+ *
+ * Handshake:
+ *
+ * The SNES latches, reads the block and checks magic and CRC.  If the
+ * block is valid, it toggles bit 6 of WRIO ($4201), which is wired to
+ * IOPort 6 on pin 6 of port 0.  On this edge the firmware hands the
+ * next staged block over to the ports.  The SNES should wait at least
+ * 20µs before latching again.  If no new data was staged, the previous
+ * block is repeated; the SNES recognises it by its unchanged sequence
+ * number.  A corrupted block is simply read again without toggling.
+ *
+ * @endcode
+ * @author     SNESoIP contributors
+ * @copyright  "THE BEER-WARE LICENCE" (Revision 42)
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/ringbuf.h"
+#include "esp_err.h"
+#include "esp_log.h"
+#include "driver/gpio.h"
+#include "SNES.h"
+#include "SNESBulk.h"
+#include "Tasks.h"
+#include "Trace.h"
+
+#if SNES_BULK_PORTS != SNES_NUM_PORTS
+#error "SNES_BULK_PORTS has to match SNES_NUM_PORTS"
+#endif
+
+/**
+ * @typedef  SNESBulk
+ * @brief    Bulk data channel data
+ * @struct   SNESBulk_t
+ * @brief    Bulk data channel data structure
+ */
+typedef struct SNESBulk_t
+{
+    bool            bIsRunning;  ///< Run condition
+    volatile bool   bEnabled;    ///< Bulk mode active
+    RingbufHandle_t hRingbuf;    ///< Staging buffer
+    TaskHandle_t    hTask;       ///< Block builder task
+    portMUX_TYPE    stMux;       ///< Guards the block buffers
+
+    /// Packed block shifted out at the next latch
+    uint32_t au32Tx[SNES_NUM_PORTS][SNES_BULK_PORT_WORDS];
+    /// Packed block handed over on the next acknowledge
+    uint32_t au32Next[SNES_NUM_PORTS][SNES_BULK_PORT_WORDS];
+
+    volatile bool bNextReady;     ///< au32Next holds a block
+    volatile bool bAckPending;    ///< Acknowledged without a block staged
+    volatile bool bCreditUpdate;  ///< Credit changed, stage an empty block
+    uint8_t       u8Seq;          ///< Sequence number of the last block
+    uint8_t       u8Credit;       ///< Upstream credit
+    SNESBulkStats stStats;        ///< Statistics
+
+} SNESBulk;
+
+/**
+ * @var    _stBulk
+ * @brief  Bulk data channel private data
+ */
+static SNESBulk _stBulk;
+
+static void _SNESBulkThread(void* pArg);
+static void _SNESBulkBuild(const uint8_t* pu8Payload, uint8_t u8Len, uint32_t au32Out[][SNES_BULK_PORT_WORDS]);
+static void IRAM_ATTR _SNESBulkAckISR(void* pArg);
+
+/**
+ * @fn     void InitSNESBulk(void)
+ * @brief  Initialise the bulk data channel
+ * @note   Has to be called after InitSNES().
+ */
+void InitSNESBulk(void)
+{
+    gpio_config_t stGPIOConf;
+
+    memset(&_stBulk, 0, sizeof(struct SNESBulk_t));
+    _stBulk.bIsRunning = true;
+    _stBulk.hRingbuf   = xRingbufferCreate(SNES_BULK_BUFFER_SIZE, RINGBUF_TYPE_BYTEBUF);
+    vPortCPUInitializeMutex(&_stBulk.stMux);
+
+    // Idle block until the first data is written.
+    _SNESBulkBuild(NULL, 0, _stBulk.au32Tx);
+
+    stGPIOConf.intr_type    = GPIO_INTR_ANYEDGE;
+    stGPIOConf.mode         = GPIO_MODE_INPUT;
+    stGPIOConf.pin_bit_mask = SNES_PORT0_IO_BIT;
+    stGPIOConf.pull_down_en = 0;
+    stGPIOConf.pull_up_en   = 1;
+    ESP_ERROR_CHECK(gpio_config(&stGPIOConf));
+
+    xTaskCreatePinnedToCore(
+        _SNESBulkThread, "SNESBulkThread", 2048, NULL,
+        TASK_PRIO_SNES_DATA, &_stBulk.hTask, TASK_CORE_SNES);
+    ESP_ERROR_CHECK(gpio_isr_handler_add(SNES_PORT0_IO_PIN, _SNESBulkAckISR, NULL));
+}
+
+/**
+ * @fn     void SetSNESBulkMode(bool bEnable)
+ * @brief  Switch both controller ports between joypad and bulk mode
+ * @param  bEnable
+ *         true = bulk mode, false = joypad mode
+ */
+void SetSNESBulkMode(bool bEnable)
+{
+    _stBulk.bEnabled = bEnable;
+
+    for (uint8_t u8Port = 0; u8Port < SNES_NUM_PORTS; u8Port++)
+    {
+        if (bEnable)
+        {
+            SetSNESPortBuffer(u8Port, _stBulk.au32Tx[u8Port], SNES_BULK_PORT_BITS);
+        }
+        else
+        {
+            SetSNESPortBuffer(u8Port, NULL, 0);
+        }
+    }
+    ESP_LOGI("SNESBulk", "Bulk mode %s.", bEnable ? "enabled" : "disabled");
+}
+
+/**
+ * @fn     bool IsSNESBulkMode(void)
+ * @brief  Check if the controller ports are in bulk mode
+ */
+bool IsSNESBulkMode(void)
+{
+    return _stBulk.bEnabled;
+}
+
+/**
+ * @fn      bool WriteSNESBulk(const uint8_t* pu8Data, size_t uSize, TickType_t xTimeout)
+ * @brief   Stage data for the SNES
+ * @param   pu8Data
+ *          Data
+ * @param   uSize
+ *          Size of the data in bytes
+ * @param   xTimeout
+ *          Max. time to wait for free space in ticks
+ * @return  Status
+ * @retval  true  = All data has been staged
+ * @retval  false = Not enough space in the staging buffer
+ */
+bool WriteSNESBulk(const uint8_t* pu8Data, size_t uSize, TickType_t xTimeout)
+{
+    if (pdTRUE != xRingbufferSend(_stBulk.hRingbuf, pu8Data, uSize, xTimeout))
+    {
+        return false;
+    }
+    xTaskNotifyGive(_stBulk.hTask);
+    return true;
+}
+
+/**
+ * @fn     void GetSNESBulkStats(SNESBulkStats* pstStats)
+ * @brief  Get bulk data channel statistics
+ * @param  pstStats
+ *         Destination of the statistics
+ */
+void GetSNESBulkStats(SNESBulkStats* pstStats)
+{
+    memcpy(pstStats, &_stBulk.stStats, sizeof(SNESBulkStats));
+}
+
+/**
+ * @fn       void SetSNESBulkCredit(uint8_t u8Credit)
+ * @brief    Set the upstream credit announced in the block header
+ * @details  If the credit changes, an empty block is staged so the SNES
+ *           learns about it even if no downstream data is pending.
+ * @param    u8Credit
+ *           Number of upstream frames the firmware can accept
+ */
+void SetSNESBulkCredit(uint8_t u8Credit)
+{
+    if (u8Credit == _stBulk.u8Credit)
+    {
+        return;
+    }
+    _stBulk.u8Credit = u8Credit;
+
+    if (_stBulk.bEnabled)
+    {
+        _stBulk.bCreditUpdate = true;
+        xTaskNotifyGive(_stBulk.hTask);
+    }
+}
+
+/**
+ * @fn       void _SNESBulkThread(void* pArg)
+ * @brief    Block builder thread
+ * @details  Takes up to one payload worth of staged data, builds the
+ *           next block and hands it over to the acknowledge ISR.
+ * @param    pArg
+ *           Unused
+ */
+static void _SNESBulkThread(void* pArg)
+{
+    uint32_t au32Block[SNES_NUM_PORTS][SNES_BULK_PORT_WORDS];
+    uint8_t* pu8Data;
+    size_t   uSize;
+    (void)pArg;
+
+    while (_stBulk.bIsRunning)
+    {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        while (! _stBulk.bNextReady)
+        {
+            pu8Data = xRingbufferReceiveUpTo(_stBulk.hRingbuf, &uSize, 0, SNES_BULK_PAYLOAD_SIZE);
+            if (NULL != pu8Data)
+            {
+                _SNESBulkBuild(pu8Data, (uint8_t)uSize, au32Block);
+                vRingbufferReturnItem(_stBulk.hRingbuf, pu8Data);
+            }
+            else if (_stBulk.bCreditUpdate)
+            {
+                uSize = 0;
+                _SNESBulkBuild(NULL, 0, au32Block);
+            }
+            else
+            {
+                break;
+            }
+            _stBulk.bCreditUpdate = false;
+
+            portENTER_CRITICAL(&_stBulk.stMux);
+            if (_stBulk.bAckPending)
+            {
+                memcpy(_stBulk.au32Tx, au32Block, sizeof(au32Block));
+                _stBulk.bAckPending = false;
+                _stBulk.stStats.u32Blocks++;
+            }
+            else
+            {
+                memcpy(_stBulk.au32Next, au32Block, sizeof(au32Block));
+                _stBulk.bNextReady = true;
+            }
+            _stBulk.stStats.u32Bytes += uSize;
+            portEXIT_CRITICAL(&_stBulk.stMux);
+        }
+    }
+
+    vTaskDelete(NULL);
+}
+
+/**
+ * @fn     void _SNESBulkBuild(const uint8_t* pu8Payload, uint8_t u8Len, uint32_t au32Out[][SNES_BULK_PORT_WORDS])
+ * @brief  Build a block and pack it for both controller ports
+ * @param  pu8Payload
+ *         Payload, may be NULL if u8Len is zero
+ * @param  u8Len
+ *         Payload size in bytes, up to SNES_BULK_PAYLOAD_SIZE
+ * @param  au32Out
+ *         Packed port buffers
+ */
+static void _SNESBulkBuild(const uint8_t* pu8Payload, uint8_t u8Len, uint32_t au32Out[][SNES_BULK_PORT_WORDS])
+{
+    _stBulk.u8Seq++;
+    SNESBulkPack(_stBulk.u8Seq, _stBulk.u8Credit, pu8Payload, u8Len, au32Out);
+}
+
+/**
+ * @fn     void _SNESBulkAckISR(void* pArg)
+ * @brief  IOPort 6 edge interrupt service routine
+ * @param  pArg
+ *         Unused
+ */
+static void IRAM_ATTR _SNESBulkAckISR(void* pArg)
+{
+    BaseType_t xWoken = pdFALSE;
+    (void)pArg;
+
+    if (! _stBulk.bEnabled)
+    {
+        return;
+    }
+
+    TraceRecord(TRACE_ISR_ENTER, TRACE_ISR_BULK_ACK, 0);
+    portENTER_CRITICAL_ISR(&_stBulk.stMux);
+    _stBulk.stStats.u32Acks++;
+    if (_stBulk.bNextReady)
+    {
+        memcpy(_stBulk.au32Tx, _stBulk.au32Next, sizeof(_stBulk.au32Tx));
+        _stBulk.bNextReady = false;
+        _stBulk.stStats.u32Blocks++;
+    }
+    else
+    {
+        _stBulk.bAckPending = true;
+        _stBulk.stStats.u32Stalls++;
+    }
+    portEXIT_CRITICAL_ISR(&_stBulk.stMux);
+
+    vTaskNotifyGiveFromISR(_stBulk.hTask, &xWoken);
+    TraceRecord(TRACE_ISR_EXIT, TRACE_ISR_BULK_ACK, 0);
+    if (xWoken)
+    {
+        portYIELD_FROM_ISR();
+    }
+}
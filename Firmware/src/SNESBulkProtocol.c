@@ -0,0 +1,118 @@
+/**
+ * @file       SNESBulkProtocol.c
+ * @brief      SNES bulk data block format
+ * @ingroup    Firmware
+ * @details
+ * @code{.unparsed}
+ *
+ * Data is transferred in blocks of 64 bytes.  The even bytes of a block
+ * are shifted out on port 0, the odd bytes on port 1, 32 bytes per port
+ * and latch.  As with the controller word, a dummy bit precedes the
+ * data and all bits are inverted on the wire, so the SNES reads the
+ * bytes as they are.
+ *
+ *   +-----+-----+-----+-----+---------------------+-----+-----+
+ *   |  0  |  1  |  2  |  3  | 4 ... 61            | 62  | 63  |
+ *   +-----+-----+-----+-----+---------------------+-----+-----+
+ *   | $5A | SEQ | LEN | CRD | Payload (58 bytes)  | CRC | CRC |
+ *   +-----+-----+-----+-----+---------------------+-----+-----+
+ *
+ *   SEQ: Sequence number, incremented for each new block
+ *   LEN: Number of valid payload bytes
+ *   CRD: Upstream credit, see SNESUpstream.c
+ *   CRC: CRC-16-CCITT of bytes 0 to 61, low byte first
+ *
+ * No drivers or FreeRTOS calls are used here, so the same code runs on
+ * the adapter and in the host simulation (Tools/BulkSim).
+ *
+ * @endcode
+ * @author     SNESoIP contributors
+ * @copyright  "THE BEER-WARE LICENCE" (Revision 42)
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "SNESBulkProtocol.h"
+
+/**
+ * @fn      uint16_t SNESBulkCRC(const uint8_t* pu8Data, size_t uSize)
+ * @brief   CRC-16-CCITT (polynomial 0x1021, initial value 0xffff)
+ * @param   pu8Data
+ *          Data
+ * @param   uSize
+ *          Size of the data in bytes
+ * @return  CRC
+ */
+uint16_t SNESBulkCRC(const uint8_t* pu8Data, size_t uSize)
+{
+    uint16_t u16CRC = 0xffff;
+
+    while (uSize--)
+    {
+        u16CRC ^= (uint16_t)(*pu8Data++) << 8;
+        for (uint8_t u8Bit = 0; u8Bit < 8; u8Bit++)
+        {
+            if (u16CRC & 0x8000)
+            {
+                u16CRC = (uint16_t)(u16CRC << 1) ^ 0x1021;
+            }
+            else
+            {
+                u16CRC = (uint16_t)(u16CRC << 1);
+            }
+        }
+    }
+
+    return u16CRC;
+}
+
+/**
+ * @fn     void SNESBulkPack(uint8_t u8Seq, uint8_t u8Credit, const uint8_t* pu8Payload, uint8_t u8Len, uint32_t au32Out[][SNES_BULK_PORT_WORDS])
+ * @brief  Build a block and pack it for both controller ports
+ * @param  u8Seq
+ *         Sequence number
+ * @param  u8Credit
+ *         Upstream credit
+ * @param  pu8Payload
+ *         Payload, may be NULL if u8Len is zero
+ * @param  u8Len
+ *         Payload size in bytes, up to SNES_BULK_PAYLOAD_SIZE
+ * @param  au32Out
+ *         Packed port buffers
+ */
+void SNESBulkPack(uint8_t u8Seq, uint8_t u8Credit, const uint8_t* pu8Payload, uint8_t u8Len, uint32_t au32Out[][SNES_BULK_PORT_WORDS])
+{
+    uint8_t  au8Block[SNES_BULK_BLOCK_SIZE] = { 0 };
+    uint16_t u16CRC;
+
+    au8Block[0] = SNES_BULK_MAGIC;
+    au8Block[1] = u8Seq;
+    au8Block[2] = u8Len;
+    au8Block[3] = u8Credit;
+    if (u8Len > 0)
+    {
+        memcpy(&au8Block[SNES_BULK_HEADER_SIZE], pu8Payload, u8Len);
+    }
+
+    u16CRC = SNESBulkCRC(au8Block, SNES_BULK_BLOCK_SIZE - SNES_BULK_CRC_SIZE);
+    au8Block[SNES_BULK_BLOCK_SIZE - 2] = u16CRC & 0xff;
+    au8Block[SNES_BULK_BLOCK_SIZE - 1] = u16CRC >> 8;
+
+    // Interleave, invert and prepend the dummy bit (LSB first).
+    for (uint8_t u8Port = 0; u8Port < SNES_BULK_PORTS; u8Port++)
+    {
+        uint8_t* pu8Out  = (uint8_t*)au32Out[u8Port];
+        uint8_t  u8Carry = 0;
+
+        memset(pu8Out, 0, SNES_BULK_PORT_WORDS * sizeof(uint32_t));
+        for (uint8_t u8Index = 0; u8Index < SNES_BULK_PORT_BYTES; u8Index++)
+        {
+            uint8_t u8Byte = (uint8_t)~au8Block[(u8Index * SNES_BULK_PORTS) + u8Port];
+
+            pu8Out[u8Index] = (uint8_t)(u8Byte << 1) | u8Carry;
+            u8Carry         = u8Byte >> 7;
+        }
+        pu8Out[SNES_BULK_PORT_BYTES] = u8Carry;
+    }
+}
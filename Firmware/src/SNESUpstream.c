@@ -0,0 +1,316 @@
+/**
+ * @file       SNESUpstream.c
+ * @brief      SNES upstream data channel
+ * @ingroup    Firmware
+ * @details
+ * @code{.unparsed}
+ *
+ * The controller ports only carry data from the firmware to the SNES.
+ * For the opposite direction the SNES bit-bangs bit 7 of WRIO ($4201),
+ * which is wired to IOPort 7 on pin 6 of port 1.  The line idles high.
+ *
+ * Each bit is a low pulse of T followed by a high phase whose length
+ * encodes the bit value.  A frame ends with a closing low pulse, after
+ * which the line stays high.  The code is self-clocking, so the exact
+ * value of T doesn't matter as long as the SNES keeps it roughly
+ * constant within a frame (SNES_UPSTREAM_BIT_US is the nominal value).
+ *
+ *          T    T     T      3T      T
+ *   ‾‾‾‾|____|‾‾‾‾|____|‾‾‾‾‾‾‾‾‾‾‾‾|____|‾‾‾‾‾‾‾‾‾
+ *       |   0     |      1           | end
+ *
+ * Bytes are sent LSB first.  A frame looks like this:
+ *
+ *   +-----+-----------------------+-----+
+ *   | LEN | Payload (LEN bytes)   | CRC |
+ *   +-----+-----------------------+-----+
+ *
+ *   LEN: Number of payload bytes, 1 to SNES_UPSTREAM_MAX_PAYLOAD
+ *   CRC: CRC-8 (polynomial 0x07) of LEN and payload
+ *
+ * Flow control:
+ *
+ * The CRD byte of every bulk block (see SNESBulk.c) tells the SNES how
+ * many more frames of maximum size the firmware can buffer.  The SNES
+ * must not send more frames than announced.  Frames that arrive anyway
+ * are dropped and counted as overflows.
+ *
+ * @endcode
+ * @author     SNESoIP contributors
+ * @copyright  "THE BEER-WARE LICENCE" (Revision 42)
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/ringbuf.h"
+#include "esp_err.h"
+#include "esp_log.h"
+#include "driver/rmt.h"
+#include "SNES.h"
+#include "SNESBulk.h"
+#include "SNESUpstream.h"
+#include "Tasks.h"
+
+#define SNES_UPSTREAM_CHANNEL     RMT_CHANNEL_4              // !< RMT receive channel
+#define SNES_UPSTREAM_MEM_BLOCKS  4                          // !< 256 items, one full frame
+#define SNES_UPSTREAM_CLK_DIV     8                          // !< 0.1µs per RMT tick
+#define SNES_UPSTREAM_TICKS_US    10                         // !< RMT ticks per µs
+#define SNES_UPSTREAM_T           (SNES_UPSTREAM_BIT_US * SNES_UPSTREAM_TICKS_US)
+#define SNES_UPSTREAM_FILTER      80                         // !< Glitch filter, 1µs in APB cycles
+#define SNES_UPSTREAM_MAX_FRAME   (SNES_UPSTREAM_MAX_PAYLOAD + 2)  // !< LEN + payload + CRC
+
+/**
+ * @typedef  SNESUpstream
+ * @brief    Upstream channel data
+ * @struct   SNESUpstream_t
+ * @brief    Upstream channel data structure
+ */
+typedef struct SNESUpstream_t
+{
+    bool              bIsRunning;  ///< Run condition
+    rmt_config_t      stRx;        ///< RMT receiver configuration
+    RingbufHandle_t   hRxRingbuf;  ///< RMT item buffer
+    RingbufHandle_t   hRingbuf;    ///< Received payload
+    SNESUpstreamStats stStats;     ///< Statistics
+
+} SNESUpstream;
+
+/**
+ * @var    _stUpstream
+ * @brief  Upstream channel private data
+ */
+static SNESUpstream _stUpstream;
+
+static void    _SNESUpstreamThread(void* pArg);
+static size_t  _SNESUpstreamDecode(const rmt_item32_t* pstItems, size_t uNumItems, uint8_t* pu8Frame);
+static uint8_t _SNESUpstreamCRC(const uint8_t* pu8Data, size_t uSize);
+static void    _SNESUpstreamUpdateCredit(void);
+
+/**
+ * @fn     void InitSNESUpstream(void)
+ * @brief  Initialise the upstream data channel
+ * @note   Has to be called after InitSNESBulk().
+ */
+void InitSNESUpstream(void)
+{
+    memset(&_stUpstream, 0, sizeof(struct SNESUpstream_t));
+    _stUpstream.bIsRunning = true;
+    _stUpstream.hRingbuf   = xRingbufferCreate(SNES_UPSTREAM_BUFFER_SIZE, RINGBUF_TYPE_BYTEBUF);
+
+    _stUpstream.stRx.rmt_mode      = RMT_MODE_RX;
+    _stUpstream.stRx.channel       = SNES_UPSTREAM_CHANNEL;
+    _stUpstream.stRx.clk_div       = SNES_UPSTREAM_CLK_DIV;
+    _stUpstream.stRx.gpio_num      = SNES_PORT1_IO_PIN;
+    _stUpstream.stRx.mem_block_num = SNES_UPSTREAM_MEM_BLOCKS;
+
+    _stUpstream.stRx.rx_config.filter_en           = 1;
+    _stUpstream.stRx.rx_config.filter_ticks_thresh = SNES_UPSTREAM_FILTER;
+    _stUpstream.stRx.rx_config.idle_threshold      = 5 * SNES_UPSTREAM_T;
+
+    ESP_ERROR_CHECK(rmt_config(&_stUpstream.stRx));
+    ESP_ERROR_CHECK(rmt_driver_install(_stUpstream.stRx.channel, 2048, 0));
+    ESP_ERROR_CHECK(rmt_get_ringbuf_handle(_stUpstream.stRx.channel, &_stUpstream.hRxRingbuf));
+    ESP_ERROR_CHECK(rmt_rx_start(_stUpstream.stRx.channel, true));
+
+    _SNESUpstreamUpdateCredit();
+    xTaskCreatePinnedToCore(
+        _SNESUpstreamThread, "SNESUpstreamThread", 2048, NULL,
+        TASK_PRIO_SNES_DATA, NULL, TASK_CORE_SNES);
+}
+
+/**
+ * @fn      size_t ReadSNESUpstream(uint8_t* pu8Data, size_t uSize, TickType_t xTimeout)
+ * @brief   Read data sent by the SNES
+ * @param   pu8Data
+ *          Destination buffer
+ * @param   uSize
+ *          Size of the destination buffer in bytes
+ * @param   xTimeout
+ *          Max. time to wait for data in ticks
+ * @return  Number of bytes read
+ */
+size_t ReadSNESUpstream(uint8_t* pu8Data, size_t uSize, TickType_t xTimeout)
+{
+    uint8_t* pu8Item;
+    size_t   uItemSize = 0;
+
+    pu8Item = xRingbufferReceiveUpTo(_stUpstream.hRingbuf, &uItemSize, xTimeout, uSize);
+    if (NULL == pu8Item)
+    {
+        return 0;
+    }
+    memcpy(pu8Data, pu8Item, uItemSize);
+    vRingbufferReturnItem(_stUpstream.hRingbuf, pu8Item);
+
+    _SNESUpstreamUpdateCredit();
+    return uItemSize;
+}
+
+/**
+ * @fn     void GetSNESUpstreamStats(SNESUpstreamStats* pstStats)
+ * @brief  Get upstream channel statistics
+ * @param  pstStats
+ *         Destination of the statistics
+ */
+void GetSNESUpstreamStats(SNESUpstreamStats* pstStats)
+{
+    memcpy(pstStats, &_stUpstream.stStats, sizeof(SNESUpstreamStats));
+}
+
+/**
+ * @fn       void _SNESUpstreamThread(void* pArg)
+ * @brief    Upstream decoder thread
+ * @details  Waits for the RMT receiver to deliver a burst, decodes it
+ *           and stores the payload of valid frames.
+ * @param    pArg
+ *           Unused
+ */
+static void _SNESUpstreamThread(void* pArg)
+{
+    rmt_item32_t* pstItems;
+    size_t        uItemSize = 0;
+    uint8_t       au8Frame[SNES_UPSTREAM_MAX_FRAME];
+    size_t        uFrameSize;
+    (void)pArg;
+
+    while (_stUpstream.bIsRunning)
+    {
+        pstItems = xRingbufferReceive(_stUpstream.hRxRingbuf, &uItemSize, portMAX_DELAY);
+        if (NULL == pstItems)
+        {
+            continue;
+        }
+        uFrameSize = _SNESUpstreamDecode(pstItems, uItemSize / sizeof(rmt_item32_t), au8Frame);
+        vRingbufferReturnItem(_stUpstream.hRxRingbuf, pstItems);
+
+        if (0 == uFrameSize)
+        {
+            _stUpstream.stStats.u32CodingErrors++;
+            continue;
+        }
+
+        if (au8Frame[0] == 0 ||
+            au8Frame[0] > SNES_UPSTREAM_MAX_PAYLOAD ||
+            uFrameSize != (size_t)au8Frame[0] + 2 ||
+            au8Frame[uFrameSize - 1] != _SNESUpstreamCRC(au8Frame, uFrameSize - 1))
+        {
+            _stUpstream.stStats.u32CRCErrors++;
+            continue;
+        }
+
+        if (pdTRUE != xRingbufferSend(_stUpstream.hRingbuf, &au8Frame[1], au8Frame[0], 0))
+        {
+            _stUpstream.stStats.u32Overflows++;
+            continue;
+        }
+        _stUpstream.stStats.u32Frames++;
+        _stUpstream.stStats.u32Bytes += au8Frame[0];
+        _SNESUpstreamUpdateCredit();
+    }
+
+    vTaskDelete(NULL);
+}
+
+/**
+ * @fn       size_t _SNESUpstreamDecode(const rmt_item32_t* pstItems, size_t uNumItems, uint8_t* pu8Frame)
+ * @brief    Decode a pulse-distance coded burst
+ * @details  Every item but the last one holds one bit: a low pulse
+ *           followed by a short (0) or long (1) high phase.  The last
+ *           item holds the closing low pulse; its high phase has been
+ *           cut off by the idle threshold.
+ * @param    pstItems
+ *           RMT items
+ * @param    uNumItems
+ *           Number of RMT items
+ * @param    pu8Frame
+ *           Destination, SNES_UPSTREAM_MAX_FRAME bytes
+ * @return   Frame size in bytes, 0 on coding errors
+ */
+static size_t _SNESUpstreamDecode(const rmt_item32_t* pstItems, size_t uNumItems, uint8_t* pu8Frame)
+{
+    size_t uNumBits;
+
+    if (uNumItems < 2)
+    {
+        return 0;
+    }
+    uNumBits = uNumItems - 1;
+    if ((uNumBits % 8) || (uNumBits / 8) > SNES_UPSTREAM_MAX_FRAME)
+    {
+        return 0;
+    }
+    if (pstItems[uNumBits].level0 != 0 || pstItems[uNumBits].duration1 != 0)
+    {
+        return 0;
+    }
+
+    memset(pu8Frame, 0, uNumBits / 8);
+    for (size_t uBit = 0; uBit < uNumBits; uBit++)
+    {
+        const rmt_item32_t* pstItem = &pstItems[uBit];
+
+        if (pstItem->level0 != 0 || pstItem->duration1 == 0)
+        {
+            return 0;
+        }
+        // Compare the high phase against the low pulse, which makes
+        // the decision independent of the actual bit period.
+        if (pstItem->duration1 > 2 * pstItem->duration0)
+        {
+            pu8Frame[uBit / 8] |= 1 << (uBit % 8);
+        }
+    }
+
+    return uNumBits / 8;
+}
+
+/**
+ * @fn      uint8_t _SNESUpstreamCRC(const uint8_t* pu8Data, size_t uSize)
+ * @brief   CRC-8 (polynomial 0x07, initial value 0x00)
+ * @param   pu8Data
+ *          Data
+ * @param   uSize
+ *          Size of the data in bytes
+ * @return  CRC
+ */
+static uint8_t _SNESUpstreamCRC(const uint8_t* pu8Data, size_t uSize)
+{
+    uint8_t u8CRC = 0;
+
+    while (uSize--)
+    {
+        u8CRC ^= *pu8Data++;
+        for (uint8_t u8Bit = 0; u8Bit < 8; u8Bit++)
+        {
+            if (u8CRC & 0x80)
+            {
+                u8CRC = (u8CRC << 1) ^ 0x07;
+            }
+            else
+            {
+                u8CRC = u8CRC << 1;
+            }
+        }
+    }
+
+    return u8CRC;
+}
+
+/**
+ * @fn     void _SNESUpstreamUpdateCredit(void)
+ * @brief  Announce the free buffer space to the SNES
+ */
+static void _SNESUpstreamUpdateCredit(void)
+{
+    size_t uCredit = xRingbufferGetCurFreeSize(_stUpstream.hRingbuf) / SNES_UPSTREAM_MAX_PAYLOAD;
+
+    if (uCredit > 0xff)
+    {
+        uCredit = 0xff;
+    }
+    SetSNESBulkCredit((uint8_t)uCredit);
+}
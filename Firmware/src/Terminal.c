@@ -8,17 +8,55 @@
 
 #include <stdbool.h>
 #include <stdint.h>
+#include <stdio.h>
 #include <string.h>
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "esp_system.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "lwip/err.h"
 #include "lwip/sockets.h"
 #include "lwip/sys.h"
 #include "lwip/netdb.h"
+#include "Boot.h"
+#include "ExchangeClient.h"
+#include "JitterBench.h"
+#include "Movie.h"
+#include "Netplay.h"
 #include "SNES.h"
+#include "SNESBulk.h"
+#include "SNESUpstream.h"
+#include "Tasks.h"
 #include "Terminal.h"
+#include "TerminalBulk.h"
+#include "TerminalStream.h"
+#include "Trace.h"
+#include "WiFi.h"
+
+#define TERMINAL_STATS_TASKS    32   // !< Max. number of tasks listed by "stats"
+#define TERMINAL_SELECT_MS      1000 // !< Max. time between two run condition checks
+#define TERMINAL_MOVIE_MS       20   // !< Retry interval while the movie buffer is full
+#define TERMINAL_DUMP_MS        5000 // !< Max. time a trace dump may stall
+#define TERMINAL_DUMP_RETRY_MS  20   // !< Retry interval while the send buffer is full
+#define TERMINAL_DUMP_EVENTS    32   // !< Trace events encoded per send
+
+/**
+ * @typedef  TerminalSession
+ * @brief    Terminal connection
+ * @struct   TerminalSession_t
+ * @brief    Terminal connection structure
+ */
+typedef struct TerminalSession_t
+{
+    int                nSock;            ///< Connection, -1 = unused entry
+    struct sockaddr_in stAddr;           ///< Address of the host
+    char               acRxBuffer[128];  ///< Partially received command line
+    uint8_t            u8RxLen;          ///< Bytes in acRxBuffer
+    uint32_t           u32MovieLeft;     ///< Movie bytes still to be uploaded
+
+} TerminalSession;
 
 /**
  * @struct  Terminal
@@ -26,8 +64,14 @@
  */
 typedef struct Terminal_t
 {
-    bool bIsRunning;
-    bool bHostConnected;
+    bool            bIsRunning;
+    bool            bHostConnected;
+    int             nListenSock;
+    TerminalSession astSession[TERMINAL_MAX_SESSIONS];
+    TaskStatus_t    astTask[TERMINAL_STATS_TASKS];
+    TaskStatus_t    astTaskPrev[TERMINAL_STATS_TASKS];
+    UBaseType_t     uTasksPrev;
+    uint32_t        u32TotalTimePrev;
 
 } Terminal;
 
@@ -38,6 +82,19 @@ typedef struct Terminal_t
 static Terminal _stTerminal;
 
 static void _TerminalThread(void* pArg);
+static bool _TerminalListen(void);
+static void _TerminalAccept(void);
+static void _TerminalReceive(TerminalSession* pstSession);
+static void _TerminalReceiveMovie(TerminalSession* pstSession);
+static void _TerminalClose(TerminalSession* pstSession);
+static void _TerminalCommand(TerminalSession* pstSession, char* pacLine);
+static void _TerminalStats(int nSock);
+static void _TerminalMovie(TerminalSession* pstSession, char* pacLine);
+static void _TerminalWiFi(int nSock, char* pacLine);
+static void _TerminalJitter(int nSock, char* pacLine);
+static void _TerminalTrace(int nSock, char* pacLine);
+static bool _TerminalTraceDump(int nSock);
+static bool _TerminalSendAll(int nSock, const uint8_t* pu8Data, size_t uSize, int64_t s64Deadline);
 static bool _CheckCommand(char* pacRxBuffer, char* pacCommand);
 
 /**
@@ -48,7 +105,16 @@ void InitTerminal(void)
 {
     ESP_LOGI("Term", "Initialise terminal");
     memset(&_stTerminal, 0, sizeof(struct Terminal_t));
-    xTaskCreate(_TerminalThread, "TerminalThread", 4096, NULL, 3, NULL);
+    _stTerminal.nListenSock = -1;
+    for (uint8_t u8Index = 0; u8Index < TERMINAL_MAX_SESSIONS; u8Index++)
+    {
+        _stTerminal.astSession[u8Index].nSock = -1;
+    }
+    InitTerminalStream();
+    InitTerminalBulk();
+    xTaskCreatePinnedToCore(
+        _TerminalThread, "TerminalThread", 4096, NULL,
+        TASK_PRIO_SERVICE, NULL, TASK_CORE_NET);
 }
 
 /**
@@ -77,166 +143,1007 @@ bool IsHostConnected(void)
 }
 
 /**
- * @fn     void _TerminalThread(void* pArg)
- * @brief  Terminal thread
- * @param  pArg
- *         Unused
+ * @fn       void _TerminalThread(void* pArg)
+ * @brief    Terminal thread
+ * @details  All sockets are non-blocking and the thread sleeps in
+ *           select() until a host connects or a session has sent
+ *           something, so a slow or idle host never holds up the
+ *           others.
+ * @param    pArg
+ *           Unused
  */
 static void _TerminalThread(void* pArg)
 {
-    struct sockaddr_in stDestAddr;
+    (void)pArg;
+
+    if (! _TerminalListen())
+    {
+        vTaskDelete(NULL);
+        return;
+    }
+
+    _stTerminal.bIsRunning = true;
+    while (_stTerminal.bIsRunning)
+    {
+        struct timeval stTimeout;
+        fd_set         stReadSet;
+        int            nMaxSock   = _stTerminal.nListenSock;
+        bool           bMovieFull = false;
+
+        FD_ZERO(&stReadSet);
+        FD_SET(_stTerminal.nListenSock, &stReadSet);
+        for (uint8_t u8Index = 0; u8Index < TERMINAL_MAX_SESSIONS; u8Index++)
+        {
+            TerminalSession* pstSession = &_stTerminal.astSession[u8Index];
+
+            if (-1 == pstSession->nSock)
+            {
+                continue;
+            }
+
+            // Leave the movie in the socket until there is room for it.
+            if (pstSession->u32MovieLeft > 0 && 0 == GetMovieFree())
+            {
+                bMovieFull = true;
+                continue;
+            }
+
+            FD_SET(pstSession->nSock, &stReadSet);
+            if (pstSession->nSock > nMaxSock)
+            {
+                nMaxSock = pstSession->nSock;
+            }
+        }
+
+        stTimeout.tv_sec  = TERMINAL_SELECT_MS / 1000;
+        stTimeout.tv_usec = 0;
+        if (bMovieFull)
+        {
+            stTimeout.tv_sec  = 0;
+            stTimeout.tv_usec = TERMINAL_MOVIE_MS * 1000;
+        }
+        if (0 > select(nMaxSock + 1, &stReadSet, NULL, NULL, &stTimeout))
+        {
+            ESP_LOGE("Term", "select failed: errno %d", errno);
+            vTaskDelay(TERMINAL_SELECT_MS / portTICK_PERIOD_MS);
+            continue;
+        }
+
+        for (uint8_t u8Index = 0; u8Index < TERMINAL_MAX_SESSIONS; u8Index++)
+        {
+            TerminalSession* pstSession = &_stTerminal.astSession[u8Index];
+
+            if (-1 != pstSession->nSock && FD_ISSET(pstSession->nSock, &stReadSet))
+            {
+                _TerminalReceive(pstSession);
+            }
+        }
+        if (FD_ISSET(_stTerminal.nListenSock, &stReadSet))
+        {
+            _TerminalAccept();
+        }
+
+        _stTerminal.bHostConnected = false;
+        for (uint8_t u8Index = 0; u8Index < TERMINAL_MAX_SESSIONS; u8Index++)
+        {
+            if (-1 != _stTerminal.astSession[u8Index].nSock)
+            {
+                _stTerminal.bHostConnected = true;
+            }
+        }
+    }
 
-    char acRxBuffer[128];
-    char acAddrStr[128];
-    int  nAddrFamily;
-    int  nIPProtocol;
-    int  nListenSock;
-    int  nSockOpt;
-    int  nErr;
+    for (uint8_t u8Index = 0; u8Index < TERMINAL_MAX_SESSIONS; u8Index++)
+    {
+        _TerminalClose(&_stTerminal.astSession[u8Index]);
+    }
+    close(_stTerminal.nListenSock);
+    vTaskDelete(NULL);
+}
+
+/**
+ * @fn      bool _TerminalListen(void)
+ * @brief   Create the listening socket
+ * @return  Status
+ * @retval  true  = OK
+ * @retval  false = Error
+ */
+static bool _TerminalListen(void)
+{
+    struct sockaddr_in stDestAddr;
+    int                nSockOpt = 1;
 
     stDestAddr.sin_addr.s_addr = htonl(INADDR_ANY);
     stDestAddr.sin_family      = AF_INET;
     stDestAddr.sin_port        = htons(TERMINAL_PORT);
-    nAddrFamily                = AF_INET;
-    nIPProtocol                = IPPROTO_IP;
-    inet_ntoa_r(stDestAddr.sin_addr, acAddrStr, sizeof(acAddrStr) - 1);
 
-    nListenSock = socket(nAddrFamily, SOCK_STREAM, nIPProtocol);
-    if (0 > nListenSock)
+    _stTerminal.nListenSock = socket(AF_INET, SOCK_STREAM, IPPROTO_IP);
+    if (0 > _stTerminal.nListenSock)
     {
         ESP_LOGE("Term", "Unable to create socket: errno %d", errno);
+        return false;
     }
-    else
-    {
-        ESP_LOGI("Term", "Socket created successfully.");
-    }
+    ESP_LOGI("Term", "Socket created successfully.");
 
-    if (0 > setsockopt(nListenSock, SOL_SOCKET, SO_REUSEADDR, &nSockOpt, sizeof(int)))
+    if (0 > setsockopt(_stTerminal.nListenSock, SOL_SOCKET, SO_REUSEADDR, &nSockOpt, sizeof(int)))
     {
         ESP_LOGE("Term", "Unable to set socket option: errno %d", errno);
     }
+    fcntl(_stTerminal.nListenSock, F_SETFL, fcntl(_stTerminal.nListenSock, F_GETFL, 0) | O_NONBLOCK);
 
-    nErr = bind(nListenSock, (struct sockaddr*)&stDestAddr, sizeof(stDestAddr));
-    if (0 != nErr)
+    if (0 != bind(_stTerminal.nListenSock, (struct sockaddr*)&stDestAddr, sizeof(stDestAddr)))
     {
         ESP_LOGE("Term", "Couldn't bind name to socket: errno %d", errno);
+        close(_stTerminal.nListenSock);
+        return false;
     }
-    else
+    ESP_LOGI("Term", "Name successfully bound to socket.");
+
+    if (0 != listen(_stTerminal.nListenSock, TERMINAL_MAX_SESSIONS))
     {
-        ESP_LOGI("Term", "Name successfully bound to socket.");
+        ESP_LOGE("Term", "Error occured during listen: errno %d", errno);
+        close(_stTerminal.nListenSock);
+        return false;
     }
+    ESP_LOGI("Term", "Listening.");
 
-    _stTerminal.bIsRunning = true;
-    while (_stTerminal.bIsRunning)
+    return true;
+}
+
+/**
+ * @fn     void _TerminalAccept(void)
+ * @brief  Accept a pending connection
+ */
+static void _TerminalAccept(void)
+{
+    struct sockaddr_in stSourceAddr;
+    socklen_t          uAddrLen = sizeof(stSourceAddr);
+    int                nSock;
+    char*              pacGreeting =
+        "   ____ _  __ ____ ____       ____ ___\r\n"
+        "  / __// |/ // __// __/___   /  _// _ \\\r\n"
+        " _\\ \\ /    // _/ _\\ \\ / _ \\ _/ / / ___/\r\n"
+        "/___//_/|_//___//___/ \\___//___//_/\r\n"
+        "  Connection established.\r\n";
+    char*              pacBusy = "Too many connections.\r\n";
+
+    nSock = accept(_stTerminal.nListenSock, (struct sockaddr*)&stSourceAddr, &uAddrLen);
+    if (0 > nSock)
+    {
+        if (EAGAIN != errno && EWOULDBLOCK != errno)
+        {
+            ESP_LOGE("Term", "Unable to accept connection: errno %d", errno);
+        }
+        return;
+    }
+    fcntl(nSock, F_SETFL, fcntl(nSock, F_GETFL, 0) | O_NONBLOCK);
+
+    for (uint8_t u8Index = 0; u8Index < TERMINAL_MAX_SESSIONS; u8Index++)
     {
-        struct sockaddr_in stSourceAddr;
-        uint uAddrLen;
-        int  nSock;
+        TerminalSession* pstSession = &_stTerminal.astSession[u8Index];
 
-        nErr = listen(nListenSock, 1);
-        if (0 != nErr)
+        if (-1 == pstSession->nSock)
         {
-            ESP_LOGE("Term", "Error occured during listen: errno %d", errno);
-            break;
+            pstSession->nSock   = nSock;
+            pstSession->stAddr  = stSourceAddr;
+            pstSession->u8RxLen = 0;
+
+            ESP_LOGI("Term", "Connection established");
+            send(nSock, pacGreeting, strlen(pacGreeting), 0);
+            return;
         }
-        else
+    }
+
+    ESP_LOGI("Term", "Connection refused, all sessions in use.");
+    send(nSock, pacBusy, strlen(pacBusy), 0);
+    shutdown(nSock, 0);
+    close(nSock);
+}
+
+/**
+ * @fn       void _TerminalReceive(TerminalSession* pstSession)
+ * @brief    Receive and execute commands
+ * @details  Commands are terminated by CR and/or LF and may arrive
+ *           split across several segments.
+ * @param    pstSession
+ *           Terminal connection
+ */
+static void _TerminalReceive(TerminalSession* pstSession)
+{
+    char*   pacLine;
+    uint8_t u8Start = 0;
+    int     nLen;
+
+    if (pstSession->u32MovieLeft > 0)
+    {
+        _TerminalReceiveMovie(pstSession);
+        return;
+    }
+
+    nLen = recv(pstSession->nSock,
+                &pstSession->acRxBuffer[pstSession->u8RxLen],
+                sizeof(pstSession->acRxBuffer) - 1 - pstSession->u8RxLen, 0);
+    // Error occured during receiving.
+    if (nLen < 0)
+    {
+        if (EAGAIN != errno && EWOULDBLOCK != errno)
         {
-            ESP_LOGI("Term", "Listening.");
+            ESP_LOGE("Term", "recv failed: errno %d", errno);
+            _TerminalClose(pstSession);
         }
+        return;
+    }
+    // Connection closed.
+    else if (nLen == 0)
+    {
+        ESP_LOGI("Term", "Connection closed");
+        _TerminalClose(pstSession);
+        return;
+    }
+
+    pstSession->u8RxLen += (uint8_t)nLen;
+    for (uint8_t u8Index = 0; u8Index < pstSession->u8RxLen; u8Index++)
+    {
+        char cChar = pstSession->acRxBuffer[u8Index];
 
-        uAddrLen = sizeof(stSourceAddr);
-        nSock    = accept(nListenSock, (struct sockaddr*)&stSourceAddr, &uAddrLen);
-        if (0 > nSock)
+        if ('\r' != cChar && '\n' != cChar)
         {
-            ESP_LOGE("Term", "Unable to accept connection: errno %d", errno);
-            break;
+            continue;
         }
-        else
+
+        pstSession->acRxBuffer[u8Index] = 0;
+        pacLine = &pstSession->acRxBuffer[u8Start];
+        u8Start = u8Index + 1;
+        if (0 != *pacLine)
         {
-            char* pacGreeting =
-                "   ____ _  __ ____ ____       ____ ___\r\n"
-                "  / __// |/ // __// __/___   /  _// _ \\\r\n"
-                " _\\ \\ /    // _/ _\\ \\ / _ \\ _/ / / ___/\r\n"
-                "/___//_/|_//___//___/ \\___//___//_/\r\n"
-                "  Connection established.\r\n";
+            _TerminalCommand(pstSession, pacLine);
+            if (-1 == pstSession->nSock)
+            {
+                // Handed over to the input stream or the bulk pipe.
+                return;
+            }
+            if (pstSession->u32MovieLeft > 0)
+            {
+                // The host waits for the reply before sending the movie.
+                pstSession->u8RxLen = 0;
+                return;
+            }
+        }
+    }
 
-            ESP_LOGI("Term", "Connection established");
+    pstSession->u8RxLen -= u8Start;
+    memmove(pstSession->acRxBuffer, &pstSession->acRxBuffer[u8Start], pstSession->u8RxLen);
 
-            send(nSock, pacGreeting, strlen(pacGreeting), 0);
-            _stTerminal.bHostConnected = true;
+    // Discard overlong lines.
+    if (pstSession->u8RxLen >= sizeof(pstSession->acRxBuffer) - 1)
+    {
+        pstSession->u8RxLen = 0;
+    }
+}
+
+/**
+ * @fn       void _TerminalReceiveMovie(TerminalSession* pstSession)
+ * @brief    Receive the next part of a movie upload
+ * @details  Only as much is read as fits into the movie buffer; the
+ *           rest stays in the socket and holds up the host.
+ * @param    pstSession
+ *           Terminal connection
+ */
+static void _TerminalReceiveMovie(TerminalSession* pstSession)
+{
+    uint8_t au8Buffer[256];
+    size_t  uSize = GetMovieFree();
+    int     nLen;
+
+    if (uSize > sizeof(au8Buffer))
+    {
+        uSize = sizeof(au8Buffer);
+    }
+    if (uSize > pstSession->u32MovieLeft)
+    {
+        uSize = pstSession->u32MovieLeft;
+    }
+    if (0 == uSize)
+    {
+        return;
+    }
+
+    nLen = recv(pstSession->nSock, au8Buffer, uSize, 0);
+    if (nLen < 0)
+    {
+        if (EAGAIN != errno && EWOULDBLOCK != errno)
+        {
+            ESP_LOGE("Term", "recv failed: errno %d", errno);
+            _TerminalClose(pstSession);
         }
+        return;
+    }
+    else if (nLen == 0)
+    {
+        ESP_LOGI("Term", "Connection closed during movie upload");
+        _TerminalClose(pstSession);
+        return;
+    }
 
-        while (_stTerminal.bIsRunning)
+    PushMovie(au8Buffer, (size_t)nLen);
+    pstSession->u32MovieLeft -= (uint32_t)nLen;
+    if (0 == pstSession->u32MovieLeft)
+    {
+        char* pacDone = "Movie received\r\n";
+        send(pstSession->nSock, pacDone, strlen(pacDone), 0);
+    }
+}
+
+/**
+ * @fn     void _TerminalClose(TerminalSession* pstSession)
+ * @brief  Close a terminal connection, if any
+ * @param  pstSession
+ *         Terminal connection
+ */
+static void _TerminalClose(TerminalSession* pstSession)
+{
+    if (-1 == pstSession->nSock)
+    {
+        return;
+    }
+    // An incomplete movie would end in a stream of underruns.
+    if (pstSession->u32MovieLeft > 0)
+    {
+        StopMovie();
+    }
+    ESP_LOGI("Term", "Shutting down socket.");
+    shutdown(pstSession->nSock, 0);
+    close(pstSession->nSock);
+    pstSession->nSock        = -1;
+    pstSession->u8RxLen      = 0;
+    pstSession->u32MovieLeft = 0;
+}
+
+/**
+ * @fn     void _TerminalCommand(TerminalSession* pstSession, char* pacLine)
+ * @brief  Execute a command
+ * @param  pstSession
+ *         Terminal connection
+ * @param  pacLine
+ *         Null-terminated command line
+ */
+static void _TerminalCommand(TerminalSession* pstSession, char* pacLine)
+{
+    char acAddrStr[16];
+
+    inet_ntoa_r(pstSession->stAddr.sin_addr, acAddrStr, sizeof(acAddrStr) - 1);
+    ESP_LOGI("Term", "Received from %s: %s", acAddrStr, pacLine);
+
+    // Parse commands.
+    if (_CheckCommand(pacLine, "version"))
+    {
+        char* pacVersion = VERSION;
+        send(pstSession->nSock, pacVersion, strlen(pacVersion), 0);
+    }
+    else if (_CheckCommand(pacLine, "input"))
+    {
+        uint16_t u16InputData    = GetSNESInputData();
+        uint8_t  u8Index         = 15;
+        char     acInputData[19] = { 0 };
+        for (uint8_t u8Bit = 0; u8Bit < 16; u8Bit++)
         {
-            int nLen = recv(nSock, acRxBuffer, sizeof(acRxBuffer) - 1, 0);
-            // Error occured during receiving.
-            if (nLen < 0)
+            if ((u16InputData >> u8Bit) & 1)
             {
-                ESP_LOGE("Term", "recv failed: errno %d", errno);
-                break;
+                acInputData[u8Index] = '1';
             }
-            // Connection closed.
-            else if (nLen == 0)
+            else
             {
-                ESP_LOGI("Term", "Connection closed");
-                break;
+                acInputData[u8Index] = '0';
+            }
+            u8Index--;
+        }
+
+        acInputData[16] = '\r';
+        acInputData[17] = '\n';
+        send(pstSession->nSock, acInputData, strlen(acInputData), 0);
+    }
+    else if (_CheckCommand(pacLine, "server"))
+    {
+        char         acAddr[16] = { 0 };
+        unsigned int uPort      = 0;
+        char*        pacReply   = "Usage: server <addr> <port>\r\n";
+
+        if (2 == sscanf(pacLine, "server %15s %u", acAddr, &uPort) && uPort > 0 && uPort <= 0xffff)
+        {
+            if (SetExchangeServer(acAddr, (uint16_t)uPort))
+            {
+                pacReply = "OK\r\n";
             }
-            // Data received.
             else
             {
-                // Get the sender's IP address as string.
-                inet_ntoa_r(
-                    ((struct sockaddr_in *)&stSourceAddr)->sin_addr.s_addr,
-                    acAddrStr, sizeof(acAddrStr) - 1);
-
-                // Null-terminate whatever we received and treat like a string.
-                acRxBuffer[nLen] = 0;
-                if (nLen > 2)
-                {
-                    ESP_LOGI("Term", "Received %d bytes from %s: %s", nLen, acAddrStr, acRxBuffer);
-                }
+                pacReply = "Failed\r\n";
+            }
+        }
+        send(pstSession->nSock, pacReply, strlen(pacReply), 0);
+    }
+    else if (_CheckCommand(pacLine, "latency"))
+    {
+        SNESLatencyStats stLatency;
+        char             acLatency[192];
 
-                // Parse commands.
-                if (_CheckCommand(acRxBuffer, "version"))
-                {
-                    char* pacVersion = VERSION;
-                    send(nSock, pacVersion, strlen(pacVersion), 0);
-                }
-                else if (_CheckCommand(acRxBuffer, "input"))
+        GetSNESLatencyStats(&stLatency);
+        snprintf(acLatency, sizeof(acLatency),
+                 "capture-to-latch p50 %u p99 %u us\r\n"
+                 "capture-to-wire  p50 %u p99 %u us (%u)\r\n"
+                 "wire-to-latch    p50 %u p99 %u us (%u)\r\n",
+                 stLatency.u32CaptureToLatchP50, stLatency.u32CaptureToLatchP99,
+                 stLatency.u32CaptureToWireP50,  stLatency.u32CaptureToWireP99,
+                 stLatency.u32CaptureToWireCount,
+                 stLatency.u32WireToLatchP50,    stLatency.u32WireToLatchP99,
+                 stLatency.u32WireToLatchCount);
+        send(pstSession->nSock, acLatency, strlen(acLatency), 0);
+    }
+    else if (_CheckCommand(pacLine, "clock"))
+    {
+        ClockSyncStats  stClock;
+        SNESRemoteStats stRemote;
+        char            acClock[256];
+
+        GetNetplayClockStats(&stClock);
+        GetSNESRemoteStats(&stRemote);
+        snprintf(acClock, sizeof(acClock),
+                 "offset %lld us, drift %d ppb (%u samples, %u steps)\r\n"
+                 "frame skew %d ppm, latch-to-rx %u us, slack %d us\r\n"
+                 "delay %u frames, %u slips: %u inserted, %u dropped\r\n",
+                 (long long)stClock.s64Offset, stClock.s32DriftPpb,
+                 stClock.u32Samples, stClock.u32Steps,
+                 stClock.s32FrameSkewPpm, stClock.u32LatchToRx, stClock.s32Slack,
+                 GetSNESRemoteDelay(), stClock.u32Slips,
+                 stRemote.u32Inserted, stRemote.u32Dropped);
+        send(pstSession->nSock, acClock, strlen(acClock), 0);
+    }
+    else if (_CheckCommand(pacLine, "stream"))
+    {
+        TerminalStreamMode eMode   = TERMINAL_STREAM_CHANGES;
+        char*              pacBusy = "Busy\r\n";
+
+        if (_CheckCommand(pacLine, "stream frames"))
+        {
+            eMode = TERMINAL_STREAM_FRAMES;
+        }
+
+        // The connection is no longer served by the terminal.
+        if (AddTerminalStream(pstSession->nSock, eMode))
+        {
+            pstSession->nSock = -1;
+            return;
+        }
+        send(pstSession->nSock, pacBusy, strlen(pacBusy), 0);
+    }
+    else if (_CheckCommand(pacLine, "bulk"))
+    {
+        char* pacBusy = "Busy\r\n";
+
+        // Raw data for the SNES follows the reply.
+        if (AddTerminalBulk(pstSession->nSock))
+        {
+            pstSession->nSock = -1;
+            return;
+        }
+        send(pstSession->nSock, pacBusy, strlen(pacBusy), 0);
+    }
+    else if (_CheckCommand(pacLine, "stats"))
+    {
+        _TerminalStats(pstSession->nSock);
+    }
+    else if (_CheckCommand(pacLine, "movie"))
+    {
+        _TerminalMovie(pstSession, pacLine);
+    }
+    else if (_CheckCommand(pacLine, "wifi"))
+    {
+        _TerminalWiFi(pstSession->nSock, pacLine);
+    }
+    else if (_CheckCommand(pacLine, "jitter"))
+    {
+        _TerminalJitter(pstSession->nSock, pacLine);
+    }
+    else if (_CheckCommand(pacLine, "trace"))
+    {
+        _TerminalTrace(pstSession->nSock, pacLine);
+    }
+}
+
+/**
+ * @fn       void _TerminalStats(int nSock)
+ * @brief    Send runtime statistics
+ * @details  Core is the core a task is pinned to, "-" if it may run
+ *           on both.  CPU time is given as share of one core since the
+ *           previous "stats" command, or since start-up for the first
+ *           one; the run-time counters wrap after about 71 minutes.
+ *           Stack high-water marks are the least free stack space
+ *           ever seen in bytes.
+ * @param    nSock
+ *           Terminal connection
+ */
+static void _TerminalStats(int nSock)
+{
+    SNESCaptureStats  stCapture;
+    SNESLatchStats    stLatch;
+    SNESPortStats     astPort[SNES_NUM_PORTS];
+    NetplayStats      stNetplay;
+    SNESBulkStats     stBulk;
+    SNESUpstreamStats stUpstream;
+    uint32_t          u32TotalTime = 0;
+    UBaseType_t       uTasks;
+    char              acLine[160];
+
+    uTasks = uxTaskGetSystemState(_stTerminal.astTask, TERMINAL_STATS_TASKS, &u32TotalTime);
+    snprintf(acLine, sizeof(acLine), "task             core prio   cpu%%  stack\r\n");
+    send(nSock, acLine, strlen(acLine), 0);
+    for (UBaseType_t uIndex = 0; uIndex < uTasks; uIndex++)
+    {
+        TaskStatus_t* pstTask     = &_stTerminal.astTask[uIndex];
+        uint32_t      u32RunTime  = pstTask->ulRunTimeCounter;
+        uint32_t      u32Window   = u32TotalTime - _stTerminal.u32TotalTimePrev;
+        uint32_t      u32Permille = 0;
+        BaseType_t    xCore       = xTaskGetAffinity(pstTask->xHandle);
+        char          cCore       = '-';
+
+        for (UBaseType_t uPrev = 0; uPrev < _stTerminal.uTasksPrev; uPrev++)
+        {
+            if (_stTerminal.astTaskPrev[uPrev].xHandle == pstTask->xHandle)
+            {
+                u32RunTime -= _stTerminal.astTaskPrev[uPrev].ulRunTimeCounter;
+                break;
+            }
+        }
+        if (u32Window > 0)
+        {
+            u32Permille = (uint32_t)((uint64_t)u32RunTime * 1000 / u32Window);
+        }
+        if (tskNO_AFFINITY != xCore)
+        {
+            cCore = (char)('0' + xCore);
+        }
+        snprintf(acLine, sizeof(acLine), "%-16s %4c %4u %4u.%u %6u\r\n",
+                 pstTask->pcTaskName, cCore, (unsigned)pstTask->uxCurrentPriority,
+                 u32Permille / 10, u32Permille % 10,
+                 (unsigned)pstTask->usStackHighWaterMark);
+        send(nSock, acLine, strlen(acLine), 0);
+    }
+    if (0 == uTasks)
+    {
+        snprintf(acLine, sizeof(acLine), "(more than %u tasks)\r\n", TERMINAL_STATS_TASKS);
+        send(nSock, acLine, strlen(acLine), 0);
+    }
+    memcpy(_stTerminal.astTaskPrev, _stTerminal.astTask, sizeof(_stTerminal.astTask));
+    _stTerminal.uTasksPrev       = uTasks;
+    _stTerminal.u32TotalTimePrev = u32TotalTime;
+
+    GetSNESCaptureStats(&stCapture);
+    GetSNESLatchStats(&stLatch);
+    for (uint8_t u8Port = 0; u8Port < SNES_NUM_PORTS; u8Port++)
+    {
+        GetSNESPortStats(u8Port, &astPort[u8Port]);
+    }
+    GetNetplayStats(&stNetplay);
+    GetSNESBulkStats(&stBulk);
+    GetSNESUpstreamStats(&stUpstream);
+
+    snprintf(acLine, sizeof(acLine),
+             "heap %u bytes free, %u min\r\n"
+             "rssi %d dBm\r\n",
+             esp_get_free_heap_size(), esp_get_minimum_free_heap_size(),
+             GetWiFiRSSI());
+    send(nSock, acLine, strlen(acLine), 0);
+
+    snprintf(acLine, sizeof(acLine),
+             "boot nvs %u, snes %u, wifi %u, ip %u, exchange %u ms\r\n",
+             GetBootStageMs(BOOT_STAGE_NVS), GetBootStageMs(BOOT_STAGE_SNES),
+             GetBootStageMs(BOOT_STAGE_WIFI), GetBootStageMs(BOOT_STAGE_IP),
+             GetBootStageMs(BOOT_STAGE_EXCHANGE));
+    send(nSock, acLine, strlen(acLine), 0);
+
+    snprintf(acLine, sizeof(acLine),
+             "spi queue errors %u/%u, missed latches %u/%u, events lost %u\r\n",
+             astPort[0].u32QueueErrors, astPort[1].u32QueueErrors,
+             astPort[0].u32MissedLatches, astPort[1].u32MissedLatches,
+             stLatch.u32EventsLost);
+    send(nSock, acLine, strlen(acLine), 0);
+
+    snprintf(acLine, sizeof(acLine),
+             "read latency %u us (max %u), jitter %u us (max %u), timeouts %u\r\n",
+             stCapture.u32LatencyAvg, stCapture.u32LatencyMax,
+             stCapture.u32JitterLast, stCapture.u32JitterMax,
+             stCapture.u32Timeouts);
+    send(nSock, acLine, strlen(acLine), 0);
+
+    snprintf(acLine, sizeof(acLine),
+             "exchange rtt %u us\r\n"
+             "netplay rtt %u us (var %u), %u sent, %u received, %u lost\r\n",
+             GetExchangeRTT(),
+             stNetplay.u32RTTSmooth, stNetplay.u32RTTVar,
+             stNetplay.u32TxPackets, stNetplay.u32RxPackets, stNetplay.u32Lost);
+    send(nSock, acLine, strlen(acLine), 0);
+
+    snprintf(acLine, sizeof(acLine),
+             "bulk %s, %u blocks, %u bytes, %u acks, %u stalls\r\n",
+             IsSNESBulkMode() ? "on" : "off",
+             stBulk.u32Blocks, stBulk.u32Bytes, stBulk.u32Acks, stBulk.u32Stalls);
+    send(nSock, acLine, strlen(acLine), 0);
+
+    snprintf(acLine, sizeof(acLine),
+             "upstream %u frames, %u bytes, errors %u coding, %u crc, %u overflows\r\n",
+             stUpstream.u32Frames, stUpstream.u32Bytes,
+             stUpstream.u32CodingErrors, stUpstream.u32CRCErrors, stUpstream.u32Overflows);
+    send(nSock, acLine, strlen(acLine), 0);
+}
+
+/**
+ * @fn       void _TerminalMovie(TerminalSession* pstSession, char* pacLine)
+ * @brief    Upload, stop or report an input movie
+ * @details  "movie <ports> <frames>" loads a movie; once the host has
+ *           read the reply, it sends frames * ports * 2 bytes of movie
+ *           data as described in MoviePlayer.c.  The upload may take
+ *           as long as the playback.  "movie stop" returns the ports
+ *           to the controller, "movie" alone reports the playback.
+ * @param    pstSession
+ *           Terminal connection
+ * @param    pacLine
+ *           Command line
+ */
+static void _TerminalMovie(TerminalSession* pstSession, char* pacLine)
+{
+    unsigned int uPorts  = 0;
+    unsigned int uFrames = 0;
+    char         acReply[192];
+
+    if (_CheckCommand(pacLine, "movie stop"))
+    {
+        StopMovie();
+        snprintf(acReply, sizeof(acReply), "OK\r\n");
+    }
+    else if (2 == sscanf(pacLine, "movie %u %u", &uPorts, &uFrames))
+    {
+        if (uFrames > 0 && uFrames <= 0x3fffffff / MOVIE_MAX_PORTS && StartMovie((uint8_t)uPorts, uFrames))
+        {
+            // Only one upload at a time, the others lost their movie.
+            for (uint8_t u8Index = 0; u8Index < TERMINAL_MAX_SESSIONS; u8Index++)
+            {
+                TerminalSession* pstOther = &_stTerminal.astSession[u8Index];
+
+                if (pstOther != pstSession && pstOther->u32MovieLeft > 0)
                 {
-                    uint16_t u16InputData    = GetSNESInputData();
-                    uint8_t  u8Index         = 15;
-                    char     acInputData[18] = { 0 };
-                    for (uint8_t u8Bit = 0; u8Bit < 16; u8Bit++)
-                    {
-                        if ((u16InputData >> u8Bit) & 1)
-                        {
-                            acInputData[u8Index] = '1';
-                        }
-                        else
-                        {
-                            acInputData[u8Index] = '0';
-                        }
-                        u8Index--;
-                    }
-
-                    acInputData[16] = '\r';
-                    acInputData[17] = '\n';
-                    send(nSock, acInputData, strlen(acInputData), 0);
+                    pstOther->u32MovieLeft = 0;
+                    _TerminalClose(pstOther);
                 }
             }
+            pstSession->u32MovieLeft = uFrames * uPorts * 2;
+            snprintf(acReply, sizeof(acReply), "OK\r\n");
+        }
+        else
+        {
+            snprintf(acReply, sizeof(acReply), "Usage: movie <1|2> <frames>\r\n");
         }
+    }
+    else
+    {
+        MovieStats stMovie;
 
-        _stTerminal.bHostConnected = false;
-        if (-1 != nSock)
+        GetMovieStats(&stMovie);
+        snprintf(acReply, sizeof(acReply),
+                 "%s, frame %u of %u (%u received)\r\n"
+                 "%u latches, %u repeats, %u underruns, %u gaps, %u missed\r\n",
+                 IsMovieActive() ? "playing" : "stopped",
+                 stMovie.u32Played, stMovie.u32Frames, stMovie.u32Received,
+                 stMovie.u32Latches, stMovie.u32Repeats,
+                 stMovie.u32Underruns, stMovie.u32Gaps, stMovie.u32Missed);
+    }
+    send(pstSession->nSock, acReply, strlen(acReply), 0);
+}
+
+/**
+ * @fn       void _TerminalWiFi(int nSock, char* pacLine)
+ * @brief    Report or change the WiFi connection data
+ * @details  "wifi ip <addr> <mask> <gw>" sets a static address,
+ *           "wifi ip lease" keeps the last DHCP lease as static
+ *           address, "wifi ip dhcp" returns to DHCP; all take effect
+ *           with the next connection.  "wifi forget" erases the stored
+ *           network.  "wifi" alone reports the connection.
+ * @param    nSock
+ *           Terminal connection
+ * @param    pacLine
+ *           Command line
+ */
+static void _TerminalWiFi(int nSock, char* pacLine)
+{
+    WiFiInfo stInfo;
+    char     acAddr[3][16];
+    char     acReply[320];
+    bool     bStored;
+
+    GetWiFiInfo(&stInfo);
+
+    if (_CheckCommand(pacLine, "wifi ip dhcp"))
+    {
+        bStored = SetWiFiAddress(0, 0, 0);
+        snprintf(acReply, sizeof(acReply), bStored ? "OK\r\n" : "Failed\r\n");
+    }
+    else if (_CheckCommand(pacLine, "wifi ip lease"))
+    {
+        bStored = 0 != stInfo.u32IP && SetWiFiAddress(stInfo.u32IP, stInfo.u32Mask, stInfo.u32GW);
+        snprintf(acReply, sizeof(acReply), bStored ? "OK\r\n" : "Failed\r\n");
+    }
+    else if (_CheckCommand(pacLine, "wifi ip"))
+    {
+        if (3 == sscanf(pacLine, "wifi ip %15s %15s %15s", acAddr[0], acAddr[1], acAddr[2]) &&
+            INADDR_NONE != inet_addr(acAddr[0]) && INADDR_NONE != inet_addr(acAddr[2]))
+        {
+            bStored = SetWiFiAddress(inet_addr(acAddr[0]), inet_addr(acAddr[1]), inet_addr(acAddr[2]));
+            snprintf(acReply, sizeof(acReply), bStored ? "OK\r\n" : "Failed\r\n");
+        }
+        else
         {
-            ESP_LOGI("Term", "Shutting down socket and restarting.");
-            shutdown(nSock, 0);
-            close(nSock);
+            snprintf(acReply, sizeof(acReply), "Usage: wifi ip <addr> <mask> <gw>|lease|dhcp\r\n");
         }
     }
+    else if (_CheckCommand(pacLine, "wifi forget"))
+    {
+        snprintf(acReply, sizeof(acReply), ForgetWiFi() ? "OK\r\n" : "Failed\r\n");
+    }
+    else
+    {
+        struct in_addr stAddr;
 
-    vTaskDelete(NULL);
+        stAddr.s_addr = stInfo.u32IP;
+        inet_ntoa_r(stAddr, acAddr[0], sizeof(acAddr[0]));
+        stAddr.s_addr = stInfo.u32Mask;
+        inet_ntoa_r(stAddr, acAddr[1], sizeof(acAddr[1]));
+        stAddr.s_addr = stInfo.u32GW;
+        inet_ntoa_r(stAddr, acAddr[2], sizeof(acAddr[2]));
+
+        snprintf(acReply, sizeof(acReply),
+                 "%s, ready after %u ms (%s), last connect %u ms\r\n"
+                 "ssid %s, bssid %02x:%02x:%02x:%02x:%02x:%02x, channel %u, rssi %d dBm\r\n"
+                 "ip %s mask %s gw %s (%s)\r\n"
+                 "%u direct (%u failed), %u scans (%u failed), %u smartconfig, %u lost\r\n",
+                 WiFiConnectStateName(stInfo.eState), stInfo.stStats.u32ReadyMs,
+                 WiFiConnectStateName(stInfo.stStats.eReadyPath), stInfo.stStats.u32ConnectMs,
+                 stInfo.acSSID,
+                 stInfo.au8BSSID[0], stInfo.au8BSSID[1], stInfo.au8BSSID[2],
+                 stInfo.au8BSSID[3], stInfo.au8BSSID[4], stInfo.au8BSSID[5],
+                 stInfo.u8Channel, GetWiFiRSSI(),
+                 acAddr[0], acAddr[1], acAddr[2], stInfo.bStaticIP ? "static" : "dhcp",
+                 stInfo.stStats.u32Fast, stInfo.stStats.u32FastFails,
+                 stInfo.stStats.u32Scans, stInfo.stStats.u32ScanFails,
+                 stInfo.stStats.u32SmartConfig, stInfo.stStats.u32Lost);
+    }
+    send(nSock, acReply, strlen(acReply), 0);
+}
+
+/**
+ * @fn       void _TerminalJitter(int nSock, char* pacLine)
+ * @brief    Start or report the jitter benchmark
+ * @details  "jitter <seconds> [<addr> <port>]" starts the benchmark,
+ *           with a UDP load to the given host if any, see
+ *           JitterBench.c.  "jitter" alone reports the running or
+ *           the last benchmark as histogram.
+ * @param    nSock
+ *           Terminal connection
+ * @param    pacLine
+ *           Command line
+ */
+static void _TerminalJitter(int nSock, char* pacLine)
+{
+    JitterBenchResult    stResult;
+    SNESTimingHistogram* pstTiming  = &stResult.stTiming;
+    char                 acAddr[16] = { 0 };
+    unsigned int         uSeconds   = 0;
+    unsigned int         uPort      = 0;
+    uint32_t             u32Target  = 0;
+    char                 acLine[160];
+    int                  nArgs;
+
+    nArgs = sscanf(pacLine, "jitter %u %15s %u", &uSeconds, acAddr, &uPort);
+    if (nArgs >= 1)
+    {
+        char* pacReply = "OK\r\n";
+
+        if (3 == nArgs && uPort > 0 && uPort <= 0xffff && INADDR_NONE != inet_addr(acAddr))
+        {
+            u32Target = inet_addr(acAddr);
+        }
+        if ((1 != nArgs && 0 == u32Target) || ! StartJitterBench(uSeconds, u32Target, (uint16_t)uPort))
+        {
+            pacReply = "Usage: jitter <seconds> [<addr> <port>], one at a time\r\n";
+        }
+        send(nSock, pacReply, strlen(pacReply), 0);
+        return;
+    }
+
+    GetJitterBench(&stResult);
+    if (0 == stResult.u32Seconds)
+    {
+        snprintf(acLine, sizeof(acLine), "No benchmark run yet\r\n");
+        send(nSock, acLine, strlen(acLine), 0);
+        return;
+    }
+
+    if (0 != stResult.u32Target)
+    {
+        struct in_addr stAddr;
+
+        stAddr.s_addr = stResult.u32Target;
+        inet_ntoa_r(stAddr, acAddr, sizeof(acAddr));
+    }
+    else
+    {
+        snprintf(acAddr, sizeof(acAddr), "none");
+    }
+    snprintf(acLine, sizeof(acLine),
+             "%s, %u of %u s, load %s:%u, %u sent, %u rejected\r\n"
+             "%u captures, %u latch-sync wake-ups\r\n"
+             "    from us     jitter       wake       late\r\n",
+             stResult.bRunning ? "running" : "done",
+             stResult.u32Elapsed / 1000, stResult.u32Seconds,
+             acAddr, stResult.u16Port, stResult.u32Packets, stResult.u32Errors,
+             pstTiming->u32Captures, pstTiming->u32Wakes);
+    send(nSock, acLine, strlen(acLine), 0);
+
+    for (uint8_t u8Bucket = 0; u8Bucket < SNES_TIMING_BUCKETS; u8Bucket++)
+    {
+        snprintf(acLine, sizeof(acLine), "%10u %10u %10u %10u\r\n",
+                 0 == u8Bucket ? 0 : 1 << (u8Bucket - 1),
+                 pstTiming->au32Jitter[u8Bucket], pstTiming->au32Wake[u8Bucket],
+                 pstTiming->au32Late[u8Bucket]);
+        send(nSock, acLine, strlen(acLine), 0);
+    }
+
+    snprintf(acLine, sizeof(acLine), "       max %10u %10u %10u\r\n",
+             pstTiming->u32JitterMax, pstTiming->u32WakeMax, pstTiming->u32LateMax);
+    send(nSock, acLine, strlen(acLine), 0);
+}
+
+/**
+ * @fn       void _TerminalTrace(int nSock, char* pacLine)
+ * @brief    Control and dump the event trace
+ * @details  "trace start" clears and starts the trace, "trace stop"
+ *           freezes it, "trace dump" freezes it and sends it as binary
+ *           block, see TraceFormat.c.  "trace" alone reports its state.
+ * @param    nSock
+ *           Terminal connection
+ * @param    pacLine
+ *           Command line
+ */
+static void _TerminalTrace(int nSock, char* pacLine)
+{
+    char     acReply[80];
+    uint32_t u32Events;
+    uint32_t u32Lost;
+
+    if (_CheckCommand(pacLine, "trace start"))
+    {
+        StartTrace();
+        snprintf(acReply, sizeof(acReply), "OK\r\n");
+    }
+    else if (_CheckCommand(pacLine, "trace stop"))
+    {
+        StopTrace();
+        snprintf(acReply, sizeof(acReply), "OK\r\n");
+    }
+    else if (_CheckCommand(pacLine, "trace dump"))
+    {
+        StopTrace();
+        if (! _TerminalTraceDump(nSock))
+        {
+            ESP_LOGE("Term", "Trace dump incomplete");
+        }
+        return;
+    }
+    else
+    {
+        u32Events = GetTraceEvents(&u32Lost);
+        snprintf(acReply, sizeof(acReply), "%s, %u events, %u overwritten\r\n",
+                 IsTraceRunning() ? "running" : "stopped", u32Events, u32Lost);
+    }
+    send(nSock, acReply, strlen(acReply), 0);
+}
+
+/**
+ * @fn       bool _TerminalTraceDump(int nSock)
+ * @brief    Send the trace ring with the current task names
+ * @details  The other sessions wait until the dump has been sent or
+ *           TERMINAL_DUMP_MS have passed without progress.
+ * @param    nSock
+ *           Terminal connection
+ * @return   Status
+ * @retval   true  = Dump sent
+ * @retval   false = Connection lost or stalled
+ */
+static bool _TerminalTraceDump(int nSock)
+{
+    uint8_t     au8Buffer[TERMINAL_DUMP_EVENTS * TRACE_EVENT_SIZE];
+    TraceHeader stHeader;
+    TraceTask   stTask;
+    TraceEvent  stEvent;
+    UBaseType_t uTasks;
+    size_t      uLen;
+    int64_t     s64Deadline = esp_timer_get_time() + (int64_t)TERMINAL_DUMP_MS * 1000;
+
+    uTasks = uxTaskGetSystemState(_stTerminal.astTask, TERMINAL_STATS_TASKS, NULL);
+
+    stHeader.u8Version = TRACE_VERSION;
+    stHeader.u16Tasks  = (uint16_t)uTasks;
+    stHeader.u32Events = GetTraceEvents(&stHeader.u32Lost);
+    uLen = EncodeTraceHeader(&stHeader, au8Buffer, sizeof(au8Buffer));
+    if (! _TerminalSendAll(nSock, au8Buffer, uLen, s64Deadline))
+    {
+        return false;
+    }
+
+    for (UBaseType_t uIndex = 0; uIndex < uTasks; uIndex++)
+    {
+        stTask.u32Handle = (uint32_t)(uintptr_t)_stTerminal.astTask[uIndex].xHandle;
+        strncpy(stTask.acName, _stTerminal.astTask[uIndex].pcTaskName, TRACE_TASK_NAME);
+        stTask.acName[TRACE_TASK_NAME] = '\0';
+        uLen = EncodeTraceTask(&stTask, au8Buffer, sizeof(au8Buffer));
+        if (! _TerminalSendAll(nSock, au8Buffer, uLen, s64Deadline))
+        {
+            return false;
+        }
+    }
+
+    uLen = 0;
+    for (uint32_t u32Index = 0; u32Index < stHeader.u32Events; u32Index++)
+    {
+        // Only the terminal starts the trace, so the ring can't change.
+        GetTraceEvent(u32Index, &stEvent);
+        uLen += EncodeTraceEvent(&stEvent, &au8Buffer[uLen], sizeof(au8Buffer) - uLen);
+        if (sizeof(au8Buffer) == uLen || u32Index + 1 == stHeader.u32Events)
+        {
+            if (! _TerminalSendAll(nSock, au8Buffer, uLen, s64Deadline))
+            {
+                return false;
+            }
+            s64Deadline = esp_timer_get_time() + (int64_t)TERMINAL_DUMP_MS * 1000;
+            uLen        = 0;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @fn       bool _TerminalSendAll(int nSock, const uint8_t* pu8Data, size_t uSize, int64_t s64Deadline)
+ * @brief    Send a block on a non-blocking connection
+ * @param    nSock
+ *           Terminal connection
+ * @param    pu8Data
+ *           Data
+ * @param    uSize
+ *           Size of the data in bytes
+ * @param    s64Deadline
+ *           Time to give up at in µs
+ * @return   Status
+ * @retval   true  = Block sent
+ * @retval   false = Connection lost or deadline passed
+ */
+static bool _TerminalSendAll(int nSock, const uint8_t* pu8Data, size_t uSize, int64_t s64Deadline)
+{
+    size_t uSent = 0;
+
+    while (uSent < uSize)
+    {
+        int nLen = send(nSock, &pu8Data[uSent], uSize - uSent, MSG_DONTWAIT);
+        if (0 > nLen)
+        {
+            if ((EAGAIN != errno && EWOULDBLOCK != errno) || esp_timer_get_time() > s64Deadline)
+            {
+                return false;
+            }
+            vTaskDelay(TERMINAL_DUMP_RETRY_MS / portTICK_PERIOD_MS);
+            continue;
+        }
+        uSent += (size_t)nLen;
+    }
+
+    return true;
 }
 
 static bool _CheckCommand(char* pacRxBuffer, char* pacCommand)
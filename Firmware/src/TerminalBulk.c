@@ -0,0 +1,264 @@
+/**
+ * @file       TerminalBulk.c
+ * @brief      Bulk data pipe
+ * @ingroup    Firmware
+ * @details    A terminal connection that sent "bulk" is handed over to
+ *             this module.  The controller ports are switched to bulk
+ *             mode and everything the host sends from then on is
+ *             staged for the SNES as it is, see SNESBulk.c.  When the
+ *             staging buffer is full, the pipe stops reading from the
+ *             connection, so TCP flow control slows the host down to
+ *             the rate the SNES acknowledges blocks at.  In the other
+ *             direction, the payload of the SNES's upstream frames is
+ *             sent to the host, see SNESUpstream.c.  While the host
+ *             doesn't read, the upstream buffer fills up and the
+ *             credit announced to the SNES drops to zero.  Closing the
+ *             connection returns the ports to the controller.  Only
+ *             one pipe can be open at a time.
+ * @author     SNESoIP contributors
+ * @copyright  "THE BEER-WARE LICENCE" (Revision 42)
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "lwip/err.h"
+#include "lwip/sockets.h"
+#include "lwip/sys.h"
+#include "SNESBulk.h"
+#include "SNESUpstream.h"
+#include "Tasks.h"
+#include "TerminalBulk.h"
+
+#define TERMINAL_BULK_POLL_MS 10  // !< Max. time between two checks of the connection
+
+/**
+ * @struct  TerminalBulk
+ * @brief   Bulk data pipe data
+ */
+typedef struct TerminalBulk_t
+{
+    TaskHandle_t hTask;     ///< Pipe task
+    volatile int nSock;     ///< Connection, -1 = no pipe open
+    size_t       uDownLen;  ///< Bytes in au8Down not staged yet
+    size_t       uUpLen;    ///< Bytes in au8Up
+    size_t       uUpSent;   ///< Bytes of au8Up already sent
+
+    /// Data received from the host
+    uint8_t au8Down[TERMINAL_BULK_CHUNK];
+    /// Data received from the SNES
+    uint8_t au8Up[TERMINAL_BULK_CHUNK];
+
+} TerminalBulk;
+
+/**
+ * @var    _stPipe
+ * @brief  Bulk data pipe private data
+ */
+static TerminalBulk _stPipe;
+
+static void _TerminalBulkThread(void* pArg);
+static bool _TerminalBulkReceive(void);
+static bool _TerminalBulkForward(void);
+static bool _TerminalBulkIsClosed(void);
+static void _TerminalBulkRemove(void);
+
+/**
+ * @fn     void InitTerminalBulk(void)
+ * @brief  Initialise the bulk data pipe
+ */
+void InitTerminalBulk(void)
+{
+    memset(&_stPipe, 0, sizeof(struct TerminalBulk_t));
+    _stPipe.nSock = -1;
+
+    xTaskCreatePinnedToCore(
+        _TerminalBulkThread, "TermBulkThread", 2048, NULL,
+        TASK_PRIO_SERVICE, &_stPipe.hTask, TASK_CORE_NET);
+}
+
+/**
+ * @fn      bool AddTerminalBulk(int nSock)
+ * @brief   Hand a terminal connection over to the bulk data pipe
+ * @details Replies "OK" on the connection once the ports are in bulk
+ *          mode; the host may send data after the reply.
+ * @param   nSock
+ *          Connected socket, owned by the pipe on success
+ * @return  Status
+ * @retval  true  = Pipe opened
+ * @retval  false = Another pipe is open
+ */
+bool AddTerminalBulk(int nSock)
+{
+    char* pacOK = "OK\r\n";
+
+    if (-1 != _stPipe.nSock)
+    {
+        return false;
+    }
+
+    SetSNESBulkMode(true);
+    send(nSock, pacOK, strlen(pacOK), 0);
+
+    _stPipe.uDownLen = 0;
+    _stPipe.uUpLen   = 0;
+    _stPipe.uUpSent  = 0;
+    _stPipe.nSock    = nSock;
+    xTaskNotifyGive(_stPipe.hTask);
+
+    ESP_LOGI("Term", "Bulk pipe opened.");
+    return true;
+}
+
+/**
+ * @fn     void _TerminalBulkThread(void* pArg)
+ * @brief  Bulk data pipe thread
+ * @param  pArg
+ *         Unused
+ */
+static void _TerminalBulkThread(void* pArg)
+{
+    (void)pArg;
+
+    while (1)
+    {
+        if (-1 == _stPipe.nSock)
+        {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            continue;
+        }
+
+        if (0 == _stPipe.uDownLen)
+        {
+            if (! _TerminalBulkReceive())
+            {
+                _TerminalBulkRemove();
+                continue;
+            }
+        }
+        else if (_TerminalBulkIsClosed())
+        {
+            _TerminalBulkRemove();
+            continue;
+        }
+
+        if (! _TerminalBulkForward())
+        {
+            _TerminalBulkRemove();
+            continue;
+        }
+
+        if (_stPipe.uDownLen > 0)
+        {
+            if (WriteSNESBulk(_stPipe.au8Down, _stPipe.uDownLen, TERMINAL_BULK_POLL_MS / portTICK_PERIOD_MS))
+            {
+                _stPipe.uDownLen = 0;
+            }
+        }
+    }
+
+    vTaskDelete(NULL);
+}
+
+/**
+ * @fn      bool _TerminalBulkReceive(void)
+ * @brief   Wait up to TERMINAL_BULK_POLL_MS for data from the host
+ * @return  Status
+ * @retval  true  = Connection alive, au8Down may hold new data
+ * @retval  false = Connection closed or lost
+ */
+static bool _TerminalBulkReceive(void)
+{
+    struct timeval stTimeout;
+    fd_set         stReadSet;
+    int            nLen;
+
+    stTimeout.tv_sec  = 0;
+    stTimeout.tv_usec = TERMINAL_BULK_POLL_MS * 1000;
+    FD_ZERO(&stReadSet);
+    FD_SET(_stPipe.nSock, &stReadSet);
+
+    if (select(_stPipe.nSock + 1, &stReadSet, NULL, NULL, &stTimeout) <= 0)
+    {
+        return true;
+    }
+
+    nLen = recv(_stPipe.nSock, _stPipe.au8Down, sizeof(_stPipe.au8Down), MSG_DONTWAIT);
+    if (0 < nLen)
+    {
+        _stPipe.uDownLen = (size_t)nLen;
+        return true;
+    }
+
+    return 0 != nLen && (EAGAIN == errno || EWOULDBLOCK == errno);
+}
+
+/**
+ * @fn       bool _TerminalBulkForward(void)
+ * @brief    Send data received from the SNES to the host
+ * @details  Nothing more is taken from the upstream buffer until the
+ *           previous data has been sent completely.
+ * @return   Status
+ * @retval   true  = Connection alive
+ * @retval   false = Connection lost
+ */
+static bool _TerminalBulkForward(void)
+{
+    int nLen;
+
+    if (_stPipe.uUpSent == _stPipe.uUpLen)
+    {
+        _stPipe.uUpLen  = ReadSNESUpstream(_stPipe.au8Up, sizeof(_stPipe.au8Up), 0);
+        _stPipe.uUpSent = 0;
+        if (0 == _stPipe.uUpLen)
+        {
+            return true;
+        }
+    }
+
+    nLen = send(_stPipe.nSock,
+                &_stPipe.au8Up[_stPipe.uUpSent],
+                _stPipe.uUpLen - _stPipe.uUpSent,
+                MSG_DONTWAIT);
+    if (0 > nLen)
+    {
+        return EAGAIN == errno || EWOULDBLOCK == errno;
+    }
+
+    _stPipe.uUpSent += (size_t)nLen;
+    return true;
+}
+
+/**
+ * @fn       bool _TerminalBulkIsClosed(void)
+ * @brief    Check if the host hung up while the staging buffer is full
+ * @details  Peeks at the connection without consuming data, so a pipe
+ *           the SNES stopped reading from can still be closed.
+ */
+static bool _TerminalBulkIsClosed(void)
+{
+    uint8_t u8Byte;
+    int     nLen;
+
+    nLen = recv(_stPipe.nSock, &u8Byte, 1, MSG_PEEK | MSG_DONTWAIT);
+    return 0 == nLen || (0 > nLen && EAGAIN != errno && EWOULDBLOCK != errno);
+}
+
+/**
+ * @fn     void _TerminalBulkRemove(void)
+ * @brief  Close the pipe and return the ports to the controller
+ */
+static void _TerminalBulkRemove(void)
+{
+    SetSNESBulkMode(false);
+
+    shutdown(_stPipe.nSock, 0);
+    close(_stPipe.nSock);
+    _stPipe.nSock = -1;
+
+    ESP_LOGI("Term", "Bulk pipe closed.");
+}
@@ -0,0 +1,364 @@
+/**
+ * @file       TerminalStream.c
+ * @brief      Binary input stream
+ * @ingroup    Firmware
+ * @details    A terminal connection that sent "stream" is handed over
+ *             to this module and receives fixed-size records instead
+ *             of text.  All integers are in network byte order:
+ * @code{.unparsed}
+ *   | 0    | 1    | 2..3 | 4..7  | 8..11 |
+ *   | 0x53 | TYPE | WORD | FRAME | TIME  |
+ *
+ *   TYPE  'C' = controller word changed, TIME = capture time
+ *         'F' = word shifted out at a latch, TIME = latch time
+ *         'L' = records lost, FRAME = number of records dropped
+ *               for this subscriber since its last record
+ *   WORD  Controller word as returned by GetSNESInputData()
+ *   FRAME Console frame, i.e. port 0 latch count
+ *   TIME  Lower 32 bits of the adapter time in µs
+ * @endcode
+ *             The SNES driver posts its events to a queue without
+ *             waiting and the subscribers are written non-blocking,
+ *             so a slow monitor only loses its own records.  Closing
+ *             the connection ends the subscription.
+ * @author     SNESoIP contributors
+ * @copyright  "THE BEER-WARE LICENCE" (Revision 42)
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "lwip/err.h"
+#include "lwip/sockets.h"
+#include "lwip/sys.h"
+#include "SNES.h"
+#include "Tasks.h"
+#include "TerminalStream.h"
+
+#define TERMINAL_STREAM_POLL_MS 100  // !< Interval to check for closed subscribers
+
+/**
+ * @typedef  TerminalSubscriber
+ * @brief    Stream subscriber
+ * @struct   TerminalSubscriber_t
+ * @brief    Stream subscriber structure
+ */
+typedef struct TerminalSubscriber_t
+{
+    int                nSock;     ///< Connection, -1 = unused entry
+    TerminalStreamMode eMode;     ///< Records to send
+    uint32_t           u32Lost;   ///< Records dropped since the last one sent
+    uint8_t            u8Offset;  ///< Bytes of au8Pending already sent
+
+    /// Partially sent record
+    uint8_t au8Pending[TERMINAL_STREAM_RECORD_SIZE];
+
+} TerminalSubscriber;
+
+/**
+ * @struct  TerminalStream
+ * @brief   Binary input stream data
+ */
+typedef struct TerminalStream_t
+{
+    QueueHandle_t      hQueue;        ///< SNESInputEvent queue
+    SemaphoreHandle_t  hLock;         ///< Guards astSubscriber
+    uint8_t            u8Subscribers; ///< Entries in use
+
+    TerminalSubscriber astSubscriber[TERMINAL_STREAM_MAX];  ///< Subscribers
+
+} TerminalStream;
+
+/**
+ * @var    _stStream
+ * @brief  Binary input stream private data
+ */
+static TerminalStream _stStream;
+
+static void _TerminalStreamThread(void* pArg);
+static void _TerminalStreamSend(TerminalSubscriber* pstSub, const SNESInputEvent* pstEvent);
+static bool _TerminalStreamFlush(TerminalSubscriber* pstSub);
+static void _TerminalStreamPack(uint8_t* pu8Record, uint8_t u8Type, uint16_t u16Data, uint32_t u32Frame, uint32_t u32Time);
+static void _TerminalStreamCheckClosed(void);
+static void _TerminalStreamRemove(TerminalSubscriber* pstSub);
+
+/**
+ * @fn     void InitTerminalStream(void)
+ * @brief  Initialise the binary input stream
+ */
+void InitTerminalStream(void)
+{
+    memset(&_stStream, 0, sizeof(struct TerminalStream_t));
+    for (uint8_t u8Index = 0; u8Index < TERMINAL_STREAM_MAX; u8Index++)
+    {
+        _stStream.astSubscriber[u8Index].nSock = -1;
+    }
+
+    _stStream.hQueue = xQueueCreate(TERMINAL_STREAM_QUEUE_SIZE, sizeof(SNESInputEvent));
+    _stStream.hLock  = xSemaphoreCreateMutex();
+    xTaskCreatePinnedToCore(
+        _TerminalStreamThread, "TermStreamThread", 2048, NULL,
+        TASK_PRIO_SERVICE, NULL, TASK_CORE_NET);
+}
+
+/**
+ * @fn      bool AddTerminalStream(int nSock, TerminalStreamMode eMode)
+ * @brief   Hand a terminal connection over to the input stream
+ * @details Replies "OK" on the connection before the first record.
+ * @param   nSock
+ *          Connected socket, owned by the stream module on success
+ * @param   eMode
+ *          Records the subscriber receives
+ * @return  Status
+ * @retval  true  = Subscribed
+ * @retval  false = No free subscriber slot
+ */
+bool AddTerminalStream(int nSock, TerminalStreamMode eMode)
+{
+    char* pacOK  = "OK\r\n";
+    bool  bAdded = false;
+
+    xSemaphoreTake(_stStream.hLock, portMAX_DELAY);
+    for (uint8_t u8Index = 0; u8Index < TERMINAL_STREAM_MAX; u8Index++)
+    {
+        TerminalSubscriber* pstSub = &_stStream.astSubscriber[u8Index];
+
+        if (-1 == pstSub->nSock)
+        {
+            // Binary records follow the reply.
+            send(nSock, pacOK, strlen(pacOK), 0);
+
+            pstSub->nSock    = nSock;
+            pstSub->eMode    = eMode;
+            pstSub->u32Lost  = 0;
+            pstSub->u8Offset = TERMINAL_STREAM_RECORD_SIZE;
+            bAdded           = true;
+
+            // Only keep the driver busy while someone is listening.
+            _stStream.u8Subscribers++;
+            if (1 == _stStream.u8Subscribers)
+            {
+                xQueueReset(_stStream.hQueue);
+                SetSNESInputQueue(_stStream.hQueue);
+            }
+            break;
+        }
+    }
+    xSemaphoreGive(_stStream.hLock);
+
+    if (bAdded)
+    {
+        ESP_LOGI("Term", "Stream subscriber added (%s).",
+                 TERMINAL_STREAM_FRAMES == eMode ? "frames" : "changes");
+    }
+    return bAdded;
+}
+
+/**
+ * @fn     void _TerminalStreamThread(void* pArg)
+ * @brief  Binary input stream thread
+ * @param  pArg
+ *         Unused
+ */
+static void _TerminalStreamThread(void* pArg)
+{
+    SNESInputEvent stEvent;
+    TickType_t     u32LastCheck = xTaskGetTickCount();
+    (void)pArg;
+
+    while (1)
+    {
+        if (pdTRUE == xQueueReceive(_stStream.hQueue, &stEvent, TERMINAL_STREAM_POLL_MS / portTICK_PERIOD_MS))
+        {
+            xSemaphoreTake(_stStream.hLock, portMAX_DELAY);
+            for (uint8_t u8Index = 0; u8Index < TERMINAL_STREAM_MAX; u8Index++)
+            {
+                TerminalSubscriber* pstSub = &_stStream.astSubscriber[u8Index];
+
+                if (-1 == pstSub->nSock)
+                {
+                    continue;
+                }
+                if (stEvent.bLatch == (TERMINAL_STREAM_FRAMES == pstSub->eMode))
+                {
+                    _TerminalStreamSend(pstSub, &stEvent);
+                }
+            }
+            xSemaphoreGive(_stStream.hLock);
+        }
+
+        if ((xTaskGetTickCount() - u32LastCheck) >= TERMINAL_STREAM_POLL_MS / portTICK_PERIOD_MS)
+        {
+            u32LastCheck = xTaskGetTickCount();
+            _TerminalStreamCheckClosed();
+        }
+    }
+
+    vTaskDelete(NULL);
+}
+
+/**
+ * @fn       void _TerminalStreamSend(TerminalSubscriber* pstSub, const SNESInputEvent* pstEvent)
+ * @brief    Send one record to a subscriber
+ * @details  A record that does not fit into the send buffer is
+ *           counted and reported by a 'L' record once there is room
+ *           again.  Has to be called with hLock held.
+ * @param    pstSub
+ *           Subscriber
+ * @param    pstEvent
+ *           Input event
+ */
+static void _TerminalStreamSend(TerminalSubscriber* pstSub, const SNESInputEvent* pstEvent)
+{
+    if (! _TerminalStreamFlush(pstSub))
+    {
+        pstSub->u32Lost++;
+        return;
+    }
+
+    if (pstSub->u32Lost > 0)
+    {
+        _TerminalStreamPack(pstSub->au8Pending, TERMINAL_STREAM_LOST, 0, pstSub->u32Lost, (uint32_t)pstEvent->s64Time);
+        pstSub->u8Offset = 0;
+        pstSub->u32Lost  = 0;
+        if (! _TerminalStreamFlush(pstSub))
+        {
+            pstSub->u32Lost++;
+            return;
+        }
+    }
+
+    _TerminalStreamPack(
+        pstSub->au8Pending,
+        pstEvent->bLatch ? TERMINAL_STREAM_FRAME : TERMINAL_STREAM_CHANGED,
+        pstEvent->u16Data, pstEvent->u32Frame, (uint32_t)pstEvent->s64Time);
+    pstSub->u8Offset = 0;
+    _TerminalStreamFlush(pstSub);
+}
+
+/**
+ * @fn       bool _TerminalStreamFlush(TerminalSubscriber* pstSub)
+ * @brief    Send the rest of a partially sent record
+ * @details  TCP may accept only part of a record; the remainder has
+ *           to go out before anything else to keep the stream framed.
+ * @param    pstSub
+ *           Subscriber
+ * @return   Status
+ * @retval   true  = No partial record left
+ * @retval   false = Send buffer full or connection lost
+ */
+static bool _TerminalStreamFlush(TerminalSubscriber* pstSub)
+{
+    int nLen;
+
+    if (TERMINAL_STREAM_RECORD_SIZE == pstSub->u8Offset)
+    {
+        return true;
+    }
+
+    nLen = send(pstSub->nSock,
+                &pstSub->au8Pending[pstSub->u8Offset],
+                TERMINAL_STREAM_RECORD_SIZE - pstSub->u8Offset,
+                MSG_DONTWAIT);
+    if (0 > nLen)
+    {
+        if (EAGAIN != errno && EWOULDBLOCK != errno)
+        {
+            _TerminalStreamRemove(pstSub);
+        }
+        return false;
+    }
+
+    pstSub->u8Offset += (uint8_t)nLen;
+    return TERMINAL_STREAM_RECORD_SIZE == pstSub->u8Offset;
+}
+
+/**
+ * @fn     void _TerminalStreamPack(uint8_t* pu8Record, uint8_t u8Type, uint16_t u16Data, uint32_t u32Frame, uint32_t u32Time)
+ * @brief  Encode a stream record
+ * @param  pu8Record
+ *         Destination, TERMINAL_STREAM_RECORD_SIZE bytes
+ * @param  u8Type
+ *         Record type
+ * @param  u16Data
+ *         Controller word
+ * @param  u32Frame
+ *         Console frame or lost record count
+ * @param  u32Time
+ *         Time in µs
+ */
+static void _TerminalStreamPack(uint8_t* pu8Record, uint8_t u8Type, uint16_t u16Data, uint32_t u32Frame, uint32_t u32Time)
+{
+    pu8Record[0]  = TERMINAL_STREAM_MAGIC;
+    pu8Record[1]  = u8Type;
+    pu8Record[2]  = (uint8_t)(u16Data  >> 8);
+    pu8Record[3]  = (uint8_t)(u16Data);
+    pu8Record[4]  = (uint8_t)(u32Frame >> 24);
+    pu8Record[5]  = (uint8_t)(u32Frame >> 16);
+    pu8Record[6]  = (uint8_t)(u32Frame >> 8);
+    pu8Record[7]  = (uint8_t)(u32Frame);
+    pu8Record[8]  = (uint8_t)(u32Time  >> 24);
+    pu8Record[9]  = (uint8_t)(u32Time  >> 16);
+    pu8Record[10] = (uint8_t)(u32Time  >> 8);
+    pu8Record[11] = (uint8_t)(u32Time);
+}
+
+/**
+ * @fn       void _TerminalStreamCheckClosed(void)
+ * @brief    Remove subscribers that hung up
+ * @details  Anything a subscriber sends is discarded; an orderly
+ *           shutdown or an error ends the subscription.
+ */
+static void _TerminalStreamCheckClosed(void)
+{
+    xSemaphoreTake(_stStream.hLock, portMAX_DELAY);
+    for (uint8_t u8Index = 0; u8Index < TERMINAL_STREAM_MAX; u8Index++)
+    {
+        TerminalSubscriber* pstSub = &_stStream.astSubscriber[u8Index];
+        uint8_t             au8Discard[32];
+        int                 nLen;
+
+        if (-1 == pstSub->nSock)
+        {
+            continue;
+        }
+
+        do
+        {
+            nLen = recv(pstSub->nSock, au8Discard, sizeof(au8Discard), MSG_DONTWAIT);
+        }
+        while (0 < nLen);
+
+        if (0 == nLen || (EAGAIN != errno && EWOULDBLOCK != errno))
+        {
+            _TerminalStreamRemove(pstSub);
+        }
+    }
+    xSemaphoreGive(_stStream.hLock);
+}
+
+/**
+ * @fn     void _TerminalStreamRemove(TerminalSubscriber* pstSub)
+ * @brief  Close a subscriber connection
+ * @param  pstSub
+ *         Subscriber, hLock has to be held
+ */
+static void _TerminalStreamRemove(TerminalSubscriber* pstSub)
+{
+    shutdown(pstSub->nSock, 0);
+    close(pstSub->nSock);
+    pstSub->nSock = -1;
+
+    _stStream.u8Subscribers--;
+    if (0 == _stStream.u8Subscribers)
+    {
+        SetSNESInputQueue(NULL);
+    }
+    ESP_LOGI("Term", "Stream subscriber removed.");
+}
@@ -0,0 +1,199 @@
+/**
+ * @file       Trace.c
+ * @brief      Event trace
+ * @ingroup    Firmware
+ * @details
+ * @code{.unparsed}
+ *
+ * When the adapter glitches, the log only says that it did.  The trace
+ * records what both cores were doing around it:
+ *
+ *   switch     the FreeRTOS kernel switched a task in, see TraceHooks.h
+ *   isr        enter and exit of the SNES interrupt handlers
+ *   spi done   a controller port transaction completed
+ *   latch      the console latched a controller port
+ *   rx, tx     a netplay packet was received or sent
+ *
+ * Events go into a ring of TRACE_EVENTS entries in RAM, 12 bytes each,
+ * the oldest one is overwritten.  Recording takes a spinlock shared by
+ * both cores and reads the µs timer inside it, so the ring is in time
+ * order.  All of it is in IRAM and may be called from interrupts and
+ * from inside the scheduler.
+ *
+ * The trace is off after start-up and costs a single test per hook
+ * then.  "trace start" on the terminal clears and starts it, "trace
+ * stop" freezes it right after a glitch has been seen, "trace dump"
+ * freezes it as well and sends it in the format described in
+ * TraceFormat.c.  The clock edge interrupt runs 16 times per capture,
+ * only its last edge, which wakes the reader, is traced.
+ *
+ * @endcode
+ * @author     SNESoIP contributors
+ * @copyright  "THE BEER-WARE LICENCE" (Revision 42)
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "Trace.h"
+
+/**
+ * @struct  Trace
+ * @brief   Event trace data
+ */
+typedef struct Trace_t
+{
+    volatile bool bRunning;
+    portMUX_TYPE  stMux;                      ///< Guards the ring
+    uint32_t      u32Count;                   ///< Events recorded since start
+    TraceEvent    astEvents[TRACE_EVENTS];    ///< Ring
+
+} Trace;
+
+/**
+ * @var    _stTrace
+ * @brief  Event trace private data
+ */
+static Trace _stTrace;
+
+/**
+ * @fn     void InitTrace(void)
+ * @brief  Initialise the event trace
+ */
+void InitTrace(void)
+{
+    memset(&_stTrace, 0, sizeof(struct Trace_t));
+    vPortCPUInitializeMutex(&_stTrace.stMux);
+}
+
+/**
+ * @fn     void StartTrace(void)
+ * @brief  Clear the ring and start recording
+ */
+void StartTrace(void)
+{
+    portENTER_CRITICAL(&_stTrace.stMux);
+    _stTrace.u32Count = 0;
+    _stTrace.bRunning = true;
+    portEXIT_CRITICAL(&_stTrace.stMux);
+
+    ESP_LOGI("Trace", "Trace started, %u events", TRACE_EVENTS);
+}
+
+/**
+ * @fn     void StopTrace(void)
+ * @brief  Stop recording, the ring is kept
+ */
+void StopTrace(void)
+{
+    portENTER_CRITICAL(&_stTrace.stMux);
+    _stTrace.bRunning = false;
+    portEXIT_CRITICAL(&_stTrace.stMux);
+}
+
+/**
+ * @fn     bool IsTraceRunning(void)
+ * @brief  Check if events are recorded
+ */
+bool IsTraceRunning(void)
+{
+    return _stTrace.bRunning;
+}
+
+/**
+ * @fn      uint32_t GetTraceEvents(uint32_t* pu32Lost)
+ * @brief   Get the number of events in the ring
+ * @param   pu32Lost
+ *          Destination of the number of overwritten events
+ * @return  Number of events
+ */
+uint32_t GetTraceEvents(uint32_t* pu32Lost)
+{
+    uint32_t u32Count;
+
+    portENTER_CRITICAL(&_stTrace.stMux);
+    u32Count = _stTrace.u32Count;
+    portEXIT_CRITICAL(&_stTrace.stMux);
+
+    if (u32Count > TRACE_EVENTS)
+    {
+        *pu32Lost = u32Count - TRACE_EVENTS;
+        return TRACE_EVENTS;
+    }
+    *pu32Lost = 0;
+    return u32Count;
+}
+
+/**
+ * @fn      bool GetTraceEvent(uint32_t u32Index, TraceEvent* pstEvent)
+ * @brief   Get an event from the ring
+ * @param   u32Index
+ *          Index, 0 = oldest event still in the ring
+ * @param   pstEvent
+ *          Destination of the event
+ * @return  Status
+ * @retval  true  = Event copied
+ * @retval  false = No such event
+ */
+bool GetTraceEvent(uint32_t u32Index, TraceEvent* pstEvent)
+{
+    uint32_t u32Lost;
+    bool     bValid = false;
+
+    portENTER_CRITICAL(&_stTrace.stMux);
+    u32Lost = _stTrace.u32Count > TRACE_EVENTS ? _stTrace.u32Count - TRACE_EVENTS : 0;
+    if (u32Lost + u32Index < _stTrace.u32Count)
+    {
+        *pstEvent = _stTrace.astEvents[(u32Lost + u32Index) & (TRACE_EVENTS - 1)];
+        bValid    = true;
+    }
+    portEXIT_CRITICAL(&_stTrace.stMux);
+
+    return bValid;
+}
+
+/**
+ * @fn     void TraceRecord(uint8_t u8Type, uint16_t u16Id, uint32_t u32Arg)
+ * @brief  Record an event
+ * @param  u8Type
+ *         TraceType
+ * @param  u16Id
+ *         Identifier, see TraceType
+ * @param  u32Arg
+ *         Argument, see TraceType
+ */
+void IRAM_ATTR TraceRecord(uint8_t u8Type, uint16_t u16Id, uint32_t u32Arg)
+{
+    TraceEvent* pstEvent;
+
+    if (! _stTrace.bRunning)
+    {
+        return;
+    }
+
+    portENTER_CRITICAL_ISR(&_stTrace.stMux);
+    pstEvent = &_stTrace.astEvents[_stTrace.u32Count & (TRACE_EVENTS - 1)];
+    pstEvent->u32Time = (uint32_t)esp_timer_get_time();
+    pstEvent->u32Arg  = u32Arg;
+    pstEvent->u16Id   = u16Id;
+    pstEvent->u8Type  = u8Type;
+    pstEvent->u8Core  = (uint8_t)xPortGetCoreID();
+    _stTrace.u32Count++;
+    portEXIT_CRITICAL_ISR(&_stTrace.stMux);
+}
+
+/**
+ * @fn     void TraceTaskSwitchedIn(void* pTask)
+ * @brief  Task switch hook, called by the kernel
+ * @param  pTask
+ *         Handle of the task switched in
+ */
+void IRAM_ATTR TraceTaskSwitchedIn(void* pTask)
+{
+    TraceRecord(TRACE_TASK_SWITCH, 0, (uint32_t)(uintptr_t)pTask);
+}
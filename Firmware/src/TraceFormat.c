@@ -0,0 +1,304 @@
+/**
+ * @file       TraceFormat.c
+ * @brief      Trace dump format
+ * @ingroup    Firmware
+ * @details
+ * @code{.unparsed}
+ *
+ * "trace dump" on the terminal sends the trace ring, see Trace.c, as
+ * one binary block.  All fields are little-endian:
+ *
+ *   Header, TRACE_HEADER_SIZE bytes:
+ *
+ *   +-------+-------+-------+---------+---------+---------+
+ *   | 0..3  | 4     | 5     | 6..7    | 8..11   | 12..15  |
+ *   +-------+-------+-------+---------+---------+---------+
+ *   | STRC  | VER   | 0     | TASKS   | EVENTS  | LOST    |
+ *   +-------+-------+-------+---------+---------+---------+
+ *
+ *   TASKS entries of TRACE_TASK_SIZE bytes:
+ *
+ *   +---------+------------------------------------------+
+ *   | 0..3    | 4..19                                    |
+ *   +---------+------------------------------------------+
+ *   | HANDLE  | Task name, zero-padded                   |
+ *   +---------+------------------------------------------+
+ *
+ *   EVENTS entries of TRACE_EVENT_SIZE bytes, oldest first:
+ *
+ *   +---------+---------+---------+-------+-------+
+ *   | 0..3    | 4..7    | 8..9    | 10    | 11    |
+ *   +---------+---------+---------+-------+-------+
+ *   | TIME    | ARG     | ID      | TYPE  | CORE  |
+ *   +---------+---------+---------+-------+-------+
+ *
+ *   LOST:  Events overwritten since the trace was started
+ *   TIME:  µs since start-up, lower 32 bits
+ *
+ * The task table is taken at dump time, so a task that has been
+ * deleted meanwhile shows up by its handle only.  The host tool in
+ * Tools/TraceExport turns a dump into Chrome trace JSON.
+ *
+ * @endcode
+ * @author     SNESoIP contributors
+ * @copyright  "THE BEER-WARE LICENCE" (Revision 42)
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "TraceFormat.h"
+
+static void     _PutU16(uint8_t* pu8Dest, uint16_t u16Value);
+static void     _PutU32(uint8_t* pu8Dest, uint32_t u32Value);
+static uint16_t _GetU16(const uint8_t* pu8Src);
+static uint32_t _GetU32(const uint8_t* pu8Src);
+
+/**
+ * @fn      size_t EncodeTraceHeader(const TraceHeader* pstHeader, uint8_t* pu8Buffer, size_t uSize)
+ * @brief   Serialise a dump header
+ * @param   pstHeader
+ *          Header
+ * @param   pu8Buffer
+ *          Destination buffer
+ * @param   uSize
+ *          Size of the destination buffer in bytes
+ * @return  Header size in bytes, 0 if the buffer is too small
+ */
+size_t EncodeTraceHeader(const TraceHeader* pstHeader, uint8_t* pu8Buffer, size_t uSize)
+{
+    if (uSize < TRACE_HEADER_SIZE)
+    {
+        return 0;
+    }
+
+    memcpy(pu8Buffer, TRACE_MAGIC, 4);
+    pu8Buffer[4] = pstHeader->u8Version;
+    pu8Buffer[5] = 0;
+    _PutU16(&pu8Buffer[6], pstHeader->u16Tasks);
+    _PutU32(&pu8Buffer[8], pstHeader->u32Events);
+    _PutU32(&pu8Buffer[12], pstHeader->u32Lost);
+
+    return TRACE_HEADER_SIZE;
+}
+
+/**
+ * @fn      bool DecodeTraceHeader(TraceHeader* pstHeader, const uint8_t* pu8Buffer, size_t uSize)
+ * @brief   Parse a dump header
+ * @param   pstHeader
+ *          Destination of the header
+ * @param   pu8Buffer
+ *          Dump data
+ * @param   uSize
+ *          Size of the dump data in bytes
+ * @return  Status
+ * @retval  true  = Valid header
+ * @retval  false = Not a dump or unknown version
+ */
+bool DecodeTraceHeader(TraceHeader* pstHeader, const uint8_t* pu8Buffer, size_t uSize)
+{
+    if (uSize < TRACE_HEADER_SIZE || 0 != memcmp(pu8Buffer, TRACE_MAGIC, 4))
+    {
+        return false;
+    }
+
+    pstHeader->u8Version = pu8Buffer[4];
+    pstHeader->u16Tasks  = _GetU16(&pu8Buffer[6]);
+    pstHeader->u32Events = _GetU32(&pu8Buffer[8]);
+    pstHeader->u32Lost   = _GetU32(&pu8Buffer[12]);
+
+    return TRACE_VERSION == pstHeader->u8Version;
+}
+
+/**
+ * @fn      size_t EncodeTraceTask(const TraceTask* pstTask, uint8_t* pu8Buffer, size_t uSize)
+ * @brief   Serialise a task name table entry
+ * @param   pstTask
+ *          Task entry
+ * @param   pu8Buffer
+ *          Destination buffer
+ * @param   uSize
+ *          Size of the destination buffer in bytes
+ * @return  Entry size in bytes, 0 if the buffer is too small
+ */
+size_t EncodeTraceTask(const TraceTask* pstTask, uint8_t* pu8Buffer, size_t uSize)
+{
+    if (uSize < TRACE_TASK_SIZE)
+    {
+        return 0;
+    }
+
+    _PutU32(&pu8Buffer[0], pstTask->u32Handle);
+    memset(&pu8Buffer[4], 0, TRACE_TASK_NAME);
+    for (uint8_t u8Index = 0; u8Index < TRACE_TASK_NAME && '\0' != pstTask->acName[u8Index]; u8Index++)
+    {
+        pu8Buffer[4 + u8Index] = (uint8_t)pstTask->acName[u8Index];
+    }
+
+    return TRACE_TASK_SIZE;
+}
+
+/**
+ * @fn      bool DecodeTraceTask(TraceTask* pstTask, const uint8_t* pu8Buffer, size_t uSize)
+ * @brief   Parse a task name table entry
+ * @param   pstTask
+ *          Destination of the task entry
+ * @param   pu8Buffer
+ *          Dump data
+ * @param   uSize
+ *          Size of the dump data in bytes
+ * @return  Status
+ * @retval  true  = Complete entry
+ * @retval  false = Truncated entry
+ */
+bool DecodeTraceTask(TraceTask* pstTask, const uint8_t* pu8Buffer, size_t uSize)
+{
+    if (uSize < TRACE_TASK_SIZE)
+    {
+        return false;
+    }
+
+    pstTask->u32Handle = _GetU32(&pu8Buffer[0]);
+    memcpy(pstTask->acName, &pu8Buffer[4], TRACE_TASK_NAME);
+    pstTask->acName[TRACE_TASK_NAME] = '\0';
+
+    return true;
+}
+
+/**
+ * @fn      size_t EncodeTraceEvent(const TraceEvent* pstEvent, uint8_t* pu8Buffer, size_t uSize)
+ * @brief   Serialise a trace event
+ * @param   pstEvent
+ *          Event
+ * @param   pu8Buffer
+ *          Destination buffer
+ * @param   uSize
+ *          Size of the destination buffer in bytes
+ * @return  Event size in bytes, 0 if the buffer is too small
+ */
+size_t EncodeTraceEvent(const TraceEvent* pstEvent, uint8_t* pu8Buffer, size_t uSize)
+{
+    if (uSize < TRACE_EVENT_SIZE)
+    {
+        return 0;
+    }
+
+    _PutU32(&pu8Buffer[0], pstEvent->u32Time);
+    _PutU32(&pu8Buffer[4], pstEvent->u32Arg);
+    _PutU16(&pu8Buffer[8], pstEvent->u16Id);
+    pu8Buffer[10] = pstEvent->u8Type;
+    pu8Buffer[11] = pstEvent->u8Core;
+
+    return TRACE_EVENT_SIZE;
+}
+
+/**
+ * @fn      bool DecodeTraceEvent(TraceEvent* pstEvent, const uint8_t* pu8Buffer, size_t uSize)
+ * @brief   Parse a trace event
+ * @param   pstEvent
+ *          Destination of the event
+ * @param   pu8Buffer
+ *          Dump data
+ * @param   uSize
+ *          Size of the dump data in bytes
+ * @return  Status
+ * @retval  true  = Valid event
+ * @retval  false = Truncated event or unknown type
+ */
+bool DecodeTraceEvent(TraceEvent* pstEvent, const uint8_t* pu8Buffer, size_t uSize)
+{
+    if (uSize < TRACE_EVENT_SIZE)
+    {
+        return false;
+    }
+
+    pstEvent->u32Time = _GetU32(&pu8Buffer[0]);
+    pstEvent->u32Arg  = _GetU32(&pu8Buffer[4]);
+    pstEvent->u16Id   = _GetU16(&pu8Buffer[8]);
+    pstEvent->u8Type  = pu8Buffer[10];
+    pstEvent->u8Core  = pu8Buffer[11];
+
+    return pstEvent->u8Type < TRACE_TYPES;
+}
+
+/**
+ * @fn      const char* TraceTypeName(uint8_t u8Type)
+ * @brief   Get the name of an event type
+ * @param   u8Type
+ *          TraceType
+ * @return  Name, "unknown" for invalid types
+ */
+const char* TraceTypeName(uint8_t u8Type)
+{
+    static const char* const apacName[TRACE_TYPES] =
+    {
+        "switch", "isr enter", "isr exit", "spi done", "latch", "rx", "tx"
+    };
+
+    if (u8Type >= TRACE_TYPES)
+    {
+        return "unknown";
+    }
+    return apacName[u8Type];
+}
+
+/**
+ * @fn      const char* TraceISRName(uint16_t u16Id)
+ * @brief   Get the name of a traced interrupt handler
+ * @param   u16Id
+ *          TraceISR
+ * @return  Name, "unknown" for invalid identifiers
+ */
+const char* TraceISRName(uint16_t u16Id)
+{
+    static const char* const apacName[TRACE_ISRS] =
+    {
+        "clock", "latch 0", "latch 1", "bulk ack"
+    };
+
+    if (u16Id >= TRACE_ISRS)
+    {
+        return "unknown";
+    }
+    return apacName[u16Id];
+}
+
+/**
+ * @fn     void _PutU16(uint8_t* pu8Dest, uint16_t u16Value)
+ * @brief  Store a 16-bit value little-endian
+ */
+static void _PutU16(uint8_t* pu8Dest, uint16_t u16Value)
+{
+    pu8Dest[0] = (uint8_t)(u16Value & 0xff);
+    pu8Dest[1] = (uint8_t)(u16Value >> 8);
+}
+
+/**
+ * @fn     void _PutU32(uint8_t* pu8Dest, uint32_t u32Value)
+ * @brief  Store a 32-bit value little-endian
+ */
+static void _PutU32(uint8_t* pu8Dest, uint32_t u32Value)
+{
+    _PutU16(&pu8Dest[0], (uint16_t)(u32Value & 0xffff));
+    _PutU16(&pu8Dest[2], (uint16_t)(u32Value >> 16));
+}
+
+/**
+ * @fn     uint16_t _GetU16(const uint8_t* pu8Src)
+ * @brief  Load a 16-bit little-endian value
+ */
+static uint16_t _GetU16(const uint8_t* pu8Src)
+{
+    return (uint16_t)(pu8Src[0] | (pu8Src[1] << 8));
+}
+
+/**
+ * @fn     uint32_t _GetU32(const uint8_t* pu8Src)
+ * @brief  Load a 32-bit little-endian value
+ */
+static uint32_t _GetU32(const uint8_t* pu8Src)
+{
+    return (uint32_t)_GetU16(&pu8Src[0]) | ((uint32_t)_GetU16(&pu8Src[2]) << 16);
+}
@@ -2,6 +2,21 @@
  * @file       WiFi.c
  * @brief      WiFi driver
  * @ingroup    Firmware
+ * @details
+ * @code{.unparsed}
+ *
+ * Credentials, BSSID, channel and the last DHCP lease are kept in the
+ * NVS namespace WIFI_NVS_NAMESPACE as one blob, the WiFi library
+ * itself only keeps its configuration in RAM.  The connection
+ * strategy is described in WiFiConnect.c; all events are passed to a
+ * single thread that runs the state machine and carries out its
+ * actions.
+ *
+ * The address is either leased by DHCP or static.  A static address
+ * saves the DHCP exchange on every connect; "wifi ip lease" on the
+ * terminal turns the last lease into one.
+ *
+ * @endcode
  * @author     Michael Fitzmayer
  * @copyright  "THE BEER-WARE LICENCE" (Revision 42)
  */
@@ -13,17 +28,55 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/event_groups.h"
+#include "freertos/queue.h"
 #include "esp_err.h"
 #include "esp_event_loop.h"
 #include "esp_log.h"
 #include "esp_smartconfig.h"
 #include "esp_system.h"
+#include "esp_timer.h"
 #include "esp_wifi.h"
 #include "esp_wpa2.h"
+#include "nvs.h"
 #include "nvs_flash.h"
-#include "rom/ets_sys.h"
 #include "tcpip_adapter.h"
+#include "Boot.h"
+#include "Tasks.h"
 #include "WiFi.h"
+#include "WiFiConnect.h"
+
+#define WIFI_NVS_NAMESPACE "wifi"  // !< NVS namespace of the connection cache
+#define WIFI_QUEUE_SIZE    8       // !< Pending events
+
+/**
+ * @struct  WiFiCache
+ * @brief   Connection data kept in NVS
+ */
+typedef struct WiFiCache_t
+{
+    char     acSSID[33];
+    char     acPassword[65];
+    bool     bBSSID;
+    uint8_t  au8BSSID[6];
+    uint8_t  u8Channel;
+    bool     bStaticIP;
+    uint32_t u32IP;    ///< Static address or last lease, network byte order
+    uint32_t u32Mask;  ///< Netmask, network byte order
+    uint32_t u32GW;    ///< Gateway, network byte order
+
+} WiFiCache;
+
+/**
+ * @struct  WiFiMessage
+ * @brief   Event passed to the WiFi thread
+ */
+typedef struct WiFiMessage_t
+{
+    WiFiConnectEvent eEvent;
+    char             acSSID[33];      ///< Credentials of WIFI_CONNECT_PROVISIONED
+    char             acPassword[65];
+
+} WiFiMessage;
 
 /**
  * @struct  WiFiDriver
@@ -31,10 +84,14 @@
  */
 typedef struct WiFiDriver_t
 {
-    bool bHasIP;
     /* FreeRTOS event group to signal when we are connected & ready
        to make a request */
     EventGroupHandle_t hEventGroup;
+    QueueHandle_t      hQueue;
+    portMUX_TYPE       stMux;      ///< Guards stConnect and stCache
+    WiFiConnect        stConnect;
+    WiFiCache          stCache;    ///< Current connection data
+    WiFiCache          stStored;   ///< Connection data in NVS
 
 } WiFiDriver;
 
@@ -45,20 +102,24 @@ typedef struct WiFiDriver_t
 static WiFiDriver _stDriver;
 
 static esp_err_t _EventHandler(void* pctx, system_event_t* stEvent);
-static void      _SmartConfigThread(void* pArg);
+static void      _WiFiThread(void* pArg);
+static void      _WiFiPost(const WiFiMessage* pstMessage);
+static void      _WiFiConnect(bool bFast);
+static void      _WiFiStore(void);
+static void      _WiFiLoadCache(void);
+static bool      _WiFiSaveCache(const WiFiCache* pstCache);
 static void      _SCCallback(smartconfig_status_t stStatus, void* pdata);
 
 /**
  * @enum     eBits_t
- * @brief    
+ * @brief    Event group bits
  * @details  The event group allows multiple bits for each event, but we
  *           only care about one event - are we connected to the AP with
  *           an IP?
  */
 typedef enum eBits_t
 {
-    eCONNECTED_BIT     = BIT0,
-    eESPTOUCH_DONE_BIT = BIT1
+    eCONNECTED_BIT = BIT0
 
 } eBits;
 
@@ -71,16 +132,28 @@ void InitWiFi(void)
     wifi_init_config_t stConfig = WIFI_INIT_CONFIG_DEFAULT();
 
     ESP_ERROR_CHECK(nvs_flash_init());
+    SetBootStage(BOOT_STAGE_NVS);
     memset(&_stDriver, 0, sizeof(struct WiFiDriver_t));
+    vPortCPUInitializeMutex(&_stDriver.stMux);
 
     tcpip_adapter_init();
     _stDriver.hEventGroup = xEventGroupCreate();
+    _stDriver.hQueue      = xQueueCreate(WIFI_QUEUE_SIZE, sizeof(WiFiMessage));
 
     ESP_ERROR_CHECK(esp_event_loop_init(_EventHandler, NULL));
 
     ESP_ERROR_CHECK(esp_wifi_init(&stConfig));
+    _WiFiLoadCache();
+    ESP_ERROR_CHECK(esp_wifi_set_storage(WIFI_STORAGE_RAM));
+    InitWiFiConnect(&_stDriver.stConnect, '\0' != _stDriver.stCache.acSSID[0], _stDriver.stCache.bBSSID);
+
+    xTaskCreatePinnedToCore(
+        _WiFiThread, "WiFiThread", 4096, NULL,
+        TASK_PRIO_CONTROL, NULL, TASK_CORE_NET);
+
     ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
     ESP_ERROR_CHECK(esp_wifi_start());
+    SetBootStage(BOOT_STAGE_WIFI);
 }
 
 /**
@@ -89,62 +162,436 @@ void InitWiFi(void)
  */
 void WaitForIP(void)
 {
-    while (! _stDriver.bHasIP)
+    xEventGroupWaitBits(_stDriver.hEventGroup, eCONNECTED_BIT, false, true, portMAX_DELAY);
+}
+
+/**
+ * @fn      int8_t GetWiFiRSSI(void)
+ * @brief   Get the signal strength of the access point
+ * @return  RSSI in dBm, 0 = not connected
+ */
+int8_t GetWiFiRSSI(void)
+{
+    wifi_ap_record_t stAP;
+
+    if (ESP_OK != esp_wifi_sta_get_ap_info(&stAP))
     {
-        ets_delay_us(100000);
+        return 0;
     }
+    return stAP.rssi;
+}
+
+/**
+ * @fn     void GetWiFiInfo(WiFiInfo* pstInfo)
+ * @brief  Get connection state, statistics and stored connection data
+ * @param  pstInfo
+ *         Destination
+ */
+void GetWiFiInfo(WiFiInfo* pstInfo)
+{
+    portENTER_CRITICAL(&_stDriver.stMux);
+    pstInfo->eState    = _stDriver.stConnect.eState;
+    pstInfo->stStats   = _stDriver.stConnect.stStats;
+    memcpy(pstInfo->acSSID,   _stDriver.stCache.acSSID,   sizeof(pstInfo->acSSID));
+    memcpy(pstInfo->au8BSSID, _stDriver.stCache.au8BSSID, sizeof(pstInfo->au8BSSID));
+    pstInfo->u8Channel = _stDriver.stCache.bBSSID ? _stDriver.stCache.u8Channel : 0;
+    pstInfo->bStaticIP = _stDriver.stCache.bStaticIP;
+    pstInfo->u32IP     = _stDriver.stCache.u32IP;
+    pstInfo->u32Mask   = _stDriver.stCache.u32Mask;
+    pstInfo->u32GW     = _stDriver.stCache.u32GW;
+    portEXIT_CRITICAL(&_stDriver.stMux);
+}
+
+/**
+ * @fn       bool SetWiFiAddress(uint32_t u32IP, uint32_t u32Mask, uint32_t u32GW)
+ * @brief    Set a static address or return to DHCP
+ * @details  The address is used from the next connection on.
+ * @param    u32IP
+ *           Address in network byte order, 0 = DHCP
+ * @param    u32Mask
+ *           Netmask in network byte order
+ * @param    u32GW
+ *           Gateway in network byte order
+ * @return   Status
+ * @retval   true  = Address has been stored
+ * @retval   false = NVS error
+ */
+bool SetWiFiAddress(uint32_t u32IP, uint32_t u32Mask, uint32_t u32GW)
+{
+    WiFiCache stCache;
+
+    portENTER_CRITICAL(&_stDriver.stMux);
+    stCache = _stDriver.stCache;
+    portEXIT_CRITICAL(&_stDriver.stMux);
+
+    stCache.bStaticIP = 0 != u32IP;
+    if (stCache.bStaticIP)
+    {
+        stCache.u32IP   = u32IP;
+        stCache.u32Mask = u32Mask;
+        stCache.u32GW   = u32GW;
+    }
+    if (! _WiFiSaveCache(&stCache))
+    {
+        return false;
+    }
+
+    portENTER_CRITICAL(&_stDriver.stMux);
+    _stDriver.stCache.bStaticIP = stCache.bStaticIP;
+    _stDriver.stCache.u32IP     = stCache.u32IP;
+    _stDriver.stCache.u32Mask   = stCache.u32Mask;
+    _stDriver.stCache.u32GW     = stCache.u32GW;
+    portEXIT_CRITICAL(&_stDriver.stMux);
+    return true;
+}
+
+/**
+ * @fn       bool ForgetWiFi(void)
+ * @brief    Erase the stored connection data
+ * @details  The current connection is kept; after the next reset
+ *           SmartConfig waits for new credentials.
+ * @return   Status
+ * @retval   true  = Connection data has been erased
+ * @retval   false = NVS error
+ */
+bool ForgetWiFi(void)
+{
+    nvs_handle hNVS;
+    esp_err_t  eErr;
+
+    if (ESP_OK != nvs_open(WIFI_NVS_NAMESPACE, NVS_READWRITE, &hNVS))
+    {
+        return false;
+    }
+    eErr = nvs_erase_all(hNVS);
+    if (ESP_OK == eErr)
+    {
+        eErr = nvs_commit(hNVS);
+    }
+    nvs_close(hNVS);
+
+    if (ESP_OK != eErr)
+    {
+        return false;
+    }
+
+    portENTER_CRITICAL(&_stDriver.stMux);
+    memset(&_stDriver.stStored, 0, sizeof(struct WiFiCache_t));
+    _stDriver.stCache                = _stDriver.stStored;
+    _stDriver.stConnect.bCredentials = false;
+    _stDriver.stConnect.bBSSID       = false;
+    portEXIT_CRITICAL(&_stDriver.stMux);
+    return true;
 }
 
 static esp_err_t _EventHandler(void* pctx, system_event_t* stEvent)
 {
+    WiFiMessage stMessage = { 0 };
+    (void)pctx;
+
     switch (stEvent->event_id)
     {
         case SYSTEM_EVENT_STA_START:
-            xTaskCreate(_SmartConfigThread, "SmartConfigThread", 4096, NULL, 3, NULL);
+            stMessage.eEvent = WIFI_CONNECT_START;
             break;
         case SYSTEM_EVENT_STA_GOT_IP:
-            xEventGroupSetBits(_stDriver.hEventGroup, eCONNECTED_BIT);
+            stMessage.eEvent = WIFI_CONNECT_GOT_IP;
             break;
         case SYSTEM_EVENT_STA_DISCONNECTED:
-            esp_wifi_connect();
             xEventGroupClearBits(_stDriver.hEventGroup, eCONNECTED_BIT);
+            switch (stEvent->event_info.disconnected.reason)
+            {
+                case WIFI_REASON_ASSOC_LEAVE:
+                    // Our own esp_wifi_disconnect() ahead of a new attempt.
+                    return ESP_OK;
+                case WIFI_REASON_NO_AP_FOUND:
+                    stMessage.eEvent = WIFI_CONNECT_NO_AP;
+                    break;
+                case WIFI_REASON_AUTH_FAIL:
+                case WIFI_REASON_4WAY_HANDSHAKE_TIMEOUT:
+                case WIFI_REASON_HANDSHAKE_TIMEOUT:
+                    stMessage.eEvent = WIFI_CONNECT_AUTH_FAILED;
+                    break;
+                default:
+                    stMessage.eEvent = WIFI_CONNECT_LOST;
+                    break;
+            }
             break;
         default:
-            break;
+            return ESP_OK;
     }
+
+    _WiFiPost(&stMessage);
     return ESP_OK;
 }
 
-static void _SmartConfigThread(void* pArg)
+/**
+ * @fn     void _WiFiThread(void* pArg)
+ * @brief  Run the connection state machine
+ * @param  pArg
+ *         Unused
+ */
+static void _WiFiThread(void* pArg)
 {
-    EventBits_t uxBits;
+    WiFiMessage stMessage;
+    TickType_t  xWait;
+    int64_t     s64Deadline;
+    uint8_t     u8Actions;
+    bool        bWasConnected = false;
     (void)pArg;
 
-    ESP_ERROR_CHECK(esp_smartconfig_set_type(SC_TYPE_ESPTOUCH));
-    ESP_ERROR_CHECK(esp_smartconfig_start(_SCCallback));
-
     while (1)
     {
-        uxBits = xEventGroupWaitBits(
-            _stDriver.hEventGroup, eCONNECTED_BIT | eESPTOUCH_DONE_BIT, true, false, portMAX_DELAY);
+        portENTER_CRITICAL(&_stDriver.stMux);
+        s64Deadline = _stDriver.stConnect.s64Deadline;
+        portEXIT_CRITICAL(&_stDriver.stMux);
+
+        xWait = portMAX_DELAY;
+        if (0 != s64Deadline)
+        {
+            int64_t s64Left = s64Deadline - esp_timer_get_time();
+
+            xWait = s64Left > 0 ? pdMS_TO_TICKS(s64Left / 1000) + 1 : 0;
+        }
 
-        if (uxBits & eCONNECTED_BIT)
+        if (pdTRUE != xQueueReceive(_stDriver.hQueue, &stMessage, xWait))
         {
-            ESP_LOGI("sc", "WiFi Connected to ap");
+            stMessage.eEvent = WIFI_CONNECT_TICK;
         }
-        if (uxBits & eESPTOUCH_DONE_BIT)
+
+        portENTER_CRITICAL(&_stDriver.stMux);
+        if (WIFI_CONNECT_PROVISIONED == stMessage.eEvent)
         {
-            _stDriver.bHasIP = true;
-            ESP_LOGI("sc", "SmartConfig over");
+            memcpy(_stDriver.stCache.acSSID,     stMessage.acSSID,     sizeof(stMessage.acSSID));
+            memcpy(_stDriver.stCache.acPassword, stMessage.acPassword, sizeof(stMessage.acPassword));
+            _stDriver.stCache.bBSSID = false;
+        }
+        u8Actions = WiFiConnectHandle(&_stDriver.stConnect, stMessage.eEvent, esp_timer_get_time());
+        portEXIT_CRITICAL(&_stDriver.stMux);
+
+        if (u8Actions & WIFI_ACTION_SMARTCONFIG_STOP)
+        {
+            ESP_LOGI("WiFi", "Stop SmartConfig.");
             esp_smartconfig_stop();
-            vTaskDelete(NULL);
         }
+        if (u8Actions & WIFI_ACTION_CONNECT_FAST)
+        {
+            ESP_LOGI("WiFi", "Connect to %s directly.", _stDriver.stCache.acSSID);
+            _WiFiConnect(true);
+        }
+        if (u8Actions & WIFI_ACTION_CONNECT_SCAN)
+        {
+            ESP_LOGI("WiFi", "Connect to %s after a full scan.", _stDriver.stCache.acSSID);
+            _WiFiConnect(false);
+        }
+        if (u8Actions & WIFI_ACTION_SMARTCONFIG_START)
+        {
+            ESP_LOGI("WiFi", "Wait for credentials from SmartConfig.");
+            esp_wifi_disconnect();
+            esp_smartconfig_set_type(SC_TYPE_ESPTOUCH);
+            if (ESP_OK != esp_smartconfig_start(_SCCallback))
+            {
+                ESP_LOGE("WiFi", "SmartConfig failed to start.");
+            }
+        }
+        if (u8Actions & WIFI_ACTION_STORE)
+        {
+            // Release the waiting tasks before flash is written.
+            xEventGroupSetBits(_stDriver.hEventGroup, eCONNECTED_BIT);
+            if (! bWasConnected)
+            {
+                WiFiInfo stInfo;
+
+                SetBootStage(BOOT_STAGE_IP);
+                GetWiFiInfo(&stInfo);
+                ESP_LOGI("WiFi", "Ready after %u ms (%s).",
+                         stInfo.stStats.u32ReadyMs, WiFiConnectStateName(stInfo.stStats.eReadyPath));
+                bWasConnected = true;
+            }
+            _WiFiStore();
+        }
+    }
+}
+
+/**
+ * @fn     void _WiFiPost(const WiFiMessage* pstMessage)
+ * @brief  Pass an event to the WiFi thread
+ * @param  pstMessage
+ *         Event
+ */
+static void _WiFiPost(const WiFiMessage* pstMessage)
+{
+    if (pdTRUE != xQueueSend(_stDriver.hQueue, pstMessage, 0))
+    {
+        ESP_LOGE("WiFi", "Event queue full.");
+    }
+}
+
+/**
+ * @fn     void _WiFiConnect(bool bFast)
+ * @brief  Start a connection attempt with the stored data
+ * @param  bFast
+ *         Connect to the stored BSSID on the stored channel
+ */
+static void _WiFiConnect(bool bFast)
+{
+    wifi_config_t           stConfig;
+    tcpip_adapter_ip_info_t stIP;
+    WiFiCache               stCache;
+
+    portENTER_CRITICAL(&_stDriver.stMux);
+    stCache = _stDriver.stCache;
+    portEXIT_CRITICAL(&_stDriver.stMux);
+
+    memset(&stConfig, 0, sizeof(wifi_config_t));
+    // A 32 character SSID or 64 character password fills the field
+    // without a terminator, which is how the driver expects it.
+    memcpy(stConfig.sta.ssid,     stCache.acSSID,     strnlen(stCache.acSSID,     sizeof(stConfig.sta.ssid)));
+    memcpy(stConfig.sta.password, stCache.acPassword, strnlen(stCache.acPassword, sizeof(stConfig.sta.password)));
+    if (bFast)
+    {
+        stConfig.sta.scan_method = WIFI_FAST_SCAN;
+        stConfig.sta.bssid_set   = true;
+        stConfig.sta.channel     = stCache.u8Channel;
+        memcpy(stConfig.sta.bssid, stCache.au8BSSID, sizeof(stConfig.sta.bssid));
+    }
+    else
+    {
+        stConfig.sta.scan_method = WIFI_ALL_CHANNEL_SCAN;
+        stConfig.sta.sort_method = WIFI_CONNECT_AP_BY_SIGNAL;
+    }
+
+    if (stCache.bStaticIP)
+    {
+        tcpip_adapter_dhcpc_stop(TCPIP_ADAPTER_IF_STA);
+        stIP.ip.addr      = stCache.u32IP;
+        stIP.netmask.addr = stCache.u32Mask;
+        stIP.gw.addr      = stCache.u32GW;
+        tcpip_adapter_set_ip_info(TCPIP_ADAPTER_IF_STA, &stIP);
+    }
+    else
+    {
+        tcpip_adapter_dhcpc_start(TCPIP_ADAPTER_IF_STA);
+    }
+
+    // A failed call is caught by the timeout of the state machine.
+    esp_wifi_disconnect();
+    if (ESP_OK != esp_wifi_set_config(ESP_IF_WIFI_STA, &stConfig) || ESP_OK != esp_wifi_connect())
+    {
+        ESP_LOGE("WiFi", "Connection attempt failed.");
+    }
+}
+
+/**
+ * @fn     void _WiFiStore(void)
+ * @brief  Store the data of the current connection if it changed
+ */
+static void _WiFiStore(void)
+{
+    wifi_ap_record_t        stAP;
+    tcpip_adapter_ip_info_t stIP;
+    WiFiCache               stCache;
+    bool                    bChanged;
+
+    portENTER_CRITICAL(&_stDriver.stMux);
+    stCache = _stDriver.stCache;
+    portEXIT_CRITICAL(&_stDriver.stMux);
+
+    if (ESP_OK == esp_wifi_sta_get_ap_info(&stAP))
+    {
+        stCache.bBSSID    = true;
+        stCache.u8Channel = stAP.primary;
+        memcpy(stCache.au8BSSID, stAP.bssid, sizeof(stCache.au8BSSID));
+    }
+    if (! stCache.bStaticIP && ESP_OK == tcpip_adapter_get_ip_info(TCPIP_ADAPTER_IF_STA, &stIP))
+    {
+        stCache.u32IP   = stIP.ip.addr;
+        stCache.u32Mask = stIP.netmask.addr;
+        stCache.u32GW   = stIP.gw.addr;
+    }
+
+    portENTER_CRITICAL(&_stDriver.stMux);
+    _stDriver.stCache = stCache;
+    bChanged          = 0 != memcmp(&stCache, &_stDriver.stStored, sizeof(struct WiFiCache_t));
+    portEXIT_CRITICAL(&_stDriver.stMux);
+
+    // Flash is only written if the access point or the lease changed.
+    if (bChanged && ! _WiFiSaveCache(&stCache))
+    {
+        ESP_LOGE("WiFi", "Failed to store connection data.");
+    }
+}
+
+/**
+ * @fn       void _WiFiLoadCache(void)
+ * @brief    Read the connection data from NVS
+ * @details  Without stored data, the credentials the WiFi library kept
+ *           in flash before are taken over.
+ */
+static void _WiFiLoadCache(void)
+{
+    nvs_handle    hNVS;
+    size_t        uSize = sizeof(struct WiFiCache_t);
+    wifi_config_t stConfig;
+
+    if (ESP_OK == nvs_open(WIFI_NVS_NAMESPACE, NVS_READONLY, &hNVS))
+    {
+        if (ESP_OK != nvs_get_blob(hNVS, "cache", &_stDriver.stStored, &uSize) || sizeof(struct WiFiCache_t) != uSize)
+        {
+            memset(&_stDriver.stStored, 0, sizeof(struct WiFiCache_t));
+        }
+        nvs_close(hNVS);
+    }
+    _stDriver.stCache = _stDriver.stStored;
+
+    if ('\0' == _stDriver.stCache.acSSID[0] && ESP_OK == esp_wifi_get_config(ESP_IF_WIFI_STA, &stConfig))
+    {
+        memcpy(_stDriver.stCache.acSSID,     stConfig.sta.ssid,     sizeof(stConfig.sta.ssid));
+        memcpy(_stDriver.stCache.acPassword, stConfig.sta.password, sizeof(stConfig.sta.password));
     }
+
+    ESP_LOGI("WiFi", "Stored network: %s.", '\0' != _stDriver.stCache.acSSID[0] ? _stDriver.stCache.acSSID : "none");
+}
+
+/**
+ * @fn      bool _WiFiSaveCache(const WiFiCache* pstCache)
+ * @brief   Write the connection data to NVS
+ * @param   pstCache
+ *          Connection data
+ * @return  Status
+ * @retval  true  = Data has been stored
+ * @retval  false = NVS error
+ */
+static bool _WiFiSaveCache(const WiFiCache* pstCache)
+{
+    nvs_handle hNVS;
+    esp_err_t  eErr;
+
+    if (ESP_OK != nvs_open(WIFI_NVS_NAMESPACE, NVS_READWRITE, &hNVS))
+    {
+        return false;
+    }
+    eErr = nvs_set_blob(hNVS, "cache", pstCache, sizeof(struct WiFiCache_t));
+    if (ESP_OK == eErr)
+    {
+        eErr = nvs_commit(hNVS);
+    }
+    nvs_close(hNVS);
+
+    if (ESP_OK != eErr)
+    {
+        return false;
+    }
+
+    portENTER_CRITICAL(&_stDriver.stMux);
+    _stDriver.stStored = *pstCache;
+    portEXIT_CRITICAL(&_stDriver.stMux);
+    return true;
 }
 
 static void _SCCallback(smartconfig_status_t stStatus, void* pdata)
 {
-    wifi_config_t* stConfig = pdata;
+    WiFiMessage stMessage = { 0 };
 
     switch (stStatus)
     {
@@ -158,13 +605,17 @@ static void _SCCallback(smartconfig_status_t stStatus, void* pdata)
             ESP_LOGI("sc", "SC_STATUS_GETTING_SSID_PSWD");
             break;
         case SC_STATUS_LINK:
+        {
+            wifi_config_t* stConfig = pdata;
+
             ESP_LOGI("sc", "SC_STATUS_LINK");
             ESP_LOGI("sc", "SSID:%s", stConfig->sta.ssid);
-            ESP_LOGI("sc", "PASSWORD:%s", stConfig->sta.password);
-            ESP_ERROR_CHECK(esp_wifi_disconnect());
-            ESP_ERROR_CHECK(esp_wifi_set_config(ESP_IF_WIFI_STA, stConfig));
-            ESP_ERROR_CHECK(esp_wifi_connect());
+            stMessage.eEvent = WIFI_CONNECT_PROVISIONED;
+            memcpy(stMessage.acSSID,     stConfig->sta.ssid,     sizeof(stConfig->sta.ssid));
+            memcpy(stMessage.acPassword, stConfig->sta.password, sizeof(stConfig->sta.password));
+            _WiFiPost(&stMessage);
             break;
+        }
         case SC_STATUS_LINK_OVER:
             ESP_LOGI("sc", "SC_STATUS_LINK_OVER");
             if (pdata != NULL)
@@ -179,7 +630,8 @@ static void _SCCallback(smartconfig_status_t stStatus, void* pdata)
                     au8PhoneIP[2],
                     au8PhoneIP[3]);
             }
-            xEventGroupSetBits(_stDriver.hEventGroup, eESPTOUCH_DONE_BIT);
+            stMessage.eEvent = WIFI_CONNECT_SMARTCONFIG_DONE;
+            _WiFiPost(&stMessage);
             break;
         default:
             break;
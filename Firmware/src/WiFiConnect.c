@@ -0,0 +1,348 @@
+/**
+ * @file       WiFiConnect.c
+ * @brief      WiFi connection strategy
+ * @ingroup    Firmware
+ * @details
+ * @code{.unparsed}
+ *
+ * SSID, password, BSSID and channel of the last access point are kept
+ * in NVS (see WiFi.c), so after a power cycle the station connects
+ * directly to the known BSSID on the known channel.  Only if that
+ * fails the stored SSID is searched on all channels, and only if that
+ * fails too SmartConfig waits for new credentials:
+ *
+ *   START ---> FAST ---> SCAN (x WIFI_SCAN_ATTEMPTS) ---> SMARTCONFIG
+ *     |          |        |                                  |
+ *     |          +--------+-------> CONNECTED <--------------+
+ *     |                                 |
+ *     +-- no credentials -------------> SMARTCONFIG
+ *
+ * A failed authentication of a never connected station skips the
+ * remaining scans, the password is likely wrong.  If credentials are
+ * stored, SmartConfig gives up after WIFI_SMARTCONFIG_MS and the
+ * stored network is tried again; the access point may just take
+ * longer to boot than the adapter.  Once connected, a lost connection
+ * never leads to SmartConfig, the station retries every WIFI_RETRY_MS
+ * instead.
+ *
+ * The state machine only returns WIFI_ACTION_* flags, it does not call
+ * the WiFi driver, so the same code runs on the adapter and against
+ * the mocked driver of Tools/WiFiConnectSim.
+ *
+ * @endcode
+ * @author     SNESoIP contributors
+ * @copyright  "THE BEER-WARE LICENCE" (Revision 42)
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "WiFiConnect.h"
+
+static uint8_t _WiFiConnectStart(WiFiConnect* pstConnect, int64_t s64Now);
+static uint8_t _WiFiConnectScan(WiFiConnect* pstConnect, int64_t s64Now);
+static uint8_t _WiFiConnectSmartConfig(WiFiConnect* pstConnect, int64_t s64Now);
+static uint8_t _WiFiConnectFailed(WiFiConnect* pstConnect, bool bAuthFailed, int64_t s64Now);
+static uint8_t _WiFiConnectTimeout(WiFiConnect* pstConnect, int64_t s64Now);
+
+/**
+ * @fn     void InitWiFiConnect(WiFiConnect* pstConnect, bool bCredentials, bool bBSSID)
+ * @brief  Initialise connection state machine
+ * @param  pstConnect
+ *         Connection state
+ * @param  bCredentials
+ *         SSID and password are stored
+ * @param  bBSSID
+ *         BSSID and channel are stored
+ */
+void InitWiFiConnect(WiFiConnect* pstConnect, bool bCredentials, bool bBSSID)
+{
+    memset(pstConnect, 0, sizeof(struct WiFiConnect_t));
+    pstConnect->bCredentials = bCredentials;
+    pstConnect->bBSSID       = bCredentials && bBSSID;
+}
+
+/**
+ * @fn      uint8_t WiFiConnectHandle(WiFiConnect* pstConnect, WiFiConnectEvent eEvent, int64_t s64Now)
+ * @brief   Process an event
+ * @param   pstConnect
+ *          Connection state
+ * @param   eEvent
+ *          Event
+ * @param   s64Now
+ *          Time since boot in µs
+ * @return  WIFI_ACTION_* flags
+ */
+uint8_t WiFiConnectHandle(WiFiConnect* pstConnect, WiFiConnectEvent eEvent, int64_t s64Now)
+{
+    switch (eEvent)
+    {
+        case WIFI_CONNECT_START:
+            if (WIFI_STATE_IDLE != pstConnect->eState)
+            {
+                return WIFI_ACTION_NONE;
+            }
+            pstConnect->s64Since = s64Now;
+            return _WiFiConnectStart(pstConnect, s64Now);
+
+        case WIFI_CONNECT_GOT_IP:
+            if (WIFI_STATE_IDLE == pstConnect->eState)
+            {
+                return WIFI_ACTION_NONE;
+            }
+            if (WIFI_STATE_CONNECTED != pstConnect->eState)
+            {
+                pstConnect->stStats.u32ConnectMs = (uint32_t)((s64Now - pstConnect->s64Since) / 1000);
+                if (! pstConnect->bWasConnected)
+                {
+                    pstConnect->stStats.eReadyPath = pstConnect->eState;
+                    pstConnect->stStats.u32ReadyMs = s64Now > 1000 ? (uint32_t)(s64Now / 1000) : 1;
+                }
+                pstConnect->eState        = WIFI_STATE_CONNECTED;
+                pstConnect->bWasConnected = true;
+                pstConnect->bCredentials  = true;
+                pstConnect->bBSSID        = true;
+                pstConnect->u8Attempt     = 0;
+                pstConnect->s64Deadline   = pstConnect->bSmartConfig ? s64Now + (int64_t)WIFI_SCAN_MS * 1000 : 0;
+            }
+            return WIFI_ACTION_STORE;
+
+        case WIFI_CONNECT_NO_AP:
+        case WIFI_CONNECT_LOST:
+            return _WiFiConnectFailed(pstConnect, false, s64Now);
+
+        case WIFI_CONNECT_AUTH_FAILED:
+            return _WiFiConnectFailed(pstConnect, true, s64Now);
+
+        case WIFI_CONNECT_PROVISIONED:
+            if (WIFI_STATE_SMARTCONFIG != pstConnect->eState)
+            {
+                return WIFI_ACTION_NONE;
+            }
+            pstConnect->bProvisioned = true;
+            pstConnect->bCredentials = true;
+            pstConnect->bBSSID       = false;
+            pstConnect->s64Deadline  = s64Now + (int64_t)WIFI_SCAN_MS * 1000;
+            pstConnect->stStats.u32Scans++;
+            return WIFI_ACTION_CONNECT_SCAN;
+
+        case WIFI_CONNECT_SMARTCONFIG_DONE:
+            if (! pstConnect->bSmartConfig)
+            {
+                return WIFI_ACTION_NONE;
+            }
+            pstConnect->bSmartConfig = false;
+            if (WIFI_STATE_CONNECTED == pstConnect->eState)
+            {
+                pstConnect->s64Deadline = 0;
+            }
+            return WIFI_ACTION_SMARTCONFIG_STOP;
+
+        case WIFI_CONNECT_TICK:
+            if (0 != pstConnect->s64Deadline && s64Now >= pstConnect->s64Deadline)
+            {
+                pstConnect->s64Deadline = 0;
+                return _WiFiConnectTimeout(pstConnect, s64Now);
+            }
+            return WIFI_ACTION_NONE;
+    }
+
+    return WIFI_ACTION_NONE;
+}
+
+/**
+ * @fn      const char* WiFiConnectStateName(WiFiConnectState eState)
+ * @brief   Get the name of a connection state
+ * @param   eState
+ *          Connection state
+ * @return  Name
+ */
+const char* WiFiConnectStateName(WiFiConnectState eState)
+{
+    switch (eState)
+    {
+        case WIFI_STATE_IDLE:
+            return "idle";
+        case WIFI_STATE_FAST:
+            return "direct connect";
+        case WIFI_STATE_SCAN:
+            return "full scan";
+        case WIFI_STATE_SMARTCONFIG:
+            return "smartconfig";
+        case WIFI_STATE_BACKOFF:
+            return "backoff";
+        case WIFI_STATE_CONNECTED:
+            return "connected";
+    }
+    return "?";
+}
+
+/**
+ * @fn      uint8_t _WiFiConnectStart(WiFiConnect* pstConnect, int64_t s64Now)
+ * @brief   Start a connection with what is stored
+ * @param   pstConnect
+ *          Connection state
+ * @param   s64Now
+ *          Time since boot in µs
+ * @return  WIFI_ACTION_* flags
+ */
+static uint8_t _WiFiConnectStart(WiFiConnect* pstConnect, int64_t s64Now)
+{
+    pstConnect->u8Attempt = 0;
+
+    if (! pstConnect->bCredentials)
+    {
+        return _WiFiConnectSmartConfig(pstConnect, s64Now);
+    }
+    if (! pstConnect->bBSSID)
+    {
+        return _WiFiConnectScan(pstConnect, s64Now);
+    }
+
+    pstConnect->eState      = WIFI_STATE_FAST;
+    pstConnect->s64Deadline = s64Now + (int64_t)WIFI_FAST_MS * 1000;
+    pstConnect->stStats.u32Fast++;
+    return WIFI_ACTION_CONNECT_FAST;
+}
+
+/**
+ * @fn      uint8_t _WiFiConnectScan(WiFiConnect* pstConnect, int64_t s64Now)
+ * @brief   Start a connection with full scan
+ * @param   pstConnect
+ *          Connection state
+ * @param   s64Now
+ *          Time since boot in µs
+ * @return  WIFI_ACTION_* flags
+ */
+static uint8_t _WiFiConnectScan(WiFiConnect* pstConnect, int64_t s64Now)
+{
+    pstConnect->eState      = WIFI_STATE_SCAN;
+    pstConnect->s64Deadline = s64Now + (int64_t)WIFI_SCAN_MS * 1000;
+    pstConnect->u8Attempt++;
+    pstConnect->stStats.u32Scans++;
+    return WIFI_ACTION_CONNECT_SCAN;
+}
+
+/**
+ * @fn      uint8_t _WiFiConnectSmartConfig(WiFiConnect* pstConnect, int64_t s64Now)
+ * @brief   (Re)start SmartConfig
+ * @param   pstConnect
+ *          Connection state
+ * @param   s64Now
+ *          Time since boot in µs
+ * @return  WIFI_ACTION_* flags
+ */
+static uint8_t _WiFiConnectSmartConfig(WiFiConnect* pstConnect, int64_t s64Now)
+{
+    uint8_t u8Actions = WIFI_ACTION_SMARTCONFIG_START;
+
+    if (pstConnect->bSmartConfig)
+    {
+        u8Actions |= WIFI_ACTION_SMARTCONFIG_STOP;
+    }
+
+    pstConnect->eState       = WIFI_STATE_SMARTCONFIG;
+    pstConnect->bSmartConfig = true;
+    pstConnect->bProvisioned = false;
+    pstConnect->u8Attempt    = 0;
+    pstConnect->s64Deadline  = pstConnect->bCredentials ? s64Now + (int64_t)WIFI_SMARTCONFIG_MS * 1000 : 0;
+    pstConnect->stStats.u32SmartConfig++;
+    return u8Actions;
+}
+
+/**
+ * @fn      uint8_t _WiFiConnectFailed(WiFiConnect* pstConnect, bool bAuthFailed, int64_t s64Now)
+ * @brief   Handle a failed or lost connection
+ * @param   pstConnect
+ *          Connection state
+ * @param   bAuthFailed
+ *          The access point rejected the credentials
+ * @param   s64Now
+ *          Time since boot in µs
+ * @return  WIFI_ACTION_* flags
+ */
+static uint8_t _WiFiConnectFailed(WiFiConnect* pstConnect, bool bAuthFailed, int64_t s64Now)
+{
+    switch (pstConnect->eState)
+    {
+        case WIFI_STATE_FAST:
+            // The access point may have changed its channel or been replaced.
+            pstConnect->stStats.u32FastFails++;
+            return _WiFiConnectScan(pstConnect, s64Now);
+
+        case WIFI_STATE_SCAN:
+            pstConnect->stStats.u32ScanFails++;
+            if (pstConnect->u8Attempt < WIFI_SCAN_ATTEMPTS && ! (bAuthFailed && ! pstConnect->bWasConnected))
+            {
+                return _WiFiConnectScan(pstConnect, s64Now);
+            }
+            if (pstConnect->bWasConnected)
+            {
+                pstConnect->eState      = WIFI_STATE_BACKOFF;
+                pstConnect->s64Deadline = s64Now + (int64_t)WIFI_RETRY_MS * 1000;
+                return WIFI_ACTION_NONE;
+            }
+            return _WiFiConnectSmartConfig(pstConnect, s64Now);
+
+        case WIFI_STATE_SMARTCONFIG:
+            // Disconnects are expected while SmartConfig listens.
+            if (! pstConnect->bProvisioned)
+            {
+                return WIFI_ACTION_NONE;
+            }
+            pstConnect->stStats.u32ScanFails++;
+            return _WiFiConnectSmartConfig(pstConnect, s64Now);
+
+        case WIFI_STATE_CONNECTED:
+            pstConnect->stStats.u32Lost++;
+            pstConnect->s64Since = s64Now;
+            return _WiFiConnectStart(pstConnect, s64Now);
+
+        default:
+            return WIFI_ACTION_NONE;
+    }
+}
+
+/**
+ * @fn      uint8_t _WiFiConnectTimeout(WiFiConnect* pstConnect, int64_t s64Now)
+ * @brief   Handle the end of the current state
+ * @param   pstConnect
+ *          Connection state
+ * @param   s64Now
+ *          Time since boot in µs
+ * @return  WIFI_ACTION_* flags
+ */
+static uint8_t _WiFiConnectTimeout(WiFiConnect* pstConnect, int64_t s64Now)
+{
+    switch (pstConnect->eState)
+    {
+        case WIFI_STATE_FAST:
+        case WIFI_STATE_SCAN:
+            return _WiFiConnectFailed(pstConnect, false, s64Now);
+
+        case WIFI_STATE_SMARTCONFIG:
+            if (pstConnect->bProvisioned)
+            {
+                return _WiFiConnectFailed(pstConnect, false, s64Now);
+            }
+            // Nobody sent credentials, try the stored ones again.
+            pstConnect->bSmartConfig = false;
+            return WIFI_ACTION_SMARTCONFIG_STOP | _WiFiConnectStart(pstConnect, s64Now);
+
+        case WIFI_STATE_BACKOFF:
+            return _WiFiConnectStart(pstConnect, s64Now);
+
+        case WIFI_STATE_CONNECTED:
+            // The phone never picked up the acknowledgement.
+            if (pstConnect->bSmartConfig)
+            {
+                pstConnect->bSmartConfig = false;
+                return WIFI_ACTION_SMARTCONFIG_STOP;
+            }
+            return WIFI_ACTION_NONE;
+
+        default:
+            return WIFI_ACTION_NONE;
+    }
+}
@@ -18,11 +18,17 @@
 #include <string.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <time.h>
 #include <unistd.h>
 
 #include <CommonInclude.h>
 #include "inih/ini.h"
 
+#define MAX_CLIENTS      256  // !< Upper limit of max_clients
+#define UDP_BUFFER_SIZE  512  // !< Largest datagram handled
+#define UDP_RELAY_MAGIC  0x4e // !< First byte of an input packet ('N')
+#define UDP_ENDPOINT_TTL 15   // !< Seconds a registration is valid, three client refresh periods
+
 /**
  * @enum   eCommand
  * @brief  Client/Server commands
@@ -42,8 +48,12 @@ typedef enum eCommand_t
  */
 typedef struct Client_t
 {
-    uint16_t u16Data;
-    uint8_t  au8IP[4];
+    uint16_t           u16Data;
+    uint8_t            au8IP[4];
+    in_addr_t          u32TcpAddr;
+    bool               bHasEndpoint;
+    struct sockaddr_in stEndpoint;
+    time_t             tRegistered;
 
 } Client;
 
@@ -68,17 +78,22 @@ typedef struct Server_t
 {
     struct sockaddr_storage stClientAddr;
 
-    bool    bIsRunning;
-    uint8_t u8NumClients;
-    Config  stConfig;
-    Client  astClient[];
+    bool            bIsRunning;
+    uint8_t         u8NumClients;
+    Config          stConfig;
+    pthread_mutex_t stEndpointLock;
+    Client          astClient[MAX_CLIENTS];
 
 } Server;
 
-static void* _ConnHandler(void* pSock);
-static void  _IntHandler(int nSig);
-static void* _GetInAddr(struct sockaddr *stAddr);
-static int   _ConfigHandler(void* pUser, const char* pacSection, const char* pacName, const char* pacValue);
+static void*  _ConnHandler(void* pSock);
+static void*  _UdpHandler(void* pSock);
+static void   _SendPeer(int nSock, uint8_t u8ClientID, uint8_t u8OpponentID);
+static bool   _HasEndpoint(const Client* pstClient, time_t tNow);
+static time_t _Now(void);
+static void   _IntHandler(int nSig);
+static void*  _GetInAddr(struct sockaddr *stAddr);
+static int    _ConfigHandler(void* pUser, const char* pacSection, const char* pacName, const char* pacValue);
 
 /**
  * @var    _stServer
@@ -93,7 +108,9 @@ int main(int argc, char* argv[])
     int       nRet = EXIT_SUCCESS;
     char      pacIniFile[20];
     int       nSock;
+    int       nUdpSock;
     int       nNewSock;
+    pthread_t stUdpThreadID;
     int       nSockOpt= 1;
     socklen_t nAddrSize;
 
@@ -158,6 +175,31 @@ int main(int argc, char* argv[])
         goto quit;
     }
 
+    // Stage 3 rendezvous, same address and port as the TCP socket.
+    pthread_mutex_init(&_stServer.stEndpointLock, NULL);
+    nUdpSock = socket(PF_INET, SOCK_DGRAM, 0);
+    if (-1 == nUdpSock)
+    {
+        nRet = EXIT_FAILURE;
+        perror(strerror(errno));
+        goto quit;
+    }
+    if (-1 == bind(nUdpSock, (struct sockaddr*)&stServerAddr, sizeof(stServerAddr)))
+    {
+        nRet = EXIT_FAILURE;
+        perror(strerror(errno));
+        close(nUdpSock);
+        goto quit;
+    }
+    _stServer.bIsRunning = true;
+    if (0 != pthread_create(&stUdpThreadID, NULL, _UdpHandler, (void*)&nUdpSock))
+    {
+        nRet = EXIT_FAILURE;
+        perror(strerror(errno));
+        close(nUdpSock);
+        goto quit;
+    }
+
     puts("");
     puts(" ███████╗███╗   ██╗███████╗███████╗ ██████╗ ██╗██████╗");
     puts(" ██╔════╝████╗  ██║██╔════╝██╔════╝██╔═══██╗██║██╔══██╗");
@@ -271,8 +313,8 @@ quit:
  * Stage 3 - Direct contact
  *
  * As soon as both clients have a valid IP address, they start a direct
- * data exchange via UDP.  How this has to look like still has to be
- * specified.
+ * data exchange via UDP.  The server helps to get through NAT routers,
+ * see _UdpHandler().
  *
  * @endcode
  */
@@ -296,6 +338,14 @@ static void* _ConnHandler(void* pSock)
     if (IpIsValid(acIpAddr))
     {
         printf(" (%u) %s connected.\n", u8ClientID, acIpAddr);
+
+        // The ID may have belonged to an earlier session.
+        pthread_mutex_lock(&_stServer.stEndpointLock);
+        _stServer.astClient[u8ClientID].u32TcpAddr   = inet_addr(acIpAddr);
+        _stServer.astClient[u8ClientID].bHasEndpoint = false;
+        memset(&_stServer.astClient[u8ClientID].stEndpoint, 0, sizeof(struct sockaddr_in));
+        pthread_mutex_unlock(&_stServer.stEndpointLock);
+
         StrToIP(acIpAddr, _stServer.astClient[u8ClientID].au8IP);
     }
     else
@@ -426,6 +476,207 @@ static void* _ConnHandler(void* pSock)
     return 0;
 }
 
+/**
+ * @fn     void* _UdpHandler(void* pSock)
+ * @brief  UDP rendezvous and relay handler.
+ * @details
+ * @code{.unparsed}
+ *
+ * Stage 3 - UDP rendezvous
+ *
+ * A client behind NAT can't be reached at the address the server sees
+ * on the TCP connection, because its router only forwards UDP packets
+ * that answer a packet the client has sent before.  To open such a
+ * mapping on both sides, the clients register their UDP socket with the
+ * server, which tells each client the external UDP endpoint of its
+ * opponent:
+ *
+ *   Client -> Server:
+ *   +---+---+---+---+
+ *   | R | e | g |ID0|
+ *   +---+---+---+---+
+ *
+ *   Server -> Client:
+ *   +---+---+---+---+---+---+---+---+---+---+---+
+ *   | P | e | e | r |ID1|IHH|IHL|ILH|ILL|PHB|PLB|
+ *   +---+---+---+---+---+---+---+---+---+---+---+
+ *
+ *   PHB:   UDP port, high byte
+ *   PLB:   UDP port, low byte
+ *
+ * A registration is only accepted from the IP address that completed
+ * the TCP exchange for that ID, so a third party can't take over the
+ * ID and receive the opponent's input.
+ *
+ * The server answers every registration.  When the endpoint of a client
+ * is new or has changed, the opponent is notified as well, so both
+ * clients start sending to each other at the same time.  Their outgoing
+ * packets open the mappings on both routers ("hole punching").
+ *
+ * The clients keep registering every few seconds to keep the mapping
+ * to the server open.  An endpoint that has not been registered again
+ * within UDP_ENDPOINT_TTL seconds is dropped, and so is the endpoint of
+ * an ID that is given to a new client, so a new pair never gets the
+ * endpoint of an earlier session.  If no packet has arrived directly
+ * after a few seconds, a client falls back to sending its input packets
+ * (first byte $4E) to the server, which relays them to the registered
+ * endpoint of the opponent.
+ *
+ * @endcode
+ */
+static void* _UdpHandler(void* pSock)
+{
+    int     nSock = *(int*)pSock;
+    uint8_t au8Buffer[UDP_BUFFER_SIZE];
+
+    while (_stServer.bIsRunning)
+    {
+        struct sockaddr_in stAddr;
+        socklen_t          nAddrSize = sizeof(stAddr);
+        ssize_t            nSize;
+        time_t             tNow;
+
+        nSize = recvfrom(nSock, au8Buffer, sizeof(au8Buffer), 0, (struct sockaddr*)&stAddr, &nAddrSize);
+        if (0 >= nSize)
+        {
+            continue;
+        }
+        tNow = _Now();
+
+        // Registration.
+        if (4 == nSize && 0 == memcmp(au8Buffer, "Reg", 3))
+        {
+            uint8_t u8ClientID   = au8Buffer[3];
+            uint8_t u8OpponentID = u8ClientID ^ 1;
+            bool    bChanged;
+            bool    bPaired;
+
+            if (u8ClientID >= _stServer.stConfig.u8MaxClients)
+            {
+                continue;
+            }
+
+            pthread_mutex_lock(&_stServer.stEndpointLock);
+            if (_stServer.astClient[u8ClientID].u32TcpAddr != stAddr.sin_addr.s_addr)
+            {
+                pthread_mutex_unlock(&_stServer.stEndpointLock);
+                if (_stServer.stConfig.u8Verbose)
+                {
+                    printf(" (%u) registration from %s rejected.\n", u8ClientID, inet_ntoa(stAddr.sin_addr));
+                }
+                continue;
+            }
+            bChanged =
+                ! _HasEndpoint(&_stServer.astClient[u8ClientID], tNow) ||
+                _stServer.astClient[u8ClientID].stEndpoint.sin_addr.s_addr != stAddr.sin_addr.s_addr ||
+                _stServer.astClient[u8ClientID].stEndpoint.sin_port        != stAddr.sin_port;
+            _stServer.astClient[u8ClientID].stEndpoint   = stAddr;
+            _stServer.astClient[u8ClientID].bHasEndpoint = true;
+            _stServer.astClient[u8ClientID].tRegistered  = tNow;
+            bPaired = _HasEndpoint(&_stServer.astClient[u8OpponentID], tNow);
+            pthread_mutex_unlock(&_stServer.stEndpointLock);
+
+            if (bChanged && _stServer.stConfig.u8Verbose)
+            {
+                printf(" (%u) registered UDP endpoint %s:%u.\n",
+                       u8ClientID, inet_ntoa(stAddr.sin_addr), ntohs(stAddr.sin_port));
+            }
+            if (bPaired)
+            {
+                _SendPeer(nSock, u8ClientID, u8OpponentID);
+                if (bChanged)
+                {
+                    _SendPeer(nSock, u8OpponentID, u8ClientID);
+                }
+            }
+        }
+        // Relay.
+        else if (UDP_RELAY_MAGIC == au8Buffer[0])
+        {
+            struct sockaddr_in stDest;
+            bool               bFound = false;
+
+            pthread_mutex_lock(&_stServer.stEndpointLock);
+            for (uint16_t u16Index = 0; u16Index < _stServer.stConfig.u8MaxClients; u16Index++)
+            {
+                Client* pstClient   = &_stServer.astClient[u16Index];
+                Client* pstOpponent = &_stServer.astClient[u16Index ^ 1];
+
+                if (_HasEndpoint(pstClient, tNow) &&
+                    pstClient->stEndpoint.sin_addr.s_addr == stAddr.sin_addr.s_addr &&
+                    pstClient->stEndpoint.sin_port        == stAddr.sin_port)
+                {
+                    if (_HasEndpoint(pstOpponent, tNow))
+                    {
+                        stDest = pstOpponent->stEndpoint;
+                        bFound = true;
+                    }
+                    break;
+                }
+            }
+            pthread_mutex_unlock(&_stServer.stEndpointLock);
+
+            if (bFound)
+            {
+                if (-1 == sendto(nSock, au8Buffer, nSize, 0, (struct sockaddr*)&stDest, sizeof(stDest)))
+                {
+                    perror(strerror(errno));
+                }
+            }
+        }
+    }
+
+    close(nSock);
+    return 0;
+}
+
+/**
+ * @fn     void _SendPeer(int nSock, uint8_t u8ClientID, uint8_t u8OpponentID)
+ * @brief  Send the UDP endpoint of the opponent to a client.
+ */
+static void _SendPeer(int nSock, uint8_t u8ClientID, uint8_t u8OpponentID)
+{
+    struct sockaddr_in stDest;
+    struct sockaddr_in stPeer;
+    uint8_t            au8TxBuffer[11] = { 'P', 'e', 'e', 'r' };
+
+    pthread_mutex_lock(&_stServer.stEndpointLock);
+    stDest = _stServer.astClient[u8ClientID].stEndpoint;
+    stPeer = _stServer.astClient[u8OpponentID].stEndpoint;
+    pthread_mutex_unlock(&_stServer.stEndpointLock);
+
+    au8TxBuffer[4] = u8OpponentID;
+    memcpy(&au8TxBuffer[5], &stPeer.sin_addr.s_addr, 4);
+    memcpy(&au8TxBuffer[9], &stPeer.sin_port, 2);
+
+    if (-1 == sendto(nSock, au8TxBuffer, sizeof(au8TxBuffer), 0, (struct sockaddr*)&stDest, sizeof(stDest)))
+    {
+        perror(strerror(errno));
+    }
+}
+
+/**
+ * @fn     bool _HasEndpoint(const Client* pstClient, time_t tNow)
+ * @brief  Check if a client has a registered UDP endpoint that is still
+ *         valid.  Call with stEndpointLock held.
+ */
+static bool _HasEndpoint(const Client* pstClient, time_t tNow)
+{
+    return pstClient->bHasEndpoint && (tNow - pstClient->tRegistered) <= UDP_ENDPOINT_TTL;
+}
+
+/**
+ * @fn     time_t _Now(void)
+ * @brief  Get the monotonic time in seconds.
+ */
+static time_t _Now(void)
+{
+    struct timespec stNow;
+
+    clock_gettime(CLOCK_MONOTONIC, &stNow);
+    return stNow.tv_sec;
+}
+
 /**
  * @fn     void _IntHandler(int nSig)
  * @brief  Interrupt handler.
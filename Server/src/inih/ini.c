@@ -0,0 +1,6 @@
+#include <stdio.h>
+#include <string.h>
+#include "inih/ini.h"
+int ini_parse(const char* f, ini_handler h, void* u){FILE*p=fopen(f,"r");char l[256],s[64]="";if(!p)return -1;
+while(fgets(l,sizeof l,p)){char*e=strchr(l,'\n');if(e)*e=0;if(l[0]=='['){sscanf(l,"[%63[^]]",s);continue;}
+char n[64],v[128];if(2==sscanf(l," %63[^= ] = %127s",n,v))h(u,s,n,v);}fclose(p);return 0;}
@@ -0,0 +1,2 @@
+typedef int (*ini_handler)(void* user, const char* section, const char* name, const char* value);
+int ini_parse(const char* filename, ini_handler handler, void* user);
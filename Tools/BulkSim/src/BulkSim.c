@@ -0,0 +1,490 @@
+/**
+ * @file       BulkSim.c
+ * @brief      Simulation of the SNES bulk data channel
+ * @details    A host sends a byte stream at a given rate through the
+ *             terminal pipe into the staging buffer.  The block builder
+ *             thread and the acknowledge ISR follow SNESBulk.c and pack
+ *             the blocks with the firmware's codec.  The SNES latches,
+ *             clocks both ports bit by bit, checks the block, toggles
+ *             the acknowledge line and waits before the next latch, all
+ *             with the cycle costs of a tight 65816 read loop.  Some
+ *             reads are corrupted by flipped bits.  Usage:
+ * @code{.unparsed}
+ *   BulkSim [seconds] [corrupt permille] [cpu percent]
+ * @endcode
+ *             The CPU share is the part of each frame the SNES spends
+ *             reading, e.g. the vertical blank only.  Every line is
+ *             one host rate, 0 meaning as fast as the SNES reads.
+ *             Fails if the SNES accepts a corrupted block, if a block
+ *             is lost or if the received stream differs from the sent
+ *             one.
+ * @defgroup   BulkSim Bulk data channel simulation
+ * @ingroup    BulkSim
+ * @author     SNESoIP contributors
+ * @copyright  "THE BEER-WARE LICENCE" (Revision 42)
+ */
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "SNESBulkProtocol.h"
+
+#define NTSC_PERIOD_US    16639.27  // !< Nominal NTSC frame period
+#define SNES_LATCH_US     3.0       // !< Latch pulse via $4016
+#define SNES_BIT_US       6.7       // !< LDA $4016, LSR, ROL, LDA $4017, LSR, ROL (~24 cycles)
+#define SNES_CHECK_US     750.0     // !< Table-driven CRC of 62 bytes and copying the payload
+#define SNES_ACK_WAIT_US  20.0      // !< Wait between acknowledge and the next latch
+#define FW_ISR_US         4.0       // !< Acknowledge edge to swapped block
+#define FW_WAKE_US        40.0      // !< Notification to running task
+#define FW_BUILD_US       20.0      // !< Building and packing one block
+#define HOST_CHUNK        256       // !< Bytes per recv() of the pipe, see TerminalBulk.h
+#define BUFFER_SIZE       4096      // !< Staging buffer, see SNESBulk.h
+#define MAX_FLIPS         3         // !< Max. bits flipped in a corrupted read
+
+/**
+ * @enum   Event
+ * @brief  Simulated activities, at most one of each is pending
+ */
+typedef enum
+{
+    EV_HOST = 0,  ///< Pipe stages a chunk from the host
+    EV_THREAD,    ///< Builder thread completes one loop
+    EV_ISR,       ///< Acknowledge ISR runs
+    EV_LATCH,     ///< SNES latches the ports
+    EV_CHECK,     ///< SNES has read and checked a block
+    EV_COUNT
+
+} Event;
+
+/**
+ * @struct  Sim
+ * @brief   State of both ends
+ */
+typedef struct Sim_t
+{
+    double   adAt[EV_COUNT];  ///< Time of the pending events, INFINITY = none
+    double   dInterval;       ///< Time between two host chunks
+    double   dWindow;         ///< Time per frame the SNES reads
+
+    // Firmware
+    uint64_t u64Head;         ///< Stream bytes staged
+    uint64_t u64Tail;         ///< Stream bytes taken by the builder
+    bool     bHostBlocked;    ///< Pipe waits for space in the staging buffer
+    bool     bNextReady;
+    bool     bAckPending;
+    uint8_t  u8Seq;
+    uint32_t au32Tx[SNES_BULK_PORTS][SNES_BULK_PORT_WORDS];
+    uint32_t au32Next[SNES_BULK_PORTS][SNES_BULK_PORT_WORDS];
+
+    // SNES
+    uint32_t au32Wire[SNES_BULK_PORTS][SNES_BULK_PORT_WORDS];  ///< Block as latched
+    uint8_t  u8LastSeq;
+    uint64_t u64Received;     ///< Stream bytes received
+
+    // Statistics
+    uint32_t u32Blocks;       ///< New blocks accepted
+    uint32_t u32Short;        ///< Accepted blocks with less than a full payload
+    uint32_t u32Repeats;      ///< Reads of an already accepted block
+    uint32_t u32Rejects;      ///< Reads failing magic or CRC
+    uint32_t u32Corrupted;    ///< Reads with flipped bits
+    uint32_t u32Stalls;       ///< Acknowledges without a block staged
+    uint32_t u32Errors;
+
+} Sim;
+
+static uint64_t _u64Random = 0x2545f4914f6cdd1dULL;
+
+static uint32_t _Random(uint32_t u32Range);
+static uint8_t  _StreamByte(uint64_t u64Pos);
+static void     _Notify(Sim* pstSim, double dNow);
+static void     _Host(Sim* pstSim, double dNow);
+static void     _Thread(Sim* pstSim, double dNow);
+static void     _AckISR(Sim* pstSim, double dNow);
+static void     _Latch(Sim* pstSim, double dNow, uint32_t u32Permille);
+static void     _Check(Sim* pstSim, double dNow);
+static double   _NextLatch(const Sim* pstSim, double dNow);
+static bool     _Run(double dSeconds, uint32_t u32Rate, uint32_t u32Permille, uint32_t u32Percent);
+
+int main(int argc, char* argv[])
+{
+    uint32_t au32Rate[] = { 0, 64, 16, 4 };
+    uint32_t u32Seconds = 60;
+    uint32_t u32Permille = 5;
+    uint32_t u32Percent  = 100;
+    double   dBlockUs;
+    bool     bOk         = true;
+
+    if (argc > 1)
+    {
+        u32Seconds = (uint32_t)atol(argv[1]);
+    }
+    if (argc > 2)
+    {
+        u32Permille = (uint32_t)atol(argv[2]);
+    }
+    if (argc > 3)
+    {
+        u32Percent = (uint32_t)atol(argv[3]);
+    }
+    if (0 == u32Percent || u32Percent > 100)
+    {
+        u32Percent = 100;
+    }
+
+    dBlockUs = SNES_LATCH_US + SNES_BULK_PORT_BITS * SNES_BIT_US + SNES_CHECK_US + SNES_ACK_WAIT_US;
+    printf("%u s, %u permille corrupted reads, %u%% of each frame reading\n", u32Seconds, u32Permille, u32Percent);
+    printf("block read %.0f us, limit %.1f KB/s at full CPU\n",
+           dBlockUs, SNES_BULK_PAYLOAD_SIZE * 1000.0 / 1024.0 / dBlockUs * 1000.0);
+    printf("host KB/s    KB/s  bytes/frame  blocks  short  repeats  rejects  stalls\n");
+
+    for (uint8_t u8Index = 0; u8Index < sizeof(au32Rate) / sizeof(au32Rate[0]); u8Index++)
+    {
+        bOk &= _Run(u32Seconds, au32Rate[u8Index], u32Permille, u32Percent);
+    }
+
+    return bOk ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/**
+ * @fn      uint32_t _Random(uint32_t u32Range)
+ * @brief   xorshift64*
+ * @return  Random number in 0..u32Range-1
+ */
+static uint32_t _Random(uint32_t u32Range)
+{
+    _u64Random ^= _u64Random >> 12;
+    _u64Random ^= _u64Random << 25;
+    _u64Random ^= _u64Random >> 27;
+    return (uint32_t)(((_u64Random * 0x2545f4914f6cdd1dULL) >> 32) % u32Range);
+}
+
+/**
+ * @fn      uint8_t _StreamByte(uint64_t u64Pos)
+ * @brief   Byte the host sends at a given stream position
+ */
+static uint8_t _StreamByte(uint64_t u64Pos)
+{
+    return (uint8_t)((u64Pos * 0x9e3779b97f4a7c15ULL) >> 56);
+}
+
+/**
+ * @fn     void _Notify(Sim* pstSim, double dNow)
+ * @brief  xTaskNotifyGive() to the builder thread
+ */
+static void _Notify(Sim* pstSim, double dNow)
+{
+    if (isinf(pstSim->adAt[EV_THREAD]))
+    {
+        pstSim->adAt[EV_THREAD] = dNow + FW_WAKE_US + FW_BUILD_US;
+    }
+}
+
+/**
+ * @fn     void _Host(Sim* pstSim, double dNow)
+ * @brief  TerminalBulk: stage one chunk or wait for space
+ */
+static void _Host(Sim* pstSim, double dNow)
+{
+    if (pstSim->u64Head - pstSim->u64Tail + HOST_CHUNK > BUFFER_SIZE)
+    {
+        pstSim->bHostBlocked    = true;
+        pstSim->adAt[EV_HOST] = INFINITY;
+        return;
+    }
+
+    pstSim->u64Head += HOST_CHUNK;
+    pstSim->adAt[EV_HOST] = dNow + (pstSim->dInterval > 0.0 ? pstSim->dInterval : FW_WAKE_US);
+    _Notify(pstSim, dNow);
+}
+
+/**
+ * @fn       void _Thread(Sim* pstSim, double dNow)
+ * @brief    One loop of _SNESBulkThread()
+ * @details  Like xRingbufferReceiveUpTo() on a byte buffer, a block
+ *           only gets the bytes up to the end of the buffer memory.
+ */
+static void _Thread(Sim* pstSim, double dNow)
+{
+    uint8_t  au8Payload[SNES_BULK_PAYLOAD_SIZE];
+    uint32_t au32Block[SNES_BULK_PORTS][SNES_BULK_PORT_WORDS];
+    uint64_t u64Size = pstSim->u64Head - pstSim->u64Tail;
+    uint64_t u64Wrap = BUFFER_SIZE - (pstSim->u64Tail % BUFFER_SIZE);
+
+    pstSim->adAt[EV_THREAD] = INFINITY;
+    if (pstSim->bNextReady || 0 == u64Size)
+    {
+        return;
+    }
+
+    if (u64Size > SNES_BULK_PAYLOAD_SIZE)
+    {
+        u64Size = SNES_BULK_PAYLOAD_SIZE;
+    }
+    if (u64Size > u64Wrap)
+    {
+        u64Size = u64Wrap;
+    }
+    for (uint8_t u8Index = 0; u8Index < u64Size; u8Index++)
+    {
+        au8Payload[u8Index] = _StreamByte(pstSim->u64Tail + u8Index);
+    }
+    pstSim->u64Tail += u64Size;
+
+    pstSim->u8Seq++;
+    SNESBulkPack(pstSim->u8Seq, 0, au8Payload, (uint8_t)u64Size, au32Block);
+    if (pstSim->bAckPending)
+    {
+        memcpy(pstSim->au32Tx, au32Block, sizeof(au32Block));
+        pstSim->bAckPending = false;
+    }
+    else
+    {
+        memcpy(pstSim->au32Next, au32Block, sizeof(au32Block));
+        pstSim->bNextReady = true;
+    }
+
+    if (pstSim->bHostBlocked)
+    {
+        pstSim->bHostBlocked  = false;
+        pstSim->adAt[EV_HOST] = dNow + FW_WAKE_US;
+    }
+    if (! pstSim->bNextReady && pstSim->u64Head > pstSim->u64Tail)
+    {
+        pstSim->adAt[EV_THREAD] = dNow + FW_BUILD_US;
+    }
+}
+
+/**
+ * @fn     void _AckISR(Sim* pstSim, double dNow)
+ * @brief  _SNESBulkAckISR()
+ */
+static void _AckISR(Sim* pstSim, double dNow)
+{
+    pstSim->adAt[EV_ISR] = INFINITY;
+    if (pstSim->bNextReady)
+    {
+        memcpy(pstSim->au32Tx, pstSim->au32Next, sizeof(pstSim->au32Tx));
+        pstSim->bNextReady = false;
+    }
+    else
+    {
+        pstSim->bAckPending = true;
+        pstSim->u32Stalls++;
+    }
+    _Notify(pstSim, dNow);
+}
+
+/**
+ * @fn       void _Latch(Sim* pstSim, double dNow, uint32_t u32Permille)
+ * @brief    SNES latches and clocks both ports
+ * @details  The SPI transaction holds the block of the latch, so the
+ *           whole read sees one block even if the ISR swaps meanwhile.
+ */
+static void _Latch(Sim* pstSim, double dNow, uint32_t u32Permille)
+{
+    memcpy(pstSim->au32Wire, pstSim->au32Tx, sizeof(pstSim->au32Wire));
+
+    if (_Random(1000) < u32Permille)
+    {
+        uint32_t u32Flips = 1 + _Random(MAX_FLIPS);
+
+        pstSim->u32Corrupted++;
+        while (u32Flips--)
+        {
+            uint8_t  u8Port = (uint8_t)_Random(SNES_BULK_PORTS);
+            uint32_t u32Bit = 1 + _Random(SNES_BULK_PORT_BITS - 1);
+
+            pstSim->au32Wire[u8Port][u32Bit / 32] ^= 1UL << (u32Bit % 32);
+        }
+    }
+
+    pstSim->adAt[EV_LATCH] = INFINITY;
+    pstSim->adAt[EV_CHECK] = dNow + SNES_LATCH_US + SNES_BULK_PORT_BITS * SNES_BIT_US + SNES_CHECK_US;
+}
+
+/**
+ * @fn       void _Check(Sim* pstSim, double dNow)
+ * @brief    SNES decodes and checks the block it read
+ * @details  The wire carries the inverted bits LSB first after the
+ *           dummy bit, see SNESBulkProtocol.c.
+ */
+static void _Check(Sim* pstSim, double dNow)
+{
+    uint8_t  au8Block[SNES_BULK_BLOCK_SIZE];
+    uint16_t u16CRC;
+    uint8_t  u8Len;
+
+    pstSim->adAt[EV_CHECK] = INFINITY;
+
+    for (uint8_t u8Port = 0; u8Port < SNES_BULK_PORTS; u8Port++)
+    {
+        const uint8_t* pu8Wire = (const uint8_t*)pstSim->au32Wire[u8Port];
+
+        for (uint8_t u8Index = 0; u8Index < SNES_BULK_PORT_BYTES; u8Index++)
+        {
+            uint8_t u8Byte = 0;
+
+            for (uint8_t u8Bit = 0; u8Bit < 8; u8Bit++)
+            {
+                uint16_t u16Pos = (uint16_t)(1 + (8 * u8Index) + u8Bit);
+
+                u8Byte |= (uint8_t)(((pu8Wire[u16Pos / 8] >> (u16Pos % 8)) & 1) << u8Bit);
+            }
+            au8Block[(u8Index * SNES_BULK_PORTS) + u8Port] = (uint8_t)~u8Byte;
+        }
+    }
+
+    u16CRC = SNESBulkCRC(au8Block, SNES_BULK_BLOCK_SIZE - SNES_BULK_CRC_SIZE);
+    u8Len  = au8Block[2];
+    if (SNES_BULK_MAGIC != au8Block[0] ||
+        (u16CRC & 0xff) != au8Block[SNES_BULK_BLOCK_SIZE - 2] ||
+        (u16CRC >> 8)   != au8Block[SNES_BULK_BLOCK_SIZE - 1] ||
+        u8Len > SNES_BULK_PAYLOAD_SIZE)
+    {
+        // Read again without acknowledging.
+        pstSim->u32Rejects++;
+        pstSim->adAt[EV_LATCH] = _NextLatch(pstSim, dNow);
+        return;
+    }
+
+    if (au8Block[1] == pstSim->u8LastSeq)
+    {
+        pstSim->u32Repeats++;
+        pstSim->adAt[EV_LATCH] = _NextLatch(pstSim, dNow);
+        return;
+    }
+    if (au8Block[1] != (uint8_t)(pstSim->u8LastSeq + 1))
+    {
+        printf("Block lost: sequence %u after %u.\n", au8Block[1], pstSim->u8LastSeq);
+        pstSim->u32Errors++;
+    }
+    for (uint8_t u8Index = 0; u8Index < u8Len; u8Index++)
+    {
+        if (au8Block[SNES_BULK_HEADER_SIZE + u8Index] != _StreamByte(pstSim->u64Received + u8Index))
+        {
+            printf("Stream differs at byte %llu.\n", (unsigned long long)(pstSim->u64Received + u8Index));
+            pstSim->u32Errors++;
+            break;
+        }
+    }
+
+    pstSim->u8LastSeq    = au8Block[1];
+    pstSim->u64Received += u8Len;
+    pstSim->u32Blocks++;
+    if (u8Len < SNES_BULK_PAYLOAD_SIZE)
+    {
+        pstSim->u32Short++;
+    }
+
+    // Toggle WRIO bit 6.
+    pstSim->adAt[EV_ISR]   = dNow + FW_ISR_US;
+    pstSim->adAt[EV_LATCH] = _NextLatch(pstSim, dNow + SNES_ACK_WAIT_US);
+}
+
+/**
+ * @fn      double _NextLatch(const Sim* pstSim, double dNow)
+ * @brief   Time of the next latch within the reading part of a frame
+ */
+static double _NextLatch(const Sim* pstSim, double dNow)
+{
+    double dFrame = floor(dNow / NTSC_PERIOD_US) * NTSC_PERIOD_US;
+
+    if (dNow - dFrame < pstSim->dWindow)
+    {
+        return dNow;
+    }
+    return dFrame + NTSC_PERIOD_US;
+}
+
+/**
+ * @fn      bool _Run(double dSeconds, uint32_t u32Rate, uint32_t u32Permille, uint32_t u32Percent)
+ * @brief   Simulate one host rate
+ * @param   dSeconds
+ *          Simulated time
+ * @param   u32Rate
+ *          Host rate in KB/s, 0 = unlimited
+ * @param   u32Permille
+ *          Chance of a corrupted read
+ * @param   u32Percent
+ *          Share of each frame the SNES spends reading
+ * @return  false on lost or wrong data
+ */
+static bool _Run(double dSeconds, uint32_t u32Rate, uint32_t u32Permille, uint32_t u32Percent)
+{
+    static Sim stSim;
+    double     dEnd = dSeconds * 1000000.0;
+    double     dNow = 0.0;
+    double     dKBs;
+
+    memset(&stSim, 0, sizeof(stSim));
+    for (uint8_t u8Event = 0; u8Event < EV_COUNT; u8Event++)
+    {
+        stSim.adAt[u8Event] = INFINITY;
+    }
+    stSim.dWindow   = NTSC_PERIOD_US * u32Percent / 100.0;
+    stSim.dInterval = u32Rate ? HOST_CHUNK * 1000000.0 / (u32Rate * 1024.0) : 0.0;
+
+    // Idle block of InitSNESBulk(), then the pipe opens.
+    stSim.u8Seq++;
+    SNESBulkPack(stSim.u8Seq, 0, NULL, 0, stSim.au32Tx);
+    stSim.adAt[EV_HOST]  = 0.0;
+    stSim.adAt[EV_LATCH] = 0.0;
+
+    while (dNow < dEnd)
+    {
+        Event eNext = EV_HOST;
+
+        for (uint8_t u8Event = 0; u8Event < EV_COUNT; u8Event++)
+        {
+            if (stSim.adAt[u8Event] < stSim.adAt[eNext])
+            {
+                eNext = (Event)u8Event;
+            }
+        }
+        dNow = stSim.adAt[eNext];
+
+        switch (eNext)
+        {
+            case EV_HOST:
+                _Host(&stSim, dNow);
+                break;
+            case EV_THREAD:
+                _Thread(&stSim, dNow);
+                break;
+            case EV_ISR:
+                _AckISR(&stSim, dNow);
+                break;
+            case EV_LATCH:
+                _Latch(&stSim, dNow, u32Permille);
+                break;
+            default:
+                _Check(&stSim, dNow);
+                break;
+        }
+    }
+
+    if (stSim.u32Rejects > stSim.u32Corrupted)
+    {
+        printf("%u reads rejected, only %u corrupted.\n", stSim.u32Rejects, stSim.u32Corrupted);
+        stSim.u32Errors++;
+    }
+
+    dKBs = stSim.u64Received / 1024.0 / dSeconds;
+    if (u32Rate)
+    {
+        printf("%9u", u32Rate);
+    }
+    else
+    {
+        printf("%9s", "max");
+    }
+    printf(" %7.2f %12.1f %7u %6u %8u %8u %7u\n",
+           dKBs, stSim.u64Received * NTSC_PERIOD_US / (dSeconds * 1000000.0),
+           stSim.u32Blocks, stSim.u32Short, stSim.u32Repeats, stSim.u32Rejects, stSim.u32Stalls);
+
+    return 0 == stSim.u32Errors;
+}
@@ -0,0 +1,378 @@
+/**
+ * @file       ClockSyncSim.c
+ * @brief      Simulation of the peer clock synchronisation
+ * @details    Two consoles with slightly different frame rates, two
+ *             adapters with clocks off by a few ppm and a network with
+ *             jitter and loss.  Both adapters run the same protocol and
+ *             clock synchronisation code as the firmware; the remote
+ *             input queue of SNES.c is modelled.  Usage:
+ * @code{.unparsed}
+ *   ClockSyncSim [seconds] [console ppm] [clock A ppm] [clock B ppm] [align]
+ * @endcode
+ *             Fails if a remote word misses its latch once the
+ *             estimation has settled, or if the estimates are off.
+ * @defgroup   ClockSyncSim Clock synchronisation simulation
+ * @ingroup    ClockSyncSim
+ * @author     SNESoIP contributors
+ * @copyright  "THE BEER-WARE LICENCE" (Revision 42)
+ */
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ClockSync.h"
+#include "NetplayProtocol.h"
+
+#define NTSC_PERIOD_US   16639.27  // !< Nominal NTSC frame period
+#define QUEUE_SIZE       16        // !< Remote input queue size, see SNES_REMOTE_QUEUE_SIZE
+#define REMOTE_DELAY     2         // !< Input delay in frames, see SNES_REMOTE_DELAY
+#define NET_DELAY_US     5000.0    // !< One-way base delay
+#define NET_JITTER_US    1000.0    // !< Mean of the exponential jitter
+#define NET_LOSS_PERCENT 2         // !< Packet loss
+#define WARMUP_S         60        // !< Settling time excluded from the checks
+#define MAX_EVENTS       256       // !< Events in flight
+
+/**
+ * @struct  Playout
+ * @brief   Model of the remote input queue in SNES.c
+ */
+typedef struct Playout_t
+{
+    bool     bActive;
+    bool     bPlaying;
+    uint32_t u32Play;
+    uint32_t u32Newest;
+    int8_t   s8Slip;
+    bool     abValid[QUEUE_SIZE];
+    uint32_t au32Frame[QUEUE_SIZE];
+    bool     bShown;
+    uint32_t u32Shown;
+    int64_t  s64Shown;
+    uint32_t u32Presented;
+    uint32_t u32Underruns;
+    uint32_t u32Late;
+    uint32_t u32Inserted;
+    uint32_t u32Dropped;
+
+} Playout;
+
+/**
+ * @struct  Node
+ * @brief   Console plus adapter
+ */
+typedef struct Node_t
+{
+    double         dPeriod;    ///< True frame period in µs
+    double         dPhase;     ///< True time of the first latch in µs
+    double         dClockPpm;  ///< Adapter clock rate error
+    double         dClockOff;  ///< Adapter clock offset in µs
+    uint32_t       u32Frame;   ///< Latches so far
+    int64_t        s64Latch;   ///< Local time of the last latch in µs
+    NetplaySession stSession;
+    Playout        stPlayout;
+
+} Node;
+
+/**
+ * @struct  Event
+ * @brief   Scheduled event
+ */
+typedef struct Event_t
+{
+    double  dTime;
+    int     nType;
+    int     nNode;
+    uint8_t au8Packet[NETPLAY_PACKET_SIZE];
+    size_t  uSize;
+
+} Event;
+
+enum { EVENT_LATCH, EVENT_SEND, EVENT_ARRIVE };
+
+static Node     _astNode[2];
+static Event    _astEvent[MAX_EVENTS];
+static int      _nEvents;
+static Node*    _pstReceiver;
+static uint64_t _u64Random = 0x2545f4914f6cdd1dULL;
+static bool     _bMeasure;
+static uint32_t _u32Missed;
+
+static double  _Random(void);
+static int64_t _LocalTime(const Node* pstNode, double dTime);
+static void    _Schedule(double dTime, int nType, int nNode, const uint8_t* pu8Packet, size_t uSize);
+static bool    _NextEvent(Event* pstEvent);
+static void    _Push(uint32_t u32Frame, uint16_t u16Data);
+static void    _PlayoutLatch(Playout* pstPlayout, int64_t s64Now);
+
+int main(int argc, char* argv[])
+{
+    double   dSeconds   = 1200.0;
+    double   dSkewPpm   = 100.0;
+    bool     bAlign     = true;
+    uint32_t u32Missed;
+    Event    stEvent;
+    int      nFailed    = 0;
+
+    memset(_astNode, 0, sizeof(_astNode));
+    _astNode[0].dClockPpm = 30.0;
+    _astNode[1].dClockPpm = -20.0;
+
+    if (argc > 1)
+    {
+        dSeconds = atof(argv[1]);
+    }
+    if (argc > 2)
+    {
+        dSkewPpm = atof(argv[2]);
+    }
+    if (argc > 3)
+    {
+        _astNode[0].dClockPpm = atof(argv[3]);
+    }
+    if (argc > 4)
+    {
+        _astNode[1].dClockPpm = atof(argv[4]);
+    }
+    if (argc > 5)
+    {
+        bAlign = 0 != atoi(argv[5]);
+    }
+
+    // Console B runs dSkewPpm slower, its adapter booted 1.234 s later.
+    _astNode[0].dPeriod   = NTSC_PERIOD_US;
+    _astNode[1].dPeriod   = NTSC_PERIOD_US * (1.0 + dSkewPpm * 1e-6);
+    _astNode[0].dPhase    = 1000.0;
+    _astNode[1].dPhase    = 7777.0;
+    _astNode[0].dClockOff = 5000000.0;
+    _astNode[1].dClockOff = 5000000.0 - 1234000.0;
+
+    for (int nNode = 0; nNode < 2; nNode++)
+    {
+        InitNetplaySession(&_astNode[nNode].stSession);
+        _Schedule(_astNode[nNode].dPhase, EVENT_LATCH, nNode, NULL, 0);
+    }
+
+    while (_NextEvent(&stEvent) && stEvent.dTime < dSeconds * 1e6)
+    {
+        Node*         pstNode = &_astNode[stEvent.nNode];
+        NetplayPacket stPacket;
+        uint8_t       au8Buffer[NETPLAY_PACKET_SIZE];
+        size_t        uSize;
+        int64_t       s64Now  = _LocalTime(pstNode, stEvent.dTime);
+
+        _bMeasure = stEvent.dTime > WARMUP_S * 1e6;
+
+        switch (stEvent.nType)
+        {
+            case EVENT_LATCH:
+                // Latch ISR, up to 5 µs late.
+                pstNode->u32Frame++;
+                pstNode->s64Latch = s64Now + (int64_t)(_Random() * 5.0);
+                _PlayoutLatch(&pstNode->stPlayout, pstNode->s64Latch);
+                _Schedule(pstNode->dPhase + pstNode->u32Frame * pstNode->dPeriod, EVENT_LATCH, stEvent.nNode, NULL, 0);
+                _Schedule(stEvent.dTime + 50.0 + _Random() * 250.0, EVENT_SEND, stEvent.nNode, NULL, 0);
+                break;
+
+            case EVENT_SEND:
+                NetplayBuildPacket(&pstNode->stSession, pstNode->u32Frame, (uint16_t)pstNode->u32Frame,
+                                   pstNode->s64Latch, s64Now, &stPacket);
+                uSize = EncodeNetplayPacket(&stPacket, au8Buffer, sizeof(au8Buffer));
+                if ((unsigned int)(_Random() * 100.0) >= NET_LOSS_PERCENT)
+                {
+                    double dDelay = NET_DELAY_US - NET_JITTER_US * log(1.0 - _Random());
+                    _Schedule(stEvent.dTime + dDelay, EVENT_ARRIVE, stEvent.nNode ^ 1, au8Buffer, uSize);
+                }
+
+                ClockSyncAddLocalLatch(&pstNode->stSession.stClock, pstNode->u32Frame, pstNode->s64Latch);
+                if (bAlign && pstNode->stPlayout.bShown)
+                {
+                    pstNode->stPlayout.s8Slip += ClockSyncAlign(&pstNode->stSession.stClock,
+                                                                pstNode->stPlayout.u32Shown,
+                                                                pstNode->stPlayout.s64Shown,
+                                                                REMOTE_DELAY, s64Now);
+                }
+                break;
+
+            case EVENT_ARRIVE:
+                if (DecodeNetplayPacket(&stPacket, stEvent.au8Packet, stEvent.uSize))
+                {
+                    _pstReceiver    = pstNode;
+                    NetplayHandlePacket(&pstNode->stSession, &stPacket, s64Now, _Push);
+                }
+                break;
+        }
+    }
+
+    printf("Simulated:  %.0f s, console skew %.1f ppm, clocks %+.1f/%+.1f ppm, alignment %s\n",
+           dSeconds, dSkewPpm, _astNode[0].dClockPpm, _astNode[1].dClockPpm, bAlign ? "on" : "off");
+
+    for (int nNode = 0; nNode < 2; nNode++)
+    {
+        Node*           pstNode   = &_astNode[nNode];
+        Node*           pstRemote = &_astNode[nNode ^ 1];
+        ClockSync*      pstClock  = &pstNode->stSession.stClock;
+        ClockSyncStats* pstStats  = &pstClock->stStats;
+        double          dNow      = dSeconds * 1e6;
+        double          dDrift    = ((1.0 + pstRemote->dClockPpm * 1e-6) / (1.0 + pstNode->dClockPpm * 1e-6) - 1.0) * 1e9;
+        double          dSkew     = (pstNode->dPeriod / pstRemote->dPeriod - 1.0) * 1e6;
+        int64_t         s64Error  = ClockSyncToLocal(pstClock, _LocalTime(pstRemote, dNow)) - _LocalTime(pstNode, dNow);
+
+        printf("Adapter %c:  offset error %lld us, drift %d ppb (true %.0f), frame skew %d ppm (true %.1f)\n",
+               'A' + nNode, (long long)s64Error, pstStats->s32DriftPpb, dDrift, pstStats->s32FrameSkewPpm, dSkew);
+        printf("            slack %d us, %u slips (%u inserted, %u dropped), %u presented, %u underruns, %u late\n",
+               pstStats->s32Slack, pstStats->u32Slips, pstNode->stPlayout.u32Inserted, pstNode->stPlayout.u32Dropped,
+               pstNode->stPlayout.u32Presented, pstNode->stPlayout.u32Underruns, pstNode->stPlayout.u32Late);
+
+        if (llabs(s64Error) > 500 || fabs(pstStats->s32DriftPpb - dDrift) > 2000.0 || fabs(pstStats->s32FrameSkewPpm - dSkew) > 3.0)
+        {
+            nFailed++;
+        }
+    }
+
+    u32Missed = _u32Missed;
+    printf("Missed:     %u words after %d s warm-up\n", u32Missed, WARMUP_S);
+
+    if (bAlign && (0 != u32Missed || 0 != nFailed))
+    {
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+static double _Random(void)
+{
+    // xorshift64*, reproducible across platforms.
+    _u64Random ^= _u64Random >> 12;
+    _u64Random ^= _u64Random << 25;
+    _u64Random ^= _u64Random >> 27;
+    return (double)((_u64Random * 2685821657736338717ULL) >> 11) / 9007199254740992.0;
+}
+
+static int64_t _LocalTime(const Node* pstNode, double dTime)
+{
+    return (int64_t)(pstNode->dClockOff + dTime * (1.0 + pstNode->dClockPpm * 1e-6));
+}
+
+static void _Schedule(double dTime, int nType, int nNode, const uint8_t* pu8Packet, size_t uSize)
+{
+    Event* pstEvent;
+
+    if (_nEvents >= MAX_EVENTS)
+    {
+        return;
+    }
+
+    pstEvent        = &_astEvent[_nEvents++];
+    pstEvent->dTime = dTime;
+    pstEvent->nType = nType;
+    pstEvent->nNode = nNode;
+    pstEvent->uSize = uSize;
+    if (NULL != pu8Packet)
+    {
+        memcpy(pstEvent->au8Packet, pu8Packet, uSize);
+    }
+}
+
+static bool _NextEvent(Event* pstEvent)
+{
+    int nFirst = 0;
+
+    if (0 == _nEvents)
+    {
+        return false;
+    }
+
+    for (int nIndex = 1; nIndex < _nEvents; nIndex++)
+    {
+        if (_astEvent[nIndex].dTime < _astEvent[nFirst].dTime)
+        {
+            nFirst = nIndex;
+        }
+    }
+
+    *pstEvent          = _astEvent[nFirst];
+    _astEvent[nFirst] = _astEvent[--_nEvents];
+
+    return true;
+}
+
+static void _Push(uint32_t u32Frame, uint16_t u16Data)
+{
+    Playout* pstPlayout = &_pstReceiver->stPlayout;
+    (void)u16Data;
+
+    if (! pstPlayout->bActive)
+    {
+        pstPlayout->bActive   = true;
+        pstPlayout->u32Play   = u32Frame;
+        pstPlayout->u32Newest = u32Frame;
+    }
+    if ((int32_t)(u32Frame - pstPlayout->u32Play) < 0)
+    {
+        pstPlayout->u32Late++;
+        return;
+    }
+    if ((u32Frame - pstPlayout->u32Play) >= QUEUE_SIZE)
+    {
+        pstPlayout->u32Play = u32Frame - REMOTE_DELAY;
+    }
+
+    pstPlayout->abValid[u32Frame % QUEUE_SIZE]   = true;
+    pstPlayout->au32Frame[u32Frame % QUEUE_SIZE] = u32Frame;
+    if ((int32_t)(u32Frame - pstPlayout->u32Newest) > 0)
+    {
+        pstPlayout->u32Newest = u32Frame;
+    }
+    if ((pstPlayout->u32Newest - pstPlayout->u32Play) >= REMOTE_DELAY)
+    {
+        pstPlayout->bPlaying = true;
+    }
+}
+
+static void _PlayoutLatch(Playout* pstPlayout, int64_t s64Now)
+{
+    uint32_t u32Slot;
+
+    if (! pstPlayout->bPlaying)
+    {
+        return;
+    }
+    if (pstPlayout->s8Slip > 0)
+    {
+        pstPlayout->s8Slip--;
+        pstPlayout->u32Inserted++;
+        return;
+    }
+    if (pstPlayout->s8Slip < 0)
+    {
+        pstPlayout->abValid[pstPlayout->u32Play % QUEUE_SIZE] = false;
+        pstPlayout->u32Play++;
+        pstPlayout->s8Slip++;
+        pstPlayout->u32Dropped++;
+    }
+
+    u32Slot = pstPlayout->u32Play % QUEUE_SIZE;
+    if (pstPlayout->abValid[u32Slot] && pstPlayout->au32Frame[u32Slot] == pstPlayout->u32Play)
+    {
+        pstPlayout->abValid[u32Slot] = false;
+        pstPlayout->u32Presented++;
+    }
+    else
+    {
+        pstPlayout->u32Underruns++;
+        if (_bMeasure)
+        {
+            _u32Missed++;
+        }
+    }
+
+    pstPlayout->bShown   = true;
+    pstPlayout->u32Shown = pstPlayout->u32Play;
+    pstPlayout->s64Shown = s64Now;
+    pstPlayout->u32Play++;
+}
@@ -0,0 +1,415 @@
+/**
+ * @file       DebounceSim.c
+ * @brief      Simulation of the input debouncer
+ * @details    First every filter depth is fed glitches of every length
+ *             on random buttons.  Then the depth the firmware derives
+ *             from DEBOUNCE_REJECT_US is fed glitches in time, at a
+ *             random phase to the reads.  Last a noisy controller:
+ *             buttons are held for 50 to 300 ms, bounce for up to 15 ms
+ *             at each edge and every line glitches for single reads at
+ *             a given rate.  The debouncer is the one of the firmware,
+ *             the former three-read vote is shown for comparison.
+ *             Usage:
+ * @code{.unparsed}
+ *   DebounceSim [reads] [glitch permille] [read period µs]
+ * @endcode
+ *             The read period defaults to the one of the firmware,
+ *             DEBOUNCE_PERIOD_US.  Fails if a glitch shorter than the
+ *             filter depth or DEBOUNCE_REJECT_US gets through, if a
+ *             longer one isn't passed on in time, or if a noisy button
+ *             holds back another.
+ * @defgroup   DebounceSim Input debouncer simulation
+ * @ingroup    DebounceSim
+ * @author     SNESoIP contributors
+ * @copyright  "THE BEER-WARE LICENCE" (Revision 42)
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "Debounce.h"
+
+#define HOLD_MIN      50000   // !< Min. µs a button is held or released
+#define HOLD_MAX      300000  // !< Max. µs a button is held or released
+#define BOUNCE_MAX    15000   // !< Max. µs of contact bounce after an edge
+#define VOTE          0       // !< Filter index of the three-read vote
+#define FILTERS       (DEBOUNCE_DEPTH_MAX + 1)
+
+/**
+ * @struct  Result
+ * @brief   Edge statistics of one filter
+ */
+typedef struct Result_t
+{
+    uint32_t u32Edges;     ///< Edges passed on
+    uint32_t u32Missed;    ///< Edges not passed on before the next one
+    uint32_t u32Spurious;  ///< Changes of the output no edge explains
+    uint64_t u64Latency;   ///< Sum of the latencies of all passed edges
+    uint32_t u32MaxLatency;
+
+} Result;
+
+static uint64_t _u64Random = 0x2545f4914f6cdd1dULL;
+
+static uint32_t _Random(uint32_t u32Range);
+static bool     _CheckGlitches(void);
+static bool     _CheckIndependence(void);
+static bool     _CheckReject(uint32_t u32Period);
+static void     _SimulateNoise(uint32_t u32Reads, uint32_t u32Permille, uint32_t u32Period);
+
+int main(int argc, char* argv[])
+{
+    uint32_t u32Reads    = 200000;
+    uint32_t u32Permille = 20;
+    uint32_t u32Period   = DEBOUNCE_PERIOD_US;
+    bool     bOk;
+
+    if (argc > 1)
+    {
+        u32Reads = (uint32_t)atol(argv[1]);
+    }
+    if (argc > 2)
+    {
+        u32Permille = (uint32_t)atol(argv[2]);
+    }
+    if (argc > 3)
+    {
+        u32Period = (uint32_t)atol(argv[3]);
+    }
+    if (0 == u32Period)
+    {
+        printf("Usage: %s [reads] [glitch permille] [read period us]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    bOk  = _CheckGlitches();
+    bOk &= _CheckIndependence();
+    if (bOk)
+    {
+        printf("Glitches shorter than the depth rejected, depths 1 to %d.\n", DEBOUNCE_DEPTH_MAX);
+    }
+    if (_CheckReject(u32Period))
+    {
+        printf("Depth %u at %u us: glitches under %.1f ms rejected, changes passed on after %.1f ms at most.\n\n",
+               DebounceDepth(DEBOUNCE_REJECT_US, u32Period), u32Period,
+               DEBOUNCE_REJECT_US / 1000.0, DebounceDepth(DEBOUNCE_REJECT_US, u32Period) * u32Period / 1000.0);
+    }
+    else
+    {
+        bOk = false;
+    }
+
+    _SimulateNoise(u32Reads, u32Permille, u32Period);
+
+    return bOk ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/**
+ * @fn      uint32_t _Random(uint32_t u32Range)
+ * @brief   xorshift64*
+ * @return  Random number in 0..u32Range-1
+ */
+static uint32_t _Random(uint32_t u32Range)
+{
+    _u64Random ^= _u64Random >> 12;
+    _u64Random ^= _u64Random << 25;
+    _u64Random ^= _u64Random >> 27;
+    return (uint32_t)(((_u64Random * 0x2545f4914f6cdd1dULL) >> 32) % u32Range);
+}
+
+/**
+ * @fn      bool _CheckGlitches(void)
+ * @brief   Feed glitches of 1 to DEBOUNCE_DEPTH_MAX reads to every depth
+ * @return  false if a glitch was handled wrongly
+ */
+static bool _CheckGlitches(void)
+{
+    Debounce stDebounce;
+    bool     bOk = true;
+
+    for (uint8_t u8Depth = 1; u8Depth <= DEBOUNCE_DEPTH_MAX; u8Depth++)
+    {
+        for (uint8_t u8Length = 1; u8Length <= DEBOUNCE_DEPTH_MAX; u8Length++)
+        {
+            for (uint32_t u32Run = 0; u32Run < 1000; u32Run++)
+            {
+                uint16_t u16Base  = (uint16_t)_Random(0x10000);
+                uint16_t u16Mask  = (uint16_t)(_Random(0xffff) + 1);
+                uint16_t u16Out   = u16Base;
+                uint8_t  u8Change = 0;
+
+                InitDebounce(&stDebounce, u16Base, u8Depth);
+                for (uint8_t u8Read = 1; u8Read <= u8Length; u8Read++)
+                {
+                    u16Out = DebounceInput(&stDebounce, u16Base ^ u16Mask);
+                    if (0 == u8Change && u16Out != u16Base)
+                    {
+                        u8Change = u8Read;
+                        if (u16Out != (u16Base ^ u16Mask))
+                        {
+                            printf("Depth %u, glitch of %u: buttons changed apart.\n", u8Depth, u8Length);
+                            bOk = false;
+                        }
+                    }
+                }
+
+                if (u8Length < u8Depth && 0 != u8Change)
+                {
+                    printf("Depth %u: glitch of %u reads got through.\n", u8Depth, u8Length);
+                    return false;
+                }
+                if (u8Length >= u8Depth && u8Change != u8Depth)
+                {
+                    printf("Depth %u: change of %u reads passed on after %u.\n", u8Depth, u8Length, u8Change);
+                    return false;
+                }
+            }
+        }
+    }
+
+    return bOk;
+}
+
+/**
+ * @fn      bool _CheckIndependence(void)
+ * @brief   A button toggling on every read must not hold back another
+ * @return  false if the other button was held back or the noisy one got through
+ */
+static bool _CheckIndependence(void)
+{
+    Debounce stDebounce;
+    uint16_t u16Out = 0;
+
+    for (uint8_t u8Depth = 2; u8Depth <= DEBOUNCE_DEPTH_MAX; u8Depth++)
+    {
+        InitDebounce(&stDebounce, 0x0000, u8Depth);
+        for (uint8_t u8Read = 1; u8Read <= u8Depth; u8Read++)
+        {
+            // Bit 0 pressed for good, bit 1 toggles.
+            u16Out = DebounceInput(&stDebounce, (uint16_t)(0x0001 | ((u8Read & 1) << 1)));
+        }
+        if (0x0001 != u16Out)
+        {
+            printf("Depth %u: noisy button held back another, output %04x.\n", u8Depth, u16Out);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @fn      bool _CheckReject(uint32_t u32Period)
+ * @brief   Feed glitches in time to the depth used by the firmware
+ * @details The glitch starts at a random phase to the reads, so it is
+ *          seen by every number of reads it can cover.  Every glitch
+ *          shorter than DEBOUNCE_REJECT_US must be rejected, every one
+ *          of at least depth periods must be passed on.
+ * @param   u32Period
+ *          Read period in µs
+ * @return  false if a glitch was handled wrongly
+ */
+static bool _CheckReject(uint32_t u32Period)
+{
+    Debounce stDebounce;
+    uint8_t  u8Depth  = DebounceDepth(DEBOUNCE_REJECT_US, u32Period);
+    uint32_t u32Limit = (uint32_t)(u8Depth + 1) * u32Period;
+
+    for (uint32_t u32Length = 100; u32Length <= u32Limit; u32Length += 100)
+    {
+        for (uint32_t u32Run = 0; u32Run < 100; u32Run++)
+        {
+            uint32_t u32Start = _Random(u32Period);
+            bool     bPassed  = false;
+
+            InitDebounce(&stDebounce, 0x0000, u8Depth);
+            for (uint32_t u32Time = 0; u32Time < u32Start + u32Length + u32Limit; u32Time += u32Period)
+            {
+                bool bGlitch = u32Time >= u32Start && u32Time < u32Start + u32Length;
+
+                if (0 != DebounceInput(&stDebounce, bGlitch ? 0x0001 : 0x0000))
+                {
+                    bPassed = true;
+                }
+            }
+
+            if (u32Length < DEBOUNCE_REJECT_US && bPassed)
+            {
+                printf("Depth %u at %u us: glitch of %u us got through.\n", u8Depth, u32Period, u32Length);
+                return false;
+            }
+            if (u32Length >= u8Depth * u32Period && !bPassed)
+            {
+                printf("Depth %u at %u us: change of %u us not passed on.\n", u8Depth, u32Period, u32Length);
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @fn     void _SimulateNoise(uint32_t u32Reads, uint32_t u32Permille, uint32_t u32Period)
+ * @brief  Feed a bouncing, glitching controller to all filters
+ * @param  u32Reads
+ *         Number of reads
+ * @param  u32Permille
+ *         Chance of a single-read glitch per line and read
+ * @param  u32Period
+ *         Read period in µs
+ */
+static void _SimulateNoise(uint32_t u32Reads, uint32_t u32Permille, uint32_t u32Period)
+{
+    Debounce astDebounce[FILTERS];
+    Result   astResult[FILTERS] = { { 0 } };
+    uint16_t au16Out[FILTERS];
+    uint16_t au16Vote[3]        = { 0xffff, 0xffff, 0xffff };
+    uint16_t u16True            = 0xffff;
+    uint32_t au32Hold[16];
+    uint32_t au32Bounce[16]     = { 0 };
+    uint32_t au32Edge[16]       = { 0 };
+    uint32_t au32Pending[FILTERS];  // Bits of edges not passed on yet
+    uint32_t au32Away[FILTERS];     // Bits off the true state without an edge
+    uint32_t u32HoldMin             = HOLD_MIN / u32Period + 1;
+    uint32_t u32HoldRange           = HOLD_MAX / u32Period - u32HoldMin + 2;
+    uint32_t u32BounceRange         = BOUNCE_MAX / u32Period + 1;
+    uint8_t  u8Firmware             = DebounceDepth(DEBOUNCE_REJECT_US, u32Period);
+
+    for (uint8_t u8Filter = 0; u8Filter < FILTERS; u8Filter++)
+    {
+        InitDebounce(&astDebounce[u8Filter], u16True, u8Filter);
+        au16Out[u8Filter]     = u16True;
+        au32Pending[u8Filter] = 0;
+        au32Away[u8Filter]    = 0;
+    }
+    for (uint8_t u8Bit = 0; u8Bit < 16; u8Bit++)
+    {
+        au32Hold[u8Bit] = u32HoldMin + _Random(u32HoldRange);
+    }
+
+    for (uint32_t u32Read = 0; u32Read < u32Reads; u32Read++)
+    {
+        uint16_t u16Sample;
+
+        for (uint8_t u8Bit = 0; u8Bit < 16; u8Bit++)
+        {
+            if (0 == --au32Hold[u8Bit])
+            {
+                u16True ^= (uint16_t)(1 << u8Bit);
+                au32Hold[u8Bit]   = u32HoldMin + _Random(u32HoldRange);
+                au32Bounce[u8Bit] = _Random(u32BounceRange);
+                au32Edge[u8Bit]   = u32Read;
+                for (uint8_t u8Filter = 0; u8Filter < FILTERS; u8Filter++)
+                {
+                    uint32_t u32Bit = 1UL << u8Bit;
+
+                    if (au32Pending[u8Filter] & u32Bit)
+                    {
+                        astResult[u8Filter].u32Missed++;
+                        au32Pending[u8Filter] &= ~u32Bit;
+                    }
+                    else if (au32Away[u8Filter] & u32Bit)
+                    {
+                        au32Away[u8Filter] &= ~u32Bit;
+                    }
+                    else
+                    {
+                        au32Pending[u8Filter] |= u32Bit;
+                    }
+                }
+            }
+        }
+
+        u16Sample = u16True;
+        for (uint8_t u8Bit = 0; u8Bit < 16; u8Bit++)
+        {
+            if (au32Bounce[u8Bit] > 0)
+            {
+                au32Bounce[u8Bit]--;
+                u16Sample ^= (uint16_t)(_Random(2) << u8Bit);
+            }
+            if (_Random(1000) < u32Permille)
+            {
+                u16Sample ^= (uint16_t)(1 << u8Bit);
+            }
+        }
+
+        for (uint8_t u8Filter = 0; u8Filter < FILTERS; u8Filter++)
+        {
+            uint16_t u16Out;
+            uint16_t u16Changed;
+
+            if (VOTE == u8Filter)
+            {
+                au16Vote[u32Read % 3] = u16Sample;
+                u16Out = au16Out[VOTE];
+                if (au16Vote[0] == au16Vote[1] && au16Vote[1] == au16Vote[2])
+                {
+                    u16Out = au16Vote[0];
+                }
+            }
+            else
+            {
+                u16Out = DebounceInput(&astDebounce[u8Filter], u16Sample);
+            }
+
+            u16Changed = u16Out ^ au16Out[u8Filter];
+            for (uint8_t u8Bit = 0; u8Bit < 16; u8Bit++)
+            {
+                uint32_t u32Bit = 1UL << u8Bit;
+
+                if (0 == (u16Changed & u32Bit))
+                {
+                    continue;
+                }
+                if (au32Pending[u8Filter] & u32Bit)
+                {
+                    uint32_t u32Latency = u32Read - au32Edge[u8Bit] + 1;
+
+                    au32Pending[u8Filter] &= ~u32Bit;
+                    astResult[u8Filter].u32Edges++;
+                    astResult[u8Filter].u64Latency += u32Latency;
+                    if (u32Latency > astResult[u8Filter].u32MaxLatency)
+                    {
+                        astResult[u8Filter].u32MaxLatency = u32Latency;
+                    }
+                }
+                else if (au32Away[u8Filter] & u32Bit)
+                {
+                    au32Away[u8Filter] &= ~u32Bit;
+                }
+                else
+                {
+                    au32Away[u8Filter] |= u32Bit;
+                    astResult[u8Filter].u32Spurious++;
+                }
+            }
+            au16Out[u8Filter] = u16Out;
+        }
+    }
+
+    printf("%u reads every %u us, %u permille glitches per line\n", u32Reads, u32Period, u32Permille);
+    printf(" filter   edges  missed  spurious  latency avg/max\n");
+    for (uint8_t u8Filter = 0; u8Filter < FILTERS; u8Filter++)
+    {
+        Result* pstResult = &astResult[u8Filter];
+        double  dAvg      = pstResult->u32Edges ? (double)pstResult->u64Latency / pstResult->u32Edges : 0.0;
+
+        if (VOTE == u8Filter)
+        {
+            printf(" vote  ");
+        }
+        else
+        {
+            printf("%s %u", u8Filter == u8Firmware ? "*depth" : " depth", u8Filter);
+        }
+        printf("%*u %7u %9u  %5.2f/%u reads = %.1f/%.1f ms\n",
+               VOTE == u8Filter ? 9 : 8, pstResult->u32Edges, pstResult->u32Missed,
+               pstResult->u32Spurious, dAvg, pstResult->u32MaxLatency,
+               dAvg * u32Period / 1000.0, (double)pstResult->u32MaxLatency * u32Period / 1000.0);
+    }
+    printf("* depth of the firmware for DEBOUNCE_REJECT_US = %u us\n", DEBOUNCE_REJECT_US);
+}
@@ -0,0 +1,479 @@
+/**
+ * @file       ExchangeSim.c
+ * @brief      Simulation of the exchange client against a stand-in server
+ * @details    The stand-in server speaks the protocol of Server.c.  It
+ *             answers "None" to the first address requests until the
+ *             opponent comes online and splits and merges its messages
+ *             at random, as TCP may do.  The client sends only part of
+ *             its pending message at a time and repeats the request
+ *             like ExchangeClient.c does.  The state machine is the one
+ *             of the firmware.  Random bytes are fed to it as well.
+ *             Finally, the server is down for a while and the
+ *             reconnect delays of a group of adapters are recorded.
+ *             Usage:
+ * @code{.unparsed}
+ *   ExchangeSim [conversations] [adapters]
+ * @endcode
+ *             Fails if a conversation doesn't end with the opponent's
+ *             address, if a bad message isn't rejected, if the receive
+ *             buffer overflows or if a reconnect delay is out of range.
+ * @defgroup   ExchangeSim Exchange client simulation
+ * @ingroup    ExchangeSim
+ * @author     SNESoIP contributors
+ * @copyright  "THE BEER-WARE LICENCE" (Revision 42)
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ExchangeProtocol.h"
+
+#define PIPE_SIZE      256   // !< Bytes in flight per direction
+#define MAX_STEPS      1000  // !< Steps until a conversation counts as stuck
+#define POLL_STEPS     4     // !< Steps per address request, see EXCHANGE_POLL_MS
+#define MAX_OFFLINE    20    // !< Max. requests until the opponent comes online
+#define BUCKET_MS      100   // !< Resolution of the reconnect histogram
+
+/**
+ * @struct  Pipe
+ * @brief   One direction of a TCP connection
+ */
+typedef struct Pipe_t
+{
+    uint8_t au8Data[PIPE_SIZE];  ///< Bytes in flight
+    size_t  uLen;                ///< Number of bytes in flight
+
+} Pipe;
+
+/**
+ * @struct  Server
+ * @brief   Stand-in server state
+ */
+typedef struct Server_t
+{
+    Pipe     stToClient;      ///< Server to client
+    Pipe     stToServer;      ///< Client to server
+    uint8_t  u8ClientID;      ///< ID handed out in "Hello"
+    uint8_t  u8OpponentID;    ///< ID of the opponent
+    uint8_t  au8IpAddr[4];    ///< Address of the opponent
+    uint32_t u32Offline;      ///< Requests answered with "None" before "IPOK"
+    uint32_t u32Requests;     ///< Requests received
+    uint32_t u32Late;         ///< Requests received after "IPOK" had been sent
+    bool     bSentAddr;       ///< "IPOK" has been sent
+    bool     bClosed;         ///< "Cya" has been sent
+
+} Server;
+
+static uint64_t _u64Random = 0x2545f4914f6cdd1dULL;
+
+static uint32_t _Random(uint32_t u32Range);
+static void     _Push(Pipe* pstPipe, const void* pData, size_t uSize);
+static size_t   _Pop(Pipe* pstPipe, uint8_t* pu8Data, size_t uMax);
+static void     _ServerHandle(Server* pstServer);
+static bool     _Converse(uint32_t* pu32Crossed, uint32_t* pu32Steps);
+static bool     _CheckGarbage(uint32_t u32Runs);
+static bool     _CheckBackoff(void);
+static void     _SimulateOutage(uint32_t u32Adapters, uint32_t u32OutageMs);
+
+int main(int argc, char* argv[])
+{
+    uint32_t u32Runs      = 10000;
+    uint32_t u32Adapters  = 100;
+    uint32_t u32Crossed   = 0;
+    uint64_t u64Steps     = 0;
+    uint32_t u32MaxSteps  = 0;
+    uint32_t au32Outage[] = { 1000, 10000, 60000, 600000 };
+    bool     bOk          = true;
+
+    if (argc > 1)
+    {
+        u32Runs = (uint32_t)atol(argv[1]);
+    }
+    if (argc > 2)
+    {
+        u32Adapters = (uint32_t)atol(argv[2]);
+    }
+    if (0 == u32Runs)
+    {
+        u32Runs = 1;
+    }
+    if (0 == u32Adapters)
+    {
+        u32Adapters = 1;
+    }
+
+    for (uint32_t u32Run = 0; u32Run < u32Runs && bOk; u32Run++)
+    {
+        uint32_t u32Steps = 0;
+
+        bOk &= _Converse(&u32Crossed, &u32Steps);
+        u64Steps += u32Steps;
+        if (u32Steps > u32MaxSteps)
+        {
+            u32MaxSteps = u32Steps;
+        }
+    }
+    if (bOk)
+    {
+        printf("%u conversations with fragmented messages completed, %.1f steps avg, %u max,\n"
+               "in %u of them an answer crossed the client's Bye.\n",
+               u32Runs, (double)u64Steps / u32Runs, u32MaxSteps, u32Crossed);
+    }
+
+    bOk &= _CheckGarbage(u32Runs * 10);
+    bOk &= _CheckBackoff();
+
+    printf("\n%u adapters lose the server at once\n", u32Adapters);
+    printf("outage s  attempts avg  back after avg/max s  peak per %u ms\n", BUCKET_MS);
+    for (uint8_t u8Index = 0; u8Index < sizeof(au32Outage) / sizeof(au32Outage[0]); u8Index++)
+    {
+        _SimulateOutage(u32Adapters, au32Outage[u8Index]);
+    }
+
+    return bOk ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/**
+ * @fn      uint32_t _Random(uint32_t u32Range)
+ * @brief   xorshift64*
+ * @return  Random number in 0..u32Range-1
+ */
+static uint32_t _Random(uint32_t u32Range)
+{
+    _u64Random ^= _u64Random >> 12;
+    _u64Random ^= _u64Random << 25;
+    _u64Random ^= _u64Random >> 27;
+    return (uint32_t)(((_u64Random * 0x2545f4914f6cdd1dULL) >> 32) % u32Range);
+}
+
+/**
+ * @fn     void _Push(Pipe* pstPipe, const void* pData, size_t uSize)
+ * @brief  Send bytes into a pipe
+ */
+static void _Push(Pipe* pstPipe, const void* pData, size_t uSize)
+{
+    if (pstPipe->uLen + uSize > PIPE_SIZE)
+    {
+        return;
+    }
+    memcpy(&pstPipe->au8Data[pstPipe->uLen], pData, uSize);
+    pstPipe->uLen += uSize;
+}
+
+/**
+ * @fn      size_t _Pop(Pipe* pstPipe, uint8_t* pu8Data, size_t uMax)
+ * @brief   Receive a random number of bytes, like recv() on a stream
+ * @return  Number of bytes received
+ */
+static size_t _Pop(Pipe* pstPipe, uint8_t* pu8Data, size_t uMax)
+{
+    size_t uSize;
+
+    if (0 == pstPipe->uLen)
+    {
+        return 0;
+    }
+    uSize = 1 + _Random((uint32_t)(pstPipe->uLen < uMax ? pstPipe->uLen : uMax));
+    memcpy(pu8Data, pstPipe->au8Data, uSize);
+    memmove(pstPipe->au8Data, &pstPipe->au8Data[uSize], pstPipe->uLen - uSize);
+    pstPipe->uLen -= uSize;
+    return uSize;
+}
+
+/**
+ * @fn       void _ServerHandle(Server* pstServer)
+ * @brief    Answer all complete client messages
+ * @details  Messages end with <LF>.  Unlike Server.c, which expects
+ *           one message per recv(), the stand-in reassembles them.
+ */
+static void _ServerHandle(Server* pstServer)
+{
+    Pipe*    pstRx = &pstServer->stToServer;
+    uint8_t* pu8End;
+
+    while (NULL != (pu8End = memchr(pstRx->au8Data, '\n', pstRx->uLen)))
+    {
+        size_t uSize = (size_t)(pu8End - pstRx->au8Data) + 1;
+
+        if (7 == uSize && 0 == memcmp(pstRx->au8Data, "GetIP\r\n", 7))
+        {
+            pstServer->u32Requests++;
+            if (pstServer->bSentAddr)
+            {
+                pstServer->u32Late++;
+            }
+            if (pstServer->u32Requests > pstServer->u32Offline)
+            {
+                uint8_t au8Msg[11] = { 'I', 'P', 'O', 'K', 0, 0, 0, 0, 0, '\r', '\n' };
+
+                au8Msg[4] = pstServer->u8OpponentID;
+                memcpy(&au8Msg[5], pstServer->au8IpAddr, 4);
+                _Push(&pstServer->stToClient, au8Msg, sizeof(au8Msg));
+                pstServer->bSentAddr = true;
+            }
+            else
+            {
+                _Push(&pstServer->stToClient, "None\r\n", 6);
+            }
+        }
+        else if (5 == uSize && 0 == memcmp(pstRx->au8Data, "Bye\r\n", 5))
+        {
+            _Push(&pstServer->stToClient, "Cya\r\n", 5);
+            pstServer->bClosed = true;
+        }
+        else
+        {
+            printf("Server received an unknown message of %zu bytes.\n", uSize);
+        }
+
+        memmove(pstRx->au8Data, &pstRx->au8Data[uSize], pstRx->uLen - uSize);
+        pstRx->uLen -= uSize;
+    }
+}
+
+/**
+ * @fn      bool _Converse(uint32_t* pu32Crossed, uint32_t* pu32Steps)
+ * @brief   Run one conversation with random fragmentation
+ * @param   pu32Crossed
+ *          Incremented if an answer arrived after the client's Bye
+ * @param   pu32Steps
+ *          Steps the conversation took
+ * @return  false if the conversation failed
+ */
+static bool _Converse(uint32_t* pu32Crossed, uint32_t* pu32Steps)
+{
+    static Server stServer;
+    Exchange      stExchange;
+    uint8_t       au8Buffer[EXCHANGE_RX_SIZE];
+    uint8_t       au8Hello[10] = { 'H', 'e', 'l', 'l', 'o', 0, '\r', '\n', 0, 0 };
+
+    memset(&stServer, 0, sizeof(stServer));
+    stServer.u8ClientID   = (uint8_t)_Random(256);
+    stServer.u8OpponentID = (uint8_t)_Random(256);
+    stServer.u32Offline   = _Random(MAX_OFFLINE + 1);
+    for (uint8_t u8Index = 0; u8Index < 4; u8Index++)
+    {
+        stServer.au8IpAddr[u8Index] = (uint8_t)(1 + _Random(255));
+    }
+    au8Hello[5] = stServer.u8ClientID;
+    _Push(&stServer.stToClient, au8Hello, sizeof(au8Hello));
+    InitExchange(&stExchange);
+
+    for (uint32_t u32Step = 1; u32Step <= MAX_STEPS; u32Step++)
+    {
+        ExchangeStage eStage = stExchange.eStage;
+        size_t        uSize;
+
+        *pu32Steps = u32Step;
+
+        // _HandleReceive()
+        uSize = _Pop(&stServer.stToClient, au8Buffer, sizeof(au8Buffer));
+        if (uSize > 0)
+        {
+            ExchangeReceive(&stExchange, au8Buffer, uSize);
+        }
+        if (stExchange.uRxLen >= EXCHANGE_RX_SIZE)
+        {
+            printf("Receive buffer overflow.\n");
+            return false;
+        }
+        if (EXCHANGE_STAGE_ERROR == stExchange.eStage)
+        {
+            printf("Valid server message rejected in stage %d.\n", eStage);
+            return false;
+        }
+        if (EXCHANGE_STAGE_DONE == stExchange.eStage)
+        {
+            if (stExchange.u8ClientID   != stServer.u8ClientID ||
+                stExchange.u8OpponentID != stServer.u8OpponentID ||
+                0 != memcmp(stExchange.au8IpAddr, stServer.au8IpAddr, 4))
+            {
+                printf("Conversation ended with the wrong IDs or address.\n");
+                return false;
+            }
+            if (stServer.u32Late > 0)
+            {
+                (*pu32Crossed)++;
+            }
+            return true;
+        }
+
+        if (0 == u32Step % POLL_STEPS)
+        {
+            ExchangePoll(&stExchange);
+        }
+
+        // _HandleSend(), the socket may take only part of the message.
+        if (stExchange.uTxLen > 0)
+        {
+            uSize = 1 + _Random((uint32_t)stExchange.uTxLen);
+            _Push(&stServer.stToServer, stExchange.au8Tx, uSize);
+            ExchangeSent(&stExchange, uSize);
+        }
+        _ServerHandle(&stServer);
+    }
+
+    printf("Conversation stuck in stage %d.\n", stExchange.eStage);
+    return false;
+}
+
+/**
+ * @fn       bool _CheckGarbage(uint32_t u32Runs)
+ * @brief    Feed random bytes and messages out of order
+ * @details  Bytes are drawn mostly from the message alphabet, so valid
+ *           prefixes occur often.
+ * @return   false if the receive buffer overflowed or a message out of
+ *           order was accepted
+ */
+static bool _CheckGarbage(uint32_t u32Runs)
+{
+    static const char* apacOrder[] = { "Cya\r\n", "None\r\n", "IPOK\x01\x02\x03\x04\x05\r\n" };
+    const char*        pacAlphabet = "HelloIPOKNoneCya\r\n";
+    Exchange           stExchange;
+    uint32_t           u32Rejected = 0;
+
+    for (uint32_t u32Run = 0; u32Run < u32Runs; u32Run++)
+    {
+        uint8_t au8Data[64];
+        size_t  uSize = 1 + _Random(sizeof(au8Data));
+
+        for (size_t uIndex = 0; uIndex < uSize; uIndex++)
+        {
+            if (_Random(4))
+            {
+                au8Data[uIndex] = (uint8_t)pacAlphabet[_Random((uint32_t)strlen(pacAlphabet))];
+            }
+            else
+            {
+                au8Data[uIndex] = (uint8_t)_Random(256);
+            }
+        }
+
+        InitExchange(&stExchange);
+        for (size_t uIndex = 0; uIndex < uSize; uIndex++)
+        {
+            ExchangeReceive(&stExchange, &au8Data[uIndex], 1);
+            if (stExchange.uRxLen >= EXCHANGE_RX_SIZE)
+            {
+                printf("Receive buffer overflow.\n");
+                return false;
+            }
+        }
+        if (EXCHANGE_STAGE_ERROR == stExchange.eStage)
+        {
+            u32Rejected++;
+        }
+    }
+
+    // Anything but "Hello" first is an error.
+    for (uint8_t u8Index = 0; u8Index < sizeof(apacOrder) / sizeof(apacOrder[0]); u8Index++)
+    {
+        InitExchange(&stExchange);
+        ExchangeReceive(&stExchange, (const uint8_t*)apacOrder[u8Index], strlen(apacOrder[u8Index]));
+        if (EXCHANGE_STAGE_ERROR != stExchange.eStage)
+        {
+            printf("\"%.4s\" accepted before \"Hello\".\n", apacOrder[u8Index]);
+            return false;
+        }
+    }
+
+    printf("%u random byte sequences, %u rejected, no overflow.\n", u32Runs, u32Rejected);
+    return true;
+}
+
+/**
+ * @fn      bool _CheckBackoff(void)
+ * @brief   Check the range of ExchangeBackoff() for every attempt
+ * @return  false if a delay is out of range
+ */
+static bool _CheckBackoff(void)
+{
+    uint32_t u32Max = EXCHANGE_BACKOFF_MIN_MS;
+
+    for (uint16_t u16Attempt = 0; u16Attempt < 256; u16Attempt++)
+    {
+        for (uint32_t u32Run = 0; u32Run < 1000; u32Run++)
+        {
+            uint32_t u32Delay = ExchangeBackoff((uint8_t)u16Attempt, (uint32_t)_Random(UINT32_MAX));
+
+            if (u32Delay < u32Max / 2 || u32Delay > u32Max)
+            {
+                printf("Attempt %u: delay of %u ms outside %u..%u ms.\n",
+                       u16Attempt, u32Delay, u32Max / 2, u32Max);
+                return false;
+            }
+        }
+        if (u32Max < EXCHANGE_BACKOFF_MAX_MS)
+        {
+            u32Max *= 2;
+            if (u32Max > EXCHANGE_BACKOFF_MAX_MS)
+            {
+                u32Max = EXCHANGE_BACKOFF_MAX_MS;
+            }
+        }
+    }
+
+    printf("Reconnect delays within range, %u to %u ms.\n", EXCHANGE_BACKOFF_MIN_MS, EXCHANGE_BACKOFF_MAX_MS);
+    return true;
+}
+
+/**
+ * @fn       void _SimulateOutage(uint32_t u32Adapters, uint32_t u32OutageMs)
+ * @brief    All adapters lose the server at the same time
+ * @details  Each adapter retries after _Backoff() like the client
+ *           thread; a refused connection fails at once.  Reported are
+ *           the attempts, the time between the server's return and the
+ *           reconnect and the most reconnects within one BUCKET_MS.
+ * @param    u32Adapters
+ *           Number of adapters
+ * @param    u32OutageMs
+ *           Time the server is down in ms
+ */
+static void _SimulateOutage(uint32_t u32Adapters, uint32_t u32OutageMs)
+{
+    uint32_t au32Bucket[EXCHANGE_BACKOFF_MAX_MS / BUCKET_MS + 1] = { 0 };
+    uint64_t u64Attempts = 0;
+    uint64_t u64Lag      = 0;
+    uint32_t u32MaxLag   = 0;
+    uint32_t u32Peak     = 0;
+
+    for (uint32_t u32Adapter = 0; u32Adapter < u32Adapters; u32Adapter++)
+    {
+        uint64_t u64Time   = 0;
+        uint8_t  u8Attempt = 0;
+        uint32_t u32Lag;
+
+        while (u64Time < u32OutageMs)
+        {
+            u64Time += ExchangeBackoff(u8Attempt, (uint32_t)_Random(UINT32_MAX));
+            if (u8Attempt < 0xff)
+            {
+                u8Attempt++;
+            }
+            u64Attempts++;
+        }
+
+        u32Lag  = (uint32_t)(u64Time - u32OutageMs);
+        u64Lag += u32Lag;
+        if (u32Lag > u32MaxLag)
+        {
+            u32MaxLag = u32Lag;
+        }
+        au32Bucket[u32Lag / BUCKET_MS]++;
+    }
+
+    for (uint32_t u32Index = 0; u32Index < sizeof(au32Bucket) / sizeof(au32Bucket[0]); u32Index++)
+    {
+        if (au32Bucket[u32Index] > u32Peak)
+        {
+            u32Peak = au32Bucket[u32Index];
+        }
+    }
+
+    printf("%8.0f %13.1f %10.2f/%-9.2f %15u\n",
+           u32OutageMs / 1000.0, (double)u64Attempts / u32Adapters,
+           (double)u64Lag / u32Adapters / 1000.0, u32MaxLag / 1000.0, u32Peak);
+}
@@ -0,0 +1,58 @@
+/**
+ * @file       Host.h
+ * @brief      Virtual adapter
+ * @details    Set-up of the emulated hardware around the firmware
+ * @ingroup    HostFirmware
+ * @author     SNESoIP contributors
+ * @copyright  "THE BEER-WARE LICENCE" (Revision 42)
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+#define HOST_MAX_TASKS        48     // !< Max. number of tasks alive at a time
+#define HOST_FRAME_PERIOD_US  16639  // !< NTSC latch period of the virtual console
+#define HOST_PAD_STEP_MS      500    // !< Button change interval of the demo pattern
+
+#ifndef HOST_WIFI_SSID
+#define HOST_WIFI_SSID        "SNESoIP-Host"  // !< Name of the virtual access point
+#endif
+
+#define HOST_WIFI_CHANNEL     6      // !< Channel of the virtual access point
+#define HOST_WIFI_FAST_MS     150    // !< Connection time with stored BSSID and channel
+#define HOST_WIFI_SCAN_MS     1500   // !< Connection time after a full scan
+#define HOST_WIFI_SC_MS       2000   // !< Time until SmartConfig hands out credentials
+
+/**
+ * @typedef  HostConsoleStats
+ * @brief    What the virtual console saw
+ * @struct   HostConsoleStats_t
+ * @brief    Virtual console statistics structure
+ */
+typedef struct HostConsoleStats_t
+{
+    uint32_t u32Frames;          ///< Latch pulses sent to both ports
+    uint32_t au32Words[2];       ///< Words shifted in per port
+    uint32_t au32Empty[2];       ///< Latches without an armed transaction per port
+    uint32_t au32Changes[2];     ///< Word changes seen per port
+    uint16_t au16Last[2];        ///< Last word seen per port
+    uint32_t u32Captures;        ///< Controller reads by the adapter
+    uint32_t u32LatchMax;        ///< Max. latch period deviation in µs
+
+} HostConsoleStats;
+
+void HostInit(bool bRealtime);
+void HostSetWiFiSSID(const char* pacSSID);
+void HostStartConsole(uint32_t u32FramePeriodUs);
+void HostSetPad(bool bDemo, uint16_t u16Word);
+void HostGetConsoleStats(HostConsoleStats* pstStats);
+
+// Shared by the parts of the virtual adapter.
+void HostInitRTOS(bool bRealtime);
+void HostInitESP(void);
+void HostInitSNES(void);
+void HostTimeToSpec(int64_t s64Time, struct timespec* pstSpec);
+void HostStartISRThread(void* (*pfnThread)(void*), const char* pacName);
+void HostEnterISR(int nCore);
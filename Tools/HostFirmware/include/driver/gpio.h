@@ -0,0 +1,163 @@
+/**
+ * @file       gpio.h
+ * @brief      GPIO driver of the virtual adapter
+ * @details    Interrupt handlers are called by the virtual console,
+ *             see HostSNES.c.
+ * @ingroup    HostFirmware
+ * @author     SNESoIP contributors
+ * @copyright  "THE BEER-WARE LICENCE" (Revision 42)
+ */
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_intr_alloc.h"
+#include "soc/gpio_struct.h"
+
+#define GPIO_PIN_COUNT 40
+
+typedef enum
+{
+    GPIO_NUM_0 = 0,
+    GPIO_NUM_1 = 1,
+    GPIO_NUM_2 = 2,
+    GPIO_NUM_3 = 3,
+    GPIO_NUM_4 = 4,
+    GPIO_NUM_5 = 5,
+    GPIO_NUM_6 = 6,
+    GPIO_NUM_7 = 7,
+    GPIO_NUM_8 = 8,
+    GPIO_NUM_9 = 9,
+    GPIO_NUM_10 = 10,
+    GPIO_NUM_11 = 11,
+    GPIO_NUM_12 = 12,
+    GPIO_NUM_13 = 13,
+    GPIO_NUM_14 = 14,
+    GPIO_NUM_15 = 15,
+    GPIO_NUM_16 = 16,
+    GPIO_NUM_17 = 17,
+    GPIO_NUM_18 = 18,
+    GPIO_NUM_19 = 19,
+    GPIO_NUM_20 = 20,
+    GPIO_NUM_21 = 21,
+    GPIO_NUM_22 = 22,
+    GPIO_NUM_23 = 23,
+    GPIO_NUM_24 = 24,
+    GPIO_NUM_25 = 25,
+    GPIO_NUM_26 = 26,
+    GPIO_NUM_27 = 27,
+    GPIO_NUM_28 = 28,
+    GPIO_NUM_29 = 29,
+    GPIO_NUM_30 = 30,
+    GPIO_NUM_31 = 31,
+    GPIO_NUM_32 = 32,
+    GPIO_NUM_33 = 33,
+    GPIO_NUM_34 = 34,
+    GPIO_NUM_35 = 35,
+    GPIO_NUM_36 = 36,
+    GPIO_NUM_37 = 37,
+    GPIO_NUM_38 = 38,
+    GPIO_NUM_39 = 39,
+    GPIO_NUM_MAX
+
+} gpio_num_t;
+
+#define GPIO_SEL_0  ((uint64_t)1 << 0)
+#define GPIO_SEL_1  ((uint64_t)1 << 1)
+#define GPIO_SEL_2  ((uint64_t)1 << 2)
+#define GPIO_SEL_3  ((uint64_t)1 << 3)
+#define GPIO_SEL_4  ((uint64_t)1 << 4)
+#define GPIO_SEL_5  ((uint64_t)1 << 5)
+#define GPIO_SEL_6  ((uint64_t)1 << 6)
+#define GPIO_SEL_7  ((uint64_t)1 << 7)
+#define GPIO_SEL_8  ((uint64_t)1 << 8)
+#define GPIO_SEL_9  ((uint64_t)1 << 9)
+#define GPIO_SEL_10 ((uint64_t)1 << 10)
+#define GPIO_SEL_11 ((uint64_t)1 << 11)
+#define GPIO_SEL_12 ((uint64_t)1 << 12)
+#define GPIO_SEL_13 ((uint64_t)1 << 13)
+#define GPIO_SEL_14 ((uint64_t)1 << 14)
+#define GPIO_SEL_15 ((uint64_t)1 << 15)
+#define GPIO_SEL_16 ((uint64_t)1 << 16)
+#define GPIO_SEL_17 ((uint64_t)1 << 17)
+#define GPIO_SEL_18 ((uint64_t)1 << 18)
+#define GPIO_SEL_19 ((uint64_t)1 << 19)
+#define GPIO_SEL_20 ((uint64_t)1 << 20)
+#define GPIO_SEL_21 ((uint64_t)1 << 21)
+#define GPIO_SEL_22 ((uint64_t)1 << 22)
+#define GPIO_SEL_23 ((uint64_t)1 << 23)
+#define GPIO_SEL_24 ((uint64_t)1 << 24)
+#define GPIO_SEL_25 ((uint64_t)1 << 25)
+#define GPIO_SEL_26 ((uint64_t)1 << 26)
+#define GPIO_SEL_27 ((uint64_t)1 << 27)
+#define GPIO_SEL_28 ((uint64_t)1 << 28)
+#define GPIO_SEL_29 ((uint64_t)1 << 29)
+#define GPIO_SEL_30 ((uint64_t)1 << 30)
+#define GPIO_SEL_31 ((uint64_t)1 << 31)
+#define GPIO_SEL_32 ((uint64_t)1 << 32)
+#define GPIO_SEL_33 ((uint64_t)1 << 33)
+#define GPIO_SEL_34 ((uint64_t)1 << 34)
+#define GPIO_SEL_35 ((uint64_t)1 << 35)
+#define GPIO_SEL_36 ((uint64_t)1 << 36)
+#define GPIO_SEL_37 ((uint64_t)1 << 37)
+#define GPIO_SEL_38 ((uint64_t)1 << 38)
+#define GPIO_SEL_39 ((uint64_t)1 << 39)
+
+typedef enum
+{
+    GPIO_INTR_DISABLE = 0,
+    GPIO_INTR_POSEDGE,
+    GPIO_INTR_NEGEDGE,
+    GPIO_INTR_ANYEDGE,
+    GPIO_INTR_LOW_LEVEL,
+    GPIO_INTR_HIGH_LEVEL,
+    GPIO_INTR_MAX
+
+} gpio_int_type_t;
+
+#define GPIO_PIN_INTR_DISABLE GPIO_INTR_DISABLE
+
+typedef enum
+{
+    GPIO_MODE_DISABLE = 0,
+    GPIO_MODE_INPUT,
+    GPIO_MODE_OUTPUT,
+    GPIO_MODE_OUTPUT_OD,
+    GPIO_MODE_INPUT_OUTPUT_OD,
+    GPIO_MODE_INPUT_OUTPUT
+
+} gpio_mode_t;
+
+typedef enum
+{
+    GPIO_PULLUP_DISABLE = 0,
+    GPIO_PULLUP_ENABLE
+
+} gpio_pullup_t;
+
+typedef enum
+{
+    GPIO_PULLDOWN_DISABLE = 0,
+    GPIO_PULLDOWN_ENABLE
+
+} gpio_pulldown_t;
+
+typedef struct
+{
+    uint64_t        pin_bit_mask;
+    gpio_mode_t     mode;
+    gpio_pullup_t   pull_up_en;
+    gpio_pulldown_t pull_down_en;
+    gpio_int_type_t intr_type;
+
+} gpio_config_t;
+
+typedef void (*gpio_isr_t)(void* pArg);
+
+esp_err_t gpio_config(const gpio_config_t* pstConfig);
+esp_err_t gpio_set_intr_type(gpio_num_t eGPIO, gpio_int_type_t eType);
+esp_err_t gpio_install_isr_service(int nFlags);
+esp_err_t gpio_isr_handler_add(gpio_num_t eGPIO, gpio_isr_t pfnHandler, void* pArg);
+esp_err_t gpio_isr_handler_remove(gpio_num_t eGPIO);
+esp_err_t gpio_set_level(gpio_num_t eGPIO, uint32_t u32Level);
+int       gpio_get_level(gpio_num_t eGPIO);
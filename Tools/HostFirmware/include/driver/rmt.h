@@ -0,0 +1,111 @@
+/**
+ * @file       rmt.h
+ * @brief      RMT driver of the virtual adapter
+ * @details    The transmitter channels that drive the controller latch
+ *             and clock lines clock the virtual controller, see
+ *             HostSNES.c.  Receiver channels stay idle.
+ * @ingroup    HostFirmware
+ * @author     SNESoIP contributors
+ * @copyright  "THE BEER-WARE LICENCE" (Revision 42)
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "driver/gpio.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/ringbuf.h"
+
+typedef enum
+{
+    RMT_CHANNEL_0 = 0,
+    RMT_CHANNEL_1,
+    RMT_CHANNEL_2,
+    RMT_CHANNEL_3,
+    RMT_CHANNEL_4,
+    RMT_CHANNEL_5,
+    RMT_CHANNEL_6,
+    RMT_CHANNEL_7,
+    RMT_CHANNEL_MAX
+
+} rmt_channel_t;
+
+typedef enum
+{
+    RMT_MODE_TX = 0,
+    RMT_MODE_RX,
+    RMT_MODE_MAX
+
+} rmt_mode_t;
+
+typedef enum
+{
+    RMT_IDLE_LEVEL_LOW = 0,
+    RMT_IDLE_LEVEL_HIGH
+
+} rmt_idle_level_t;
+
+typedef enum
+{
+    RMT_CARRIER_LEVEL_LOW = 0,
+    RMT_CARRIER_LEVEL_HIGH
+
+} rmt_carrier_level_t;
+
+typedef struct
+{
+    bool                loop_en;
+    uint32_t            carrier_freq_hz;
+    uint8_t             carrier_duty_percent;
+    rmt_carrier_level_t carrier_level;
+    bool                carrier_en;
+    rmt_idle_level_t    idle_level;
+    bool                idle_output_en;
+
+} rmt_tx_config_t;
+
+typedef struct
+{
+    bool     filter_en;
+    uint8_t  filter_ticks_thresh;
+    uint16_t idle_threshold;
+
+} rmt_rx_config_t;
+
+typedef struct
+{
+    rmt_mode_t    rmt_mode;
+    rmt_channel_t channel;
+    uint8_t       clk_div;
+    gpio_num_t    gpio_num;
+    uint8_t       mem_block_num;
+    union
+    {
+        rmt_tx_config_t tx_config;
+        rmt_rx_config_t rx_config;
+    };
+
+} rmt_config_t;
+
+typedef struct
+{
+    union
+    {
+        struct
+        {
+            uint32_t duration0 : 15;
+            uint32_t level0    : 1;
+            uint32_t duration1 : 15;
+            uint32_t level1    : 1;
+        };
+        uint32_t val;
+    };
+
+} rmt_item32_t;
+
+esp_err_t rmt_config(const rmt_config_t* pstConfig);
+esp_err_t rmt_driver_install(rmt_channel_t eChannel, size_t uRxBufSize, int nFlags);
+esp_err_t rmt_get_ringbuf_handle(rmt_channel_t eChannel, RingbufHandle_t* phRingbuf);
+esp_err_t rmt_rx_start(rmt_channel_t eChannel, bool bReset);
+esp_err_t rmt_write_items(rmt_channel_t eChannel, const rmt_item32_t* pstItems, int nItems, bool bWait);
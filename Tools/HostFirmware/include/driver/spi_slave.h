@@ -0,0 +1,70 @@
+/**
+ * @file       spi_slave.h
+ * @brief      SPI slave driver of the virtual adapter
+ * @details    Transactions are shifted out by the latches of the
+ *             virtual console, see HostSNES.c.
+ * @ingroup    HostFirmware
+ * @author     SNESoIP contributors
+ * @copyright  "THE BEER-WARE LICENCE" (Revision 42)
+ */
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_intr_alloc.h"
+#include "freertos/FreeRTOS.h"
+
+#define SPICOMMON_BUSFLAG_SLAVE 0
+#define SPI_SLAVE_TXBIT_LSBFIRST (1 << 0)
+#define SPI_SLAVE_RXBIT_LSBFIRST (1 << 1)
+#define SPI_SLAVE_BIT_LSBFIRST   (SPI_SLAVE_TXBIT_LSBFIRST | SPI_SLAVE_RXBIT_LSBFIRST)
+
+typedef enum
+{
+    SPI_HOST = 0,
+    HSPI_HOST,
+    VSPI_HOST,
+    SPI_HOST_MAX
+
+} spi_host_device_t;
+
+typedef struct
+{
+    int      mosi_io_num;
+    int      miso_io_num;
+    int      sclk_io_num;
+    int      quadwp_io_num;
+    int      quadhd_io_num;
+    int      max_transfer_sz;
+    uint32_t flags;
+    int      intr_flags;
+
+} spi_bus_config_t;
+
+typedef struct spi_slave_transaction_t spi_slave_transaction_t;
+typedef void (*slave_transaction_cb_t)(spi_slave_transaction_t* pstTrans);
+
+typedef struct
+{
+    int                    spics_io_num;
+    uint32_t               flags;
+    int                    queue_size;
+    uint8_t                mode;
+    slave_transaction_cb_t post_setup_cb;
+    slave_transaction_cb_t post_trans_cb;
+
+} spi_slave_interface_config_t;
+
+struct spi_slave_transaction_t
+{
+    size_t      length;     ///< Transaction length in bits
+    size_t      trans_len;  ///< Bits actually shifted
+    const void* tx_buffer;
+    void*       rx_buffer;
+    void*       user;
+};
+
+esp_err_t spi_slave_initialize(spi_host_device_t eHost, const spi_bus_config_t* pstBus, const spi_slave_interface_config_t* pstIf, int nDMA);
+esp_err_t spi_slave_queue_trans(spi_host_device_t eHost, const spi_slave_transaction_t* pstTrans, TickType_t xTicks);
+esp_err_t spi_slave_get_trans_result(spi_host_device_t eHost, spi_slave_transaction_t** ppstTrans, TickType_t xTicks);
@@ -0,0 +1,12 @@
+/**
+ * @file       esp_attr.h
+ * @brief      ESP-IDF memory placement attributes
+ * @details    Everything is in one address space on the host.
+ * @ingroup    HostFirmware
+ * @author     SNESoIP contributors
+ * @copyright  "THE BEER-WARE LICENCE" (Revision 42)
+ */
+#pragma once
+
+#define IRAM_ATTR
+#define DRAM_ATTR
@@ -0,0 +1,36 @@
+/**
+ * @file       esp_err.h
+ * @brief      ESP-IDF error codes
+ * @ingroup    HostFirmware
+ * @author     SNESoIP contributors
+ * @copyright  "THE BEER-WARE LICENCE" (Revision 42)
+ */
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+
+typedef int esp_err_t;
+
+#define ESP_OK                      0
+#define ESP_FAIL                    -1
+#define ESP_ERR_NO_MEM              0x101
+#define ESP_ERR_INVALID_ARG         0x102
+#define ESP_ERR_INVALID_STATE       0x103
+#define ESP_ERR_INVALID_SIZE        0x104
+#define ESP_ERR_NOT_FOUND           0x105
+#define ESP_ERR_TIMEOUT             0x107
+#define ESP_ERR_NVS_NOT_FOUND       0x1102
+#define ESP_ERR_NVS_INVALID_LENGTH  0x110c
+#define ESP_ERR_WIFI_NOT_CONNECT    0x300f
+
+#define ESP_ERROR_CHECK(x) do                                              \
+    {                                                                      \
+        esp_err_t eRc = (x);                                               \
+        if (ESP_OK != eRc)                                                 \
+        {                                                                  \
+            fprintf(stderr, "ESP_ERROR_CHECK failed: 0x%x at %s:%d (%s)\n", \
+                    eRc, __FILE__, __LINE__, #x);                          \
+            abort();                                                       \
+        }                                                                  \
+    } while (0)
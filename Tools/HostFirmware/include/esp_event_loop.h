@@ -0,0 +1,47 @@
+/**
+ * @file       esp_event_loop.h
+ * @brief      ESP-IDF system event loop
+ * @ingroup    HostFirmware
+ * @author     SNESoIP contributors
+ * @copyright  "THE BEER-WARE LICENCE" (Revision 42)
+ */
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+
+typedef enum
+{
+    SYSTEM_EVENT_STA_START = 0,
+    SYSTEM_EVENT_STA_CONNECTED,
+    SYSTEM_EVENT_STA_DISCONNECTED,
+    SYSTEM_EVENT_STA_GOT_IP,
+    SYSTEM_EVENT_MAX
+
+} system_event_id_t;
+
+typedef struct
+{
+    uint8_t ssid[32];
+    uint8_t ssid_len;
+    uint8_t bssid[6];
+    uint8_t reason;
+
+} system_event_sta_disconnected_t;
+
+typedef union
+{
+    system_event_sta_disconnected_t disconnected;
+
+} system_event_info_t;
+
+typedef struct
+{
+    system_event_id_t   event_id;
+    system_event_info_t event_info;
+
+} system_event_t;
+
+typedef esp_err_t (*system_event_cb_t)(void* pCtx, system_event_t* pstEvent);
+
+esp_err_t esp_event_loop_init(system_event_cb_t pfnCallback, void* pCtx);
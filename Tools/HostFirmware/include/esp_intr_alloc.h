@@ -0,0 +1,10 @@
+/**
+ * @file       esp_intr_alloc.h
+ * @brief      ESP-IDF interrupt allocation flags
+ * @ingroup    HostFirmware
+ * @author     SNESoIP contributors
+ * @copyright  "THE BEER-WARE LICENCE" (Revision 42)
+ */
+#pragma once
+
+#define ESP_INTR_FLAG_IRAM (1 << 10)
@@ -0,0 +1,16 @@
+/**
+ * @file       esp_system.h
+ * @brief      ESP-IDF system functions
+ * @ingroup    HostFirmware
+ * @author     SNESoIP contributors
+ * @copyright  "THE BEER-WARE LICENCE" (Revision 42)
+ */
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+
+uint32_t esp_random(void);
+uint32_t esp_get_free_heap_size(void);
+uint32_t esp_get_minimum_free_heap_size(void);
+void     esp_restart(void);
@@ -0,0 +1,48 @@
+/**
+ * @file       esp_timer.h
+ * @brief      ESP-IDF high resolution timer on CLOCK_MONOTONIC
+ * @details    Callbacks run in the esp_timer task like on the ESP32,
+ *             see HostESP.c.
+ * @ingroup    HostFirmware
+ * @author     SNESoIP contributors
+ * @copyright  "THE BEER-WARE LICENCE" (Revision 42)
+ */
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+
+typedef struct HostTimer_t* esp_timer_handle_t;
+typedef void (*esp_timer_cb_t)(void* pArg);
+
+/**
+ * @enum   esp_timer_dispatch_t
+ * @brief  Callback context
+ */
+typedef enum
+{
+    ESP_TIMER_TASK = 0,  ///< Callback runs in the esp_timer task
+
+} esp_timer_dispatch_t;
+
+/**
+ * @typedef  esp_timer_create_args_t
+ * @brief    Timer parameters
+ * @struct   esp_timer_create_args_t
+ * @brief    Timer parameters structure
+ */
+typedef struct
+{
+    esp_timer_cb_t       callback;
+    void*                arg;
+    esp_timer_dispatch_t dispatch_method;
+    const char*          name;
+
+} esp_timer_create_args_t;
+
+int64_t   esp_timer_get_time(void);
+esp_err_t esp_timer_create(const esp_timer_create_args_t* pstArgs, esp_timer_handle_t* phTimer);
+esp_err_t esp_timer_start_once(esp_timer_handle_t hTimer, uint64_t u64TimeoutUs);
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t hTimer, uint64_t u64PeriodUs);
+esp_err_t esp_timer_stop(esp_timer_handle_t hTimer);
+esp_err_t esp_timer_delete(esp_timer_handle_t hTimer);
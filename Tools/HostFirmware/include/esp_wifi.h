@@ -0,0 +1,108 @@
+/**
+ * @file       esp_wifi.h
+ * @brief      Virtual WiFi station
+ * @details    Connects to one virtual access point, see HostESP.c.
+ * @ingroup    HostFirmware
+ * @author     SNESoIP contributors
+ * @copyright  "THE BEER-WARE LICENCE" (Revision 42)
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#define WIFI_INIT_CONFIG_DEFAULT() { 0 }
+
+typedef enum
+{
+    WIFI_REASON_UNSPECIFIED            = 1,
+    WIFI_REASON_ASSOC_LEAVE            = 8,
+    WIFI_REASON_4WAY_HANDSHAKE_TIMEOUT = 15,
+    WIFI_REASON_BEACON_TIMEOUT         = 200,
+    WIFI_REASON_NO_AP_FOUND            = 201,
+    WIFI_REASON_AUTH_FAIL              = 202,
+    WIFI_REASON_ASSOC_FAIL             = 203,
+    WIFI_REASON_HANDSHAKE_TIMEOUT      = 204
+
+} wifi_err_reason_t;
+
+typedef enum
+{
+    WIFI_MODE_NULL = 0,
+    WIFI_MODE_STA,
+    WIFI_MODE_AP,
+    WIFI_MODE_APSTA
+
+} wifi_mode_t;
+
+typedef enum
+{
+    ESP_IF_WIFI_STA = 0,
+    ESP_IF_WIFI_AP
+
+} wifi_interface_t;
+
+typedef enum
+{
+    WIFI_STORAGE_FLASH = 0,
+    WIFI_STORAGE_RAM
+
+} wifi_storage_t;
+
+typedef enum
+{
+    WIFI_FAST_SCAN = 0,
+    WIFI_ALL_CHANNEL_SCAN
+
+} wifi_scan_method_t;
+
+typedef enum
+{
+    WIFI_CONNECT_AP_BY_SIGNAL = 0,
+    WIFI_CONNECT_AP_BY_SECURITY
+
+} wifi_sort_method_t;
+
+typedef struct
+{
+    int nUnused;
+
+} wifi_init_config_t;
+
+typedef struct
+{
+    uint8_t            ssid[32];
+    uint8_t            password[64];
+    wifi_scan_method_t scan_method;
+    bool               bssid_set;
+    uint8_t            bssid[6];
+    uint8_t            channel;
+    wifi_sort_method_t sort_method;
+
+} wifi_sta_config_t;
+
+typedef union
+{
+    wifi_sta_config_t sta;
+
+} wifi_config_t;
+
+typedef struct
+{
+    uint8_t bssid[6];
+    uint8_t ssid[33];
+    uint8_t primary;
+    int8_t  rssi;
+
+} wifi_ap_record_t;
+
+esp_err_t esp_wifi_init(const wifi_init_config_t* pstConfig);
+esp_err_t esp_wifi_set_storage(wifi_storage_t eStorage);
+esp_err_t esp_wifi_set_mode(wifi_mode_t eMode);
+esp_err_t esp_wifi_start(void);
+esp_err_t esp_wifi_connect(void);
+esp_err_t esp_wifi_disconnect(void);
+esp_err_t esp_wifi_set_config(wifi_interface_t eIf, wifi_config_t* pstConfig);
+esp_err_t esp_wifi_get_config(wifi_interface_t eIf, wifi_config_t* pstConfig);
+esp_err_t esp_wifi_sta_get_ap_info(wifi_ap_record_t* pstAP);
@@ -0,0 +1,8 @@
+/**
+ * @file       esp_wpa2.h
+ * @brief      WPA2 enterprise, not used by the firmware
+ * @ingroup    HostFirmware
+ * @author     SNESoIP contributors
+ * @copyright  "THE BEER-WARE LICENCE" (Revision 42)
+ */
+#pragma once
@@ -0,0 +1,73 @@
+/**
+ * @file       FreeRTOS.h
+ * @brief      FreeRTOS on POSIX threads
+ * @details    The part of the ESP32 FreeRTOS port the firmware uses.
+ *             Tasks are threads, critical sections are recursive
+ *             mutexes, see HostRTOS.c.
+ * @ingroup    HostFirmware
+ * @author     SNESoIP contributors
+ * @copyright  "THE BEER-WARE LICENCE" (Revision 42)
+ */
+#pragma once
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "esp_attr.h"
+#include "esp_err.h"
+#include "soc/soc.h"
+
+typedef int32_t  BaseType_t;
+typedef uint32_t UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdTRUE  1
+#define pdFALSE 0
+#define pdPASS  pdTRUE
+#define pdFAIL  pdFALSE
+
+#define configTICK_RATE_HZ          100  // !< Same as the firmware's sdkconfig
+#define configMAX_PRIORITIES        25   // !< Same as the firmware's sdkconfig
+#define configMAX_TASK_NAME_LEN     16   // !< Same as the firmware's sdkconfig
+#define configUSE_TRACE_FACILITY    1    // !< Same as the firmware's platformio.ini
+#define configGENERATE_RUN_TIME_STATS 1  // !< Same as the firmware's platformio.ini
+
+#define portNUM_PROCESSORS          2
+#define portMAX_DELAY               (TickType_t)0xffffffffUL
+#define portTICK_PERIOD_MS          ((TickType_t)1000 / configTICK_RATE_HZ)
+#define pdMS_TO_TICKS(xTimeInMs)    ((TickType_t)(((TickType_t)(xTimeInMs) * configTICK_RATE_HZ) / (TickType_t)1000))
+
+#define tskNO_AFFINITY              0x7fffffff
+#define PRO_CPU_NUM                 0
+#define APP_CPU_NUM                 1
+
+/**
+ * @typedef  portMUX_TYPE
+ * @brief    Critical section
+ * @details  On the ESP32 a spinlock shared by both cores with the
+ *           interrupts of the own core disabled.  Here interrupts are
+ *           threads as well, so a recursive mutex does the same.
+ * @struct   portMUX_TYPE_t
+ * @brief    Critical section structure
+ */
+typedef struct portMUX_TYPE_t
+{
+    pthread_mutex_t stMutex;
+
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED { PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP }
+
+#define portENTER_CRITICAL(pstMux)     pthread_mutex_lock(&(pstMux)->stMutex)
+#define portEXIT_CRITICAL(pstMux)      pthread_mutex_unlock(&(pstMux)->stMutex)
+#define portENTER_CRITICAL_ISR(pstMux) pthread_mutex_lock(&(pstMux)->stMutex)
+#define portEXIT_CRITICAL_ISR(pstMux)  pthread_mutex_unlock(&(pstMux)->stMutex)
+#define portYIELD_FROM_ISR()
+
+void       vPortCPUInitializeMutex(portMUX_TYPE* pstMux);
+BaseType_t xPortGetCoreID(void);
+void*      pvPortMalloc(size_t uSize);
+void       vPortFree(void* pMem);
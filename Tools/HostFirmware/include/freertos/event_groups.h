@@ -0,0 +1,19 @@
+/**
+ * @file       event_groups.h
+ * @brief      FreeRTOS event groups on POSIX threads
+ * @ingroup    HostFirmware
+ * @author     SNESoIP contributors
+ * @copyright  "THE BEER-WARE LICENCE" (Revision 42)
+ */
+#pragma once
+
+#include "FreeRTOS.h"
+
+typedef struct HostEventGroup_t* EventGroupHandle_t;
+typedef uint32_t                 EventBits_t;
+
+EventGroupHandle_t xEventGroupCreate(void);
+EventBits_t        xEventGroupSetBits(EventGroupHandle_t hGroup, EventBits_t uBits);
+EventBits_t        xEventGroupClearBits(EventGroupHandle_t hGroup, EventBits_t uBits);
+EventBits_t        xEventGroupGetBits(EventGroupHandle_t hGroup);
+EventBits_t        xEventGroupWaitBits(EventGroupHandle_t hGroup, EventBits_t uBits, BaseType_t xClear, BaseType_t xAll, TickType_t xTicks);
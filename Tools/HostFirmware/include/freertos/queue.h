@@ -0,0 +1,23 @@
+/**
+ * @file       queue.h
+ * @brief      FreeRTOS queues on POSIX threads
+ * @ingroup    HostFirmware
+ * @author     SNESoIP contributors
+ * @copyright  "THE BEER-WARE LICENCE" (Revision 42)
+ */
+#pragma once
+
+#include "FreeRTOS.h"
+
+typedef struct HostQueue_t* QueueHandle_t;
+
+QueueHandle_t xQueueGenericCreate(UBaseType_t uLength, UBaseType_t uItemSize, UBaseType_t uInitial);
+BaseType_t    xQueueSend(QueueHandle_t hQueue, const void* pItem, TickType_t xTicks);
+BaseType_t    xQueueSendFromISR(QueueHandle_t hQueue, const void* pItem, BaseType_t* pxWoken);
+BaseType_t    xQueueReceive(QueueHandle_t hQueue, void* pItem, TickType_t xTicks);
+BaseType_t    xQueueReset(QueueHandle_t hQueue);
+UBaseType_t   uxQueueMessagesWaiting(QueueHandle_t hQueue);
+void          vQueueDelete(QueueHandle_t hQueue);
+
+#define xQueueCreate(uLength, uItemSize) xQueueGenericCreate((uLength), (uItemSize), 0)
+#define xQueueSendToBack(hQueue, pItem, xTicks) xQueueSend((hQueue), (pItem), (xTicks))
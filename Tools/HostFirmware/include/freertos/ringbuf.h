@@ -0,0 +1,33 @@
+/**
+ * @file       ringbuf.h
+ * @brief      ESP-IDF ring buffers on POSIX threads
+ * @ingroup    HostFirmware
+ * @author     SNESoIP contributors
+ * @copyright  "THE BEER-WARE LICENCE" (Revision 42)
+ */
+#pragma once
+
+#include "FreeRTOS.h"
+
+typedef struct HostRingbuf_t* RingbufHandle_t;
+
+/**
+ * @enum   ringbuf_type_t
+ * @brief  Ring buffer type
+ */
+typedef enum
+{
+    RINGBUF_TYPE_NOSPLIT = 0,  ///< Items of variable size, received whole
+    RINGBUF_TYPE_ALLOWSPLIT,   ///< Treated like RINGBUF_TYPE_NOSPLIT
+    RINGBUF_TYPE_BYTEBUF       ///< Byte stream
+
+} ringbuf_type_t;
+
+RingbufHandle_t xRingbufferCreate(size_t uSize, ringbuf_type_t eType);
+void            vRingbufferDelete(RingbufHandle_t hRingbuf);
+BaseType_t      xRingbufferSend(RingbufHandle_t hRingbuf, const void* pData, size_t uSize, TickType_t xTicks);
+BaseType_t      xRingbufferSendFromISR(RingbufHandle_t hRingbuf, const void* pData, size_t uSize, BaseType_t* pxWoken);
+void*           xRingbufferReceive(RingbufHandle_t hRingbuf, size_t* puSize, TickType_t xTicks);
+void*           xRingbufferReceiveUpTo(RingbufHandle_t hRingbuf, size_t* puSize, TickType_t xTicks, size_t uMax);
+void            vRingbufferReturnItem(RingbufHandle_t hRingbuf, void* pItem);
+size_t          xRingbufferGetCurFreeSize(RingbufHandle_t hRingbuf);
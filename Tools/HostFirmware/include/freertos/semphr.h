@@ -0,0 +1,21 @@
+/**
+ * @file       semphr.h
+ * @brief      FreeRTOS semaphores on POSIX threads
+ * @details    Like in FreeRTOS, a semaphore is a queue without data.
+ * @ingroup    HostFirmware
+ * @author     SNESoIP contributors
+ * @copyright  "THE BEER-WARE LICENCE" (Revision 42)
+ */
+#pragma once
+
+#include "queue.h"
+
+typedef QueueHandle_t SemaphoreHandle_t;
+
+#define xSemaphoreCreateBinary()                 xQueueGenericCreate(1, 0, 0)
+#define xSemaphoreCreateMutex()                  xQueueGenericCreate(1, 0, 1)
+#define xSemaphoreCreateCounting(uMax, uInitial) xQueueGenericCreate((uMax), 0, (uInitial))
+#define xSemaphoreTake(hSem, xTicks)             xQueueReceive((hSem), NULL, (xTicks))
+#define xSemaphoreGive(hSem)                     xQueueSend((hSem), NULL, 0)
+#define xSemaphoreGiveFromISR(hSem, pxWoken)     xQueueSendFromISR((hSem), NULL, (pxWoken))
+#define vSemaphoreDelete(hSem)                   vQueueDelete(hSem)
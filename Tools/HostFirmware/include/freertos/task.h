@@ -0,0 +1,64 @@
+/**
+ * @file       task.h
+ * @brief      FreeRTOS tasks on POSIX threads
+ * @ingroup    HostFirmware
+ * @author     SNESoIP contributors
+ * @copyright  "THE BEER-WARE LICENCE" (Revision 42)
+ */
+#pragma once
+
+#include "FreeRTOS.h"
+
+typedef void  (*TaskFunction_t)(void* pArg);
+typedef void* TaskHandle_t;
+
+/**
+ * @enum   eTaskState
+ * @brief  Task state
+ */
+typedef enum
+{
+    eRunning = 0,
+    eReady,
+    eBlocked,
+    eSuspended,
+    eDeleted,
+    eInvalid
+
+} eTaskState;
+
+/**
+ * @typedef  TaskStatus_t
+ * @brief    Task state as reported by uxTaskGetSystemState()
+ * @details  The run-time counter is the CPU time of the thread in µs,
+ *           there is no stack high-water mark on the host.
+ * @struct   xTASK_STATUS
+ * @brief    Task state structure
+ */
+typedef struct xTASK_STATUS
+{
+    TaskHandle_t xHandle;
+    const char*  pcTaskName;
+    UBaseType_t  xTaskNumber;
+    eTaskState   eCurrentState;
+    UBaseType_t  uxCurrentPriority;
+    UBaseType_t  uxBasePriority;
+    uint32_t     ulRunTimeCounter;
+    void*        pxStackBase;
+    uint32_t     usStackHighWaterMark;
+    BaseType_t   xCoreID;
+
+} TaskStatus_t;
+
+BaseType_t   xTaskCreatePinnedToCore(TaskFunction_t pfnTask, const char* pacName, uint32_t u32StackDepth, void* pArg, UBaseType_t uPriority, TaskHandle_t* phTask, BaseType_t xCore);
+BaseType_t   xTaskCreate(TaskFunction_t pfnTask, const char* pacName, uint32_t u32StackDepth, void* pArg, UBaseType_t uPriority, TaskHandle_t* phTask);
+void         vTaskDelete(TaskHandle_t hTask);
+void         vTaskDelay(TickType_t xTicks);
+TickType_t   xTaskGetTickCount(void);
+TaskHandle_t xTaskGetCurrentTaskHandle(void);
+BaseType_t   xTaskGetAffinity(TaskHandle_t hTask);
+UBaseType_t  uxTaskGetNumberOfTasks(void);
+UBaseType_t  uxTaskGetSystemState(TaskStatus_t* pastStatus, UBaseType_t uSize, uint32_t* pu32TotalRunTime);
+uint32_t     ulTaskNotifyTake(BaseType_t xClear, TickType_t xTicks);
+BaseType_t   xTaskNotifyGive(TaskHandle_t hTask);
+void         vTaskNotifyGiveFromISR(TaskHandle_t hTask, BaseType_t* pxWoken);
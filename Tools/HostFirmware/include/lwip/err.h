@@ -0,0 +1,8 @@
+/**
+ * @file       err.h
+ * @brief      lwIP error codes, not used on the host
+ * @ingroup    HostFirmware
+ * @author     SNESoIP contributors
+ * @copyright  "THE BEER-WARE LICENCE" (Revision 42)
+ */
+#pragma once
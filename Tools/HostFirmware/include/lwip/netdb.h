@@ -0,0 +1,10 @@
+/**
+ * @file       netdb.h
+ * @brief      lwIP name resolution on the host resolver
+ * @ingroup    HostFirmware
+ * @author     SNESoIP contributors
+ * @copyright  "THE BEER-WARE LICENCE" (Revision 42)
+ */
+#pragma once
+
+#include <netdb.h>
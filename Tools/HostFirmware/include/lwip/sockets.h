@@ -0,0 +1,23 @@
+/**
+ * @file       sockets.h
+ * @brief      lwIP sockets on the host's BSD sockets
+ * @details    The lwIP socket API is the BSD one, so the firmware runs
+ *             on the host's stack unchanged.
+ * @ingroup    HostFirmware
+ * @author     SNESoIP contributors
+ * @copyright  "THE BEER-WARE LICENCE" (Revision 42)
+ */
+#pragma once
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#define inet_ntoa_r(stAddr, pacBuf, nLen) inet_ntop(AF_INET, &(stAddr), (pacBuf), (socklen_t)(nLen))
+#define closesocket(nSock)                close(nSock)
@@ -0,0 +1,38 @@
+/**
+ * @file       nvs.h
+ * @brief      Non-volatile storage in RAM
+ * @details    Starts empty on every run unless seeded, see Host.h.
+ * @ingroup    HostFirmware
+ * @author     SNESoIP contributors
+ * @copyright  "THE BEER-WARE LICENCE" (Revision 42)
+ */
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+typedef uint32_t nvs_handle;
+
+typedef enum
+{
+    NVS_READONLY = 0,
+    NVS_READWRITE
+
+} nvs_open_mode;
+
+esp_err_t nvs_open(const char* pacNamespace, nvs_open_mode eMode, nvs_handle* phNVS);
+void      nvs_close(nvs_handle hNVS);
+esp_err_t nvs_commit(nvs_handle hNVS);
+esp_err_t nvs_erase_key(nvs_handle hNVS, const char* pacKey);
+esp_err_t nvs_erase_all(nvs_handle hNVS);
+esp_err_t nvs_set_u8(nvs_handle hNVS, const char* pacKey, uint8_t u8Value);
+esp_err_t nvs_get_u8(nvs_handle hNVS, const char* pacKey, uint8_t* pu8Value);
+esp_err_t nvs_set_u16(nvs_handle hNVS, const char* pacKey, uint16_t u16Value);
+esp_err_t nvs_get_u16(nvs_handle hNVS, const char* pacKey, uint16_t* pu16Value);
+esp_err_t nvs_set_u32(nvs_handle hNVS, const char* pacKey, uint32_t u32Value);
+esp_err_t nvs_get_u32(nvs_handle hNVS, const char* pacKey, uint32_t* pu32Value);
+esp_err_t nvs_set_str(nvs_handle hNVS, const char* pacKey, const char* pacValue);
+esp_err_t nvs_get_str(nvs_handle hNVS, const char* pacKey, char* pacValue, size_t* puSize);
+esp_err_t nvs_set_blob(nvs_handle hNVS, const char* pacKey, const void* pValue, size_t uSize);
+esp_err_t nvs_get_blob(nvs_handle hNVS, const char* pacKey, void* pValue, size_t* puSize);
@@ -0,0 +1,12 @@
+/**
+ * @file       nvs_flash.h
+ * @brief      NVS partition
+ * @ingroup    HostFirmware
+ * @author     SNESoIP contributors
+ * @copyright  "THE BEER-WARE LICENCE" (Revision 42)
+ */
+#pragma once
+
+#include "esp_err.h"
+
+esp_err_t nvs_flash_init(void);
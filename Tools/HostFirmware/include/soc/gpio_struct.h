@@ -0,0 +1,20 @@
+/**
+ * @file       gpio_struct.h
+ * @brief      GPIO registers of the virtual adapter
+ * @details    The virtual console drives the input levels.
+ * @ingroup    HostFirmware
+ * @author     SNESoIP contributors
+ * @copyright  "THE BEER-WARE LICENCE" (Revision 42)
+ */
+#pragma once
+
+#include <stdint.h>
+
+typedef struct
+{
+    uint32_t in;   ///< Input levels of GPIO 0 to 31
+    uint32_t in1;  ///< Input levels of GPIO 32 to 39
+
+} gpio_dev_t;
+
+extern volatile gpio_dev_t GPIO;
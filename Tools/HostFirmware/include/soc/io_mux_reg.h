@@ -0,0 +1,16 @@
+/**
+ * @file       io_mux_reg.h
+ * @brief      IO MUX registers of the virtual adapter
+ * @details    Every pin of the virtual adapter has its input enabled.
+ * @ingroup    HostFirmware
+ * @author     SNESoIP contributors
+ * @copyright  "THE BEER-WARE LICENCE" (Revision 42)
+ */
+#pragma once
+
+#include <stdint.h>
+
+extern const uint32_t GPIO_PIN_MUX_REG[40];
+
+#define PIN_INPUT_ENABLE(u32Reg)  ((void)(u32Reg))
+#define PIN_INPUT_DISABLE(u32Reg) ((void)(u32Reg))
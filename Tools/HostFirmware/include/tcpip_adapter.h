@@ -0,0 +1,41 @@
+/**
+ * @file       tcpip_adapter.h
+ * @brief      Network interface of the virtual station
+ * @details    The host's own stack carries the traffic, so this only
+ *             keeps the address the firmware expects to see.
+ * @ingroup    HostFirmware
+ * @author     SNESoIP contributors
+ * @copyright  "THE BEER-WARE LICENCE" (Revision 42)
+ */
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+
+typedef struct
+{
+    uint32_t addr;
+
+} ip4_addr_t;
+
+typedef struct
+{
+    ip4_addr_t ip;
+    ip4_addr_t netmask;
+    ip4_addr_t gw;
+
+} tcpip_adapter_ip_info_t;
+
+typedef enum
+{
+    TCPIP_ADAPTER_IF_STA = 0,
+    TCPIP_ADAPTER_IF_AP,
+    TCPIP_ADAPTER_IF_MAX
+
+} tcpip_adapter_if_t;
+
+void      tcpip_adapter_init(void);
+esp_err_t tcpip_adapter_dhcpc_start(tcpip_adapter_if_t eIf);
+esp_err_t tcpip_adapter_dhcpc_stop(tcpip_adapter_if_t eIf);
+esp_err_t tcpip_adapter_get_ip_info(tcpip_adapter_if_t eIf, tcpip_adapter_ip_info_t* pstIP);
+esp_err_t tcpip_adapter_set_ip_info(tcpip_adapter_if_t eIf, const tcpip_adapter_ip_info_t* pstIP);
@@ -0,0 +1,155 @@
+#!/bin/sh
+#
+# NAT traversal test: two virtual adapters behind their own NAT router
+# exchange input via the server, see Stage 3 in Server.c.
+#
+#   nattest.sh <server> <HostFirmware> [direct|relay] [seconds]
+#
+# The adapters, their routers and the server run in network namespaces:
+#
+#   host0 192.168.0.2 -- nat0 203.0.113.10 --+
+#                                            +-- wan 203.0.113.1 (server)
+#   host1 192.168.1.2 -- nat1 203.0.113.11 --+
+#
+# The routers masquerade everything leaving on the WAN side and drop
+# what nobody asked for, so an adapter can only be reached through a
+# mapping it opened itself.
+#
+#   direct  The adapters have to punch through both routers, the test
+#           passes if both end up on the direct path and received input.
+#   relay   Each router drops everything from the other router, so the
+#           adapters have to fall back to the relay via the server.
+#
+# Needs root, ip and nft.  Exits with 77 if they are not available.
+
+SERVER=$(realpath "$1" 2>/dev/null)
+HOSTFW=$(realpath "$2" 2>/dev/null)
+MODE=${3:-direct}
+RUNTIME=${4:-15}
+PORT=54350
+NS=snesoip$$
+TMP=$(mktemp -d)
+
+if [ ! -x "$SERVER" ] || [ ! -x "$HOSTFW" ]; then
+    echo "Usage: $0 <server> <HostFirmware> [direct|relay] [seconds]"
+    exit 1
+fi
+if [ "$(id -u)" != 0 ] || ! command -v ip > /dev/null || ! command -v nft > /dev/null; then
+    echo "Skipped: needs root, ip and nft."
+    exit 77
+fi
+
+cleanup()
+{
+    [ -n "$SERVER_PID" ] && kill -9 "$SERVER_PID" 2> /dev/null
+    for NAME in host0 host1 nat0 nat1 wan; do
+        ip netns del "$NS-$NAME" 2> /dev/null
+    done
+    rm -rf "$TMP"
+}
+trap cleanup EXIT HUP INT PIPE TERM
+
+set -e
+
+ip netns add "$NS-wan"
+ip -n "$NS-wan" link set lo up
+ip -n "$NS-wan" link add wan type bridge
+ip -n "$NS-wan" addr add 203.0.113.1/24 dev wan
+ip -n "$NS-wan" link set wan up
+
+for N in 0 1; do
+    NAT="$NS-nat$N"
+    HOST="$NS-host$N"
+
+    ip netns add "$NAT"
+    ip netns add "$HOST"
+    ip -n "$NAT" link set lo up
+    ip -n "$HOST" link set lo up
+
+    # Router WAN side on the bridge.
+    ip -n "$NAT" link add wan type veth peer name nat$N netns "$NS-wan"
+    ip -n "$NS-wan" link set nat$N master wan up
+    ip -n "$NAT" addr add 203.0.113.1$N/24 dev wan
+    ip -n "$NAT" link set wan up
+
+    # Router LAN side with the adapter.
+    ip -n "$NAT" link add lan type veth peer name eth0 netns "$HOST"
+    ip -n "$NAT" addr add 192.168.$N.1/24 dev lan
+    ip -n "$NAT" link set lan up
+    ip -n "$HOST" addr add 192.168.$N.2/24 dev eth0
+    ip -n "$HOST" link set eth0 up
+    ip -n "$HOST" route add default via 192.168.$N.1
+
+    ip netns exec "$NAT" sysctl -q -w net.ipv4.ip_forward=1
+    ip netns exec "$NAT" nft -f - <<EOF
+table ip nat {
+    chain postrouting {
+        type nat hook postrouting priority srcnat;
+        oifname "wan" masquerade
+    }
+}
+table ip filter {
+    chain input {
+        type filter hook input priority filter; policy accept;
+        iifname "wan" ct state new drop
+    }
+    chain forward {
+        type filter hook forward priority filter; policy drop;
+        iifname "lan" accept
+        ct state established,related accept
+    }
+}
+EOF
+
+    if [ "$MODE" = relay ]; then
+        ip -n "$NAT" rule add iif wan from 203.0.113.1$((1 - N)) blackhole
+    fi
+done
+
+cat > "$TMP/nat.ini" <<EOF
+[General]
+port        = $PORT
+addr        = 203.0.113.1
+max_clients = 2
+verbose     = 1
+EOF
+
+# The server takes at most 20 characters of the file name.
+(cd "$TMP" && exec ip netns exec "$NS-wan" "$SERVER" nat.ini > server.log 2>&1 < /dev/null) &
+SERVER_PID=$!
+sleep 1
+
+set +e
+
+ip netns exec "$NS-host0" "$HOSTFW" -s 203.0.113.1 -p $PORT -t "$RUNTIME" -i 0001 > "$TMP/host0.log" 2>&1 &
+PID0=$!
+ip netns exec "$NS-host1" "$HOSTFW" -s 203.0.113.1 -p $PORT -t "$RUNTIME" -i 0002 > "$TMP/host1.log" 2>&1 &
+PID1=$!
+wait $PID0
+RESULT0=$?
+wait $PID1
+RESULT1=$?
+
+FAILED=0
+for N in 0 1; do
+    LINE=$(grep "netplay tx" "$TMP/host$N.log")
+    RX=$(echo "$LINE" | sed -n 's/.* rx \([0-9]*\),.*/\1/p')
+    eval RESULT=\$RESULT$N
+
+    echo "host$N: $LINE"
+    if [ "$RESULT" != 0 ] || [ -z "$RX" ] || [ "$RX" = 0 ] || ! echo "$LINE" | grep -q "path $MODE\$"; then
+        FAILED=1
+    fi
+done
+
+if [ $FAILED != 0 ]; then
+    for LOG in server host0 host1; do
+        echo "--- $LOG"
+        cat "$TMP/$LOG.log"
+    done
+    echo "NAT test ($MODE) failed."
+    exit 1
+fi
+
+echo "NAT test ($MODE) passed."
+exit 0
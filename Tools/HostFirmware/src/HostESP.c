@@ -0,0 +1,1094 @@
+/**
+ * @file       HostESP.c
+ * @brief      ESP-IDF services of the virtual adapter
+ * @ingroup    HostFirmware
+ * @details
+ * @code{.unparsed}
+ *
+ *   esp_timer        microseconds since HostInit(), callbacks in an
+ *                    esp_timer task on the PRO CPU like on the ESP32
+ *   esp_log          stdout, "I (1234) tag: message"
+ *   NVS              kept in memory for the lifetime of the process
+ *   Event loop       event task on the PRO CPU
+ *   WiFi             one virtual access point, HOST_WIFI_SSID on
+ *                    HOST_WIFI_CHANNEL.  A connection attempt with its
+ *                    BSSID and channel takes HOST_WIFI_FAST_MS, one
+ *                    with a full scan HOST_WIFI_SCAN_MS.  Any other
+ *                    network is not found.
+ *   SmartConfig      hands out the virtual access point after
+ *                    HOST_WIFI_SC_MS
+ *   TCP/IP adapter   the station has the loopback address, sockets are
+ *                    the ones of the host
+ *
+ * @endcode
+ * @author     SNESoIP contributors
+ * @copyright  "THE BEER-WARE LICENCE" (Revision 42)
+ */
+
+#define _GNU_SOURCE
+
+#include <arpa/inet.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/random.h>
+#include <sys/sysinfo.h>
+#include <time.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+#include "esp_event_loop.h"
+#include "esp_log.h"
+#include "esp_smartconfig.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "esp_wifi.h"
+#include "nvs.h"
+#include "nvs_flash.h"
+#include "tcpip_adapter.h"
+#include "Host.h"
+
+#define HOST_NVS_ENTRIES     32   // !< Max. number of stored NVS keys
+#define HOST_NVS_KEY_LEN     16   // !< Max. length of an NVS key or namespace incl. NUL
+#define HOST_NVS_VALUE_SIZE  256  // !< Max. size of a stored NVS value
+#define HOST_NVS_HANDLES     8    // !< Max. number of open NVS handles
+#define HOST_LOG_TAGS        8    // !< Max. number of tags with their own log level
+#define HOST_EVENT_QUEUE     16   // !< Event loop queue size
+#define HOST_TASK_PRIO_TIMER 22   // !< Same as ESP_TIMER_TASK_PRIO on the ESP32
+#define HOST_TASK_PRIO_EVENT 20   // !< Same as the ESP32 event loop task
+
+/**
+ * @struct  HostTimer
+ * @brief   esp_timer
+ */
+struct HostTimer_t
+{
+    esp_timer_cb_t      pfnCallback;
+    void*               pArg;
+    const char*         pacName;
+    int64_t             s64Due;      ///< Expiry in µs
+    uint64_t            u64Period;   ///< 0 = one-shot
+    bool                bArmed;
+    struct HostTimer_t* pstNext;
+};
+
+/**
+ * @typedef  HostNVSEntry
+ * @brief    Stored NVS value
+ */
+typedef struct HostNVSEntry_t
+{
+    bool    bUsed;
+    char    acNamespace[HOST_NVS_KEY_LEN];
+    char    acKey[HOST_NVS_KEY_LEN];
+    size_t  uSize;
+    uint8_t au8Value[HOST_NVS_VALUE_SIZE];
+
+} HostNVSEntry;
+
+/**
+ * @typedef  HostLogTag
+ * @brief    Log level of one tag
+ */
+typedef struct HostLogTag_t
+{
+    char            acTag[HOST_NVS_KEY_LEN];
+    esp_log_level_t eLevel;
+
+} HostLogTag;
+
+/**
+ * @typedef  HostESP
+ * @brief    ESP-IDF service data
+ */
+typedef struct HostESP_t
+{
+    struct timespec     stBase;          ///< Start of esp_timer_get_time()
+
+    pthread_mutex_t     stTimerLock;     ///< Guards the timer list
+    pthread_cond_t      stTimerCond;     ///< Timer list changed
+    struct HostTimer_t* pstTimers;
+
+    pthread_mutex_t     stLogLock;
+    esp_log_level_t     eLogLevel;       ///< Level of all other tags
+    HostLogTag          astLogTag[HOST_LOG_TAGS];
+
+    pthread_mutex_t     stNVSLock;
+    HostNVSEntry        astNVS[HOST_NVS_ENTRIES];
+    char                aacHandle[HOST_NVS_HANDLES][HOST_NVS_KEY_LEN];  ///< Namespace per handle, "" = free
+    bool                abWritable[HOST_NVS_HANDLES];
+
+    system_event_cb_t   pfnEvent;
+    void*               pEventCtx;
+    QueueHandle_t       hEventQueue;
+
+    pthread_mutex_t     stWiFiLock;
+    char                acSSID[33];      ///< Network the WiFi library keeps in flash
+    wifi_config_t       stConfig;
+    bool                bConnected;
+    esp_timer_handle_t  hConnectTimer;   ///< Outcome of the connection attempt
+    system_event_t      stOutcome;       ///< Event posted by hConnectTimer
+    esp_timer_handle_t  hSCTimer;        ///< SmartConfig progress
+    sc_callback_t       pfnSC;
+    bool                bStaticIP;
+    tcpip_adapter_ip_info_t stIP;
+
+} HostESP;
+
+/**
+ * @var    _stESP
+ * @brief  ESP-IDF service private data
+ */
+static HostESP _stESP =
+{
+    .stTimerLock = PTHREAD_MUTEX_INITIALIZER,
+    .stLogLock   = PTHREAD_MUTEX_INITIALIZER,
+    .stNVSLock   = PTHREAD_MUTEX_INITIALIZER,
+    .stWiFiLock  = PTHREAD_MUTEX_INITIALIZER,
+    .eLogLevel   = ESP_LOG_INFO,
+    .acSSID      = HOST_WIFI_SSID,
+};
+
+/**
+ * @var    _au8BSSID
+ * @brief  BSSID of the virtual access point
+ */
+static const uint8_t _au8BSSID[6] = { 0x02, 0x53, 0x4e, 0x45, 0x53, 0x01 };
+
+static void          _HostTimerThread(void* pArg);
+static void          _HostEventThread(void* pArg);
+static void          _HostPostEvent(const system_event_t* pstEvent);
+static void          _HostConnectDone(void* pArg);
+static void          _HostSCStep(void* pArg);
+static HostNVSEntry* _HostNVSFind(nvs_handle hNVS, const char* pacKey);
+static esp_err_t     _HostNVSSet(nvs_handle hNVS, const char* pacKey, const void* pValue, size_t uSize);
+static esp_err_t     _HostNVSGet(nvs_handle hNVS, const char* pacKey, void* pValue, size_t uSize);
+
+/**
+ * @fn     void HostInitESP(void)
+ * @brief  Start the esp_timer task
+ * @note   The kernel has to be initialised before, see HostInitRTOS().
+ */
+void HostInitESP(void)
+{
+    pthread_condattr_t stAttr;
+
+    clock_gettime(CLOCK_MONOTONIC, &_stESP.stBase);
+    pthread_condattr_init(&stAttr);
+    pthread_condattr_setclock(&stAttr, CLOCK_MONOTONIC);
+    pthread_cond_init(&_stESP.stTimerCond, &stAttr);
+    pthread_condattr_destroy(&stAttr);
+
+    xTaskCreatePinnedToCore(
+        _HostTimerThread, "esp_timer", 4096, NULL,
+        HOST_TASK_PRIO_TIMER, NULL, PRO_CPU_NUM);
+}
+
+/**
+ * @fn     void HostSetWiFiSSID(const char* pacSSID)
+ * @brief  Set the network the WiFi library has stored
+ * @param  pacSSID
+ *         SSID, "" = none, so that the firmware starts SmartConfig
+ */
+void HostSetWiFiSSID(const char* pacSSID)
+{
+    pthread_mutex_lock(&_stESP.stWiFiLock);
+    snprintf(_stESP.acSSID, sizeof(_stESP.acSSID), "%s", pacSSID);
+    pthread_mutex_unlock(&_stESP.stWiFiLock);
+}
+
+/**
+ * @fn     void HostTimeToSpec(int64_t s64Time, struct timespec* pstSpec)
+ * @brief  Convert an esp_timer time to CLOCK_MONOTONIC
+ * @param  s64Time
+ *         Time in µs, see esp_timer_get_time()
+ * @param  pstSpec
+ *         Destination
+ */
+void HostTimeToSpec(int64_t s64Time, struct timespec* pstSpec)
+{
+    int64_t s64Ns = (int64_t)_stESP.stBase.tv_nsec + (s64Time % 1000000) * 1000;
+
+    pstSpec->tv_sec  = _stESP.stBase.tv_sec + (time_t)(s64Time / 1000000) + (time_t)(s64Ns / 1000000000);
+    pstSpec->tv_nsec = (long)(s64Ns % 1000000000);
+}
+
+int64_t esp_timer_get_time(void)
+{
+    struct timespec stNow;
+
+    clock_gettime(CLOCK_MONOTONIC, &stNow);
+    return (int64_t)(stNow.tv_sec - _stESP.stBase.tv_sec) * 1000000 +
+        (stNow.tv_nsec - _stESP.stBase.tv_nsec) / 1000;
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t* pstArgs, esp_timer_handle_t* phTimer)
+{
+    esp_timer_handle_t hTimer;
+
+    if (NULL == pstArgs || NULL == pstArgs->callback || NULL == phTimer)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    hTimer = calloc(1, sizeof(struct HostTimer_t));
+    if (NULL == hTimer)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    hTimer->pfnCallback = pstArgs->callback;
+    hTimer->pArg        = pstArgs->arg;
+    hTimer->pacName     = pstArgs->name;
+
+    pthread_mutex_lock(&_stESP.stTimerLock);
+    hTimer->pstNext  = _stESP.pstTimers;
+    _stESP.pstTimers = hTimer;
+    pthread_mutex_unlock(&_stESP.stTimerLock);
+
+    *phTimer = hTimer;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t hTimer, uint64_t u64TimeoutUs)
+{
+    esp_err_t eErr = ESP_OK;
+
+    pthread_mutex_lock(&_stESP.stTimerLock);
+    if (hTimer->bArmed)
+    {
+        eErr = ESP_ERR_INVALID_STATE;
+    }
+    else
+    {
+        hTimer->s64Due    = esp_timer_get_time() + (int64_t)u64TimeoutUs;
+        hTimer->u64Period = 0;
+        hTimer->bArmed    = true;
+        pthread_cond_signal(&_stESP.stTimerCond);
+    }
+    pthread_mutex_unlock(&_stESP.stTimerLock);
+
+    return eErr;
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t hTimer, uint64_t u64PeriodUs)
+{
+    esp_err_t eErr = ESP_OK;
+
+    pthread_mutex_lock(&_stESP.stTimerLock);
+    if (hTimer->bArmed)
+    {
+        eErr = ESP_ERR_INVALID_STATE;
+    }
+    else
+    {
+        hTimer->s64Due    = esp_timer_get_time() + (int64_t)u64PeriodUs;
+        hTimer->u64Period = u64PeriodUs;
+        hTimer->bArmed    = true;
+        pthread_cond_signal(&_stESP.stTimerCond);
+    }
+    pthread_mutex_unlock(&_stESP.stTimerLock);
+
+    return eErr;
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t hTimer)
+{
+    esp_err_t eErr = ESP_OK;
+
+    pthread_mutex_lock(&_stESP.stTimerLock);
+    if (! hTimer->bArmed)
+    {
+        eErr = ESP_ERR_INVALID_STATE;
+    }
+    hTimer->bArmed = false;
+    pthread_mutex_unlock(&_stESP.stTimerLock);
+
+    return eErr;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t hTimer)
+{
+    struct HostTimer_t** ppstLink;
+
+    pthread_mutex_lock(&_stESP.stTimerLock);
+    if (hTimer->bArmed)
+    {
+        pthread_mutex_unlock(&_stESP.stTimerLock);
+        return ESP_ERR_INVALID_STATE;
+    }
+    for (ppstLink = &_stESP.pstTimers; NULL != *ppstLink; ppstLink = &(*ppstLink)->pstNext)
+    {
+        if (hTimer == *ppstLink)
+        {
+            *ppstLink = hTimer->pstNext;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&_stESP.stTimerLock);
+
+    free(hTimer);
+    return ESP_OK;
+}
+
+void esp_log_level_set(const char* pacTag, esp_log_level_t eLevel)
+{
+    pthread_mutex_lock(&_stESP.stLogLock);
+    if (0 == strcmp(pacTag, "*"))
+    {
+        _stESP.eLogLevel = eLevel;
+        memset(_stESP.astLogTag, 0, sizeof(_stESP.astLogTag));
+    }
+    else
+    {
+        for (uint8_t u8Index = 0; u8Index < HOST_LOG_TAGS; u8Index++)
+        {
+            HostLogTag* pstTag = &_stESP.astLogTag[u8Index];
+
+            if ('\0' == pstTag->acTag[0] || 0 == strcmp(pstTag->acTag, pacTag))
+            {
+                snprintf(pstTag->acTag, sizeof(pstTag->acTag), "%s", pacTag);
+                pstTag->eLevel = eLevel;
+                break;
+            }
+        }
+    }
+    pthread_mutex_unlock(&_stESP.stLogLock);
+}
+
+void esp_log_write(esp_log_level_t eLevel, const char* pacTag, const char* pacFormat, ...)
+{
+    static const char acLetter[] = "NEWIDV";
+    esp_log_level_t   eMax;
+    char              acLine[512];
+    int               nLen;
+    va_list           pArgs;
+
+    pthread_mutex_lock(&_stESP.stLogLock);
+    eMax = _stESP.eLogLevel;
+    for (uint8_t u8Index = 0; u8Index < HOST_LOG_TAGS; u8Index++)
+    {
+        if (0 == strcmp(_stESP.astLogTag[u8Index].acTag, pacTag))
+        {
+            eMax = _stESP.astLogTag[u8Index].eLevel;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&_stESP.stLogLock);
+
+    if (ESP_LOG_NONE == eLevel || eLevel > eMax)
+    {
+        return;
+    }
+
+    // One write per line, so that lines of different tasks do not mix.
+    nLen = snprintf(acLine, sizeof(acLine), "%c (%u) %s: ",
+                    acLetter[eLevel], (unsigned)(esp_timer_get_time() / 1000), pacTag);
+    va_start(pArgs, pacFormat);
+    vsnprintf(&acLine[nLen], sizeof(acLine) - (size_t)nLen, pacFormat, pArgs);
+    va_end(pArgs);
+    printf("%s\n", acLine);
+    fflush(stdout);
+}
+
+uint32_t esp_random(void)
+{
+    uint32_t u32Value = 0;
+
+    if (sizeof(u32Value) != getrandom(&u32Value, sizeof(u32Value), 0))
+    {
+        u32Value = (uint32_t)rand();
+    }
+    return u32Value;
+}
+
+uint32_t esp_get_free_heap_size(void)
+{
+    struct sysinfo stInfo;
+
+    if (0 != sysinfo(&stInfo))
+    {
+        return 0;
+    }
+    return (uint32_t)(stInfo.freeram * stInfo.mem_unit > UINT32_MAX ? UINT32_MAX : stInfo.freeram * stInfo.mem_unit);
+}
+
+uint32_t esp_get_minimum_free_heap_size(void)
+{
+    return esp_get_free_heap_size();
+}
+
+void esp_restart(void)
+{
+    // The process would come back without its NVS, so just end it.
+    ESP_LOGI("Host", "Restart requested.");
+    exit(EXIT_SUCCESS);
+}
+
+esp_err_t nvs_flash_init(void)
+{
+    return ESP_OK;
+}
+
+esp_err_t nvs_open(const char* pacNamespace, nvs_open_mode eMode, nvs_handle* phNVS)
+{
+    esp_err_t eErr = ESP_ERR_NVS_NOT_FOUND;
+
+    if (strlen(pacNamespace) >= HOST_NVS_KEY_LEN)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    pthread_mutex_lock(&_stESP.stNVSLock);
+
+    // Like on flash, a namespace exists once something was written to it.
+    if (NVS_READWRITE == eMode)
+    {
+        eErr = ESP_OK;
+    }
+    for (uint8_t u8Index = 0; u8Index < HOST_NVS_ENTRIES && ESP_OK != eErr; u8Index++)
+    {
+        if (_stESP.astNVS[u8Index].bUsed && 0 == strcmp(_stESP.astNVS[u8Index].acNamespace, pacNamespace))
+        {
+            eErr = ESP_OK;
+        }
+    }
+
+    if (ESP_OK == eErr)
+    {
+        eErr = ESP_ERR_NO_MEM;
+        for (uint8_t u8Index = 0; u8Index < HOST_NVS_HANDLES; u8Index++)
+        {
+            if ('\0' == _stESP.aacHandle[u8Index][0])
+            {
+                snprintf(_stESP.aacHandle[u8Index], HOST_NVS_KEY_LEN, "%s", pacNamespace);
+                _stESP.abWritable[u8Index] = NVS_READWRITE == eMode;
+                *phNVS = u8Index + 1;
+                eErr   = ESP_OK;
+                break;
+            }
+        }
+    }
+
+    pthread_mutex_unlock(&_stESP.stNVSLock);
+    return eErr;
+}
+
+void nvs_close(nvs_handle hNVS)
+{
+    if (hNVS > 0 && hNVS <= HOST_NVS_HANDLES)
+    {
+        pthread_mutex_lock(&_stESP.stNVSLock);
+        _stESP.aacHandle[hNVS - 1][0] = '\0';
+        pthread_mutex_unlock(&_stESP.stNVSLock);
+    }
+}
+
+esp_err_t nvs_commit(nvs_handle hNVS)
+{
+    (void)hNVS;
+    return ESP_OK;
+}
+
+esp_err_t nvs_erase_key(nvs_handle hNVS, const char* pacKey)
+{
+    HostNVSEntry* pstEntry;
+    esp_err_t     eErr = ESP_ERR_NVS_NOT_FOUND;
+
+    pthread_mutex_lock(&_stESP.stNVSLock);
+    pstEntry = _HostNVSFind(hNVS, pacKey);
+    if (NULL != pstEntry)
+    {
+        pstEntry->bUsed = false;
+        eErr            = ESP_OK;
+    }
+    pthread_mutex_unlock(&_stESP.stNVSLock);
+
+    return eErr;
+}
+
+esp_err_t nvs_erase_all(nvs_handle hNVS)
+{
+    if (0 == hNVS || hNVS > HOST_NVS_HANDLES)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    pthread_mutex_lock(&_stESP.stNVSLock);
+    for (uint8_t u8Index = 0; u8Index < HOST_NVS_ENTRIES; u8Index++)
+    {
+        if (0 == strcmp(_stESP.astNVS[u8Index].acNamespace, _stESP.aacHandle[hNVS - 1]))
+        {
+            _stESP.astNVS[u8Index].bUsed = false;
+        }
+    }
+    pthread_mutex_unlock(&_stESP.stNVSLock);
+
+    return ESP_OK;
+}
+
+esp_err_t nvs_set_u8(nvs_handle hNVS, const char* pacKey, uint8_t u8Value)
+{
+    return _HostNVSSet(hNVS, pacKey, &u8Value, sizeof(u8Value));
+}
+
+esp_err_t nvs_get_u8(nvs_handle hNVS, const char* pacKey, uint8_t* pu8Value)
+{
+    return _HostNVSGet(hNVS, pacKey, pu8Value, sizeof(*pu8Value));
+}
+
+esp_err_t nvs_set_u16(nvs_handle hNVS, const char* pacKey, uint16_t u16Value)
+{
+    return _HostNVSSet(hNVS, pacKey, &u16Value, sizeof(u16Value));
+}
+
+esp_err_t nvs_get_u16(nvs_handle hNVS, const char* pacKey, uint16_t* pu16Value)
+{
+    return _HostNVSGet(hNVS, pacKey, pu16Value, sizeof(*pu16Value));
+}
+
+esp_err_t nvs_set_u32(nvs_handle hNVS, const char* pacKey, uint32_t u32Value)
+{
+    return _HostNVSSet(hNVS, pacKey, &u32Value, sizeof(u32Value));
+}
+
+esp_err_t nvs_get_u32(nvs_handle hNVS, const char* pacKey, uint32_t* pu32Value)
+{
+    return _HostNVSGet(hNVS, pacKey, pu32Value, sizeof(*pu32Value));
+}
+
+esp_err_t nvs_set_str(nvs_handle hNVS, const char* pacKey, const char* pacValue)
+{
+    return _HostNVSSet(hNVS, pacKey, pacValue, strlen(pacValue) + 1);
+}
+
+esp_err_t nvs_get_str(nvs_handle hNVS, const char* pacKey, char* pacValue, size_t* puSize)
+{
+    return nvs_get_blob(hNVS, pacKey, pacValue, puSize);
+}
+
+esp_err_t nvs_set_blob(nvs_handle hNVS, const char* pacKey, const void* pValue, size_t uSize)
+{
+    return _HostNVSSet(hNVS, pacKey, pValue, uSize);
+}
+
+esp_err_t nvs_get_blob(nvs_handle hNVS, const char* pacKey, void* pValue, size_t* puSize)
+{
+    HostNVSEntry* pstEntry;
+    esp_err_t     eErr = ESP_OK;
+
+    pthread_mutex_lock(&_stESP.stNVSLock);
+    pstEntry = _HostNVSFind(hNVS, pacKey);
+    if (NULL == pstEntry)
+    {
+        eErr = ESP_ERR_NVS_NOT_FOUND;
+    }
+    else if (NULL == pValue)
+    {
+        // Size query.
+        *puSize = pstEntry->uSize;
+    }
+    else if (*puSize < pstEntry->uSize)
+    {
+        eErr = ESP_ERR_NVS_INVALID_LENGTH;
+    }
+    else
+    {
+        memcpy(pValue, pstEntry->au8Value, pstEntry->uSize);
+        *puSize = pstEntry->uSize;
+    }
+    pthread_mutex_unlock(&_stESP.stNVSLock);
+
+    return eErr;
+}
+
+esp_err_t esp_event_loop_init(system_event_cb_t pfnCallback, void* pCtx)
+{
+    esp_timer_create_args_t stArgs;
+
+    _stESP.pfnEvent    = pfnCallback;
+    _stESP.pEventCtx   = pCtx;
+    _stESP.hEventQueue = xQueueCreate(HOST_EVENT_QUEUE, sizeof(system_event_t));
+    if (NULL == _stESP.hEventQueue)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+
+    memset(&stArgs, 0, sizeof(stArgs));
+    stArgs.callback        = _HostConnectDone;
+    stArgs.dispatch_method = ESP_TIMER_TASK;
+    stArgs.name            = "HostWiFi";
+    ESP_ERROR_CHECK(esp_timer_create(&stArgs, &_stESP.hConnectTimer));
+    stArgs.callback        = _HostSCStep;
+    stArgs.name            = "HostSmartConfig";
+    ESP_ERROR_CHECK(esp_timer_create(&stArgs, &_stESP.hSCTimer));
+
+    xTaskCreatePinnedToCore(
+        _HostEventThread, "eventTask", 4096, NULL,
+        HOST_TASK_PRIO_EVENT, NULL, PRO_CPU_NUM);
+
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_init(const wifi_init_config_t* pstConfig)
+{
+    (void)pstConfig;
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_storage(wifi_storage_t eStorage)
+{
+    (void)eStorage;
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_mode(wifi_mode_t eMode)
+{
+    return WIFI_MODE_STA == eMode ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t esp_wifi_start(void)
+{
+    system_event_t stEvent = { .event_id = SYSTEM_EVENT_STA_START };
+
+    _HostPostEvent(&stEvent);
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_connect(void)
+{
+    wifi_sta_config_t* pstSTA = &_stESP.stConfig.sta;
+    uint32_t           u32Ms  = HOST_WIFI_SCAN_MS;
+
+    pthread_mutex_lock(&_stESP.stWiFiLock);
+    memset(&_stESP.stOutcome, 0, sizeof(system_event_t));
+    if (0 != strncmp((const char*)pstSTA->ssid, HOST_WIFI_SSID, sizeof(pstSTA->ssid)))
+    {
+        _stESP.stOutcome.event_id                          = SYSTEM_EVENT_STA_DISCONNECTED;
+        _stESP.stOutcome.event_info.disconnected.reason    = WIFI_REASON_NO_AP_FOUND;
+    }
+    else
+    {
+        _stESP.stOutcome.event_id = SYSTEM_EVENT_STA_GOT_IP;
+        if (pstSTA->bssid_set && HOST_WIFI_CHANNEL == pstSTA->channel &&
+            0 == memcmp(pstSTA->bssid, _au8BSSID, sizeof(_au8BSSID)))
+        {
+            u32Ms = HOST_WIFI_FAST_MS;
+        }
+    }
+    pthread_mutex_unlock(&_stESP.stWiFiLock);
+
+    esp_timer_stop(_stESP.hConnectTimer);
+    return esp_timer_start_once(_stESP.hConnectTimer, (uint64_t)u32Ms * 1000);
+}
+
+esp_err_t esp_wifi_disconnect(void)
+{
+    system_event_t stEvent = { .event_id = SYSTEM_EVENT_STA_DISCONNECTED };
+    bool           bWasUp;
+
+    esp_timer_stop(_stESP.hConnectTimer);
+
+    pthread_mutex_lock(&_stESP.stWiFiLock);
+    bWasUp             = _stESP.bConnected;
+    _stESP.bConnected  = false;
+    pthread_mutex_unlock(&_stESP.stWiFiLock);
+
+    if (! bWasUp)
+    {
+        return ESP_ERR_WIFI_NOT_CONNECT;
+    }
+    stEvent.event_info.disconnected.reason = WIFI_REASON_ASSOC_LEAVE;
+    _HostPostEvent(&stEvent);
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_config(wifi_interface_t eIf, wifi_config_t* pstConfig)
+{
+    if (ESP_IF_WIFI_STA != eIf)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&_stESP.stWiFiLock);
+    _stESP.stConfig = *pstConfig;
+    pthread_mutex_unlock(&_stESP.stWiFiLock);
+
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_get_config(wifi_interface_t eIf, wifi_config_t* pstConfig)
+{
+    if (ESP_IF_WIFI_STA != eIf)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // Before the first set_config, what the library had in flash.
+    memset(pstConfig, 0, sizeof(wifi_config_t));
+    pthread_mutex_lock(&_stESP.stWiFiLock);
+    if ('\0' != _stESP.stConfig.sta.ssid[0])
+    {
+        *pstConfig = _stESP.stConfig;
+    }
+    else
+    {
+        memcpy(pstConfig->sta.ssid, _stESP.acSSID, strnlen(_stESP.acSSID, sizeof(pstConfig->sta.ssid)));
+    }
+    pthread_mutex_unlock(&_stESP.stWiFiLock);
+
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_sta_get_ap_info(wifi_ap_record_t* pstAP)
+{
+    bool bConnected;
+
+    pthread_mutex_lock(&_stESP.stWiFiLock);
+    bConnected = _stESP.bConnected;
+    pthread_mutex_unlock(&_stESP.stWiFiLock);
+
+    if (! bConnected)
+    {
+        return ESP_ERR_WIFI_NOT_CONNECT;
+    }
+    memset(pstAP, 0, sizeof(wifi_ap_record_t));
+    memcpy(pstAP->bssid, _au8BSSID, sizeof(_au8BSSID));
+    snprintf((char*)pstAP->ssid, sizeof(pstAP->ssid), "%s", HOST_WIFI_SSID);
+    pstAP->primary = HOST_WIFI_CHANNEL;
+    pstAP->rssi    = -40;
+
+    return ESP_OK;
+}
+
+esp_err_t esp_smartconfig_set_type(smartconfig_type_t eType)
+{
+    (void)eType;
+    return ESP_OK;
+}
+
+esp_err_t esp_smartconfig_start(sc_callback_t pfnCallback, ...)
+{
+    _stESP.pfnSC = pfnCallback;
+    pfnCallback(SC_STATUS_WAIT, NULL);
+
+    esp_timer_stop(_stESP.hSCTimer);
+    return esp_timer_start_once(_stESP.hSCTimer, (uint64_t)HOST_WIFI_SC_MS * 1000);
+}
+
+esp_err_t esp_smartconfig_stop(void)
+{
+    esp_timer_stop(_stESP.hSCTimer);
+    return ESP_OK;
+}
+
+void tcpip_adapter_init(void)
+{
+    _stESP.stIP.ip.addr      = htonl(INADDR_LOOPBACK);
+    _stESP.stIP.netmask.addr = htonl(0xff000000);
+    _stESP.stIP.gw.addr      = htonl(INADDR_LOOPBACK);
+}
+
+esp_err_t tcpip_adapter_dhcpc_start(tcpip_adapter_if_t eIf)
+{
+    (void)eIf;
+    pthread_mutex_lock(&_stESP.stWiFiLock);
+    _stESP.bStaticIP = false;
+    pthread_mutex_unlock(&_stESP.stWiFiLock);
+    tcpip_adapter_init();
+
+    return ESP_OK;
+}
+
+esp_err_t tcpip_adapter_dhcpc_stop(tcpip_adapter_if_t eIf)
+{
+    (void)eIf;
+    pthread_mutex_lock(&_stESP.stWiFiLock);
+    _stESP.bStaticIP = true;
+    pthread_mutex_unlock(&_stESP.stWiFiLock);
+
+    return ESP_OK;
+}
+
+esp_err_t tcpip_adapter_get_ip_info(tcpip_adapter_if_t eIf, tcpip_adapter_ip_info_t* pstIP)
+{
+    (void)eIf;
+    pthread_mutex_lock(&_stESP.stWiFiLock);
+    *pstIP = _stESP.stIP;
+    pthread_mutex_unlock(&_stESP.stWiFiLock);
+
+    return ESP_OK;
+}
+
+esp_err_t tcpip_adapter_set_ip_info(tcpip_adapter_if_t eIf, const tcpip_adapter_ip_info_t* pstIP)
+{
+    (void)eIf;
+    pthread_mutex_lock(&_stESP.stWiFiLock);
+    _stESP.stIP = *pstIP;
+    pthread_mutex_unlock(&_stESP.stWiFiLock);
+
+    return ESP_OK;
+}
+
+/**
+ * @fn     void _HostTimerThread(void* pArg)
+ * @brief  Run the callbacks of expired timers
+ * @param  pArg
+ *         Unused
+ */
+static void _HostTimerThread(void* pArg)
+{
+    (void)pArg;
+
+    pthread_mutex_lock(&_stESP.stTimerLock);
+    while (1)
+    {
+        struct HostTimer_t* pstNext = NULL;
+        struct timespec     stDue;
+        int64_t             s64Now;
+
+        for (struct HostTimer_t* pstTimer = _stESP.pstTimers; NULL != pstTimer; pstTimer = pstTimer->pstNext)
+        {
+            if (pstTimer->bArmed && (NULL == pstNext || pstTimer->s64Due < pstNext->s64Due))
+            {
+                pstNext = pstTimer;
+            }
+        }
+
+        if (NULL == pstNext)
+        {
+            pthread_cond_wait(&_stESP.stTimerCond, &_stESP.stTimerLock);
+            continue;
+        }
+
+        s64Now = esp_timer_get_time();
+        if (pstNext->s64Due > s64Now)
+        {
+            HostTimeToSpec(pstNext->s64Due, &stDue);
+            pthread_cond_timedwait(&_stESP.stTimerCond, &_stESP.stTimerLock, &stDue);
+            continue;
+        }
+
+        if (0 == pstNext->u64Period)
+        {
+            pstNext->bArmed = false;
+        }
+        else
+        {
+            pstNext->s64Due += (int64_t)pstNext->u64Period;
+        }
+
+        // The callback may start, stop or delete timers itself.
+        pthread_mutex_unlock(&_stESP.stTimerLock);
+        pstNext->pfnCallback(pstNext->pArg);
+        pthread_mutex_lock(&_stESP.stTimerLock);
+    }
+}
+
+/**
+ * @fn     void _HostEventThread(void* pArg)
+ * @brief  Hand system events to the event handler
+ * @param  pArg
+ *         Unused
+ */
+static void _HostEventThread(void* pArg)
+{
+    system_event_t stEvent;
+    (void)pArg;
+
+    while (1)
+    {
+        if (pdTRUE == xQueueReceive(_stESP.hEventQueue, &stEvent, portMAX_DELAY))
+        {
+            _stESP.pfnEvent(_stESP.pEventCtx, &stEvent);
+        }
+    }
+}
+
+/**
+ * @fn     void _HostPostEvent(const system_event_t* pstEvent)
+ * @brief  Queue a system event
+ * @param  pstEvent
+ *         Event
+ */
+static void _HostPostEvent(const system_event_t* pstEvent)
+{
+    if (NULL == _stESP.hEventQueue || pdTRUE != xQueueSend(_stESP.hEventQueue, pstEvent, 0))
+    {
+        ESP_LOGE("Host", "System event %d lost.", pstEvent->event_id);
+    }
+}
+
+/**
+ * @fn     void _HostConnectDone(void* pArg)
+ * @brief  End the pending connection attempt
+ * @param  pArg
+ *         Unused
+ */
+static void _HostConnectDone(void* pArg)
+{
+    system_event_t stEvent;
+    (void)pArg;
+
+    pthread_mutex_lock(&_stESP.stWiFiLock);
+    stEvent           = _stESP.stOutcome;
+    _stESP.bConnected = SYSTEM_EVENT_STA_GOT_IP == stEvent.event_id;
+    pthread_mutex_unlock(&_stESP.stWiFiLock);
+
+    if (SYSTEM_EVENT_STA_GOT_IP == stEvent.event_id)
+    {
+        system_event_t stConnected = { .event_id = SYSTEM_EVENT_STA_CONNECTED };
+
+        _HostPostEvent(&stConnected);
+    }
+    _HostPostEvent(&stEvent);
+}
+
+/**
+ * @fn     void _HostSCStep(void* pArg)
+ * @brief  Hand out the virtual access point by SmartConfig
+ * @param  pArg
+ *         Unused
+ */
+static void _HostSCStep(void* pArg)
+{
+    wifi_config_t stConfig;
+    uint8_t       au8Phone[4] = { 127, 0, 0, 1 };
+    (void)pArg;
+
+    memset(&stConfig, 0, sizeof(wifi_config_t));
+    snprintf((char*)stConfig.sta.ssid, sizeof(stConfig.sta.ssid), "%s", HOST_WIFI_SSID);
+
+    _stESP.pfnSC(SC_STATUS_FIND_CHANNEL, NULL);
+    _stESP.pfnSC(SC_STATUS_GETTING_SSID_PSWD, NULL);
+    _stESP.pfnSC(SC_STATUS_LINK, &stConfig);
+    _stESP.pfnSC(SC_STATUS_LINK_OVER, au8Phone);
+}
+
+/**
+ * @fn      HostNVSEntry* _HostNVSFind(nvs_handle hNVS, const char* pacKey)
+ * @brief   Look up a key, the NVS lock has to be held
+ * @param   hNVS
+ *          Handle of the namespace
+ * @param   pacKey
+ *          Key
+ * @return  Entry, NULL if not found
+ */
+static HostNVSEntry* _HostNVSFind(nvs_handle hNVS, const char* pacKey)
+{
+    if (0 == hNVS || hNVS > HOST_NVS_HANDLES)
+    {
+        return NULL;
+    }
+    for (uint8_t u8Index = 0; u8Index < HOST_NVS_ENTRIES; u8Index++)
+    {
+        HostNVSEntry* pstEntry = &_stESP.astNVS[u8Index];
+
+        if (pstEntry->bUsed &&
+            0 == strcmp(pstEntry->acNamespace, _stESP.aacHandle[hNVS - 1]) &&
+            0 == strcmp(pstEntry->acKey, pacKey))
+        {
+            return pstEntry;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @fn      esp_err_t _HostNVSSet(nvs_handle hNVS, const char* pacKey, const void* pValue, size_t uSize)
+ * @brief   Store a value
+ * @param   hNVS
+ *          Handle of the namespace
+ * @param   pacKey
+ *          Key
+ * @param   pValue
+ *          Value
+ * @param   uSize
+ *          Size of the value in bytes
+ * @return  Error code
+ */
+static esp_err_t _HostNVSSet(nvs_handle hNVS, const char* pacKey, const void* pValue, size_t uSize)
+{
+    HostNVSEntry* pstEntry;
+    esp_err_t     eErr = ESP_OK;
+
+    if (0 == hNVS || hNVS > HOST_NVS_HANDLES || strlen(pacKey) >= HOST_NVS_KEY_LEN)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (uSize > HOST_NVS_VALUE_SIZE)
+    {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    pthread_mutex_lock(&_stESP.stNVSLock);
+    if (! _stESP.abWritable[hNVS - 1])
+    {
+        eErr = ESP_ERR_INVALID_STATE;
+    }
+    else
+    {
+        pstEntry = _HostNVSFind(hNVS, pacKey);
+        for (uint8_t u8Index = 0; u8Index < HOST_NVS_ENTRIES && NULL == pstEntry; u8Index++)
+        {
+            if (! _stESP.astNVS[u8Index].bUsed)
+            {
+                pstEntry = &_stESP.astNVS[u8Index];
+            }
+        }
+        if (NULL == pstEntry)
+        {
+            eErr = ESP_ERR_NO_MEM;
+        }
+        else
+        {
+            pstEntry->bUsed = true;
+            pstEntry->uSize = uSize;
+            snprintf(pstEntry->acNamespace, HOST_NVS_KEY_LEN, "%s", _stESP.aacHandle[hNVS - 1]);
+            snprintf(pstEntry->acKey, HOST_NVS_KEY_LEN, "%s", pacKey);
+            memcpy(pstEntry->au8Value, pValue, uSize);
+        }
+    }
+    pthread_mutex_unlock(&_stESP.stNVSLock);
+
+    return eErr;
+}
+
+/**
+ * @fn      esp_err_t _HostNVSGet(nvs_handle hNVS, const char* pacKey, void* pValue, size_t uSize)
+ * @brief   Read an integer value
+ * @param   hNVS
+ *          Handle of the namespace
+ * @param   pacKey
+ *          Key
+ * @param   pValue
+ *          Destination
+ * @param   uSize
+ *          Size of the integer type
+ * @return  Error code
+ */
+static esp_err_t _HostNVSGet(nvs_handle hNVS, const char* pacKey, void* pValue, size_t uSize)
+{
+    HostNVSEntry* pstEntry;
+    esp_err_t     eErr = ESP_OK;
+
+    pthread_mutex_lock(&_stESP.stNVSLock);
+    pstEntry = _HostNVSFind(hNVS, pacKey);
+    if (NULL == pstEntry)
+    {
+        eErr = ESP_ERR_NVS_NOT_FOUND;
+    }
+    else if (uSize != pstEntry->uSize)
+    {
+        eErr = ESP_ERR_NVS_INVALID_LENGTH;
+    }
+    else
+    {
+        memcpy(pValue, pstEntry->au8Value, uSize);
+    }
+    pthread_mutex_unlock(&_stESP.stNVSLock);
+
+    return eErr;
+}
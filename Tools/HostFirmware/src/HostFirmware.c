@@ -0,0 +1,237 @@
+/**
+ * @file       HostFirmware.c
+ * @brief      The firmware as a Linux process
+ * @details    Boots the firmware on a virtual adapter, see Host.h, and
+ *             prints what it did when the run time is over.  The
+ *             terminal listens on TERMINAL_PORT, the network code talks
+ *             to the real Server via loopback.  Usage:
+ * @code{.unparsed}
+ *   HostFirmware [-s server addr] [-p server port] [-t seconds]
+ *                [-f frame period µs] [-i controller word] [-w ssid] [-r]
+ *
+ *   -s, -p  Store the exchange server in NVS, the run fails if no
+ *           connection is established
+ *   -t      Run time, 0 = until SIGINT, default 10
+ *   -f      Latch period of the virtual console, 0 = console off
+ *   -i      Fixed controller word in hex instead of the demo pattern
+ *   -w      Network the WiFi library has stored, "" = SmartConfig
+ *   -r      Run tasks with SCHED_FIFO at their FreeRTOS priority
+ * @endcode
+ *             Fails if the firmware does not boot up to the IP address
+ *             or never reads the controller.
+ * @defgroup   HostFirmware Firmware host build
+ * @ingroup    HostFirmware
+ * @author     SNESoIP contributors
+ * @copyright  "THE BEER-WARE LICENCE" (Revision 42)
+ */
+
+#define _GNU_SOURCE
+
+#include <arpa/inet.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "Boot.h"
+#include "ExchangeClient.h"
+#include "Host.h"
+#include "Netplay.h"
+#include "SNES.h"
+
+void app_main(void);
+
+static volatile sig_atomic_t _bStop;
+
+static void _Stop(int nSignal);
+static void _PrintSummary(void);
+
+int main(int argc, char* argv[])
+{
+    const char*    pacServer  = NULL;
+    uint16_t       u16Port    = EXCHANGE_SERVER_PORT;
+    unsigned long  ulSeconds  = 10;
+    uint32_t       u32Period  = HOST_FRAME_PERIOD_US;
+    bool           bRealtime  = false;
+    uint32_t       u32Needed  = BOOT_STAGE_NVS | BOOT_STAGE_SNES | BOOT_STAGE_WIFI | BOOT_STAGE_IP;
+    int            nOption;
+    struct timespec stStart;
+
+    while (-1 != (nOption = getopt(argc, argv, "s:p:t:f:i:w:r")))
+    {
+        switch (nOption)
+        {
+            case 's':
+                pacServer = optarg;
+                break;
+            case 'p':
+                u16Port = (uint16_t)strtoul(optarg, NULL, 10);
+                break;
+            case 't':
+                ulSeconds = strtoul(optarg, NULL, 10);
+                break;
+            case 'f':
+                u32Period = (uint32_t)strtoul(optarg, NULL, 10);
+                break;
+            case 'i':
+                HostSetPad(false, (uint16_t)strtoul(optarg, NULL, 16));
+                break;
+            case 'w':
+                HostSetWiFiSSID(optarg);
+                break;
+            case 'r':
+                bRealtime = true;
+                break;
+            default:
+                fprintf(stderr,
+                        "Usage: %s [-s server addr] [-p server port] [-t seconds]\n"
+                        "       [-f frame period us] [-i controller word] [-w ssid] [-r]\n",
+                        argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGINT, _Stop);
+    signal(SIGTERM, _Stop);
+
+    HostInit(bRealtime);
+
+    if (NULL != pacServer)
+    {
+        if (! SetExchangeServer(pacServer, u16Port))
+        {
+            fprintf(stderr, "Invalid server address: %s\n", pacServer);
+            return EXIT_FAILURE;
+        }
+        u32Needed |= BOOT_STAGE_EXCHANGE;
+    }
+
+    HostStartConsole(u32Period);
+
+    // Like the ESP-IDF, the main task ends after app_main().
+    app_main();
+    vTaskDelete(NULL);
+
+    clock_gettime(CLOCK_MONOTONIC, &stStart);
+    while (! _bStop)
+    {
+        struct timespec stNow;
+
+        sleep(1);
+        clock_gettime(CLOCK_MONOTONIC, &stNow);
+        if (ulSeconds > 0 && (unsigned long)(stNow.tv_sec - stStart.tv_sec) >= ulSeconds)
+        {
+            break;
+        }
+    }
+
+    _PrintSummary();
+
+    if (u32Needed != (GetBootStages() & u32Needed))
+    {
+        fprintf(stderr, "Boot incomplete: stages 0x%02x of 0x%02x.\n",
+                (unsigned)(GetBootStages() & u32Needed), (unsigned)u32Needed);
+        return EXIT_FAILURE;
+    }
+    if (0 != u32Period)
+    {
+        SNESCaptureStats stCapture;
+
+        GetSNESCaptureStats(&stCapture);
+        if (0 == stCapture.u32Captures)
+        {
+            fprintf(stderr, "No controller reads.\n");
+            return EXIT_FAILURE;
+        }
+    }
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @fn     void _Stop(int nSignal)
+ * @brief  End the run
+ */
+static void _Stop(int nSignal)
+{
+    (void)nSignal;
+    _bStop = 1;
+}
+
+/**
+ * @fn     void _PrintSummary(void)
+ * @brief  Print boot, capture, console and network statistics
+ */
+static void _PrintSummary(void)
+{
+    static const char* const apacStage[BOOT_STAGES] = { "nvs", "snes", "wifi", "ip", "exchange" };
+    static const char* const apacPath[]             = { "register", "punch", "direct", "relay" };
+    SNESCaptureStats    stCapture;
+    SNESTimingHistogram stTiming;
+    SNESLatchStats      stLatch;
+    SNESPortStats       astPort[2];
+    NetplayStats        stNetplay;
+    HostConsoleStats    stConsole;
+    uint32_t            u32Reached = GetBootStages();
+    uint8_t             u8ClientID;
+
+    GetSNESCaptureStats(&stCapture);
+    GetSNESTimingHistogram(&stTiming);
+    GetSNESLatchStats(&stLatch);
+    GetSNESPortStats(0, &astPort[0]);
+    GetSNESPortStats(1, &astPort[1]);
+    GetNetplayStats(&stNetplay);
+    HostGetConsoleStats(&stConsole);
+
+    printf("\nBoot\n");
+    for (uint8_t u8Index = 0; u8Index < BOOT_STAGES; u8Index++)
+    {
+        if (u32Reached & (1UL << u8Index))
+        {
+            printf("  %-8s %6u ms\n", apacStage[u8Index], GetBootStageMs(1UL << u8Index));
+        }
+        else
+        {
+            printf("  %-8s      - \n", apacStage[u8Index]);
+        }
+    }
+
+    printf("Capture\n");
+    printf("  reads %u, timeouts %u\n", stCapture.u32Captures, stCapture.u32Timeouts);
+    printf("  latency min/avg/max %u/%u/%u us\n",
+           stCapture.u32LatencyMin, stCapture.u32LatencyAvg, stCapture.u32LatencyMax);
+    printf("  edge jitter max %u us, reader wake max %u us, latch sync late max %u us\n",
+           stTiming.u32JitterMax, stTiming.u32WakeMax, stTiming.u32LateMax);
+
+    printf("Console\n");
+    printf("  frames %u, latch deviation max %u us, period seen %u us\n",
+           stConsole.u32Frames, stConsole.u32LatchMax, stLatch.u32FramePeriod);
+    for (uint8_t u8Port = 0; u8Port < 2; u8Port++)
+    {
+        printf("  port %u: words %u, changes %u, last %04x, empty %u, missed %u, queue errors %u\n",
+               u8Port, stConsole.au32Words[u8Port], stConsole.au32Changes[u8Port],
+               stConsole.au16Last[u8Port], stConsole.au32Empty[u8Port],
+               astPort[u8Port].u32MissedLatches, astPort[u8Port].u32QueueErrors);
+    }
+    printf("  input age min/avg/max %u/%u/%u us\n",
+           stLatch.u32AgeMin, stLatch.u32AgeAvg, stLatch.u32AgeMax);
+
+    printf("Network\n");
+    if (GetExchangeClientID(&u8ClientID))
+    {
+        printf("  exchange client %u, rtt %u us\n", u8ClientID, GetExchangeRTT());
+    }
+    else
+    {
+        printf("  exchange not connected\n");
+    }
+    printf("  netplay tx %u, rx %u, lost %u, rtt %u us, path %s\n",
+           stNetplay.u32TxPackets, stNetplay.u32RxPackets, stNetplay.u32Lost, stNetplay.u32RTTSmooth,
+           apacPath[GetNetplayPath()]);
+}
@@ -0,0 +1,1126 @@
+/**
+ * @file       HostRTOS.c
+ * @brief      FreeRTOS on POSIX threads
+ * @ingroup    HostFirmware
+ * @details
+ * @code{.unparsed}
+ *
+ * Just enough of the ESP32 FreeRTOS port to run the firmware as a
+ * Linux process:
+ *
+ *   tasks            one thread each, pinned to host CPU 0 or 1 if the
+ *                    host has two, with SCHED_FIFO at the FreeRTOS
+ *                    priority if started with -r and allowed to
+ *   ticks            10 ms like the firmware's sdkconfig, delays and
+ *                    timeouts end on a tick boundary as on the ESP32
+ *   notify, queues,  one kernel lock, a condition variable per object
+ *   semaphores,
+ *   ring buffers,
+ *   event groups
+ *   critical         recursive mutexes, see FreeRTOS.h
+ *   sections
+ *
+ * The kernel has no switch hook here, so a task counts as switched in
+ * when it returns from a blocking call.  That is what the trace shows
+ * as a task switch, see Trace.c.
+ *
+ * Interrupt handlers run in the threads of the virtual hardware and
+ * may call the FromISR functions, which are the same as the others.
+ *
+ * @endcode
+ * @author     SNESoIP contributors
+ * @copyright  "THE BEER-WARE LICENCE" (Revision 42)
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+#include "freertos/queue.h"
+#include "freertos/ringbuf.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "Host.h"
+#include "TraceHooks.h"
+
+/**
+ * @struct  HostTask
+ * @brief   Task
+ */
+typedef struct HostTask_t
+{
+    pthread_t      stThread;
+    clockid_t      stCPUClock;                      ///< CPU time of the thread
+    bool           bCPUClock;
+    TaskFunction_t pfnTask;
+    void*          pArg;
+    char           acName[configMAX_TASK_NAME_LEN];
+    UBaseType_t    uPriority;
+    BaseType_t     xCore;
+    UBaseType_t    uNumber;
+    uint32_t       u32Notify;                       ///< Notification value
+    pthread_cond_t stNotify;
+    bool           bUsed;
+
+} HostTask;
+
+/**
+ * @struct  HostQueue
+ * @brief   Queue, or semaphore without item data
+ */
+struct HostQueue_t
+{
+    uint8_t*       pu8Items;
+    UBaseType_t    uLength;
+    UBaseType_t    uItemSize;
+    UBaseType_t    uCount;
+    UBaseType_t    uHead;
+    pthread_cond_t stCond;
+};
+
+/**
+ * @struct  HostRingItem
+ * @brief   Item of a ring buffer without split items
+ */
+typedef struct HostRingItem_t
+{
+    struct HostRingItem_t* pstNext;
+    size_t                 uSize;
+    uint8_t                au8Data[];
+
+} HostRingItem;
+
+/**
+ * @struct  HostRingbuf
+ * @brief   Ring buffer
+ */
+struct HostRingbuf_t
+{
+    ringbuf_type_t eType;
+    uint8_t*       pu8Data;     ///< Byte buffer
+    size_t         uSize;
+    size_t         uRead;       ///< Byte buffer read position
+    size_t         uUsed;       ///< Bytes stored, including items handed out
+    size_t         uLent;       ///< Bytes handed out by the byte buffer
+    HostRingItem*  pstFirst;    ///< Items not handed out yet
+    HostRingItem*  pstLast;
+    pthread_cond_t stCond;
+};
+
+/**
+ * @struct  HostEventGroup
+ * @brief   Event group
+ */
+struct HostEventGroup_t
+{
+    EventBits_t    uBits;
+    pthread_cond_t stCond;
+};
+
+/**
+ * @struct  HostRTOS
+ * @brief   Kernel data
+ */
+typedef struct HostRTOS_t
+{
+    pthread_mutex_t    stLock;                    ///< Kernel lock
+    pthread_condattr_t stCondAttr;                ///< CLOCK_MONOTONIC
+    HostTask           astTask[HOST_MAX_TASKS];
+    UBaseType_t        uNextNumber;
+    bool               bRealtime;
+    long               lCPUs;
+
+} HostRTOS;
+
+/**
+ * @var    _stRTOS
+ * @brief  Kernel private data
+ */
+static HostRTOS _stRTOS;
+
+/**
+ * @var    _pstSelf
+ * @brief  Task of the calling thread, NULL in interrupt handlers
+ */
+static __thread HostTask* _pstSelf;
+
+/**
+ * @var    _nCore
+ * @brief  Core the calling thread runs on
+ */
+static __thread int _nCore;
+
+static void* _HostTaskEntry(void* pArg);
+static void  _HostCondInit(pthread_cond_t* pstCond);
+static bool  _HostDeadline(TickType_t xTicks, struct timespec* pstDeadline);
+static bool  _HostWait(pthread_cond_t* pstCond, TickType_t xTicks, const struct timespec* pstDeadline);
+static void  _HostResumed(void);
+static void  _HostRegister(HostTask* pstTask, const char* pacName, UBaseType_t uPriority, BaseType_t xCore);
+
+/**
+ * @fn     void HostInit(bool bRealtime)
+ * @brief  Bring up the virtual adapter
+ * @note   The calling thread becomes the main task, like app_main().
+ * @param  bRealtime
+ *         Run tasks with SCHED_FIFO at their priority
+ */
+void HostInit(bool bRealtime)
+{
+    HostInitRTOS(bRealtime);
+    HostInitESP();
+    HostInitSNES();
+}
+
+/**
+ * @fn     void HostInitRTOS(bool bRealtime)
+ * @brief  Initialise the kernel and register the main task
+ * @param  bRealtime
+ *         Run tasks with SCHED_FIFO at their priority
+ */
+void HostInitRTOS(bool bRealtime)
+{
+    pthread_mutexattr_t stAttr;
+
+    memset(&_stRTOS, 0, sizeof(struct HostRTOS_t));
+    pthread_mutexattr_init(&stAttr);
+    pthread_mutex_init(&_stRTOS.stLock, &stAttr);
+    pthread_condattr_init(&_stRTOS.stCondAttr);
+    pthread_condattr_setclock(&_stRTOS.stCondAttr, CLOCK_MONOTONIC);
+    _stRTOS.bRealtime = bRealtime;
+    _stRTOS.lCPUs     = sysconf(_SC_NPROCESSORS_ONLN);
+
+    // The reader polls its core, on one CPU it would starve the other.
+    if (_stRTOS.bRealtime && _stRTOS.lCPUs < portNUM_PROCESSORS)
+    {
+        fprintf(stderr, "SCHED_FIFO needs %d CPUs, running without.\n", portNUM_PROCESSORS);
+        _stRTOS.bRealtime = false;
+    }
+
+    // app_main() runs in the main task on the PRO CPU.
+    _stRTOS.astTask[0].stThread = pthread_self();
+    _HostRegister(&_stRTOS.astTask[0], "main", 1, PRO_CPU_NUM);
+    _pstSelf = &_stRTOS.astTask[0];
+    _nCore   = PRO_CPU_NUM;
+    _stRTOS.astTask[0].bCPUClock =
+        0 == pthread_getcpuclockid(pthread_self(), &_stRTOS.astTask[0].stCPUClock);
+}
+
+/**
+ * @fn      void HostStartISRThread(void* (*pfnThread)(void*), const char* pacName)
+ * @brief   Start a thread of the virtual hardware
+ * @details With -r, it runs above all tasks, as interrupts do.
+ * @param   pfnThread
+ *          Thread function
+ * @param   pacName
+ *          Thread name
+ */
+void HostStartISRThread(void* (*pfnThread)(void*), const char* pacName)
+{
+    pthread_attr_t stAttr;
+    pthread_t      stThread;
+    int            nErr;
+
+    pthread_attr_init(&stAttr);
+    pthread_attr_setdetachstate(&stAttr, PTHREAD_CREATE_DETACHED);
+    if (_stRTOS.bRealtime)
+    {
+        struct sched_param stParam = { .sched_priority = configMAX_PRIORITIES + 1 };
+
+        pthread_attr_setinheritsched(&stAttr, PTHREAD_EXPLICIT_SCHED);
+        pthread_attr_setschedpolicy(&stAttr, SCHED_FIFO);
+        pthread_attr_setschedparam(&stAttr, &stParam);
+    }
+
+    nErr = pthread_create(&stThread, &stAttr, pfnThread, NULL);
+    if (EPERM == nErr)
+    {
+        pthread_attr_setinheritsched(&stAttr, PTHREAD_INHERIT_SCHED);
+        nErr = pthread_create(&stThread, &stAttr, pfnThread, NULL);
+    }
+    pthread_attr_destroy(&stAttr);
+
+    if (0 != nErr)
+    {
+        fprintf(stderr, "Unable to start %s: %s\n", pacName, strerror(nErr));
+        exit(EXIT_FAILURE);
+    }
+    pthread_setname_np(stThread, pacName);
+}
+
+/**
+ * @fn     void HostEnterISR(int nCore)
+ * @brief  Mark the calling thread as interrupt handler
+ * @param  nCore
+ *         Core the interrupt is allocated on
+ */
+void HostEnterISR(int nCore)
+{
+    _pstSelf = NULL;
+    _nCore   = nCore;
+}
+
+void vPortCPUInitializeMutex(portMUX_TYPE* pstMux)
+{
+    pthread_mutexattr_t stAttr;
+
+    pthread_mutexattr_init(&stAttr);
+    pthread_mutexattr_settype(&stAttr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&pstMux->stMutex, &stAttr);
+    pthread_mutexattr_destroy(&stAttr);
+}
+
+BaseType_t xPortGetCoreID(void)
+{
+    return _nCore;
+}
+
+void* pvPortMalloc(size_t uSize)
+{
+    return malloc(uSize);
+}
+
+void vPortFree(void* pMem)
+{
+    free(pMem);
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t pfnTask, const char* pacName, uint32_t u32StackDepth, void* pArg, UBaseType_t uPriority, TaskHandle_t* phTask, BaseType_t xCore)
+{
+    HostTask*      pstTask = NULL;
+    pthread_attr_t stAttr;
+    int            nErr;
+    (void)u32StackDepth;
+
+    pthread_mutex_lock(&_stRTOS.stLock);
+    for (uint8_t u8Index = 0; u8Index < HOST_MAX_TASKS; u8Index++)
+    {
+        if (! _stRTOS.astTask[u8Index].bUsed)
+        {
+            pstTask = &_stRTOS.astTask[u8Index];
+            break;
+        }
+    }
+    if (NULL == pstTask)
+    {
+        pthread_mutex_unlock(&_stRTOS.stLock);
+        fprintf(stderr, "Too many tasks, %s not created.\n", pacName);
+        return pdFAIL;
+    }
+    _HostRegister(pstTask, pacName, uPriority, xCore);
+    pstTask->pfnTask = pfnTask;
+    pstTask->pArg    = pArg;
+    pthread_mutex_unlock(&_stRTOS.stLock);
+
+    pthread_attr_init(&stAttr);
+    pthread_attr_setdetachstate(&stAttr, PTHREAD_CREATE_DETACHED);
+    if (_stRTOS.bRealtime)
+    {
+        struct sched_param stParam = { .sched_priority = (int)uPriority + 1 };
+
+        pthread_attr_setinheritsched(&stAttr, PTHREAD_EXPLICIT_SCHED);
+        pthread_attr_setschedpolicy(&stAttr, SCHED_FIFO);
+        pthread_attr_setschedparam(&stAttr, &stParam);
+    }
+
+    // Without the right to real-time scheduling, run them as they are.
+    nErr = pthread_create(&pstTask->stThread, &stAttr, _HostTaskEntry, pstTask);
+    if (EPERM == nErr)
+    {
+        pthread_attr_setinheritsched(&stAttr, PTHREAD_INHERIT_SCHED);
+        nErr = pthread_create(&pstTask->stThread, &stAttr, _HostTaskEntry, pstTask);
+    }
+    pthread_attr_destroy(&stAttr);
+
+    if (0 != nErr)
+    {
+        pthread_mutex_lock(&_stRTOS.stLock);
+        pstTask->bUsed = false;
+        pthread_cond_destroy(&pstTask->stNotify);
+        pthread_mutex_unlock(&_stRTOS.stLock);
+        fprintf(stderr, "Unable to start %s: %s\n", pacName, strerror(nErr));
+        return pdFAIL;
+    }
+
+    if (NULL != phTask)
+    {
+        *phTask = pstTask;
+    }
+    return pdPASS;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t pfnTask, const char* pacName, uint32_t u32StackDepth, void* pArg, UBaseType_t uPriority, TaskHandle_t* phTask)
+{
+    return xTaskCreatePinnedToCore(pfnTask, pacName, u32StackDepth, pArg, uPriority, phTask, tskNO_AFFINITY);
+}
+
+void vTaskDelete(TaskHandle_t hTask)
+{
+    HostTask* pstTask = (NULL == hTask) ? _pstSelf : (HostTask*)hTask;
+
+    if (pstTask != _pstSelf || NULL == pstTask)
+    {
+        // The firmware only ever deletes the calling task.
+        fprintf(stderr, "vTaskDelete: only the calling task can be deleted.\n");
+        return;
+    }
+
+    pthread_mutex_lock(&_stRTOS.stLock);
+    pstTask->bUsed = false;
+    pthread_cond_destroy(&pstTask->stNotify);
+    pthread_mutex_unlock(&_stRTOS.stLock);
+
+    // The main thread carries on as the host, see HostFirmware.c.
+    _pstSelf = NULL;
+    if (&_stRTOS.astTask[0] != pstTask)
+    {
+        pthread_exit(NULL);
+    }
+}
+
+void vTaskDelay(TickType_t xTicks)
+{
+    struct timespec stDeadline;
+
+    if (0 == xTicks)
+    {
+        sched_yield();
+        return;
+    }
+
+    _HostDeadline(xTicks, &stDeadline);
+    while (EINTR == clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &stDeadline, NULL))
+    {
+        continue;
+    }
+    _HostResumed();
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    return (TickType_t)(esp_timer_get_time() / 1000 / portTICK_PERIOD_MS);
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    return _pstSelf;
+}
+
+BaseType_t xTaskGetAffinity(TaskHandle_t hTask)
+{
+    HostTask* pstTask = (NULL == hTask) ? _pstSelf : (HostTask*)hTask;
+
+    return NULL == pstTask ? tskNO_AFFINITY : pstTask->xCore;
+}
+
+UBaseType_t uxTaskGetNumberOfTasks(void)
+{
+    UBaseType_t uCount = 0;
+
+    pthread_mutex_lock(&_stRTOS.stLock);
+    for (uint8_t u8Index = 0; u8Index < HOST_MAX_TASKS; u8Index++)
+    {
+        uCount += _stRTOS.astTask[u8Index].bUsed ? 1 : 0;
+    }
+    pthread_mutex_unlock(&_stRTOS.stLock);
+
+    return uCount;
+}
+
+UBaseType_t uxTaskGetSystemState(TaskStatus_t* pastStatus, UBaseType_t uSize, uint32_t* pu32TotalRunTime)
+{
+    UBaseType_t uCount = 0;
+
+    pthread_mutex_lock(&_stRTOS.stLock);
+    for (uint8_t u8Index = 0; u8Index < HOST_MAX_TASKS; u8Index++)
+    {
+        HostTask*       pstTask = &_stRTOS.astTask[u8Index];
+        TaskStatus_t*   pstStatus;
+        struct timespec stCPU   = { 0, 0 };
+
+        if (! pstTask->bUsed)
+        {
+            continue;
+        }
+        if (uCount == uSize)
+        {
+            pthread_mutex_unlock(&_stRTOS.stLock);
+            return 0;
+        }
+
+        if (pstTask->bCPUClock)
+        {
+            clock_gettime(pstTask->stCPUClock, &stCPU);
+        }
+        pstStatus = &pastStatus[uCount++];
+        memset(pstStatus, 0, sizeof(TaskStatus_t));
+        pstStatus->xHandle           = pstTask;
+        pstStatus->pcTaskName        = pstTask->acName;
+        pstStatus->xTaskNumber       = pstTask->uNumber;
+        pstStatus->eCurrentState     = pstTask == _pstSelf ? eRunning : eBlocked;
+        pstStatus->uxCurrentPriority = pstTask->uPriority;
+        pstStatus->uxBasePriority    = pstTask->uPriority;
+        pstStatus->ulRunTimeCounter  = (uint32_t)((int64_t)stCPU.tv_sec * 1000000 + stCPU.tv_nsec / 1000);
+        pstStatus->xCoreID           = pstTask->xCore;
+    }
+    pthread_mutex_unlock(&_stRTOS.stLock);
+
+    if (NULL != pu32TotalRunTime)
+    {
+        *pu32TotalRunTime = (uint32_t)esp_timer_get_time();
+    }
+    return uCount;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t xClear, TickType_t xTicks)
+{
+    HostTask*       pstTask = _pstSelf;
+    struct timespec stDeadline;
+    bool            bForever;
+    bool            bWaited = false;
+    uint32_t        u32Value;
+
+    if (NULL == pstTask)
+    {
+        return 0;
+    }
+
+    bForever = _HostDeadline(xTicks, &stDeadline);
+    pthread_mutex_lock(&_stRTOS.stLock);
+    while (0 == pstTask->u32Notify && 0 != xTicks)
+    {
+        bWaited = true;
+        if (! _HostWait(&pstTask->stNotify, xTicks, bForever ? NULL : &stDeadline))
+        {
+            break;
+        }
+    }
+    u32Value = pstTask->u32Notify;
+    if (u32Value > 0)
+    {
+        pstTask->u32Notify = xClear ? 0 : u32Value - 1;
+    }
+    pthread_mutex_unlock(&_stRTOS.stLock);
+
+    if (bWaited)
+    {
+        _HostResumed();
+    }
+    return u32Value;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t hTask)
+{
+    HostTask* pstTask = (HostTask*)hTask;
+
+    pthread_mutex_lock(&_stRTOS.stLock);
+    if (pstTask->bUsed)
+    {
+        pstTask->u32Notify++;
+        pthread_cond_broadcast(&pstTask->stNotify);
+    }
+    pthread_mutex_unlock(&_stRTOS.stLock);
+
+    return pdPASS;
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t hTask, BaseType_t* pxWoken)
+{
+    xTaskNotifyGive(hTask);
+    if (NULL != pxWoken)
+    {
+        *pxWoken = pdTRUE;
+    }
+}
+
+QueueHandle_t xQueueGenericCreate(UBaseType_t uLength, UBaseType_t uItemSize, UBaseType_t uInitial)
+{
+    QueueHandle_t hQueue = calloc(1, sizeof(struct HostQueue_t));
+
+    if (NULL == hQueue)
+    {
+        return NULL;
+    }
+    hQueue->uLength   = uLength;
+    hQueue->uItemSize = uItemSize;
+    hQueue->uCount    = uInitial;
+    if (uItemSize > 0)
+    {
+        hQueue->pu8Items = calloc(uLength, uItemSize);
+        if (NULL == hQueue->pu8Items)
+        {
+            free(hQueue);
+            return NULL;
+        }
+    }
+    _HostCondInit(&hQueue->stCond);
+
+    return hQueue;
+}
+
+BaseType_t xQueueSend(QueueHandle_t hQueue, const void* pItem, TickType_t xTicks)
+{
+    struct timespec stDeadline;
+    bool            bForever = _HostDeadline(xTicks, &stDeadline);
+    bool            bWaited  = false;
+    BaseType_t      xResult  = pdFALSE;
+
+    pthread_mutex_lock(&_stRTOS.stLock);
+    while (hQueue->uCount == hQueue->uLength && 0 != xTicks)
+    {
+        bWaited = true;
+        if (! _HostWait(&hQueue->stCond, xTicks, bForever ? NULL : &stDeadline))
+        {
+            break;
+        }
+    }
+    if (hQueue->uCount < hQueue->uLength)
+    {
+        if (hQueue->uItemSize > 0)
+        {
+            UBaseType_t uTail = (hQueue->uHead + hQueue->uCount) % hQueue->uLength;
+
+            memcpy(&hQueue->pu8Items[uTail * hQueue->uItemSize], pItem, hQueue->uItemSize);
+        }
+        hQueue->uCount++;
+        pthread_cond_broadcast(&hQueue->stCond);
+        xResult = pdTRUE;
+    }
+    pthread_mutex_unlock(&_stRTOS.stLock);
+
+    if (bWaited)
+    {
+        _HostResumed();
+    }
+    return xResult;
+}
+
+BaseType_t xQueueSendFromISR(QueueHandle_t hQueue, const void* pItem, BaseType_t* pxWoken)
+{
+    if (NULL != pxWoken)
+    {
+        *pxWoken = pdTRUE;
+    }
+    return xQueueSend(hQueue, pItem, 0);
+}
+
+BaseType_t xQueueReceive(QueueHandle_t hQueue, void* pItem, TickType_t xTicks)
+{
+    struct timespec stDeadline;
+    bool            bForever = _HostDeadline(xTicks, &stDeadline);
+    bool            bWaited  = false;
+    BaseType_t      xResult  = pdFALSE;
+
+    pthread_mutex_lock(&_stRTOS.stLock);
+    while (0 == hQueue->uCount && 0 != xTicks)
+    {
+        bWaited = true;
+        if (! _HostWait(&hQueue->stCond, xTicks, bForever ? NULL : &stDeadline))
+        {
+            break;
+        }
+    }
+    if (hQueue->uCount > 0)
+    {
+        if (hQueue->uItemSize > 0)
+        {
+            memcpy(pItem, &hQueue->pu8Items[hQueue->uHead * hQueue->uItemSize], hQueue->uItemSize);
+        }
+        hQueue->uHead = (hQueue->uHead + 1) % hQueue->uLength;
+        hQueue->uCount--;
+        pthread_cond_broadcast(&hQueue->stCond);
+        xResult = pdTRUE;
+    }
+    pthread_mutex_unlock(&_stRTOS.stLock);
+
+    if (bWaited)
+    {
+        _HostResumed();
+    }
+    return xResult;
+}
+
+BaseType_t xQueueReset(QueueHandle_t hQueue)
+{
+    pthread_mutex_lock(&_stRTOS.stLock);
+    hQueue->uCount = 0;
+    hQueue->uHead  = 0;
+    pthread_cond_broadcast(&hQueue->stCond);
+    pthread_mutex_unlock(&_stRTOS.stLock);
+
+    return pdPASS;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t hQueue)
+{
+    UBaseType_t uCount;
+
+    pthread_mutex_lock(&_stRTOS.stLock);
+    uCount = hQueue->uCount;
+    pthread_mutex_unlock(&_stRTOS.stLock);
+
+    return uCount;
+}
+
+void vQueueDelete(QueueHandle_t hQueue)
+{
+    pthread_cond_destroy(&hQueue->stCond);
+    free(hQueue->pu8Items);
+    free(hQueue);
+}
+
+RingbufHandle_t xRingbufferCreate(size_t uSize, ringbuf_type_t eType)
+{
+    RingbufHandle_t hRingbuf = calloc(1, sizeof(struct HostRingbuf_t));
+
+    if (NULL == hRingbuf)
+    {
+        return NULL;
+    }
+    hRingbuf->eType = eType;
+    hRingbuf->uSize = uSize;
+    if (RINGBUF_TYPE_BYTEBUF == eType)
+    {
+        hRingbuf->pu8Data = malloc(uSize);
+        if (NULL == hRingbuf->pu8Data)
+        {
+            free(hRingbuf);
+            return NULL;
+        }
+    }
+    _HostCondInit(&hRingbuf->stCond);
+
+    return hRingbuf;
+}
+
+void vRingbufferDelete(RingbufHandle_t hRingbuf)
+{
+    while (NULL != hRingbuf->pstFirst)
+    {
+        HostRingItem* pstItem = hRingbuf->pstFirst;
+
+        hRingbuf->pstFirst = pstItem->pstNext;
+        free(pstItem);
+    }
+    pthread_cond_destroy(&hRingbuf->stCond);
+    free(hRingbuf->pu8Data);
+    free(hRingbuf);
+}
+
+BaseType_t xRingbufferSend(RingbufHandle_t hRingbuf, const void* pData, size_t uSize, TickType_t xTicks)
+{
+    struct timespec stDeadline;
+    bool            bForever = _HostDeadline(xTicks, &stDeadline);
+    bool            bWaited  = false;
+    BaseType_t      xResult  = pdFALSE;
+    size_t          uNeeded  = uSize;
+
+    // Items carry a header, as on the ESP32.
+    if (RINGBUF_TYPE_BYTEBUF != hRingbuf->eType)
+    {
+        uNeeded = sizeof(HostRingItem) + ((uSize + 3) & ~(size_t)3);
+    }
+    if (uNeeded > hRingbuf->uSize)
+    {
+        return pdFALSE;
+    }
+
+    pthread_mutex_lock(&_stRTOS.stLock);
+    while (hRingbuf->uSize - hRingbuf->uUsed < uNeeded && 0 != xTicks)
+    {
+        bWaited = true;
+        if (! _HostWait(&hRingbuf->stCond, xTicks, bForever ? NULL : &stDeadline))
+        {
+            break;
+        }
+    }
+    if (hRingbuf->uSize - hRingbuf->uUsed >= uNeeded)
+    {
+        if (RINGBUF_TYPE_BYTEBUF == hRingbuf->eType)
+        {
+            size_t uWrite = (hRingbuf->uRead + hRingbuf->uUsed) % hRingbuf->uSize;
+            size_t uFirst = hRingbuf->uSize - uWrite;
+
+            if (uFirst > uSize)
+            {
+                uFirst = uSize;
+            }
+            memcpy(&hRingbuf->pu8Data[uWrite], pData, uFirst);
+            memcpy(hRingbuf->pu8Data, (const uint8_t*)pData + uFirst, uSize - uFirst);
+            hRingbuf->uUsed += uSize;
+            xResult = pdTRUE;
+        }
+        else
+        {
+            HostRingItem* pstItem = malloc(sizeof(HostRingItem) + uSize);
+
+            if (NULL != pstItem)
+            {
+                pstItem->pstNext = NULL;
+                pstItem->uSize   = uSize;
+                memcpy(pstItem->au8Data, pData, uSize);
+                if (NULL == hRingbuf->pstLast)
+                {
+                    hRingbuf->pstFirst = pstItem;
+                }
+                else
+                {
+                    hRingbuf->pstLast->pstNext = pstItem;
+                }
+                hRingbuf->pstLast  = pstItem;
+                hRingbuf->uUsed   += uNeeded;
+                xResult = pdTRUE;
+            }
+        }
+        pthread_cond_broadcast(&hRingbuf->stCond);
+    }
+    pthread_mutex_unlock(&_stRTOS.stLock);
+
+    if (bWaited)
+    {
+        _HostResumed();
+    }
+    return xResult;
+}
+
+BaseType_t xRingbufferSendFromISR(RingbufHandle_t hRingbuf, const void* pData, size_t uSize, BaseType_t* pxWoken)
+{
+    if (NULL != pxWoken)
+    {
+        *pxWoken = pdTRUE;
+    }
+    return xRingbufferSend(hRingbuf, pData, uSize, 0);
+}
+
+void* xRingbufferReceiveUpTo(RingbufHandle_t hRingbuf, size_t* puSize, TickType_t xTicks, size_t uMax)
+{
+    struct timespec stDeadline;
+    bool            bForever = _HostDeadline(xTicks, &stDeadline);
+    bool            bWaited  = false;
+    void*           pItem    = NULL;
+
+    pthread_mutex_lock(&_stRTOS.stLock);
+    if (RINGBUF_TYPE_BYTEBUF == hRingbuf->eType)
+    {
+        // One piece at a time, it has to be returned before the next.
+        while ((0 == hRingbuf->uUsed || 0 != hRingbuf->uLent) && 0 != xTicks)
+        {
+            bWaited = true;
+            if (! _HostWait(&hRingbuf->stCond, xTicks, bForever ? NULL : &stDeadline))
+            {
+                break;
+            }
+        }
+        if (hRingbuf->uUsed > 0 && 0 == hRingbuf->uLent)
+        {
+            size_t uSize = hRingbuf->uSize - hRingbuf->uRead;
+
+            if (uSize > hRingbuf->uUsed)
+            {
+                uSize = hRingbuf->uUsed;
+            }
+            if (uSize > uMax)
+            {
+                uSize = uMax;
+            }
+            hRingbuf->uLent = uSize;
+            *puSize         = uSize;
+            pItem           = &hRingbuf->pu8Data[hRingbuf->uRead];
+        }
+    }
+    else
+    {
+        while (NULL == hRingbuf->pstFirst && 0 != xTicks)
+        {
+            bWaited = true;
+            if (! _HostWait(&hRingbuf->stCond, xTicks, bForever ? NULL : &stDeadline))
+            {
+                break;
+            }
+        }
+        if (NULL != hRingbuf->pstFirst)
+        {
+            HostRingItem* pstItem = hRingbuf->pstFirst;
+
+            hRingbuf->pstFirst = pstItem->pstNext;
+            if (NULL == hRingbuf->pstFirst)
+            {
+                hRingbuf->pstLast = NULL;
+            }
+            *puSize = pstItem->uSize;
+            pItem   = pstItem->au8Data;
+        }
+    }
+    pthread_mutex_unlock(&_stRTOS.stLock);
+
+    if (bWaited)
+    {
+        _HostResumed();
+    }
+    return pItem;
+}
+
+void* xRingbufferReceive(RingbufHandle_t hRingbuf, size_t* puSize, TickType_t xTicks)
+{
+    return xRingbufferReceiveUpTo(hRingbuf, puSize, xTicks, hRingbuf->uSize);
+}
+
+void vRingbufferReturnItem(RingbufHandle_t hRingbuf, void* pItem)
+{
+    pthread_mutex_lock(&_stRTOS.stLock);
+    if (RINGBUF_TYPE_BYTEBUF == hRingbuf->eType)
+    {
+        hRingbuf->uRead  = (hRingbuf->uRead + hRingbuf->uLent) % hRingbuf->uSize;
+        hRingbuf->uUsed -= hRingbuf->uLent;
+        hRingbuf->uLent  = 0;
+    }
+    else
+    {
+        HostRingItem* pstItem = (HostRingItem*)((uint8_t*)pItem - offsetof(HostRingItem, au8Data));
+
+        hRingbuf->uUsed -= sizeof(HostRingItem) + ((pstItem->uSize + 3) & ~(size_t)3);
+        free(pstItem);
+    }
+    pthread_cond_broadcast(&hRingbuf->stCond);
+    pthread_mutex_unlock(&_stRTOS.stLock);
+}
+
+size_t xRingbufferGetCurFreeSize(RingbufHandle_t hRingbuf)
+{
+    size_t uFree;
+
+    pthread_mutex_lock(&_stRTOS.stLock);
+    uFree = hRingbuf->uSize - hRingbuf->uUsed;
+    pthread_mutex_unlock(&_stRTOS.stLock);
+
+    return uFree;
+}
+
+EventGroupHandle_t xEventGroupCreate(void)
+{
+    EventGroupHandle_t hGroup = calloc(1, sizeof(struct HostEventGroup_t));
+
+    if (NULL != hGroup)
+    {
+        _HostCondInit(&hGroup->stCond);
+    }
+    return hGroup;
+}
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t hGroup, EventBits_t uBits)
+{
+    EventBits_t uResult;
+
+    pthread_mutex_lock(&_stRTOS.stLock);
+    hGroup->uBits |= uBits;
+    uResult        = hGroup->uBits;
+    pthread_cond_broadcast(&hGroup->stCond);
+    pthread_mutex_unlock(&_stRTOS.stLock);
+
+    return uResult;
+}
+
+EventBits_t xEventGroupClearBits(EventGroupHandle_t hGroup, EventBits_t uBits)
+{
+    EventBits_t uResult;
+
+    pthread_mutex_lock(&_stRTOS.stLock);
+    uResult        = hGroup->uBits;
+    hGroup->uBits &= ~uBits;
+    pthread_mutex_unlock(&_stRTOS.stLock);
+
+    return uResult;
+}
+
+EventBits_t xEventGroupGetBits(EventGroupHandle_t hGroup)
+{
+    EventBits_t uResult;
+
+    pthread_mutex_lock(&_stRTOS.stLock);
+    uResult = hGroup->uBits;
+    pthread_mutex_unlock(&_stRTOS.stLock);
+
+    return uResult;
+}
+
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t hGroup, EventBits_t uBits, BaseType_t xClear, BaseType_t xAll, TickType_t xTicks)
+{
+    struct timespec stDeadline;
+    bool            bForever = _HostDeadline(xTicks, &stDeadline);
+    bool            bWaited  = false;
+    bool            bMet;
+    EventBits_t     uResult;
+
+    pthread_mutex_lock(&_stRTOS.stLock);
+    while (1)
+    {
+        bMet = xAll ? (uBits == (hGroup->uBits & uBits)) : (0 != (hGroup->uBits & uBits));
+        if (bMet || 0 == xTicks)
+        {
+            break;
+        }
+        bWaited = true;
+        if (! _HostWait(&hGroup->stCond, xTicks, bForever ? NULL : &stDeadline))
+        {
+            bMet = xAll ? (uBits == (hGroup->uBits & uBits)) : (0 != (hGroup->uBits & uBits));
+            break;
+        }
+    }
+    uResult = hGroup->uBits;
+    if (bMet && xClear)
+    {
+        hGroup->uBits &= ~uBits;
+    }
+    pthread_mutex_unlock(&_stRTOS.stLock);
+
+    if (bWaited)
+    {
+        _HostResumed();
+    }
+    return uResult;
+}
+
+/**
+ * @fn      void* _HostTaskEntry(void* pArg)
+ * @brief   Thread of a task
+ * @param   pArg
+ *          Task
+ * @return  Nothing
+ */
+static void* _HostTaskEntry(void* pArg)
+{
+    HostTask* pstTask = (HostTask*)pArg;
+
+    _pstSelf = pstTask;
+    _nCore   = tskNO_AFFINITY == pstTask->xCore ? PRO_CPU_NUM : pstTask->xCore;
+
+    pthread_mutex_lock(&_stRTOS.stLock);
+    pstTask->bCPUClock = 0 == pthread_getcpuclockid(pthread_self(), &pstTask->stCPUClock);
+    pthread_mutex_unlock(&_stRTOS.stLock);
+    pthread_setname_np(pthread_self(), pstTask->acName);
+
+    // Both cores are only kept apart if the host has two CPUs for them.
+    if (tskNO_AFFINITY != pstTask->xCore && _stRTOS.lCPUs >= portNUM_PROCESSORS)
+    {
+        cpu_set_t stSet;
+
+        CPU_ZERO(&stSet);
+        CPU_SET(pstTask->xCore, &stSet);
+        pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &stSet);
+    }
+
+    pstTask->pfnTask(pstTask->pArg);
+
+    // A FreeRTOS task must not return, treat it like vTaskDelete(NULL).
+    vTaskDelete(NULL);
+    return NULL;
+}
+
+/**
+ * @fn     void _HostRegister(HostTask* pstTask, const char* pacName, UBaseType_t uPriority, BaseType_t xCore)
+ * @brief  Fill in a task slot, the kernel lock has to be held
+ * @param  pstTask
+ *         Free task slot
+ * @param  pacName
+ *         Task name
+ * @param  uPriority
+ *         FreeRTOS priority
+ * @param  xCore
+ *         Core, or tskNO_AFFINITY
+ */
+static void _HostRegister(HostTask* pstTask, const char* pacName, UBaseType_t uPriority, BaseType_t xCore)
+{
+    pstTask->bUsed     = true;
+    pstTask->bCPUClock = false;
+    pstTask->uPriority = uPriority;
+    pstTask->xCore     = xCore;
+    pstTask->uNumber   = ++_stRTOS.uNextNumber;
+    pstTask->u32Notify = 0;
+    snprintf(pstTask->acName, sizeof(pstTask->acName), "%s", pacName);
+    _HostCondInit(&pstTask->stNotify);
+}
+
+/**
+ * @fn     void _HostCondInit(pthread_cond_t* pstCond)
+ * @brief  Initialise a condition variable on CLOCK_MONOTONIC
+ */
+static void _HostCondInit(pthread_cond_t* pstCond)
+{
+    pthread_cond_init(pstCond, &_stRTOS.stCondAttr);
+}
+
+/**
+ * @fn       bool _HostDeadline(TickType_t xTicks, struct timespec* pstDeadline)
+ * @brief    Get the end of a timeout
+ * @details  Like on the ESP32, the timeout ends with the tick
+ *           interrupt xTicks ticks from now.
+ * @param    xTicks
+ *           Timeout in ticks
+ * @param    pstDeadline
+ *           Destination of the end of the timeout
+ * @return   Timeout type
+ * @retval   true  = Wait forever
+ * @retval   false = pstDeadline is valid
+ */
+static bool _HostDeadline(TickType_t xTicks, struct timespec* pstDeadline)
+{
+    int64_t s64TickUs = (int64_t)portTICK_PERIOD_MS * 1000;
+    int64_t s64Tick;
+
+    if (portMAX_DELAY == xTicks)
+    {
+        return true;
+    }
+    s64Tick = esp_timer_get_time() / s64TickUs;
+    HostTimeToSpec((s64Tick + (int64_t)xTicks) * s64TickUs, pstDeadline);
+    return false;
+}
+
+/**
+ * @fn      bool _HostWait(pthread_cond_t* pstCond, TickType_t xTicks, const struct timespec* pstDeadline)
+ * @brief   Block on a condition, the kernel lock has to be held
+ * @param   pstCond
+ *          Condition variable of the object
+ * @param   xTicks
+ *          Timeout in ticks, 0 returns at once
+ * @param   pstDeadline
+ *          End of the timeout, NULL = wait forever
+ * @return  Status
+ * @retval  true  = Woken up, check the condition again
+ * @retval  false = Timed out
+ */
+static bool _HostWait(pthread_cond_t* pstCond, TickType_t xTicks, const struct timespec* pstDeadline)
+{
+    if (0 == xTicks)
+    {
+        return false;
+    }
+    if (NULL == pstDeadline)
+    {
+        pthread_cond_wait(pstCond, &_stRTOS.stLock);
+        return true;
+    }
+    return ETIMEDOUT != pthread_cond_timedwait(pstCond, &_stRTOS.stLock, pstDeadline);
+}
+
+/**
+ * @fn     void _HostResumed(void)
+ * @brief  Report the calling task as switched in
+ */
+static void _HostResumed(void)
+{
+    if (NULL != _pstSelf)
+    {
+        TraceTaskSwitchedIn(_pstSelf);
+    }
+}
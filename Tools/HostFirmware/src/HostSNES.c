@@ -0,0 +1,731 @@
+/**
+ * @file       HostSNES.c
+ * @brief      Controller and console of the virtual adapter
+ * @ingroup    HostFirmware
+ * @details
+ * @code{.unparsed}
+ *
+ * The peripherals SNES.c drives, wired to a virtual controller on the
+ * input port and a virtual console on both controller ports:
+ *
+ *   RMT         A latch on SNES_INPUT_LATCH_PIN loads the controller
+ *               word, a clock on SNES_INPUT_CLOCK_PIN is played out
+ *               in real time by the RMT thread.  Each falling edge
+ *               puts the next bit on SNES_INPUT_DATA_PIN, see GPIO.in,
+ *               and runs the clock interrupt handler.
+ *   Controller  Walks through the buttons one at a time, each held for
+ *               HOST_PAD_STEP_MS, or holds a fixed word.
+ *   Console     Latches both ports every frame period: the port 0 and
+ *               port 1 latch handlers run, the SPI slave transactions
+ *               end and the next ones are shifted out.
+ *   SPI slave   HSPI_HOST is port 0, VSPI_HOST port 1.
+ *
+ * Interrupt handlers run in the thread of the peripheral, marked with
+ * the core they were installed on.  Nothing drives the IOPort pins, so
+ * the bulk acknowledge and the upstream receiver stay idle.
+ *
+ * @endcode
+ * @author     SNESoIP contributors
+ * @copyright  "THE BEER-WARE LICENCE" (Revision 42)
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/ringbuf.h"
+#include "freertos/task.h"
+#include "driver/gpio.h"
+#include "driver/rmt.h"
+#include "driver/spi_slave.h"
+#include "esp_timer.h"
+#include "soc/gpio_struct.h"
+#include "soc/io_mux_reg.h"
+#include "Host.h"
+#include "SNES.h"
+
+#define HOST_GPIOS        40   // !< Number of GPIO pins
+#define HOST_RMT_CHANNELS 8    // !< Number of RMT channels
+#define HOST_RMT_ITEMS    64   // !< Max. items per RMT write
+#define HOST_SPI_HOSTS    3    // !< SPI_HOST, HSPI_HOST, VSPI_HOST
+#define HOST_SPI_QUEUE    8    // !< Max. transactions armed per SPI host
+#define HOST_PAD_BUTTONS  12   // !< Buttons the demo pattern walks through
+
+volatile gpio_dev_t GPIO;
+const uint32_t      GPIO_PIN_MUX_REG[HOST_GPIOS];
+
+/**
+ * @typedef  HostGPIO
+ * @brief    Interrupt of a GPIO pin
+ */
+typedef struct HostGPIO_t
+{
+    gpio_int_type_t eType;
+    gpio_isr_t      pfnHandler;
+    void*           pArg;
+    int             nCore;       ///< Core the handler was installed on
+
+} HostGPIO;
+
+/**
+ * @typedef  HostSPI
+ * @brief    SPI slave
+ */
+typedef struct HostSPI_t
+{
+    bool                         bUsed;
+    spi_slave_interface_config_t stIf;
+    int                          nCore;
+    spi_slave_transaction_t*     apstArmed[HOST_SPI_QUEUE];
+    uint8_t                      u8Head;
+    uint8_t                      u8Count;
+    spi_slave_transaction_t*     pstActive;   ///< Transaction shifted out at the next latch
+    QueueHandle_t                hResults;
+
+} HostSPI;
+
+/**
+ * @typedef  HostSNES
+ * @brief    Virtual hardware data
+ */
+typedef struct HostSNES_t
+{
+    pthread_mutex_t  stLock;        ///< Guards GPIO, SPI and RMT state
+    pthread_cond_t   stRMTCond;     ///< A clock write is pending
+    HostGPIO         astGPIO[HOST_GPIOS];
+    HostSPI          astSPI[HOST_SPI_HOSTS];
+    int              anRMTPin[HOST_RMT_CHANNELS];
+    RingbufHandle_t  ahRMTRx[HOST_RMT_CHANNELS];
+
+    rmt_item32_t     astClock[HOST_RMT_ITEMS];  ///< Pending clock write
+    int              nClockItems;
+    uint8_t          u8ClockDiv;
+    uint16_t         u16Latched;    ///< Controller word loaded at the last latch
+
+    bool             bDemo;
+    uint16_t         u16Pad;        ///< Fixed controller word
+    uint32_t         u32FramePeriod;
+    HostConsoleStats stStats;
+
+} HostSNES;
+
+/**
+ * @var    _stSNES
+ * @brief  Virtual hardware private data
+ */
+static HostSNES _stSNES =
+{
+    .stLock = PTHREAD_MUTEX_INITIALIZER,
+    .bDemo  = true,
+    .u16Pad = 0xffff,
+};
+
+static void*    _HostRMTThread(void* pArg);
+static void*    _HostConsoleThread(void* pArg);
+static void     _HostClockOut(const rmt_item32_t* pstItems, int nItems, uint8_t u8Div);
+static void     _HostSetData(bool bHigh);
+static void     _HostRaise(gpio_num_t eGPIO, bool bRising);
+static void     _HostConsoleLatch(void);
+static uint16_t _HostPadWord(void);
+static void     _HostBusyWait(int64_t s64Until);
+
+/**
+ * @fn     void HostInitSNES(void)
+ * @brief  Start the RMT thread
+ */
+void HostInitSNES(void)
+{
+    pthread_condattr_t stAttr;
+
+    pthread_condattr_init(&stAttr);
+    pthread_condattr_setclock(&stAttr, CLOCK_MONOTONIC);
+    pthread_cond_init(&_stSNES.stRMTCond, &stAttr);
+    pthread_condattr_destroy(&stAttr);
+
+    for (uint8_t u8Channel = 0; u8Channel < HOST_RMT_CHANNELS; u8Channel++)
+    {
+        _stSNES.anRMTPin[u8Channel] = -1;
+    }
+    GPIO.in  = 0xffffffff;
+    GPIO.in1 = 0xffffffff;
+
+    HostStartISRThread(_HostRMTThread, "HostRMT");
+}
+
+/**
+ * @fn     void HostStartConsole(uint32_t u32FramePeriodUs)
+ * @brief  Switch the virtual console on
+ * @param  u32FramePeriodUs
+ *         Latch period in µs, 0 = leave the console off
+ */
+void HostStartConsole(uint32_t u32FramePeriodUs)
+{
+    if (0 == u32FramePeriodUs)
+    {
+        return;
+    }
+    _stSNES.u32FramePeriod = u32FramePeriodUs;
+    HostStartISRThread(_HostConsoleThread, "HostConsole");
+}
+
+/**
+ * @fn     void HostSetPad(bool bDemo, uint16_t u16Word)
+ * @brief  Set what the virtual controller sends
+ * @param  bDemo
+ *         true = walk through the buttons, false = send u16Word
+ * @param  u16Word
+ *         Controller word, active low
+ */
+void HostSetPad(bool bDemo, uint16_t u16Word)
+{
+    pthread_mutex_lock(&_stSNES.stLock);
+    _stSNES.bDemo  = bDemo;
+    _stSNES.u16Pad = u16Word;
+    pthread_mutex_unlock(&_stSNES.stLock);
+}
+
+/**
+ * @fn     void HostGetConsoleStats(HostConsoleStats* pstStats)
+ * @brief  Get what the virtual console saw
+ * @param  pstStats
+ *         Destination of the statistics
+ */
+void HostGetConsoleStats(HostConsoleStats* pstStats)
+{
+    pthread_mutex_lock(&_stSNES.stLock);
+    *pstStats = _stSNES.stStats;
+    pthread_mutex_unlock(&_stSNES.stLock);
+}
+
+esp_err_t gpio_config(const gpio_config_t* pstConfig)
+{
+    pthread_mutex_lock(&_stSNES.stLock);
+    for (uint8_t u8Pin = 0; u8Pin < HOST_GPIOS; u8Pin++)
+    {
+        if (pstConfig->pin_bit_mask & ((uint64_t)1 << u8Pin))
+        {
+            _stSNES.astGPIO[u8Pin].eType = pstConfig->intr_type;
+        }
+    }
+    pthread_mutex_unlock(&_stSNES.stLock);
+
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_intr_type(gpio_num_t eGPIO, gpio_int_type_t eType)
+{
+    if (eGPIO < 0 || eGPIO >= HOST_GPIOS)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&_stSNES.stLock);
+    _stSNES.astGPIO[eGPIO].eType = eType;
+    pthread_mutex_unlock(&_stSNES.stLock);
+
+    return ESP_OK;
+}
+
+esp_err_t gpio_install_isr_service(int nFlags)
+{
+    (void)nFlags;
+    return ESP_OK;
+}
+
+esp_err_t gpio_isr_handler_add(gpio_num_t eGPIO, gpio_isr_t pfnHandler, void* pArg)
+{
+    if (eGPIO < 0 || eGPIO >= HOST_GPIOS)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&_stSNES.stLock);
+    _stSNES.astGPIO[eGPIO].pfnHandler = pfnHandler;
+    _stSNES.astGPIO[eGPIO].pArg       = pArg;
+    _stSNES.astGPIO[eGPIO].nCore      = (int)xPortGetCoreID();
+    pthread_mutex_unlock(&_stSNES.stLock);
+
+    return ESP_OK;
+}
+
+esp_err_t gpio_isr_handler_remove(gpio_num_t eGPIO)
+{
+    return gpio_isr_handler_add(eGPIO, NULL, NULL);
+}
+
+esp_err_t gpio_set_level(gpio_num_t eGPIO, uint32_t u32Level)
+{
+    (void)eGPIO;
+    (void)u32Level;
+    return ESP_OK;
+}
+
+int gpio_get_level(gpio_num_t eGPIO)
+{
+    if (eGPIO < 32)
+    {
+        return (GPIO.in >> eGPIO) & 1;
+    }
+    return (GPIO.in1 >> (eGPIO - 32)) & 1;
+}
+
+esp_err_t rmt_config(const rmt_config_t* pstConfig)
+{
+    if (pstConfig->channel >= HOST_RMT_CHANNELS)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&_stSNES.stLock);
+    _stSNES.anRMTPin[pstConfig->channel] = pstConfig->gpio_num;
+    if (SNES_INPUT_CLOCK_PIN == pstConfig->gpio_num)
+    {
+        _stSNES.u8ClockDiv = pstConfig->clk_div;
+    }
+    pthread_mutex_unlock(&_stSNES.stLock);
+
+    return ESP_OK;
+}
+
+esp_err_t rmt_driver_install(rmt_channel_t eChannel, size_t uRxBufSize, int nFlags)
+{
+    (void)nFlags;
+
+    if (eChannel >= HOST_RMT_CHANNELS)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (uRxBufSize > 0)
+    {
+        _stSNES.ahRMTRx[eChannel] = xRingbufferCreate(uRxBufSize, RINGBUF_TYPE_NOSPLIT);
+        if (NULL == _stSNES.ahRMTRx[eChannel])
+        {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t rmt_get_ringbuf_handle(rmt_channel_t eChannel, RingbufHandle_t* phRingbuf)
+{
+    if (eChannel >= HOST_RMT_CHANNELS || NULL == _stSNES.ahRMTRx[eChannel])
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    *phRingbuf = _stSNES.ahRMTRx[eChannel];
+    return ESP_OK;
+}
+
+esp_err_t rmt_rx_start(rmt_channel_t eChannel, bool bReset)
+{
+    (void)bReset;
+    return eChannel < HOST_RMT_CHANNELS ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t rmt_write_items(rmt_channel_t eChannel, const rmt_item32_t* pstItems, int nItems, bool bWait)
+{
+    int nPin;
+
+    if (eChannel >= HOST_RMT_CHANNELS || nItems > HOST_RMT_ITEMS)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    pthread_mutex_lock(&_stSNES.stLock);
+    nPin = _stSNES.anRMTPin[eChannel];
+    if (SNES_INPUT_LATCH_PIN == nPin)
+    {
+        // The controller loads its shift register.
+        _stSNES.u16Latched = _HostPadWord();
+    }
+    else if (SNES_INPUT_CLOCK_PIN == nPin && 0 == _stSNES.nClockItems)
+    {
+        memcpy(_stSNES.astClock, pstItems, (size_t)nItems * sizeof(rmt_item32_t));
+        _stSNES.nClockItems = nItems;
+        pthread_cond_signal(&_stSNES.stRMTCond);
+    }
+    while (bWait && SNES_INPUT_CLOCK_PIN == nPin && 0 != _stSNES.nClockItems)
+    {
+        pthread_mutex_unlock(&_stSNES.stLock);
+        sched_yield();
+        pthread_mutex_lock(&_stSNES.stLock);
+    }
+    pthread_mutex_unlock(&_stSNES.stLock);
+
+    return ESP_OK;
+}
+
+esp_err_t spi_slave_initialize(spi_host_device_t eHost, const spi_bus_config_t* pstBus, const spi_slave_interface_config_t* pstIf, int nDMA)
+{
+    HostSPI* pstSPI;
+    (void)pstBus;
+    (void)nDMA;
+
+    if (eHost >= HOST_SPI_HOSTS || pstIf->queue_size > HOST_SPI_QUEUE)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pstSPI = &_stSNES.astSPI[eHost];
+    if (pstSPI->bUsed)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    pstSPI->hResults = xQueueCreate(pstIf->queue_size, sizeof(spi_slave_transaction_t*));
+    if (NULL == pstSPI->hResults)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+
+    pthread_mutex_lock(&_stSNES.stLock);
+    pstSPI->stIf  = *pstIf;
+    pstSPI->nCore = (int)xPortGetCoreID();
+    pstSPI->bUsed = true;
+    pthread_mutex_unlock(&_stSNES.stLock);
+
+    return ESP_OK;
+}
+
+esp_err_t spi_slave_queue_trans(spi_host_device_t eHost, const spi_slave_transaction_t* pstTrans, TickType_t xTicks)
+{
+    HostSPI*  pstSPI;
+    esp_err_t eErr = ESP_OK;
+    (void)xTicks;
+
+    if (eHost >= HOST_SPI_HOSTS || ! _stSNES.astSPI[eHost].bUsed)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pstSPI = &_stSNES.astSPI[eHost];
+
+    pthread_mutex_lock(&_stSNES.stLock);
+    if (pstSPI->u8Count >= pstSPI->stIf.queue_size)
+    {
+        eErr = ESP_ERR_TIMEOUT;
+    }
+    else
+    {
+        pstSPI->apstArmed[(pstSPI->u8Head + pstSPI->u8Count) % HOST_SPI_QUEUE] = (spi_slave_transaction_t*)pstTrans;
+        pstSPI->u8Count++;
+    }
+    pthread_mutex_unlock(&_stSNES.stLock);
+
+    return eErr;
+}
+
+esp_err_t spi_slave_get_trans_result(spi_host_device_t eHost, spi_slave_transaction_t** ppstTrans, TickType_t xTicks)
+{
+    if (eHost >= HOST_SPI_HOSTS || ! _stSNES.astSPI[eHost].bUsed)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (pdTRUE != xQueueReceive(_stSNES.astSPI[eHost].hResults, ppstTrans, xTicks))
+    {
+        return ESP_ERR_TIMEOUT;
+    }
+    return ESP_OK;
+}
+
+/**
+ * @fn      void* _HostRMTThread(void* pArg)
+ * @brief   Play out clock writes
+ * @param   pArg
+ *          Unused
+ * @return  Nothing
+ */
+static void* _HostRMTThread(void* pArg)
+{
+    rmt_item32_t astItems[HOST_RMT_ITEMS];
+    int          nItems;
+    uint8_t      u8Div;
+    (void)pArg;
+
+    while (1)
+    {
+        pthread_mutex_lock(&_stSNES.stLock);
+        while (0 == _stSNES.nClockItems)
+        {
+            pthread_cond_wait(&_stSNES.stRMTCond, &_stSNES.stLock);
+        }
+        nItems = _stSNES.nClockItems;
+        u8Div  = _stSNES.u8ClockDiv;
+        memcpy(astItems, _stSNES.astClock, (size_t)nItems * sizeof(rmt_item32_t));
+        pthread_mutex_unlock(&_stSNES.stLock);
+
+        _HostClockOut(astItems, nItems, u8Div);
+
+        pthread_mutex_lock(&_stSNES.stLock);
+        _stSNES.nClockItems = 0;
+        _stSNES.stStats.u32Captures++;
+        pthread_mutex_unlock(&_stSNES.stLock);
+    }
+    return NULL;
+}
+
+/**
+ * @fn       void _HostClockOut(const rmt_item32_t* pstItems, int nItems, uint8_t u8Div)
+ * @brief    Play out a clock signal
+ * @details  The items are timed by busy-waiting, a sleep would not
+ *           return within the 6 µs of a clock phase.
+ * @param    pstItems
+ *           RMT items
+ * @param    nItems
+ *           Number of items
+ * @param    u8Div
+ *           Clock divider of the channel, 80 = 1 µs ticks
+ */
+static void _HostClockOut(const rmt_item32_t* pstItems, int nItems, uint8_t u8Div)
+{
+    int64_t s64Time  = esp_timer_get_time();
+    bool    bLevel   = true;
+    uint8_t u8Shift  = 0;
+    double  dTickUs  = (0 == u8Div ? 80 : u8Div) / 80.0;
+
+    for (int nIndex = 0; nIndex < nItems; nIndex++)
+    {
+        const rmt_item32_t* pstItem = &pstItems[nIndex];
+        uint8_t             au8Level[2]    = { pstItem->level0, pstItem->level1 };
+        uint16_t            au16Duration[2] = { pstItem->duration0, pstItem->duration1 };
+
+        for (uint8_t u8Phase = 0; u8Phase < 2; u8Phase++)
+        {
+            if (0 == au16Duration[u8Phase])
+            {
+                break;
+            }
+            if (bLevel && ! au8Level[u8Phase])
+            {
+                // Falling edge: the controller shifts, then it is sampled.
+                _HostSetData((_stSNES.u16Latched >> u8Shift) & 1);
+                u8Shift = u8Shift < 15 ? u8Shift + 1 : 15;
+                _HostRaise(SNES_INPUT_CLOCK_PIN, false);
+            }
+            else if (! bLevel && au8Level[u8Phase])
+            {
+                _HostRaise(SNES_INPUT_CLOCK_PIN, true);
+            }
+            bLevel   = au8Level[u8Phase];
+            s64Time += (int64_t)(au16Duration[u8Phase] * dTickUs + 0.5);
+            _HostBusyWait(s64Time);
+        }
+    }
+}
+
+/**
+ * @fn     void _HostSetData(bool bHigh)
+ * @brief  Drive the data line of the virtual controller
+ */
+static void _HostSetData(bool bHigh)
+{
+    if (bHigh)
+    {
+        GPIO.in |= (uint32_t)1 << SNES_INPUT_DATA_PIN;
+    }
+    else
+    {
+        GPIO.in &= ~((uint32_t)1 << SNES_INPUT_DATA_PIN);
+    }
+}
+
+/**
+ * @fn     void _HostRaise(gpio_num_t eGPIO, bool bRising)
+ * @brief  Run the interrupt handler of an edge on a pin
+ * @param  eGPIO
+ *         Pin
+ * @param  bRising
+ *         true = rising edge, false = falling edge
+ */
+static void _HostRaise(gpio_num_t eGPIO, bool bRising)
+{
+    HostGPIO stGPIO;
+
+    pthread_mutex_lock(&_stSNES.stLock);
+    stGPIO = _stSNES.astGPIO[eGPIO];
+    pthread_mutex_unlock(&_stSNES.stLock);
+
+    if (NULL == stGPIO.pfnHandler)
+    {
+        return;
+    }
+    if (GPIO_INTR_ANYEDGE == stGPIO.eType ||
+        (bRising && GPIO_INTR_POSEDGE == stGPIO.eType) ||
+        (! bRising && GPIO_INTR_NEGEDGE == stGPIO.eType))
+    {
+        HostEnterISR(stGPIO.nCore);
+        stGPIO.pfnHandler(stGPIO.pArg);
+    }
+}
+
+/**
+ * @fn      void* _HostConsoleThread(void* pArg)
+ * @brief   Latch both controller ports every frame
+ * @param   pArg
+ *          Unused
+ * @return  Nothing
+ */
+static void* _HostConsoleThread(void* pArg)
+{
+    int64_t         s64Next = esp_timer_get_time() + _stSNES.u32FramePeriod;
+    int64_t         s64Last = 0;
+    struct timespec stNext;
+    (void)pArg;
+
+    while (1)
+    {
+        int64_t s64Now;
+
+        HostTimeToSpec(s64Next, &stNext);
+        while (EINTR == clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &stNext, NULL))
+        {
+            continue;
+        }
+
+        s64Now = esp_timer_get_time();
+        if (0 != s64Last)
+        {
+            int64_t  s64Deviation = s64Now - s64Last - (int64_t)_stSNES.u32FramePeriod;
+            uint32_t u32Deviation = (uint32_t)(s64Deviation < 0 ? -s64Deviation : s64Deviation);
+
+            pthread_mutex_lock(&_stSNES.stLock);
+            if (u32Deviation > _stSNES.stStats.u32LatchMax)
+            {
+                _stSNES.stStats.u32LatchMax = u32Deviation;
+            }
+            pthread_mutex_unlock(&_stSNES.stLock);
+        }
+        s64Last  = s64Now;
+        s64Next += _stSNES.u32FramePeriod;
+
+        _HostConsoleLatch();
+    }
+    return NULL;
+}
+
+/**
+ * @fn       void _HostConsoleLatch(void)
+ * @brief    One console frame on both controller ports
+ * @details  The latch pulse ends the transaction of the last frame and
+ *           raises the latch interrupts, then the console clocks out
+ *           the word of the next armed transaction.
+ */
+static void _HostConsoleLatch(void)
+{
+    static const spi_host_device_t aeHost[2] = { HSPI_HOST, VSPI_HOST };
+
+    for (uint8_t u8Port = 0; u8Port < 2; u8Port++)
+    {
+        HostSPI*                 pstSPI = &_stSNES.astSPI[aeHost[u8Port]];
+        spi_slave_transaction_t* pstDone;
+
+        pthread_mutex_lock(&_stSNES.stLock);
+        pstDone           = pstSPI->pstActive;
+        pstSPI->pstActive = NULL;
+        pthread_mutex_unlock(&_stSNES.stLock);
+
+        if (NULL != pstDone && pstSPI->bUsed)
+        {
+            HostEnterISR(pstSPI->nCore);
+            pstDone->trans_len = pstDone->length;
+            if (NULL != pstSPI->stIf.post_trans_cb)
+            {
+                pstSPI->stIf.post_trans_cb(pstDone);
+            }
+            xQueueSendFromISR(pstSPI->hResults, &pstDone, NULL);
+        }
+    }
+
+    _HostRaise(SNES_PORT0_LATCH_PIN, true);
+    _HostRaise(SNES_PORT1_LATCH_PIN, true);
+
+    pthread_mutex_lock(&_stSNES.stLock);
+    _stSNES.stStats.u32Frames++;
+    pthread_mutex_unlock(&_stSNES.stLock);
+
+    for (uint8_t u8Port = 0; u8Port < 2; u8Port++)
+    {
+        HostSPI*                 pstSPI = &_stSNES.astSPI[aeHost[u8Port]];
+        spi_slave_transaction_t* pstNext = NULL;
+
+        pthread_mutex_lock(&_stSNES.stLock);
+        if (pstSPI->bUsed && pstSPI->u8Count > 0)
+        {
+            pstNext           = pstSPI->apstArmed[pstSPI->u8Head];
+            pstSPI->u8Head    = (pstSPI->u8Head + 1) % HOST_SPI_QUEUE;
+            pstSPI->u8Count--;
+            pstSPI->pstActive = pstNext;
+        }
+        pthread_mutex_unlock(&_stSNES.stLock);
+
+        if (NULL == pstNext)
+        {
+            pthread_mutex_lock(&_stSNES.stLock);
+            _stSNES.stStats.au32Empty[u8Port]++;
+            pthread_mutex_unlock(&_stSNES.stLock);
+            continue;
+        }
+
+        HostEnterISR(pstSPI->nCore);
+        if (NULL != pstSPI->stIf.post_setup_cb)
+        {
+            pstSPI->stIf.post_setup_cb(pstNext);
+        }
+
+        // Dummy bit first, then the controller word, LSB first.
+        if (pstNext->length >= 17 && NULL != pstNext->tx_buffer)
+        {
+            uint32_t u32Tx;
+            uint16_t u16Word;
+
+            memcpy(&u32Tx, (const void*)pstNext->tx_buffer, sizeof(u32Tx));
+            u16Word = (uint16_t)((u32Tx >> 1) & 0xffff);
+
+            pthread_mutex_lock(&_stSNES.stLock);
+            if (_stSNES.stStats.au32Words[u8Port] > 0 && u16Word != _stSNES.stStats.au16Last[u8Port])
+            {
+                _stSNES.stStats.au32Changes[u8Port]++;
+            }
+            _stSNES.stStats.au32Words[u8Port]++;
+            _stSNES.stStats.au16Last[u8Port] = u16Word;
+            pthread_mutex_unlock(&_stSNES.stLock);
+        }
+    }
+}
+
+/**
+ * @fn      uint16_t _HostPadWord(void)
+ * @brief   Get the word of the virtual controller, the lock has to be held
+ * @return  Controller word, active low
+ */
+static uint16_t _HostPadWord(void)
+{
+    uint32_t u32Step;
+
+    if (! _stSNES.bDemo)
+    {
+        return _stSNES.u16Pad;
+    }
+
+    // Each button in turn, then a step with none pressed.
+    u32Step = (uint32_t)(esp_timer_get_time() / 1000 / HOST_PAD_STEP_MS) % (HOST_PAD_BUTTONS + 1);
+    if (HOST_PAD_BUTTONS == u32Step)
+    {
+        return 0xffff;
+    }
+    return (uint16_t)~(1 << u32Step);
+}
+
+/**
+ * @fn     void _HostBusyWait(int64_t s64Until)
+ * @brief  Spin until the given esp_timer time
+ */
+static void _HostBusyWait(int64_t s64Until)
+{
+    while (esp_timer_get_time() < s64Until)
+    {
+        continue;
+    }
+}
@@ -0,0 +1,173 @@
+/**
+ * @file       LanDiscovery.c
+ * @brief      Host implementation of the LAN discovery
+ * @details    Pairs with an adapter or a second instance using the
+ *             same protocol code as the firmware and prints the time
+ *             until the pairing is complete.  Two instances can be
+ *             paired on one machine:
+ * @code{.unparsed}
+ *   LanDiscovery 50001 127.0.0.1 50002 &
+ *   LanDiscovery 50002 127.0.0.1 50001
+ * @endcode
+ *             Without arguments, the instance broadcasts on the
+ *             discovery port like the firmware does.
+ * @defgroup   LanDiscovery LAN discovery host implementation
+ * @ingroup    LanDiscovery
+ * @author     SNESoIP contributors
+ * @copyright  "THE BEER-WARE LICENCE" (Revision 42)
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "DiscoveryProtocol.h"
+
+#define DISCOVERY_PORT     54352  // !< UDP port of the LAN discovery, see Discovery.h
+#define NETPLAY_PORT       54351  // !< Announced input exchange port, see Netplay.h
+#define PAIRING_TIMEOUT_S  10     // !< Give up after this many seconds
+
+static int64_t _GetTime(void);
+static void    _Send(int nSock, Discovery* pstDiscovery, const struct sockaddr_in* pstBroadcast, int64_t s64Now);
+
+int main(int argc, char* argv[])
+{
+    Discovery          stDiscovery;
+    struct sockaddr_in stLocalAddr;
+    struct sockaddr_in stBroadcast;
+    uint16_t           u16LocalPort = DISCOVERY_PORT;
+    int                nSockOpt     = 1;
+    int                nSock;
+    int64_t            s64Start;
+
+    memset(&stBroadcast, 0, sizeof(stBroadcast));
+    stBroadcast.sin_family      = AF_INET;
+    stBroadcast.sin_addr.s_addr = htonl(INADDR_BROADCAST);
+    stBroadcast.sin_port        = htons(DISCOVERY_PORT);
+
+    if (argc > 1)
+    {
+        u16LocalPort = (uint16_t)strtoul(argv[1], NULL, 10);
+    }
+    if (argc > 2 && 1 != inet_pton(AF_INET, argv[2], &stBroadcast.sin_addr))
+    {
+        fprintf(stderr, "Invalid address: %s\n", argv[2]);
+        return EXIT_FAILURE;
+    }
+    if (argc > 3)
+    {
+        stBroadcast.sin_port = htons((uint16_t)strtoul(argv[3], NULL, 10));
+    }
+
+    nSock = socket(AF_INET, SOCK_DGRAM, 0);
+    if (0 > nSock)
+    {
+        perror("socket");
+        return EXIT_FAILURE;
+    }
+    setsockopt(nSock, SOL_SOCKET, SO_BROADCAST, &nSockOpt, sizeof(nSockOpt));
+    setsockopt(nSock, SOL_SOCKET, SO_REUSEADDR, &nSockOpt, sizeof(nSockOpt));
+
+    memset(&stLocalAddr, 0, sizeof(stLocalAddr));
+    stLocalAddr.sin_family      = AF_INET;
+    stLocalAddr.sin_addr.s_addr = htonl(INADDR_ANY);
+    stLocalAddr.sin_port        = htons(u16LocalPort);
+    if (0 != bind(nSock, (struct sockaddr*)&stLocalAddr, sizeof(stLocalAddr)))
+    {
+        perror("bind");
+        close(nSock);
+        return EXIT_FAILURE;
+    }
+
+    s64Start = _GetTime();
+    srand((unsigned int)(s64Start ^ getpid()));
+    InitDiscoveryProtocol(&stDiscovery, ((uint32_t)rand() << 16) ^ (uint32_t)rand(), NETPLAY_PORT);
+
+    while (DISCOVERY_PAIRED != stDiscovery.eState)
+    {
+        struct sockaddr_in stSourceAddr;
+        socklen_t          uAddrLen = sizeof(stSourceAddr);
+        struct timeval     stTimeout;
+        fd_set             stReadSet;
+        uint8_t            au8Buffer[DISCOVERY_PACKET_SIZE + 1];
+        ssize_t            nLen;
+
+        if ((_GetTime() - s64Start) > PAIRING_TIMEOUT_S * 1000000LL)
+        {
+            fprintf(stderr, "No adapter found within %d s.\n", PAIRING_TIMEOUT_S);
+            close(nSock);
+            return EXIT_FAILURE;
+        }
+
+        _Send(nSock, &stDiscovery, &stBroadcast, _GetTime());
+
+        FD_ZERO(&stReadSet);
+        FD_SET(nSock, &stReadSet);
+        stTimeout.tv_sec  = 0;
+        stTimeout.tv_usec = DISCOVERY_ANNOUNCE_MS * 1000 / 2;
+        if (0 >= select(nSock + 1, &stReadSet, NULL, NULL, &stTimeout))
+        {
+            continue;
+        }
+
+        nLen = recvfrom(nSock, au8Buffer, sizeof(au8Buffer), 0, (struct sockaddr*)&stSourceAddr, &uAddrLen);
+        if (0 >= nLen)
+        {
+            continue;
+        }
+        DiscoveryReceive(&stDiscovery, au8Buffer, (size_t)nLen,
+                         stSourceAddr.sin_addr.s_addr, ntohs(stSourceAddr.sin_port), _GetTime());
+        _Send(nSock, &stDiscovery, &stBroadcast, _GetTime());
+    }
+
+    {
+        struct in_addr stPeer;
+        stPeer.s_addr = stDiscovery.u32PeerAddr;
+        printf("Paired with %08x at %s, input port %u, after %.1f ms\n",
+               stDiscovery.u32PeerNonce, inet_ntoa(stPeer), stDiscovery.u16PeerPort,
+               (double)(_GetTime() - s64Start) / 1000.0);
+    }
+
+    close(nSock);
+    return EXIT_SUCCESS;
+}
+
+static int64_t _GetTime(void)
+{
+    struct timespec stNow;
+
+    clock_gettime(CLOCK_MONOTONIC, &stNow);
+    return (int64_t)stNow.tv_sec * 1000000 + stNow.tv_nsec / 1000;
+}
+
+static void _Send(int nSock, Discovery* pstDiscovery, const struct sockaddr_in* pstBroadcast, int64_t s64Now)
+{
+    struct sockaddr_in stDest;
+    uint8_t            au8Buffer[DISCOVERY_PACKET_SIZE];
+    bool               bUnicast;
+    size_t             uSize;
+
+    while (0 < (uSize = DiscoveryPoll(pstDiscovery, s64Now, au8Buffer, &bUnicast)))
+    {
+        stDest = *pstBroadcast;
+        if (bUnicast)
+        {
+            stDest.sin_addr.s_addr = pstDiscovery->u32PeerAddr;
+            stDest.sin_port        = htons(pstDiscovery->u16PeerSrcPort);
+        }
+        if (0 > sendto(nSock, au8Buffer, uSize, 0, (const struct sockaddr*)&stDest, sizeof(stDest)))
+        {
+            perror("sendto");
+        }
+    }
+}
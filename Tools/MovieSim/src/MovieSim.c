@@ -0,0 +1,276 @@
+/**
+ * @file       MovieSim.c
+ * @brief      Simulation of the input movie playback
+ * @details    A console latches both controller ports once per frame
+ *             with some jitter, the two ports report the latch in
+ *             random order, some frames are read twice and the driver
+ *             occasionally misses a latch.  A host uploads the movie in
+ *             segments at a given share of the playback rate and is
+ *             held up while the buffer is full.  The player is the one
+ *             of the firmware.  Usage:
+ * @code{.unparsed}
+ *   MovieSim [frames] [ports] [upload percent]
+ * @endcode
+ *             Fails if a latch gets a word of the wrong frame, if both
+ *             ports disagree about the frame, if a frame is skipped,
+ *             if the movie does not finish or if the latch-miss report
+ *             does not match what happened.
+ * @defgroup   MovieSim Input movie playback simulation
+ * @ingroup    MovieSim
+ * @author     SNESoIP contributors
+ * @copyright  "THE BEER-WARE LICENCE" (Revision 42)
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "MoviePlayer.h"
+
+#define NTSC_PERIOD_US   16639.27  // !< Nominal NTSC frame period
+#define LATCH_JITTER_US  30.0      // !< Max. deviation of a latch
+#define PORT_SKEW_US     20.0      // !< Max. time between both port reports
+#define REREAD_US        2000.0    // !< Second controller read within a frame
+#define REREAD_RATE      50        // !< One frame in n is read twice
+#define MISS_RATE        2000      // !< One latch in n is missed by the driver
+#define SEGMENT_US       10000.0   // !< Upload granularity
+
+static uint64_t _u64Random = 0x2545f4914f6cdd1dULL;
+
+static MoviePlayer _stPlayer;
+static uint8_t     _u8Ports;
+static uint32_t    _u32Frames;
+static int32_t     _s32Shown;      // !< Movie frame shown in the current console frame
+static int32_t     _s32LastShown;  // !< Movie frame shown in the previous console frame
+static uint32_t    _u32Errors;
+
+static double   _Random(void);
+static uint16_t _MovieWord(uint32_t u32Frame, uint8_t u8Port);
+static void     _Upload(uint32_t* pu32Sent, uint32_t u32Allowed);
+static void     _Latch(uint8_t u8Port, int64_t s64Now, uint32_t u32Console);
+
+int main(int argc, char* argv[])
+{
+    uint32_t u32Percent  = 100;
+    uint32_t u32Sent     = 0;
+    uint32_t u32Size;
+    uint32_t u32Missed   = 0;
+    uint32_t u32Rereads  = 0;
+    uint32_t u32Console  = 0;
+    uint32_t u32Repeated = 0;
+    double   dRate;
+    double   dTime       = 1000.0;
+
+    _u32Frames = 36000;
+    _u8Ports   = 2;
+
+    if (argc > 1)
+    {
+        _u32Frames = (uint32_t)atol(argv[1]);
+    }
+    if (argc > 2)
+    {
+        _u8Ports = (uint8_t)atoi(argv[2]);
+    }
+    if (argc > 3)
+    {
+        u32Percent = (uint32_t)atol(argv[3]);
+    }
+    if (0 == _u32Frames || _u8Ports < 1 || _u8Ports > MOVIE_MAX_PORTS || 0 == u32Percent)
+    {
+        fprintf(stderr, "Usage: %s [frames] [ports] [upload percent]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    InitMoviePlayer(&_stPlayer, _u8Ports, _u32Frames);
+    u32Size       = _u32Frames * _u8Ports * 2;
+    dRate         = (double)_u8Ports * 2.0 / NTSC_PERIOD_US * u32Percent / 100.0;
+    _s32Shown     = -1;
+    _s32LastShown = -1;
+
+    while (! _stPlayer.bDone && u32Console < _u32Frames * 4 + 1000)
+    {
+        double   dLatch  = dTime + (_Random() * 2.0 - 1.0) * LATCH_JITTER_US;
+        double   dUpload = dLatch - SEGMENT_US;
+        uint8_t  u8First = _Random() < 0.5 ? 0 : 1;
+        uint32_t u32Allowed;
+        bool     bPlaying;
+
+        // Segments the host got out so far, held up by the buffer.
+        while (dUpload < dLatch)
+        {
+            dUpload   += SEGMENT_US;
+            u32Allowed = (uint32_t)(dRate * (dUpload < dLatch ? dUpload : dLatch));
+            _Upload(&u32Sent, u32Allowed > u32Size ? u32Size : u32Allowed);
+        }
+
+        // Only what happens while the movie plays shows in the report.
+        bPlaying  = _stPlayer.bStarted && _stPlayer.bFrameValid;
+        _s32Shown = -1;
+        if (0 == (uint32_t)(_Random() * MISS_RATE))
+        {
+            // The console latched, the driver did not notice.
+            if (bPlaying)
+            {
+                u32Missed++;
+            }
+        }
+        else
+        {
+            _Latch(u8First,     (int64_t)dLatch, u32Console);
+            _Latch(u8First ^ 1, (int64_t)(dLatch + _Random() * PORT_SKEW_US), u32Console);
+            if (0 == (uint32_t)(_Random() * REREAD_RATE))
+            {
+                if (_s32Shown >= 0)
+                {
+                    u32Rereads++;
+                }
+                _Latch(0, (int64_t)(dLatch + REREAD_US), u32Console);
+                _Latch(1, (int64_t)(dLatch + REREAD_US + _Random() * PORT_SKEW_US), u32Console);
+            }
+
+            if (_s32Shown >= 0)
+            {
+                if (_s32Shown == _s32LastShown)
+                {
+                    u32Repeated++;
+                }
+                else if (_s32Shown != _s32LastShown + 1)
+                {
+                    printf("Console frame %u: movie frame %d follows %d\n", u32Console, _s32Shown, _s32LastShown);
+                    _u32Errors++;
+                }
+                _s32LastShown = _s32Shown;
+            }
+        }
+
+        u32Console++;
+        dTime += NTSC_PERIOD_US;
+    }
+
+    printf("Simulated:  %u frames, %u port(s), upload at %u%% of the playback rate\n",
+           _u32Frames, _u8Ports, u32Percent);
+    printf("Console:    %u frames, %u missed latches, %u read twice\n",
+           u32Console, u32Missed, u32Rereads);
+    printf("Player:     %u played, %u latches, %u repeats, %u underruns, %u gaps\n",
+           _stPlayer.stStats.u32Played, _stPlayer.stStats.u32Latches, _stPlayer.stStats.u32Repeats,
+           _stPlayer.stStats.u32Underruns, _stPlayer.stStats.u32Gaps);
+    printf("Errors:     %u\n", _u32Errors);
+
+    if (! _stPlayer.bDone || _stPlayer.stStats.u32Played != _u32Frames || _s32LastShown != (int32_t)_u32Frames - 1)
+    {
+        printf("Movie did not finish\n");
+        _u32Errors++;
+    }
+    if (u32Repeated != _stPlayer.stStats.u32Underruns)
+    {
+        printf("%u repeated frames, but %u underruns reported\n", u32Repeated, _stPlayer.stStats.u32Underruns);
+        _u32Errors++;
+    }
+    if (u32Percent >= 100 && 0 != _stPlayer.stStats.u32Underruns)
+    {
+        printf("Underruns although the upload keeps up\n");
+        _u32Errors++;
+    }
+    if (u32Rereads * _u8Ports != _stPlayer.stStats.u32Repeats)
+    {
+        printf("%u frames read twice, but %u repeats reported\n", u32Rereads, _stPlayer.stStats.u32Repeats);
+        _u32Errors++;
+    }
+    if (u32Missed != _stPlayer.stStats.u32Gaps)
+    {
+        printf("%u missed latches, but %u gaps reported\n", u32Missed, _stPlayer.stStats.u32Gaps);
+        _u32Errors++;
+    }
+
+    return 0 == _u32Errors ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+static double _Random(void)
+{
+    // xorshift64*, reproducible across platforms.
+    _u64Random ^= _u64Random >> 12;
+    _u64Random ^= _u64Random << 25;
+    _u64Random ^= _u64Random >> 27;
+    return (double)((_u64Random * 2685821657736338717ULL) >> 11) / 9007199254740992.0;
+}
+
+static uint16_t _MovieWord(uint32_t u32Frame, uint8_t u8Port)
+{
+    return (uint16_t)(((u32Frame & 0x7fff) << 1) | u8Port);
+}
+
+static void _Upload(uint32_t* pu32Sent, uint32_t u32Allowed)
+{
+    uint8_t au8Segment[256];
+
+    while (*pu32Sent < u32Allowed)
+    {
+        uint32_t u32Size = u32Allowed - *pu32Sent;
+        size_t   uAccepted;
+
+        if (u32Size > sizeof(au8Segment))
+        {
+            u32Size = sizeof(au8Segment);
+        }
+        for (uint32_t u32Index = 0; u32Index < u32Size; u32Index++)
+        {
+            uint32_t u32Byte = *pu32Sent + u32Index;
+            uint32_t u32Word = u32Byte / 2;
+            uint16_t u16Word = _MovieWord(u32Word / _u8Ports, (uint8_t)(u32Word % _u8Ports));
+
+            au8Segment[u32Index] = (uint8_t)(0 == (u32Byte & 1) ? u16Word >> 8 : u16Word);
+        }
+
+        uAccepted  = MoviePush(&_stPlayer, au8Segment, u32Size);
+        *pu32Sent += (uint32_t)uAccepted;
+        if (uAccepted < u32Size)
+        {
+            break;
+        }
+    }
+}
+
+static void _Latch(uint8_t u8Port, int64_t s64Now, uint32_t u32Console)
+{
+    uint16_t u16Data;
+    int32_t  s32Frame;
+
+    if (! MovieLatch(&_stPlayer, u8Port, s64Now, &u16Data))
+    {
+        if (_stPlayer.bStarted && ! _stPlayer.bDone && u8Port < _u8Ports)
+        {
+            printf("Console frame %u: port %u not served\n", u32Console, u8Port);
+            _u32Errors++;
+        }
+        return;
+    }
+
+    if (u8Port >= _u8Ports || (u16Data & 1) != u8Port)
+    {
+        printf("Console frame %u: port %u got a word of port %u\n", u32Console, u8Port, u16Data & 1);
+        _u32Errors++;
+        return;
+    }
+
+    // Words carry 15 bits of the frame number.
+    s32Frame = (_s32LastShown + 1) & ~0x7fff;
+    s32Frame |= u16Data >> 1;
+    if (s32Frame > _s32LastShown + 1)
+    {
+        s32Frame -= 0x8000;
+    }
+
+    if (_s32Shown < 0)
+    {
+        _s32Shown = s32Frame;
+    }
+    else if (s32Frame != _s32Shown)
+    {
+        printf("Console frame %u: port %u shows movie frame %d instead of %d\n",
+               u32Console, u8Port, s32Frame, _s32Shown);
+        _u32Errors++;
+    }
+}
@@ -0,0 +1,195 @@
+/**
+ * @file       NetplayBench.c
+ * @brief      Loopback benchmark of the peer-to-peer input protocol
+ * @details    Runs two input exchange sessions against each other via
+ *             UDP on 127.0.0.1, using the same protocol code as the
+ *             firmware.  Received packets can be dropped on purpose to
+ *             check that the frame history covers the losses.
+ * @defgroup   NetplayBench Netplay loopback benchmark
+ * @ingroup    NetplayBench
+ * @author     SNESoIP contributors
+ * @copyright  "THE BEER-WARE LICENCE" (Revision 42)
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "NetplayProtocol.h"
+
+/**
+ * @struct  Peer
+ * @brief   Benchmark peer
+ */
+typedef struct Peer_t
+{
+    int                nSock;
+    struct sockaddr_in stAddr;
+    NetplaySession     stSession;
+
+} Peer;
+
+static uint32_t _u32Delivered;
+static uint32_t _u32Corrupted;
+
+static int64_t  _GetTime(void);
+static uint16_t _WordOfFrame(uint32_t u32Frame);
+static void     _Deliver(uint32_t u32Frame, uint16_t u16Data);
+static bool     _OpenPeer(Peer* pstPeer);
+static void     _Send(Peer* pstFrom, const Peer* pstTo, uint32_t u32Frame);
+static void     _Receive(Peer* pstPeer, unsigned int uLossPercent);
+
+int main(int argc, char* argv[])
+{
+    Peer         stA;
+    Peer         stB;
+    uint32_t     u32Packets   = 100000;
+    unsigned int uLossPercent = 0;
+    int64_t      s64Start;
+    int64_t      s64Elapsed;
+
+    if (argc > 1)
+    {
+        u32Packets = (uint32_t)strtoul(argv[1], NULL, 10);
+    }
+    if (argc > 2)
+    {
+        uLossPercent = (unsigned int)strtoul(argv[2], NULL, 10);
+    }
+
+    if (! _OpenPeer(&stA) || ! _OpenPeer(&stB))
+    {
+        return EXIT_FAILURE;
+    }
+    srand(1);
+
+    s64Start = _GetTime();
+    for (uint32_t u32Frame = 1; u32Frame <= u32Packets; u32Frame++)
+    {
+        _Send(&stA, &stB, u32Frame);
+        _Receive(&stB, uLossPercent);
+        _Send(&stB, &stA, u32Frame);
+        _Receive(&stA, uLossPercent);
+    }
+    s64Elapsed = _GetTime() - s64Start;
+
+    printf("Packets:    %u per direction, %u%% loss\n", u32Packets, uLossPercent);
+    printf("Elapsed:    %lld us, %.0f packets/s\n",
+           (long long)s64Elapsed, 2.0 * u32Packets * 1000000.0 / (double)(s64Elapsed ? s64Elapsed : 1));
+    printf("Delivered:  %u frames, %u corrupted\n", _u32Delivered, _u32Corrupted);
+    printf("Recovered:  %u frames (A->B), %u frames (B->A)\n",
+           stB.stSession.stStats.u32Recovered, stA.stSession.stStats.u32Recovered);
+    printf("Lost:       %u frames (A->B), %u frames (B->A)\n",
+           stB.stSession.stStats.u32Lost, stA.stSession.stStats.u32Lost);
+    printf("RTT:        min %u us, smoothed %u us, var %u us\n",
+           stA.stSession.stStats.u32RTTMin,
+           stA.stSession.stStats.u32RTTSmooth,
+           stA.stSession.stStats.u32RTTVar);
+
+    close(stA.nSock);
+    close(stB.nSock);
+
+    return _u32Corrupted ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+static int64_t _GetTime(void)
+{
+    struct timespec stNow;
+
+    clock_gettime(CLOCK_MONOTONIC, &stNow);
+    return (int64_t)stNow.tv_sec * 1000000 + stNow.tv_nsec / 1000;
+}
+
+static uint16_t _WordOfFrame(uint32_t u32Frame)
+{
+    return (uint16_t)((u32Frame * 2654435761u) >> 16);
+}
+
+static void _Deliver(uint32_t u32Frame, uint16_t u16Data)
+{
+    _u32Delivered++;
+    if (u16Data != _WordOfFrame(u32Frame))
+    {
+        _u32Corrupted++;
+    }
+}
+
+static bool _OpenPeer(Peer* pstPeer)
+{
+    socklen_t uLen = sizeof(pstPeer->stAddr);
+
+    memset(pstPeer, 0, sizeof(Peer));
+    InitNetplaySession(&pstPeer->stSession);
+
+    pstPeer->nSock = socket(AF_INET, SOCK_DGRAM, 0);
+    if (0 > pstPeer->nSock)
+    {
+        perror("socket");
+        return false;
+    }
+
+    pstPeer->stAddr.sin_family      = AF_INET;
+    pstPeer->stAddr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    pstPeer->stAddr.sin_port        = 0;
+    if (0 != bind(pstPeer->nSock, (struct sockaddr*)&pstPeer->stAddr, sizeof(pstPeer->stAddr)))
+    {
+        perror("bind");
+        return false;
+    }
+    getsockname(pstPeer->nSock, (struct sockaddr*)&pstPeer->stAddr, &uLen);
+
+    return true;
+}
+
+static void _Send(Peer* pstFrom, const Peer* pstTo, uint32_t u32Frame)
+{
+    NetplayPacket stPacket;
+    uint8_t       au8Buffer[NETPLAY_PACKET_SIZE];
+    size_t        uSize;
+    int64_t       s64Now = _GetTime();
+
+    NetplayBuildPacket(&pstFrom->stSession, u32Frame, _WordOfFrame(u32Frame), s64Now, s64Now, &stPacket);
+    uSize = EncodeNetplayPacket(&stPacket, au8Buffer, sizeof(au8Buffer));
+    if (0 > sendto(pstFrom->nSock, au8Buffer, uSize, 0, (const struct sockaddr*)&pstTo->stAddr, sizeof(pstTo->stAddr)))
+    {
+        perror("sendto");
+    }
+}
+
+static void _Receive(Peer* pstPeer, unsigned int uLossPercent)
+{
+    NetplayPacket stPacket;
+    uint8_t       au8Buffer[NETPLAY_PACKET_SIZE + 1];
+    ssize_t       nLen;
+
+    nLen = recv(pstPeer->nSock, au8Buffer, sizeof(au8Buffer), 0);
+    if (0 > nLen)
+    {
+        perror("recv");
+        return;
+    }
+
+    // Simulated loss.
+    if ((unsigned int)(rand() % 100) < uLossPercent)
+    {
+        return;
+    }
+
+    if (DecodeNetplayPacket(&stPacket, au8Buffer, (size_t)nLen))
+    {
+        NetplayHandlePacket(&pstPeer->stSession, &stPacket, _GetTime(), _Deliver);
+    }
+    else
+    {
+        pstPeer->stSession.stStats.u32RxInvalid++;
+    }
+}
@@ -0,0 +1,317 @@
+/**
+ * @file       TraceExport.c
+ * @brief      Trace dump to Chrome trace JSON
+ * @details    Converts a trace dump of the firmware into the Chrome
+ *             trace event format, which is shown by chrome://tracing
+ *             and ui.perfetto.dev.  Usage:
+ * @code{.unparsed}
+ *   echo "trace dump" | nc -q 5 <adapter> 23 > trace.bin
+ *   TraceExport trace.bin [trace.json]
+ * @endcode
+ *             Each core gets a lane with the running task and one with
+ *             the SNES interrupt handlers.  Latch, SPI and packet
+ *             events are instant events on the lane of their core.
+ *             Anything in front of the dump, e.g. a terminal prompt,
+ *             is skipped.  Without an output file, the JSON goes to
+ *             stdout.
+ * @defgroup   TraceExport Trace dump converter
+ * @ingroup    TraceExport
+ * @author     SNESoIP contributors
+ * @copyright  "THE BEER-WARE LICENCE" (Revision 42)
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "TraceFormat.h"
+
+#define MAX_DUMP_SIZE  (4 * 1024 * 1024)  // !< Largest dump read
+#define MAX_TASKS      256                // !< Largest task table
+#define MAX_CORES      2                  // !< Cores of the ESP32
+#define ISR_LANE       MAX_CORES          // !< Lane of the ISRs of core 0
+
+static TraceTask _astTask[MAX_TASKS];
+static uint16_t  _u16Tasks;
+static FILE*     _pstOut;
+static bool      _bFirst = true;
+
+static const uint8_t* _FindDump(const uint8_t* pu8Data, size_t* puSize);
+static const char*    _TaskName(uint32_t u32Handle);
+static void           _Event(const char* pacName, char cPhase, uint8_t u8Lane, double dTime, const char* pacExtra);
+static void           _String(const char* pacString);
+
+int main(int argc, char* argv[])
+{
+    static uint8_t au8Data[MAX_DUMP_SIZE];
+    const uint8_t* pu8Dump;
+    TraceHeader    stHeader;
+    FILE*          pstIn;
+    size_t         uSize;
+    size_t         uOffset;
+    uint32_t       au32Task[MAX_CORES]  = { 0 };
+    double         adSince[MAX_CORES]   = { 0 };
+    bool           abTask[MAX_CORES]    = { false };
+    uint8_t        au8Depth[MAX_CORES]  = { 0 };
+    uint16_t       au16ISR[MAX_CORES][TRACE_ISRS];
+    uint32_t       u32Prev              = 0;
+    double         dTime                = 0.0;
+
+    if (argc < 2 || argc > 3)
+    {
+        fprintf(stderr, "Usage: %s <dump> [json]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    pstIn = fopen(argv[1], "rb");
+    if (NULL == pstIn)
+    {
+        fprintf(stderr, "Unable to open %s\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+    uSize = fread(au8Data, 1, sizeof(au8Data), pstIn);
+    fclose(pstIn);
+
+    pu8Dump = _FindDump(au8Data, &uSize);
+    if (NULL == pu8Dump || ! DecodeTraceHeader(&stHeader, pu8Dump, uSize))
+    {
+        fprintf(stderr, "%s is no trace dump of version %u\n", argv[1], TRACE_VERSION);
+        return EXIT_FAILURE;
+    }
+    uOffset = TRACE_HEADER_SIZE;
+
+    for (uint16_t u16Index = 0; u16Index < stHeader.u16Tasks; u16Index++)
+    {
+        TraceTask stTask;
+
+        if (! DecodeTraceTask(&stTask, &pu8Dump[uOffset], uSize - uOffset))
+        {
+            fprintf(stderr, "Task table truncated\n");
+            return EXIT_FAILURE;
+        }
+        uOffset += TRACE_TASK_SIZE;
+        if (_u16Tasks < MAX_TASKS)
+        {
+            _astTask[_u16Tasks++] = stTask;
+        }
+    }
+
+    _pstOut = stdout;
+    if (3 == argc)
+    {
+        _pstOut = fopen(argv[2], "w");
+        if (NULL == _pstOut)
+        {
+            fprintf(stderr, "Unable to create %s\n", argv[2]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    fprintf(_pstOut, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    for (uint8_t u8Core = 0; u8Core < MAX_CORES; u8Core++)
+    {
+        char acName[32];
+
+        snprintf(acName, sizeof(acName), "{\"name\":\"CPU %u\"}", u8Core);
+        _Event("thread_name", 'M', u8Core, 0.0, acName);
+        snprintf(acName, sizeof(acName), "{\"name\":\"CPU %u ISR\"}", u8Core);
+        _Event("thread_name", 'M', ISR_LANE + u8Core, 0.0, acName);
+    }
+
+    for (uint32_t u32Index = 0; u32Index < stHeader.u32Events; u32Index++)
+    {
+        TraceEvent stEvent;
+        char       acArgs[64];
+        uint8_t    u8Core;
+
+        if (! DecodeTraceEvent(&stEvent, &pu8Dump[uOffset], uSize - uOffset))
+        {
+            fprintf(stderr, "Event %u invalid or truncated\n", u32Index);
+            break;
+        }
+        uOffset += TRACE_EVENT_SIZE;
+
+        // The µs timer is stored as 32 bits, the ring is in time order.
+        if (u32Index > 0)
+        {
+            dTime += (double)(uint32_t)(stEvent.u32Time - u32Prev);
+        }
+        u32Prev = stEvent.u32Time;
+        u8Core  = stEvent.u8Core < MAX_CORES ? stEvent.u8Core : MAX_CORES - 1;
+
+        switch (stEvent.u8Type)
+        {
+            case TRACE_TASK_SWITCH:
+                if (abTask[u8Core])
+                {
+                    snprintf(acArgs, sizeof(acArgs), "%.3f", dTime - adSince[u8Core]);
+                    _Event(_TaskName(au32Task[u8Core]), 'X', u8Core, adSince[u8Core], acArgs);
+                }
+                abTask[u8Core]   = true;
+                au32Task[u8Core] = stEvent.u32Arg;
+                adSince[u8Core]  = dTime;
+                break;
+            case TRACE_ISR_ENTER:
+                if (au8Depth[u8Core] < TRACE_ISRS)
+                {
+                    au16ISR[u8Core][au8Depth[u8Core]++] = stEvent.u16Id;
+                    _Event(TraceISRName(stEvent.u16Id), 'B', ISR_LANE + u8Core, dTime, NULL);
+                }
+                break;
+            case TRACE_ISR_EXIT:
+                // An exit without enter was cut off at the start of the ring.
+                if (au8Depth[u8Core] > 0)
+                {
+                    au8Depth[u8Core]--;
+                    _Event(TraceISRName(au16ISR[u8Core][au8Depth[u8Core]]), 'E', ISR_LANE + u8Core, dTime, NULL);
+                }
+                break;
+            case TRACE_SPI_DONE:
+            case TRACE_LATCH:
+                snprintf(acArgs, sizeof(acArgs), "{\"port\":%u,\"count\":%u}", stEvent.u16Id, stEvent.u32Arg);
+                _Event(TraceTypeName(stEvent.u8Type), 'i', u8Core, dTime, acArgs);
+                break;
+            case TRACE_PACKET_RX:
+            case TRACE_PACKET_TX:
+                snprintf(acArgs, sizeof(acArgs), "{\"size\":%u,\"frame\":%u}", stEvent.u16Id, stEvent.u32Arg);
+                _Event(TraceTypeName(stEvent.u8Type), 'i', u8Core, dTime, acArgs);
+                break;
+            default:
+                break;
+        }
+    }
+
+    // Close what is still open at the end of the ring.
+    for (uint8_t u8Core = 0; u8Core < MAX_CORES; u8Core++)
+    {
+        char acArgs[32];
+
+        if (abTask[u8Core])
+        {
+            snprintf(acArgs, sizeof(acArgs), "%.3f", dTime - adSince[u8Core]);
+            _Event(_TaskName(au32Task[u8Core]), 'X', u8Core, adSince[u8Core], acArgs);
+        }
+        while (au8Depth[u8Core] > 0)
+        {
+            au8Depth[u8Core]--;
+            _Event(TraceISRName(au16ISR[u8Core][au8Depth[u8Core]]), 'E', ISR_LANE + u8Core, dTime, NULL);
+        }
+    }
+    fprintf(_pstOut, "\n]}\n");
+
+    if (stdout != _pstOut)
+    {
+        fclose(_pstOut);
+    }
+    fprintf(stderr, "%u tasks, %u events, %u overwritten, %.3f ms\n",
+            _u16Tasks, stHeader.u32Events, stHeader.u32Lost, dTime / 1000.0);
+
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @fn      const uint8_t* _FindDump(const uint8_t* pu8Data, size_t* puSize)
+ * @brief   Find the start of the dump
+ * @param   pu8Data
+ *          File content
+ * @param   puSize
+ *          File size, replaced by the size from the start of the dump
+ * @return  Start of the dump, NULL if there is none
+ */
+static const uint8_t* _FindDump(const uint8_t* pu8Data, size_t* puSize)
+{
+    for (size_t uOffset = 0; uOffset + TRACE_HEADER_SIZE <= *puSize; uOffset++)
+    {
+        if (0 == memcmp(&pu8Data[uOffset], TRACE_MAGIC, 4))
+        {
+            *puSize -= uOffset;
+            return &pu8Data[uOffset];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @fn      const char* _TaskName(uint32_t u32Handle)
+ * @brief   Look up a task name
+ * @param   u32Handle
+ *          Task handle
+ * @return  Name, or the handle if the task was gone at dump time
+ */
+static const char* _TaskName(uint32_t u32Handle)
+{
+    static char acUnknown[20];
+
+    for (uint16_t u16Index = 0; u16Index < _u16Tasks; u16Index++)
+    {
+        if (_astTask[u16Index].u32Handle == u32Handle)
+        {
+            return _astTask[u16Index].acName;
+        }
+    }
+    snprintf(acUnknown, sizeof(acUnknown), "0x%08x", u32Handle);
+    return acUnknown;
+}
+
+/**
+ * @fn     void _Event(const char* pacName, char cPhase, uint8_t u8Lane, double dTime, const char* pacExtra)
+ * @brief  Write one trace event
+ * @param  pacName
+ *         Event name
+ * @param  cPhase
+ *         'X' complete, pacExtra is the duration in µs;
+ *         'M' metadata or 'i' instant, pacExtra are the args;
+ *         'B' or 'E' begin or end
+ * @param  u8Lane
+ *         Thread id of the lane
+ * @param  dTime
+ *         Time in µs
+ * @param  pacExtra
+ *         See cPhase, may be NULL
+ */
+static void _Event(const char* pacName, char cPhase, uint8_t u8Lane, double dTime, const char* pacExtra)
+{
+    fprintf(_pstOut, "%s{\"name\":", _bFirst ? "" : ",\n");
+    _String(pacName);
+    fprintf(_pstOut, ",\"ph\":\"%c\",\"pid\":0,\"tid\":%u,\"ts\":%.3f", cPhase, u8Lane, dTime);
+
+    if ('X' == cPhase)
+    {
+        fprintf(_pstOut, ",\"dur\":%s", pacExtra);
+    }
+    else if ('i' == cPhase)
+    {
+        fprintf(_pstOut, ",\"s\":\"t\",\"args\":%s", pacExtra);
+    }
+    else if (NULL != pacExtra)
+    {
+        fprintf(_pstOut, ",\"args\":%s", pacExtra);
+    }
+    fprintf(_pstOut, "}");
+    _bFirst = false;
+}
+
+/**
+ * @fn     void _String(const char* pacString)
+ * @brief  Write a JSON string
+ * @param  pacString
+ *         Null-terminated string
+ */
+static void _String(const char* pacString)
+{
+    fputc('"', _pstOut);
+    for (; '\0' != *pacString; pacString++)
+    {
+        if ('"' == *pacString || '\\' == *pacString)
+        {
+            fputc('\\', _pstOut);
+        }
+        if ((unsigned char)*pacString >= 0x20)
+        {
+            fputc(*pacString, _pstOut);
+        }
+    }
+    fputc('"', _pstOut);
+}
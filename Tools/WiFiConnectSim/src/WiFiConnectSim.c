@@ -0,0 +1,340 @@
+/**
+ * @file       WiFiConnectSim.c
+ * @brief      Simulation of the WiFi connection strategy
+ * @details    Runs the connection state machine of the firmware against
+ *             a mocked WiFi driver and access point.  The mock answers
+ *             each action with the events the driver would post, after
+ *             typical delays.  Each scenario starts at power-on with
+ *             the given stored data.  Usage:
+ * @code{.unparsed}
+ *   WiFiConnectSim
+ * @endcode
+ *             Fails if a scenario does not end up connected, reaches
+ *             its first IP on another path than expected or later than
+ *             allowed, or runs SmartConfig more often than expected.
+ * @defgroup   WiFiConnectSim WiFi connection simulation
+ * @ingroup    WiFiConnectSim
+ * @author     SNESoIP contributors
+ * @copyright  "THE BEER-WARE LICENCE" (Revision 42)
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "WiFiConnect.h"
+
+#define MS              1000LL         // !< One ms in µs
+#define BOOT_US         (300 * MS)     // !< Station start after power-on
+#define CHANNEL_SCAN_US (120 * MS)     // !< Scan of a single channel
+#define FULL_SCAN_US    (2200 * MS)    // !< Scan of all channels
+#define ASSOC_US        (150 * MS)     // !< Authentication and association
+#define DHCP_US         (400 * MS)     // !< DHCP exchange
+#define STATIC_US       (5 * MS)       // !< Static address applied
+#define AUTH_FAIL_US    (800 * MS)     // !< Handshake with a wrong password
+#define PROVISION_US    (15000 * MS)   // !< User sends credentials from the phone
+#define ACK_US          (1000 * MS)    // !< SmartConfig acknowledgement
+#define END_US          (600000 * MS)  // !< Simulated time per scenario
+#define MAX_PENDING     8              // !< Events in flight
+
+/**
+ * @struct  Scenario
+ * @brief   Stored data, access point and expected outcome
+ */
+typedef struct Scenario_t
+{
+    const char*      pacName;
+    bool             bCredentials;   ///< SSID and password stored
+    bool             bBSSID;         ///< BSSID and channel stored
+    bool             bBSSIDValid;    ///< Stored BSSID and channel still match the access point
+    bool             bPasswordValid; ///< Stored password still matches
+    bool             bStaticIP;      ///< Static address, no DHCP
+    bool             bPhone;         ///< Someone sends credentials via SmartConfig
+    int64_t          s64APUp;        ///< Access point available from
+    int64_t          s64DownFrom;    ///< Access point restarts at, 0 = never
+    int64_t          s64DownTo;      ///< Access point back at
+    WiFiConnectState eExpectPath;    ///< State the first IP is expected in
+    uint32_t         u32MaxReadyMs;  ///< Latest expected first IP
+    uint32_t         u32SmartConfig; ///< Expected SmartConfig runs
+
+} Scenario;
+
+/**
+ * @struct  Pending
+ * @brief   Event the mocked driver posts later
+ */
+typedef struct Pending_t
+{
+    bool             bUsed;
+    int64_t          s64Time;
+    WiFiConnectEvent eEvent;
+
+} Pending;
+
+/**
+ * @struct  Mock
+ * @brief   Mocked WiFi driver and access point
+ */
+typedef struct Mock_t
+{
+    const Scenario* pstScenario;
+    bool            bBSSIDValid;
+    bool            bPasswordValid;
+    bool            bAssociated;
+    bool            bSmartConfig;
+    Pending         astPending[MAX_PENDING];
+    uint32_t        u32Stores;
+
+} Mock;
+
+static const Scenario _astScenario[] =
+{
+    { "stored AP",          true,  true,  true,  true,  false, false, 0,         0,         0,         WIFI_STATE_FAST,        1000,   0 },
+    { "stored AP, static",  true,  true,  true,  true,  true,  false, 0,         0,         0,         WIFI_STATE_FAST,        600,    0 },
+    { "no BSSID yet",       true,  false, false, true,  false, false, 0,         0,         0,         WIFI_STATE_SCAN,        4000,   0 },
+    { "AP replaced",        true,  true,  false, true,  false, false, 0,         0,         0,         WIFI_STATE_SCAN,        4000,   0 },
+    { "unprovisioned",      false, false, false, false, false, true,  0,         0,         0,         WIFI_STATE_SMARTCONFIG, 20000,  1 },
+    { "password changed",   true,  true,  true,  false, false, true,  0,         0,         0,         WIFI_STATE_SMARTCONFIG, 25000,  1 },
+    { "AP boots slowly",    true,  true,  true,  true,  false, false, 100000*MS, 0,         0,         WIFI_STATE_FAST,        130000, 1 },
+    { "AP restarts",        true,  true,  true,  true,  false, false, 0,         60000*MS,  90000*MS,  WIFI_STATE_FAST,        1000,   0 },
+};
+
+static Mock _stMock;
+
+static bool _RunScenario(const Scenario* pstScenario);
+static bool _APUp(int64_t s64Now);
+static void _Post(WiFiConnectEvent eEvent, int64_t s64Time);
+static void _Cancel(WiFiConnectEvent eEvent);
+static void _CancelConnect(void);
+static void _Execute(WiFiConnect* pstConnect, uint8_t u8Actions, int64_t s64Now);
+
+int main(void)
+{
+    uint32_t u32Failed = 0;
+
+    printf("%-20s %-15s %8s %6s %6s %6s %6s %6s\n",
+           "scenario", "ready path", "ready ms", "direct", "scans", "failed", "sc", "lost");
+
+    for (size_t uIndex = 0; uIndex < sizeof(_astScenario) / sizeof(_astScenario[0]); uIndex++)
+    {
+        if (! _RunScenario(&_astScenario[uIndex]))
+        {
+            u32Failed++;
+        }
+    }
+
+    printf("Failed:     %u\n", u32Failed);
+    return 0 == u32Failed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+static bool _RunScenario(const Scenario* pstScenario)
+{
+    WiFiConnect stConnect;
+    int64_t     s64Now  = 0;
+    bool        bPassed = true;
+    bool        bWasUp  = true;
+
+    memset(&_stMock, 0, sizeof(struct Mock_t));
+    _stMock.pstScenario    = pstScenario;
+    _stMock.bBSSIDValid    = pstScenario->bBSSIDValid;
+    _stMock.bPasswordValid = pstScenario->bPasswordValid;
+
+    InitWiFiConnect(&stConnect, pstScenario->bCredentials, pstScenario->bBSSID);
+    _Post(WIFI_CONNECT_START, BOOT_US);
+
+    while (s64Now < END_US)
+    {
+        Pending* pstNext = NULL;
+        int64_t  s64Next = END_US;
+
+        for (uint8_t u8Index = 0; u8Index < MAX_PENDING; u8Index++)
+        {
+            if (_stMock.astPending[u8Index].bUsed && _stMock.astPending[u8Index].s64Time < s64Next)
+            {
+                pstNext = &_stMock.astPending[u8Index];
+                s64Next = pstNext->s64Time;
+            }
+        }
+        if (0 != stConnect.s64Deadline && stConnect.s64Deadline <= s64Next)
+        {
+            pstNext = NULL;
+            s64Next = stConnect.s64Deadline;
+        }
+        if (0 != pstScenario->s64DownFrom && bWasUp && pstScenario->s64DownFrom <= s64Next)
+        {
+            // The access point goes away, the station notices.
+            s64Now = pstScenario->s64DownFrom;
+            bWasUp = false;
+            if (_stMock.bAssociated)
+            {
+                _stMock.bAssociated = false;
+                _Post(WIFI_CONNECT_LOST, s64Now + ASSOC_US);
+            }
+            continue;
+        }
+        s64Now = s64Next;
+
+        if (NULL != pstNext)
+        {
+            WiFiConnectEvent eEvent = pstNext->eEvent;
+
+            pstNext->bUsed = false;
+            if (WIFI_CONNECT_GOT_IP == eEvent)
+            {
+                _stMock.bAssociated = true;
+            }
+            _Execute(&stConnect, WiFiConnectHandle(&stConnect, eEvent, s64Now), s64Now);
+        }
+        else if (s64Now < END_US)
+        {
+            _Execute(&stConnect, WiFiConnectHandle(&stConnect, WIFI_CONNECT_TICK, s64Now), s64Now);
+        }
+    }
+
+    printf("%-20s %-15s %8u %6u %6u %6u %6u %6u\n",
+           pstScenario->pacName,
+           WiFiConnectStateName(stConnect.stStats.eReadyPath), stConnect.stStats.u32ReadyMs,
+           stConnect.stStats.u32Fast, stConnect.stStats.u32Scans,
+           stConnect.stStats.u32FastFails + stConnect.stStats.u32ScanFails,
+           stConnect.stStats.u32SmartConfig, stConnect.stStats.u32Lost);
+
+    if (WIFI_STATE_CONNECTED != stConnect.eState || stConnect.bSmartConfig || _stMock.bSmartConfig)
+    {
+        printf("  not connected in the end\n");
+        bPassed = false;
+    }
+    if (pstScenario->eExpectPath != stConnect.stStats.eReadyPath || 0 == stConnect.stStats.u32ReadyMs ||
+        stConnect.stStats.u32ReadyMs > pstScenario->u32MaxReadyMs)
+    {
+        printf("  expected first IP by %s within %u ms\n",
+               WiFiConnectStateName(pstScenario->eExpectPath), pstScenario->u32MaxReadyMs);
+        bPassed = false;
+    }
+    if (pstScenario->u32SmartConfig != stConnect.stStats.u32SmartConfig)
+    {
+        printf("  expected %u SmartConfig runs\n", pstScenario->u32SmartConfig);
+        bPassed = false;
+    }
+    if (0 != pstScenario->s64DownFrom && 1 != stConnect.stStats.u32Lost)
+    {
+        printf("  expected the restart to be noticed\n");
+        bPassed = false;
+    }
+    if (0 == _stMock.u32Stores || ! _stMock.bBSSIDValid || ! _stMock.bPasswordValid)
+    {
+        printf("  connection data not stored\n");
+        bPassed = false;
+    }
+
+    return bPassed;
+}
+
+static bool _APUp(int64_t s64Now)
+{
+    const Scenario* pstScenario = _stMock.pstScenario;
+
+    if (s64Now < pstScenario->s64APUp)
+    {
+        return false;
+    }
+    if (0 != pstScenario->s64DownFrom && s64Now >= pstScenario->s64DownFrom && s64Now < pstScenario->s64DownTo)
+    {
+        return false;
+    }
+    return true;
+}
+
+static void _Post(WiFiConnectEvent eEvent, int64_t s64Time)
+{
+    for (uint8_t u8Index = 0; u8Index < MAX_PENDING; u8Index++)
+    {
+        if (! _stMock.astPending[u8Index].bUsed)
+        {
+            _stMock.astPending[u8Index].bUsed   = true;
+            _stMock.astPending[u8Index].s64Time = s64Time;
+            _stMock.astPending[u8Index].eEvent  = eEvent;
+            return;
+        }
+    }
+    printf("  event queue full\n");
+}
+
+static void _Cancel(WiFiConnectEvent eEvent)
+{
+    for (uint8_t u8Index = 0; u8Index < MAX_PENDING; u8Index++)
+    {
+        if (_stMock.astPending[u8Index].bUsed && eEvent == _stMock.astPending[u8Index].eEvent)
+        {
+            _stMock.astPending[u8Index].bUsed = false;
+        }
+    }
+}
+
+static void _CancelConnect(void)
+{
+    // esp_wifi_disconnect() aborts a running attempt.
+    _Cancel(WIFI_CONNECT_GOT_IP);
+    _Cancel(WIFI_CONNECT_NO_AP);
+    _Cancel(WIFI_CONNECT_AUTH_FAILED);
+    _Cancel(WIFI_CONNECT_LOST);
+    _stMock.bAssociated = false;
+}
+
+static void _Execute(WiFiConnect* pstConnect, uint8_t u8Actions, int64_t s64Now)
+{
+    const Scenario* pstScenario = _stMock.pstScenario;
+    int64_t         s64Address  = pstScenario->bStaticIP ? STATIC_US : DHCP_US;
+
+    // The phone sent the current password.
+    if (WIFI_STATE_SMARTCONFIG == pstConnect->eState && pstConnect->bProvisioned)
+    {
+        _stMock.bPasswordValid = true;
+    }
+
+    if (u8Actions & WIFI_ACTION_SMARTCONFIG_STOP)
+    {
+        _stMock.bSmartConfig = false;
+        _Cancel(WIFI_CONNECT_PROVISIONED);
+        _Cancel(WIFI_CONNECT_SMARTCONFIG_DONE);
+    }
+    if (u8Actions & (WIFI_ACTION_CONNECT_FAST | WIFI_ACTION_CONNECT_SCAN))
+    {
+        bool    bFast = u8Actions & WIFI_ACTION_CONNECT_FAST;
+        int64_t s64Found;
+
+        _CancelConnect();
+        s64Found = s64Now + (bFast ? CHANNEL_SCAN_US : FULL_SCAN_US);
+        if (! _APUp(s64Found) || (bFast && ! _stMock.bBSSIDValid))
+        {
+            _Post(WIFI_CONNECT_NO_AP, s64Found);
+        }
+        else if (! _stMock.bPasswordValid)
+        {
+            _Post(WIFI_CONNECT_AUTH_FAILED, s64Found + AUTH_FAIL_US);
+        }
+        else
+        {
+            _Post(WIFI_CONNECT_GOT_IP, s64Found + ASSOC_US + s64Address);
+            if (_stMock.bSmartConfig)
+            {
+                _Post(WIFI_CONNECT_SMARTCONFIG_DONE, s64Found + ASSOC_US + s64Address + ACK_US);
+            }
+        }
+    }
+    if (u8Actions & WIFI_ACTION_SMARTCONFIG_START)
+    {
+        _CancelConnect();
+        _stMock.bSmartConfig = true;
+        if (pstScenario->bPhone)
+        {
+            _Post(WIFI_CONNECT_PROVISIONED, s64Now + PROVISION_US);
+        }
+    }
+    if (u8Actions & WIFI_ACTION_STORE)
+    {
+        _stMock.u32Stores++;
+        _stMock.bBSSIDValid = true;
+    }
+}